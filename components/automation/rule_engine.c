@@ -0,0 +1,521 @@
+#include "rule_engine.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_console.h"
+#include "storage_manager.h"
+#include "metrics.h"
+#include "tlog.h"
+#include "static_alloc.h"
+#include "mem_budget.h"
+#include "liveness.h"
+
+#define TAG "rules"
+#define RULE_HEADER_SIZE 7 /* size, triggers, action, arg, hold (2), name length */
+#define TIMER_BUDGET_US 200000 /* Firing actions, each a door command with its flash commits */
+
+#define RULE_METRICS(X)         \
+    X(COUNTER, input_changes)   \
+    X(COUNTER, evaluations)     \
+    X(COUNTER, fired)           \
+    X(COUNTER, rejected_loads)  \
+    X(GAUGE, rules)             \
+    X(GAUGE, eval_us_max)
+METRICS_GROUP_DEFINE(rules, RULE_METRICS)
+
+typedef struct {
+    rule_info_t info;
+    uint16_t code_offset; /* Into s_blob */
+    uint8_t code_len;
+    int64_t due_us;
+} rule_t;
+
+/* A fired rule, copied out so the action runs without s_mutex */
+typedef struct {
+    size_t index;
+    rule_action_t action;
+    uint8_t arg;
+    char name[RULE_MAX_NAME + 1];
+} firing_t;
+
+static bool s_initialized = false;
+static SemaphoreHandle_t s_mutex = NULL;
+static esp_timer_handle_t s_timer = NULL;
+static rule_action_handler_t s_handler = NULL;
+static uint8_t s_blob[RULE_BLOB_MAX];
+static rule_t s_rules[RULE_MAX_RULES];
+static size_t s_rule_count = 0;
+static int16_t s_inputs[RULE_INPUT_COUNT];
+static liveness_id_t s_timer_liveness = -1;
+
+STATIC_MUTEX_DEFINE(s_mutex);
+
+/* Checks one program; fills the set of inputs it reads. Runs before any code is executed */
+static bool verify_code(const uint8_t *code, size_t len, uint8_t *inputs)
+{
+    int depth = 0;
+    *inputs = 0;
+    for (size_t i = 0; i < len;) {
+        uint8_t op = code[i++];
+        switch (op) {
+            case RULE_OP_IN:
+                if (i >= len || code[i] >= RULE_INPUT_COUNT) {
+                    return false;
+                }
+                *inputs |= 1u << code[i++];
+                depth++;
+                break;
+            case RULE_OP_K8:
+                if (i >= len) {
+                    return false;
+                }
+                i++;
+                depth++;
+                break;
+            case RULE_OP_K16:
+                if (i + 1 >= len) {
+                    return false;
+                }
+                i += 2;
+                depth++;
+                break;
+            case RULE_OP_EQ:
+            case RULE_OP_NE:
+            case RULE_OP_LT:
+            case RULE_OP_LE:
+            case RULE_OP_GT:
+            case RULE_OP_GE:
+            case RULE_OP_AND:
+            case RULE_OP_OR:
+                if (depth < 2) {
+                    return false;
+                }
+                depth--;
+                break;
+            case RULE_OP_NOT:
+                if (depth < 1) {
+                    return false;
+                }
+                break;
+            default:
+                return false;
+        }
+        if (depth > RULE_STACK_DEPTH) {
+            return false;
+        }
+    }
+    return depth == 1;
+}
+
+/* Parses and verifies a whole blob into rules; code offsets are relative to the blob */
+static bool parse_blob(const uint8_t *blob, size_t len, rule_t *rules, size_t *count)
+{
+    if (len < 4 || len > RULE_BLOB_MAX || blob[0] != RULE_BLOB_MAGIC0 || blob[1] != RULE_BLOB_MAGIC1 ||
+        blob[2] != RULE_BLOB_VERSION || blob[3] > RULE_MAX_RULES) {
+        return false;
+    }
+
+    size_t offset = 4;
+    for (size_t r = 0; r < blob[3]; r++) {
+        if (offset + RULE_HEADER_SIZE > len) {
+            return false;
+        }
+        const uint8_t *h = &blob[offset];
+        size_t size = h[0];
+        size_t name_len = h[6];
+        if (size < RULE_HEADER_SIZE + name_len + 1 || offset + size > len || name_len > RULE_MAX_NAME ||
+            h[2] == RULE_ACTION_NONE || h[2] >= RULE_ACTION_COUNT) {
+            return false;
+        }
+        size_t code_len = size - RULE_HEADER_SIZE - name_len;
+        if (code_len > RULE_MAX_CODE) {
+            return false;
+        }
+
+        rule_t *rule = &rules[r];
+        memset(rule, 0, sizeof(*rule));
+        if (!verify_code(&h[RULE_HEADER_SIZE + name_len], code_len, &rule->info.inputs)) {
+            return false;
+        }
+        /* A trigger the condition does not read could never see its change */
+        if (h[1] == 0 || (h[1] & ~rule->info.inputs)) {
+            return false;
+        }
+        memcpy(rule->info.name, &h[RULE_HEADER_SIZE], name_len);
+        rule->info.triggers = h[1];
+        rule->info.action = (rule_action_t)h[2];
+        rule->info.action_arg = h[3];
+        rule->info.hold_s = (uint16_t)(h[4] | (h[5] << 8));
+        rule->code_offset = (uint16_t)(offset + RULE_HEADER_SIZE + name_len);
+        rule->code_len = (uint8_t)code_len;
+        offset += size;
+    }
+    *count = blob[3];
+    return offset == len;
+}
+
+/* Verified code only: no bounds checks needed */
+static bool run(const rule_t *rule)
+{
+    const uint8_t *code = &s_blob[rule->code_offset];
+    int32_t stack[RULE_STACK_DEPTH];
+    int sp = 0;
+
+    for (size_t i = 0; i < rule->code_len;) {
+        uint8_t op = code[i++];
+        int32_t b;
+        switch (op) {
+            case RULE_OP_IN:
+                stack[sp++] = s_inputs[code[i++]];
+                break;
+            case RULE_OP_K8:
+                stack[sp++] = (int8_t)code[i++];
+                break;
+            case RULE_OP_K16:
+                stack[sp++] = (int16_t)(code[i] | (code[i + 1] << 8));
+                i += 2;
+                break;
+            case RULE_OP_NOT:
+                stack[sp - 1] = !stack[sp - 1];
+                break;
+            default:
+                b = stack[--sp];
+                switch (op) {
+                    case RULE_OP_EQ: stack[sp - 1] = stack[sp - 1] == b; break;
+                    case RULE_OP_NE: stack[sp - 1] = stack[sp - 1] != b; break;
+                    case RULE_OP_LT: stack[sp - 1] = stack[sp - 1] < b; break;
+                    case RULE_OP_LE: stack[sp - 1] = stack[sp - 1] <= b; break;
+                    case RULE_OP_GT: stack[sp - 1] = stack[sp - 1] > b; break;
+                    case RULE_OP_GE: stack[sp - 1] = stack[sp - 1] >= b; break;
+                    case RULE_OP_AND: stack[sp - 1] = stack[sp - 1] && b; break;
+                    default: stack[sp - 1] = stack[sp - 1] || b; break;
+                }
+                break;
+        }
+    }
+    return stack[0] != 0;
+}
+
+/* Caller holds s_mutex */
+static void arm_timer(void)
+{
+    int64_t next = INT64_MAX;
+    for (size_t r = 0; r < s_rule_count; r++) {
+        if (s_rules[r].info.pending && s_rules[r].due_us < next) {
+            next = s_rules[r].due_us;
+        }
+    }
+    esp_timer_stop(s_timer);
+    if (next != INT64_MAX) {
+        int64_t now = esp_timer_get_time();
+        esp_timer_start_once(s_timer, next > now ? (uint64_t)(next - now) : 1);
+    }
+}
+
+static void timer_callback(void *arg)
+{
+    firing_t firing[RULE_MAX_RULES];
+    size_t count = 0;
+    uint32_t begin = liveness_begin();
+
+    LOCK_TAKE(s_mutex);
+    int64_t now = esp_timer_get_time();
+    for (size_t r = 0; r < s_rule_count; r++) {
+        rule_t *rule = &s_rules[r];
+        if (!rule->info.pending || rule->due_us > now) {
+            continue;
+        }
+        rule->info.pending = false;
+        rule->info.fired++;
+        firing[count].index = r;
+        firing[count].action = rule->info.action;
+        firing[count].arg = rule->info.action_arg;
+        memcpy(firing[count].name, rule->info.name, sizeof(firing[count].name));
+        count++;
+    }
+    arm_timer();
+    LOCK_GIVE(s_mutex);
+
+    for (size_t i = 0; i < count; i++) {
+        TLOGI(TAG, "Rule %u fired, action %d", (unsigned)firing[i].index, firing[i].action);
+        METRIC_INC(fired);
+        storage_log_event(EVENT_TYPE_RULE, (int32_t)((firing[i].index << 8) | firing[i].action));
+        if (s_handler) {
+            s_handler(firing[i].action, firing[i].arg, firing[i].name);
+        }
+    }
+    liveness_end(s_timer_liveness, begin);
+}
+
+esp_err_t rule_engine_init(rule_action_handler_t handler)
+{
+    if (s_initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    s_mutex = STATIC_MUTEX_CREATE(s_mutex);
+    if (!s_mutex) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    esp_timer_create_args_t timer_args = {
+        .callback = timer_callback,
+        .arg = NULL,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "rules"
+    };
+    esp_err_t ret = esp_timer_create(&timer_args, &s_timer);
+    if (ret != ESP_OK) {
+        vSemaphoreDelete(s_mutex);
+        return ret;
+    }
+
+    for (size_t i = 0; i < RULE_INPUT_COUNT; i++) {
+        s_inputs[i] = RULE_INPUT_UNKNOWN;
+    }
+    s_rule_count = 0;
+    s_handler = handler;
+    METRIC_SET(rules, 0);
+    METRIC_SET(eval_us_max, 0);
+    mem_budget_register_static(TAG, STATIC_MUTEX_BYTES);
+
+    /* Actions run on the esp_timer task, ahead of door timeouts and relay pulse ends */
+    const liveness_desc_t timing = {.name = "rule_timer", .budget_us = TIMER_BUDGET_US};
+    if (liveness_register(&timing, &s_timer_liveness) != ESP_OK) {
+        s_timer_liveness = -1;
+    }
+
+    s_initialized = true;
+    ESP_LOGI(TAG, "Initialized");
+    return ESP_OK;
+}
+
+esp_err_t rule_engine_deinit(void)
+{
+    if (!s_initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    esp_timer_stop(s_timer);
+    esp_timer_delete(s_timer);
+    s_timer = NULL;
+    if (s_timer_liveness >= 0) {
+        liveness_unregister(s_timer_liveness);
+        s_timer_liveness = -1;
+    }
+    vSemaphoreDelete(s_mutex);
+    s_mutex = NULL;
+    s_rule_count = 0;
+    s_handler = NULL;
+    s_initialized = false;
+    return ESP_OK;
+}
+
+esp_err_t rule_engine_load(const uint8_t *blob, size_t len)
+{
+    if (!s_initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    static rule_t parsed[RULE_MAX_RULES]; /* Too large for the caller's stack; guarded by s_mutex */
+    size_t count = 0;
+    LOCK_TAKE(s_mutex);
+    if (len > 0 && (!blob || !parse_blob(blob, len, parsed, &count))) {
+        LOCK_GIVE(s_mutex);
+        METRIC_INC(rejected_loads);
+        ESP_LOGW(TAG, "Rejected rule blob (%u bytes)", (unsigned)len);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (len > 0) {
+        memcpy(s_blob, blob, len);
+    }
+    memcpy(s_rules, parsed, count * sizeof(rule_t));
+    s_rule_count = count;
+    /* Conditions already true when loaded wait for a false -> true change */
+    for (size_t r = 0; r < s_rule_count; r++) {
+        s_rules[r].info.condition = run(&s_rules[r]);
+    }
+    arm_timer();
+    LOCK_GIVE(s_mutex);
+
+    METRIC_SET(rules, count);
+    ESP_LOGI(TAG, "Loaded %u rules (%u bytes)", (unsigned)count, (unsigned)len);
+    return ESP_OK;
+}
+
+esp_err_t rule_engine_install(const uint8_t *blob, size_t len)
+{
+    esp_err_t ret = rule_engine_load(blob, len);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    return storage_save_rules(blob, len);
+}
+
+esp_err_t rule_engine_load_stored(void)
+{
+    static uint8_t blob[RULE_BLOB_MAX];
+    size_t len = sizeof(blob);
+    esp_err_t ret = storage_load_rules(blob, &len);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    return rule_engine_load(blob, len);
+}
+
+esp_err_t rule_engine_set_input(rule_input_t input, int16_t value)
+{
+    if (input >= RULE_INPUT_COUNT) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!s_initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    LOCK_TAKE(s_mutex);
+    int16_t old = s_inputs[input];
+    if (old == value) {
+        LOCK_GIVE(s_mutex);
+        return ESP_OK;
+    }
+    s_inputs[input] = value;
+    METRIC_INC(input_changes);
+
+    int64_t start = esp_timer_get_time();
+    uint8_t bit = 1u << input;
+    for (size_t r = 0; r < s_rule_count; r++) {
+        rule_t *rule = &s_rules[r];
+        if (!(rule->info.inputs & bit)) {
+            continue;
+        }
+        rule->info.evaluations++;
+        METRIC_INC(evaluations);
+        if (!run(rule)) {
+            rule->info.condition = false;
+            rule->info.pending = false;
+            continue;
+        }
+        if (rule->info.condition) {
+            continue; /* Still true: holding, or already fired */
+        }
+        rule->info.condition = true;
+        if (old == RULE_INPUT_UNKNOWN || !(rule->info.triggers & bit)) {
+            continue;
+        }
+        rule->info.pending = true;
+        rule->due_us = start + (int64_t)rule->info.hold_s * 1000000;
+    }
+    uint32_t elapsed_us = (uint32_t)(esp_timer_get_time() - start);
+    if (elapsed_us > METRIC_GET(eval_us_max)) {
+        METRIC_SET(eval_us_max, elapsed_us);
+    }
+    /* Also re-armed when a hold was cancelled: it may have been the earliest */
+    arm_timer();
+    LOCK_GIVE(s_mutex);
+    return ESP_OK;
+}
+
+size_t rule_engine_count(void)
+{
+    return s_rule_count;
+}
+
+esp_err_t rule_engine_get_info(size_t index, rule_info_t *info)
+{
+    if (!info) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!s_initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    LOCK_TAKE(s_mutex);
+    esp_err_t ret = ESP_ERR_NOT_FOUND;
+    if (index < s_rule_count) {
+        *info = s_rules[index].info;
+        ret = ESP_OK;
+    }
+    LOCK_GIVE(s_mutex);
+    return ret;
+}
+
+uint32_t rule_engine_max_eval_us(void)
+{
+    return METRIC_GET(eval_us_max);
+}
+
+static const char *action_name(rule_action_t action)
+{
+    switch (action) {
+        case RULE_ACTION_CLOSE: return "close";
+        case RULE_ACTION_OPEN: return "open";
+        case RULE_ACTION_ALERT: return "alert";
+        default: return "?";
+    }
+}
+
+static int hex_value(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static int rules_cmd(int argc, char **argv)
+{
+    if (argc > 1 && strcmp(argv[1], "clear") == 0) {
+        return rule_engine_install(NULL, 0) == ESP_OK ? 0 : 1;
+    }
+    if (argc > 2 && strcmp(argv[1], "load") == 0) {
+        static uint8_t blob[RULE_BLOB_MAX];
+        size_t digits = strlen(argv[2]);
+        if (digits % 2 || digits / 2 > sizeof(blob)) {
+            printf("expected at most %d bytes of hex from tools/rule_compile.py\n", RULE_BLOB_MAX);
+            return 1;
+        }
+        for (size_t i = 0; i < digits / 2; i++) {
+            int hi = hex_value(argv[2][2 * i]);
+            int lo = hex_value(argv[2][2 * i + 1]);
+            if (hi < 0 || lo < 0) {
+                printf("invalid hex\n");
+                return 1;
+            }
+            blob[i] = (uint8_t)(hi << 4 | lo);
+        }
+        esp_err_t ret = rule_engine_install(blob, digits / 2);
+        printf("%s\n", ret == ESP_OK ? "rules stored" : esp_err_to_name(ret));
+        return ret == ESP_OK ? 0 : 1;
+    }
+
+    printf("inputs: door %d vehicle %d hour %d; worst evaluation %" PRIu32 " us\n", s_inputs[RULE_INPUT_DOOR],
+           s_inputs[RULE_INPUT_VEHICLE], s_inputs[RULE_INPUT_HOUR], rule_engine_max_eval_us());
+    printf("%-16s %-6s %5s %-5s %-8s %6s %6s\n", "rule", "action", "hold", "cond", "state", "evals", "fired");
+    for (size_t r = 0; r < rule_engine_count(); r++) {
+        rule_info_t info;
+        if (rule_engine_get_info(r, &info) != ESP_OK) {
+            continue;
+        }
+        printf("%-16s %-6s %5u %-5s %-8s %6" PRIu32 " %6" PRIu32 "\n", info.name, action_name(info.action),
+               info.hold_s, info.condition ? "true" : "false", info.pending ? "holding" : "idle",
+               info.evaluations, info.fired);
+    }
+    return 0;
+}
+
+esp_err_t rule_engine_register_console_command(void)
+{
+    const esp_console_cmd_t cmd = {
+        .command = "rules",
+        .help = "List automation rules, 'rules load <hex>' from tools/rule_compile.py, or 'rules clear'",
+        .hint = "[load <hex> | clear]",
+        .func = &rules_cmd,
+    };
+    return esp_console_cmd_register(&cmd);
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+/*
+ * On-device automation rules, compiled on the host by tools/rule_compile.py
+ * and stored in NVS as bytecode.
+ *
+ * A rule is a condition over a few inputs (door state, vehicle presence, hour
+ * of day), an optional hold time and an action. Inputs are pushed in with
+ * rule_engine_set_input(); only the rules whose condition reads that input are
+ * evaluated. A rule fires once when its condition becomes true because one of
+ * its trigger inputs changed and then stays true for the hold time; it fires
+ * again only after the condition was false in between. Actions run later from
+ * the esp_timer task, never in the caller of rule_engine_set_input(), so a
+ * door state callback can feed the engine without re-entering the door.
+ *
+ * Programs contain no jumps, so evaluation time is bounded by the verified
+ * code size: RULE_MAX_RULES * RULE_MAX_CODE instructions per input change at
+ * most. Inputs that become known for the first time (boot) update the rules'
+ * view but never trigger them, so a reboot cannot move the door by itself.
+ */
+
+/* Inputs; UNKNOWN (-1) until first set */
+typedef enum {
+    RULE_INPUT_DOOR = 0, /* door_state_t */
+    RULE_INPUT_VEHICLE,  /* 1 present, 0 absent */
+    RULE_INPUT_HOUR,     /* 0..23 local time, unknown until the clock is set */
+    RULE_INPUT_COUNT
+} rule_input_t;
+
+#define RULE_INPUT_UNKNOWN (-1)
+
+typedef enum {
+    RULE_ACTION_NONE = 0,
+    RULE_ACTION_CLOSE,
+    RULE_ACTION_OPEN,
+    RULE_ACTION_ALERT, /* Argument: alert code */
+    RULE_ACTION_COUNT
+} rule_action_t;
+
+/*
+ * Bytecode, little endian. Blob: "GR", version, rule count, then per rule:
+ *   u8 size (whole rule), u8 trigger mask (1 << rule_input_t), u8 action,
+ *   u8 action argument, u16 hold seconds, u8 name length, name, code.
+ * The code is a stack program leaving one value; non-zero means true.
+ */
+#define RULE_BLOB_MAGIC0  'G'
+#define RULE_BLOB_MAGIC1  'R'
+#define RULE_BLOB_VERSION 1
+#define RULE_BLOB_MAX     512
+#define RULE_MAX_RULES    16
+#define RULE_MAX_CODE     48
+#define RULE_MAX_NAME     15
+#define RULE_STACK_DEPTH  8
+
+typedef enum {
+    RULE_OP_IN = 0x01,  /* u8 input: push its value */
+    RULE_OP_K8 = 0x02,  /* i8: push constant */
+    RULE_OP_K16 = 0x03, /* i16: push constant */
+    RULE_OP_EQ = 0x10,
+    RULE_OP_NE,
+    RULE_OP_LT,
+    RULE_OP_LE,
+    RULE_OP_GT,
+    RULE_OP_GE,
+    RULE_OP_AND = 0x20,
+    RULE_OP_OR,
+    RULE_OP_NOT,
+} rule_op_t;
+
+typedef void (*rule_action_handler_t)(rule_action_t action, uint8_t arg, const char *rule_name);
+
+typedef struct {
+    char name[RULE_MAX_NAME + 1];
+    rule_action_t action;
+    uint8_t action_arg;
+    uint16_t hold_s;
+    uint8_t inputs;   /* Read by the condition */
+    uint8_t triggers; /* Changes that may fire it */
+    bool condition;
+    bool pending;     /* Held true, waiting for the hold time */
+    uint32_t evaluations;
+    uint32_t fired;
+} rule_info_t;
+
+esp_err_t rule_engine_init(rule_action_handler_t handler);
+esp_err_t rule_engine_deinit(void);
+/* Verifies and activates a blob; the previous rules stay active if it is rejected */
+esp_err_t rule_engine_load(const uint8_t *blob, size_t len);
+/* Verifies, stores in NVS and activates; an empty blob removes all rules */
+esp_err_t rule_engine_install(const uint8_t *blob, size_t len);
+/* Loads the rules stored in NVS, if any */
+esp_err_t rule_engine_load_stored(void);
+esp_err_t rule_engine_set_input(rule_input_t input, int16_t value);
+size_t rule_engine_count(void);
+esp_err_t rule_engine_get_info(size_t index, rule_info_t *info);
+/* Worst single rule_engine_set_input() evaluation since init, in microseconds */
+uint32_t rule_engine_max_eval_us(void);
+esp_err_t rule_engine_register_console_command(void);
@@ -0,0 +1,270 @@
+#include "diag_export.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include "sdkconfig.h"
+#include "esp_console.h"
+#include "esp_rom_crc.h"
+#include "driver/uart.h"
+#include "metrics.h"
+#include "trace.h"
+
+#define FRAME_MAX (DIAG_FRAME_HEADER + DIAG_EXPORT_PAYLOAD_MAX + DIAG_FRAME_CRC)
+
+_Static_assert(FRAME_MAX <= 254, "a frame must fit one COBS block");
+
+typedef struct {
+    const char *name;
+    diag_stream_t stream;
+    diag_export_read_t read;
+    void *ctx;
+} diag_source_t;
+
+static diag_source_t s_sources[DIAG_EXPORT_MAX_SOURCES];
+static size_t s_source_count = 0;
+static bool s_builtins_registered = false;
+static diag_export_write_t s_write = NULL;
+static void *s_write_ctx = NULL;
+
+/* One frame at a time, from the console task; words keep the payload 4-byte aligned */
+static uint32_t s_frame_words[FRAME_MAX / 4];
+static uint8_t s_wire[DIAG_FRAME_WIRE_MAX];
+
+static void put_u32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+uint32_t diag_crc32(const uint8_t *data, size_t len)
+{
+    return esp_rom_crc32_le(0, data, (uint32_t)len);
+}
+
+size_t diag_cobs_encode(const uint8_t *in, size_t len, uint8_t *out)
+{
+    size_t code_pos = 0;
+    size_t o = 1;
+    uint8_t code = 1;
+    for (size_t i = 0; i < len; i++) {
+        if (in[i] == 0) {
+            out[code_pos] = code;
+            code_pos = o++;
+            code = 1;
+            continue;
+        }
+        out[o++] = in[i];
+        if (++code == 0xFF) {
+            out[code_pos] = code;
+            code_pos = o++;
+            code = 1;
+        }
+    }
+    out[code_pos] = code;
+    return o;
+}
+
+size_t diag_cobs_decode(const uint8_t *in, size_t len, uint8_t *out)
+{
+    size_t i = 0;
+    size_t o = 0;
+    while (i < len) {
+        uint8_t code = in[i++];
+        if (code == 0 || i + code - 1 > len) {
+            return 0;
+        }
+        for (uint8_t k = 1; k < code; k++) {
+            if (in[i] == 0) {
+                return 0;
+            }
+            out[o++] = in[i++];
+        }
+        if (code < 0xFF && i < len) {
+            out[o++] = 0;
+        }
+    }
+    return o;
+}
+
+/* The console UART through its driver: stdout would turn \n bytes into \r\n */
+static esp_err_t uart_output(const uint8_t *data, size_t len, void *ctx)
+{
+    return uart_write_bytes(CONFIG_ESP_CONSOLE_UART_NUM, data, len) == (int)len ? ESP_OK : ESP_FAIL;
+}
+
+static esp_err_t output(const uint8_t *data, size_t len)
+{
+    return s_write ? s_write(data, len, s_write_ctx) : uart_output(data, len, NULL);
+}
+
+/* The payload is already in place after the header */
+static esp_err_t send_frame(diag_stream_t stream, uint8_t flags, uint16_t seq, size_t len)
+{
+    uint8_t *frame = (uint8_t *)s_frame_words;
+    frame[0] = (uint8_t)stream;
+    frame[1] = flags;
+    frame[2] = (uint8_t)seq;
+    frame[3] = (uint8_t)(seq >> 8);
+    put_u32(&frame[DIAG_FRAME_HEADER + len], diag_crc32(frame, DIAG_FRAME_HEADER + len));
+
+    size_t n = diag_cobs_encode(frame, DIAG_FRAME_HEADER + len + DIAG_FRAME_CRC, s_wire);
+    s_wire[n++] = 0;
+    return output(s_wire, n);
+}
+
+static esp_err_t read_metrics_schema(uint32_t *cursor, uint8_t *buf, size_t len, size_t *out_len, void *ctx)
+{
+    return metrics_read_schema(cursor, (char *)buf, len, out_len);
+}
+
+static esp_err_t read_metrics(uint32_t *cursor, uint8_t *buf, size_t len, size_t *out_len, void *ctx)
+{
+    *out_len = metrics_read_binary(cursor, buf, len);
+    return ESP_OK;
+}
+
+static esp_err_t read_trace(uint32_t *cursor, uint8_t *buf, size_t len, size_t *out_len, void *ctx)
+{
+    *out_len = trace_read(cursor, (trace_record_t *)buf, len / sizeof(trace_record_t)) * sizeof(trace_record_t);
+    return ESP_OK;
+}
+
+static esp_err_t add_source(const char *name, diag_stream_t stream, diag_export_read_t read, void *ctx)
+{
+    if (s_source_count >= DIAG_EXPORT_MAX_SOURCES) {
+        return ESP_ERR_NO_MEM;
+    }
+    s_sources[s_source_count++] = (diag_source_t){
+        .name = name,
+        .stream = stream,
+        .read = read,
+        .ctx = ctx,
+    };
+    return ESP_OK;
+}
+
+static void register_builtins(void)
+{
+    if (s_builtins_registered) {
+        return;
+    }
+    s_builtins_registered = true;
+    add_source("metrics", DIAG_STREAM_METRICS_SCHEMA, read_metrics_schema, NULL);
+    add_source("metrics", DIAG_STREAM_METRICS, read_metrics, NULL);
+    add_source("trace", DIAG_STREAM_TRACE, read_trace, NULL);
+}
+
+esp_err_t diag_export_register_source(const char *name, diag_stream_t stream, diag_export_read_t read, void *ctx)
+{
+    if (!name || !read || stream == DIAG_STREAM_END) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    register_builtins();
+    return add_source(name, stream, read, ctx);
+}
+
+void diag_export_set_output(diag_export_write_t write, void *ctx)
+{
+    s_write = write;
+    s_write_ctx = ctx;
+}
+
+static bool selected(const diag_source_t *src, const char *const *names, size_t count)
+{
+    if (count == 0) {
+        return true;
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (strcmp(src->name, names[i]) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static esp_err_t export_source(const diag_source_t *src, uint32_t *frames, uint32_t *bytes)
+{
+    uint8_t *payload = (uint8_t *)s_frame_words + DIAG_FRAME_HEADER;
+    uint32_t cursor = 0;
+    uint16_t seq = 0;
+    uint8_t flags = DIAG_FRAME_FIRST;
+
+    for (;;) {
+        size_t len = 0;
+        esp_err_t ret = src->read(&cursor, payload, DIAG_EXPORT_PAYLOAD_MAX, &len, src->ctx);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+        if (len == 0) {
+            flags |= DIAG_FRAME_LAST;
+        }
+        ret = send_frame(src->stream, flags, seq++, len);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+        (*frames)++;
+        *bytes += len;
+        if (len == 0) {
+            return ESP_OK;
+        }
+        flags = 0;
+    }
+}
+
+esp_err_t diag_export(const char *const *names, size_t count)
+{
+    register_builtins();
+    for (size_t i = 0; i < count; i++) {
+        bool known = false;
+        for (size_t s = 0; s < s_source_count; s++) {
+            known = known || strcmp(s_sources[s].name, names[i]) == 0;
+        }
+        if (!known) {
+            return ESP_ERR_NOT_FOUND;
+        }
+    }
+
+    /* Text already printed goes first; the delimiter ends any partial line for the receiver */
+    fflush(stdout);
+    const uint8_t delimiter = 0;
+    esp_err_t ret = output(&delimiter, 1);
+
+    uint32_t frames = 0;
+    uint32_t bytes = 0;
+    for (size_t s = 0; s < s_source_count && ret == ESP_OK; s++) {
+        if (selected(&s_sources[s], names, count)) {
+            ret = export_source(&s_sources[s], &frames, &bytes);
+        }
+    }
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    uint8_t *payload = (uint8_t *)s_frame_words + DIAG_FRAME_HEADER;
+    put_u32(&payload[0], frames);
+    put_u32(&payload[4], bytes);
+    return send_frame(DIAG_STREAM_END, DIAG_FRAME_FIRST | DIAG_FRAME_LAST, 0, 8);
+}
+
+static int export_cmd(int argc, char **argv)
+{
+    esp_err_t ret = diag_export((const char *const *)&argv[1], (size_t)(argc - 1));
+    if (ret != ESP_OK) {
+        printf("export: %s\n", esp_err_to_name(ret));
+        return 1;
+    }
+    return 0;
+}
+
+esp_err_t diag_export_register_console_command(void)
+{
+    const esp_console_cmd_t cmd = {
+        .command = "export",
+        .help = "Stream diagnostics as binary frames for tools/diag_export.py: all sources, or the named ones",
+        .hint = "[events|metrics|trace]...",
+        .func = &export_cmd,
+    };
+    return esp_console_cmd_register(&cmd);
+}
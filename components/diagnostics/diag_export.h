@@ -0,0 +1,70 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+/*
+ * Binary diagnostic export on the console UART.
+ *
+ * 'export' streams the registered sources (event log, metrics, trace ring) as
+ * frames instead of formatted text. Each frame is
+ *
+ *   COBS(u8 stream, u8 flags, u16 seq, payload[0..DIAG_EXPORT_PAYLOAD_MAX], u32 crc32) 0x00
+ *
+ * little endian, with a CRC-32 (IEEE, as zlib) over header and payload. COBS
+ * keeps 0x00 out of the frame so the delimiter resynchronises a receiver
+ * after console text or a lost byte. Sources copy their records straight into
+ * the frame buffer a chunk at a time, so nothing is staged in RAM beyond one
+ * frame. A stream ends with a frame flagged DIAG_FRAME_LAST (possibly
+ * empty); the export ends with a DIAG_STREAM_END frame. tools/diag_export.py
+ * sends the command, receives and decodes the frames.
+ *
+ * Frames go to the console UART through the driver, bypassing the newline
+ * translation of stdout, and only from the console task.
+ */
+
+typedef enum {
+    DIAG_STREAM_END = 0,            /* u32 frames, u32 payload bytes of the export */
+    DIAG_STREAM_EVENTS = 1,         /* storage_export_record_t records, oldest first */
+    DIAG_STREAM_METRICS_SCHEMA = 2, /* "group.name:c;" per metric, the metrics_schema_hash() input */
+    DIAG_STREAM_METRICS = 3,        /* metrics_snapshot_binary() */
+    DIAG_STREAM_TRACE = 4,          /* trace_record_t records, oldest first */
+} diag_stream_t;
+
+#define DIAG_FRAME_FIRST 0x01
+#define DIAG_FRAME_LAST  0x02
+
+#define DIAG_FRAME_HEADER       4
+#define DIAG_FRAME_CRC          4
+/* Header, payload and CRC fill exactly one COBS block: one byte of overhead */
+#define DIAG_EXPORT_PAYLOAD_MAX 240
+/* Longest encoded frame, delimiter included */
+#define DIAG_FRAME_WIRE_MAX     (DIAG_FRAME_HEADER + DIAG_EXPORT_PAYLOAD_MAX + DIAG_FRAME_CRC + 2)
+
+#define DIAG_EXPORT_MAX_SOURCES 8
+
+/*
+ * Fills buf (4-byte aligned, 'len' bytes) with the next chunk of a stream
+ * starting at *cursor, which starts at 0 and means what the source wants.
+ * Sets *out_len to the bytes written; 0 ends the stream. An error aborts the
+ * export without its end frame.
+ */
+typedef esp_err_t (*diag_export_read_t)(uint32_t *cursor, uint8_t *buf, size_t len, size_t *out_len, void *ctx);
+/* Receives encoded frames */
+typedef esp_err_t (*diag_export_write_t)(const uint8_t *data, size_t len, void *ctx);
+
+/* Metrics and trace are built in; the name selects a source on the command line */
+esp_err_t diag_export_register_source(const char *name, diag_stream_t stream, diag_export_read_t read, void *ctx);
+/* NULL restores the console UART */
+void diag_export_set_output(diag_export_write_t write, void *ctx);
+
+/* Exports the named sources in registration order, all of them for count 0 */
+esp_err_t diag_export(const char *const *names, size_t count);
+
+/* COBS encoding with no delimiter; decode returns 0 for malformed input */
+size_t diag_cobs_encode(const uint8_t *in, size_t len, uint8_t *out);
+size_t diag_cobs_decode(const uint8_t *in, size_t len, uint8_t *out);
+uint32_t diag_crc32(const uint8_t *data, size_t len);
+
+esp_err_t diag_export_register_console_command(void);
@@ -0,0 +1,99 @@
+#include "hot_path.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include "esp_console.h"
+
+static hot_path_t *s_paths = NULL;
+
+void hot_path_record(hot_path_t *path, uint32_t cycles)
+{
+    if (!path->listed) {
+        path->listed = true;
+        path->next = __atomic_load_n(&s_paths, __ATOMIC_RELAXED);
+        while (!__atomic_compare_exchange_n(&s_paths, &path->next, path, true, __ATOMIC_RELEASE,
+                                            __ATOMIC_RELAXED)) {
+        }
+    }
+    if (path->calls == 0 || cycles < path->cycles_min) {
+        path->cycles_min = cycles;
+    }
+    if (cycles > path->cycles_max) {
+        path->cycles_max = cycles;
+    }
+    path->cycles_total += cycles;
+    path->calls++;
+}
+
+const hot_path_t *hot_path_next(const hot_path_t *path)
+{
+    return path ? path->next : __atomic_load_n(&s_paths, __ATOMIC_ACQUIRE);
+}
+
+const hot_path_t *hot_path_find(const char *name)
+{
+    for (const hot_path_t *p = hot_path_next(NULL); p; p = hot_path_next(p)) {
+        if (strcmp(p->name, name) == 0) {
+            return p;
+        }
+    }
+    return NULL;
+}
+
+uint64_t hot_path_stall_total(const hot_path_t *path)
+{
+    return path->cycles_total - (uint64_t)path->calls * path->cycles_min;
+}
+
+uint32_t hot_path_stall_max(const hot_path_t *path)
+{
+    return path->calls ? path->cycles_max - path->cycles_min : 0;
+}
+
+void hot_path_reset(void)
+{
+    for (hot_path_t *p = __atomic_load_n(&s_paths, __ATOMIC_ACQUIRE); p; p = p->next) {
+        p->calls = 0;
+        p->cycles_min = 0;
+        p->cycles_max = 0;
+        p->cycles_total = 0;
+    }
+}
+
+static int hotpath_cmd(int argc, char **argv)
+{
+    if (argc > 1 && strcmp(argv[1], "reset") == 0) {
+        hot_path_reset();
+        return 0;
+    }
+
+#if CONFIG_GARAGE_HOT_PATH_IRAM
+    printf("Hot paths in IRAM (budget %d bytes)\n", CONFIG_GARAGE_HOT_PATH_IRAM_BUDGET);
+#else
+    printf("Hot paths in flash\n");
+#endif
+    if (!hot_path_next(NULL)) {
+        printf("No profiled paths (CONFIG_GARAGE_HOT_PATH_PROFILE is off, or none ran yet)\n");
+        return 0;
+    }
+
+    printf("%-28s %8s %8s %8s %8s %10s %10s\n", "cycles", "calls", "min", "avg", "max", "stall avg", "stall max");
+    for (const hot_path_t *p = hot_path_next(NULL); p; p = hot_path_next(p)) {
+        uint32_t calls = p->calls ? p->calls : 1;
+        printf("%-28s %8" PRIu32 " %8" PRIu32 " %8" PRIu32 " %8" PRIu32 " %10" PRIu32 " %10" PRIu32 "\n", p->name,
+               p->calls, p->cycles_min, (uint32_t)(p->cycles_total / calls), p->cycles_max,
+               (uint32_t)(hot_path_stall_total(p) / calls), hot_path_stall_max(p));
+    }
+    return 0;
+}
+
+esp_err_t hot_path_register_console_command(void)
+{
+    const esp_console_cmd_t cmd = {
+        .command = "hotpath",
+        .help = "Cycles and estimated cache stalls on the timing-critical paths, or 'hotpath reset'",
+        .hint = "[reset]",
+        .func = &hotpath_cmd,
+    };
+    return esp_console_cmd_register(&cmd);
+}
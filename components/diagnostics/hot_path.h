@@ -0,0 +1,76 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "sdkconfig.h"
+#include "esp_err.h"
+#include "esp_cpu.h"
+
+/*
+ * Timing-critical code paths: placement and cycle profiling.
+ *
+ * HOT_PATH_ATTR marks the reed debounce, relay pulse and door state machine
+ * functions. With CONFIG_GARAGE_HOT_PATH_IRAM they are linked into IRAM
+ * (sections .iram1.hot.*) instead of running from flash through the cache;
+ * tools/iram_budget.py checks their total against
+ * CONFIG_GARAGE_HOT_PATH_IRAM_BUDGET after every link. Callees outside these
+ * files (esp_timer, GPIO driver, NVS) keep their own placement. These paths
+ * run in tasks and timer callbacks, which wait out a flash write on the
+ * single core anyway: IRAM removes their cache misses, not that wait. Only
+ * the reed and tilt ISRs run during a flash write; they are registered with
+ * ESP_INTR_FLAG_IRAM and call only IRAM-safe code.
+ *
+ * With CONFIG_GARAGE_HOT_PATH_PROFILE each marked path counts the CPU cycles
+ * between HOT_PATH_BEGIN() and HOT_PATH_END(). The ESP32-H2 has no cache miss
+ * counter, so stalls are estimated: the fastest run of a path is taken as its
+ * warm-cache cost and every cycle above it as a stall (cache misses, plus any
+ * interrupt taken meanwhile). Comparing the two placements gives the latency
+ * saved per byte of IRAM. Each record is only written from one context at a
+ * time (its timer callback, or under its component's mutex), so it needs no
+ * lock of its own. 'hotpath' on the console prints them.
+ */
+
+#if CONFIG_GARAGE_HOT_PATH_IRAM
+#define HOT_PATH_STR_(x)  #x
+#define HOT_PATH_STR(x)   HOT_PATH_STR_(x)
+#define HOT_PATH_ATTR     __attribute__((section(".iram1.hot." HOT_PATH_STR(__COUNTER__))))
+#else
+#define HOT_PATH_ATTR
+#endif
+
+typedef struct hot_path {
+    const char *name;
+    uint32_t calls;
+    uint32_t cycles_min;
+    uint32_t cycles_max;
+    uint64_t cycles_total;
+    struct hot_path *next;
+    bool listed;
+} hot_path_t;
+
+#if CONFIG_GARAGE_HOT_PATH_PROFILE
+
+#define HOT_PATH_DEFINE(path)       static hot_path_t path##_hot = {.name = TAG "/" #path}
+#define HOT_PATH_BEGIN()            esp_cpu_get_cycle_count()
+#define HOT_PATH_END(path, begin)   hot_path_record(&path##_hot, esp_cpu_get_cycle_count() - (begin))
+
+#else
+
+#define HOT_PATH_DEFINE(path)       extern int path##_hot_unused_
+#define HOT_PATH_BEGIN()            0
+#define HOT_PATH_END(path, begin)   ((void)(begin))
+
+#endif
+
+/* Lists the record on its first call */
+void hot_path_record(hot_path_t *path, uint32_t cycles);
+
+/* Walk the records: pass NULL for the first */
+const hot_path_t *hot_path_next(const hot_path_t *path);
+const hot_path_t *hot_path_find(const char *name);
+/* Cycles above the warm-cache minimum: all calls, and the worst one */
+uint64_t hot_path_stall_total(const hot_path_t *path);
+uint32_t hot_path_stall_max(const hot_path_t *path);
+/* A path running at the time may keep the cycles of the call in progress */
+void hot_path_reset(void);
+esp_err_t hot_path_register_console_command(void);
@@ -0,0 +1,410 @@
+#include "liveness.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "esp_console.h"
+#include "metrics.h"
+#include "static_alloc.h"
+#include "mem_budget.h"
+
+#define TAG "liveness"
+#define MONITOR_STACK_SIZE 2560
+/* Above the esp_timer task (22), so a callback spinning there cannot hide itself */
+#define MONITOR_PRIORITY 23
+/* Longest monitor sleep while an entry is silent, so a silence that ended is noticed without a new deadline */
+#define MONITOR_SILENT_SCAN_MS 1000
+#define HEARTBEAT_ALLOWANCE 3 /* Heartbeats the esp_timer task may fall behind before it counts as wedged */
+
+#define LIVENESS_METRICS(X)    \
+    X(COUNTER, escalations)    \
+    X(GAUGE, silent)           \
+    X(GAUGE, entries)
+METRICS_GROUP_DEFINE(liveness, LIVENESS_METRICS)
+
+typedef struct {
+    bool used;
+    liveness_desc_t desc;
+    /* Shared with the check-in paths, accessed with atomics only */
+    uint32_t period_us; /* 0: idle */
+    uint32_t last_us;
+    uint32_t checkins;
+    uint32_t misses;
+    uint32_t lateness_max_us;
+    uint32_t runs;
+    uint32_t overruns;
+    uint32_t exec_max_us;
+    /* Monitor task only */
+    bool silent;
+    uint32_t escalations;
+} entry_t;
+
+static bool s_initialized = false;
+static entry_t s_entries[LIVENESS_MAX_ENTRIES];
+static liveness_escalation_fn_t s_escalate = NULL;
+static SemaphoreHandle_t s_mutex = NULL;
+static TaskHandle_t s_task = NULL;
+static esp_timer_handle_t s_heartbeat_timer = NULL;
+static liveness_id_t s_heartbeat_id = -1;
+
+STATIC_MUTEX_DEFINE(s_mutex);
+STATIC_TASK_DEFINE(s_monitor, MONITOR_STACK_SIZE);
+
+static inline uint32_t now_us(void)
+{
+    return (uint32_t)esp_timer_get_time();
+}
+
+static inline void atomic_max(uint32_t *target, uint32_t value)
+{
+    uint32_t seen = __atomic_load_n(target, __ATOMIC_RELAXED);
+    while (value > seen &&
+           !__atomic_compare_exchange_n(target, &seen, value, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+void liveness_checkin(liveness_id_t id)
+{
+    if (id < 0 || id >= LIVENESS_MAX_ENTRIES) {
+        return;
+    }
+    entry_t *e = &s_entries[id];
+    uint32_t now = now_us();
+    uint32_t gap = now - __atomic_exchange_n(&e->last_us, now, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&e->checkins, 1, __ATOMIC_RELAXED);
+    uint32_t period_us = __atomic_load_n(&e->period_us, __ATOMIC_RELAXED);
+    if (period_us && gap > period_us) {
+        __atomic_fetch_add(&e->misses, 1, __ATOMIC_RELAXED);
+        atomic_max(&e->lateness_max_us, gap - period_us);
+    }
+}
+
+uint32_t liveness_begin(void)
+{
+    return now_us();
+}
+
+void liveness_end(liveness_id_t id, uint32_t begin)
+{
+    if (id < 0 || id >= LIVENESS_MAX_ENTRIES) {
+        return;
+    }
+    entry_t *e = &s_entries[id];
+    uint32_t exec_us = now_us() - begin;
+    __atomic_fetch_add(&e->runs, 1, __ATOMIC_RELAXED);
+    atomic_max(&e->exec_max_us, exec_us);
+    if (e->desc.budget_us && exec_us > e->desc.budget_us) {
+        __atomic_fetch_add(&e->overruns, 1, __ATOMIC_RELAXED);
+    }
+}
+
+static void escalate(liveness_id_t id, const char *name, liveness_action_t action, uint32_t period_ms)
+{
+    static const char *const actions[] = {"logged", "stopping the door", "rebooting"};
+    ESP_LOGE(TAG, "%s silent for more than %" PRIu32 " ms, %s", name, period_ms, actions[action]);
+    METRIC_INC(escalations);
+    if (s_escalate) {
+        s_escalate(id, name, action);
+    }
+    if (action == LIVENESS_ACTION_REBOOT) {
+        esp_restart();
+    }
+}
+
+/* Escalates entries whose window ran out; returns ticks until the next window ends */
+static TickType_t scan(void)
+{
+    liveness_id_t overdue[LIVENESS_MAX_ENTRIES];
+    liveness_desc_t descs[LIVENESS_MAX_ENTRIES];
+    size_t count = 0;
+    /* Otherwise the next window end: register and set_period wake the monitor, check-ins need not */
+    uint32_t next_us = LIVENESS_MAX_PERIOD_MS * 1000U;
+    uint32_t silent = 0;
+
+    LOCK_TAKE(s_mutex);
+    for (liveness_id_t i = 0; i < LIVENESS_MAX_ENTRIES; i++) {
+        entry_t *e = &s_entries[i];
+        uint32_t period_us = __atomic_load_n(&e->period_us, __ATOMIC_ACQUIRE);
+        if (!e->used || !period_us) {
+            e->silent = false;
+            continue;
+        }
+        /* Clock read after the check-in time, so a check-in racing the scan cannot look 71 minutes old */
+        uint32_t last = __atomic_load_n(&e->last_us, __ATOMIC_RELAXED);
+        uint32_t elapsed = now_us() - last;
+        if (elapsed <= period_us) {
+            e->silent = false;
+            if (period_us - elapsed < next_us) {
+                next_us = period_us - elapsed;
+            }
+            continue;
+        }
+        silent++;
+        if (!e->silent) {
+            e->silent = true;
+            e->escalations++;
+            overdue[count] = i;
+            descs[count++] = e->desc;
+        }
+    }
+    METRIC_SET(silent, silent);
+    LOCK_GIVE(s_mutex);
+    if (silent && next_us > MONITOR_SILENT_SCAN_MS * 1000) {
+        next_us = MONITOR_SILENT_SCAN_MS * 1000;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        escalate(overdue[i], descs[i].name, descs[i].action, descs[i].period_ms);
+    }
+    return pdMS_TO_TICKS(next_us / 1000) + 1;
+}
+
+static void monitor_task(void *pvParameters)
+{
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, scan());
+    }
+}
+
+static void heartbeat_callback(void *arg)
+{
+    liveness_checkin(s_heartbeat_id);
+}
+
+/* Caller holds s_mutex */
+static liveness_id_t add_entry(const liveness_desc_t *desc)
+{
+    for (liveness_id_t i = 0; i < LIVENESS_MAX_ENTRIES; i++) {
+        entry_t *e = &s_entries[i];
+        if (e->used) {
+            continue;
+        }
+        memset(e, 0, sizeof(*e));
+        e->used = true;
+        e->desc = *desc;
+        __atomic_store_n(&e->last_us, now_us(), __ATOMIC_RELAXED);
+        __atomic_store_n(&e->period_us, desc->period_ms * 1000, __ATOMIC_RELEASE);
+        METRIC_INC(entries);
+        return i;
+    }
+    return -1;
+}
+
+esp_err_t liveness_init(liveness_escalation_fn_t escalate_fn)
+{
+    if (s_initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    memset(s_entries, 0, sizeof(s_entries));
+    s_escalate = escalate_fn;
+    s_mutex = STATIC_MUTEX_CREATE(s_mutex);
+    if (!s_mutex) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    const liveness_desc_t heartbeat = {
+        .name = "esp_timer",
+        .period_ms = HEARTBEAT_ALLOWANCE * LIVENESS_TIMER_HEARTBEAT_MS,
+        .action = LIVENESS_ACTION_REBOOT,
+    };
+    METRIC_SET(entries, 0);
+    s_heartbeat_id = add_entry(&heartbeat);
+
+    esp_timer_create_args_t timer_args = {
+        .callback = heartbeat_callback,
+        .arg = NULL,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "liveness"
+    };
+    esp_err_t ret = esp_timer_create(&timer_args, &s_heartbeat_timer);
+    if (ret != ESP_OK) {
+        vSemaphoreDelete(s_mutex);
+        return ret;
+    }
+
+    BaseType_t task_ret = STATIC_TASK_CREATE(s_monitor, monitor_task, "liveness", NULL, MONITOR_PRIORITY, &s_task);
+    if (task_ret != pdPASS) {
+        esp_timer_delete(s_heartbeat_timer);
+        vSemaphoreDelete(s_mutex);
+        return ESP_ERR_NO_MEM;
+    }
+    esp_timer_start_periodic(s_heartbeat_timer, (uint64_t)LIVENESS_TIMER_HEARTBEAT_MS * 1000);
+
+    mem_budget_register_static(TAG, STATIC_MUTEX_BYTES + STATIC_TASK_BYTES(s_monitor));
+    mem_budget_register_task(TAG, s_task, MONITOR_STACK_SIZE);
+
+    s_initialized = true;
+    ESP_LOGI(TAG, "Initialized, %d entries", LIVENESS_MAX_ENTRIES);
+    return ESP_OK;
+}
+
+esp_err_t liveness_deinit(void)
+{
+    if (!s_initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    esp_timer_stop(s_heartbeat_timer);
+    esp_timer_delete(s_heartbeat_timer);
+    s_heartbeat_timer = NULL;
+    mem_budget_unregister_task(s_task);
+    vTaskDelete(s_task);
+    s_task = NULL;
+
+    vSemaphoreDelete(s_mutex);
+    s_mutex = NULL;
+    memset(s_entries, 0, sizeof(s_entries));
+    s_heartbeat_id = -1;
+    s_escalate = NULL;
+    s_initialized = false;
+    return ESP_OK;
+}
+
+esp_err_t liveness_register(const liveness_desc_t *desc, liveness_id_t *id)
+{
+    if (!desc || !id || desc->period_ms > LIVENESS_MAX_PERIOD_MS || desc->action > LIVENESS_ACTION_REBOOT) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!s_initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    LOCK_TAKE(s_mutex);
+    liveness_id_t slot = add_entry(desc);
+    LOCK_GIVE(s_mutex);
+    if (slot < 0) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    *id = slot;
+    xTaskNotifyGive(s_task);
+    return ESP_OK;
+}
+
+esp_err_t liveness_unregister(liveness_id_t id)
+{
+    if (id < 0 || id >= LIVENESS_MAX_ENTRIES) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!s_initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    LOCK_TAKE(s_mutex);
+    if (!s_entries[id].used) {
+        LOCK_GIVE(s_mutex);
+        return ESP_ERR_NOT_FOUND;
+    }
+    memset(&s_entries[id], 0, sizeof(s_entries[id]));
+    METRIC_ADD(entries, -1);
+    LOCK_GIVE(s_mutex);
+    return ESP_OK;
+}
+
+esp_err_t liveness_set_period(liveness_id_t id, uint32_t period_ms)
+{
+    if (id < 0 || id >= LIVENESS_MAX_ENTRIES || period_ms > LIVENESS_MAX_PERIOD_MS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!s_initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    entry_t *e = &s_entries[id];
+    /* Window start before the period, so the monitor never pairs a new period with an old check-in */
+    __atomic_store_n(&e->last_us, now_us(), __ATOMIC_RELAXED);
+    __atomic_store_n(&e->period_us, period_ms * 1000, __ATOMIC_RELEASE);
+    xTaskNotifyGive(s_task);
+    return ESP_OK;
+}
+
+esp_err_t liveness_get_stats(liveness_id_t id, liveness_stats_t *stats)
+{
+    if (id < 0 || id >= LIVENESS_MAX_ENTRIES || !stats) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!s_initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    LOCK_TAKE(s_mutex);
+    const entry_t *e = &s_entries[id];
+    esp_err_t ret = ESP_ERR_NOT_FOUND;
+    if (e->used) {
+        *stats = (liveness_stats_t){
+            .name = e->desc.name,
+            .period_ms = __atomic_load_n(&e->period_us, __ATOMIC_RELAXED) / 1000,
+            .silent = e->silent,
+            .checkins = __atomic_load_n(&e->checkins, __ATOMIC_RELAXED),
+            .misses = __atomic_load_n(&e->misses, __ATOMIC_RELAXED),
+            .lateness_max_us = __atomic_load_n(&e->lateness_max_us, __ATOMIC_RELAXED),
+            .escalations = e->escalations,
+            .runs = __atomic_load_n(&e->runs, __ATOMIC_RELAXED),
+            .overruns = __atomic_load_n(&e->overruns, __ATOMIC_RELAXED),
+            .exec_max_us = __atomic_load_n(&e->exec_max_us, __ATOMIC_RELAXED),
+        };
+        ret = ESP_OK;
+    }
+    LOCK_GIVE(s_mutex);
+    return ret;
+}
+
+void liveness_reset_stats(void)
+{
+    if (!s_initialized) {
+        return;
+    }
+
+    LOCK_TAKE(s_mutex);
+    for (liveness_id_t i = 0; i < LIVENESS_MAX_ENTRIES; i++) {
+        entry_t *e = &s_entries[i];
+        __atomic_store_n(&e->checkins, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&e->misses, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&e->lateness_max_us, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&e->runs, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&e->overruns, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&e->exec_max_us, 0, __ATOMIC_RELAXED);
+        e->escalations = 0;
+    }
+    LOCK_GIVE(s_mutex);
+}
+
+static int liveness_cmd(int argc, char **argv)
+{
+    if (argc > 1 && strcmp(argv[1], "reset") == 0) {
+        liveness_reset_stats();
+        return 0;
+    }
+
+    printf("%-14s %7s %8s %5s %9s %5s %7s %7s %9s\n", "entry", "period", "checkins", "miss", "late_max", "esc",
+           "runs", "overrun", "exec_max");
+    for (liveness_id_t i = 0; i < LIVENESS_MAX_ENTRIES; i++) {
+        liveness_stats_t st;
+        if (liveness_get_stats(i, &st) != ESP_OK) {
+            continue;
+        }
+        printf("%-14s %7" PRIu32 " %8" PRIu32 " %5" PRIu32 " %9" PRIu32 " %5" PRIu32 " %7" PRIu32 " %7" PRIu32
+               " %9" PRIu32 "%s\n",
+               st.name ? st.name : "?", st.period_ms, st.checkins, st.misses, st.lateness_max_us, st.escalations,
+               st.runs, st.overruns, st.exec_max_us, st.silent ? "  SILENT" : "");
+    }
+    printf("times in us, period in ms (0: idle)\n");
+    return 0;
+}
+
+esp_err_t liveness_register_console_command(void)
+{
+    const esp_console_cmd_t cmd = {
+        .command = "liveness",
+        .help = "Task and timer check-ins, deadline misses and execution time, or 'liveness reset'",
+        .hint = "[reset]",
+        .func = &liveness_cmd,
+    };
+    return esp_console_cmd_register(&cmd);
+}
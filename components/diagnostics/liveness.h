@@ -0,0 +1,74 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+/*
+ * Liveness and deadline monitor for tasks and esp_timer callbacks.
+ *
+ * Each registration declares how long it may go without checking in. A
+ * high-priority monitor task sleeps until the earliest of those deadlines and
+ * escalates an entry that stays silent past it: record only, stop the door
+ * (via the handler given to liveness_init) or reboot. Late check-ins count as
+ * misses with their lateness; liveness_begin/liveness_end time a callback
+ * against its execution budget. Check-in and end are lock free, a handful of
+ * relaxed atomics each, so they can sit on the paths they watch.
+ *
+ * An entry registered with period 0, or set to it, is idle: a task or timer
+ * that only has work at times (the safety check while the door moves, a relay
+ * pulse) arms its entry when the work starts. Timestamps are 32-bit
+ * microseconds, so periods are limited to LIVENESS_MAX_PERIOD_MS.
+ */
+
+#define LIVENESS_MAX_ENTRIES   12
+#define LIVENESS_MAX_PERIOD_MS (60 * 60 * 1000)
+/* The monitor's own esp_timer check-in; a wedged esp_timer task also stalls door timeouts and relay pulses */
+#define LIVENESS_TIMER_HEARTBEAT_MS 1000
+
+typedef enum {
+    LIVENESS_ACTION_NONE,      /* Record and log only */
+    LIVENESS_ACTION_SAFE_STOP, /* Escalation handler stops the door */
+    LIVENESS_ACTION_REBOOT,
+} liveness_action_t;
+
+typedef struct {
+    const char *name;
+    uint32_t period_ms;        /* Longest gap between check-ins while armed; 0 registers it idle */
+    uint32_t budget_us;        /* Execution budget per liveness_begin/end; 0 if not timed */
+    liveness_action_t action;  /* Taken once per silence, when the period runs out */
+} liveness_desc_t;
+
+typedef int liveness_id_t;
+
+/* Runs on the monitor task; must not wait on anything the watched tasks may hold */
+typedef void (*liveness_escalation_fn_t)(liveness_id_t id, const char *name, liveness_action_t action);
+
+typedef struct {
+    const char *name;
+    uint32_t period_ms;
+    bool silent;              /* Overdue now, escalated */
+    uint32_t checkins;
+    uint32_t misses;          /* Check-ins that came after the period ran out */
+    uint32_t lateness_max_us; /* Longest gap past the period */
+    uint32_t escalations;
+    uint32_t runs;
+    uint32_t overruns;        /* Runs over budget_us */
+    uint32_t exec_max_us;
+} liveness_stats_t;
+
+/* 'escalate' may be NULL; REBOOT entries reboot after it returns either way */
+esp_err_t liveness_init(liveness_escalation_fn_t escalate);
+esp_err_t liveness_deinit(void);
+esp_err_t liveness_register(const liveness_desc_t *desc, liveness_id_t *id);
+esp_err_t liveness_unregister(liveness_id_t id);
+/* Arms the entry with a fresh window from now, or idles it with 0 */
+esp_err_t liveness_set_period(liveness_id_t id, uint32_t period_ms);
+esp_err_t liveness_get_stats(liveness_id_t id, liveness_stats_t *stats);
+void liveness_reset_stats(void);
+esp_err_t liveness_register_console_command(void);
+
+/* Hot path. An id that was never registered (monitor not running) is ignored */
+void liveness_checkin(liveness_id_t id);
+uint32_t liveness_begin(void);
+void liveness_end(liveness_id_t id, uint32_t begin);
@@ -0,0 +1,166 @@
+#include "lock_profile.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "esp_console.h"
+
+static lock_profile_t *s_profiles = NULL;
+
+static inline uint32_t now_us(void)
+{
+    return (uint32_t)esp_timer_get_time();
+}
+
+static size_t bucket_of(uint32_t us)
+{
+    size_t bucket = 0;
+    for (uint32_t limit = 10; bucket < LOCK_PROFILE_BUCKETS - 1 && us >= limit; limit *= 10) {
+        bucket++;
+    }
+    return bucket;
+}
+
+static void copy_name(char *dst, TaskHandle_t task)
+{
+    const char *name = pcTaskGetName(task);
+    strncpy(dst, name ? name : "?", LOCK_PROFILE_NAME_LEN - 1);
+    dst[LOCK_PROFILE_NAME_LEN - 1] = '\0';
+}
+
+SemaphoreHandle_t lock_profile_attach(lock_profile_t *profile, const char *name, SemaphoreHandle_t mutex)
+{
+    if (!mutex) {
+        return NULL;
+    }
+    profile->name = name;
+    /* Components are re-initialized in tests; a record is listed once and keeps counting */
+    if (!profile->listed) {
+        profile->listed = true;
+        profile->next = __atomic_load_n(&s_profiles, __ATOMIC_RELAXED);
+        while (!__atomic_compare_exchange_n(&s_profiles, &profile->next, profile, true, __ATOMIC_RELEASE,
+                                            __ATOMIC_RELAXED)) {
+        }
+    }
+    return mutex;
+}
+
+BaseType_t lock_profile_take(lock_profile_t *profile, SemaphoreHandle_t mutex)
+{
+    uint32_t wait_us = 0;
+    bool contended = false;
+    TaskHandle_t holder = NULL;
+    if (xSemaphoreTake(mutex, 0) != pdTRUE) {
+        contended = true;
+        holder = xSemaphoreGetMutexHolder(mutex);
+        uint32_t start = now_us();
+        xSemaphoreTake(mutex, portMAX_DELAY);
+        wait_us = now_us() - start;
+    }
+
+    /* The record belongs to whoever holds the mutex */
+    profile->acquisitions++;
+    profile->wait_hist[bucket_of(wait_us)]++;
+    if (contended) {
+        profile->contended++;
+        if (wait_us >= profile->wait_max_us) {
+            profile->wait_max_us = wait_us;
+            copy_name(profile->wait_max_waiter, NULL);
+            /* The holder may have given the lock between the two takes */
+            if (holder) {
+                copy_name(profile->wait_max_holder, holder);
+            } else {
+                strcpy(profile->wait_max_holder, "?");
+            }
+        }
+    }
+    profile->taken_at_us = now_us();
+    return pdTRUE;
+}
+
+BaseType_t lock_profile_give(lock_profile_t *profile, SemaphoreHandle_t mutex)
+{
+    uint32_t hold_us = now_us() - profile->taken_at_us;
+    profile->hold_hist[bucket_of(hold_us)]++;
+    if (hold_us > profile->hold_max_us) {
+        profile->hold_max_us = hold_us;
+        copy_name(profile->hold_max_owner, NULL);
+    }
+    return xSemaphoreGive(mutex);
+}
+
+const lock_profile_t *lock_profile_next(const lock_profile_t *profile)
+{
+    return profile ? profile->next : __atomic_load_n(&s_profiles, __ATOMIC_ACQUIRE);
+}
+
+const lock_profile_t *lock_profile_find(const char *name)
+{
+    for (const lock_profile_t *p = lock_profile_next(NULL); p; p = lock_profile_next(p)) {
+        if (strcmp(p->name, name) == 0) {
+            return p;
+        }
+    }
+    return NULL;
+}
+
+void lock_profile_reset(void)
+{
+    for (lock_profile_t *p = __atomic_load_n(&s_profiles, __ATOMIC_ACQUIRE); p; p = p->next) {
+        p->acquisitions = 0;
+        p->contended = 0;
+        memset(p->wait_hist, 0, sizeof(p->wait_hist));
+        memset(p->hold_hist, 0, sizeof(p->hold_hist));
+        p->wait_max_us = 0;
+        p->wait_max_waiter[0] = '\0';
+        p->wait_max_holder[0] = '\0';
+        p->hold_max_us = 0;
+        p->hold_max_owner[0] = '\0';
+    }
+}
+
+static void print_hist(const char *label, const uint32_t *hist)
+{
+    printf("    %-5s", label);
+    for (size_t i = 0; i < LOCK_PROFILE_BUCKETS; i++) {
+        printf(" %8" PRIu32, hist[i]);
+    }
+    printf("\n");
+}
+
+static int locks_cmd(int argc, char **argv)
+{
+    if (argc > 1 && strcmp(argv[1], "reset") == 0) {
+        lock_profile_reset();
+        return 0;
+    }
+    if (!lock_profile_next(NULL)) {
+        printf("No profiled locks (CONFIG_GARAGE_LOCK_PROFILE is off)\n");
+        return 0;
+    }
+
+    for (const lock_profile_t *p = lock_profile_next(NULL); p; p = lock_profile_next(p)) {
+        printf("%s: %" PRIu32 " taken, %" PRIu32 " contended\n", p->name, p->acquisitions, p->contended);
+        printf("    longest hold %" PRIu32 " us by %s", p->hold_max_us, p->hold_max_owner[0] ? p->hold_max_owner : "-");
+        if (p->contended) {
+            printf(", longest wait %" PRIu32 " us: %s behind %s", p->wait_max_us, p->wait_max_waiter,
+                   p->wait_max_holder);
+        }
+        printf("\n    %-5s %8s %8s %8s %8s %8s %8s\n", "", "<10us", "<100us", "<1ms", "<10ms", "<100ms", "longer");
+        print_hist("wait", p->wait_hist);
+        print_hist("hold", p->hold_hist);
+    }
+    return 0;
+}
+
+esp_err_t lock_profile_register_console_command(void)
+{
+    const esp_console_cmd_t cmd = {
+        .command = "locks",
+        .help = "Mutex acquisitions, contention, wait and hold times, or 'locks reset'",
+        .hint = "[reset]",
+        .func = &locks_cmd,
+    };
+    return esp_console_cmd_register(&cmd);
+}
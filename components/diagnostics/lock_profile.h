@@ -0,0 +1,77 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "sdkconfig.h"
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Mutex profiling behind CONFIG_GARAGE_LOCK_PROFILE.
+ *
+ * Components take and give the mutexes they define with STATIC_MUTEX_DEFINE()
+ * through LOCK_TAKE()/LOCK_GIVE(). With the option off those are plain
+ * xSemaphoreTake(portMAX_DELAY)/xSemaphoreGive(). With it on, every such
+ * mutex has a record named "<TAG>/<variable>" holding acquisitions, contended
+ * acquisitions, wait and hold time histograms, the longest hold with the task
+ * that held it, and the longest wait with both the waiter and the task that
+ * held the lock meanwhile: a high-priority waiter behind a low-priority holder
+ * is a priority inversion. Records are only written while their mutex is
+ * held, so they need no lock of their own. 'locks' on the console prints them.
+ */
+
+#define LOCK_PROFILE_BUCKETS   6  /* <10 us, <100 us, <1 ms, <10 ms, <100 ms, longer */
+#define LOCK_PROFILE_NAME_LEN 16  /* configMAX_TASK_NAME_LEN */
+
+typedef struct lock_profile {
+    const char *name;
+    uint32_t acquisitions;
+    uint32_t contended;
+    uint32_t wait_hist[LOCK_PROFILE_BUCKETS];
+    uint32_t hold_hist[LOCK_PROFILE_BUCKETS];
+    uint32_t wait_max_us;
+    char wait_max_waiter[LOCK_PROFILE_NAME_LEN];
+    char wait_max_holder[LOCK_PROFILE_NAME_LEN];
+    uint32_t hold_max_us;
+    char hold_max_owner[LOCK_PROFILE_NAME_LEN];
+    uint32_t taken_at_us;
+    struct lock_profile *next;
+    bool listed;
+} lock_profile_t;
+
+#if CONFIG_GARAGE_LOCK_PROFILE
+
+#define LOCK_PROFILE_DEFINE(name)         static lock_profile_t name##_profile
+#define LOCK_PROFILE_ATTACH(name, handle) lock_profile_attach(&name##_profile, TAG "/" #name, (handle))
+#define LOCK_TAKE(name)                   lock_profile_take(&name##_profile, (name))
+#define LOCK_GIVE(name)                   lock_profile_give(&name##_profile, (name))
+
+#else
+
+#define LOCK_PROFILE_DEFINE(name)         extern int name##_profile_unused_
+#define LOCK_PROFILE_ATTACH(name, handle) (handle)
+#define LOCK_TAKE(name)                   xSemaphoreTake((name), portMAX_DELAY)
+#define LOCK_GIVE(name)                   xSemaphoreGive(name)
+
+#endif
+
+/* Lists the record on first use; returns the handle so creation stays one expression */
+SemaphoreHandle_t lock_profile_attach(lock_profile_t *profile, const char *name, SemaphoreHandle_t mutex);
+BaseType_t lock_profile_take(lock_profile_t *profile, SemaphoreHandle_t mutex);
+BaseType_t lock_profile_give(lock_profile_t *profile, SemaphoreHandle_t mutex);
+
+/* Walk the records: pass NULL for the first */
+const lock_profile_t *lock_profile_next(const lock_profile_t *profile);
+const lock_profile_t *lock_profile_find(const char *name);
+/* Counters of a lock in use at the time may be off by the acquisition in progress */
+void lock_profile_reset(void);
+esp_err_t lock_profile_register_console_command(void);
+
+#ifdef __cplusplus
+}
+#endif
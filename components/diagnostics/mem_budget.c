@@ -0,0 +1,196 @@
+#include "mem_budget.h"
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include "esp_console.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_system.h"
+
+#define TAG "mem_budget"
+
+typedef struct {
+    const char *component;
+    size_t static_bytes;
+} component_entry_t;
+
+typedef struct {
+    const char *component;
+    TaskHandle_t task;
+    uint32_t stack_bytes;
+} task_entry_t;
+
+static component_entry_t s_components[MEM_BUDGET_MAX_COMPONENTS];
+static size_t s_component_count = 0;
+static task_entry_t s_tasks[MEM_BUDGET_MAX_TASKS];
+static size_t s_task_count = 0;
+static TaskHandle_t s_exempt[MEM_BUDGET_MAX_EXEMPT];
+static size_t s_exempt_count = 0;
+
+static volatile bool s_sealed = false;
+static size_t s_free_at_seal = 0;
+static volatile uint32_t s_allocs_after_seal = 0;
+static volatile size_t s_last_alloc_size = 0;
+static void *volatile s_last_alloc_caller = NULL;
+
+static component_entry_t *find_component(const char *component)
+{
+    for (size_t i = 0; i < s_component_count; i++) {
+        if (strcmp(s_components[i].component, component) == 0) {
+            return &s_components[i];
+        }
+    }
+    if (s_component_count >= MEM_BUDGET_MAX_COMPONENTS) {
+        return NULL;
+    }
+    s_components[s_component_count].component = component;
+    s_components[s_component_count].static_bytes = 0;
+    return &s_components[s_component_count++];
+}
+
+esp_err_t mem_budget_register_static(const char *component, size_t bytes)
+{
+    if (!component) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    component_entry_t *entry = find_component(component);
+    if (!entry) {
+        return ESP_ERR_NO_MEM;
+    }
+    entry->static_bytes = bytes;
+    return ESP_OK;
+}
+
+esp_err_t mem_budget_register_task(const char *component, TaskHandle_t task, uint32_t stack_bytes)
+{
+    if (!component || !task) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_task_count >= MEM_BUDGET_MAX_TASKS || !find_component(component)) {
+        return ESP_ERR_NO_MEM;
+    }
+    s_tasks[s_task_count].component = component;
+    s_tasks[s_task_count].task = task;
+    s_tasks[s_task_count].stack_bytes = stack_bytes;
+    s_task_count++;
+    return ESP_OK;
+}
+
+void mem_budget_unregister_task(TaskHandle_t task)
+{
+    for (size_t i = 0; i < s_task_count; i++) {
+        if (s_tasks[i].task == task) {
+            s_tasks[i] = s_tasks[--s_task_count];
+            return;
+        }
+    }
+}
+
+uint32_t mem_budget_task_stack_bytes(TaskHandle_t task)
+{
+    for (size_t i = 0; i < s_task_count; i++) {
+        if (s_tasks[i].task == task) {
+            return s_tasks[i].stack_bytes;
+        }
+    }
+    return 0;
+}
+
+esp_err_t mem_budget_exempt_task(TaskHandle_t task)
+{
+    if (!task) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_exempt_count >= MEM_BUDGET_MAX_EXEMPT) {
+        return ESP_ERR_NO_MEM;
+    }
+    s_exempt[s_exempt_count++] = task;
+    return ESP_OK;
+}
+
+void mem_budget_seal(void)
+{
+    s_free_at_seal = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+    s_sealed = true;
+#if !CONFIG_HEAP_USE_HOOKS
+    ESP_LOGW(TAG, "CONFIG_HEAP_USE_HOOKS disabled: allocations after init are not tracked");
+#endif
+}
+
+uint32_t mem_budget_allocs_after_seal(void)
+{
+    return s_allocs_after_seal;
+}
+
+#if CONFIG_HEAP_USE_HOOKS
+/* Called by the heap allocator for every successful allocation; must not allocate or block */
+void esp_heap_trace_alloc_hook(void *ptr, size_t size, uint32_t caps)
+{
+    if (!s_sealed || xPortInIsrContext()) {
+        return;
+    }
+    TaskHandle_t current = xTaskGetCurrentTaskHandle();
+    for (size_t i = 0; i < s_exempt_count; i++) {
+        if (s_exempt[i] == current) {
+            return;
+        }
+    }
+    s_allocs_after_seal++;
+    s_last_alloc_size = size;
+    s_last_alloc_caller = __builtin_return_address(0);
+#if CONFIG_GARAGE_HEAP_FREEZE_ABORT
+    esp_system_abort("heap allocation after init");
+#endif
+}
+#endif
+
+void mem_budget_report(void)
+{
+    printf("%-14s %8s  %s\n", "component", "static", "tasks (stack / min free)");
+    for (size_t c = 0; c < s_component_count; c++) {
+        printf("%-14s %8u ", s_components[c].component, (unsigned)s_components[c].static_bytes);
+        for (size_t t = 0; t < s_task_count; t++) {
+            if (strcmp(s_tasks[t].component, s_components[c].component) != 0) {
+                continue;
+            }
+            /* ESP-IDF reports the high-water mark in bytes */
+            printf(" %s %" PRIu32 "/%u", pcTaskGetName(s_tasks[t].task), s_tasks[t].stack_bytes,
+                   (unsigned)uxTaskGetStackHighWaterMark(s_tasks[t].task));
+        }
+        printf("\n");
+    }
+
+    size_t total = heap_caps_get_total_size(MALLOC_CAP_8BIT);
+    size_t free_now = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+    size_t min_free = heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT);
+    printf("heap: total %u free %u min_free %u peak_used %u largest_block %u\n", (unsigned)total,
+           (unsigned)free_now, (unsigned)min_free, (unsigned)(total - min_free),
+           (unsigned)heap_caps_get_largest_free_block(MALLOC_CAP_8BIT));
+
+    if (s_sealed) {
+        printf("after init: %" PRIu32 " allocs, free delta %d", s_allocs_after_seal,
+               (int)free_now - (int)s_free_at_seal);
+        if (s_allocs_after_seal) {
+            printf(", last %u bytes from %p", (unsigned)s_last_alloc_size, s_last_alloc_caller);
+        }
+        printf("\n");
+    }
+}
+
+static int mem_cmd(int argc, char **argv)
+{
+    mem_budget_report();
+    return 0;
+}
+
+esp_err_t mem_budget_register_console_command(void)
+{
+    const esp_console_cmd_t cmd = {
+        .command = "mem",
+        .help = "Print the RAM budget: static kernel objects, stack high-water marks, heap",
+        .hint = NULL,
+        .func = &mem_cmd,
+    };
+    return esp_console_cmd_register(&cmd);
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Per-component RAM budget: statically reserved kernel object storage, task
+ * stack sizes with high-water marks, and heap usage since boot. After
+ * mem_budget_seal() (end of init) every heap allocation is counted, and with
+ * CONFIG_GARAGE_HEAP_FREEZE_ABORT it aborts, so fragmentation cannot grow
+ * during long uptimes. Requires CONFIG_HEAP_USE_HOOKS for the allocation check.
+ */
+
+#define MEM_BUDGET_MAX_COMPONENTS 12
+#define MEM_BUDGET_MAX_TASKS      8
+#define MEM_BUDGET_MAX_EXEMPT     2
+
+/* Sets (not adds) the component's static bytes, so re-init does not double count */
+esp_err_t mem_budget_register_static(const char *component, size_t bytes);
+esp_err_t mem_budget_register_task(const char *component, TaskHandle_t task, uint32_t stack_bytes);
+/* Must be called before the task is deleted */
+void mem_budget_unregister_task(TaskHandle_t task);
+/* Stack size the task was registered with; 0 if it was not */
+uint32_t mem_budget_task_stack_bytes(TaskHandle_t task);
+esp_err_t mem_budget_exempt_task(TaskHandle_t task);
+void mem_budget_seal(void);
+uint32_t mem_budget_allocs_after_seal(void);
+void mem_budget_report(void);
+esp_err_t mem_budget_register_console_command(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,204 @@
+#include "metrics.h"
+#include <stdio.h>
+#include <string.h>
+
+#define FNV_OFFSET 2166136261u
+#define FNV_PRIME  16777619u
+
+/* Sorted by group name; only modified from constructors before the scheduler starts */
+static metrics_group_t *s_groups = NULL;
+
+static uint32_t fnv1a(uint32_t hash, const char *str)
+{
+    while (*str) {
+        hash ^= (uint8_t)*str++;
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+void metrics_register(metrics_group_t *group)
+{
+    if (!group) {
+        return;
+    }
+
+    metrics_group_t **link = &s_groups;
+    while (*link) {
+        if (*link == group) {
+            return;
+        }
+        if (strcmp((*link)->name, group->name) > 0) {
+            break;
+        }
+        link = &(*link)->next;
+    }
+    group->next = *link;
+    *link = group;
+}
+
+const metrics_group_t *metrics_first_group(void)
+{
+    return s_groups;
+}
+
+size_t metrics_count(void)
+{
+    size_t count = 0;
+    for (const metrics_group_t *g = s_groups; g; g = g->next) {
+        count += g->count;
+    }
+    return count;
+}
+
+uint32_t metrics_schema_hash(void)
+{
+    uint32_t hash = FNV_OFFSET;
+    for (const metrics_group_t *g = s_groups; g; g = g->next) {
+        for (size_t i = 0; i < g->count; i++) {
+            hash = fnv1a(hash, g->name);
+            hash = fnv1a(hash, ".");
+            hash = fnv1a(hash, g->descs[i].name);
+            hash = fnv1a(hash, g->descs[i].kind == METRIC_GAUGE ? ":g;" : ":c;");
+        }
+    }
+    return hash;
+}
+
+size_t metrics_snapshot_text(char *buf, size_t len)
+{
+    if (!buf || len == 0) {
+        return 0;
+    }
+
+    size_t used = 0;
+    buf[0] = '\0';
+    for (const metrics_group_t *g = s_groups; g; g = g->next) {
+        for (size_t i = 0; i < g->count; i++) {
+            uint32_t value = __atomic_load_n(&g->values[i], __ATOMIC_RELAXED);
+            int n = snprintf(buf + used, len - used, "%s.%s %lu\n", g->name, g->descs[i].name,
+                             (unsigned long)value);
+            if (n < 0 || (size_t)n >= len - used) {
+                /* Drop the partial line */
+                buf[used] = '\0';
+                return used;
+            }
+            used += (size_t)n;
+        }
+    }
+    return used;
+}
+
+static void put_u16(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void put_u32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+/*
+ * Binary layout (little endian):
+ *   u8 version, u8 reserved, u16 count, u32 schema hash, u32 value[count]
+ * Values follow the order of the text snapshot; the schema hash identifies it.
+ */
+size_t metrics_snapshot_binary(uint8_t *buf, size_t len)
+{
+    size_t count = metrics_count();
+    size_t needed = 8 + count * 4;
+    if (!buf || len < needed || count > UINT16_MAX) {
+        return 0;
+    }
+
+    buf[0] = METRICS_BINARY_VERSION;
+    buf[1] = 0;
+    put_u16(&buf[2], (uint16_t)count);
+    put_u32(&buf[4], metrics_schema_hash());
+
+    uint8_t *p = &buf[8];
+    for (const metrics_group_t *g = s_groups; g; g = g->next) {
+        for (size_t i = 0; i < g->count; i++) {
+            put_u32(p, __atomic_load_n(&g->values[i], __ATOMIC_RELAXED));
+            p += 4;
+        }
+    }
+    return needed;
+}
+
+size_t metrics_read_binary(uint32_t *offset, uint8_t *buf, size_t len)
+{
+    size_t count = metrics_count();
+    size_t used = 0;
+    if (*offset == 0) {
+        if (!buf || len < 8 || count > UINT16_MAX) {
+            return 0;
+        }
+        buf[0] = METRICS_BINARY_VERSION;
+        buf[1] = 0;
+        put_u16(&buf[2], (uint16_t)count);
+        put_u32(&buf[4], metrics_schema_hash());
+        used = 8;
+    }
+
+    size_t skip = (*offset == 0) ? 0 : (*offset - 8) / 4;
+    size_t index = 0;
+    for (const metrics_group_t *g = s_groups; g && len - used >= 4; g = g->next) {
+        for (size_t i = 0; i < g->count && len - used >= 4; i++, index++) {
+            if (index >= skip) {
+                put_u32(&buf[used], __atomic_load_n(&g->values[i], __ATOMIC_RELAXED));
+                used += 4;
+            }
+        }
+    }
+    *offset += used;
+    return used;
+}
+
+esp_err_t metrics_read_schema(uint32_t *index, char *buf, size_t len, size_t *out_len)
+{
+    size_t used = 0;
+    size_t n = 0;
+    for (const metrics_group_t *g = s_groups; g; g = g->next) {
+        for (size_t i = 0; i < g->count; i++, n++) {
+            if (n < *index) {
+                continue;
+            }
+            /* Whole entries only, without a terminator */
+            size_t group_len = strlen(g->name);
+            size_t name_len = strlen(g->descs[i].name);
+            if (group_len + name_len + 4 > len - used) {
+                /* Ending here with nothing written would read as the end of the stream */
+                *out_len = used;
+                return used > 0 ? ESP_OK : ESP_ERR_INVALID_SIZE;
+            }
+            memcpy(&buf[used], g->name, group_len);
+            used += group_len;
+            buf[used++] = '.';
+            memcpy(&buf[used], g->descs[i].name, name_len);
+            used += name_len;
+            buf[used++] = ':';
+            buf[used++] = (g->descs[i].kind == METRIC_GAUGE) ? 'g' : 'c';
+            buf[used++] = ';';
+            (*index)++;
+        }
+    }
+    *out_len = used;
+    return ESP_OK;
+}
+
+void metrics_reset(void)
+{
+    for (const metrics_group_t *g = s_groups; g; g = g->next) {
+        for (size_t i = 0; i < g->count; i++) {
+            if (g->descs[i].kind == METRIC_COUNTER) {
+                __atomic_store_n(&g->values[i], 0, __ATOMIC_RELAXED);
+            }
+        }
+    }
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Static runtime metrics registry.
+ *
+ * Each component declares its metrics once with an X-macro list and
+ * METRICS_GROUP_DEFINE(); the group registers itself before app_main() via a
+ * constructor, so no init call and no heap are needed. Updates are relaxed
+ * atomic operations and are safe from tasks, esp_timer callbacks and ISRs.
+ *
+ *     #define RELAY_METRICS(X) \
+ *         X(COUNTER, pulses)   \
+ *         X(COUNTER, rejected)
+ *     METRICS_GROUP_DEFINE(relay, RELAY_METRICS)
+ *
+ *     METRIC_INC(pulses);
+ *
+ * One group per translation unit.
+ */
+
+typedef enum {
+    METRIC_COUNTER = 0,
+    METRIC_GAUGE = 1
+} metric_kind_t;
+
+typedef struct {
+    const char *name;
+    metric_kind_t kind;
+} metric_desc_t;
+
+typedef struct metrics_group {
+    const char *name;
+    const metric_desc_t *descs;
+    uint32_t *values;
+    size_t count;
+    struct metrics_group *next;
+} metrics_group_t;
+
+#define METRICS_BINARY_VERSION 1
+
+#define METRICS_ID_ENTRY_(kind, name)   metric_id_##name,
+#define METRICS_DESC_ENTRY_(kind, name) {#name, METRIC_##kind},
+
+#define METRICS_GROUP_DEFINE(group, LIST)                                          \
+    enum { LIST(METRICS_ID_ENTRY_) group##_metrics_count_ };                       \
+    static const metric_desc_t s_metrics_descs[] = {LIST(METRICS_DESC_ENTRY_)};    \
+    static uint32_t s_metrics_values[group##_metrics_count_];                      \
+    static metrics_group_t s_metrics = {                                           \
+        .name = #group,                                                            \
+        .descs = s_metrics_descs,                                                  \
+        .values = s_metrics_values,                                                \
+        .count = group##_metrics_count_,                                           \
+        .next = NULL,                                                              \
+    };                                                                             \
+    __attribute__((constructor)) static void group##_metrics_register_(void)       \
+    {                                                                              \
+        metrics_register(&s_metrics);                                              \
+    }
+
+#define METRIC_ADD(name, n) __atomic_fetch_add(&s_metrics_values[metric_id_##name], (uint32_t)(n), __ATOMIC_RELAXED)
+#define METRIC_INC(name)    METRIC_ADD(name, 1)
+#define METRIC_SET(name, v) __atomic_store_n(&s_metrics_values[metric_id_##name], (uint32_t)(v), __ATOMIC_RELAXED)
+#define METRIC_GET(name)    __atomic_load_n(&s_metrics_values[metric_id_##name], __ATOMIC_RELAXED)
+
+void metrics_register(metrics_group_t *group);
+const metrics_group_t *metrics_first_group(void);
+size_t metrics_count(void);
+uint32_t metrics_schema_hash(void);
+size_t metrics_snapshot_text(char *buf, size_t len);
+size_t metrics_snapshot_binary(uint8_t *buf, size_t len);
+/*
+ * Chunked forms for streaming (see diag_export.h); both start with a cursor
+ * of 0 and yield 0 bytes once done. The binary one yields the bytes of
+ * metrics_snapshot_binary() with whole values per chunk, the schema one the
+ * "group.name:c;" / ":g;" entries that metrics_schema_hash() hashes, or
+ * ESP_ERR_INVALID_SIZE when the next entry is longer than the whole buffer.
+ */
+size_t metrics_read_binary(uint32_t *offset, uint8_t *buf, size_t len);
+esp_err_t metrics_read_schema(uint32_t *index, char *buf, size_t len, size_t *out_len);
+void metrics_reset(void);
+esp_err_t metrics_register_console_command(void);
+
+#ifdef __cplusplus
+}
+#endif
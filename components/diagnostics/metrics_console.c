@@ -0,0 +1,50 @@
+#include "metrics.h"
+#include <stdio.h>
+#include <string.h>
+#include "esp_console.h"
+
+#define METRICS_BINARY_CHUNK_SIZE 64
+
+/* Console commands run one at a time on the REPL task */
+static uint8_t s_binary_buf[METRICS_BINARY_CHUNK_SIZE];
+
+static int metrics_cmd(int argc, char **argv)
+{
+    if (argc > 1 && strcmp(argv[1], "-b") == 0) {
+        uint32_t offset = 0;
+        size_t len;
+        while ((len = metrics_read_binary(&offset, s_binary_buf, sizeof(s_binary_buf))) > 0) {
+            for (size_t i = 0; i < len; i++) {
+                printf("%02x", s_binary_buf[i]);
+            }
+        }
+        printf("\n");
+        return 0;
+    }
+
+    if (argc > 1 && strcmp(argv[1], "reset") == 0) {
+        metrics_reset();
+        return 0;
+    }
+
+    /* A line at a time: no buffer to outgrow as groups are added */
+    printf("# schema %08lx\n", (unsigned long)metrics_schema_hash());
+    for (const metrics_group_t *g = metrics_first_group(); g; g = g->next) {
+        for (size_t i = 0; i < g->count; i++) {
+            printf("%s.%s %lu\n", g->name, g->descs[i].name,
+                   (unsigned long)__atomic_load_n(&g->values[i], __ATOMIC_RELAXED));
+        }
+    }
+    return 0;
+}
+
+esp_err_t metrics_register_console_command(void)
+{
+    const esp_console_cmd_t cmd = {
+        .command = "metrics",
+        .help = "Print runtime metrics: 'metrics' (text), 'metrics -b' (binary, hex), 'metrics reset'",
+        .hint = "[-b|reset]",
+        .func = &metrics_cmd,
+    };
+    return esp_console_cmd_register(&cmd);
+}
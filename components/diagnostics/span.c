@@ -0,0 +1,298 @@
+#include "span.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include "esp_console.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#ifndef CONFIG_GARAGE_SPAN_RING_SIZE
+#define CONFIG_GARAGE_SPAN_RING_SIZE 256
+#endif
+
+#define RING_SIZE CONFIG_GARAGE_SPAN_RING_SIZE
+#define RING_MASK (RING_SIZE - 1)
+
+_Static_assert((RING_SIZE & RING_MASK) == 0, "CONFIG_GARAGE_SPAN_RING_SIZE must be a power of two");
+
+static const char *const s_span_names[] = {
+    [SPAN_MATTER_COMMAND] = "MATTER_COMMAND",
+    [SPAN_DOOR_COMMAND] = "DOOR_COMMAND",
+    [SPAN_DOOR_LOCK] = "DOOR_LOCK",
+    [SPAN_DOOR_STATE] = "DOOR_STATE",
+    [SPAN_RELAY_ACTIVATE] = "RELAY_ACTIVATE",
+    [SPAN_RELAY_RELEASE] = "RELAY_RELEASE",
+    [SPAN_NVS_COMMIT] = "NVS_COMMIT",
+    [SPAN_MATTER_REPORT] = "MATTER_REPORT",
+};
+
+#define SPAN_COUNT (sizeof(s_span_names) / sizeof(s_span_names[0]))
+
+static const char s_phase_chars[] = {
+    [SPAN_PHASE_BEGIN] = 'B',
+    [SPAN_PHASE_END] = 'E',
+    [SPAN_PHASE_MARK] = 'M',
+};
+
+/*
+ * Tasks are looked up by handle. A task claims a slot with fetch-add on its
+ * first record, fills it and publishes it with 'ready'; only the owning task
+ * writes its correlation ID afterwards. The name is copied at claim time, so
+ * the dump still names a task that has since been deleted.
+ */
+typedef struct {
+    TaskHandle_t handle;
+    uint16_t corr;
+    bool ready;
+    char name[SPAN_TASK_NAME_LEN];
+} span_task_t;
+
+static span_task_t s_task_table[SPAN_MAX_TASKS];
+static uint32_t s_task_count = 0;
+
+#if CONFIG_GARAGE_SPAN_ENABLE
+/* Same overwriting ring as trace.c: seq 0 while a writer fills the slot, index + 1 once published */
+typedef struct {
+    uint32_t seq;
+    span_record_t rec;
+} span_slot_t;
+
+static span_slot_t s_ring[RING_SIZE];
+static uint32_t s_head = 0;
+static uint32_t s_base = 0; /* First index still reported after span_clear() */
+static uint16_t s_next_corr = 0;
+
+/* NULL once the table is full: that task's records carry SPAN_TASK_NONE and correlation ID 0 */
+static span_task_t *current_task(void)
+{
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    uint32_t count = __atomic_load_n(&s_task_count, __ATOMIC_ACQUIRE);
+    if (count > SPAN_MAX_TASKS) {
+        count = SPAN_MAX_TASKS;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        span_task_t *t = &s_task_table[i];
+        if (__atomic_load_n(&t->ready, __ATOMIC_ACQUIRE) && t->handle == self) {
+            return t;
+        }
+    }
+    if (count >= SPAN_MAX_TASKS) {
+        return NULL;
+    }
+
+    uint32_t index = __atomic_fetch_add(&s_task_count, 1, __ATOMIC_RELAXED);
+    if (index >= SPAN_MAX_TASKS) {
+        return NULL;
+    }
+    span_task_t *t = &s_task_table[index];
+    t->handle = self;
+    t->corr = 0;
+    strncpy(t->name, pcTaskGetName(self), sizeof(t->name) - 1);
+    t->name[sizeof(t->name) - 1] = '\0';
+    __atomic_store_n(&t->ready, true, __ATOMIC_RELEASE);
+    return t;
+}
+
+void span_record(span_id_t id, span_phase_t phase)
+{
+    uint32_t timestamp_us = (uint32_t)esp_timer_get_time();
+    span_task_t *task = current_task();
+    uint32_t index = __atomic_fetch_add(&s_head, 1, __ATOMIC_RELAXED);
+    span_slot_t *slot = &s_ring[index & RING_MASK];
+
+    __atomic_store_n(&slot->seq, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    slot->rec.timestamp_us = timestamp_us;
+    slot->rec.corr = task ? task->corr : 0;
+    slot->rec.id = (uint8_t)id;
+    slot->rec.phase = (uint8_t)phase;
+    slot->rec.task = task ? (uint8_t)(task - s_task_table) : SPAN_TASK_NONE;
+    __atomic_store_n(&slot->seq, index + 1, __ATOMIC_RELEASE);
+}
+
+uint16_t span_corr_enter(void)
+{
+    span_task_t *task = current_task();
+    if (!task) {
+        return 0;
+    }
+    uint16_t prev = task->corr;
+    if (prev == 0) {
+        uint16_t corr;
+        do {
+            corr = __atomic_add_fetch(&s_next_corr, 1, __ATOMIC_RELAXED);
+        } while (corr == 0);
+        task->corr = corr;
+    }
+    return prev;
+}
+
+uint16_t span_corr_get(void)
+{
+    span_task_t *task = current_task();
+    return task ? task->corr : 0;
+}
+
+void span_corr_set(uint16_t corr)
+{
+    span_task_t *task = current_task();
+    if (task) {
+        task->corr = corr;
+    }
+}
+
+static bool read_slot(uint32_t index, span_record_t *out)
+{
+    const span_slot_t *slot = &s_ring[index & RING_MASK];
+    if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != index + 1) {
+        return false;
+    }
+    *out = slot->rec;
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&slot->seq, __ATOMIC_RELAXED) == index + 1;
+}
+
+static uint32_t first_retained(uint32_t head)
+{
+    uint32_t base = __atomic_load_n(&s_base, __ATOMIC_RELAXED);
+    return (head - base > RING_SIZE) ? head - RING_SIZE : base;
+}
+
+size_t span_snapshot(span_record_t *out, size_t max)
+{
+    uint32_t head = __atomic_load_n(&s_head, __ATOMIC_ACQUIRE);
+    size_t count = 0;
+    for (uint32_t i = first_retained(head); i != head && count < max; i++) {
+        if (read_slot(i, &out[count])) {
+            count++;
+        }
+    }
+    return count;
+}
+
+void span_clear(void)
+{
+    __atomic_store_n(&s_base, __atomic_load_n(&s_head, __ATOMIC_ACQUIRE), __ATOMIC_RELEASE);
+}
+
+uint32_t span_overwritten(void)
+{
+    uint32_t head = __atomic_load_n(&s_head, __ATOMIC_ACQUIRE);
+    return first_retained(head) - __atomic_load_n(&s_base, __ATOMIC_RELAXED);
+}
+
+void span_dump(void)
+{
+    char line[SPAN_LINE_MAX];
+    span_record_t rec;
+    uint32_t head = __atomic_load_n(&s_head, __ATOMIC_ACQUIRE);
+    uint32_t first = first_retained(head);
+
+    printf("# spans: %" PRIu32 " records, %" PRIu32 " overwritten\n", head - first, span_overwritten());
+    for (uint8_t i = 0; i < SPAN_MAX_TASKS; i++) {
+        const char *name = span_task_name(i);
+        if (name) {
+            printf("# task %u %s\n", i, name);
+        }
+    }
+    for (uint32_t i = first; i != head; i++) {
+        if (read_slot(i, &rec)) {
+            span_format(&rec, line, sizeof(line));
+            printf("%s\n", line);
+        }
+    }
+    printf("# spans end\n");
+}
+#else
+void span_record(span_id_t id, span_phase_t phase)
+{
+}
+
+uint16_t span_corr_enter(void)
+{
+    return 0;
+}
+
+uint16_t span_corr_get(void)
+{
+    return 0;
+}
+
+void span_corr_set(uint16_t corr)
+{
+}
+
+size_t span_snapshot(span_record_t *out, size_t max)
+{
+    return 0;
+}
+
+void span_clear(void)
+{
+}
+
+uint32_t span_overwritten(void)
+{
+    return 0;
+}
+
+void span_dump(void)
+{
+    printf("# spans: disabled (CONFIG_GARAGE_SPAN_ENABLE)\n");
+}
+#endif
+
+const char *span_task_name(uint8_t task)
+{
+    if (task >= SPAN_MAX_TASKS || !__atomic_load_n(&s_task_table[task].ready, __ATOMIC_ACQUIRE)) {
+        return NULL;
+    }
+    return s_task_table[task].name;
+}
+
+const char *span_id_to_string(span_id_t id)
+{
+    if ((size_t)id < SPAN_COUNT && s_span_names[id]) {
+        return s_span_names[id];
+    }
+    return "UNKNOWN";
+}
+
+size_t span_format(const span_record_t *record, char *buf, size_t len)
+{
+    if (!record || !buf || len == 0) {
+        return 0;
+    }
+
+    char phase = record->phase < sizeof(s_phase_chars) ? s_phase_chars[record->phase] : '?';
+    int n = snprintf(buf, len, "S %" PRIu32 " %c %s %u %u", record->timestamp_us, phase,
+                     span_id_to_string((span_id_t)record->id), record->corr, record->task);
+    if (n < 0) {
+        buf[0] = '\0';
+        return 0;
+    }
+    return ((size_t)n < len) ? (size_t)n : len - 1;
+}
+
+static int spans_cmd(int argc, char **argv)
+{
+    if (argc > 1 && strcmp(argv[1], "clear") == 0) {
+        span_clear();
+        return 0;
+    }
+
+    span_dump();
+    return 0;
+}
+
+esp_err_t span_register_console_command(void)
+{
+    const esp_console_cmd_t cmd = {
+        .command = "spans",
+        .help = "Dump command latency spans for tools/span_trace.py, or 'spans clear'",
+        .hint = "[clear]",
+        .func = &spans_cmd,
+    };
+    return esp_console_cmd_register(&cmd);
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "sdkconfig.h"
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Command latency spans.
+ *
+ * A command crosses several components and tasks: Matter handling, the door
+ * state machine, relay arbitration, the state mutex, the NVS commit and the
+ * Matter report. Each of these marks its begin and end with SPAN_BEGIN() /
+ * SPAN_END(), tagged with the correlation ID of the command being served.
+ * Records go to a lock-free RAM ring of their own (the event trace is kept
+ * for replay and must not be evicted by them). The 'spans' console command
+ * dumps it as text and tools/span_trace.py turns a dump into Chrome trace /
+ * Perfetto JSON, one track per task, with the spans of a command linked.
+ *
+ * The correlation ID belongs to the calling task. A command entry point
+ * takes one with SPAN_CORR_ENTER(), which keeps the caller's ID if it is
+ * already serving a command, and restores it with SPAN_CORR_SET() on the
+ * way out. Work deferred to another task (a timer callback, a report task)
+ * carries the ID across with SPAN_CORR_GET() and SPAN_CORR_SET(). Spans are
+ * recorded from tasks and esp_timer callbacks, not from ISRs.
+ *
+ * With CONFIG_GARAGE_SPAN_ENABLE off the macros compile to nothing and every
+ * correlation ID reads as 0.
+ */
+
+typedef enum {
+    SPAN_MATTER_COMMAND = 1, /* Matter command handler, entry to return */
+    SPAN_DOOR_COMMAND = 2,   /* garage_door_open/close/stop */
+    SPAN_DOOR_LOCK = 3,      /* Waiting for the door state mutex */
+    SPAN_DOOR_STATE = 4,     /* State transition: save and state callbacks */
+    SPAN_RELAY_ACTIVATE = 5, /* Arbitration (interval, active pulse) to pin high */
+    SPAN_RELAY_RELEASE = 6,  /* Mark: pulse timer drops the pin */
+    SPAN_NVS_COMMIT = 7,     /* nvs_commit() */
+    SPAN_MATTER_REPORT = 8,  /* Attribute report after a state change */
+} span_id_t;
+
+typedef enum {
+    SPAN_PHASE_BEGIN = 0,
+    SPAN_PHASE_END = 1,
+    SPAN_PHASE_MARK = 2,
+} span_phase_t;
+
+/* Tasks that get a name in the dump; records from later tasks show task SPAN_TASK_NONE */
+#define SPAN_MAX_TASKS 16
+#define SPAN_TASK_NONE 0xFF
+#define SPAN_TASK_NAME_LEN 16 /* configMAX_TASK_NAME_LEN */
+
+typedef struct {
+    uint32_t timestamp_us; /* esp_timer time, wraps after ~71 minutes */
+    uint16_t corr;         /* Correlation ID, 0 outside any command */
+    uint8_t id;            /* span_id_t */
+    uint8_t phase;         /* span_phase_t */
+    uint8_t task;          /* Index into the task table, see span_task_name() */
+} span_record_t;
+
+/* Longest line span_format() produces, including the terminator */
+#define SPAN_LINE_MAX 56
+
+#if CONFIG_GARAGE_SPAN_ENABLE
+#define SPAN_BEGIN(id)         span_record((id), SPAN_PHASE_BEGIN)
+#define SPAN_END(id)           span_record((id), SPAN_PHASE_END)
+#define SPAN_MARK(id)          span_record((id), SPAN_PHASE_MARK)
+#define SPAN_CORR_ENTER()      span_corr_enter()
+#define SPAN_CORR_GET()        span_corr_get()
+#define SPAN_CORR_SET(corr)    span_corr_set(corr)
+#else
+#define SPAN_BEGIN(id)         do { } while (0)
+#define SPAN_END(id)           do { } while (0)
+#define SPAN_MARK(id)          do { } while (0)
+#define SPAN_CORR_ENTER()      ((uint16_t)0)
+#define SPAN_CORR_GET()        ((uint16_t)0)
+#define SPAN_CORR_SET(corr)    do { (void)(corr); } while (0)
+#endif
+
+void span_record(span_id_t id, span_phase_t phase);
+/* Returns the task's current ID, having given it a new one if that was 0 */
+uint16_t span_corr_enter(void);
+uint16_t span_corr_get(void);
+void span_corr_set(uint16_t corr);
+
+/* Copies up to 'max' retained records, oldest first; returns the number copied */
+size_t span_snapshot(span_record_t *out, size_t max);
+void span_clear(void);
+/* Records lost to ring wrap-around since the last clear */
+uint32_t span_overwritten(void);
+/* NULL for SPAN_TASK_NONE or a slot not claimed yet */
+const char *span_task_name(uint8_t task);
+
+/* Text form, one record per line: "S <timestamp_us> <B|E|M> <SPAN> <corr> <task>" */
+size_t span_format(const span_record_t *record, char *buf, size_t len);
+const char *span_id_to_string(span_id_t id);
+
+/* Task names as "# task <index> <name>" lines, then the records */
+void span_dump(void);
+esp_err_t span_register_console_command(void);
+
+#ifdef __cplusplus
+}
+#endif
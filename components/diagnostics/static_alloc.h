@@ -0,0 +1,66 @@
+#pragma once
+
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/event_groups.h"
+#include "lock_profile.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Kernel object allocation that follows CONFIG_GARAGE_STATIC_ALLOCATION.
+ *
+ * STATIC_*_DEFINE() reserves the backing storage at file scope (nothing in
+ * the dynamic build); STATIC_*_CREATE() creates the object from it, or from
+ * the heap in the dynamic build. Stack sizes are in bytes, as everywhere in
+ * ESP-IDF FreeRTOS. Mutexes defined here are taken with LOCK_TAKE/LOCK_GIVE
+ * (lock_profile.h); STATIC_MUTEX_CREATE() needs the file's TAG for the name.
+ */
+
+#if CONFIG_GARAGE_STATIC_ALLOCATION
+
+#define STATIC_TASK_DEFINE(name, stack_bytes)          \
+    static StackType_t name##_stack[(stack_bytes)];     \
+    static StaticTask_t name##_tcb
+
+#define STATIC_TASK_CREATE(name, fn, task_name, arg, prio, handle)                                       \
+    (((*(handle)) = xTaskCreateStatic((fn), (task_name), sizeof(name##_stack), (arg), (prio), name##_stack, \
+                                      &name##_tcb)) != NULL ? pdPASS : pdFAIL)
+
+#define STATIC_MUTEX_DEFINE(name) static StaticSemaphore_t name##_buf; LOCK_PROFILE_DEFINE(name)
+#define STATIC_MUTEX_CREATE(name) LOCK_PROFILE_ATTACH(name, xSemaphoreCreateMutexStatic(&name##_buf))
+
+#define STATIC_EVENT_GROUP_DEFINE(name) static StaticEventGroup_t name##_buf
+#define STATIC_EVENT_GROUP_CREATE(name) xEventGroupCreateStatic(&name##_buf)
+
+/* Bytes reserved at file scope for a task, for the memory budget report */
+#define STATIC_TASK_BYTES(name) (sizeof(name##_stack) + sizeof(name##_tcb))
+#define STATIC_MUTEX_BYTES      sizeof(StaticSemaphore_t)
+#define STATIC_EVENT_GROUP_BYTES sizeof(StaticEventGroup_t)
+
+#else
+
+#define STATIC_TASK_DEFINE(name, stack_bytes) enum { name##_stack_bytes = (stack_bytes) }
+
+#define STATIC_TASK_CREATE(name, fn, task_name, arg, prio, handle) \
+    xTaskCreate((fn), (task_name), name##_stack_bytes, (arg), (prio), (handle))
+
+#define STATIC_MUTEX_DEFINE(name) extern int name##_unused_; LOCK_PROFILE_DEFINE(name)
+#define STATIC_MUTEX_CREATE(name) LOCK_PROFILE_ATTACH(name, xSemaphoreCreateMutex())
+
+#define STATIC_EVENT_GROUP_DEFINE(name) extern int name##_unused_
+#define STATIC_EVENT_GROUP_CREATE(name) xEventGroupCreate()
+
+#define STATIC_TASK_BYTES(name)  0
+#define STATIC_MUTEX_BYTES       0
+#define STATIC_EVENT_GROUP_BYTES 0
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
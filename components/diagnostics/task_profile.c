@@ -0,0 +1,448 @@
+#include "task_profile.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include "freertos/semphr.h"
+#include "esp_console.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "mem_budget.h"
+#include "static_alloc.h"
+
+#define TAG "task_profile"
+
+#ifndef CONFIG_GARAGE_TASK_PROFILE_HISTORY
+#define CONFIG_GARAGE_TASK_PROFILE_HISTORY 12
+#endif
+
+#define HISTORY CONFIG_GARAGE_TASK_PROFILE_HISTORY
+
+#if CONFIG_GARAGE_TASK_PROFILE
+
+typedef struct {
+    TaskHandle_t handle; /* NULL: never used */
+    configRUN_TIME_COUNTER_TYPE run_time; /* At the previous sample */
+    bool warned;
+    task_profile_task_t info;
+} slot_t;
+
+/* ESP-IDF's own tasks are sized by sdkconfig, not registered with mem_budget */
+static const struct {
+    const char *prefix;
+    uint32_t stack_bytes;
+} s_idf_tasks[] = {
+    {"main", CONFIG_ESP_MAIN_TASK_STACK_SIZE},
+    {"esp_timer", CONFIG_ESP_TIMER_TASK_STACK_SIZE},
+    {"IDLE", CONFIG_FREERTOS_IDLE_TASK_STACKSIZE},
+};
+
+static bool s_initialized = false;
+static SemaphoreHandle_t s_mutex = NULL;
+static esp_timer_handle_t s_timer = NULL;
+
+static slot_t s_slots[TASK_PROFILE_MAX_TASKS];
+static TaskStatus_t s_status[TASK_PROFILE_MAX_TASKS];
+static int s_slot_of[TASK_PROFILE_MAX_TASKS]; /* Per s_status entry */
+static task_profile_sample_t s_history[HISTORY];
+static size_t s_head = 0; /* Next sample goes here */
+static size_t s_count = 0;
+static configRUN_TIME_COUNTER_TYPE s_total = 0; /* Total run time at the previous sample */
+static bool s_overflow_logged = false;
+
+STATIC_MUTEX_DEFINE(s_mutex);
+
+static bool is_idle(const char *name)
+{
+    return strncmp(name, "IDLE", 4) == 0;
+}
+
+static uint32_t stack_size_of(TaskHandle_t handle, const char *name)
+{
+    uint32_t bytes = mem_budget_task_stack_bytes(handle);
+    if (bytes) {
+        return bytes;
+    }
+    for (size_t i = 0; i < sizeof(s_idf_tasks) / sizeof(s_idf_tasks[0]); i++) {
+        if (strncmp(name, s_idf_tasks[i].prefix, strlen(s_idf_tasks[i].prefix)) == 0) {
+            return s_idf_tasks[i].stack_bytes;
+        }
+    }
+    return 0;
+}
+
+/* Slot the task had at the previous sample; a reused handle with another name is a new task */
+static int find_slot(const TaskStatus_t *status)
+{
+    for (int i = 0; i < TASK_PROFILE_MAX_TASKS; i++) {
+        if (s_slots[i].handle == status->xHandle &&
+            strncmp(s_slots[i].info.name, status->pcTaskName, TASK_PROFILE_NAME_LEN - 1) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/* A never used slot, else the one of a task gone before this sample. Caller holds s_mutex */
+static int claim_slot(const TaskStatus_t *status, const bool *taken)
+{
+    int slot = -1;
+    for (int i = 0; i < TASK_PROFILE_MAX_TASKS && slot < 0; i++) {
+        slot = s_slots[i].handle ? slot : i;
+    }
+    for (int i = 0; i < TASK_PROFILE_MAX_TASKS && slot < 0; i++) {
+        slot = taken[i] ? slot : i;
+    }
+    if (slot < 0) {
+        return -1;
+    }
+
+    slot_t *s = &s_slots[slot];
+    memset(s, 0, sizeof(*s));
+    s->handle = status->xHandle;
+    snprintf(s->info.name, sizeof(s->info.name), "%s", status->pcTaskName);
+    s->info.stack_bytes = stack_size_of(status->xHandle, status->pcTaskName);
+    s->info.stack_free_min = UINT32_MAX;
+    return slot;
+}
+
+static uint16_t permille(configRUN_TIME_COUNTER_TYPE part, configRUN_TIME_COUNTER_TYPE whole)
+{
+    if (whole == 0) {
+        return 0;
+    }
+    uint64_t p = ((uint64_t)part * 1000 + whole / 2) / whole;
+    return (uint16_t)(p > 1000 ? 1000 : p);
+}
+
+static void timer_callback(void *arg)
+{
+    task_profile_sample();
+}
+
+esp_err_t task_profile_sample(void)
+{
+    if (!s_initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    LOCK_TAKE(s_mutex);
+    configRUN_TIME_COUNTER_TYPE total = 0;
+    UBaseType_t count = 0;
+    if (uxTaskGetNumberOfTasks() <= TASK_PROFILE_MAX_TASKS) {
+        count = uxTaskGetSystemState(s_status, TASK_PROFILE_MAX_TASKS, &total);
+    }
+    if (count == 0) {
+        bool log = !s_overflow_logged;
+        s_overflow_logged = true;
+        LOCK_GIVE(s_mutex);
+        if (log) {
+            ESP_LOGW(TAG, "More than %d tasks, not sampled", TASK_PROFILE_MAX_TASKS);
+        }
+        return ESP_ERR_NO_MEM;
+    }
+
+    /* Match first, so a task that is gone frees its slot for a new one in the same sample */
+    bool taken[TASK_PROFILE_MAX_TASKS] = {false};
+    for (UBaseType_t i = 0; i < count; i++) {
+        s_slot_of[i] = find_slot(&s_status[i]);
+        if (s_slot_of[i] >= 0) {
+            taken[s_slot_of[i]] = true;
+        }
+    }
+    for (UBaseType_t i = 0; i < count; i++) {
+        if (s_slot_of[i] < 0) {
+            s_slot_of[i] = claim_slot(&s_status[i], taken);
+            if (s_slot_of[i] >= 0) {
+                taken[s_slot_of[i]] = true;
+            }
+        }
+    }
+
+    /* Wraps once within TASK_PROFILE_MAX_PERIOD_MS; unsigned differences absorb it */
+    configRUN_TIME_COUNTER_TYPE elapsed = total - s_total;
+    s_total = total;
+    task_profile_sample_t *sample = &s_history[s_head];
+    memset(sample, 0, sizeof(*sample));
+    sample->uptime_s = (uint32_t)(esp_timer_get_time() / 1000000);
+    sample->period_ms = elapsed / 1000;
+
+    configRUN_TIME_COUNTER_TYPE busy = 0;
+    for (int i = 0; i < TASK_PROFILE_MAX_TASKS; i++) {
+        s_slots[i].info.alive = taken[i];
+        s_slots[i].info.cpu_permille = 0;
+    }
+    for (UBaseType_t i = 0; i < count; i++) {
+        const TaskStatus_t *status = &s_status[i];
+        if (s_slot_of[i] < 0) {
+            continue;
+        }
+        slot_t *s = &s_slots[s_slot_of[i]];
+        configRUN_TIME_COUNTER_TYPE ran = status->ulRunTimeCounter - s->run_time;
+        s->run_time = status->ulRunTimeCounter;
+        if (!is_idle(status->pcTaskName)) {
+            busy += ran;
+        }
+
+        task_profile_task_t *info = &s->info;
+        info->priority = status->uxCurrentPriority;
+        info->cpu_permille = permille(ran, elapsed);
+        if (info->cpu_permille > info->cpu_peak_permille) {
+            info->cpu_peak_permille = info->cpu_permille;
+        }
+        if (status->usStackHighWaterMark < info->stack_free_min) {
+            info->stack_free_min = status->usStackHighWaterMark;
+        }
+        sample->task_permille[s_slot_of[i]] = info->cpu_permille;
+        if (strcmp(status->pcTaskName, "esp_timer") == 0) {
+            sample->timer_permille = info->cpu_permille;
+        }
+    }
+    sample->busy_permille = permille(busy, elapsed);
+    sample->heap_free = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+    sample->heap_min_free = heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT);
+    sample->heap_largest_block = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+    s_head = (s_head + 1) % HISTORY;
+    if (s_count < HISTORY) {
+        s_count++;
+    }
+
+    /* Logged once per task, after the lock: ESP_LOG may block on the UART */
+    char low_name[TASK_PROFILE_NAME_LEN] = "";
+    uint32_t low_free = 0;
+    for (int i = 0; i < TASK_PROFILE_MAX_TASKS; i++) {
+        slot_t *s = &s_slots[i];
+        if (s->info.alive && !s->warned && s->info.stack_free_min < TASK_PROFILE_STACK_WARN_BYTES) {
+            s->warned = true;
+            memcpy(low_name, s->info.name, sizeof(low_name));
+            low_free = s->info.stack_free_min;
+            break;
+        }
+    }
+    LOCK_GIVE(s_mutex);
+
+    if (low_name[0]) {
+        ESP_LOGW(TAG, "Task %s down to %" PRIu32 " bytes of free stack", low_name, low_free);
+    }
+    return ESP_OK;
+}
+
+esp_err_t task_profile_init(uint32_t period_ms)
+{
+    if (s_initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (period_ms == 0 || period_ms > TASK_PROFILE_MAX_PERIOD_MS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    memset(s_slots, 0, sizeof(s_slots));
+    memset(s_history, 0, sizeof(s_history));
+    s_head = 0;
+    s_count = 0;
+    s_total = 0;
+    s_overflow_logged = false;
+
+    s_mutex = STATIC_MUTEX_CREATE(s_mutex);
+    if (!s_mutex) {
+        return ESP_ERR_NO_MEM;
+    }
+    const esp_timer_create_args_t timer_args = {
+        .callback = timer_callback,
+        .arg = NULL,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "task_profile",
+    };
+    esp_err_t ret = esp_timer_create(&timer_args, &s_timer);
+    if (ret != ESP_OK) {
+        vSemaphoreDelete(s_mutex);
+        return ret;
+    }
+    ret = esp_timer_start_periodic(s_timer, (uint64_t)period_ms * 1000);
+    if (ret != ESP_OK) {
+        esp_timer_delete(s_timer);
+        vSemaphoreDelete(s_mutex);
+        return ret;
+    }
+
+    mem_budget_register_static(TAG, STATIC_MUTEX_BYTES + sizeof(s_slots) + sizeof(s_status) + sizeof(s_history));
+    s_initialized = true;
+    /* The first sample covers the time since boot */
+    task_profile_sample();
+
+    ESP_LOGI(TAG, "Sampling every %" PRIu32 " ms, %d samples of history", period_ms, HISTORY);
+    return ESP_OK;
+}
+
+esp_err_t task_profile_deinit(void)
+{
+    if (!s_initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    esp_timer_stop(s_timer);
+    esp_timer_delete(s_timer);
+    s_timer = NULL;
+    s_initialized = false;
+    vSemaphoreDelete(s_mutex);
+    s_mutex = NULL;
+    return ESP_OK;
+}
+
+esp_err_t task_profile_get_task(size_t slot, task_profile_task_t *task)
+{
+    if (!task || slot >= TASK_PROFILE_MAX_TASKS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!s_initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    LOCK_TAKE(s_mutex);
+    esp_err_t ret = s_slots[slot].handle ? ESP_OK : ESP_ERR_NOT_FOUND;
+    *task = s_slots[slot].info;
+    LOCK_GIVE(s_mutex);
+    return ret;
+}
+
+esp_err_t task_profile_get_sample(size_t age, task_profile_sample_t *sample)
+{
+    if (!sample) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!s_initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    LOCK_TAKE(s_mutex);
+    esp_err_t ret = ESP_ERR_NOT_FOUND;
+    if (age < s_count) {
+        *sample = s_history[(s_head + HISTORY - 1 - age) % HISTORY];
+        ret = ESP_OK;
+    }
+    LOCK_GIVE(s_mutex);
+    return ret;
+}
+
+static void reset_peaks(void)
+{
+    LOCK_TAKE(s_mutex);
+    for (int i = 0; i < TASK_PROFILE_MAX_TASKS; i++) {
+        s_slots[i].info.cpu_peak_permille = s_slots[i].info.cpu_permille;
+    }
+    LOCK_GIVE(s_mutex);
+}
+
+#else
+
+esp_err_t task_profile_init(uint32_t period_ms)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t task_profile_deinit(void)
+{
+    return ESP_ERR_INVALID_STATE;
+}
+
+esp_err_t task_profile_sample(void)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t task_profile_get_task(size_t slot, task_profile_task_t *task)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t task_profile_get_sample(size_t age, task_profile_sample_t *sample)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+static void reset_peaks(void)
+{
+}
+
+#endif
+
+static void print_permille(uint16_t permille)
+{
+    printf(" %3u.%u", permille / 10, permille % 10);
+}
+
+void task_profile_report(void)
+{
+    task_profile_sample_t sample;
+    if (task_profile_get_sample(0, &sample) != ESP_OK) {
+        printf("No task profile (CONFIG_GARAGE_TASK_PROFILE is off)\n");
+        return;
+    }
+
+    printf("%-16s %4s %6s %6s %6s %8s\n", "task", "prio", "cpu%", "peak%", "stack", "free_min");
+    for (size_t i = 0; i < TASK_PROFILE_MAX_TASKS; i++) {
+        task_profile_task_t task;
+        if (task_profile_get_task(i, &task) != ESP_OK) {
+            continue;
+        }
+        printf("%-16s %4u", task.name, (unsigned)task.priority);
+        print_permille(task.cpu_permille);
+        print_permille(task.cpu_peak_permille);
+        if (task.stack_bytes) {
+            printf(" %6" PRIu32, task.stack_bytes);
+        } else {
+            printf(" %6s", "-");
+        }
+        printf(" %8" PRIu32 "%s\n", task.stack_free_min, task.alive ? "" : " (deleted)");
+    }
+    printf("busy");
+    print_permille(sample.busy_permille);
+    printf("%%, esp_timer callbacks");
+    print_permille(sample.timer_permille);
+    printf("%% over the last %" PRIu32 " ms\n", sample.period_ms);
+    printf("heap: free %" PRIu32 " min_free %" PRIu32 " largest_block %" PRIu32 "\n", sample.heap_free,
+           sample.heap_min_free, sample.heap_largest_block);
+}
+
+static void print_history(void)
+{
+    printf("%8s %9s %6s %6s %9s %9s %9s\n", "uptime_s", "period_ms", "busy%", "timer%", "heap_free", "min_free",
+           "largest");
+    task_profile_sample_t sample;
+    for (size_t age = HISTORY; age-- > 0;) {
+        if (task_profile_get_sample(age, &sample) != ESP_OK) {
+            continue;
+        }
+        printf("%8" PRIu32 " %9" PRIu32, sample.uptime_s, sample.period_ms);
+        print_permille(sample.busy_permille);
+        print_permille(sample.timer_permille);
+        printf(" %9" PRIu32 " %9" PRIu32 " %9" PRIu32 "\n", sample.heap_free, sample.heap_min_free,
+               sample.heap_largest_block);
+    }
+}
+
+static int tasks_cmd(int argc, char **argv)
+{
+    if (argc > 1 && strcmp(argv[1], "history") == 0) {
+        print_history();
+        return 0;
+    }
+    if (argc > 1 && strcmp(argv[1], "reset") == 0) {
+        reset_peaks();
+        return 0;
+    }
+    task_profile_report();
+    return 0;
+}
+
+esp_err_t task_profile_register_console_command(void)
+{
+    const esp_console_cmd_t cmd = {
+        .command = "tasks",
+        .help = "Per-task CPU share, stack high-water marks and heap; 'tasks history' for the sample ring, "
+                "'tasks reset' for the CPU peaks",
+        .hint = "[history|reset]",
+        .func = &tasks_cmd,
+    };
+    return esp_console_cmd_register(&cmd);
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "sdkconfig.h"
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+/*
+ * Per-task CPU, stack and heap profile behind CONFIG_GARAGE_TASK_PROFILE.
+ *
+ * Once per period a snapshot of every task (uxTaskGetSystemState(), FreeRTOS
+ * run-time stats) and of the heap goes into a ring of the last
+ * CONFIG_GARAGE_TASK_PROFILE_HISTORY samples: each task's share of the CPU
+ * over the period, and heap free, minimum free and largest free block. The
+ * esp_timer task's share is the load of all esp_timer callbacks. Per task the
+ * lowest stack high-water mark ever seen is kept next to its stack size, when
+ * known (registered with mem_budget, or an ESP-IDF task sized by sdkconfig),
+ * so stacks can be trimmed from data. A task whose free stack drops below
+ * TASK_PROFILE_STACK_WARN_BYTES is logged once. 'tasks' on the console prints
+ * the table, 'tasks history' the ring.
+ *
+ * Tasks are tracked by handle in TASK_PROFILE_MAX_TASKS slots; a deleted task
+ * keeps its slot, with its numbers, until a new task needs one.
+ */
+
+#define TASK_PROFILE_MAX_TASKS        20
+#define TASK_PROFILE_NAME_LEN         16 /* configMAX_TASK_NAME_LEN */
+#define TASK_PROFILE_STACK_WARN_BYTES 256
+/* The 32-bit microsecond run-time counters wrap after 71 minutes */
+#define TASK_PROFILE_MAX_PERIOD_MS    (60 * 60 * 1000)
+
+typedef struct {
+    char name[TASK_PROFILE_NAME_LEN];
+    UBaseType_t priority;
+    bool alive;               /* In the latest sample */
+    uint16_t cpu_permille;    /* Over the latest period */
+    uint16_t cpu_peak_permille;
+    uint32_t stack_bytes;     /* 0: unknown */
+    uint32_t stack_free_min;  /* Lowest high-water mark, bytes */
+} task_profile_task_t;
+
+typedef struct {
+    uint32_t uptime_s;
+    uint32_t period_ms;       /* Covered by the CPU shares, since the previous sample */
+    uint16_t busy_permille;   /* All tasks but the idle task */
+    uint16_t timer_permille;  /* The esp_timer task: all esp_timer callbacks */
+    uint32_t heap_free;
+    uint32_t heap_min_free;
+    uint32_t heap_largest_block;
+    uint16_t task_permille[TASK_PROFILE_MAX_TASKS]; /* By slot */
+} task_profile_sample_t;
+
+/* Samples now and every period_ms; ESP_ERR_NOT_SUPPORTED with the option off */
+esp_err_t task_profile_init(uint32_t period_ms);
+esp_err_t task_profile_deinit(void);
+/* Takes a sample now, outside the period */
+esp_err_t task_profile_sample(void);
+/* ESP_ERR_NOT_FOUND for an unused slot */
+esp_err_t task_profile_get_task(size_t slot, task_profile_task_t *task);
+/* age 0 is the latest sample; ESP_ERR_NOT_FOUND past the recorded history */
+esp_err_t task_profile_get_sample(size_t age, task_profile_sample_t *sample);
+void task_profile_report(void);
+esp_err_t task_profile_register_console_command(void);
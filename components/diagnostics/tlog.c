@@ -0,0 +1,86 @@
+#include "tlog.h"
+#include <string.h>
+#include "esp_timer.h"
+#include "metrics.h"
+
+#ifndef CONFIG_TLOG_RING_SIZE
+#define CONFIG_TLOG_RING_SIZE 64
+#endif
+
+#define RING_SIZE CONFIG_TLOG_RING_SIZE
+#define RING_MASK (RING_SIZE - 1)
+
+_Static_assert((RING_SIZE & RING_MASK) == 0, "CONFIG_TLOG_RING_SIZE must be a power of two");
+
+#define TLOG_METRICS(X)     \
+    X(COUNTER, written)     \
+    X(COUNTER, dropped)
+METRICS_GROUP_DEFINE(tlog, TLOG_METRICS)
+
+/*
+ * Multi-producer, single-consumer ring. Producers claim a slot by advancing
+ * s_head with CAS (only if the consumer has released it), fill it, then
+ * publish it by storing seq = index + 1. The consumer only reads slots whose
+ * seq matches, so a producer preempted mid-write just delays the drain.
+ * When the ring is full the new record is dropped and counted.
+ */
+static tlog_record_t s_ring[RING_SIZE];
+static uint32_t s_head = 0;
+static uint32_t s_tail = 0;
+
+void tlog_write(const tlog_fmt_t *fmt, tlog_arg_t a0, tlog_arg_t a1, tlog_arg_t a2, tlog_arg_t a3)
+{
+    uint32_t head = __atomic_load_n(&s_head, __ATOMIC_RELAXED);
+    do {
+        if (head - __atomic_load_n(&s_tail, __ATOMIC_ACQUIRE) >= RING_SIZE) {
+            METRIC_INC(dropped);
+            return;
+        }
+    } while (!__atomic_compare_exchange_n(&s_head, &head, head + 1, true, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+
+    tlog_record_t *rec = &s_ring[head & RING_MASK];
+    rec->timestamp_us = (uint32_t)esp_timer_get_time();
+    rec->fmt = fmt;
+    rec->args[0] = a0;
+    rec->args[1] = a1;
+    rec->args[2] = a2;
+    rec->args[3] = a3;
+    __atomic_store_n(&rec->seq, head + 1, __ATOMIC_RELEASE);
+    METRIC_INC(written);
+}
+
+bool tlog_read(tlog_record_t *record)
+{
+    uint32_t tail = __atomic_load_n(&s_tail, __ATOMIC_RELAXED);
+    tlog_record_t *rec = &s_ring[tail & RING_MASK];
+    if (__atomic_load_n(&rec->seq, __ATOMIC_ACQUIRE) != tail + 1) {
+        return false;
+    }
+
+    memcpy(record, rec, sizeof(tlog_record_t));
+    __atomic_store_n(&s_tail, tail + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+size_t tlog_format(const tlog_record_t *record, char *buf, size_t len)
+{
+    if (!record || !record->fmt || !buf || len == 0) {
+        return 0;
+    }
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wformat-nonliteral"
+    int n = snprintf(buf, len, record->fmt->fmt, record->args[0], record->args[1], record->args[2],
+                     record->args[3]);
+#pragma GCC diagnostic pop
+    if (n < 0) {
+        buf[0] = '\0';
+        return 0;
+    }
+    return ((size_t)n < len) ? (size_t)n : len - 1;
+}
+
+uint32_t tlog_dropped(void)
+{
+    return METRIC_GET(dropped);
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include "sdkconfig.h"
+#include "esp_err.h"
+#include "esp_log.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Deferred tokenized logging for timing-sensitive paths.
+ *
+ * A TLOG call stores the address of a static format descriptor, a timestamp
+ * and up to TLOG_MAX_ARGS raw integer/pointer arguments in a lock-free RAM
+ * ring; formatting happens later in the drain task or on the host
+ * (tools/tlog_decode.py resolves descriptor addresses from the ELF).
+ *
+ * %s arguments must point to static strings (literals, rodata tables), since
+ * only the pointer is stored. 64-bit arguments are not supported.
+ */
+
+#define TLOG_MAX_ARGS 4
+
+typedef uintptr_t tlog_arg_t;
+
+typedef struct {
+    uint8_t level;      /* esp_log_level_t */
+    uint8_t nargs;
+    const char *tag;
+    const char *fmt;
+} tlog_fmt_t;
+
+typedef struct {
+    uint32_t seq;       /* Commit marker, see tlog.c */
+    uint32_t timestamp_us;
+    const tlog_fmt_t *fmt;
+    tlog_arg_t args[TLOG_MAX_ARGS];
+} tlog_record_t;
+
+#define TLOG_NARGS_(...) TLOG_NARGS_IMPL_(0, ##__VA_ARGS__, 4, 3, 2, 1, 0)
+#define TLOG_NARGS_IMPL_(_0, _1, _2, _3, _4, N, ...) N
+#define TLOG_ARGS_0() 0, 0, 0, 0
+#define TLOG_ARGS_1(a) (tlog_arg_t)(a), 0, 0, 0
+#define TLOG_ARGS_2(a, b) (tlog_arg_t)(a), (tlog_arg_t)(b), 0, 0
+#define TLOG_ARGS_3(a, b, c) (tlog_arg_t)(a), (tlog_arg_t)(b), (tlog_arg_t)(c), 0
+#define TLOG_ARGS_4(a, b, c, d) (tlog_arg_t)(a), (tlog_arg_t)(b), (tlog_arg_t)(c), (tlog_arg_t)(d)
+#define TLOG_CAT_(a, b) a##b
+#define TLOG_ARGS_N_(n) TLOG_CAT_(TLOG_ARGS_, n)
+
+#define TLOG_(lvl, tag_, fmt_, ...)                                                         \
+    do {                                                                                    \
+        static const tlog_fmt_t tlog_fmt_desc_ = {                                          \
+            .level = (lvl), .nargs = TLOG_NARGS_(__VA_ARGS__), .tag = (tag_), .fmt = (fmt_)}; \
+        if (0) {                                                                            \
+            printf(fmt_, ##__VA_ARGS__); /* format checking only */                         \
+        }                                                                                   \
+        tlog_write(&tlog_fmt_desc_, TLOG_ARGS_N_(TLOG_NARGS_(__VA_ARGS__))(__VA_ARGS__));   \
+    } while (0)
+
+#if CONFIG_TLOG_ENABLE
+#define TLOGE(tag, fmt, ...) TLOG_(ESP_LOG_ERROR, tag, fmt, ##__VA_ARGS__)
+#define TLOGW(tag, fmt, ...) TLOG_(ESP_LOG_WARN, tag, fmt, ##__VA_ARGS__)
+#define TLOGI(tag, fmt, ...) TLOG_(ESP_LOG_INFO, tag, fmt, ##__VA_ARGS__)
+#define TLOGD(tag, fmt, ...) TLOG_(ESP_LOG_DEBUG, tag, fmt, ##__VA_ARGS__)
+#else
+#define TLOGE(tag, fmt, ...) ESP_LOGE(tag, fmt, ##__VA_ARGS__)
+#define TLOGW(tag, fmt, ...) ESP_LOGW(tag, fmt, ##__VA_ARGS__)
+#define TLOGI(tag, fmt, ...) ESP_LOGI(tag, fmt, ##__VA_ARGS__)
+#define TLOGD(tag, fmt, ...) ESP_LOGD(tag, fmt, ##__VA_ARGS__)
+#endif
+
+void tlog_write(const tlog_fmt_t *fmt, tlog_arg_t a0, tlog_arg_t a1, tlog_arg_t a2, tlog_arg_t a3);
+bool tlog_read(tlog_record_t *record);
+size_t tlog_format(const tlog_record_t *record, char *buf, size_t len);
+uint32_t tlog_dropped(void);
+esp_err_t tlog_start(void);
+
+#ifdef __cplusplus
+}
+#endif
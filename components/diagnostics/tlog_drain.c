@@ -0,0 +1,89 @@
+#include "tlog.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "static_alloc.h"
+#include "mem_budget.h"
+
+#define TAG "tlog"
+#define TLOG_TEXT_BUF_SIZE 160
+#define TLOG_DRAIN_STACK_SIZE 3072
+#define TLOG_DRAIN_PRIORITY 1
+/* An empty ring doubles the drain period up to this, so an idle system is not woken 20 times a second */
+#define TLOG_DRAIN_IDLE_MS 1000
+
+#if CONFIG_TLOG_ENABLE
+static TaskHandle_t s_drain_task = NULL;
+
+STATIC_TASK_DEFINE(s_drain, TLOG_DRAIN_STACK_SIZE);
+
+#if CONFIG_TLOG_OUTPUT_BINARY
+/* One line per record: "TLOG <timestamp> <descriptor> <args...>" in hex */
+static void emit(const tlog_record_t *rec)
+{
+    printf("TLOG %08" PRIx32 " %08" PRIxPTR, rec->timestamp_us, (uintptr_t)rec->fmt);
+    for (int i = 0; i < rec->fmt->nargs; i++) {
+        printf(" %" PRIxPTR, rec->args[i]);
+    }
+    printf("\n");
+}
+#else
+static char s_text_buf[TLOG_TEXT_BUF_SIZE];
+
+static void emit(const tlog_record_t *rec)
+{
+    static const char letters[] = {'N', 'E', 'W', 'I', 'D', 'V'};
+    uint8_t level = rec->fmt->level < sizeof(letters) ? rec->fmt->level : ESP_LOG_VERBOSE;
+
+    tlog_format(rec, s_text_buf, sizeof(s_text_buf));
+    esp_log_write((esp_log_level_t)level, rec->fmt->tag, "%c (%" PRIu32 ") %s: %s\n", letters[level],
+                  rec->timestamp_us / 1000, rec->fmt->tag, s_text_buf);
+}
+#endif
+
+static void tlog_drain_task(void *pvParameters)
+{
+    tlog_record_t rec;
+    uint32_t reported_drops = 0;
+    uint32_t period_ms = CONFIG_TLOG_DRAIN_PERIOD_MS;
+
+    while (true) {
+        bool drained = false;
+        while (tlog_read(&rec)) {
+            emit(&rec);
+            drained = true;
+        }
+
+        uint32_t drops = tlog_dropped();
+        if (drops != reported_drops) {
+            ESP_LOGW(TAG, "%" PRIu32 " records dropped (ring full)", drops - reported_drops);
+            reported_drops = drops;
+        }
+
+        if (drained) {
+            period_ms = CONFIG_TLOG_DRAIN_PERIOD_MS;
+        } else if (period_ms < TLOG_DRAIN_IDLE_MS) {
+            period_ms = period_ms * 2 < TLOG_DRAIN_IDLE_MS ? period_ms * 2 : TLOG_DRAIN_IDLE_MS;
+        }
+        vTaskDelay(pdMS_TO_TICKS(period_ms));
+    }
+}
+#endif
+
+esp_err_t tlog_start(void)
+{
+#if CONFIG_TLOG_ENABLE
+    if (s_drain_task) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    BaseType_t ret = STATIC_TASK_CREATE(s_drain, tlog_drain_task, "tlog", NULL, TLOG_DRAIN_PRIORITY, &s_drain_task);
+    if (ret != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    mem_budget_register_static(TAG, STATIC_TASK_BYTES(s_drain));
+    mem_budget_register_task(TAG, s_drain_task, TLOG_DRAIN_STACK_SIZE);
+#endif
+    return ESP_OK;
+}
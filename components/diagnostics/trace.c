@@ -0,0 +1,251 @@
+#include "trace.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include "esp_attr.h"
+#include "esp_console.h"
+#include "esp_timer.h"
+
+#ifndef CONFIG_GARAGE_TRACE_RING_SIZE
+#define CONFIG_GARAGE_TRACE_RING_SIZE 512
+#endif
+
+#define RING_SIZE CONFIG_GARAGE_TRACE_RING_SIZE
+#define RING_MASK (RING_SIZE - 1)
+
+_Static_assert((RING_SIZE & RING_MASK) == 0, "CONFIG_GARAGE_TRACE_RING_SIZE must be a power of two");
+
+static const char *const s_type_names[] = {
+    [TRACE_BOOT] = "BOOT",
+    [TRACE_REED_EDGE] = "REED",
+    [TRACE_POSITION] = "POSITION",
+    [TRACE_COMMAND] = "COMMAND",
+    [TRACE_RELAY_PULSE] = "RELAY",
+    [TRACE_STATE] = "STATE",
+};
+
+#define TYPE_COUNT (sizeof(s_type_names) / sizeof(s_type_names[0]))
+
+#if CONFIG_GARAGE_TRACE_ENABLE
+/*
+ * Overwriting ring. A writer claims index i with fetch-add, marks the slot
+ * busy (seq 0), fills it and publishes seq = i + 1. Readers copy a slot and
+ * keep it only if seq was i + 1 before and after the copy, so a record torn
+ * by a concurrent writer is skipped rather than reported.
+ */
+typedef struct {
+    uint32_t seq;
+    trace_record_t rec;
+} trace_slot_t;
+
+static trace_slot_t s_ring[RING_SIZE];
+static uint32_t s_head = 0;
+static uint32_t s_base = 0; /* First index still reported after trace_clear() */
+
+uint32_t IRAM_ATTR trace_now(void)
+{
+    return (uint32_t)esp_timer_get_time();
+}
+
+void IRAM_ATTR trace_record_at(uint32_t timestamp_us, trace_type_t type, uint8_t a, uint16_t b)
+{
+    uint32_t index = __atomic_fetch_add(&s_head, 1, __ATOMIC_RELAXED);
+    trace_slot_t *slot = &s_ring[index & RING_MASK];
+
+    __atomic_store_n(&slot->seq, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    slot->rec.timestamp_us = timestamp_us;
+    slot->rec.type = (uint8_t)type;
+    slot->rec.a = a;
+    slot->rec.b = b;
+    __atomic_store_n(&slot->seq, index + 1, __ATOMIC_RELEASE);
+}
+
+void IRAM_ATTR trace_record(trace_type_t type, uint8_t a, uint16_t b)
+{
+    trace_record_at(trace_now(), type, a, b);
+}
+
+static bool read_slot(uint32_t index, trace_record_t *out)
+{
+    const trace_slot_t *slot = &s_ring[index & RING_MASK];
+    if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != index + 1) {
+        return false;
+    }
+    *out = slot->rec;
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&slot->seq, __ATOMIC_RELAXED) == index + 1;
+}
+
+static uint32_t first_retained(uint32_t head)
+{
+    uint32_t base = __atomic_load_n(&s_base, __ATOMIC_RELAXED);
+    return (head - base > RING_SIZE) ? head - RING_SIZE : base;
+}
+
+size_t trace_snapshot(trace_record_t *out, size_t max)
+{
+    uint32_t head = __atomic_load_n(&s_head, __ATOMIC_ACQUIRE);
+    size_t count = 0;
+    for (uint32_t i = first_retained(head); i != head && count < max; i++) {
+        if (read_slot(i, &out[count])) {
+            count++;
+        }
+    }
+    return count;
+}
+
+size_t trace_read(uint32_t *cursor, trace_record_t *out, size_t max)
+{
+    uint32_t head = __atomic_load_n(&s_head, __ATOMIC_ACQUIRE);
+    uint32_t first = first_retained(head);
+    uint32_t i = *cursor;
+    if ((int32_t)(i - first) < 0) {
+        i = first;
+    }
+    size_t count = 0;
+    for (; i != head && count < max; i++) {
+        if (read_slot(i, &out[count])) {
+            count++;
+        }
+    }
+    *cursor = i;
+    return count;
+}
+
+void trace_clear(void)
+{
+    __atomic_store_n(&s_base, __atomic_load_n(&s_head, __ATOMIC_ACQUIRE), __ATOMIC_RELEASE);
+}
+
+uint32_t trace_overwritten(void)
+{
+    uint32_t head = __atomic_load_n(&s_head, __ATOMIC_ACQUIRE);
+    return first_retained(head) - __atomic_load_n(&s_base, __ATOMIC_RELAXED);
+}
+
+void trace_dump(void)
+{
+    char line[TRACE_LINE_MAX];
+    trace_record_t rec;
+    uint32_t head = __atomic_load_n(&s_head, __ATOMIC_ACQUIRE);
+    uint32_t first = first_retained(head);
+
+    printf("# trace: %" PRIu32 " records, %" PRIu32 " overwritten\n", head - first, trace_overwritten());
+    for (uint32_t i = first; i != head; i++) {
+        if (read_slot(i, &rec)) {
+            trace_format(&rec, line, sizeof(line));
+            printf("%s\n", line);
+        }
+    }
+    printf("# trace end\n");
+}
+#else
+uint32_t trace_now(void)
+{
+    return 0;
+}
+
+void trace_record_at(uint32_t timestamp_us, trace_type_t type, uint8_t a, uint16_t b)
+{
+}
+
+void trace_record(trace_type_t type, uint8_t a, uint16_t b)
+{
+}
+
+size_t trace_snapshot(trace_record_t *out, size_t max)
+{
+    return 0;
+}
+
+size_t trace_read(uint32_t *cursor, trace_record_t *out, size_t max)
+{
+    return 0;
+}
+
+void trace_clear(void)
+{
+}
+
+uint32_t trace_overwritten(void)
+{
+    return 0;
+}
+
+void trace_dump(void)
+{
+    printf("# trace: disabled (CONFIG_GARAGE_TRACE_ENABLE)\n");
+}
+#endif
+
+const char *trace_type_to_string(trace_type_t type)
+{
+    if ((size_t)type < TYPE_COUNT && s_type_names[type]) {
+        return s_type_names[type];
+    }
+    return "UNKNOWN";
+}
+
+size_t trace_format(const trace_record_t *record, char *buf, size_t len)
+{
+    if (!record || !buf || len == 0) {
+        return 0;
+    }
+
+    int n = snprintf(buf, len, "T %" PRIu32 " %s %u %u", record->timestamp_us,
+                     trace_type_to_string((trace_type_t)record->type), record->a, record->b);
+    if (n < 0) {
+        buf[0] = '\0';
+        return 0;
+    }
+    return ((size_t)n < len) ? (size_t)n : len - 1;
+}
+
+bool trace_parse(const char *line, trace_record_t *record)
+{
+    char name[16];
+    uint32_t timestamp_us;
+    unsigned a;
+    unsigned b;
+
+    if (!line || !record) {
+        return false;
+    }
+    if (sscanf(line, "T %" SCNu32 " %15s %u %u", &timestamp_us, name, &a, &b) != 4 || a > UINT8_MAX ||
+        b > UINT16_MAX) {
+        return false;
+    }
+    for (size_t type = 0; type < TYPE_COUNT; type++) {
+        if (s_type_names[type] && strcmp(name, s_type_names[type]) == 0) {
+            record->timestamp_us = timestamp_us;
+            record->type = (uint8_t)type;
+            record->a = (uint8_t)a;
+            record->b = (uint16_t)b;
+            return true;
+        }
+    }
+    return false;
+}
+
+static int trace_cmd(int argc, char **argv)
+{
+    if (argc > 1 && strcmp(argv[1], "clear") == 0) {
+        trace_clear();
+        return 0;
+    }
+
+    trace_dump();
+    return 0;
+}
+
+esp_err_t trace_register_console_command(void)
+{
+    const esp_console_cmd_t cmd = {
+        .command = "trace",
+        .help = "Dump the event trace for tests/host/trace_replay, or 'trace clear'",
+        .hint = "[clear]",
+        .func = &trace_cmd,
+    };
+    return esp_console_cmd_register(&cmd);
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "sdkconfig.h"
+#include "esp_err.h"
+
+/*
+ * Compact event trace for reproducing field issues.
+ *
+ * Records the inputs of the door logic (reed edges, commands) and its
+ * outputs (debounced positions, relay pulses, state transitions) with
+ * microsecond timestamps in a RAM ring that overwrites the oldest entries.
+ * The 'trace' console command dumps it as text; tests/host/trace_replay
+ * feeds a dump back into garage_door_control.c under virtual time and diffs
+ * the outputs. Writers are lock-free and safe from ISRs.
+ *
+ * With CONFIG_GARAGE_TRACE_ENABLE off the TRACE* macros compile to nothing.
+ */
+
+typedef enum {
+    TRACE_BOOT = 1,        /* a: door_position_t at init, b: door_state_t after reconciliation */
+    TRACE_REED_EDGE = 2,   /* a: trace_reed_t, b: level sampled in the ISR */
+    TRACE_POSITION = 3,    /* a: debounced door_position_t */
+    TRACE_COMMAND = 4,     /* a: trace_command_t, b: esp_err_t result; timestamp is command entry */
+    TRACE_RELAY_PULSE = 5, /* b: pulse width in ms */
+    TRACE_STATE = 6,       /* a: old door_state_t, b: new door_state_t */
+} trace_type_t;
+
+typedef enum {
+    TRACE_REED_CLOSED = 0,
+    TRACE_REED_OPEN = 1,
+} trace_reed_t;
+
+typedef enum {
+    TRACE_CMD_OPEN = 0,
+    TRACE_CMD_CLOSE = 1,
+    TRACE_CMD_STOP = 2,
+} trace_command_t;
+
+typedef struct {
+    uint32_t timestamp_us; /* esp_timer time, wraps after ~71 minutes */
+    uint8_t type;
+    uint8_t a;
+    uint16_t b;
+} trace_record_t;
+
+/* Longest line trace_format() produces, including the terminator */
+#define TRACE_LINE_MAX 48
+
+#if CONFIG_GARAGE_TRACE_ENABLE
+#define TRACE(type, a, b)            trace_record((type), (uint8_t)(a), (uint16_t)(b))
+#define TRACE_AT(ts, type, a, b)     trace_record_at((ts), (type), (uint8_t)(a), (uint16_t)(b))
+#define TRACE_NOW()                  trace_now()
+#else
+#define TRACE(type, a, b)            do { } while (0)
+#define TRACE_AT(ts, type, a, b)     do { (void)(ts); } while (0)
+#define TRACE_NOW()                  0
+#endif
+
+uint32_t trace_now(void);
+void trace_record(trace_type_t type, uint8_t a, uint16_t b);
+void trace_record_at(uint32_t timestamp_us, trace_type_t type, uint8_t a, uint16_t b);
+/* Copies up to 'max' retained records, oldest first; returns the number copied */
+size_t trace_snapshot(trace_record_t *out, size_t max);
+/*
+ * Chunked form of trace_snapshot(): copies up to 'max' records from *cursor
+ * on and advances it; start with 0. Records overwritten meanwhile are skipped.
+ */
+size_t trace_read(uint32_t *cursor, trace_record_t *out, size_t max);
+void trace_clear(void);
+/* Records lost to ring wrap-around since the last clear */
+uint32_t trace_overwritten(void);
+
+/* Text form, one record per line: "T <timestamp_us> <TYPE> <a> <b>" */
+size_t trace_format(const trace_record_t *record, char *buf, size_t len);
+bool trace_parse(const char *line, trace_record_t *record);
+const char *trace_type_to_string(trace_type_t type);
+
+void trace_dump(void);
+esp_err_t trace_register_console_command(void);
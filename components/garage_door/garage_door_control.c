@@ -1,4 +1,5 @@
 #include "garage_door_control.h"
+#include <inttypes.h>
 #include <string.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
@@ -7,89 +8,445 @@
 #include "esp_timer.h"
 #include "reed_switch.h"
 #include "relay_control.h"
+#include "pulse_planner.h"
+#include "sensor_scheduler.h"
 #include "storage_manager.h"
+#include "metrics.h"
+#include "tlog.h"
+#include "trace.h"
+#include "static_alloc.h"
+#include "mem_budget.h"
+#include "liveness.h"
+#include "hot_path.h"
+#include "span.h"
 
 #define TAG "garage_door"
-#define DEFAULT_TIMEOUT_MS 30000
-#define SAFETY_CHECK_INTERVAL_MS 100
+/* The learned latency is persisted once it drifts this far, not on every start */
+#define MOTION_START_SAVE_STEP_MS 100
+/* A planned pulse waits this much past the relay's minimum interval, or this long after a rejection */
+#define PULSE_MARGIN_MS 20
+#define PULSE_RETRY_MS 100
+/* A moving door whose safety check falls this far behind is unsupervised: stop it */
+#define SAFETY_LIVENESS_MS 500
+#define TIMEOUT_BUDGET_US 100000 /* Two flash commits */
+#define MAX_STATE_CALLBACKS 4
+
+#define DOOR_METRICS(X)               \
+    X(COUNTER, transitions)           \
+    X(COUNTER, timeouts)              \
+    X(COUNTER, obstructions)          \
+    X(COUNTER, no_actuations)         \
+    X(COUNTER, actuation_retries)     \
+    X(COUNTER, direction_corrections) \
+    X(COUNTER, rejected_commands)     \
+    X(GAUGE, state)
+METRICS_GROUP_DEFINE(door, DOOR_METRICS)
 
 static door_state_t s_current_state = DOOR_STATE_UNKNOWN;
 static bool s_initialized = false;
-static uint32_t s_timeout_ms = DEFAULT_TIMEOUT_MS;
-static door_state_callback_t s_state_callback = NULL;
+#if CONFIG_GARAGE_DOOR_ACTUATION_RETRY
+#define DEFAULT_ACTUATION_RETRY true
+#else
+#define DEFAULT_ACTUATION_RETRY false
+#endif
+#if CONFIG_GARAGE_FIXED_CONFIG
+#define TIMEOUT_MS CONFIG_GARAGE_DOOR_TIMEOUT_MS
+#define ACTUATION_RETRY DEFAULT_ACTUATION_RETRY
+#else
+static uint32_t s_timeout_ms = GARAGE_DOOR_DEFAULT_TIMEOUT_MS;
+#define TIMEOUT_MS s_timeout_ms
+static bool s_actuation_retry = DEFAULT_ACTUATION_RETRY;
+#define ACTUATION_RETRY s_actuation_retry
+#endif
+static door_state_callback_t s_state_callbacks[MAX_STATE_CALLBACKS];
+static size_t s_state_callback_count = 0;
 static SemaphoreHandle_t s_state_mutex = NULL;
 static esp_timer_handle_t s_timeout_timer = NULL;
-static esp_timer_handle_t s_safety_timer = NULL;
-static TaskHandle_t s_safety_task = NULL;
+static esp_timer_handle_t s_pulse_timer = NULL;
+/* The opener's toggle sequence, and the motion the pulses still to send lead to; under s_state_mutex */
+static pulse_planner_t s_planner;
+static bool s_plan_active = false;
+static planner_motion_t s_plan_target = PLANNER_STOPPED;
+/* A reed has shown the door leaving in the commanded direction */
+static bool s_direction_verified = false;
+/* The command's one wrong-stop correction is used up, or it never needs one */
+static bool s_corrected = false;
+static sensor_id_t s_safety_sensor = -1;
+static int64_t s_motion_start_us = 0;
+/* Still at the end stop the motion started from; false when it started between the stops */
+static bool s_awaiting_release = false;
+static bool s_retried = false;
+/* Learned pulse-to-release latency, 0 until a start has been seen; kept in NVS */
+static uint32_t s_release_ms = 0;
+static uint32_t s_saved_release_ms = 0;
+/* Correlation ID of the command behind the current motion, for the spans of its end */
+static uint16_t s_motion_corr = 0;
+static liveness_id_t s_safety_liveness = -1;
+static liveness_id_t s_timeout_liveness = -1;
+
+STATIC_MUTEX_DEFINE(s_state_mutex);
+/* Up to the flash commit, which no placement speeds up */
+HOT_PATH_DEFINE(update_state);
+HOT_PATH_DEFINE(safety_check);
+
+/* Caller holds s_state_mutex */
+static esp_err_t pulse_locked(void)
+{
+    esp_err_t ret = relay_activate();
+    if (ret == ESP_OK) {
+        pulse_planner_on_pulse(&s_planner);
+        if (s_awaiting_release) {
+            /* The start window runs from the pulse that should move the door */
+            s_motion_start_us = esp_timer_get_time();
+        }
+    }
+    return ret;
+}
 
-static void update_state(door_state_t new_state)
+static void cancel_plan_locked(void)
 {
-    xSemaphoreTake(s_state_mutex, portMAX_DELAY);
+    s_plan_active = false;
+    if (s_pulse_timer) {
+        esp_timer_stop(s_pulse_timer);
+    }
+}
+
+/* Until the relay takes the next pulse */
+static uint64_t pulse_interval_us(void)
+{
+    relay_config_t config;
+    if (relay_get_config(&config) != ESP_OK) {
+        return (uint64_t)PULSE_RETRY_MS * 1000;
+    }
+    return (uint64_t)(config.min_interval_ms + PULSE_MARGIN_MS) * 1000;
+}
+
+/* Caller holds s_state_mutex */
+static void schedule_plan_locked(int pulses, uint64_t delay_us)
+{
+    s_plan_active = pulses > 0;
+    esp_timer_stop(s_pulse_timer);
+    if (s_plan_active) {
+        esp_timer_start_once(s_pulse_timer, delay_us);
+    }
+}
+
+/*
+ * Sends the next pulse toward s_plan_target, replanning from the model each
+ * time so reed changes in between are taken into account, and schedules the
+ * one after once the relay takes pulses again. Caller holds s_state_mutex.
+ */
+static void advance_plan_locked(void)
+{
+    int pulses = s_plan_active ? pulse_planner_plan(&s_planner, s_plan_target) : 0;
+    if (pulses <= 0) {
+        schedule_plan_locked(0, 0);
+    } else if (pulse_locked() == ESP_OK) {
+        schedule_plan_locked(pulses - 1, pulse_interval_us());
+    } else {
+        schedule_plan_locked(pulses, (uint64_t)PULSE_RETRY_MS * 1000);
+    }
+}
+
+/*
+ * First pulse of a move toward target, sent now so a refused pulse fails the
+ * command; the rest follow from the pulse timer. Caller holds s_state_mutex.
+ */
+static esp_err_t start_plan_locked(planner_motion_t target)
+{
+    /* Commands start from rest, unless a stop's pulse is still queued */
+    if (!s_plan_active) {
+        pulse_planner_settle(&s_planner);
+    }
+    int pulses = pulse_planner_plan(&s_planner, target);
+    if (pulses < 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (pulses > 0) {
+        esp_err_t ret = pulse_locked();
+        if (ret != ESP_OK) {
+            return ret;
+        }
+        pulses--;
+    }
+    s_plan_target = target;
+    s_direction_verified = false;
+    /* Only a door started between the stops can end up at the wrong one */
+    s_corrected = s_planner.at != DOOR_POSITION_BETWEEN;
+    schedule_plan_locked(pulses, pulse_interval_us());
+    return ESP_OK;
+}
+
+static void HOT_PATH_ATTR update_state(door_state_t new_state)
+{
+    uint32_t begin = HOT_PATH_BEGIN();
+    SPAN_BEGIN(SPAN_DOOR_LOCK);
+    LOCK_TAKE(s_state_mutex);
+    SPAN_END(SPAN_DOOR_LOCK);
     if (s_current_state != new_state) {
-        ESP_LOGI(TAG, "State: %s -> %s", garage_door_state_to_string(s_current_state), garage_door_state_to_string(new_state));
+        SPAN_BEGIN(SPAN_DOOR_STATE);
+        TLOGI(TAG, "State: %s -> %s", garage_door_state_to_string(s_current_state), garage_door_state_to_string(new_state));
+        TRACE(TRACE_STATE, s_current_state, new_state);
         s_current_state = new_state;
+        if (new_state != DOOR_STATE_OPENING && new_state != DOOR_STATE_CLOSING && s_timeout_timer) {
+            /* Motion is over; a late timeout would turn a finished move into STOPPED */
+            esp_timer_stop(s_timeout_timer);
+        }
+        /* The safety check only has work while the door moves */
+        bool moving = (new_state == DOOR_STATE_OPENING || new_state == DOOR_STATE_CLOSING);
+        if (s_safety_sensor >= 0) {
+            sensor_scheduler_set_period(s_safety_sensor, moving ? GARAGE_DOOR_SAFETY_CHECK_INTERVAL_MS : 0);
+        }
+        if (s_safety_liveness >= 0) {
+            liveness_set_period(s_safety_liveness, moving ? SAFETY_LIVENESS_MS : 0);
+        }
+        if (!moving) {
+            s_motion_corr = 0;
+        }
+        /* A stop command's pulses outlive its transition; anything else ends the plan */
+        if (!moving && !(new_state == DOOR_STATE_STOPPED && s_plan_target == PLANNER_STOPPED)) {
+            cancel_plan_locked();
+        }
+        METRIC_INC(transitions);
+        METRIC_SET(state, new_state);
+        HOT_PATH_END(update_state, begin);
         storage_save_door_state(new_state);
         
-        if (s_state_callback) {
-            s_state_callback(new_state);
+        for (size_t i = 0; i < s_state_callback_count; i++) {
+            s_state_callbacks[i](new_state);
         }
+        SPAN_END(SPAN_DOOR_STATE);
     }
-    xSemaphoreGive(s_state_mutex);
+    LOCK_GIVE(s_state_mutex);
+}
+
+static uint32_t motion_start_window_ms(void)
+{
+    if (s_release_ms == 0) {
+        return GARAGE_DOOR_MOTION_START_GRACE_MS;
+    }
+    uint32_t window = 2 * s_release_ms;
+    if (window < GARAGE_DOOR_MOTION_START_MIN_MS) {
+        return GARAGE_DOOR_MOTION_START_MIN_MS;
+    }
+    return window > GARAGE_DOOR_MOTION_START_GRACE_MS ? GARAGE_DOOR_MOTION_START_GRACE_MS : window;
+}
+
+/* True when the learned latency has drifted far enough from the saved one to save it */
+static bool learn_release(uint32_t latency_ms)
+{
+    s_release_ms = s_release_ms ? (3 * s_release_ms + latency_ms) / 4 : latency_ms;
+    uint32_t drift = s_release_ms > s_saved_release_ms ? s_release_ms - s_saved_release_ms
+                                                       : s_saved_release_ms - s_release_ms;
+    return s_saved_release_ms == 0 || drift >= MOTION_START_SAVE_STEP_MS;
 }
 
 static void timeout_timer_callback(void *arg)
 {
-    ESP_LOGW(TAG, "Operation timeout, stopping door");
-    storage_log_event(EVENT_TYPE_TIMEOUT, s_current_state);
+    uint32_t begin = liveness_begin();
+    uint16_t corr = SPAN_CORR_GET();
+    SPAN_CORR_SET(s_motion_corr);
+    TLOGW(TAG, "Operation timeout, stopping door");
+    METRIC_INC(timeouts);
+    door_state_t state = garage_door_get_state();
+    /* Stop first: a slow flash commit must not delay the safe state */
     update_state(DOOR_STATE_STOPPED);
+    storage_log_event(EVENT_TYPE_TIMEOUT, state);
+    SPAN_CORR_SET(corr);
+    liveness_end(s_timeout_liveness, begin);
 }
 
-static void safety_check_task(void *pvParameters)
+static void pulse_timer_callback(void *arg)
 {
-    while (true) {
-        vTaskDelay(pdMS_TO_TICKS(SAFETY_CHECK_INTERVAL_MS));
-        
-        xSemaphoreTake(s_state_mutex, portMAX_DELAY);
-        door_state_t state = s_current_state;
-        xSemaphoreGive(s_state_mutex);
-        
-        if (state == DOOR_STATE_OPENING || state == DOOR_STATE_CLOSING) {
-            door_position_t pos = reed_switch_get_position();
-            
-            if (state == DOOR_STATE_OPENING) {
-                if (pos == DOOR_POSITION_CLOSED) {
-                    ESP_LOGW(TAG, "Obstruction detected: door not opening");
-                    storage_log_event(EVENT_TYPE_OBSTRUCTION, state);
-                    update_state(DOOR_STATE_STOPPED);
-                } else if (pos == DOOR_POSITION_OPEN) {
-                    update_state(DOOR_STATE_OPEN);
-                }
-            } else if (state == DOOR_STATE_CLOSING) {
-                if (pos == DOOR_POSITION_OPEN) {
-                    ESP_LOGW(TAG, "Obstruction detected: door not closing");
-                    storage_log_event(EVENT_TYPE_OBSTRUCTION, state);
-                    update_state(DOOR_STATE_STOPPED);
-                } else if (pos == DOOR_POSITION_CLOSED) {
-                    update_state(DOOR_STATE_CLOSED);
-                }
-            }
-        }
+    uint16_t corr = SPAN_CORR_GET();
+    SPAN_CORR_SET(s_motion_corr);
+    LOCK_TAKE(s_state_mutex);
+    advance_plan_locked();
+    LOCK_GIVE(s_state_mutex);
+    SPAN_CORR_SET(corr);
+}
+
+/*
+ * The door never left its end stop after the pulse: pulse once more, or stop
+ * and report it. The state lock keeps a stop command from landing between the
+ * check and the second pulse, which would start a stopped door.
+ */
+static void no_actuation(door_state_t state, uint32_t waited_ms)
+{
+    bool retried = false;
+    LOCK_TAKE(s_state_mutex);
+    if (s_current_state != state) {
+        LOCK_GIVE(s_state_mutex);
+        return;
     }
+    /* The opener did not act on the pulse: it still rests at the end stop */
+    pulse_planner_reset(&s_planner, reed_switch_get_position());
+    if (ACTUATION_RETRY && !s_retried && pulse_locked() == ESP_OK) {
+        s_retried = true;
+        retried = true;
+        s_motion_start_us = esp_timer_get_time();
+        /* The operation timeout runs from the pulse that moves the door */
+        esp_timer_stop(s_timeout_timer);
+        esp_timer_start_once(s_timeout_timer, (uint64_t)TIMEOUT_MS * 1000);
+    }
+    LOCK_GIVE(s_state_mutex);
+    
+    if (retried) {
+        TLOGW(TAG, "Door not moving %" PRIu32 " ms after the pulse, pulsing again", waited_ms);
+        METRIC_INC(actuation_retries);
+        return;
+    }
+    TLOGW(TAG, "No actuation: door still at its end stop %" PRIu32 " ms after the pulse", waited_ms);
+    METRIC_INC(no_actuations);
+    update_state(DOOR_STATE_STOPPED);
+    storage_log_event(EVENT_TYPE_NO_ACTUATION, state);
 }
 
-static void reed_switch_callback(door_position_t position)
+/* Sampled by the sensor scheduler while the door moves */
+static void HOT_PATH_ATTR safety_check(void *ctx)
 {
-    xSemaphoreTake(s_state_mutex, portMAX_DELAY);
+    uint32_t begin = HOT_PATH_BEGIN();
+    liveness_checkin(s_safety_liveness);
+    LOCK_TAKE(s_state_mutex);
     door_state_t state = s_current_state;
-    xSemaphoreGive(s_state_mutex);
+    bool verified = s_direction_verified;
+    bool awaiting = s_awaiting_release;
+    int64_t start_us = s_motion_start_us;
+    LOCK_GIVE(s_state_mutex);
     
+    door_state_t next = state;
+    bool obstructed = false;
+    bool not_started = false;
+    bool learned = false;
+    uint32_t release_ms = 0;
+    uint32_t elapsed_ms = (uint32_t)((esp_timer_get_time() - start_us) / 1000);
     if (state == DOOR_STATE_OPENING || state == DOOR_STATE_CLOSING) {
-        if (position == DOOR_POSITION_OPEN) {
-            update_state(DOOR_STATE_OPEN);
-        } else if (position == DOOR_POSITION_CLOSED) {
-            update_state(DOOR_STATE_CLOSED);
+        door_position_t pos = reed_switch_get_position();
+        bool starting = elapsed_ms < motion_start_window_ms();
+        door_position_t start_stop = (state == DOOR_STATE_OPENING) ? DOOR_POSITION_CLOSED : DOOR_POSITION_OPEN;
+        door_position_t end_stop = (state == DOOR_STATE_OPENING) ? DOOR_POSITION_OPEN : DOOR_POSITION_CLOSED;
+        
+        if (pos == end_stop) {
+            next = (state == DOOR_STATE_OPENING) ? DOOR_STATE_OPEN : DOOR_STATE_CLOSED;
+        } else if (awaiting && pos != start_stop) {
+            /* Unless a pulse restarted the window meanwhile */
+            LOCK_TAKE(s_state_mutex);
+            if (s_awaiting_release && s_motion_start_us == start_us) {
+                s_awaiting_release = false;
+                learned = learn_release(elapsed_ms);
+                release_ms = s_release_ms;
+            }
+            LOCK_GIVE(s_state_mutex);
+        } else if (pos == start_stop && !starting && (awaiting || verified)) {
+            /*
+             * Never left the end stop: the opener ignored the pulse. Back at it:
+             * obstruction. A door started between the stops that arrives here
+             * ran the wrong way, which the reed callback corrects.
+             */
+            not_started = awaiting;
+            obstructed = !awaiting;
+            next = DOOR_STATE_STOPPED;
         }
     }
+    /* The transition is profiled by update_state() */
+    HOT_PATH_END(safety_check, begin);
+    
+    uint16_t corr = SPAN_CORR_GET();
+    SPAN_CORR_SET(s_motion_corr);
+    if (not_started) {
+        no_actuation(state, elapsed_ms);
+    } else if (obstructed) {
+        TLOGW(TAG, "Obstruction detected: door not %s", state == DOOR_STATE_OPENING ? "opening" : "closing");
+        METRIC_INC(obstructions);
+        update_state(DOOR_STATE_STOPPED);
+        storage_log_event(EVENT_TYPE_OBSTRUCTION, state);
+    } else if (next != state) {
+        update_state(next);
+    }
+    if (learned && storage_save_motion_start(release_ms) == ESP_OK) {
+        s_saved_release_ms = release_ms;
+    }
+    SPAN_CORR_SET(corr);
+}
+
+/*
+ * A door started between the stops that reaches the opposite end stop gets
+ * pulsed back, once per command: its direction was a guess, the model was
+ * wrong, or it got there on the leg before a reversal. One whose reed already
+ * showed it leaving the right way was reversed by the opener itself (its own
+ * obstruction sensing) and is left at the end stop.
+ */
+static bool correct_direction_locked(door_position_t position)
+{
+    bool opening = s_current_state == DOOR_STATE_OPENING;
+    door_position_t wrong_stop = opening ? DOOR_POSITION_CLOSED : DOOR_POSITION_OPEN;
+    if (s_direction_verified || s_corrected || position != wrong_stop ||
+        (!opening && s_current_state != DOOR_STATE_CLOSING)) {
+        return false;
+    }
+    s_corrected = true;
+    s_plan_target = opening ? PLANNER_UP : PLANNER_DOWN;
+    /* The reed closes short of the opener's limit: pulse once it has come to rest there */
+    schedule_plan_locked(1, pulse_interval_us());
+    /* Confirmed like a fresh start from this end stop, timed from the correcting pulse */
+    s_motion_start_us = esp_timer_get_time();
+    s_awaiting_release = true;
+    s_retried = false;
+    esp_timer_stop(s_timeout_timer);
+    esp_timer_start_once(s_timeout_timer, (uint64_t)TIMEOUT_MS * 1000);
+    return true;
+}
+
+static void HOT_PATH_ATTR reed_switch_callback(door_position_t position)
+{
+    uint16_t corr = SPAN_CORR_GET();
+    SPAN_CORR_SET(s_motion_corr);
+    LOCK_TAKE(s_state_mutex);
+    bool expected = pulse_planner_on_reed(&s_planner, position);
+    bool moving = (s_current_state == DOOR_STATE_OPENING || s_current_state == DOOR_STATE_CLOSING);
+    if (moving && position == DOOR_POSITION_BETWEEN && expected) {
+        s_direction_verified = true;
+    }
+    bool corrected = correct_direction_locked(position);
+    LOCK_GIVE(s_state_mutex);
+    
+    if (corrected) {
+        TLOGW(TAG, "Door reached the %s stop %s, pulsing it back", position == DOOR_POSITION_OPEN ? "open" : "closed",
+              expected ? "before reversing" : "running the wrong way");
+        METRIC_INC(direction_corrections);
+        SPAN_CORR_SET(corr);
+        return;
+    }
+    /* End stops are authoritative in every state, e.g. a door still travelling after a reset */
+    if (position == DOOR_POSITION_OPEN) {
+        update_state(DOOR_STATE_OPEN);
+    } else if (position == DOOR_POSITION_CLOSED) {
+        update_state(DOOR_STATE_CLOSED);
+    }
+    SPAN_CORR_SET(corr);
+}
+
+/*
+ * Reconcile the persisted state with the reed switches at boot. The reeds win
+ * at the end stops; a persisted motion state can never be resumed after a
+ * reset, so between the stops it becomes STOPPED.
+ */
+static door_state_t reconcile_boot_state(door_state_t saved, door_position_t pos)
+{
+    switch (pos) {
+        case DOOR_POSITION_CLOSED:
+            return DOOR_STATE_CLOSED;
+        case DOOR_POSITION_OPEN:
+            return DOOR_STATE_OPEN;
+        case DOOR_POSITION_BETWEEN:
+            return (saved == DOOR_STATE_UNKNOWN) ? DOOR_STATE_UNKNOWN : DOOR_STATE_STOPPED;
+        default:
+            /* Reed fault: keep a persisted end state, never a motion state */
+            if (saved == DOOR_STATE_OPEN || saved == DOOR_STATE_CLOSED || saved == DOOR_STATE_STOPPED) {
+                return saved;
+            }
+            return DOOR_STATE_UNKNOWN;
+    }
 }
 
 esp_err_t garage_door_init(void)
@@ -98,23 +455,27 @@ esp_err_t garage_door_init(void)
         return ESP_ERR_INVALID_STATE;
     }
     
-    s_state_mutex = xSemaphoreCreateMutex();
+    s_state_mutex = STATIC_MUTEX_CREATE(s_state_mutex);
     if (!s_state_mutex) {
         return ESP_ERR_NO_MEM;
     }
     
-    uint32_t saved_state;
-    if (storage_load_door_state(&saved_state) == ESP_OK) {
-        s_current_state = (door_state_t)saved_state;
-    } else {
-        door_position_t pos = reed_switch_get_position();
-        if (pos == DOOR_POSITION_CLOSED) {
-            s_current_state = DOOR_STATE_CLOSED;
-        } else if (pos == DOOR_POSITION_OPEN) {
-            s_current_state = DOOR_STATE_OPEN;
-        } else {
-            s_current_state = DOOR_STATE_UNKNOWN;
-        }
+    uint32_t saved_state = DOOR_STATE_UNKNOWN;
+    if (storage_load_door_state(&saved_state) != ESP_OK || saved_state > DOOR_STATE_UNKNOWN) {
+        saved_state = DOOR_STATE_UNKNOWN;
+    }
+    
+    door_position_t pos = reed_switch_get_position();
+    if (storage_load_motion_start(&s_release_ms) != ESP_OK) {
+        s_release_ms = 0;
+    }
+    s_saved_release_ms = s_release_ms;
+    s_current_state = reconcile_boot_state((door_state_t)saved_state, pos);
+    TRACE(TRACE_BOOT, pos, s_current_state);
+    if (s_current_state != (door_state_t)saved_state) {
+        ESP_LOGI(TAG, "Restored state %s reconciled to %s", garage_door_state_to_string((door_state_t)saved_state),
+                 garage_door_state_to_string(s_current_state));
+        storage_save_door_state(s_current_state);
     }
     
     esp_timer_create_args_t timeout_args = {
@@ -130,16 +491,58 @@ esp_err_t garage_door_init(void)
         return ret;
     }
     
+    esp_timer_create_args_t pulse_args = {
+        .callback = pulse_timer_callback,
+        .arg = NULL,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "door_pulse"
+    };
+    ret = esp_timer_create(&pulse_args, &s_pulse_timer);
+    if (ret != ESP_OK) {
+        esp_timer_delete(s_timeout_timer);
+        vSemaphoreDelete(s_state_mutex);
+        return ret;
+    }
+    /* Whatever moved the door before the reset, it rests now; the last direction is lost */
+    pulse_planner_reset(&s_planner, pos);
+    s_plan_active = false;
+    s_plan_target = PLANNER_STOPPED;
+    
     reed_switch_register_callback(reed_switch_callback);
     
-    BaseType_t task_ret = xTaskCreate(safety_check_task, "safety", 2048, NULL, 7, &s_safety_task);
-    if (task_ret != pdPASS) {
+    /* Registered paused; update_state() runs it while the door moves */
+    const sensor_desc_t safety = {
+        .name = "door_safety",
+        .period_ms = 0,
+        .deadline_ms = GARAGE_DOOR_SAFETY_CHECK_INTERVAL_MS,
+        .sample = safety_check,
+    };
+    ret = sensor_scheduler_register(&safety, &s_safety_sensor);
+    if (ret != ESP_OK) {
+        esp_timer_delete(s_pulse_timer);
         esp_timer_delete(s_timeout_timer);
         vSemaphoreDelete(s_state_mutex);
-        return ESP_ERR_NO_MEM;
+        return ret;
+    }
+    
+    mem_budget_register_static(TAG, STATIC_MUTEX_BYTES);
+    
+    /* Optional: without the monitor the door runs unwatched, as before */
+    const liveness_desc_t supervision = {
+        .name = "door_safety",
+        .period_ms = 0,
+        .action = LIVENESS_ACTION_SAFE_STOP,
+    };
+    if (liveness_register(&supervision, &s_safety_liveness) != ESP_OK) {
+        s_safety_liveness = -1;
+    }
+    const liveness_desc_t timeout = {.name = "door_timeout", .budget_us = TIMEOUT_BUDGET_US};
+    if (liveness_register(&timeout, &s_timeout_liveness) != ESP_OK) {
+        s_timeout_liveness = -1;
     }
     
     s_initialized = true;
+    METRIC_SET(state, s_current_state);
     ESP_LOGI(TAG, "Initialized, state: %s", garage_door_state_to_string(s_current_state));
     return ESP_OK;
 }
@@ -150,9 +553,18 @@ esp_err_t garage_door_deinit(void)
         return ESP_ERR_INVALID_STATE;
     }
     
-    if (s_safety_task) {
-        vTaskDelete(s_safety_task);
-        s_safety_task = NULL;
+    if (s_safety_sensor >= 0) {
+        sensor_scheduler_unregister(s_safety_sensor);
+        s_safety_sensor = -1;
+    }
+    
+    if (s_safety_liveness >= 0) {
+        liveness_unregister(s_safety_liveness);
+        s_safety_liveness = -1;
+    }
+    if (s_timeout_liveness >= 0) {
+        liveness_unregister(s_timeout_liveness);
+        s_timeout_liveness = -1;
     }
     
     if (s_timeout_timer) {
@@ -160,99 +572,167 @@ esp_err_t garage_door_deinit(void)
         esp_timer_delete(s_timeout_timer);
         s_timeout_timer = NULL;
     }
+    if (s_pulse_timer) {
+        esp_timer_stop(s_pulse_timer);
+        esp_timer_delete(s_pulse_timer);
+        s_pulse_timer = NULL;
+    }
     
     vSemaphoreDelete(s_state_mutex);
     s_state_mutex = NULL;
+    s_state_callback_count = 0;
     s_initialized = false;
     
     return ESP_OK;
 }
 
-esp_err_t garage_door_open(void)
+static esp_err_t open_door(void)
 {
     if (!s_initialized) {
         return ESP_ERR_INVALID_STATE;
     }
     
-    xSemaphoreTake(s_state_mutex, portMAX_DELAY);
+    LOCK_TAKE(s_state_mutex);
     door_state_t state = s_current_state;
-    xSemaphoreGive(s_state_mutex);
+    LOCK_GIVE(s_state_mutex);
     
     if (state != DOOR_STATE_CLOSED && state != DOOR_STATE_STOPPED) {
         ESP_LOGW(TAG, "Cannot open from state %s", garage_door_state_to_string(state));
+        METRIC_INC(rejected_commands);
         return ESP_ERR_INVALID_STATE;
     }
     
-    esp_err_t ret = relay_activate();
+    LOCK_TAKE(s_state_mutex);
+    esp_err_t ret = start_plan_locked(PLANNER_UP);
+    if (ret == ESP_OK) {
+        /* With the pulse: the safety check must not see the new motion with the last one's start */
+        s_motion_start_us = esp_timer_get_time();
+        s_awaiting_release = (reed_switch_get_position() == DOOR_POSITION_CLOSED);
+        s_retried = false;
+        s_motion_corr = SPAN_CORR_GET();
+    }
+    LOCK_GIVE(s_state_mutex);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to activate relay: %s", esp_err_to_name(ret));
         return ret;
     }
     
     update_state(DOOR_STATE_OPENING);
-    esp_timer_start_once(s_timeout_timer, s_timeout_ms * 1000);
+    esp_timer_start_once(s_timeout_timer, (uint64_t)TIMEOUT_MS * 1000);
     storage_log_event(EVENT_TYPE_DOOR_OPEN, 0);
     
     return ESP_OK;
 }
 
-esp_err_t garage_door_close(void)
+static esp_err_t close_door(void)
 {
     if (!s_initialized) {
         return ESP_ERR_INVALID_STATE;
     }
     
-    xSemaphoreTake(s_state_mutex, portMAX_DELAY);
+    LOCK_TAKE(s_state_mutex);
     door_state_t state = s_current_state;
-    xSemaphoreGive(s_state_mutex);
+    LOCK_GIVE(s_state_mutex);
     
     if (state != DOOR_STATE_OPEN && state != DOOR_STATE_STOPPED) {
         ESP_LOGW(TAG, "Cannot close from state %s", garage_door_state_to_string(state));
+        METRIC_INC(rejected_commands);
         return ESP_ERR_INVALID_STATE;
     }
     
-    esp_err_t ret = relay_activate();
+    LOCK_TAKE(s_state_mutex);
+    esp_err_t ret = start_plan_locked(PLANNER_DOWN);
+    if (ret == ESP_OK) {
+        /* With the pulse: the safety check must not see the new motion with the last one's start */
+        s_motion_start_us = esp_timer_get_time();
+        s_awaiting_release = (reed_switch_get_position() == DOOR_POSITION_OPEN);
+        s_retried = false;
+        s_motion_corr = SPAN_CORR_GET();
+    }
+    LOCK_GIVE(s_state_mutex);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to activate relay: %s", esp_err_to_name(ret));
         return ret;
     }
     
     update_state(DOOR_STATE_CLOSING);
-    esp_timer_start_once(s_timeout_timer, s_timeout_ms * 1000);
+    esp_timer_start_once(s_timeout_timer, (uint64_t)TIMEOUT_MS * 1000);
     storage_log_event(EVENT_TYPE_DOOR_CLOSED, 0);
     
     return ESP_OK;
 }
 
-esp_err_t garage_door_stop(void)
+static esp_err_t stop_door(void)
 {
     if (!s_initialized) {
         return ESP_ERR_INVALID_STATE;
     }
     
-    xSemaphoreTake(s_state_mutex, portMAX_DELAY);
+    LOCK_TAKE(s_state_mutex);
     door_state_t state = s_current_state;
-    xSemaphoreGive(s_state_mutex);
+    LOCK_GIVE(s_state_mutex);
     
     if (state == DOOR_STATE_CLOSED || state == DOOR_STATE_OPEN) {
         return ESP_OK;
     }
     
+    /* A pulse the relay refuses for now is sent from the pulse timer */
+    LOCK_TAKE(s_state_mutex);
+    s_plan_target = PLANNER_STOPPED;
+    s_plan_active = true;
+    advance_plan_locked();
+    LOCK_GIVE(s_state_mutex);
     update_state(DOOR_STATE_STOPPED);
     
-    if (s_timeout_timer) {
-        esp_timer_stop(s_timeout_timer);
-    }
-    
     return ESP_OK;
 }
 
+/*
+ * Commands are traced with their entry time so a replay issues them at the same moment.
+ * A command not issued through Matter gets a correlation ID of its own for its spans.
+ */
+esp_err_t garage_door_open(void)
+{
+    uint32_t start = TRACE_NOW();
+    uint16_t corr = SPAN_CORR_ENTER();
+    SPAN_BEGIN(SPAN_DOOR_COMMAND);
+    esp_err_t ret = open_door();
+    SPAN_END(SPAN_DOOR_COMMAND);
+    SPAN_CORR_SET(corr);
+    TRACE_AT(start, TRACE_COMMAND, TRACE_CMD_OPEN, ret);
+    return ret;
+}
+
+esp_err_t garage_door_close(void)
+{
+    uint32_t start = TRACE_NOW();
+    uint16_t corr = SPAN_CORR_ENTER();
+    SPAN_BEGIN(SPAN_DOOR_COMMAND);
+    esp_err_t ret = close_door();
+    SPAN_END(SPAN_DOOR_COMMAND);
+    SPAN_CORR_SET(corr);
+    TRACE_AT(start, TRACE_COMMAND, TRACE_CMD_CLOSE, ret);
+    return ret;
+}
+
+esp_err_t garage_door_stop(void)
+{
+    uint32_t start = TRACE_NOW();
+    uint16_t corr = SPAN_CORR_ENTER();
+    SPAN_BEGIN(SPAN_DOOR_COMMAND);
+    esp_err_t ret = stop_door();
+    SPAN_END(SPAN_DOOR_COMMAND);
+    SPAN_CORR_SET(corr);
+    TRACE_AT(start, TRACE_COMMAND, TRACE_CMD_STOP, ret);
+    return ret;
+}
+
 door_state_t garage_door_get_state(void)
 {
     door_state_t state;
-    xSemaphoreTake(s_state_mutex, portMAX_DELAY);
+    LOCK_TAKE(s_state_mutex);
     state = s_current_state;
-    xSemaphoreGive(s_state_mutex);
+    LOCK_GIVE(s_state_mutex);
     return state;
 }
 
@@ -267,8 +747,27 @@ esp_err_t garage_door_set_timeout(uint32_t timeout_ms)
     if (timeout_ms < 1000) {
         return ESP_ERR_INVALID_ARG;
     }
+#if CONFIG_GARAGE_FIXED_CONFIG
+    return ESP_ERR_NOT_SUPPORTED;
+#else
     s_timeout_ms = timeout_ms;
     return ESP_OK;
+#endif
+}
+
+esp_err_t garage_door_set_actuation_retry(bool enable)
+{
+#if CONFIG_GARAGE_FIXED_CONFIG
+    return ESP_ERR_NOT_SUPPORTED;
+#else
+    s_actuation_retry = enable;
+    return ESP_OK;
+#endif
+}
+
+uint32_t garage_door_motion_start_window_ms(void)
+{
+    return motion_start_window_ms();
 }
 
 esp_err_t garage_door_register_state_callback(door_state_callback_t callback)
@@ -276,8 +775,19 @@ esp_err_t garage_door_register_state_callback(door_state_callback_t callback)
     if (!callback) {
         return ESP_ERR_INVALID_ARG;
     }
-    s_state_callback = callback;
-    return ESP_OK;
+    if (!s_initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    /* update_state() walks the array under the same mutex */
+    esp_err_t ret = ESP_OK;
+    LOCK_TAKE(s_state_mutex);
+    if (s_state_callback_count >= MAX_STATE_CALLBACKS) {
+        ret = ESP_ERR_NO_MEM;
+    } else {
+        s_state_callbacks[s_state_callback_count++] = callback;
+    }
+    LOCK_GIVE(s_state_mutex);
+    return ret;
 }
 
 const char *garage_door_state_to_string(door_state_t state)
@@ -4,6 +4,10 @@
 #include <stdbool.h>
 #include "esp_err.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 typedef enum {
     DOOR_STATE_CLOSED = 0,
     DOOR_STATE_OPENING = 1,
@@ -15,6 +19,18 @@ typedef enum {
 
 typedef void (*door_state_callback_t)(door_state_t state);
 
+#define GARAGE_DOOR_DEFAULT_TIMEOUT_MS 30000
+/* The safety check samples the reeds this often while the door moves */
+#define GARAGE_DOOR_SAFETY_CHECK_INTERVAL_MS 100
+/*
+ * Motion-start confirmation: the reed at the end stop the door departs from
+ * must release within a window after the pulse, or the opener never acted on
+ * it. The window is twice the learned pulse-to-release latency within these
+ * bounds, and the maximum until a start has been seen.
+ */
+#define GARAGE_DOOR_MOTION_START_GRACE_MS 2000
+#define GARAGE_DOOR_MOTION_START_MIN_MS 1000
+
 esp_err_t garage_door_init(void);
 esp_err_t garage_door_deinit(void);
 esp_err_t garage_door_open(void);
@@ -22,6 +38,20 @@ esp_err_t garage_door_close(void);
 esp_err_t garage_door_stop(void);
 door_state_t garage_door_get_state(void);
 bool garage_door_is_moving(void);
+/* ESP_ERR_NOT_SUPPORTED with CONFIG_GARAGE_FIXED_CONFIG (CONFIG_GARAGE_DOOR_TIMEOUT_MS) */
 esp_err_t garage_door_set_timeout(uint32_t timeout_ms);
+/*
+ * A door that has not left its end stop within the motion-start window after
+ * the pulse gets one more pulse before it is reported as EVENT_TYPE_NO_ACTUATION.
+ * ESP_ERR_NOT_SUPPORTED with CONFIG_GARAGE_FIXED_CONFIG (CONFIG_GARAGE_DOOR_ACTUATION_RETRY)
+ */
+esp_err_t garage_door_set_actuation_retry(bool enable);
+/* Learned from the reed releases seen since boot */
+uint32_t garage_door_motion_start_window_ms(void);
+/* After garage_door_init(); callbacks run under the door state mutex and must not take locks a command holds */
 esp_err_t garage_door_register_state_callback(door_state_callback_t callback);
-const char *garage_door_state_to_string(door_state_t state);
\ No newline at end of file
+const char *garage_door_state_to_string(door_state_t state);
+
+#ifdef __cplusplus
+}
+#endif
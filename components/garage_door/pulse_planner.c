@@ -0,0 +1,102 @@
+#include "pulse_planner.h"
+
+static bool moving(planner_motion_t motion)
+{
+    return motion != PLANNER_STOPPED;
+}
+
+void pulse_planner_reset(pulse_planner_t *planner, door_position_t pos)
+{
+    planner->motion = PLANNER_STOPPED;
+    planner->at = pos;
+    if (pos == DOOR_POSITION_OPEN) {
+        planner->last = PLANNER_UP;
+    } else if (pos == DOOR_POSITION_CLOSED) {
+        planner->last = PLANNER_DOWN;
+    } else {
+        planner->last = PLANNER_STOPPED;
+    }
+}
+
+void pulse_planner_on_pulse(pulse_planner_t *planner)
+{
+    if (moving(planner->motion)) {
+        planner->last = planner->motion;
+        planner->motion = PLANNER_STOPPED;
+    } else if (planner->at == DOOR_POSITION_CLOSED) {
+        planner->motion = PLANNER_UP;
+    } else if (planner->at == DOOR_POSITION_OPEN) {
+        planner->motion = PLANNER_DOWN;
+    } else if (planner->last == PLANNER_UP) {
+        planner->motion = PLANNER_DOWN;
+    } else if (planner->last == PLANNER_DOWN) {
+        planner->motion = PLANNER_UP;
+    } else {
+        planner->motion = PLANNER_MOVING;
+    }
+}
+
+void pulse_planner_settle(pulse_planner_t *planner)
+{
+    if (!moving(planner->motion)) {
+        return;
+    }
+    if (planner->at == DOOR_POSITION_BETWEEN) {
+        planner->motion = PLANNER_STOPPED;
+        planner->last = PLANNER_STOPPED;
+    } else {
+        pulse_planner_reset(planner, planner->at);
+    }
+}
+
+bool pulse_planner_on_reed(pulse_planner_t *planner, door_position_t pos)
+{
+    bool expected = true;
+    door_position_t from = planner->at;
+    planner->at = pos;
+    switch (pos) {
+        case DOOR_POSITION_OPEN:
+            expected = planner->motion != PLANNER_DOWN;
+            planner->motion = PLANNER_STOPPED;
+            planner->last = PLANNER_UP;
+            break;
+        case DOOR_POSITION_CLOSED:
+            expected = planner->motion != PLANNER_UP;
+            planner->motion = PLANNER_STOPPED;
+            planner->last = PLANNER_DOWN;
+            break;
+        case DOOR_POSITION_BETWEEN:
+            /* Leaving an end stop shows the direction, whoever pressed the button */
+            if (from == DOOR_POSITION_CLOSED) {
+                expected = planner->motion != PLANNER_DOWN;
+                planner->motion = PLANNER_UP;
+            } else if (from == DOOR_POSITION_OPEN) {
+                expected = planner->motion != PLANNER_UP;
+                planner->motion = PLANNER_DOWN;
+            }
+            break;
+        default:
+            break;
+    }
+    return expected;
+}
+
+static bool reached(planner_motion_t motion, planner_motion_t target)
+{
+    if (target == PLANNER_STOPPED) {
+        return motion == PLANNER_STOPPED;
+    }
+    return motion == target || motion == PLANNER_MOVING;
+}
+
+int pulse_planner_plan(const pulse_planner_t *planner, planner_motion_t target)
+{
+    pulse_planner_t model = *planner;
+    for (int pulses = 0; pulses <= PULSE_PLANNER_MAX_PULSES; pulses++) {
+        if (reached(model.motion, target)) {
+            return pulses;
+        }
+        pulse_planner_on_pulse(&model);
+    }
+    return -1;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "reed_switch.h"
+
+/*
+ * Model of a single-button (toggle) opener. Each pulse starts the door away
+ * from the end stop it rests at, stops it while it moves, and after a stop
+ * between the end stops reverses the direction it last moved in. The model
+ * follows the pulses the firmware sends and the debounced reed transitions,
+ * which also pick up wall-button use at the end stops, and plans the shortest
+ * pulse sequence to a target motion. Pure functions over a value, so the host
+ * tests drive it directly.
+ */
+
+typedef enum {
+    PLANNER_STOPPED = 0,
+    PLANNER_UP,
+    PLANNER_DOWN,
+    PLANNER_MOVING, /* Started between the stops with no known last direction */
+} planner_motion_t;
+
+typedef struct {
+    planner_motion_t motion;
+    planner_motion_t last;   /* Direction of the latest travel; PLANNER_STOPPED: unknown */
+    door_position_t at;      /* Latest reed position */
+} pulse_planner_t;
+
+/* No pulse plans to more than stop and reverse */
+#define PULSE_PLANNER_MAX_PULSES 3
+
+/* Door at rest at pos, last direction unknown unless pos is an end stop */
+void pulse_planner_reset(pulse_planner_t *planner, door_position_t pos);
+void pulse_planner_on_pulse(pulse_planner_t *planner);
+/*
+ * The door is known to rest: motion inferred from the reeds alone (a wall
+ * button, or contact chatter) is dropped, and between the stops the last
+ * direction becomes unknown.
+ */
+void pulse_planner_settle(pulse_planner_t *planner);
+/* False when the reeds contradict the modelled direction (the door ran the other way) */
+bool pulse_planner_on_reed(pulse_planner_t *planner, door_position_t pos);
+/*
+ * Pulses that leave the opener in target (PLANNER_UP, PLANNER_DOWN or
+ * PLANNER_STOPPED); a door moving in an unknown direction counts as either.
+ * -1 when no sequence gets there, e.g. up while at the open stop.
+ */
+int pulse_planner_plan(const pulse_planner_t *planner, planner_motion_t target);
@@ -3,11 +3,33 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/event_groups.h"
+#include "esp_timer.h"
 #include "garage_door_control.h"
 #include "reed_switch.h"
+#include "poll_scheduler.h"
+#include "matter_events.h"
+#include "metrics.h"
+#include "tlog.h"
+#include "static_alloc.h"
+#include "mem_budget.h"
+#include "span.h"
+
+#if CONFIG_OPENTHREAD_ENABLED
+#include "esp_openthread.h"
+#include "esp_openthread_lock.h"
+#include "openthread/link.h"
+#include "openthread/thread.h"
+#endif
 
 #define TAG "matter_device"
 
+#define MATTER_METRICS(X)             \
+    X(COUNTER, reports)               \
+    X(COUNTER, commands)              \
+    X(COUNTER, events)                \
+    X(GAUGE, poll_period_ms)
+METRICS_GROUP_DEFINE(matter, MATTER_METRICS)
+
 /* Matter node placeholder - will be implemented with ESP-Matter SDK */
 static uint16_t window_covering_endpoint_id = 1;
 
@@ -18,19 +40,75 @@ static uint8_t operational_status = 0x00;        /* Operational: 0x00 = Stall */
 /* Event group for door state changes */
 static EventGroupHandle_t matter_event_group = NULL;
 static const uint8_t MATTER_DOOR_STATE_CHANGED_BIT = BIT0;
+static const uint8_t MATTER_STOP_BIT = BIT1;
+static const uint8_t MATTER_COMMAND_BIT = BIT2;
+static const uint8_t MATTER_LOCAL_ACTIVITY_BIT = BIT3;
+/* Latest state from the door callback, for the poll scheduler on matter_task */
+static door_state_t poll_door_state = DOOR_STATE_UNKNOWN;
+/* Correlation ID of the change being reported; changes coalesced into one report keep the last */
+static uint16_t report_corr = 0;
+/* Next event number to report to subscribers */
+static uint64_t event_cursor = 0;
 
 /* Matter task handle */
 static TaskHandle_t matter_task_handle = NULL;
+
+STATIC_EVENT_GROUP_DEFINE(matter_event_group);
+STATIC_TASK_DEFINE(matter_task, 4096);
 static bool matter_running = false;
 
 /* Forward declarations */
-static void garage_door_command_callback(door_state_t state, void *priv_data);
+static void garage_door_command_callback(door_state_t state);
 static void matter_task(void *pvParameters);
+static void report_new_events(void);
+
+static uint32_t now_ms(void)
+{
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+/* Poll scheduler radio binding; runs on matter_task only, which holds no other lock */
+static esp_err_t thread_set_poll_period(uint32_t period_ms, void *ctx)
+{
+    (void)ctx;
+#if CONFIG_OPENTHREAD_ENABLED
+    esp_openthread_lock_acquire(portMAX_DELAY);
+    otError ot_err = otLinkSetPollPeriod(esp_openthread_get_instance(), period_ms);
+    esp_openthread_lock_release();
+    if (ot_err != OT_ERROR_NONE) {
+        return ESP_FAIL;
+    }
+#endif
+    METRIC_SET(poll_period_ms, period_ms);
+    ESP_LOGD(TAG, "Thread poll period: %" PRIu32 "ms", period_ms);
+    return ESP_OK;
+}
+
+#if CONFIG_OPENTHREAD_ENABLED
+/* The poll period only applies to a child with its receiver off between polls (sleepy end device) */
+static esp_err_t thread_set_sleepy(void)
+{
+    otLinkModeConfig mode = {};
+    mode.mRxOnWhenIdle = false;
+    mode.mDeviceType = false;  /* Minimal Thread device: never a router */
+    mode.mNetworkData = false; /* Stable network data only */
+    esp_openthread_lock_acquire(portMAX_DELAY);
+    otError ot_err = otThreadSetLinkMode(esp_openthread_get_instance(), mode);
+    esp_openthread_lock_release();
+    return ot_err == OT_ERROR_NONE ? ESP_OK : ESP_FAIL;
+}
+#endif
 
 /* Garage door state callback */
-static void garage_door_command_callback(door_state_t state, void *priv_data)
+static void garage_door_command_callback(door_state_t state)
 {
-    ESP_LOGI(TAG, "Garage door state: %s", garage_door_state_to_string(state));
+    TLOGI(TAG, "Garage door state: %s", garage_door_state_to_string(state));
+
+    /*
+     * Runs under the door's state mutex: the poll period change, which takes
+     * the OpenThread lock, waits for matter_task along with the report
+     */
+    __atomic_store_n(&poll_door_state, state, __ATOMIC_RELAXED);
 
     /* Update Matter attributes based on door state */
     uint8_t new_position = 0;
@@ -58,13 +136,13 @@ static void garage_door_command_callback(door_state_t state, void *priv_data)
             break;
 
         case DOOR_STATE_STOPPED:
-        case DOOR_STATE_ERROR:
+        case DOOR_STATE_UNKNOWN:
             new_position = current_position_percentage; /* Keep current */
             new_status = 0x00; /* Stall */
             break;
 
         default:
-            ESP_LOGW(TAG, "Unknown door state: %d", state);
+            TLOGW(TAG, "Unknown door state: %d", state);
             return;
     }
 
@@ -73,7 +151,7 @@ static void garage_door_command_callback(door_state_t state, void *priv_data)
         current_position_percentage = new_position;
     }
 
-    ESP_LOGI(TAG, "Position: %u%%, Status: 0x%02x", new_position, new_status);
+    TLOGI(TAG, "Position: %u%%, Status: 0x%02x", new_position, new_status);
 
     /* TODO: When ESP-Matter is properly configured, update Matter attributes here:
      * - WindowCovering::CurrentPositionLiftPercentage100th
@@ -82,6 +160,7 @@ static void garage_door_command_callback(door_state_t state, void *priv_data)
 
     /* Notify event group */
     if (matter_event_group != NULL) {
+        report_corr = SPAN_CORR_GET();
         xEventGroupSetBits(matter_event_group, MATTER_DOOR_STATE_CHANGED_BIT);
     }
 }
@@ -91,14 +170,38 @@ static void matter_task(void *pvParameters)
 {
     ESP_LOGI(TAG, "Matter task started");
 
+    /*
+     * The poll scheduler runs on this task only. It wakes only for the end of
+     * the fast poll window: an idle door costs no wakeups (light sleep)
+     */
+    uint32_t wait_ms = poll_scheduler_tick(now_ms());
     while (matter_running) {
-        /* Wait for door state changes */
+        /* Wait for door state changes and activity */
         EventBits_t bits = xEventGroupWaitBits(matter_event_group,
-                                               MATTER_DOOR_STATE_CHANGED_BIT,
+                                               MATTER_DOOR_STATE_CHANGED_BIT | MATTER_STOP_BIT |
+                                                   MATTER_COMMAND_BIT | MATTER_LOCAL_ACTIVITY_BIT,
+                                               pdTRUE,  /* Clear on exit: one report per change */
                                                pdFALSE,
-                                               pdMS_TO_TICKS(100));
+                                               poll_scheduler_get_mode() == POLL_MODE_IDLE ? portMAX_DELAY
+                                                                                           : pdMS_TO_TICKS(wait_ms));
+
+        /* Door activity opens the fast poll window, which expires once activity has settled */
+        uint32_t now = now_ms();
+        if (bits & MATTER_DOOR_STATE_CHANGED_BIT) {
+            poll_scheduler_on_door_state(__atomic_load_n(&poll_door_state, __ATOMIC_RELAXED), now);
+        }
+        if (bits & MATTER_COMMAND_BIT) {
+            poll_scheduler_on_command(now);
+        }
+        if (bits & MATTER_LOCAL_ACTIVITY_BIT) {
+            poll_scheduler_on_local_activity(now);
+        }
+        wait_ms = poll_scheduler_tick(now);
 
         if (bits & MATTER_DOOR_STATE_CHANGED_BIT) {
+            SPAN_CORR_SET(report_corr);
+            SPAN_BEGIN(SPAN_MATTER_REPORT);
+            METRIC_INC(reports);
             ESP_LOGD(TAG, "Door state changed, would update Matter attributes");
 
             /* TODO: Implement Matter attribute update when SDK is available:
@@ -107,13 +210,37 @@ static void matter_task(void *pvParameters)
              *                                WindowCovering::Attributes::CurrentPositionLiftPercentage100th::Id,
              *                                &position_val);
              */
+            SPAN_END(SPAN_MATTER_REPORT);
+            SPAN_CORR_SET(0);
         }
+
+        /* Events logged since the last wakeup; a fault logged after its state change waits for the next one */
+        report_new_events();
     }
 
     ESP_LOGI(TAG, "Matter task stopped");
     vTaskDelete(NULL);
 }
 
+/* Hands events logged since the last call to subscribers, straight from the event log */
+static void report_new_events(void)
+{
+    matter_event_t events[4];
+    size_t count = 0;
+    do {
+        if (matter_events_read(&event_cursor, events, sizeof(events) / sizeof(events[0]), &count) != ESP_OK) {
+            return;
+        }
+        for (size_t i = 0; i < count; i++) {
+            METRIC_INC(events);
+            ESP_LOGD(TAG, "Event %" PRIu64 ": cluster 0x%04" PRIx32 " event 0x%08" PRIx32 " data %" PRIu32,
+                     events[i].number, events[i].cluster, events[i].event, events[i].data);
+            /* TODO: When ESP-Matter is properly configured, deliver to subscriptions here; reads with
+             * an EventMin are answered by matter_events_read() from the same log. */
+        }
+    } while (count > 0);
+}
+
 /* Initialize Matter device */
 esp_err_t matter_device_init(void)
 {
@@ -122,12 +249,31 @@ esp_err_t matter_device_init(void)
     ESP_LOGW(TAG, "Matter integration in stub mode - ESP-Matter SDK needs proper configuration");
 
     /* Create event group */
-    matter_event_group = xEventGroupCreate();
+    matter_event_group = STATIC_EVENT_GROUP_CREATE(matter_event_group);
     if (matter_event_group == NULL) {
         ESP_LOGE(TAG, "Failed to create event group");
         return ESP_ERR_NO_MEM;
     }
 
+#if CONFIG_OPENTHREAD_ENABLED
+    err = thread_set_sleepy();
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to set the sleepy link mode; the poll period has no effect");
+    }
+#endif
+
+    /* Start with the idle poll period; door events switch to the fast window */
+    poll_policy_t poll_policy;
+    poll_scheduler_get_default_policy(&poll_policy);
+    const poll_radio_t poll_radio = {
+        .set_poll_period = thread_set_poll_period,
+        .ctx = NULL
+    };
+    err = poll_scheduler_init(&poll_policy, &poll_radio, now_ms());
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to start poll scheduler: %s", esp_err_to_name(err));
+    }
+
     /* Register garage door state callback */
     err = garage_door_register_state_callback(garage_door_command_callback);
     if (err != ESP_OK) {
@@ -135,24 +281,32 @@ esp_err_t matter_device_init(void)
         /* Continue anyway - we'll poll state in main loop */
     }
 
+    /* Subscribers get events logged from now on; earlier ones are read by event number */
+    matter_events_next_number(&event_cursor);
+
     /* Initialize current position from garage door state */
     door_state_t initial_state = garage_door_get_state();
     current_position_percentage = (initial_state == DOOR_STATE_OPEN) ? 100 : 0;
 
+    /* Before the task starts: it may preempt the caller (app_main, in static builds) and exit on false */
+    matter_running = true;
+
     /* Create Matter task */
-    BaseType_t ret = xTaskCreate(matter_task,
-                                "matter_task",
-                                4096,
-                                NULL,
-                                2,
-                                &matter_task_handle);
+    BaseType_t ret = STATIC_TASK_CREATE(matter_task,
+                                        matter_task,
+                                        "matter_task",
+                                        NULL,
+                                        2,
+                                        &matter_task_handle);
     if (ret != pdPASS) {
         ESP_LOGE(TAG, "Failed to create Matter task");
+        matter_running = false;
         vEventGroupDelete(matter_event_group);
         return ESP_FAIL;
     }
 
-    matter_running = true;
+    mem_budget_register_static(TAG, STATIC_EVENT_GROUP_BYTES + STATIC_TASK_BYTES(matter_task));
+    mem_budget_register_task(TAG, matter_task_handle, 4096);
 
     ESP_LOGI(TAG, "Matter device initialized in stub mode");
     ESP_LOGI(TAG, "To enable full Matter functionality:");
@@ -171,10 +325,14 @@ esp_err_t matter_device_deinit(void)
     /* Stop Matter task */
     matter_running = false;
     if (matter_task_handle != NULL) {
+        xEventGroupSetBits(matter_event_group, MATTER_STOP_BIT);
+        mem_budget_unregister_task(matter_task_handle);
         vTaskDelay(pdMS_TO_TICKS(100)); /* Give task time to exit */
         matter_task_handle = NULL;
     }
 
+    poll_scheduler_deinit();
+
     /* Delete event group */
     if (matter_event_group != NULL) {
         vEventGroupDelete(matter_event_group);
@@ -200,3 +358,54 @@ void matter_device_update_door_state(uint32_t position, bool is_moving)
 
     ESP_LOGD(TAG, "Matter attribute update would go here");
 }
+
+/* Handle a WindowCovering command: the target of the ESP-Matter command callback */
+esp_err_t matter_device_handle_command(matter_door_command_t command)
+{
+    uint16_t corr = SPAN_CORR_ENTER();
+    SPAN_BEGIN(SPAN_MATTER_COMMAND);
+    matter_device_notify_command();
+
+    esp_err_t ret;
+    switch (command) {
+        case MATTER_DOOR_CMD_UP_OR_OPEN:
+            ret = garage_door_open();
+            break;
+
+        case MATTER_DOOR_CMD_DOWN_OR_CLOSE:
+            ret = garage_door_close();
+            break;
+
+        case MATTER_DOOR_CMD_STOP_MOTION:
+            ret = garage_door_stop();
+            break;
+
+        default:
+            ret = ESP_ERR_INVALID_ARG;
+            break;
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Command %d failed: %s", command, esp_err_to_name(ret));
+    }
+
+    SPAN_END(SPAN_MATTER_COMMAND);
+    SPAN_CORR_SET(corr);
+    return ret;
+}
+
+/* Notify that a Matter command was received */
+void matter_device_notify_command(void)
+{
+    METRIC_INC(commands);
+    if (matter_event_group != NULL) {
+        xEventGroupSetBits(matter_event_group, MATTER_COMMAND_BIT);
+    }
+}
+
+/* Notify local activity not reflected in the door state (e.g. wall button) */
+void matter_device_notify_local_activity(void)
+{
+    if (matter_event_group != NULL) {
+        xEventGroupSetBits(matter_event_group, MATTER_LOCAL_ACTIVITY_BIT);
+    }
+}
@@ -9,9 +9,20 @@
 extern "C" {
 #endif
 
+/* WindowCovering commands, as the ESP-Matter command callback delivers them */
+typedef enum {
+    MATTER_DOOR_CMD_UP_OR_OPEN = 0,
+    MATTER_DOOR_CMD_DOWN_OR_CLOSE = 1,
+    MATTER_DOOR_CMD_STOP_MOTION = 2,
+} matter_door_command_t;
+
 esp_err_t matter_device_init(void);
 esp_err_t matter_device_deinit(void);
 void matter_device_update_door_state(uint32_t position, bool is_moving);
+/* Runs the door command and records its spans (see span.h); ESP_ERR_INVALID_STATE if the door refuses it */
+esp_err_t matter_device_handle_command(matter_door_command_t command);
+void matter_device_notify_command(void);
+void matter_device_notify_local_activity(void);
 
 #ifdef __cplusplus
 }
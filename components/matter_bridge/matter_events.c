@@ -0,0 +1,129 @@
+#include "matter_events.h"
+#include <inttypes.h>
+#include "esp_log.h"
+#include "storage_manager.h"
+
+#define TAG "matter_events"
+
+static uint32_t s_boot_seq = 0;
+
+typedef struct {
+    matter_event_t *events;
+    size_t max_count;
+    size_t count;
+} read_ctx_t;
+
+/* False for journal entries Matter has no event for */
+static bool translate(uint32_t seq, const event_log_t *log, matter_event_t *event)
+{
+    *event = (matter_event_t){
+        .number = seq,
+        .timestamp_ms = log->timestamp,
+        .previous_boot = seq < s_boot_seq,
+        .endpoint = MATTER_EVENTS_DOOR_ENDPOINT,
+        .cluster = MATTER_CLUSTER_WINDOW_COVERING,
+        .priority = MATTER_EVENT_PRIORITY_CRITICAL,
+    };
+
+    switch (log->type) {
+        case EVENT_TYPE_DOOR_OPEN:
+        case EVENT_TYPE_DOOR_CLOSED:
+            event->event = MATTER_EVENT_MOVEMENT_STARTED;
+            event->priority = MATTER_EVENT_PRIORITY_INFO;
+            event->data = log->type == EVENT_TYPE_DOOR_OPEN ? 100 : 0;
+            return true;
+
+        case EVENT_TYPE_TIMEOUT:
+            event->event = MATTER_EVENT_SAFETY_FAULT;
+            event->data = MATTER_SAFETY_POSITION_FAILURE;
+            return true;
+
+        case EVENT_TYPE_OBSTRUCTION:
+            event->event = MATTER_EVENT_SAFETY_FAULT;
+            event->data = MATTER_SAFETY_OBSTACLE_DETECTED;
+            return true;
+
+        case EVENT_TYPE_NO_ACTUATION:
+            event->event = MATTER_EVENT_SAFETY_FAULT;
+            event->data = MATTER_SAFETY_FAILED_COMMUNICATION;
+            return true;
+
+        case EVENT_TYPE_ERROR:
+            event->endpoint = MATTER_EVENTS_ROOT_ENDPOINT;
+            event->cluster = MATTER_CLUSTER_GENERAL_DIAGNOSTICS;
+            event->event = MATTER_EVENT_HARDWARE_FAULT_CHANGE;
+            event->data = MATTER_HARDWARE_FAULT_UNSPECIFIED;
+            return true;
+
+        case EVENT_TYPE_LIVENESS:
+            event->endpoint = MATTER_EVENTS_ROOT_ENDPOINT;
+            event->cluster = MATTER_CLUSTER_SOFTWARE_DIAGNOSTICS;
+            event->event = MATTER_EVENT_SOFTWARE_FAULT;
+            event->priority = MATTER_EVENT_PRIORITY_INFO;
+            event->data = (uint32_t)log->value;
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+static bool visit(uint32_t seq, const event_log_t *log, void *ctx)
+{
+    read_ctx_t *read = ctx;
+    if (translate(seq, log, &read->events[read->count])) {
+        read->count++;
+    }
+    return read->count < read->max_count;
+}
+
+esp_err_t matter_events_init(void)
+{
+    uint32_t oldest = 0;
+    esp_err_t ret = storage_log_range(&oldest, &s_boot_seq);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Event journal unavailable: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    ESP_LOGI(TAG, "Serving events %" PRIu32 "..%" PRIu32 " from the event log", oldest, s_boot_seq);
+    return ESP_OK;
+}
+
+esp_err_t matter_events_read(uint64_t *event_min, matter_event_t *events, size_t max_count, size_t *count)
+{
+    if (!event_min || !events || max_count == 0 || !count) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    *count = 0;
+    if (*event_min > UINT32_MAX) {
+        return ESP_OK;
+    }
+    read_ctx_t read = {
+        .events = events,
+        .max_count = max_count,
+        .count = 0,
+    };
+    uint32_t cursor = (uint32_t)*event_min;
+    esp_err_t ret = storage_visit_logs(&cursor, visit, &read);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    *event_min = cursor;
+    *count = read.count;
+    return ESP_OK;
+}
+
+esp_err_t matter_events_next_number(uint64_t *next)
+{
+    if (!next) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    uint32_t oldest = 0;
+    uint32_t seq = 0;
+    esp_err_t ret = storage_log_range(&oldest, &seq);
+    if (ret == ESP_OK) {
+        *next = seq;
+    }
+    return ret;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Matter events served from the event log (storage_log_event()).
+ *
+ * Door movements, timeouts, obstructions and faults are already persisted in
+ * the NVS event journal. Rather than copying them into an event buffer of the
+ * Matter stack, a read translates journal entries as it walks them: the
+ * journal sequence number is the event number, so numbers stay monotonic
+ * across reboots without an epoch of their own, and a read from EventMin
+ * costs one NVS lookup per retained event from there on. Journal entries
+ * with no Matter counterpart (rules, commissioning) leave gaps in the
+ * numbering, which EventMin filtering allows.
+ *
+ * Plain C over storage_manager, so it runs unchanged on the host.
+ */
+
+#define MATTER_EVENTS_DOOR_ENDPOINT 1 /* WindowCovering endpoint */
+#define MATTER_EVENTS_ROOT_ENDPOINT 0 /* Diagnostics clusters */
+
+#define MATTER_CLUSTER_GENERAL_DIAGNOSTICS  0x0033
+#define MATTER_CLUSTER_SOFTWARE_DIAGNOSTICS 0x0034
+#define MATTER_CLUSTER_WINDOW_COVERING      0x0102
+
+/* WindowCovering defines no events: manufacturer-specific ones under the test vendor prefix */
+#define MATTER_EVENTS_MFG_PREFIX            0xFFF10000u
+#define MATTER_EVENT_MOVEMENT_STARTED       (MATTER_EVENTS_MFG_PREFIX | 0x00) /* data: target lift percent */
+#define MATTER_EVENT_SAFETY_FAULT           (MATTER_EVENTS_MFG_PREFIX | 0x01) /* data: SafetyStatus bits */
+#define MATTER_EVENT_HARDWARE_FAULT_CHANGE  0x00 /* GeneralDiagnostics; data: HardwareFaultEnum now active */
+#define MATTER_EVENT_SOFTWARE_FAULT         0x00 /* SoftwareDiagnostics; data: liveness entry << 8 | action */
+
+/* WindowCovering SafetyStatus bits */
+#define MATTER_SAFETY_FAILED_COMMUNICATION 0x0004 /* The opener did not act on the relay pulse */
+#define MATTER_SAFETY_POSITION_FAILURE     0x0008 /* No end stop within the operation timeout */
+#define MATTER_SAFETY_OBSTACLE_DETECTED    0x0020 /* Door back at the end stop it left */
+
+#define MATTER_HARDWARE_FAULT_UNSPECIFIED 0
+
+typedef enum {
+    MATTER_EVENT_PRIORITY_DEBUG = 0,
+    MATTER_EVENT_PRIORITY_INFO = 1,
+    MATTER_EVENT_PRIORITY_CRITICAL = 2,
+} matter_event_priority_t;
+
+typedef struct {
+    uint64_t number;                  /* Journal sequence number */
+    uint32_t timestamp_ms;            /* System time of the boot that logged it */
+    bool previous_boot;               /* timestamp_ms is from an earlier boot, not comparable with now */
+    uint16_t endpoint;
+    uint32_t cluster;
+    uint32_t event;
+    matter_event_priority_t priority;
+    uint32_t data;                    /* Per event, see the event IDs */
+} matter_event_t;
+
+/* Marks the boot, once storage is up: events logged from here on get previous_boot false */
+esp_err_t matter_events_init(void);
+/*
+ * Fills 'events' with up to max_count events numbered *event_min or later,
+ * oldest first, and moves *event_min past the last journal entry examined.
+ * Events already overwritten in the journal are skipped; *count 0 means the
+ * reader is up to date.
+ */
+esp_err_t matter_events_read(uint64_t *event_min, matter_event_t *events, size_t max_count, size_t *count);
+/* Number the next logged event will get: a subscription is primed once its EventMin reaches it */
+esp_err_t matter_events_next_number(uint64_t *next);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,196 @@
+#include "poll_scheduler.h"
+#include <string.h>
+#include "esp_log.h"
+
+#define TAG "poll_sched"
+
+#define MS_PER_DAY 86400000ULL
+
+static poll_policy_t s_policy;
+static poll_radio_t s_radio;
+static bool s_initialized = false;
+static bool s_moving = false;
+static uint32_t s_window_end_ms = 0;
+static poll_mode_t s_mode = POLL_MODE_IDLE;
+static uint32_t s_period_ms = 0;
+
+static bool policy_is_valid(const poll_policy_t *policy)
+{
+    return policy->idle_period_ms > 0 && policy->active_period_ms > 0 &&
+           policy->active_period_ms <= policy->idle_period_ms;
+}
+
+/* Wrap-safe "a is before b" for 32-bit millisecond timestamps */
+static bool time_before(uint32_t a, uint32_t b)
+{
+    return (int32_t)(a - b) < 0;
+}
+
+static void apply_mode(uint32_t now_ms)
+{
+    poll_mode_t mode = (s_moving || time_before(now_ms, s_window_end_ms)) ? POLL_MODE_ACTIVE : POLL_MODE_IDLE;
+    uint32_t period = (mode == POLL_MODE_ACTIVE) ? s_policy.active_period_ms : s_policy.idle_period_ms;
+
+    if (period == s_period_ms) {
+        s_mode = mode;
+        return;
+    }
+
+    if (s_radio.set_poll_period) {
+        esp_err_t ret = s_radio.set_poll_period(period, s_radio.ctx);
+        if (ret != ESP_OK) {
+            /* Keep the old mode so the next tick retries */
+            ESP_LOGW(TAG, "Failed to set poll period %" PRIu32 "ms: %s", period, esp_err_to_name(ret));
+            return;
+        }
+    }
+
+    ESP_LOGD(TAG, "Poll period %" PRIu32 "ms -> %" PRIu32 "ms", s_period_ms, period);
+    s_mode = mode;
+    s_period_ms = period;
+}
+
+static void extend_window(uint32_t now_ms)
+{
+    uint32_t end = now_ms + s_policy.activity_window_ms;
+    if (time_before(s_window_end_ms, end)) {
+        s_window_end_ms = end;
+    }
+}
+
+esp_err_t poll_scheduler_init(const poll_policy_t *policy, const poll_radio_t *radio, uint32_t now_ms)
+{
+    if (s_initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (!policy || !radio || !policy_is_valid(policy)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    memcpy(&s_policy, policy, sizeof(poll_policy_t));
+    memcpy(&s_radio, radio, sizeof(poll_radio_t));
+    s_moving = false;
+    s_window_end_ms = now_ms;
+    s_mode = POLL_MODE_IDLE;
+    s_period_ms = 0;
+    s_initialized = true;
+
+    apply_mode(now_ms);
+
+    ESP_LOGI(TAG, "Initialized: idle %" PRIu32 "ms, active %" PRIu32 "ms, window %" PRIu32 "ms",
+             s_policy.idle_period_ms, s_policy.active_period_ms, s_policy.activity_window_ms);
+    return ESP_OK;
+}
+
+esp_err_t poll_scheduler_deinit(void)
+{
+    if (!s_initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    memset(&s_radio, 0, sizeof(poll_radio_t));
+    s_initialized = false;
+    return ESP_OK;
+}
+
+void poll_scheduler_on_door_state(door_state_t state, uint32_t now_ms)
+{
+    if (!s_initialized) {
+        return;
+    }
+
+    /* Any state change is local activity; motion pins the fast period until it ends */
+    s_moving = (state == DOOR_STATE_OPENING || state == DOOR_STATE_CLOSING);
+    extend_window(now_ms);
+    apply_mode(now_ms);
+}
+
+void poll_scheduler_on_local_activity(uint32_t now_ms)
+{
+    if (!s_initialized) {
+        return;
+    }
+
+    extend_window(now_ms);
+    apply_mode(now_ms);
+}
+
+void poll_scheduler_on_command(uint32_t now_ms)
+{
+    if (!s_initialized) {
+        return;
+    }
+
+    extend_window(now_ms);
+    apply_mode(now_ms);
+}
+
+uint32_t poll_scheduler_tick(uint32_t now_ms)
+{
+    if (!s_initialized) {
+        return UINT32_MAX;
+    }
+
+    apply_mode(now_ms);
+
+    if (s_moving) {
+        return s_policy.active_period_ms;
+    }
+    if (time_before(now_ms, s_window_end_ms)) {
+        return s_window_end_ms - now_ms;
+    }
+    return s_policy.idle_period_ms;
+}
+
+poll_mode_t poll_scheduler_get_mode(void)
+{
+    return s_mode;
+}
+
+uint32_t poll_scheduler_get_period(void)
+{
+    return s_period_ms;
+}
+
+void poll_scheduler_get_default_policy(poll_policy_t *policy)
+{
+    if (!policy) {
+        return;
+    }
+
+    policy->idle_period_ms = POLL_DEFAULT_IDLE_PERIOD_MS;
+    policy->active_period_ms = POLL_DEFAULT_ACTIVE_PERIOD_MS;
+    policy->activity_window_ms = POLL_DEFAULT_ACTIVITY_WINDOW_MS;
+    policy->radio_on_us = POLL_DEFAULT_RADIO_ON_US;
+}
+
+esp_err_t poll_scheduler_project(const poll_policy_t *policy, const poll_traffic_t *traffic,
+                                 poll_projection_t *projection)
+{
+    if (!policy || !traffic || !projection || !policy_is_valid(policy)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    /* Upper bound: fast windows are assumed never to overlap */
+    uint64_t active_ms = (uint64_t)traffic->door_cycles_per_day *
+                             (traffic->travel_time_ms + policy->activity_window_ms) +
+                         (uint64_t)(traffic->commands_per_day + traffic->local_events_per_day) *
+                             policy->activity_window_ms;
+    if (active_ms > MS_PER_DAY) {
+        active_ms = MS_PER_DAY;
+    }
+    uint64_t idle_ms = MS_PER_DAY - active_ms;
+
+    uint64_t polls = active_ms / policy->active_period_ms + idle_ms / policy->idle_period_ms;
+    uint64_t radio_on_us = polls * policy->radio_on_us;
+    uint32_t radio_on_ms = (policy->radio_on_us + 999) / 1000;
+
+    /* ppm = on_us / (MS_PER_DAY * 1000) * 1e6 */
+    projection->duty_cycle_ppm = (uint32_t)(radio_on_us * 1000 / MS_PER_DAY);
+    projection->polls_per_day = (uint32_t)polls;
+    projection->active_ms_per_day = (uint32_t)active_ms;
+    projection->idle_latency_ms = policy->idle_period_ms + radio_on_ms;
+    projection->active_latency_ms = policy->active_period_ms + radio_on_ms;
+    return ESP_OK;
+}
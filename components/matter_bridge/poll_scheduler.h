@@ -0,0 +1,79 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "garage_door_control.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Thread data-poll scheduler.
+ *
+ * Runs a slow poll period while the door is idle and switches to a fast
+ * period right after local activity, after a command, and for the whole of
+ * OPENING/CLOSING. The decision logic only depends on the events fed in and
+ * the caller-supplied clock, so it runs unchanged on the host against a
+ * stand-in radio.
+ *
+ * Not thread-safe: all calls, and with them the radio binding, come from one
+ * task (matter_task on target), which must not hold locks the radio binding
+ * could wait behind.
+ */
+
+#define POLL_DEFAULT_IDLE_PERIOD_MS     450
+#define POLL_DEFAULT_ACTIVE_PERIOD_MS   100
+#define POLL_DEFAULT_ACTIVITY_WINDOW_MS 30000
+#define POLL_DEFAULT_RADIO_ON_US        4000
+
+typedef struct {
+    uint32_t idle_period_ms;     /* Poll period while idle */
+    uint32_t active_period_ms;   /* Poll period inside the fast window */
+    uint32_t activity_window_ms; /* Fast window after activity or a command */
+    uint32_t radio_on_us;        /* Radio-on time per poll (data request + ack + rx) */
+} poll_policy_t;
+
+typedef enum {
+    POLL_MODE_IDLE = 0,
+    POLL_MODE_ACTIVE = 1
+} poll_mode_t;
+
+/* Radio binding: the Thread stack on target, a recorder in host tests */
+typedef struct {
+    esp_err_t (*set_poll_period)(uint32_t period_ms, void *ctx);
+    void *ctx;
+} poll_radio_t;
+
+/* Expected traffic used to project the cost of a policy */
+typedef struct {
+    uint32_t door_cycles_per_day;   /* Open or close operations */
+    uint32_t travel_time_ms;        /* OPENING/CLOSING duration */
+    uint32_t commands_per_day;      /* Matter commands not followed by motion */
+    uint32_t local_events_per_day;  /* Reed activity without a command */
+} poll_traffic_t;
+
+typedef struct {
+    uint32_t duty_cycle_ppm;        /* Radio-on fraction, parts per million */
+    uint32_t polls_per_day;
+    uint32_t active_ms_per_day;     /* Time spent in the fast window */
+    uint32_t idle_latency_ms;       /* Worst-case command latency while idle */
+    uint32_t active_latency_ms;     /* Worst-case command latency in the fast window */
+} poll_projection_t;
+
+esp_err_t poll_scheduler_init(const poll_policy_t *policy, const poll_radio_t *radio, uint32_t now_ms);
+esp_err_t poll_scheduler_deinit(void);
+void poll_scheduler_on_door_state(door_state_t state, uint32_t now_ms);
+void poll_scheduler_on_local_activity(uint32_t now_ms);
+void poll_scheduler_on_command(uint32_t now_ms);
+uint32_t poll_scheduler_tick(uint32_t now_ms);
+poll_mode_t poll_scheduler_get_mode(void);
+uint32_t poll_scheduler_get_period(void);
+void poll_scheduler_get_default_policy(poll_policy_t *policy);
+esp_err_t poll_scheduler_project(const poll_policy_t *policy, const poll_traffic_t *traffic,
+                                 poll_projection_t *projection);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,296 @@
+#include "delta_ota.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_ota_ops.h"
+#include "esp_partition.h"
+#include "esp_console.h"
+#include "metrics.h"
+#include "tlog.h"
+#include "static_alloc.h"
+#include "mem_budget.h"
+
+#define TAG "delta_ota"
+
+#define OTA_METRICS(X)             \
+    X(COUNTER, updates_started)    \
+    X(COUNTER, updates_applied)    \
+    X(COUNTER, updates_failed)     \
+    X(GAUGE, last_patch_bytes)     \
+    X(GAUGE, last_image_bytes)     \
+    X(GAUGE, last_apply_ms)
+METRICS_GROUP_DEFINE(ota, OTA_METRICS)
+
+static bool s_initialized = false;
+static SemaphoreHandle_t s_mutex = NULL;
+static delta_patch_t s_patch; /* Bounded: the only buffers an update uses */
+static delta_ota_state_t s_state = DELTA_OTA_IDLE;
+static esp_err_t s_error = ESP_OK;
+static const esp_partition_t *s_running = NULL;
+static const esp_partition_t *s_update = NULL;
+static esp_ota_handle_t s_handle = 0;
+static int64_t s_start_us = 0;
+static uint32_t s_elapsed_ms = 0;
+
+STATIC_MUTEX_DEFINE(s_mutex);
+
+static esp_err_t read_running(void *ctx, size_t offset, void *buf, size_t len)
+{
+    return esp_partition_read(s_running, offset, buf, len);
+}
+
+static esp_err_t write_update(void *ctx, const void *buf, size_t len)
+{
+    return esp_ota_write(s_handle, buf, len);
+}
+
+/* Caller holds s_mutex */
+static void fail(esp_err_t err)
+{
+    esp_ota_abort(s_handle);
+    delta_patch_release(&s_patch);
+    s_elapsed_ms = (uint32_t)((esp_timer_get_time() - s_start_us) / 1000);
+    s_state = DELTA_OTA_FAILED;
+    s_error = err;
+    METRIC_INC(updates_failed);
+    TLOGW(TAG, "Update failed after %" PRIu32 " patch bytes: %s", s_patch.stats.patch_bytes, esp_err_to_name(err));
+}
+
+esp_err_t delta_ota_init(void)
+{
+    if (s_initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    s_mutex = STATIC_MUTEX_CREATE(s_mutex);
+    if (!s_mutex) {
+        return ESP_ERR_NO_MEM;
+    }
+    s_state = DELTA_OTA_IDLE;
+    s_error = ESP_OK;
+    mem_budget_register_static(TAG, STATIC_MUTEX_BYTES + sizeof(s_patch));
+    s_initialized = true;
+    return ESP_OK;
+}
+
+esp_err_t delta_ota_deinit(void)
+{
+    if (!s_initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (s_state == DELTA_OTA_RECEIVING) {
+        esp_ota_abort(s_handle);
+        delta_patch_release(&s_patch);
+    }
+    vSemaphoreDelete(s_mutex);
+    s_mutex = NULL;
+    s_state = DELTA_OTA_IDLE;
+    s_initialized = false;
+    return ESP_OK;
+}
+
+esp_err_t delta_ota_begin(void)
+{
+    if (!s_initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    LOCK_TAKE(s_mutex);
+    if (s_state == DELTA_OTA_RECEIVING) {
+        LOCK_GIVE(s_mutex);
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    s_running = esp_ota_get_running_partition();
+    s_update = esp_ota_get_next_update_partition(NULL);
+    if (!s_running || !s_update) {
+        LOCK_GIVE(s_mutex);
+        ESP_LOGE(TAG, "No OTA slot to update (single-app partition table?)");
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    /* Sequential writes erase the slot sector by sector as the image grows */
+    esp_err_t ret = esp_ota_begin(s_update, OTA_WITH_SEQUENTIAL_WRITES, &s_handle);
+    if (ret != ESP_OK) {
+        LOCK_GIVE(s_mutex);
+        return ret;
+    }
+
+    const delta_io_t io = {
+        .read_old = read_running,
+        .write_new = write_update,
+        .old_capacity = s_running->size,
+        .new_capacity = s_update->size,
+    };
+    ret = delta_patch_begin(&s_patch, &io);
+    if (ret != ESP_OK) {
+        esp_ota_abort(s_handle);
+        LOCK_GIVE(s_mutex);
+        return ret;
+    }
+
+    s_start_us = esp_timer_get_time();
+    s_state = DELTA_OTA_RECEIVING;
+    s_error = ESP_OK;
+    METRIC_INC(updates_started);
+    LOCK_GIVE(s_mutex);
+    TLOGI(TAG, "Delta update %s -> %s", s_running->label, s_update->label);
+    return ESP_OK;
+}
+
+esp_err_t delta_ota_write(const void *data, size_t len)
+{
+    if (!s_initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    LOCK_TAKE(s_mutex);
+    if (s_state != DELTA_OTA_RECEIVING) {
+        LOCK_GIVE(s_mutex);
+        return ESP_ERR_INVALID_STATE;
+    }
+    esp_err_t ret = delta_patch_write(&s_patch, data, len);
+    if (ret != ESP_OK) {
+        fail(ret);
+    }
+    LOCK_GIVE(s_mutex);
+    return ret;
+}
+
+esp_err_t delta_ota_end(void)
+{
+    if (!s_initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    LOCK_TAKE(s_mutex);
+    if (s_state != DELTA_OTA_RECEIVING) {
+        LOCK_GIVE(s_mutex);
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    esp_err_t ret = delta_patch_finish(&s_patch);
+    if (ret != ESP_OK) {
+        fail(ret);
+        LOCK_GIVE(s_mutex);
+        return ret;
+    }
+    delta_patch_release(&s_patch);
+
+    /* Also validates the app image header and its own checksum */
+    ret = esp_ota_end(s_handle);
+    if (ret == ESP_OK) {
+        ret = esp_ota_set_boot_partition(s_update);
+    }
+    if (ret != ESP_OK) {
+        s_state = DELTA_OTA_FAILED;
+        s_error = ret;
+        METRIC_INC(updates_failed);
+        LOCK_GIVE(s_mutex);
+        TLOGW(TAG, "Rebuilt image rejected: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    s_elapsed_ms = (uint32_t)((esp_timer_get_time() - s_start_us) / 1000);
+    s_state = DELTA_OTA_READY;
+    METRIC_INC(updates_applied);
+    METRIC_SET(last_patch_bytes, s_patch.stats.patch_bytes);
+    METRIC_SET(last_image_bytes, s_patch.stats.out_bytes);
+    METRIC_SET(last_apply_ms, s_elapsed_ms);
+    LOCK_GIVE(s_mutex);
+    TLOGI(TAG, "Image of %" PRIu32 " bytes from a %" PRIu32 " byte patch in %" PRIu32 " ms; boots from %s",
+          s_patch.stats.out_bytes, s_patch.stats.patch_bytes, s_elapsed_ms, s_update->label);
+    return ESP_OK;
+}
+
+esp_err_t delta_ota_abort(void)
+{
+    if (!s_initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    LOCK_TAKE(s_mutex);
+    if (s_state != DELTA_OTA_RECEIVING) {
+        LOCK_GIVE(s_mutex);
+        return ESP_ERR_INVALID_STATE;
+    }
+    esp_ota_abort(s_handle);
+    delta_patch_release(&s_patch);
+    s_state = DELTA_OTA_IDLE;
+    LOCK_GIVE(s_mutex);
+    return ESP_OK;
+}
+
+void delta_ota_get_status(delta_ota_status_t *status)
+{
+    if (!status) {
+        return;
+    }
+    if (!s_initialized) {
+        *status = (delta_ota_status_t){.state = DELTA_OTA_IDLE};
+        return;
+    }
+
+    LOCK_TAKE(s_mutex);
+    status->state = s_state;
+    status->error = s_error;
+    status->stats = s_patch.stats;
+    status->elapsed_ms = s_state == DELTA_OTA_RECEIVING
+                             ? (uint32_t)((esp_timer_get_time() - s_start_us) / 1000)
+                             : s_elapsed_ms;
+    LOCK_GIVE(s_mutex);
+}
+
+esp_err_t delta_ota_confirm_running(void)
+{
+    return esp_ota_mark_app_valid_cancel_rollback();
+}
+
+static const char *state_name(delta_ota_state_t state)
+{
+    switch (state) {
+        case DELTA_OTA_IDLE: return "idle";
+        case DELTA_OTA_RECEIVING: return "receiving";
+        case DELTA_OTA_READY: return "ready, reboot to apply";
+        case DELTA_OTA_FAILED: return "failed";
+        default: return "?";
+    }
+}
+
+static int ota_cmd(int argc, char **argv)
+{
+    const esp_partition_t *running = esp_ota_get_running_partition();
+    const esp_partition_t *next = esp_ota_get_next_update_partition(NULL);
+    printf("running %s, update slot %s\n", running ? running->label : "?", next ? next->label : "none");
+
+    delta_ota_status_t status;
+    delta_ota_get_status(&status);
+    printf("state: %s", state_name(status.state));
+    if (status.state == DELTA_OTA_FAILED) {
+        printf(" (%s)", esp_err_to_name(status.error));
+    }
+    printf("\n");
+    if (status.state == DELTA_OTA_IDLE) {
+        return 0;
+    }
+
+    const delta_patch_stats_t *st = &status.stats;
+    printf("patch %" PRIu32 " bytes -> image %" PRIu32 " bytes (%" PRIu32 " copied, %" PRIu32 " inserted, %" PRIu32
+           " edits, %" PRIu32 " checkpoints) in %" PRIu32 " ms\n",
+           st->patch_bytes, st->out_bytes, st->copied_bytes, st->inserted_bytes, st->edits, st->checkpoints,
+           status.elapsed_ms);
+    return 0;
+}
+
+esp_err_t delta_ota_register_console_command(void)
+{
+    const esp_console_cmd_t cmd = {
+        .command = "ota",
+        .help = "Show OTA slots and the progress of the current or last delta update",
+        .hint = NULL,
+        .func = &ota_cmd,
+    };
+    return esp_console_cmd_register(&cmd);
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "delta_patch.h"
+
+/*
+ * Delta firmware update into the inactive OTA slot. A patch made by
+ * tools/delta_diff.py against the running image is streamed in with
+ * delta_ota_write() in blocks as the transport receives them (the Matter OTA
+ * requestor's BDX download); the new image is rebuilt from the running slot
+ * and the patch as it arrives, so nothing larger than one block is buffered.
+ * delta_ota_end() verifies the image and selects it for the next boot; the
+ * new firmware confirms itself with delta_ota_confirm_running() once it is up,
+ * otherwise the bootloader rolls back (CONFIG_BOOTLOADER_APP_ROLLBACK_ENABLE).
+ *
+ * Needs a partition table with two OTA slots (partitions_ota.csv).
+ */
+
+typedef enum {
+    DELTA_OTA_IDLE,
+    DELTA_OTA_RECEIVING,
+    DELTA_OTA_READY,  /* Verified and selected for the next boot */
+    DELTA_OTA_FAILED,
+} delta_ota_state_t;
+
+typedef struct {
+    delta_ota_state_t state;
+    esp_err_t error;           /* Why the last update failed */
+    delta_patch_stats_t stats; /* Of the current or last update */
+    uint32_t elapsed_ms;       /* From begin to end (or now, while receiving) */
+} delta_ota_status_t;
+
+esp_err_t delta_ota_init(void);
+/* Aborts an update in progress */
+esp_err_t delta_ota_deinit(void);
+esp_err_t delta_ota_begin(void);
+esp_err_t delta_ota_write(const void *data, size_t len);
+esp_err_t delta_ota_end(void);
+esp_err_t delta_ota_abort(void);
+void delta_ota_get_status(delta_ota_status_t *status);
+/* Cancels the rollback of a freshly updated image; call once the door is up */
+esp_err_t delta_ota_confirm_running(void);
+esp_err_t delta_ota_register_console_command(void);
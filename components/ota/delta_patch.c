@@ -0,0 +1,369 @@
+#include "delta_patch.h"
+#include <string.h>
+
+#define RECORD_MAX_SIZE 16 /* Opcode and three 5-byte varints */
+#define EDIT_MAX_SIZE   6
+
+static uint32_t get_u32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/* Returns the bytes used, 0 if more are needed, -1 if malformed */
+static int get_varint(const uint8_t *buf, size_t len, uint32_t *value)
+{
+    uint32_t result = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (i == 4 && buf[i] > 0x0F) {
+            return -1;
+        }
+        result |= (uint32_t)(buf[i] & 0x7F) << (7 * i);
+        if (!(buf[i] & 0x80)) {
+            *value = result;
+            return (int)i + 1;
+        }
+    }
+    return len >= 5 ? -1 : 0;
+}
+
+static esp_err_t fail(delta_patch_t *patch, esp_err_t err)
+{
+    patch->state = DELTA_STATE_FAILED;
+    patch->error = err;
+    return err;
+}
+
+static esp_err_t flush(delta_patch_t *patch)
+{
+    if (patch->out_len == 0) {
+        return ESP_OK;
+    }
+    esp_err_t ret = patch->io.write_new(patch->io.ctx, patch->out, patch->out_len);
+    patch->out_len = 0;
+    return ret;
+}
+
+/* Output bytes are hashed as they are produced, before staging */
+static esp_err_t emit(delta_patch_t *patch, const uint8_t *data, size_t len)
+{
+    if (patch->stats.out_bytes + len > patch->new_size) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    mbedtls_sha256_update(&patch->hash, data, len);
+    patch->stats.out_bytes += len;
+    while (len > 0) {
+        size_t n = DELTA_PATCH_BUF_SIZE - patch->out_len;
+        if (n > len) {
+            n = len;
+        }
+        memcpy(&patch->out[patch->out_len], data, n);
+        patch->out_len += n;
+        data += n;
+        len -= n;
+        if (patch->out_len == DELTA_PATCH_BUF_SIZE) {
+            esp_err_t ret = flush(patch);
+            if (ret != ESP_OK) {
+                return ret;
+            }
+        }
+    }
+    return ESP_OK;
+}
+
+/* Reads old image bytes straight into the staging buffer */
+static esp_err_t copy_old(delta_patch_t *patch, uint32_t len)
+{
+    if (patch->stats.out_bytes + len > patch->new_size) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    while (len > 0) {
+        size_t n = DELTA_PATCH_BUF_SIZE - patch->out_len;
+        if (n > len) {
+            n = len;
+        }
+        uint8_t *dst = &patch->out[patch->out_len];
+        esp_err_t ret = patch->io.read_old(patch->io.ctx, patch->copy_offset, dst, n);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+        mbedtls_sha256_update(&patch->hash, dst, n);
+        patch->out_len += n;
+        patch->copy_offset += n;
+        patch->copy_remaining -= n;
+        patch->stats.out_bytes += n;
+        patch->stats.copied_bytes += n;
+        len -= n;
+        if (patch->out_len == DELTA_PATCH_BUF_SIZE) {
+            ret = flush(patch);
+            if (ret != ESP_OK) {
+                return ret;
+            }
+        }
+    }
+    return ESP_OK;
+}
+
+static esp_err_t parse_header(delta_patch_t *patch)
+{
+    const uint8_t *h = patch->field;
+    if (h[0] != 'G' || h[1] != 'D' || h[2] != 'P' || h[3] != DELTA_PATCH_VERSION) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    patch->old_size = get_u32(&h[4]);
+    patch->new_size = get_u32(&h[8]);
+    memcpy(patch->new_hash, &h[44], sizeof(patch->new_hash));
+    if (patch->old_size > patch->io.old_capacity || patch->new_size > patch->io.new_capacity) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    /* The base must match before the first byte is written to the slot */
+    uint8_t digest[32];
+    mbedtls_sha256_starts(&patch->hash, 0);
+    for (uint32_t offset = 0; offset < patch->old_size; offset += DELTA_PATCH_BUF_SIZE) {
+        size_t n = patch->old_size - offset;
+        if (n > DELTA_PATCH_BUF_SIZE) {
+            n = DELTA_PATCH_BUF_SIZE;
+        }
+        esp_err_t ret = patch->io.read_old(patch->io.ctx, offset, patch->out, n);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+        mbedtls_sha256_update(&patch->hash, patch->out, n);
+    }
+    mbedtls_sha256_finish(&patch->hash, digest);
+    if (memcmp(digest, &h[12], sizeof(digest)) != 0) {
+        return ESP_ERR_INVALID_VERSION;
+    }
+
+    mbedtls_sha256_starts(&patch->hash, 0);
+    patch->state = DELTA_STATE_RECORD;
+    return ESP_OK;
+}
+
+static esp_err_t finish_copy(delta_patch_t *patch)
+{
+    esp_err_t ret = copy_old(patch, patch->copy_remaining);
+    patch->state = DELTA_STATE_RECORD;
+    return ret;
+}
+
+/* Returns ESP_ERR_NOT_FINISHED while the record's fields are incomplete */
+static esp_err_t parse_record(delta_patch_t *patch)
+{
+    const uint8_t *r = patch->field;
+    size_t len = patch->field_len;
+    uint32_t offset, length, edits;
+    int n1, n2, n3;
+
+    switch (r[0]) {
+        case DELTA_OP_END: {
+            esp_err_t ret = flush(patch);
+            if (ret != ESP_OK) {
+                return ret;
+            }
+            if (patch->stats.out_bytes != patch->new_size) {
+                return ESP_ERR_INVALID_ARG;
+            }
+            uint8_t digest[32];
+            mbedtls_sha256_finish(&patch->hash, digest);
+            if (memcmp(digest, patch->new_hash, sizeof(digest)) != 0) {
+                return ESP_ERR_INVALID_CRC;
+            }
+            patch->state = DELTA_STATE_DONE;
+            return ESP_OK;
+        }
+        case DELTA_OP_COPY:
+            n1 = get_varint(&r[1], len - 1, &offset);
+            if (n1 <= 0) {
+                break;
+            }
+            n2 = get_varint(&r[1 + n1], len - 1 - n1, &length);
+            if (n2 <= 0) {
+                n1 = n2;
+                break;
+            }
+            n3 = get_varint(&r[1 + n1 + n2], len - 1 - n1 - n2, &edits);
+            if (n3 <= 0) {
+                n1 = n3;
+                break;
+            }
+            if (offset > patch->old_size || length > patch->old_size - offset || edits > length) {
+                return ESP_ERR_INVALID_ARG;
+            }
+            patch->copy_offset = offset;
+            patch->copy_remaining = length;
+            patch->edits_remaining = edits;
+            if (edits > 0) {
+                patch->state = DELTA_STATE_EDIT;
+                return ESP_OK;
+            }
+            return finish_copy(patch);
+        case DELTA_OP_INSERT:
+            n1 = get_varint(&r[1], len - 1, &length);
+            if (n1 <= 0) {
+                break;
+            }
+            patch->insert_remaining = length;
+            patch->state = length ? DELTA_STATE_INSERT : DELTA_STATE_RECORD;
+            return ESP_OK;
+        case DELTA_OP_CHECK:
+            patch->state = DELTA_STATE_CHECK;
+            return ESP_OK;
+        default:
+            return ESP_ERR_INVALID_ARG;
+    }
+    return n1 < 0 ? ESP_ERR_INVALID_ARG : ESP_ERR_NOT_FINISHED;
+}
+
+/* One edit of a COPY: unchanged old bytes, then one replaced byte */
+static esp_err_t parse_edit(delta_patch_t *patch)
+{
+    uint32_t skip;
+    int n = get_varint(patch->field, patch->field_len, &skip);
+    if (n < 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (n == 0 || patch->field_len < (size_t)n + 1) {
+        return ESP_ERR_NOT_FINISHED;
+    }
+    if (skip >= patch->copy_remaining) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_err_t ret = copy_old(patch, skip);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    ret = emit(patch, &patch->field[n], 1);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    patch->copy_offset++;
+    patch->copy_remaining--;
+    patch->stats.edits++;
+    if (--patch->edits_remaining == 0) {
+        return finish_copy(patch);
+    }
+    return ESP_OK;
+}
+
+static esp_err_t parse_check(delta_patch_t *patch)
+{
+    mbedtls_sha256_context snapshot;
+    uint8_t digest[32];
+    mbedtls_sha256_init(&snapshot);
+    mbedtls_sha256_clone(&snapshot, &patch->hash);
+    mbedtls_sha256_finish(&snapshot, digest);
+    mbedtls_sha256_free(&snapshot);
+    if (memcmp(digest, patch->field, DELTA_PATCH_CHECK_SIZE) != 0) {
+        return ESP_ERR_INVALID_CRC;
+    }
+    patch->stats.checkpoints++;
+    patch->state = DELTA_STATE_RECORD;
+    return ESP_OK;
+}
+
+esp_err_t delta_patch_begin(delta_patch_t *patch, const delta_io_t *io)
+{
+    if (!patch || !io || !io->read_old || !io->write_new) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(patch, 0, sizeof(*patch));
+    patch->io = *io;
+    patch->state = DELTA_STATE_HEADER;
+    mbedtls_sha256_init(&patch->hash);
+    return ESP_OK;
+}
+
+esp_err_t delta_patch_write(delta_patch_t *patch, const uint8_t *data, size_t len)
+{
+    if (!patch || (!data && len > 0)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (patch->state == DELTA_STATE_FAILED) {
+        return patch->error;
+    }
+    if (patch->state == DELTA_STATE_DONE && len > 0) {
+        return fail(patch, ESP_ERR_INVALID_ARG);
+    }
+    patch->stats.patch_bytes += len;
+
+    size_t i = 0;
+    while (i < len) {
+        esp_err_t ret = ESP_OK;
+        size_t n;
+        switch (patch->state) {
+            case DELTA_STATE_HEADER:
+                n = DELTA_PATCH_HEADER_SIZE - patch->field_len;
+                if (n > len - i) {
+                    n = len - i;
+                }
+                memcpy(&patch->field[patch->field_len], &data[i], n);
+                patch->field_len += n;
+                i += n;
+                if (patch->field_len == DELTA_PATCH_HEADER_SIZE) {
+                    patch->field_len = 0;
+                    ret = parse_header(patch);
+                }
+                break;
+            case DELTA_STATE_RECORD:
+            case DELTA_STATE_EDIT:
+                /* Fields are a few bytes: collect one at a time until they parse */
+                patch->field[patch->field_len++] = data[i++];
+                ret = patch->state == DELTA_STATE_RECORD ? parse_record(patch) : parse_edit(patch);
+                if (ret == ESP_ERR_NOT_FINISHED) {
+                    size_t max = patch->state == DELTA_STATE_RECORD ? RECORD_MAX_SIZE : EDIT_MAX_SIZE;
+                    ret = patch->field_len < max ? ESP_OK : ESP_ERR_INVALID_ARG;
+                } else {
+                    patch->field_len = 0;
+                }
+                break;
+            case DELTA_STATE_INSERT:
+                n = patch->insert_remaining;
+                if (n > len - i) {
+                    n = len - i;
+                }
+                ret = emit(patch, &data[i], n);
+                patch->stats.inserted_bytes += n;
+                patch->insert_remaining -= n;
+                i += n;
+                if (patch->insert_remaining == 0) {
+                    patch->state = DELTA_STATE_RECORD;
+                }
+                break;
+            case DELTA_STATE_CHECK:
+                patch->field[patch->field_len++] = data[i++];
+                if (patch->field_len == DELTA_PATCH_CHECK_SIZE) {
+                    patch->field_len = 0;
+                    ret = parse_check(patch);
+                }
+                break;
+            default:
+                /* Bytes after END */
+                ret = ESP_ERR_INVALID_ARG;
+                break;
+        }
+        if (ret != ESP_OK) {
+            return fail(patch, ret);
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t delta_patch_finish(delta_patch_t *patch)
+{
+    if (!patch) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (patch->state == DELTA_STATE_FAILED) {
+        return patch->error;
+    }
+    /* A patch that ends early is as bad as a corrupt one */
+    return patch->state == DELTA_STATE_DONE ? ESP_OK : fail(patch, ESP_ERR_INVALID_SIZE);
+}
+
+void delta_patch_release(delta_patch_t *patch)
+{
+    if (patch) {
+        mbedtls_sha256_free(&patch->hash);
+    }
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "mbedtls/sha256.h"
+
+/*
+ * Streaming applier for delta patches made by tools/delta_diff.py.
+ *
+ * The new image is rebuilt front to back from ranges of the old image (with
+ * a few bytes edited, as relocated addresses are) and inserted literal data,
+ * so it can be written straight into an erased OTA slot while the patch is
+ * still arriving. Patch data may be fed in chunks of any size. RAM use is
+ * the delta_patch_t the caller owns, independent of image and patch size.
+ *
+ * Integrity is checked as the patch streams in: the old image must hash to
+ * the base the patch was made for before anything is written, checkpoints
+ * compare a running SHA-256 of the output every DELTA_PATCH_CHECK_INTERVAL
+ * bytes so a corrupt patch is caught long before the end, and the full hash
+ * of the new image is compared at the end.
+ *
+ * Format, little endian, varints are unsigned LEB128:
+ *   header:  "GDP" version, u32 old size, u32 new size, old SHA-256, new SHA-256
+ *   COPY:    0x01, varint old offset, varint length, varint edit count,
+ *            per edit: varint unchanged bytes before it, u8 new value
+ *   INSERT:  0x02, varint length, data
+ *   CHECK:   0x03, first 8 bytes of the SHA-256 of the output so far
+ *   END:     0x00
+ */
+
+#define DELTA_PATCH_VERSION        1
+#define DELTA_PATCH_HEADER_SIZE    76
+#define DELTA_PATCH_CHECK_SIZE     8
+#define DELTA_PATCH_CHECK_INTERVAL (64 * 1024)
+#define DELTA_PATCH_BUF_SIZE       1024 /* Old image reads and output staging */
+
+typedef enum {
+    DELTA_OP_END = 0x00,
+    DELTA_OP_COPY = 0x01,
+    DELTA_OP_INSERT = 0x02,
+    DELTA_OP_CHECK = 0x03,
+} delta_op_t;
+
+/* Storage callbacks: random-access reads of the old image, sequential writes of the new one */
+typedef struct {
+    esp_err_t (*read_old)(void *ctx, size_t offset, void *buf, size_t len);
+    esp_err_t (*write_new)(void *ctx, const void *buf, size_t len);
+    void *ctx;
+    size_t old_capacity; /* Readable bytes of the old image's partition */
+    size_t new_capacity; /* Size of the slot being written */
+} delta_io_t;
+
+typedef struct {
+    uint32_t patch_bytes;
+    uint32_t out_bytes;
+    uint32_t copied_bytes;
+    uint32_t inserted_bytes;
+    uint32_t edits;
+    uint32_t checkpoints;
+} delta_patch_stats_t;
+
+typedef enum {
+    DELTA_STATE_HEADER,
+    DELTA_STATE_RECORD,
+    DELTA_STATE_EDIT,
+    DELTA_STATE_INSERT,
+    DELTA_STATE_CHECK,
+    DELTA_STATE_DONE,
+    DELTA_STATE_FAILED,
+} delta_state_t;
+
+typedef struct {
+    delta_io_t io;
+    delta_state_t state;
+    esp_err_t error; /* Returned again by every call after a failure */
+    uint8_t field[DELTA_PATCH_HEADER_SIZE]; /* Header or record bytes collected across chunks */
+    size_t field_len;
+    uint32_t old_size;
+    uint32_t new_size;
+    uint8_t new_hash[32];
+    uint32_t copy_offset;    /* Next old byte of the current COPY */
+    uint32_t copy_remaining;
+    uint32_t edits_remaining;
+    uint32_t insert_remaining;
+    uint32_t next_check;     /* Output size at which the next CHECK is due */
+    mbedtls_sha256_context hash;
+    uint8_t out[DELTA_PATCH_BUF_SIZE];
+    size_t out_len;
+    delta_patch_stats_t stats;
+} delta_patch_t;
+
+esp_err_t delta_patch_begin(delta_patch_t *patch, const delta_io_t *io);
+/*
+ * Feeds the next patch bytes. Errors are final: ESP_ERR_NOT_SUPPORTED (not a
+ * patch), ESP_ERR_INVALID_VERSION (made for another old image),
+ * ESP_ERR_INVALID_SIZE (images do not fit), ESP_ERR_INVALID_ARG (malformed),
+ * ESP_ERR_INVALID_CRC (output hash mismatch) or the storage callback's error.
+ */
+esp_err_t delta_patch_write(delta_patch_t *patch, const uint8_t *data, size_t len);
+/* ESP_OK once the END record was applied and the new image verified */
+esp_err_t delta_patch_finish(delta_patch_t *patch);
+/* Frees the hash context; safe after any result */
+void delta_patch_release(delta_patch_t *patch);
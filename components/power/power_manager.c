@@ -0,0 +1,280 @@
+#include "power_manager.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_pm.h"
+#include "esp_sleep.h"
+#include "esp_timer.h"
+#include "esp_console.h"
+#include "sdkconfig.h"
+#include "reed_switch.h"
+#include "metrics.h"
+#include "static_alloc.h"
+#include "mem_budget.h"
+
+#define TAG "power"
+
+#define POWER_METRICS(X)      \
+    X(COUNTER, idle_entries)  \
+    X(GAUGE, sleep_allowed)
+METRICS_GROUP_DEFINE(power, POWER_METRICS)
+
+static bool s_initialized = false;
+static SemaphoreHandle_t s_mutex = NULL;
+static esp_pm_lock_handle_t s_awake_lock = NULL;
+static esp_timer_handle_t s_idle_timer = NULL;
+static bool s_awake = false;   /* s_awake_lock held */
+static bool s_at_rest = false;
+static uint32_t s_idle_entries = 0;
+static int64_t s_stats_since_us = 0;
+
+/* Written by the light sleep callbacks, with interrupts disabled */
+static volatile uint32_t s_sleeps = 0;
+static volatile uint32_t s_sleep_max_us = 0;
+static volatile uint64_t s_slept_us = 0;
+
+STATIC_MUTEX_DEFINE(s_mutex);
+
+#if CONFIG_PM_LIGHT_SLEEP_CALLBACKS
+static esp_err_t IRAM_ATTR sleep_exit(int64_t sleep_time_us, void *arg)
+{
+    s_sleeps++;
+    s_slept_us += (uint64_t)sleep_time_us;
+    if ((uint32_t)sleep_time_us > s_sleep_max_us) {
+        s_sleep_max_us = (uint32_t)sleep_time_us;
+    }
+    return ESP_OK;
+}
+
+static esp_pm_sleep_cbs_register_config_t s_sleep_cbs = {
+    .exit_cb = sleep_exit,
+};
+#endif
+
+/* Caller holds s_mutex */
+static void set_awake(bool awake)
+{
+    if (awake == s_awake) {
+        return;
+    }
+    esp_err_t ret = awake ? esp_pm_lock_acquire(s_awake_lock) : esp_pm_lock_release(s_awake_lock);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "PM lock %s failed: %s", awake ? "acquire" : "release", esp_err_to_name(ret));
+        return;
+    }
+    s_awake = awake;
+    METRIC_SET(sleep_allowed, !awake);
+}
+
+static void idle_timer_callback(void *arg)
+{
+    LOCK_TAKE(s_mutex);
+    if (s_at_rest && s_awake) {
+        set_awake(false);
+        s_idle_entries++;
+        METRIC_INC(idle_entries);
+    }
+    LOCK_GIVE(s_mutex);
+}
+
+void power_manager_on_door_state(door_state_t state)
+{
+    if (!s_initialized) {
+        return;
+    }
+
+    LOCK_TAKE(s_mutex);
+    /* Awake first: the state change may be a command whose relay pulse is running */
+    set_awake(true);
+    s_at_rest = (state == DOOR_STATE_CLOSED || state == DOOR_STATE_OPEN);
+    esp_timer_stop(s_idle_timer);
+    if (s_at_rest) {
+        esp_timer_start_once(s_idle_timer, (uint64_t)CONFIG_GARAGE_POWER_IDLE_ENTRY_MS * 1000);
+    }
+    LOCK_GIVE(s_mutex);
+}
+
+esp_err_t power_manager_init(void)
+{
+    if (s_initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    s_mutex = STATIC_MUTEX_CREATE(s_mutex);
+    if (!s_mutex) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    /* Held from the start: sleep is only allowed once the door is known to rest */
+    esp_err_t ret = esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "door_active", &s_awake_lock);
+    if (ret != ESP_OK) {
+        vSemaphoreDelete(s_mutex);
+        return ret;
+    }
+    esp_pm_lock_acquire(s_awake_lock);
+    s_awake = true;
+
+    const esp_timer_create_args_t timer_args = {
+        .callback = idle_timer_callback,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "power_idle"
+    };
+    ret = esp_timer_create(&timer_args, &s_idle_timer);
+    if (ret != ESP_OK) {
+        esp_pm_lock_release(s_awake_lock);
+        esp_pm_lock_delete(s_awake_lock);
+        vSemaphoreDelete(s_mutex);
+        return ret;
+    }
+
+    const esp_pm_config_t pm_config = {
+        .max_freq_mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+        .min_freq_mhz = CONFIG_XTAL_FREQ,
+        .light_sleep_enable = true,
+    };
+    ret = esp_pm_configure(&pm_config);
+    if (ret == ESP_OK) {
+        ret = esp_sleep_enable_gpio_wakeup();
+    }
+    if (ret == ESP_OK) {
+        ret = reed_switch_set_wakeup(true);
+    }
+    if (ret != ESP_OK) {
+        esp_timer_delete(s_idle_timer);
+        esp_pm_lock_release(s_awake_lock);
+        esp_pm_lock_delete(s_awake_lock);
+        vSemaphoreDelete(s_mutex);
+        return ret;
+    }
+
+#if CONFIG_PM_LIGHT_SLEEP_CALLBACKS
+    /* Optional: without it sleep works, only the residency is not measured */
+    if (esp_pm_light_sleep_register_cbs(&s_sleep_cbs) != ESP_OK) {
+        ESP_LOGW(TAG, "Sleep residency not measured");
+    }
+#endif
+
+    mem_budget_register_static(TAG, STATIC_MUTEX_BYTES);
+
+    s_idle_entries = 0;
+    s_stats_since_us = esp_timer_get_time();
+    s_initialized = true;
+    power_manager_on_door_state(garage_door_get_state());
+
+    ESP_LOGI(TAG, "Light sleep at rest after %d ms, %d-%d MHz", CONFIG_GARAGE_POWER_IDLE_ENTRY_MS,
+             pm_config.min_freq_mhz, pm_config.max_freq_mhz);
+    return ESP_OK;
+}
+
+esp_err_t power_manager_deinit(void)
+{
+    if (!s_initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    s_initialized = false;
+#if CONFIG_PM_LIGHT_SLEEP_CALLBACKS
+    esp_pm_light_sleep_unregister_cbs(&s_sleep_cbs);
+#endif
+    reed_switch_set_wakeup(false);
+
+    esp_timer_stop(s_idle_timer);
+    esp_timer_delete(s_idle_timer);
+    s_idle_timer = NULL;
+
+    /* Leave the chip awake: light sleep stays configured, nothing would wake it for the door */
+    if (!s_awake) {
+        esp_pm_lock_acquire(s_awake_lock);
+    }
+    const esp_pm_config_t pm_config = {
+        .max_freq_mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+        .min_freq_mhz = CONFIG_XTAL_FREQ,
+        .light_sleep_enable = false,
+    };
+    esp_pm_configure(&pm_config);
+    esp_pm_lock_release(s_awake_lock);
+    esp_pm_lock_delete(s_awake_lock);
+    s_awake_lock = NULL;
+    s_awake = false;
+
+    vSemaphoreDelete(s_mutex);
+    s_mutex = NULL;
+    return ESP_OK;
+}
+
+esp_err_t power_manager_get_stats(power_stats_t *stats)
+{
+    if (!stats) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!s_initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    LOCK_TAKE(s_mutex);
+    stats->sleep_allowed = !s_awake;
+    stats->idle_entries = s_idle_entries;
+    stats->elapsed_us = (uint64_t)(esp_timer_get_time() - s_stats_since_us);
+    LOCK_GIVE(s_mutex);
+    stats->sleeps = s_sleeps;
+    stats->sleep_max_us = s_sleep_max_us;
+    stats->slept_us = s_slept_us;
+    return ESP_OK;
+}
+
+void power_manager_reset_stats(void)
+{
+    if (!s_initialized) {
+        return;
+    }
+
+    LOCK_TAKE(s_mutex);
+    s_idle_entries = 0;
+    s_stats_since_us = esp_timer_get_time();
+    LOCK_GIVE(s_mutex);
+    s_sleeps = 0;
+    s_sleep_max_us = 0;
+    s_slept_us = 0;
+}
+
+static int power_cmd(int argc, char **argv)
+{
+    if (argc > 1 && strcmp(argv[1], "reset") == 0) {
+        power_manager_reset_stats();
+        return 0;
+    }
+
+    power_stats_t stats;
+    if (power_manager_get_stats(&stats) != ESP_OK) {
+        printf("Power management not running (CONFIG_GARAGE_POWER_SAVE)\n");
+        return 0;
+    }
+
+    printf("light sleep: %s, %" PRIu32 " idle entries\n", stats.sleep_allowed ? "allowed" : "held awake",
+           stats.idle_entries);
+#if CONFIG_PM_LIGHT_SLEEP_CALLBACKS
+    uint64_t awake_us = stats.elapsed_us > stats.slept_us ? stats.elapsed_us - stats.slept_us : 0;
+    printf("%" PRIu32 " sleeps, longest %" PRIu32 " ms, slept %" PRIu64 " of %" PRIu64 " ms: awake %" PRIu64
+           ".%02" PRIu64 "%%\n",
+           stats.sleeps, stats.sleep_max_us / 1000, stats.slept_us / 1000, stats.elapsed_us / 1000,
+           stats.elapsed_us ? awake_us * 100 / stats.elapsed_us : 0,
+           stats.elapsed_us ? awake_us * 10000 / stats.elapsed_us % 100 : 0);
+#else
+    printf("sleep residency needs CONFIG_PM_LIGHT_SLEEP_CALLBACKS\n");
+#endif
+    return 0;
+}
+
+esp_err_t power_manager_register_console_command(void)
+{
+    const esp_console_cmd_t cmd = {
+        .command = "power",
+        .help = "Light sleep state and residency, or 'power reset'",
+        .hint = "[reset]",
+        .func = &power_cmd,
+    };
+    return esp_console_cmd_register(&cmd);
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "garage_door_control.h"
+
+/*
+ * Light sleep between door cycles (CONFIG_GARAGE_POWER_SAVE).
+ *
+ * The power manager enables automatic light sleep, which with tickless idle
+ * lets the chip sleep whenever no task is ready, and holds a
+ * ESP_PM_NO_LIGHT_SLEEP lock unless the door is at rest: CLOSED or OPEN for
+ * CONFIG_GARAGE_POWER_IDLE_ENTRY_MS. While the door moves, after a stop and
+ * in an unknown state the chip stays awake. At rest the reeds are armed as
+ * wake sources, so the door leaving or reaching an end stop wakes the chip;
+ * timers (the relay pulse end, the rule timers) wake it on their own, and a
+ * Matter command arrives through the radio, which does as well.
+ *
+ * Time spent asleep is measured with the light sleep callbacks
+ * (CONFIG_PM_LIGHT_SLEEP_CALLBACKS); see the 'power' console command.
+ */
+
+typedef struct {
+    bool sleep_allowed;
+    uint32_t idle_entries; /* Times the door rested long enough to allow sleep */
+    uint32_t sleeps;       /* Light sleep periods entered */
+    uint32_t sleep_max_us;
+    uint64_t slept_us;
+    uint64_t elapsed_us;   /* Since init or the last reset */
+} power_stats_t;
+
+/* After the reed switches and the door: arms the reeds and follows the current door state */
+esp_err_t power_manager_init(void);
+esp_err_t power_manager_deinit(void);
+/* Door state callback */
+void power_manager_on_door_state(door_state_t state);
+esp_err_t power_manager_get_stats(power_stats_t *stats);
+void power_manager_reset_stats(void);
+esp_err_t power_manager_register_console_command(void);
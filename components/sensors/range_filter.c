@@ -0,0 +1,99 @@
+#include "range_filter.h"
+#include <string.h>
+
+/* 343 m/s round trip: mm = us * 0.1715, 0.1715 * 65536 = 11239.4 */
+#define ECHO_US_TO_MM_Q16 11239u
+
+uint16_t range_echo_to_mm(uint32_t echo_us)
+{
+    uint32_t mm = (uint32_t)(((uint64_t)echo_us * ECHO_US_TO_MM_Q16 + 0x8000u) >> 16);
+    return mm > UINT16_MAX ? UINT16_MAX : (uint16_t)mm;
+}
+
+void range_filter_reset(range_filter_t *filter)
+{
+    memset(filter, 0, sizeof(*filter));
+}
+
+static uint16_t distance(uint16_t a, uint16_t b)
+{
+    return a > b ? a - b : b - a;
+}
+
+/* The newest sample in the window: after a confirmed step the median lags, the last sample does not */
+static uint16_t last(const range_filter_t *filter)
+{
+    return filter->window[(filter->next + RANGE_FILTER_WINDOW - 1) % RANGE_FILTER_WINDOW];
+}
+
+static void push(range_filter_t *filter, uint16_t mm)
+{
+    filter->window[filter->next] = mm;
+    filter->next = (filter->next + 1) % RANGE_FILTER_WINDOW;
+    if (filter->count < RANGE_FILTER_WINDOW) {
+        filter->count++;
+    }
+}
+
+static uint16_t median(const range_filter_t *filter)
+{
+    uint16_t sorted[RANGE_FILTER_WINDOW];
+    memcpy(sorted, filter->window, filter->count * sizeof(uint16_t));
+    for (uint8_t i = 1; i < filter->count; i++) {
+        uint16_t key = sorted[i];
+        uint8_t j = i;
+        while (j > 0 && sorted[j - 1] > key) {
+            sorted[j] = sorted[j - 1];
+            j--;
+        }
+        sorted[j] = key;
+    }
+    return sorted[filter->count / 2];
+}
+
+/*
+ * The median absorbs isolated spikes once the window is full, but a spike in
+ * a half-empty window or two in five would still move it. A sample far from
+ * the previous one is therefore held back: if the next one lands near it, the
+ * jump is real (a car arrived) and both enter the window; otherwise it is
+ * dropped as an outlier.
+ */
+bool range_filter_add(range_filter_t *filter, uint16_t distance_mm, uint16_t *median_mm)
+{
+    if (filter->count > 0 && distance(distance_mm, last(filter)) > RANGE_FILTER_STEP_MM) {
+        if (filter->pending_mm == 0 || distance(distance_mm, filter->pending_mm) > RANGE_FILTER_STEP_MM) {
+            if (filter->pending_mm != 0) {
+                filter->outliers++;
+            }
+            filter->pending_mm = distance_mm;
+            return false;
+        }
+        push(filter, filter->pending_mm);
+    } else if (filter->pending_mm != 0) {
+        filter->outliers++;
+    }
+    filter->pending_mm = 0;
+    push(filter, distance_mm);
+
+    filter->median_mm = median(filter);
+    if (median_mm) {
+        *median_mm = filter->median_mm;
+    }
+    return true;
+}
+
+bool presence_update(presence_state_t *state, const presence_config_t *config, uint16_t distance_mm)
+{
+    bool near = state->present ? distance_mm < config->present_below_mm + config->hysteresis_mm
+                               : distance_mm < config->present_below_mm;
+    if (near == state->present) {
+        state->streak = 0;
+        return false;
+    }
+    if (++state->streak < config->confirm_samples) {
+        return false;
+    }
+    state->present = near;
+    state->streak = 0;
+    return true;
+}
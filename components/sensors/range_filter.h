@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Integer-only signal chain for the ultrasonic ranger: echo time to
+ * millimetres, a median filter with a step gate against single-sample
+ * reflections, and a debounced presence decision with hysteresis. Pure
+ * functions on caller-owned state, so the host tests drive them directly.
+ */
+
+#define RANGE_FILTER_WINDOW  5
+/* A jump larger than this from the previous sample is held until the next sample confirms it */
+#define RANGE_FILTER_STEP_MM 300
+
+typedef struct {
+    uint16_t window[RANGE_FILTER_WINDOW];
+    uint8_t count;
+    uint8_t next;
+    uint16_t pending_mm; /* Unconfirmed jump, 0 when none */
+    uint16_t median_mm;
+    uint32_t outliers;
+} range_filter_t;
+
+typedef struct {
+    uint16_t present_below_mm;
+    uint16_t hysteresis_mm;
+    uint8_t confirm_samples;
+} presence_config_t;
+
+typedef struct {
+    bool present;
+    uint8_t streak;
+} presence_state_t;
+
+/* Round-trip echo time to distance at 343 m/s, in Q16 fixed point */
+uint16_t range_echo_to_mm(uint32_t echo_us);
+
+void range_filter_reset(range_filter_t *filter);
+/* Returns true with the new median when the sample was accepted, false while a jump is unconfirmed */
+bool range_filter_add(range_filter_t *filter, uint16_t distance_mm, uint16_t *median_mm);
+
+/* Returns true when 'present' changed */
+bool presence_update(presence_state_t *state, const presence_config_t *config, uint16_t distance_mm);
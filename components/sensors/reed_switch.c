@@ -6,19 +6,83 @@
 #include "driver/gpio.h"
 #include "esp_timer.h"
 #include "esp_intr_alloc.h"
+#include "hal/gpio_ll.h"
+#include "metrics.h"
+#include "tlog.h"
+#include "trace.h"
+#include "hot_path.h"
+#include "sdkconfig.h"
 
-#define DEBOUNCE_MS 50
 #define TAG "reed_switch"
 
+#if CONFIG_GARAGE_FIXED_CONFIG
+/* Constant pins: each read is one register load with a constant mask */
+#define DEBOUNCE_MS         CONFIG_GARAGE_REED_DEBOUNCE_MS
+#define REED_CLOSED_PIN     ((gpio_num_t)CONFIG_GARAGE_REED_CLOSED_GPIO)
+#define REED_OPEN_PIN       ((gpio_num_t)CONFIG_GARAGE_REED_OPEN_GPIO)
+#define REED_LEVEL(pin)     gpio_ll_get_level(&GPIO, (pin))
+#else
+#define DEBOUNCE_MS         50
+#define REED_CLOSED_PIN     s_config.reed_closed_pin
+#define REED_OPEN_PIN       s_config.reed_open_pin
+#define REED_LEVEL(pin)     gpio_get_level(pin)
+#endif
+
+#define REED_METRICS(X)             \
+    X(COUNTER, edges)               \
+    X(COUNTER, debounce_events)     \
+    X(COUNTER, position_changes)
+METRICS_GROUP_DEFINE(reed, REED_METRICS)
+
 static reed_switch_config_t s_config;
 static bool s_initialized = false;
 static reed_switch_callback_t s_callback = NULL;
 static volatile door_position_t s_current_position = DOOR_POSITION_UNKNOWN;
 static esp_timer_handle_t s_debounce_timer = NULL;
 static volatile bool s_debounce_pending = false;
+static volatile bool s_wakeup = false;
+
+HOT_PATH_DEFINE(debounce);
+
+/*
+ * Light sleep wake sources are level triggered: arm each reed at the level it
+ * takes when it next changes. The ISR puts both back on edges (a level
+ * interrupt keeps firing while the level holds) and the debounce re-arms them
+ * from the settled levels. An edge racing the re-arm leaves a debounce
+ * pending, which arms again.
+ */
+static void arm_wakeup(gpio_num_t pin)
+{
+    gpio_wakeup_enable(pin, REED_LEVEL(pin) ? GPIO_INTR_LOW_LEVEL : GPIO_INTR_HIGH_LEVEL);
+}
+
+static void disarm_wakeup(gpio_num_t pin)
+{
+    gpio_wakeup_disable(pin);
+    gpio_set_intr_type(pin, GPIO_INTR_ANYEDGE);
+}
+
+/* disarm_wakeup() through the LL layer, which is inline and so safe while flash is busy */
+static inline void isr_disarm_wakeup(gpio_num_t pin)
+{
+    gpio_ll_wakeup_disable(&GPIO, pin);
+    gpio_ll_set_intr_type(&GPIO, pin, GPIO_INTR_ANYEDGE);
+}
 
+/*
+ * Registered with ESP_INTR_FLAG_IRAM, so it runs during flash writes: only
+ * IRAM-safe calls (LL register access, the trace ring, inline metrics, and
+ * esp_timer with CONFIG_ESP_TIMER_IN_IRAM).
+ */
 static void IRAM_ATTR gpio_isr_handler(void *arg)
 {
+    gpio_num_t pin = (gpio_num_t)(uintptr_t)arg;
+    METRIC_INC(edges);
+    TRACE(TRACE_REED_EDGE, pin == REED_CLOSED_PIN ? TRACE_REED_CLOSED : TRACE_REED_OPEN, gpio_ll_get_level(&GPIO, pin));
+    if (s_wakeup) {
+        isr_disarm_wakeup(REED_CLOSED_PIN);
+        isr_disarm_wakeup(REED_OPEN_PIN);
+    }
     if (!s_debounce_pending) {
         s_debounce_pending = true;
         if (s_debounce_timer) {
@@ -27,16 +91,30 @@ static void IRAM_ATTR gpio_isr_handler(void *arg)
     }
 }
 
-static void debounce_timer_callback(void *arg)
+static void HOT_PATH_ATTR debounce_timer_callback(void *arg)
 {
+    uint32_t begin = HOT_PATH_BEGIN();
     s_debounce_pending = false;
+    METRIC_INC(debounce_events);
     door_position_t new_pos = reed_switch_get_position();
+    bool changed = (new_pos != s_current_position);
     
-    if (new_pos != s_current_position) {
+    if (changed) {
         s_current_position = new_pos;
-        ESP_LOGI(TAG, "Position changed to %d", s_current_position);
+        METRIC_INC(position_changes);
+        TRACE(TRACE_POSITION, new_pos, 0);
+    }
+    if (s_wakeup) {
+        arm_wakeup(REED_CLOSED_PIN);
+        arm_wakeup(REED_OPEN_PIN);
+    }
+    /* The door's handling of the change is profiled as its own path */
+    HOT_PATH_END(debounce, begin);
+    
+    if (changed) {
+        TLOGI(TAG, "Position changed to %d", new_pos);
         if (s_callback) {
-            s_callback(s_current_position);
+            s_callback(new_pos);
         }
     }
 }
@@ -51,10 +129,17 @@ esp_err_t reed_switch_init(const reed_switch_config_t *config)
         return ESP_ERR_INVALID_ARG;
     }
     
+#if CONFIG_GARAGE_FIXED_CONFIG
+    if (config->reed_closed_pin != REED_CLOSED_PIN || config->reed_open_pin != REED_OPEN_PIN) {
+        ESP_LOGE(TAG, "Pins %d/%d differ from the fixed configuration", config->reed_closed_pin,
+                 config->reed_open_pin);
+        return ESP_ERR_INVALID_ARG;
+    }
+#endif
     memcpy(&s_config, config, sizeof(reed_switch_config_t));
     
     gpio_config_t io_conf = {
-        .pin_bit_mask = (1ULL << config->reed_closed_pin) | (1ULL << config->reed_open_pin),
+        .pin_bit_mask = (1ULL << REED_CLOSED_PIN) | (1ULL << REED_OPEN_PIN),
         .mode = GPIO_MODE_INPUT,
         .pull_up_en = GPIO_PULLUP_ENABLE,
         .pull_down_en = GPIO_PULLDOWN_DISABLE,
@@ -78,18 +163,19 @@ esp_err_t reed_switch_init(const reed_switch_config_t *config)
         return ret;
     }
     
-    ret = gpio_install_isr_service(0);
+    ret = gpio_install_isr_service(ESP_INTR_FLAG_IRAM);
     if (ret != ESP_OK && ret != ESP_ERR_INVALID_STATE) {
         return ret;
     }
     
-    gpio_isr_handler_add(config->reed_closed_pin, gpio_isr_handler, NULL);
-    gpio_isr_handler_add(config->reed_open_pin, gpio_isr_handler, NULL);
+    gpio_isr_handler_add(REED_CLOSED_PIN, gpio_isr_handler, (void *)(uintptr_t)REED_CLOSED_PIN);
+    gpio_isr_handler_add(REED_OPEN_PIN, gpio_isr_handler, (void *)(uintptr_t)REED_OPEN_PIN);
     
-    s_current_position = reed_switch_get_position();
+    /* reed_switch_get_position() reports UNKNOWN until initialized */
     s_initialized = true;
+    s_current_position = reed_switch_get_position();
     
-    ESP_LOGI(TAG, "Initialized on pins %d (closed), %d (open)", config->reed_closed_pin, config->reed_open_pin);
+    ESP_LOGI(TAG, "Initialized on pins %d (closed), %d (open)", REED_CLOSED_PIN, REED_OPEN_PIN);
     return ESP_OK;
 }
 
@@ -99,28 +185,35 @@ esp_err_t reed_switch_deinit(void)
         return ESP_ERR_INVALID_STATE;
     }
     
-    gpio_isr_handler_remove(s_config.reed_closed_pin);
-    gpio_isr_handler_remove(s_config.reed_open_pin);
+    if (s_wakeup) {
+        s_wakeup = false;
+        disarm_wakeup(REED_CLOSED_PIN);
+        disarm_wakeup(REED_OPEN_PIN);
+    }
+    gpio_isr_handler_remove(REED_CLOSED_PIN);
+    gpio_isr_handler_remove(REED_OPEN_PIN);
     
     if (s_debounce_timer) {
         esp_timer_stop(s_debounce_timer);
         esp_timer_delete(s_debounce_timer);
         s_debounce_timer = NULL;
     }
+    /* A stopped debounce never clears the flag itself; edges after re-init would be ignored */
+    s_debounce_pending = false;
     
     s_initialized = false;
     s_callback = NULL;
     return ESP_OK;
 }
 
-door_position_t reed_switch_get_position(void)
+door_position_t HOT_PATH_ATTR reed_switch_get_position(void)
 {
     if (!s_initialized) {
         return DOOR_POSITION_UNKNOWN;
     }
     
-    bool closed = (gpio_get_level(s_config.reed_closed_pin) == 0);
-    bool open = (gpio_get_level(s_config.reed_open_pin) == 0);
+    bool closed = (REED_LEVEL(REED_CLOSED_PIN) == 0);
+    bool open = (REED_LEVEL(REED_OPEN_PIN) == 0);
     
     if (closed && !open) {
         return DOOR_POSITION_CLOSED;
@@ -152,6 +245,23 @@ esp_err_t reed_switch_register_callback(reed_switch_callback_t callback)
     return ESP_OK;
 }
 
+esp_err_t reed_switch_set_wakeup(bool enable)
+{
+    if (!s_initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    
+    s_wakeup = enable;
+    if (enable) {
+        arm_wakeup(REED_CLOSED_PIN);
+        arm_wakeup(REED_OPEN_PIN);
+    } else {
+        disarm_wakeup(REED_CLOSED_PIN);
+        disarm_wakeup(REED_OPEN_PIN);
+    }
+    return ESP_OK;
+}
+
 esp_err_t reed_switch_set_gpio_config(const reed_switch_config_t *config)
 {
     if (!config) {
@@ -162,6 +272,10 @@ esp_err_t reed_switch_set_gpio_config(const reed_switch_config_t *config)
         return ESP_ERR_INVALID_STATE;
     }
     
+#if CONFIG_GARAGE_FIXED_CONFIG
+    return ESP_ERR_NOT_SUPPORTED;
+#else
     memcpy(&s_config, config, sizeof(reed_switch_config_t));
     return ESP_OK;
+#endif
 }
\ No newline at end of file
@@ -5,6 +5,10 @@
 
 #include "driver/gpio.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 typedef struct {
     gpio_num_t reed_closed_pin;
     gpio_num_t reed_open_pin;
@@ -20,10 +24,18 @@ typedef enum {
 
 typedef void (*reed_switch_callback_t)(door_position_t position);
 
+/* With CONFIG_GARAGE_FIXED_CONFIG the pins must match the configured ones */
 esp_err_t reed_switch_init(const reed_switch_config_t *config);
 esp_err_t reed_switch_deinit(void);
 door_position_t reed_switch_get_position(void);
 bool reed_switch_is_closed(void);
 bool reed_switch_is_open(void);
 esp_err_t reed_switch_register_callback(reed_switch_callback_t callback);
-esp_err_t reed_switch_set_gpio_config(const reed_switch_config_t *config);
\ No newline at end of file
+/* Light sleep wake sources (esp_sleep_enable_gpio_wakeup()): either reed changing wakes the chip */
+esp_err_t reed_switch_set_wakeup(bool enable);
+/* ESP_ERR_NOT_SUPPORTED with CONFIG_GARAGE_FIXED_CONFIG */
+esp_err_t reed_switch_set_gpio_config(const reed_switch_config_t *config);
+
+#ifdef __cplusplus
+}
+#endif
@@ -6,33 +6,86 @@
 #include "esp_log.h"
 #include "driver/gpio.h"
 #include "esp_timer.h"
+#include "metrics.h"
+#include "tlog.h"
+#include "trace.h"
+#include "static_alloc.h"
+#include "mem_budget.h"
+#include "liveness.h"
+#include "hot_path.h"
+#include "span.h"
+#include "sdkconfig.h"
 
 #define DEFAULT_PULSE_DURATION_MS 500
 #define DEFAULT_MAX_PULSE_DURATION_MS 600
 #define DEFAULT_MIN_INTERVAL_MS 1000
 #define TAG "relay"
 
-static gpio_num_t s_gpio_num = GPIO_NUM_NC;
+#if CONFIG_GARAGE_FIXED_CONFIG
+#include "hal/gpio_ll.h"
+/* Constant pin and timings: no config loads, the pin is one register write */
+#define RELAY_PIN               ((gpio_num_t)CONFIG_GARAGE_RELAY_GPIO)
+#define PULSE_DURATION_MS       CONFIG_GARAGE_RELAY_PULSE_MS
+#define MAX_PULSE_DURATION_MS   CONFIG_GARAGE_RELAY_MAX_PULSE_MS
+#define MIN_INTERVAL_MS         CONFIG_GARAGE_RELAY_MIN_INTERVAL_MS
+#define RELAY_SET(level)        gpio_ll_set_level(&GPIO, RELAY_PIN, (level))
+#else
+#define RELAY_PIN               s_gpio_num
+#define PULSE_DURATION_MS       s_config.pulse_duration_ms
+#define MAX_PULSE_DURATION_MS   s_config.max_pulse_duration_ms
+#define MIN_INTERVAL_MS         s_config.min_interval_ms
+#define RELAY_SET(level)        gpio_set_level(s_gpio_num, (level))
+#endif
+/* A pulse still on this long past the configured maximum means the esp_timer task is stuck: reboot drops the pin */
+#define PULSE_LIVENESS_SLACK_MS 200
+
+#define RELAY_METRICS(X)   \
+    X(COUNTER, pulses)     \
+    X(COUNTER, rejected)
+METRICS_GROUP_DEFINE(relay, RELAY_METRICS)
+
 static bool s_initialized = false;
 static bool s_active = false;
 static esp_timer_handle_t s_pulse_timer = NULL;
+#if !CONFIG_GARAGE_FIXED_CONFIG
+static gpio_num_t s_gpio_num = GPIO_NUM_NC;
 static relay_config_t s_config = {
     .pulse_duration_ms = DEFAULT_PULSE_DURATION_MS,
     .max_pulse_duration_ms = DEFAULT_MAX_PULSE_DURATION_MS,
     .min_interval_ms = DEFAULT_MIN_INTERVAL_MS
 };
+#endif
 static int64_t s_last_activation_time = 0;
 static relay_callback_t s_callback = NULL;
 static SemaphoreHandle_t s_mutex = NULL;
+static liveness_id_t s_pulse_liveness = -1;
+static uint16_t s_pulse_corr = 0; /* Correlation ID of the command behind the pulse */
+
+STATIC_MUTEX_DEFINE(s_mutex);
+/* Timer expiry to pin low, and call to pin high */
+HOT_PATH_DEFINE(pulse_end);
+HOT_PATH_DEFINE(activate);
 
-static void pulse_timer_callback(void *arg)
+static void HOT_PATH_ATTR pulse_timer_callback(void *arg)
 {
-    xSemaphoreTake(s_mutex, portMAX_DELAY);
-    gpio_set_level(s_gpio_num, 0);
+    uint32_t begin = HOT_PATH_BEGIN();
+    LOCK_TAKE(s_mutex);
+    RELAY_SET(0);
     s_active = false;
-    xSemaphoreGive(s_mutex);
+    HOT_PATH_END(pulse_end, begin);
+    LOCK_GIVE(s_mutex);
     
-    ESP_LOGI(TAG, "Pulse completed, relay deactivated");
+    uint16_t corr = SPAN_CORR_GET();
+    SPAN_CORR_SET(s_pulse_corr);
+    SPAN_MARK(SPAN_RELAY_RELEASE);
+    SPAN_CORR_SET(corr);
+    
+    if (s_pulse_liveness >= 0) {
+        liveness_checkin(s_pulse_liveness);
+        liveness_set_period(s_pulse_liveness, 0);
+    }
+    
+    TLOGI(TAG, "Pulse completed, relay deactivated");
     
     if (s_callback) {
         s_callback();
@@ -45,12 +98,21 @@ esp_err_t relay_init(gpio_num_t gpio_num)
         return ESP_ERR_INVALID_STATE;
     }
     
-    s_mutex = xSemaphoreCreateMutex();
+#if CONFIG_GARAGE_FIXED_CONFIG
+    if (gpio_num != RELAY_PIN) {
+        ESP_LOGE(TAG, "GPIO %d differs from the fixed configuration", gpio_num);
+        return ESP_ERR_INVALID_ARG;
+    }
+#endif
+    
+    s_mutex = STATIC_MUTEX_CREATE(s_mutex);
     if (!s_mutex) {
         return ESP_ERR_NO_MEM;
     }
     
+#if !CONFIG_GARAGE_FIXED_CONFIG
     s_gpio_num = gpio_num;
+#endif
     
     gpio_config_t io_conf = {
         .pin_bit_mask = (1ULL << gpio_num),
@@ -81,6 +143,18 @@ esp_err_t relay_init(gpio_num_t gpio_num)
         return ret;
     }
     
+    mem_budget_register_static(TAG, STATIC_MUTEX_BYTES);
+    
+    /* Armed for each pulse; optional, the relay works without the monitor */
+    const liveness_desc_t pulse = {
+        .name = "relay_pulse",
+        .period_ms = 0,
+        .action = LIVENESS_ACTION_REBOOT,
+    };
+    if (liveness_register(&pulse, &s_pulse_liveness) != ESP_OK) {
+        s_pulse_liveness = -1;
+    }
+    
     s_initialized = true;
     ESP_LOGI(TAG, "Initialized on GPIO %d", gpio_num);
     return ESP_OK;
@@ -92,7 +166,7 @@ esp_err_t relay_deinit(void)
         return ESP_ERR_INVALID_STATE;
     }
     
-    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    LOCK_TAKE(s_mutex);
     
     if (s_pulse_timer) {
         esp_timer_stop(s_pulse_timer);
@@ -100,11 +174,16 @@ esp_err_t relay_deinit(void)
         s_pulse_timer = NULL;
     }
     
-    gpio_set_level(s_gpio_num, 0);
+    RELAY_SET(0);
     s_active = false;
     s_initialized = false;
     
-    xSemaphoreGive(s_mutex);
+    if (s_pulse_liveness >= 0) {
+        liveness_unregister(s_pulse_liveness);
+        s_pulse_liveness = -1;
+    }
+    
+    LOCK_GIVE(s_mutex);
     vSemaphoreDelete(s_mutex);
     s_mutex = NULL;
     
@@ -113,41 +192,56 @@ esp_err_t relay_deinit(void)
 
 esp_err_t relay_activate(void)
 {
-    return relay_activate_pulse(s_config.pulse_duration_ms);
+    return relay_activate_pulse(PULSE_DURATION_MS);
 }
 
-esp_err_t relay_activate_pulse(uint32_t duration_ms)
+esp_err_t HOT_PATH_ATTR relay_activate_pulse(uint32_t duration_ms)
 {
+    uint32_t begin = HOT_PATH_BEGIN();
     if (!s_initialized) {
         return ESP_ERR_INVALID_STATE;
     }
     
-    if (duration_ms == 0 || duration_ms > s_config.max_pulse_duration_ms) {
+    if (duration_ms == 0 || duration_ms > MAX_PULSE_DURATION_MS) {
+        METRIC_INC(rejected);
         return ESP_ERR_INVALID_ARG;
     }
     
-    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    SPAN_BEGIN(SPAN_RELAY_ACTIVATE);
+    LOCK_TAKE(s_mutex);
     
     if (s_active) {
-        xSemaphoreGive(s_mutex);
+        LOCK_GIVE(s_mutex);
+        SPAN_END(SPAN_RELAY_ACTIVATE);
+        METRIC_INC(rejected);
         return ESP_ERR_INVALID_STATE;
     }
     
     int64_t now = esp_timer_get_time() / 1000;
-    if (now - s_last_activation_time < s_config.min_interval_ms) {
-        xSemaphoreGive(s_mutex);
+    if (now - s_last_activation_time < MIN_INTERVAL_MS) {
+        LOCK_GIVE(s_mutex);
+        SPAN_END(SPAN_RELAY_ACTIVATE);
+        METRIC_INC(rejected);
         return ESP_ERR_INVALID_STATE;
     }
     
-    gpio_set_level(s_gpio_num, 1);
+    RELAY_SET(1);
+    HOT_PATH_END(activate, begin);
+    SPAN_END(SPAN_RELAY_ACTIVATE);
     s_active = true;
     s_last_activation_time = now;
+    s_pulse_corr = SPAN_CORR_GET();
     
     esp_timer_start_once(s_pulse_timer, duration_ms * 1000);
+    if (s_pulse_liveness >= 0) {
+        liveness_set_period(s_pulse_liveness, MAX_PULSE_DURATION_MS + PULSE_LIVENESS_SLACK_MS);
+    }
     
-    xSemaphoreGive(s_mutex);
+    LOCK_GIVE(s_mutex);
+    METRIC_INC(pulses);
+    TRACE(TRACE_RELAY_PULSE, 0, duration_ms);
     
-    ESP_LOGI(TAG, "Activated relay for %" PRIu32 "ms", duration_ms);
+    TLOGI(TAG, "Activated relay for %" PRIu32 "ms", duration_ms);
     return ESP_OK;
 }
 
@@ -157,11 +251,15 @@ esp_err_t relay_set_config(const relay_config_t *config)
         return ESP_ERR_INVALID_ARG;
     }
     
-    xSemaphoreTake(s_mutex, portMAX_DELAY);
+#if CONFIG_GARAGE_FIXED_CONFIG
+    return ESP_ERR_NOT_SUPPORTED;
+#else
+    LOCK_TAKE(s_mutex);
     memcpy(&s_config, config, sizeof(relay_config_t));
-    xSemaphoreGive(s_mutex);
+    LOCK_GIVE(s_mutex);
     
     return ESP_OK;
+#endif
 }
 
 esp_err_t relay_get_config(relay_config_t *config)
@@ -170,9 +268,15 @@ esp_err_t relay_get_config(relay_config_t *config)
         return ESP_ERR_INVALID_ARG;
     }
     
-    xSemaphoreTake(s_mutex, portMAX_DELAY);
+#if CONFIG_GARAGE_FIXED_CONFIG
+    config->pulse_duration_ms = PULSE_DURATION_MS;
+    config->max_pulse_duration_ms = MAX_PULSE_DURATION_MS;
+    config->min_interval_ms = MIN_INTERVAL_MS;
+#else
+    LOCK_TAKE(s_mutex);
     memcpy(config, &s_config, sizeof(relay_config_t));
-    xSemaphoreGive(s_mutex);
+    LOCK_GIVE(s_mutex);
+#endif
     
     return ESP_OK;
 }
@@ -180,9 +284,9 @@ esp_err_t relay_get_config(relay_config_t *config)
 bool relay_is_active(void)
 {
     bool active;
-    xSemaphoreTake(s_mutex, portMAX_DELAY);
+    LOCK_TAKE(s_mutex);
     active = s_active;
-    xSemaphoreGive(s_mutex);
+    LOCK_GIVE(s_mutex);
     return active;
 }
 
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <stdbool.h>
 #include <stdint.h>
 #include "driver/gpio.h"
 
@@ -11,10 +12,12 @@ typedef struct {
 
 typedef void (*relay_callback_t)(void);
 
+/* With CONFIG_GARAGE_FIXED_CONFIG gpio_num must be CONFIG_GARAGE_RELAY_GPIO */
 esp_err_t relay_init(gpio_num_t gpio_num);
 esp_err_t relay_deinit(void);
 esp_err_t relay_activate(void);
 esp_err_t relay_activate_pulse(uint32_t duration_ms);
+/* ESP_ERR_NOT_SUPPORTED with CONFIG_GARAGE_FIXED_CONFIG: the timings are compile-time constants */
 esp_err_t relay_set_config(const relay_config_t *config);
 esp_err_t relay_get_config(relay_config_t *config);
 bool relay_is_active(void);
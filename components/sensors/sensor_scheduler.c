@@ -0,0 +1,455 @@
+#include "sensor_scheduler.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_attr.h"
+#include "esp_timer.h"
+#include "esp_console.h"
+#include "metrics.h"
+#include "static_alloc.h"
+#include "mem_budget.h"
+
+#define TAG "sensor_sched"
+#define SCHEDULER_STACK_SIZE 3072
+#define SCHEDULER_PRIORITY 7
+
+#define SENSOR_SCHED_METRICS(X) \
+    X(COUNTER, runs)            \
+    X(COUNTER, batched_runs)    \
+    X(COUNTER, deadline_misses) \
+    X(GAUGE, sensors)
+METRICS_GROUP_DEFINE(sensor_sched, SENSOR_SCHED_METRICS)
+
+typedef struct {
+    bool used;
+    bool released; /* By sensor_scheduler_release*(), whatever the period */
+    sensor_desc_t desc;
+    int64_t release_us;
+    sensor_stats_t stats;
+} sensor_entry_t;
+
+/* One sample taken by the task, copied out so it runs without s_mutex */
+typedef struct {
+    sensor_id_t id;
+    sensor_sample_fn_t sample;
+    void *ctx;
+    int64_t release_us;
+    int64_t deadline_us;
+} job_t;
+
+static bool s_initialized = false;
+static sensor_entry_t s_sensors[SENSOR_SCHEDULER_MAX_SENSORS];
+static SemaphoreHandle_t s_mutex = NULL;
+static TaskHandle_t s_task = NULL;
+static esp_timer_handle_t s_wake_timer = NULL;
+static uint32_t s_releases = 0; /* Bit per sensor id, set from ISRs and other tasks */
+
+STATIC_MUTEX_DEFINE(s_mutex);
+STATIC_TASK_DEFINE(s_sched, SCHEDULER_STACK_SIZE);
+
+static int64_t deadline_of(const sensor_entry_t *e)
+{
+    uint32_t deadline_ms = e->desc.deadline_ms ? e->desc.deadline_ms : e->desc.period_ms;
+    return e->release_us + (int64_t)deadline_ms * 1000;
+}
+
+/* Released sensor with the earliest absolute deadline, or -1. Caller holds s_mutex */
+static sensor_id_t pick_edf(int64_t now)
+{
+    sensor_id_t best = -1;
+    for (sensor_id_t i = 0; i < SENSOR_SCHEDULER_MAX_SENSORS; i++) {
+        const sensor_entry_t *e = &s_sensors[i];
+        if (!e->used || (e->desc.period_ms == 0 && !e->released) || e->release_us > now) {
+            continue;
+        }
+        if (best < 0 || deadline_of(e) < deadline_of(&s_sensors[best])) {
+            best = i;
+        }
+    }
+    return best;
+}
+
+/* Queue a job and move the sensor to its next release. Caller holds s_mutex */
+static void take_job(sensor_id_t id, job_t *job)
+{
+    sensor_entry_t *e = &s_sensors[id];
+    *job = (job_t){
+        .id = id,
+        .sample = e->desc.sample,
+        .ctx = e->desc.ctx,
+        .release_us = e->release_us,
+        .deadline_us = deadline_of(e),
+    };
+    e->released = false;
+    e->release_us += (int64_t)e->desc.period_ms * 1000;
+}
+
+/* Turns pending releases into releases at 'now'. Caller holds s_mutex */
+static void take_releases(int64_t now)
+{
+    uint32_t released = __atomic_exchange_n(&s_releases, 0, __ATOMIC_ACQUIRE);
+    for (sensor_id_t i = 0; released && i < SENSOR_SCHEDULER_MAX_SENSORS; i++, released >>= 1) {
+        if ((released & 1) && s_sensors[i].used) {
+            s_sensors[i].released = true;
+            s_sensors[i].release_us = now;
+        }
+    }
+}
+
+/* Caller holds s_mutex */
+static void record(const job_t *job, int64_t start, int64_t end)
+{
+    sensor_entry_t *e = &s_sensors[job->id];
+    if (!e->used || e->desc.sample != job->sample) {
+        return; /* Unregistered while it ran */
+    }
+    int64_t period_us = (int64_t)e->desc.period_ms * 1000;
+    if (period_us && e->release_us <= end) {
+        /* Ran into its next release: drop the missed ones instead of running back to back */
+        e->release_us += ((end - e->release_us) / period_us + 1) * period_us;
+    }
+
+    sensor_stats_t *st = &e->stats;
+    uint32_t exec_us = (uint32_t)(end - start);
+    st->runs++;
+    st->exec_total_us += exec_us;
+    if (exec_us > st->exec_max_us) {
+        st->exec_max_us = exec_us;
+    }
+    if (start < job->release_us) {
+        st->batched++;
+        METRIC_INC(batched_runs);
+    } else {
+        uint32_t lateness_us = (uint32_t)(start - job->release_us);
+        st->lateness_total_us += lateness_us;
+        if (lateness_us > st->lateness_max_us) {
+            st->lateness_max_us = lateness_us;
+        }
+    }
+    if (end > job->deadline_us) {
+        st->deadline_misses++;
+        METRIC_INC(deadline_misses);
+    }
+    METRIC_INC(runs);
+}
+
+/* Sleep until the earliest release; caller holds s_mutex */
+static void arm_wake_timer(int64_t now)
+{
+    int64_t next = INT64_MAX;
+    for (sensor_id_t i = 0; i < SENSOR_SCHEDULER_MAX_SENSORS; i++) {
+        if (s_sensors[i].used && s_sensors[i].desc.period_ms && s_sensors[i].release_us < next) {
+            next = s_sensors[i].release_us;
+        }
+    }
+    esp_timer_stop(s_wake_timer);
+    if (next != INT64_MAX) {
+        esp_timer_start_once(s_wake_timer, next > now ? (uint64_t)(next - now) : 1);
+    }
+}
+
+/*
+ * Runs everything released, EDF first. A sensor on a bus takes the other
+ * sensors on that bus released within the batch window along, so the bus is
+ * powered up and locked once for all of them.
+ */
+static void run_released(void)
+{
+    job_t jobs[SENSOR_SCHEDULER_MAX_SENSORS];
+
+    while (true) {
+        LOCK_TAKE(s_mutex);
+        int64_t now = esp_timer_get_time();
+        take_releases(now);
+        sensor_id_t first = pick_edf(now);
+        if (first < 0) {
+            arm_wake_timer(now);
+            LOCK_GIVE(s_mutex);
+            return;
+        }
+
+        const sensor_bus_t *bus = s_sensors[first].desc.bus;
+        size_t count = 0;
+        take_job(first, &jobs[count++]);
+        if (bus) {
+            int64_t window_end = now + (int64_t)SENSOR_SCHEDULER_BATCH_WINDOW_MS * 1000;
+            for (sensor_id_t i = 0; i < SENSOR_SCHEDULER_MAX_SENSORS; i++) {
+                const sensor_entry_t *e = &s_sensors[i];
+                if (i != first && e->used && e->desc.bus == bus && e->desc.period_ms &&
+                    e->release_us <= window_end) {
+                    take_job(i, &jobs[count++]);
+                }
+            }
+        }
+        LOCK_GIVE(s_mutex);
+
+        if (bus && bus->begin) {
+            bus->begin(bus->ctx);
+        }
+        for (size_t j = 0; j < count; j++) {
+            int64_t start = esp_timer_get_time();
+            jobs[j].sample(jobs[j].ctx);
+            int64_t end = esp_timer_get_time();
+            LOCK_TAKE(s_mutex);
+            record(&jobs[j], start, end);
+            LOCK_GIVE(s_mutex);
+        }
+        if (bus && bus->end) {
+            bus->end(bus->ctx);
+        }
+    }
+}
+
+static void scheduler_task(void *pvParameters)
+{
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        run_released();
+    }
+}
+
+static void wake_timer_callback(void *arg)
+{
+    xTaskNotifyGive(s_task);
+}
+
+esp_err_t sensor_scheduler_init(void)
+{
+    if (s_initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    memset(s_sensors, 0, sizeof(s_sensors));
+    s_releases = 0;
+    s_mutex = STATIC_MUTEX_CREATE(s_mutex);
+    if (!s_mutex) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    esp_timer_create_args_t timer_args = {
+        .callback = wake_timer_callback,
+        .arg = NULL,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "sensor_wake"
+    };
+    esp_err_t ret = esp_timer_create(&timer_args, &s_wake_timer);
+    if (ret != ESP_OK) {
+        vSemaphoreDelete(s_mutex);
+        return ret;
+    }
+
+    BaseType_t task_ret = STATIC_TASK_CREATE(s_sched, scheduler_task, "sensors", NULL, SCHEDULER_PRIORITY, &s_task);
+    if (task_ret != pdPASS) {
+        esp_timer_delete(s_wake_timer);
+        vSemaphoreDelete(s_mutex);
+        return ESP_ERR_NO_MEM;
+    }
+
+    mem_budget_register_static(TAG, STATIC_MUTEX_BYTES + STATIC_TASK_BYTES(s_sched));
+    mem_budget_register_task(TAG, s_task, SCHEDULER_STACK_SIZE);
+
+    s_initialized = true;
+    METRIC_SET(sensors, 0);
+    ESP_LOGI(TAG, "Initialized, %d sensor slots", SENSOR_SCHEDULER_MAX_SENSORS);
+    return ESP_OK;
+}
+
+esp_err_t sensor_scheduler_deinit(void)
+{
+    if (!s_initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    esp_timer_stop(s_wake_timer);
+    esp_timer_delete(s_wake_timer);
+    s_wake_timer = NULL;
+    mem_budget_unregister_task(s_task);
+    vTaskDelete(s_task);
+    s_task = NULL;
+
+    vSemaphoreDelete(s_mutex);
+    s_mutex = NULL;
+    memset(s_sensors, 0, sizeof(s_sensors));
+    s_initialized = false;
+    return ESP_OK;
+}
+
+esp_err_t sensor_scheduler_register(const sensor_desc_t *desc, sensor_id_t *id)
+{
+    if (!desc || !desc->sample || !id) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!s_initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    LOCK_TAKE(s_mutex);
+    sensor_id_t slot = -1;
+    for (sensor_id_t i = 0; i < SENSOR_SCHEDULER_MAX_SENSORS; i++) {
+        if (!s_sensors[i].used) {
+            slot = i;
+            break;
+        }
+    }
+    if (slot < 0) {
+        LOCK_GIVE(s_mutex);
+        return ESP_ERR_NO_MEM;
+    }
+
+    sensor_entry_t *e = &s_sensors[slot];
+    memset(e, 0, sizeof(*e));
+    e->used = true;
+    e->desc = *desc;
+    e->release_us = esp_timer_get_time() + (int64_t)desc->period_ms * 1000;
+    e->stats.name = desc->name;
+    METRIC_INC(sensors);
+    LOCK_GIVE(s_mutex);
+
+    *id = slot;
+    xTaskNotifyGive(s_task);
+    ESP_LOGI(TAG, "Registered %s: period %" PRIu32 " ms%s%s", desc->name, desc->period_ms,
+             desc->bus ? ", bus " : "", desc->bus ? desc->bus->name : "");
+    return ESP_OK;
+}
+
+esp_err_t sensor_scheduler_unregister(sensor_id_t id)
+{
+    if (id < 0 || id >= SENSOR_SCHEDULER_MAX_SENSORS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!s_initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    LOCK_TAKE(s_mutex);
+    if (!s_sensors[id].used) {
+        LOCK_GIVE(s_mutex);
+        return ESP_ERR_NOT_FOUND;
+    }
+    memset(&s_sensors[id], 0, sizeof(s_sensors[id]));
+    METRIC_ADD(sensors, -1);
+    LOCK_GIVE(s_mutex);
+    return ESP_OK;
+}
+
+esp_err_t sensor_scheduler_set_period(sensor_id_t id, uint32_t period_ms)
+{
+    if (id < 0 || id >= SENSOR_SCHEDULER_MAX_SENSORS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!s_initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    LOCK_TAKE(s_mutex);
+    sensor_entry_t *e = &s_sensors[id];
+    if (!e->used) {
+        LOCK_GIVE(s_mutex);
+        return ESP_ERR_NOT_FOUND;
+    }
+    e->desc.period_ms = period_ms;
+    e->release_us = esp_timer_get_time() + (int64_t)period_ms * 1000;
+    LOCK_GIVE(s_mutex);
+
+    xTaskNotifyGive(s_task);
+    return ESP_OK;
+}
+
+esp_err_t sensor_scheduler_release(sensor_id_t id)
+{
+    if (!s_initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (id < 0 || id >= SENSOR_SCHEDULER_MAX_SENSORS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    __atomic_fetch_or(&s_releases, 1u << id, __ATOMIC_RELEASE);
+    xTaskNotifyGive(s_task);
+    return ESP_OK;
+}
+
+void IRAM_ATTR sensor_scheduler_release_from_isr(sensor_id_t id)
+{
+    if (!s_initialized || id < 0 || id >= SENSOR_SCHEDULER_MAX_SENSORS) {
+        return;
+    }
+    __atomic_fetch_or(&s_releases, 1u << id, __ATOMIC_RELEASE);
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(s_task, &woken);
+    portYIELD_FROM_ISR(woken);
+}
+
+esp_err_t sensor_scheduler_get_stats(sensor_id_t id, sensor_stats_t *stats)
+{
+    if (id < 0 || id >= SENSOR_SCHEDULER_MAX_SENSORS || !stats) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!s_initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    LOCK_TAKE(s_mutex);
+    esp_err_t ret = ESP_ERR_NOT_FOUND;
+    if (s_sensors[id].used) {
+        *stats = s_sensors[id].stats;
+        stats->period_ms = s_sensors[id].desc.period_ms;
+        ret = ESP_OK;
+    }
+    LOCK_GIVE(s_mutex);
+    return ret;
+}
+
+void sensor_scheduler_reset_stats(void)
+{
+    if (!s_initialized) {
+        return;
+    }
+
+    LOCK_TAKE(s_mutex);
+    for (sensor_id_t i = 0; i < SENSOR_SCHEDULER_MAX_SENSORS; i++) {
+        const char *name = s_sensors[i].stats.name;
+        memset(&s_sensors[i].stats, 0, sizeof(s_sensors[i].stats));
+        s_sensors[i].stats.name = name;
+    }
+    LOCK_GIVE(s_mutex);
+}
+
+static int sensors_cmd(int argc, char **argv)
+{
+    if (argc > 1 && strcmp(argv[1], "reset") == 0) {
+        sensor_scheduler_reset_stats();
+        return 0;
+    }
+
+    printf("%-12s %7s %7s %7s %5s %9s %9s %9s %9s\n", "sensor", "period", "runs", "batched", "miss", "late_avg",
+           "late_max", "exec_avg", "exec_max");
+    for (sensor_id_t i = 0; i < SENSOR_SCHEDULER_MAX_SENSORS; i++) {
+        sensor_stats_t st;
+        if (sensor_scheduler_get_stats(i, &st) != ESP_OK) {
+            continue;
+        }
+        uint32_t on_time = st.runs - st.batched;
+        printf("%-12s %7" PRIu32 " %7" PRIu32 " %7" PRIu32 " %5" PRIu32 " %9" PRIu32 " %9" PRIu32 " %9" PRIu32
+               " %9" PRIu32 "\n",
+               st.name ? st.name : "?", st.period_ms, st.runs, st.batched, st.deadline_misses,
+               on_time ? (uint32_t)(st.lateness_total_us / on_time) : 0, st.lateness_max_us,
+               st.runs ? (uint32_t)(st.exec_total_us / st.runs) : 0, st.exec_max_us);
+    }
+    printf("times in us, period in ms (0: paused)\n");
+    return 0;
+}
+
+esp_err_t sensor_scheduler_register_console_command(void)
+{
+    const esp_console_cmd_t cmd = {
+        .command = "sensors",
+        .help = "Per-sensor sampling lateness and execution time, or 'sensors reset'",
+        .hint = "[reset]",
+        .func = &sensors_cmd,
+    };
+    return esp_console_cmd_register(&cmd);
+}
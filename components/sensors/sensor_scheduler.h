@@ -0,0 +1,76 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+/*
+ * One task samples every periodic sensor. Each registered sensor has a period
+ * and a relative deadline; the task always runs the released sensor with the
+ * earliest absolute deadline (EDF) and sleeps on a one-shot esp_timer until
+ * the next release, so idle sensors cost no wakeups. Sensors that share a bus
+ * are batched: when one is due, the others on that bus released within
+ * SENSOR_SCHEDULER_BATCH_WINDOW_MS are sampled inside the same bus
+ * transaction. Adding a sensor costs a table slot, not a task and a stack.
+ *
+ * A sensor that signals data itself (a FIFO watermark interrupt) registers
+ * paused and is released from its ISR with sensor_scheduler_release_from_isr()
+ * (or from a task with sensor_scheduler_release()); it then runs like any
+ * released sensor, EDF against its deadline_ms.
+ *
+ * Sample functions run on the scheduler task and must not block for long;
+ * their execution time and release lateness are recorded per sensor (see the
+ * 'sensors' console command).
+ */
+
+#define SENSOR_SCHEDULER_MAX_SENSORS    8
+#define SENSOR_SCHEDULER_BATCH_WINDOW_MS 20
+
+/* A shared bus (e.g. I2C): begin/end bracket every batch of transactions on it */
+typedef struct {
+    const char *name;
+    void (*begin)(void *ctx);
+    void (*end)(void *ctx);
+    void *ctx;
+} sensor_bus_t;
+
+typedef void (*sensor_sample_fn_t)(void *ctx);
+
+typedef struct {
+    const char *name;
+    uint32_t period_ms;      /* 0 registers the sensor paused */
+    uint32_t deadline_ms;    /* After release; 0 means the period */
+    const sensor_bus_t *bus; /* NULL for a sensor on its own pins */
+    sensor_sample_fn_t sample;
+    void *ctx;
+} sensor_desc_t;
+
+typedef int sensor_id_t;
+
+typedef struct {
+    const char *name;
+    uint32_t period_ms;
+    uint32_t runs;
+    uint32_t batched;         /* Runs taken early alongside another sensor on the bus */
+    uint32_t deadline_misses; /* Finished after release + deadline */
+    uint32_t lateness_max_us; /* Start after release */
+    uint64_t lateness_total_us;
+    uint32_t exec_max_us;
+    uint64_t exec_total_us;
+} sensor_stats_t;
+
+esp_err_t sensor_scheduler_init(void);
+esp_err_t sensor_scheduler_deinit(void);
+/* The first release is one period after registration */
+esp_err_t sensor_scheduler_register(const sensor_desc_t *desc, sensor_id_t *id);
+esp_err_t sensor_scheduler_unregister(sensor_id_t id);
+/* Restarts the sensor's period from now, as esp_timer_start_periodic would; 0 pauses it */
+esp_err_t sensor_scheduler_set_period(sensor_id_t id, uint32_t period_ms);
+/* Releases the sensor now; a periodic sensor's period restarts from this run */
+esp_err_t sensor_scheduler_release(sensor_id_t id);
+/* ISR safe sensor_scheduler_release() */
+void sensor_scheduler_release_from_isr(sensor_id_t id);
+esp_err_t sensor_scheduler_get_stats(sensor_id_t id, sensor_stats_t *stats);
+void sensor_scheduler_reset_stats(void);
+esp_err_t sensor_scheduler_register_console_command(void);
@@ -0,0 +1,86 @@
+#include "tilt_angle.h"
+
+#define CORDIC_STEPS 14
+/* Vectors are scaled up to this magnitude first: room for the CORDIC gain (1.65) times sqrt(2) below 2^31 */
+#define CORDIC_SCALE_LIMIT (1 << 28)
+
+/* atan(2^-i) in millidegrees */
+static const int32_t s_atan_mdeg[CORDIC_STEPS] = {
+    45000, 26565, 14036, 7125, 3576, 1790, 895, 448, 224, 112, 56, 28, 14, 7,
+};
+
+int32_t tilt_angle_cdeg(int32_t along, int32_t normal)
+{
+    int32_t x = along;
+    int32_t y = normal;
+    if (x == 0 && y == 0) {
+        return 0;
+    }
+    while (x > -CORDIC_SCALE_LIMIT && x < CORDIC_SCALE_LIMIT && y > -CORDIC_SCALE_LIMIT &&
+           y < CORDIC_SCALE_LIMIT) {
+        x *= 2;
+        y *= 2;
+    }
+
+    /* Rotate into the right half plane; the steps below converge within +/-99 degrees */
+    int32_t angle = 0;
+    if (x < 0) {
+        int32_t t = x;
+        if (y >= 0) {
+            x = y;
+            y = -t;
+            angle = 90000;
+        } else {
+            x = -y;
+            y = t;
+            angle = -90000;
+        }
+    }
+
+    /* Vectoring mode: rotate y to zero, summing the rotations */
+    for (int i = 0; i < CORDIC_STEPS; i++) {
+        int32_t dx = y >> i;
+        int32_t dy = x >> i;
+        if (y > 0) {
+            x += dx;
+            y -= dy;
+            angle += s_atan_mdeg[i];
+        } else {
+            x -= dx;
+            y += dy;
+            angle -= s_atan_mdeg[i];
+        }
+    }
+    return (angle >= 0 ? angle + 5 : angle - 5) / 10;
+}
+
+int32_t tilt_angle_from_fifo(const uint8_t *data, size_t samples)
+{
+    int32_t along = 0;
+    int32_t normal = 0;
+    for (size_t i = 0; i < samples; i++, data += TILT_SAMPLE_BYTES) {
+        along += (int16_t)(data[0] | (data[1] << 8));
+        normal += (int16_t)(data[4] | (data[5] << 8));
+    }
+    return tilt_angle_cdeg(along, normal);
+}
+
+uint8_t tilt_angle_to_percent(int32_t angle_cdeg, int32_t closed_cdeg, int32_t open_cdeg)
+{
+    int32_t travel = angle_cdeg - closed_cdeg;
+    int32_t span = open_cdeg - closed_cdeg;
+    if (span == 0) {
+        return 0;
+    }
+    if (span < 0) {
+        travel = -travel;
+        span = -span;
+    }
+    if (travel <= 0) {
+        return 0;
+    }
+    if (travel >= span) {
+        return 100;
+    }
+    return (uint8_t)((travel * 100 + span / 2) / span);
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Integer-only signal chain for the panel tilt sensor: a burst of FIFO
+ * samples is averaged, turned into a panel angle and mapped to a door
+ * position. The H2 has no FPU, so the angle comes from a CORDIC (shifts and
+ * adds, well under 0.1 degree) once per burst rather than from atan2f per
+ * sample. Pure functions, so the host tests and benchmarks drive them
+ * directly.
+ */
+
+#define TILT_SAMPLE_BYTES 6 /* X, Y, Z: 16-bit little endian, left justified */
+
+/* atan2(normal, along) in centidegrees, -18000..18000; 0 for a zero vector */
+int32_t tilt_angle_cdeg(int32_t along, int32_t normal);
+/* Panel angle of the burst average; X reads gravity along the panel, Z normal to it */
+int32_t tilt_angle_from_fifo(const uint8_t *data, size_t samples);
+/* Linear between the end-stop angles (either order), clamped to 0..100 */
+uint8_t tilt_angle_to_percent(int32_t angle_cdeg, int32_t closed_cdeg, int32_t open_cdeg);
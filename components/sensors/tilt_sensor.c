@@ -0,0 +1,464 @@
+#include "tilt_sensor.h"
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_attr.h"
+#include "driver/i2c_master.h"
+#include "esp_intr_alloc.h"
+#include "hal/gpio_ll.h"
+#include "reed_switch.h"
+#include "tilt_angle.h"
+#include "sensor_scheduler.h"
+#include "metrics.h"
+#include "tlog.h"
+#include "static_alloc.h"
+#include "mem_budget.h"
+
+#define TAG "tilt_sensor"
+#define DEFAULT_ADDRESS 0x18
+#define DEFAULT_SCL_HZ 400000
+#define DEFAULT_OPEN_CDEG 9000
+#define I2C_TIMEOUT_MS 20
+#define FIFO_DEPTH 32
+/* Released bursts must run before the FIFO can fill up at the idle watermark */
+#define BURST_DEADLINE_MS ((FIFO_DEPTH - TILT_SENSOR_WATERMARK_IDLE) * 1000 / TILT_SENSOR_ODR_HZ)
+/* A burst also runs this long after the last one, should the interrupt never come (sensor reset, INT line cut) */
+#define WATCHDOG_MS (2 * TILT_SENSOR_WATERMARK_IDLE * 1000 / TILT_SENSOR_ODR_HZ)
+/* With the bus failing, the interrupt stays masked and bursts are retried at this period */
+#define BUS_RETRY_MS 1000
+/* End-stop angles closer than this mean a loose or misplaced mount, not a door */
+#define MIN_SPAN_CDEG 2000
+/* A recalibration that moves an end-stop angle this far is logged */
+#define CALIBRATION_LOG_CDEG 100
+
+/* LIS3DH registers; the sub-address MSB selects auto-increment for multi-byte transfers */
+#define REG_WHO_AM_I  0x0F
+#define REG_CTRL_REG1 0x20
+#define REG_OUT_X_L   0x28
+#define REG_FIFO_CTRL 0x2E
+#define REG_FIFO_SRC  0x2F
+#define REG_AUTO_INC  0x80
+
+#define WHO_AM_I_VALUE   0x33
+#define CTRL1_ODR_25HZ   0x30
+#define CTRL1_XYZ_EN     0x07
+#define CTRL3_I1_WTM     0x04
+#define CTRL4_BDU_HR     0x88 /* Block data update, high resolution, +/-2 g */
+#define CTRL5_FIFO_EN    0x40
+#define FIFO_MODE_BYPASS 0x00
+#define FIFO_MODE_STREAM 0x80
+#define FIFO_SRC_OVRN    0x40
+#define FIFO_SRC_FSS     0x1F
+
+#define TILT_METRICS(X)              \
+    X(COUNTER, interrupts)           \
+    X(COUNTER, bursts)               \
+    X(COUNTER, samples)              \
+    X(COUNTER, overruns)             \
+    X(COUNTER, bus_errors)           \
+    X(COUNTER, calibrations)         \
+    X(COUNTER, calibration_rejects)  \
+    X(GAUGE, percent)
+METRICS_GROUP_DEFINE(tilt, TILT_METRICS)
+
+static bool s_initialized = false;
+static tilt_sensor_config_t s_config;
+static i2c_master_bus_handle_t s_bus = NULL;
+static i2c_master_dev_handle_t s_dev = NULL;
+static sensor_id_t s_sensor = -1;
+static SemaphoreHandle_t s_mutex = NULL;
+static tilt_sensor_callback_t s_callback = NULL;
+
+/* One drained FIFO; static, the scheduler task's stack is small */
+static uint8_t s_fifo[FIFO_DEPTH * TILT_SAMPLE_BYTES];
+static bool s_moving = false;
+/* Scheduler task only: the watermark the sensor has (0 unknown), and whether the bus failed */
+static uint8_t s_watermark = 0;
+static bool s_retrying = false;
+static bool s_rejecting = false;
+static bool s_valid = false;
+static int32_t s_closed_cdeg = 0;
+static int32_t s_open_cdeg = DEFAULT_OPEN_CDEG;
+static int32_t s_angle_cdeg = 0;
+static uint8_t s_percent = 0;
+
+STATIC_MUTEX_DEFINE(s_mutex);
+
+static esp_err_t write_reg(uint8_t reg, uint8_t value)
+{
+    const uint8_t buf[2] = {reg, value};
+    return i2c_master_transmit(s_dev, buf, sizeof(buf), I2C_TIMEOUT_MS);
+}
+
+static esp_err_t read_regs(uint8_t reg, uint8_t *out, size_t count)
+{
+    uint8_t sub = reg | (count > 1 ? REG_AUTO_INC : 0);
+    return i2c_master_transmit_receive(s_dev, &sub, 1, out, count, I2C_TIMEOUT_MS);
+}
+
+static esp_err_t set_watermark(uint8_t watermark)
+{
+    return write_reg(REG_FIFO_CTRL, FIFO_MODE_STREAM | watermark);
+}
+
+/* Probes and configures the sensor; sampling starts once the FIFO leaves bypass */
+static esp_err_t configure(void)
+{
+    uint8_t id = 0;
+    esp_err_t ret = read_regs(REG_WHO_AM_I, &id, 1);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    if (id != WHO_AM_I_VALUE) {
+        ESP_LOGE(TAG, "Unexpected WHO_AM_I 0x%02x", id);
+        return ESP_ERR_NOT_FOUND;
+    }
+    ret = write_reg(REG_FIFO_CTRL, FIFO_MODE_BYPASS);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    /* CTRL_REG1..5 in one auto-increment write */
+    const uint8_t ctrl[] = {
+        REG_CTRL_REG1 | REG_AUTO_INC, CTRL1_ODR_25HZ | CTRL1_XYZ_EN, 0x00, CTRL3_I1_WTM, CTRL4_BDU_HR, CTRL5_FIFO_EN,
+    };
+    return i2c_master_transmit(s_dev, ctrl, sizeof(ctrl), I2C_TIMEOUT_MS);
+}
+
+static void release_bus(void)
+{
+    if (s_dev) {
+        i2c_master_bus_rm_device(s_dev);
+        s_dev = NULL;
+    }
+    if (s_bus) {
+        i2c_del_master_bus(s_bus);
+        s_bus = NULL;
+    }
+}
+
+static void IRAM_ATTR watermark_isr(void *arg)
+{
+    /* Level triggered: masked until the burst has drained the FIFO below the watermark */
+    gpio_ll_intr_disable(&GPIO, s_config.int_pin);
+    METRIC_INC(interrupts);
+    sensor_scheduler_release_from_isr(s_sensor);
+}
+
+/* Moves an end-stop angle to what the panel reads there. Caller holds s_mutex */
+static void calibrate(door_position_t end_stop, int32_t angle_cdeg)
+{
+    int32_t *reference = (end_stop == DOOR_POSITION_CLOSED) ? &s_closed_cdeg : &s_open_cdeg;
+    int32_t other = (end_stop == DOOR_POSITION_CLOSED) ? s_open_cdeg : s_closed_cdeg;
+    if (abs(angle_cdeg - other) < MIN_SPAN_CDEG) {
+        METRIC_INC(calibration_rejects);
+        if (!s_rejecting) {
+            TLOGW(TAG, "Panel at %ld cdeg %s, too close to the other end stop", (long)angle_cdeg,
+                  end_stop == DOOR_POSITION_CLOSED ? "closed" : "open");
+        }
+        s_rejecting = true;
+        return;
+    }
+    s_rejecting = false;
+    if (abs(angle_cdeg - *reference) >= CALIBRATION_LOG_CDEG) {
+        METRIC_INC(calibrations);
+        TLOGI(TAG, "%s end stop at %ld cdeg (was %ld)", end_stop == DOOR_POSITION_CLOSED ? "Closed" : "Open",
+              (long)angle_cdeg, (long)*reference);
+    }
+    *reference = angle_cdeg;
+}
+
+/* Fuses a burst angle with the reeds; returns true when the position changed. Caller holds s_mutex */
+static bool update_position(int32_t angle_cdeg)
+{
+    s_angle_cdeg = angle_cdeg;
+    door_position_t end_stop = reed_switch_get_position();
+    if (!s_moving && (end_stop == DOOR_POSITION_CLOSED || end_stop == DOOR_POSITION_OPEN)) {
+        calibrate(end_stop, angle_cdeg);
+    }
+
+    uint8_t percent = tilt_angle_to_percent(angle_cdeg, s_closed_cdeg, s_open_cdeg);
+    switch (end_stop) {
+        case DOOR_POSITION_CLOSED:
+            percent = 0;
+            break;
+        case DOOR_POSITION_OPEN:
+            percent = 100;
+            break;
+        case DOOR_POSITION_BETWEEN:
+            /* Off both reeds the door is at neither end, whatever the angle says */
+            percent = percent < 1 ? 1 : (percent > 99 ? 99 : percent);
+            break;
+        default:
+            break; /* Reeds unknown or contradictory: the panel is all there is */
+    }
+
+    bool changed = !s_valid || percent != s_percent;
+    s_percent = percent;
+    s_valid = true;
+    METRIC_SET(percent, percent);
+    return changed;
+}
+
+/* Reads the fill level, then drains the FIFO into s_fifo in one auto-increment read */
+static esp_err_t drain(size_t *samples)
+{
+    uint8_t src = 0;
+    esp_err_t ret = read_regs(REG_FIFO_SRC, &src, 1);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    *samples = src & FIFO_SRC_FSS;
+    if (src & FIFO_SRC_OVRN) {
+        METRIC_INC(overruns);
+    }
+    if (*samples == 0) {
+        return ESP_OK;
+    }
+    ret = read_regs(REG_OUT_X_L, s_fifo, *samples * TILT_SAMPLE_BYTES);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    METRIC_INC(bursts);
+    METRIC_ADD(samples, *samples);
+    return ESP_OK;
+}
+
+/*
+ * Released by the watermark interrupt, by tilt_sensor_set_moving(), or by
+ * the watchdog period. Once initialized only this task touches
+ * the bus, so s_mutex is never held across a transfer.
+ */
+static void burst(void *ctx)
+{
+    LOCK_TAKE(s_mutex);
+    uint8_t watermark = s_moving ? TILT_SENSOR_WATERMARK_MOVING : TILT_SENSOR_WATERMARK_IDLE;
+    LOCK_GIVE(s_mutex);
+
+    esp_err_t ret = ESP_OK;
+    if (s_retrying) {
+        /* Gone from the bus, it may have lost power too: set it up again before draining */
+        ret = configure();
+        s_watermark = 0;
+    }
+    if (ret == ESP_OK && watermark != s_watermark) {
+        ret = set_watermark(watermark);
+        s_watermark = (ret == ESP_OK) ? watermark : 0;
+    }
+    size_t samples = 0;
+    if (ret == ESP_OK) {
+        ret = drain(&samples);
+    }
+
+    bool changed = false;
+    LOCK_TAKE(s_mutex);
+    if (ret == ESP_OK && samples > 0) {
+        changed = update_position(tilt_angle_from_fifo(s_fifo, samples));
+    }
+    uint8_t percent = s_percent;
+    LOCK_GIVE(s_mutex);
+
+    bool was_retrying = s_retrying;
+    s_retrying = ret != ESP_OK;
+    if (ret != ESP_OK) {
+        METRIC_INC(bus_errors);
+        if (!was_retrying) {
+            TLOGW(TAG, "Burst read failed (0x%x), retrying every %d ms", ret, BUS_RETRY_MS);
+            sensor_scheduler_set_period(s_sensor, BUS_RETRY_MS);
+        }
+        return;
+    }
+    if (was_retrying) {
+        TLOGI(TAG, "Bus recovered");
+        sensor_scheduler_set_period(s_sensor, WATCHDOG_MS);
+    }
+    gpio_intr_enable(s_config.int_pin);
+
+    if (changed && s_callback) {
+        s_callback(percent);
+    }
+}
+
+esp_err_t tilt_sensor_init(const tilt_sensor_config_t *config)
+{
+    if (s_initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (!config) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    memcpy(&s_config, config, sizeof(s_config));
+    if (!s_config.address) {
+        s_config.address = DEFAULT_ADDRESS;
+    }
+    if (!s_config.scl_speed_hz) {
+        s_config.scl_speed_hz = DEFAULT_SCL_HZ;
+    }
+    s_closed_cdeg = config->closed_cdeg;
+    s_open_cdeg = config->open_cdeg;
+    if (s_closed_cdeg == 0 && s_open_cdeg == 0) {
+        s_open_cdeg = DEFAULT_OPEN_CDEG;
+    }
+
+    s_moving = false;
+    s_watermark = 0;
+    s_retrying = false;
+    s_rejecting = false;
+    s_valid = false;
+    s_percent = 0;
+    s_angle_cdeg = 0;
+
+    s_mutex = STATIC_MUTEX_CREATE(s_mutex);
+    if (!s_mutex) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    const i2c_master_bus_config_t bus_config = {
+        .i2c_port = -1,
+        .sda_io_num = config->sda_pin,
+        .scl_io_num = config->scl_pin,
+        .clk_source = I2C_CLK_SRC_DEFAULT,
+        .glitch_ignore_cnt = 7,
+        .flags.enable_internal_pullup = true,
+    };
+    esp_err_t ret = i2c_new_master_bus(&bus_config, &s_bus);
+    if (ret != ESP_OK) {
+        vSemaphoreDelete(s_mutex);
+        return ret;
+    }
+    const i2c_device_config_t dev_config = {
+        .dev_addr_length = I2C_ADDR_BIT_LEN_7,
+        .device_address = s_config.address,
+        .scl_speed_hz = s_config.scl_speed_hz,
+    };
+    ret = i2c_master_bus_add_device(s_bus, &dev_config, &s_dev);
+    if (ret == ESP_OK) {
+        ret = configure();
+    }
+    if (ret != ESP_OK) {
+        release_bus();
+        vSemaphoreDelete(s_mutex);
+        return ret;
+    }
+
+    /* The watermark interrupt releases every burst, restarting the watchdog period each time */
+    const sensor_desc_t desc = {
+        .name = "tilt",
+        .period_ms = WATCHDOG_MS,
+        .deadline_ms = BURST_DEADLINE_MS,
+        .sample = burst,
+    };
+    ret = sensor_scheduler_register(&desc, &s_sensor);
+    if (ret != ESP_OK) {
+        write_reg(REG_CTRL_REG1, 0);
+        release_bus();
+        vSemaphoreDelete(s_mutex);
+        return ret;
+    }
+
+    gpio_config_t io_conf = {
+        .pin_bit_mask = (1ULL << config->int_pin),
+        .mode = GPIO_MODE_INPUT,
+        .pull_up_en = GPIO_PULLUP_DISABLE,
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .intr_type = GPIO_INTR_HIGH_LEVEL
+    };
+    ret = gpio_config(&io_conf);
+    if (ret == ESP_OK) {
+        /* Shared with the reed switches: every handler on it must be IRAM-safe */
+        ret = gpio_install_isr_service(ESP_INTR_FLAG_IRAM);
+        ret = (ret == ESP_ERR_INVALID_STATE) ? ESP_OK : ret;
+    }
+    if (ret == ESP_OK) {
+        ret = gpio_isr_handler_add(config->int_pin, watermark_isr, NULL);
+    }
+    if (ret == ESP_OK) {
+        /* Leaving bypass starts filling the FIFO; the interrupt is ready for it */
+        ret = set_watermark(TILT_SENSOR_WATERMARK_IDLE);
+        s_watermark = TILT_SENSOR_WATERMARK_IDLE;
+        if (ret != ESP_OK) {
+            gpio_isr_handler_remove(config->int_pin);
+        }
+    }
+    if (ret != ESP_OK) {
+        sensor_scheduler_unregister(s_sensor);
+        s_sensor = -1;
+        write_reg(REG_CTRL_REG1, 0);
+        release_bus();
+        vSemaphoreDelete(s_mutex);
+        return ret;
+    }
+
+    mem_budget_register_static(TAG, STATIC_MUTEX_BYTES + sizeof(s_fifo));
+    s_initialized = true;
+
+    ESP_LOGI(TAG, "Initialized at 0x%02x on pins %d (sda), %d (scl), %d (int), %d Hz", s_config.address,
+             config->sda_pin, config->scl_pin, config->int_pin, TILT_SENSOR_ODR_HZ);
+    return ESP_OK;
+}
+
+esp_err_t tilt_sensor_deinit(void)
+{
+    if (!s_initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    gpio_intr_disable(s_config.int_pin);
+    gpio_isr_handler_remove(s_config.int_pin);
+    sensor_scheduler_unregister(s_sensor);
+    s_sensor = -1;
+    write_reg(REG_CTRL_REG1, 0); /* Power down */
+    release_bus();
+
+    vSemaphoreDelete(s_mutex);
+    s_mutex = NULL;
+    s_callback = NULL;
+    s_initialized = false;
+    return ESP_OK;
+}
+
+esp_err_t tilt_sensor_set_moving(bool moving)
+{
+    if (!s_initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    LOCK_TAKE(s_mutex);
+    bool changed = moving != s_moving;
+    s_moving = moving;
+    LOCK_GIVE(s_mutex);
+    /* The burst writes the new watermark, and drains what the old one held back */
+    return changed ? sensor_scheduler_release(s_sensor) : ESP_OK;
+}
+
+esp_err_t tilt_sensor_get_position(uint8_t *percent)
+{
+    if (!percent) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!s_initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    LOCK_TAKE(s_mutex);
+    esp_err_t ret = s_valid ? ESP_OK : ESP_ERR_INVALID_STATE;
+    *percent = s_percent;
+    LOCK_GIVE(s_mutex);
+    return ret;
+}
+
+int32_t tilt_sensor_angle_cdeg(void)
+{
+    return s_angle_cdeg;
+}
+
+esp_err_t tilt_sensor_register_callback(tilt_sensor_callback_t callback)
+{
+    if (!callback) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_callback = callback;
+    return ESP_OK;
+}
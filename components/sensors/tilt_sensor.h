@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "driver/gpio.h"
+
+/*
+ * LIS3DH-class I2C accelerometer on the door panel: a position source
+ * between the reed end stops. The sensor samples on its own into its 32-level
+ * FIFO and raises INT1 once a watermark's worth is waiting; the interrupt
+ * releases a burst on the sensor scheduler task (sensor_scheduler_init()
+ * first), which reads the fill level and drains the FIFO in one
+ * auto-increment read. The CPU wakes once and the bus carries two
+ * transactions per burst, not per sample.
+ *
+ * Each burst is averaged into a panel angle (tilt_angle.h) and mapped
+ * linearly between the angles at the closed and open end stops, which the
+ * reeds recalibrate whenever the door rests at one. The reeds stay
+ * authoritative: 0 or 100 only at an end stop, 1..99 between them. Mount the
+ * sensor with X up the panel and Z facing out of the garage, on a panel
+ * whose tilt changes over the whole travel (a one-piece door, or the top
+ * section of a sectional door).
+ */
+
+typedef struct {
+    gpio_num_t sda_pin;
+    gpio_num_t scl_pin;
+    gpio_num_t int_pin;    /* INT1, push-pull, active high */
+    uint8_t address;       /* 0: 0x18 (SA0 low) */
+    uint32_t scl_speed_hz; /* 0: 400 kHz */
+    int16_t closed_cdeg;   /* Panel angles at the end stops until the reeds have seen them; */
+    int16_t open_cdeg;     /* both 0: vertical closed, horizontal open */
+} tilt_sensor_config_t;
+
+typedef void (*tilt_sensor_callback_t)(uint8_t percent);
+
+#define TILT_SENSOR_ODR_HZ 25
+/* Samples per burst: a position every 200 ms while the door moves, every second otherwise */
+#define TILT_SENSOR_WATERMARK_MOVING 5
+#define TILT_SENSOR_WATERMARK_IDLE   25
+
+esp_err_t tilt_sensor_init(const tilt_sensor_config_t *config);
+esp_err_t tilt_sensor_deinit(void);
+/* Selects the watermark; call on every door state change. Never blocks on the bus: a burst applies it */
+esp_err_t tilt_sensor_set_moving(bool moving);
+/* 0 closed .. 100 open; ESP_ERR_INVALID_STATE before the first burst */
+esp_err_t tilt_sensor_get_position(uint8_t *percent);
+/* Panel angle of the latest burst, centidegrees from vertical */
+int32_t tilt_sensor_angle_cdeg(void);
+/* Called from the sensor scheduler task when the position changes */
+esp_err_t tilt_sensor_register_callback(tilt_sensor_callback_t callback);
@@ -0,0 +1,340 @@
+#include "ultrasonic.h"
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_attr.h"
+#include "esp_timer.h"
+#include "esp_rom_sys.h"
+#include "driver/rmt_rx.h"
+#include "range_filter.h"
+#include "sensor_scheduler.h"
+#include "metrics.h"
+#include "tlog.h"
+#include "static_alloc.h"
+#include "mem_budget.h"
+
+#define TAG "ultrasonic"
+#define RMT_RESOLUTION_HZ 1000000 /* 1 tick = 1 us */
+#define TRIGGER_PULSE_US 10
+#define ECHO_GLITCH_NS 1000
+/* Receive ends after this much silence; above the 4 m echo (23.3 ms), below the RMT idle limit */
+#define ECHO_IDLE_NS (30 * 1000 * 1000)
+#define ECHO_MIN_US 117   /* 2 cm */
+#define ECHO_MAX_US 23300 /* 4 m */
+#define ECHO_NONE 0
+#define ECHO_SYMBOLS 8
+
+#define DEFAULT_PRESENT_BELOW_MM 1500
+#define DEFAULT_HYSTERESIS_MM 200
+#define DEFAULT_CONFIRM_SAMPLES 2
+
+#define ULTRASONIC_METRICS(X)    \
+    X(COUNTER, samples)          \
+    X(COUNTER, no_echo)          \
+    X(COUNTER, outliers)         \
+    X(COUNTER, presence_changes) \
+    X(GAUGE, distance_mm)        \
+    X(GAUGE, rate)
+METRICS_GROUP_DEFINE(ultrasonic, ULTRASONIC_METRICS)
+
+static bool s_initialized = false;
+static ultrasonic_config_t s_config;
+static presence_config_t s_presence_config;
+static rmt_channel_handle_t s_rx_channel = NULL;
+static sensor_id_t s_sensor = -1;
+static SemaphoreHandle_t s_mutex = NULL;
+static ultrasonic_callback_t s_callback = NULL;
+
+/* Written by the RMT ISR, consumed by the next sample tick */
+static rmt_symbol_word_t s_symbols[ECHO_SYMBOLS];
+static volatile uint32_t s_echo_us = ECHO_NONE;
+static volatile bool s_echo_ready = false;
+static volatile bool s_receiving = false;
+
+static range_filter_t s_filter;
+static presence_state_t s_presence;
+static uint16_t s_distance_mm = 0;
+static ultrasonic_activity_t s_activity = ULTRASONIC_ACTIVITY_OPEN;
+static ultrasonic_rate_t s_rate = ULTRASONIC_RATE_OFF;
+static int64_t s_stable_since_us = 0;
+
+STATIC_MUTEX_DEFINE(s_mutex);
+
+static bool IRAM_ATTR echo_done_callback(rmt_channel_handle_t channel, const rmt_rx_done_event_data_t *edata,
+                                         void *ctx)
+{
+    uint32_t echo_us = ECHO_NONE;
+    for (size_t i = 0; i < edata->num_symbols; i++) {
+        if (edata->received_symbols[i].level0) {
+            echo_us = edata->received_symbols[i].duration0;
+            break;
+        }
+        if (edata->received_symbols[i].level1) {
+            echo_us = edata->received_symbols[i].duration1;
+            break;
+        }
+    }
+    s_echo_us = echo_us;
+    s_echo_ready = true;
+    s_receiving = false;
+    return false;
+}
+
+/* Sampling period for the current activity; caller holds s_mutex */
+static ultrasonic_rate_t select_rate(void)
+{
+    switch (s_activity) {
+        case ULTRASONIC_ACTIVITY_MOVING:
+            return ULTRASONIC_RATE_FAST;
+        case ULTRASONIC_ACTIVITY_CLOSED:
+            if (esp_timer_get_time() - s_stable_since_us >= (int64_t)ULTRASONIC_STABLE_OFF_MS * 1000) {
+                return ULTRASONIC_RATE_OFF;
+            }
+            return ULTRASONIC_RATE_SLOW;
+        default:
+            return ULTRASONIC_RATE_SLOW;
+    }
+}
+
+/* Caller holds s_mutex */
+static void apply_rate(ultrasonic_rate_t rate)
+{
+    if (rate == s_rate) {
+        return;
+    }
+    uint32_t period_ms = 0;
+    if (rate != ULTRASONIC_RATE_OFF) {
+        period_ms = (rate == ULTRASONIC_RATE_FAST) ? ULTRASONIC_FAST_PERIOD_MS : ULTRASONIC_SLOW_PERIOD_MS;
+    }
+    sensor_scheduler_set_period(s_sensor, period_ms);
+    TLOGD(TAG, "Sampling rate %d -> %d", s_rate, rate);
+    s_rate = rate;
+    METRIC_SET(rate, rate);
+}
+
+static void start_measurement(void)
+{
+    if (s_receiving) {
+        /* No edge at all since the last trigger (sensor unplugged): abort the receive */
+        rmt_disable(s_rx_channel);
+        rmt_enable(s_rx_channel);
+        s_receiving = false;
+    }
+
+    const rmt_receive_config_t receive_config = {
+        .signal_range_min_ns = ECHO_GLITCH_NS,
+        .signal_range_max_ns = ECHO_IDLE_NS,
+    };
+    s_echo_ready = false;
+    s_receiving = true;
+    if (rmt_receive(s_rx_channel, s_symbols, sizeof(s_symbols), &receive_config) != ESP_OK) {
+        s_receiving = false;
+        return;
+    }
+
+    gpio_set_level(s_config.trig_pin, 1);
+    esp_rom_delay_us(TRIGGER_PULSE_US);
+    gpio_set_level(s_config.trig_pin, 0);
+}
+
+/* Filters the previous measurement; returns true when presence changed. Caller holds s_mutex */
+static bool process_echo(void)
+{
+    if (!s_echo_ready && !s_receiving) {
+        return false; /* First tick after a pause: nothing was triggered */
+    }
+    uint32_t echo_us = s_echo_ready ? s_echo_us : ECHO_NONE;
+    s_echo_ready = false;
+    METRIC_INC(samples);
+
+    if (echo_us < ECHO_MIN_US || echo_us > ECHO_MAX_US) {
+        METRIC_INC(no_echo);
+        return false;
+    }
+
+    uint16_t median_mm;
+    uint32_t outliers = s_filter.outliers;
+    bool accepted = range_filter_add(&s_filter, range_echo_to_mm(echo_us), &median_mm);
+    METRIC_ADD(outliers, s_filter.outliers - outliers);
+    if (!accepted) {
+        return false;
+    }
+
+    s_distance_mm = median_mm;
+    METRIC_SET(distance_mm, median_mm);
+    if (!presence_update(&s_presence, &s_presence_config, median_mm)) {
+        return false;
+    }
+    METRIC_INC(presence_changes);
+    s_stable_since_us = esp_timer_get_time();
+    return true;
+}
+
+/* Pipelined: each tick consumes the echo triggered by the previous one, then triggers the next */
+static void sample(void *ctx)
+{
+    LOCK_TAKE(s_mutex);
+    bool changed = process_echo();
+    bool present = s_presence.present;
+    uint16_t distance_mm = s_distance_mm;
+    apply_rate(select_rate());
+    if (s_rate != ULTRASONIC_RATE_OFF) {
+        start_measurement();
+    }
+    LOCK_GIVE(s_mutex);
+
+    if (changed) {
+        TLOGI(TAG, "Vehicle %s (%u mm)", present ? "present" : "absent", distance_mm);
+        if (s_callback) {
+            s_callback(present, distance_mm);
+        }
+    }
+}
+
+esp_err_t ultrasonic_init(const ultrasonic_config_t *config)
+{
+    if (s_initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (!config) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    memcpy(&s_config, config, sizeof(s_config));
+    s_presence_config = (presence_config_t){
+        .present_below_mm = config->present_below_mm ? config->present_below_mm : DEFAULT_PRESENT_BELOW_MM,
+        .hysteresis_mm = config->hysteresis_mm ? config->hysteresis_mm : DEFAULT_HYSTERESIS_MM,
+        .confirm_samples = config->confirm_samples ? config->confirm_samples : DEFAULT_CONFIRM_SAMPLES,
+    };
+
+    s_mutex = STATIC_MUTEX_CREATE(s_mutex);
+    if (!s_mutex) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    gpio_config_t io_conf = {
+        .pin_bit_mask = (1ULL << config->trig_pin),
+        .mode = GPIO_MODE_OUTPUT,
+        .pull_up_en = GPIO_PULLUP_DISABLE,
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .intr_type = GPIO_INTR_DISABLE
+    };
+    esp_err_t ret = gpio_config(&io_conf);
+    if (ret != ESP_OK) {
+        vSemaphoreDelete(s_mutex);
+        return ret;
+    }
+    gpio_set_level(config->trig_pin, 0);
+
+    const rmt_rx_channel_config_t rx_config = {
+        .gpio_num = config->echo_pin,
+        .clk_src = RMT_CLK_SRC_DEFAULT,
+        .resolution_hz = RMT_RESOLUTION_HZ,
+        .mem_block_symbols = 48,
+    };
+    ret = rmt_new_rx_channel(&rx_config, &s_rx_channel);
+    if (ret != ESP_OK) {
+        vSemaphoreDelete(s_mutex);
+        return ret;
+    }
+    const rmt_rx_event_callbacks_t callbacks = {
+        .on_recv_done = echo_done_callback,
+    };
+    rmt_rx_register_event_callbacks(s_rx_channel, &callbacks, NULL);
+    rmt_enable(s_rx_channel);
+
+    /* Registered paused; apply_rate() below sets the period */
+    const sensor_desc_t desc = {
+        .name = "ultrasonic",
+        .period_ms = 0,
+        .sample = sample,
+    };
+    ret = sensor_scheduler_register(&desc, &s_sensor);
+    if (ret != ESP_OK) {
+        rmt_disable(s_rx_channel);
+        rmt_del_channel(s_rx_channel);
+        s_rx_channel = NULL;
+        vSemaphoreDelete(s_mutex);
+        return ret;
+    }
+
+    range_filter_reset(&s_filter);
+    memset(&s_presence, 0, sizeof(s_presence));
+    s_distance_mm = 0;
+    s_receiving = false;
+    s_echo_ready = false;
+    s_rate = ULTRASONIC_RATE_OFF;
+    s_activity = ULTRASONIC_ACTIVITY_OPEN;
+    s_stable_since_us = esp_timer_get_time();
+    mem_budget_register_static(TAG, STATIC_MUTEX_BYTES);
+
+    s_initialized = true;
+    LOCK_TAKE(s_mutex);
+    apply_rate(select_rate());
+    LOCK_GIVE(s_mutex);
+
+    ESP_LOGI(TAG, "Initialized on pins %d (trig), %d (echo), present below %u mm", config->trig_pin,
+             config->echo_pin, s_presence_config.present_below_mm);
+    return ESP_OK;
+}
+
+esp_err_t ultrasonic_deinit(void)
+{
+    if (!s_initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    sensor_scheduler_unregister(s_sensor);
+    s_sensor = -1;
+    rmt_disable(s_rx_channel);
+    rmt_del_channel(s_rx_channel);
+    s_rx_channel = NULL;
+    gpio_set_level(s_config.trig_pin, 0);
+
+    vSemaphoreDelete(s_mutex);
+    s_mutex = NULL;
+    s_callback = NULL;
+    s_initialized = false;
+    return ESP_OK;
+}
+
+esp_err_t ultrasonic_set_activity(ultrasonic_activity_t activity)
+{
+    if (!s_initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    LOCK_TAKE(s_mutex);
+    if (activity != s_activity) {
+        s_activity = activity;
+        s_stable_since_us = esp_timer_get_time();
+        apply_rate(select_rate());
+    }
+    LOCK_GIVE(s_mutex);
+    return ESP_OK;
+}
+
+ultrasonic_rate_t ultrasonic_get_rate(void)
+{
+    return s_rate;
+}
+
+bool ultrasonic_vehicle_present(void)
+{
+    return s_presence.present;
+}
+
+uint16_t ultrasonic_distance_mm(void)
+{
+    return s_distance_mm;
+}
+
+esp_err_t ultrasonic_register_callback(ultrasonic_callback_t callback)
+{
+    if (!callback) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_callback = callback;
+    return ESP_OK;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "driver/gpio.h"
+
+/*
+ * HC-SR04 vehicle presence sensor. The echo pulse is timed by an RMT receive
+ * channel, so no CPU time is spent waiting for it; samples go through
+ * range_filter.h and a debounced presence decision. Samples are taken by the
+ * sensor scheduler (sensor_scheduler_init() first). Sampling is adaptive:
+ * fast while the door moves, slow while it stands open, and off once the bay
+ * has been stable behind a closed door (nothing can enter or leave).
+ */
+
+typedef struct {
+    gpio_num_t trig_pin;
+    gpio_num_t echo_pin;
+    uint16_t present_below_mm; /* Ceiling mount: a car roof is closer than the floor */
+    uint16_t hysteresis_mm;
+    uint8_t confirm_samples;
+} ultrasonic_config_t;
+
+typedef enum {
+    ULTRASONIC_ACTIVITY_MOVING,
+    ULTRASONIC_ACTIVITY_OPEN,
+    ULTRASONIC_ACTIVITY_CLOSED,
+} ultrasonic_activity_t;
+
+typedef enum {
+    ULTRASONIC_RATE_OFF,
+    ULTRASONIC_RATE_SLOW,
+    ULTRASONIC_RATE_FAST,
+} ultrasonic_rate_t;
+
+typedef void (*ultrasonic_callback_t)(bool vehicle_present, uint16_t distance_mm);
+
+#define ULTRASONIC_FAST_PERIOD_MS 200
+#define ULTRASONIC_SLOW_PERIOD_MS 2000
+#define ULTRASONIC_STABLE_OFF_MS  60000
+
+esp_err_t ultrasonic_init(const ultrasonic_config_t *config);
+esp_err_t ultrasonic_deinit(void);
+/* Drives the sampling rate; call on every door state change */
+esp_err_t ultrasonic_set_activity(ultrasonic_activity_t activity);
+ultrasonic_rate_t ultrasonic_get_rate(void);
+bool ultrasonic_vehicle_present(void);
+/* Latest filtered distance, 0 before the first accepted sample */
+uint16_t ultrasonic_distance_mm(void);
+/* Called from the sensor scheduler task when the debounced presence changes */
+esp_err_t ultrasonic_register_callback(ultrasonic_callback_t callback);
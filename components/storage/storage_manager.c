@@ -1,10 +1,18 @@
 #include "storage_manager.h"
+#include <stddef.h>
 #include <string.h>
+#include "sdkconfig.h"
+#include "esp_attr.h"
 #include "esp_log.h"
 #include "nvs_flash.h"
 #include "nvs.h"
+#include "esp_rom_crc.h"
 #include "esp_system.h"
 #include "esp_timer.h"
+#include "metrics.h"
+#include "mem_budget.h"
+#include "span.h"
+#include "static_alloc.h"
 
 #define TAG "storage"
 
@@ -15,13 +23,251 @@
 #define KEY_MAX_PULSE_DURATION "max_pulse"
 #define KEY_MIN_INTERVAL "min_int"
 #define KEY_DOOR_STATE "door_state"
+#define KEY_MOTION_START "start_ms"
 #define KEY_EVENT_COUNT "evt_count"
+#define KEY_EVENT_RESERVED "evt_resv"
+#define KEY_RULES "rules"
 
 #define MAX_EVENT_LOGS 100
 
+#define STORAGE_METRICS(X)          \
+    X(COUNTER, nvs_commits)         \
+    X(COUNTER, nvs_bytes)           \
+    X(COUNTER, nvs_commit_errors)   \
+    X(COUNTER, events_logged)       \
+    X(COUNTER, deferred_writes)     \
+    X(COUNTER, checkpoints)
+METRICS_GROUP_DEFINE(storage, STORAGE_METRICS)
+
 static bool s_initialized = false;
 static nvs_handle_t s_nvs_handle = 0;
 
+#if CONFIG_GARAGE_STATE_SNAPSHOT
+#define SNAPSHOT_MAGIC   0x50534753 /* "SGSP" */
+#define SNAPSHOT_VERSION 2
+
+/* All 32-bit fields, so no padding goes into the CRC */
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t door_state;
+    uint32_t state_dirty;
+    uint32_t flash_next;     /* Sequence number of the next event NVS takes */
+    uint32_t pending_count;  /* Events from flash_next on, not yet in NVS */
+    uint32_t reserved;       /* Sequence numbers below it are reserved in NVS (evt_resv) */
+    event_log_t pending[STORAGE_PENDING_EVENTS];
+    storage_transition_t transitions[STORAGE_TRANSITIONS];
+    uint32_t transition_count;
+    uint32_t warm_boots;
+    uint32_t deferred_writes;
+    uint32_t checkpoints;
+    uint32_t crc;            /* Of everything before it */
+} snapshot_t;
+
+/* Left alone by the startup code: whatever the last run wrote, or garbage after a power-on */
+static __NOINIT_ATTR snapshot_t s_snapshot;
+static bool s_restored = false;
+static SemaphoreHandle_t s_snapshot_mutex = NULL;
+STATIC_MUTEX_DEFINE(s_snapshot_mutex);
+#endif
+
+/* Commit pending writes; bytes is the payload written since the last commit */
+static esp_err_t commit(size_t bytes)
+{
+    SPAN_BEGIN(SPAN_NVS_COMMIT);
+    esp_err_t ret = nvs_commit(s_nvs_handle);
+    SPAN_END(SPAN_NVS_COMMIT);
+    METRIC_INC(nvs_commits);
+    if (ret == ESP_OK) {
+        METRIC_ADD(nvs_bytes, bytes);
+    } else {
+        METRIC_INC(nvs_commit_errors);
+    }
+    return ret;
+}
+
+/*
+ * The event log is a ring of MAX_EVENT_LOGS slots. evt_count is the sequence
+ * number of the next event and seq % MAX_EVENT_LOGS its slot, so the retained
+ * events are the last MAX_EVENT_LOGS sequence numbers. Before sequence
+ * numbers, evt_count was the next slot itself and wrapped at MAX_EVENT_LOGS:
+ * if that slot already holds an entry, such a ring has wrapped and its
+ * numbering continues one lap on.
+ */
+static esp_err_t flash_next_seq(uint32_t *next)
+{
+    *next = 0;
+    esp_err_t ret = nvs_get_u32(s_nvs_handle, KEY_EVENT_COUNT, next);
+    if (ret == ESP_ERR_NVS_NOT_FOUND) {
+        return ESP_OK;
+    }
+    if (ret != ESP_OK) return ret;
+    
+    if (*next < MAX_EVENT_LOGS) {
+        char key[32];
+        snprintf(key, sizeof(key), "evt_%" PRIu32, *next);
+        size_t size = 0;
+        if (nvs_get_blob(s_nvs_handle, key, NULL, &size) == ESP_OK) {
+            *next += MAX_EVENT_LOGS;
+        }
+    }
+    return ESP_OK;
+}
+
+static esp_err_t write_slot(uint32_t seq, const event_log_t *log)
+{
+    char key[32];
+    snprintf(key, sizeof(key), "evt_%" PRIu32, seq % MAX_EVENT_LOGS);
+    return nvs_set_blob(s_nvs_handle, key, log, sizeof(event_log_t));
+}
+
+#if CONFIG_GARAGE_STATE_SNAPSHOT
+static uint32_t snapshot_crc(void)
+{
+    return esp_rom_crc32_le(0, (const uint8_t *)&s_snapshot, offsetof(snapshot_t, crc));
+}
+
+static void snapshot_seal(void)
+{
+    s_snapshot.crc = snapshot_crc();
+}
+
+/* No-init RAM holds garbage after these */
+static bool warm_reset(esp_reset_reason_t reason)
+{
+    return reason != ESP_RST_POWERON && reason != ESP_RST_BROWNOUT && reason != ESP_RST_DEEPSLEEP &&
+           reason != ESP_RST_UNKNOWN;
+}
+
+static bool snapshot_intact(void)
+{
+    return s_snapshot.magic == SNAPSHOT_MAGIC && s_snapshot.version == SNAPSHOT_VERSION &&
+           s_snapshot.pending_count <= STORAGE_PENDING_EVENTS && s_snapshot.crc == snapshot_crc();
+}
+
+/*
+ * Pending events are readable, and so numbered, before they reach NVS, so
+ * their sequence numbers are reserved in NVS first: a snapshot lost with RAM
+ * may have handed out any number below evt_resv. Those numbers are skipped,
+ * never given to other events, and their slots, which hold entries one lap
+ * older, are erased so the skipped numbers read as gaps.
+ */
+static void skip_reserved(uint32_t reserved)
+{
+    uint32_t from = s_snapshot.flash_next;
+    for (uint32_t seq = from; seq < reserved; seq++) {
+        char key[32];
+        snprintf(key, sizeof(key), "evt_%" PRIu32, seq % MAX_EVENT_LOGS);
+        nvs_erase_key(s_nvs_handle, key);
+    }
+    esp_err_t ret = nvs_set_u32(s_nvs_handle, KEY_EVENT_COUNT, reserved);
+    if (ret == ESP_OK) {
+        ret = commit(sizeof(uint32_t));
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Skipping event numbers not stored: %s", esp_err_to_name(ret));
+    }
+    /* Skipped in RAM regardless: a gap is better than a number used twice */
+    s_snapshot.flash_next = reserved;
+    ESP_LOGI(TAG, "Event numbers %" PRIu32 "-%" PRIu32 " lost with the RAM snapshot", from, reserved - 1);
+}
+
+/* A fresh snapshot of what NVS holds */
+static void snapshot_load_flash(void)
+{
+    memset(&s_snapshot, 0, sizeof(s_snapshot));
+    s_snapshot.magic = SNAPSHOT_MAGIC;
+    s_snapshot.version = SNAPSHOT_VERSION;
+    if (nvs_get_u32(s_nvs_handle, KEY_DOOR_STATE, &s_snapshot.door_state) != ESP_OK) {
+        s_snapshot.door_state = STORAGE_DOOR_STATE_NONE;
+    }
+    flash_next_seq(&s_snapshot.flash_next);
+    uint32_t reserved = 0;
+    if (nvs_get_u32(s_nvs_handle, KEY_EVENT_RESERVED, &reserved) == ESP_OK && reserved > s_snapshot.flash_next) {
+        skip_reserved(reserved);
+    }
+    s_snapshot.reserved = s_snapshot.flash_next;
+    snapshot_seal();
+}
+
+/* Caller holds s_snapshot_mutex: numbers up to a full pending ring past seq */
+static esp_err_t reserve_locked(uint32_t seq)
+{
+    uint32_t reserved = seq + STORAGE_PENDING_EVENTS;
+    esp_err_t ret = nvs_set_u32(s_nvs_handle, KEY_EVENT_RESERVED, reserved);
+    if (ret == ESP_OK) {
+        ret = commit(sizeof(uint32_t));
+    }
+    if (ret == ESP_OK) {
+        s_snapshot.reserved = reserved;
+        snapshot_seal();
+    }
+    return ret;
+}
+
+/* Caller holds s_snapshot_mutex */
+static esp_err_t checkpoint_locked(void)
+{
+    size_t bytes = 0;
+    esp_err_t ret = ESP_OK;
+    if (s_snapshot.state_dirty) {
+        ret = nvs_set_u32(s_nvs_handle, KEY_DOOR_STATE, s_snapshot.door_state);
+        bytes += sizeof(uint32_t);
+    }
+    for (uint32_t i = 0; ret == ESP_OK && i < s_snapshot.pending_count; i++) {
+        ret = write_slot(s_snapshot.flash_next + i, &s_snapshot.pending[i]);
+        bytes += sizeof(event_log_t);
+    }
+    uint32_t next = s_snapshot.flash_next + s_snapshot.pending_count;
+    uint32_t reserved = s_snapshot.reserved;
+    if (ret == ESP_OK && s_snapshot.pending_count) {
+        ret = nvs_set_u32(s_nvs_handle, KEY_EVENT_COUNT, next);
+        bytes += sizeof(uint32_t);
+    }
+    /* The emptied ring's numbers, in the same commit: events need no commit of their own */
+    if (ret == ESP_OK && s_snapshot.pending_count) {
+        reserved = next + STORAGE_PENDING_EVENTS;
+        ret = nvs_set_u32(s_nvs_handle, KEY_EVENT_RESERVED, reserved);
+        bytes += sizeof(uint32_t);
+    }
+    if (ret != ESP_OK || bytes == 0) {
+        return ret;
+    }
+    
+    ret = commit(bytes);
+    if (ret != ESP_OK) {
+        return ret; /* Still pending, for the next checkpoint */
+    }
+    s_snapshot.flash_next = next;
+    s_snapshot.pending_count = 0;
+    s_snapshot.reserved = reserved;
+    s_snapshot.state_dirty = 0;
+    s_snapshot.checkpoints++;
+    snapshot_seal();
+    METRIC_INC(checkpoints);
+    return ESP_OK;
+}
+
+/*
+ * Restarts leave flash current, in case the next image reads no snapshot (an
+ * OTA changing its layout). A watchdog reboot may come from a task stuck in
+ * here, so this does not wait: the RAM snapshot still holds whatever it skips.
+ */
+static void shutdown_checkpoint(void)
+{
+    if (xSemaphoreTake(s_snapshot_mutex, 0) == pdTRUE) {
+        checkpoint_locked();
+        xSemaphoreGive(s_snapshot_mutex);
+    }
+}
+
+/* Faults are committed at once; these can wait for a checkpoint */
+static bool routine_event(event_type_t type)
+{
+    return type == EVENT_TYPE_DOOR_OPEN || type == EVENT_TYPE_DOOR_CLOSED || type == EVENT_TYPE_RULE;
+}
+#endif
+
 esp_err_t storage_init(void)
 {
     if (s_initialized) {
@@ -45,11 +291,92 @@ esp_err_t storage_init(void)
         return ret;
     }
     
+#if CONFIG_GARAGE_STATE_SNAPSHOT
+    s_snapshot_mutex = STATIC_MUTEX_CREATE(s_snapshot_mutex);
+    if (!s_snapshot_mutex) {
+        nvs_close(s_nvs_handle);
+        return ESP_ERR_NO_MEM;
+    }
+    esp_reset_reason_t reason = esp_reset_reason();
+    s_restored = warm_reset(reason) && snapshot_intact();
+    if (s_restored) {
+        s_snapshot.warm_boots++;
+        snapshot_seal();
+        ESP_LOGI(TAG, "Warm boot (reset reason %d): door state %" PRIu32 " and %" PRIu32 " pending events from RAM",
+                 reason, s_snapshot.door_state, s_snapshot.pending_count);
+    } else {
+        if (warm_reset(reason)) {
+            ESP_LOGW(TAG, "RAM snapshot failed its check, loading from flash");
+        }
+        snapshot_load_flash();
+    }
+    esp_register_shutdown_handler(shutdown_checkpoint);
+    mem_budget_register_static(TAG, sizeof(s_snapshot) + STATIC_MUTEX_BYTES);
+#endif
+    
     s_initialized = true;
     ESP_LOGI(TAG, "Initialized");
     return ESP_OK;
 }
 
+esp_err_t storage_deinit(void)
+{
+    if (!s_initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    
+#if CONFIG_GARAGE_STATE_SNAPSHOT
+    esp_unregister_shutdown_handler(shutdown_checkpoint);
+    vSemaphoreDelete(s_snapshot_mutex);
+    s_snapshot_mutex = NULL;
+#endif
+    nvs_close(s_nvs_handle);
+    s_initialized = false;
+    return ESP_OK;
+}
+
+esp_err_t storage_checkpoint(void)
+{
+    if (!s_initialized) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+#if CONFIG_GARAGE_STATE_SNAPSHOT
+    LOCK_TAKE(s_snapshot_mutex);
+    esp_err_t ret = checkpoint_locked();
+    LOCK_GIVE(s_snapshot_mutex);
+    return ret;
+#else
+    return ESP_OK; /* Every write was committed */
+#endif
+}
+
+esp_err_t storage_get_snapshot_info(storage_snapshot_info_t *info)
+{
+    if (!s_initialized || !info) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+#if CONFIG_GARAGE_STATE_SNAPSHOT
+    LOCK_TAKE(s_snapshot_mutex);
+    info->restored = s_restored;
+    info->state_dirty = s_snapshot.state_dirty;
+    info->warm_boots = s_snapshot.warm_boots;
+    info->pending_events = s_snapshot.pending_count;
+    info->deferred_writes = s_snapshot.deferred_writes;
+    info->checkpoints = s_snapshot.checkpoints;
+    uint32_t count = s_snapshot.transition_count;
+    info->transition_count = count < STORAGE_TRANSITIONS ? count : STORAGE_TRANSITIONS;
+    for (size_t i = 0; i < info->transition_count; i++) {
+        info->transitions[i] = s_snapshot.transitions[(count - info->transition_count + i) % STORAGE_TRANSITIONS];
+    }
+    LOCK_GIVE(s_snapshot_mutex);
+    return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
 esp_err_t storage_save_gpio_config(const storage_gpio_config_t *config)
 {
     if (!s_initialized || !config) {
@@ -65,7 +392,7 @@ esp_err_t storage_save_gpio_config(const storage_gpio_config_t *config)
     ret = nvs_set_u32(s_nvs_handle, KEY_RELAY_PIN, config->relay_pin);
     if (ret != ESP_OK) return ret;
     
-    ret = nvs_commit(s_nvs_handle);
+    ret = commit(3 * sizeof(uint32_t));
     ESP_LOGI(TAG, "Saved GPIO config");
     return ret;
 }
@@ -110,7 +437,7 @@ esp_err_t storage_save_relay_config(const storage_relay_config_t *config)
     ret = nvs_set_u32(s_nvs_handle, KEY_MIN_INTERVAL, config->min_interval_ms);
     if (ret != ESP_OK) return ret;
     
-    ret = nvs_commit(s_nvs_handle);
+    ret = commit(3 * sizeof(uint32_t));
     ESP_LOGI(TAG, "Saved relay config");
     return ret;
 }
@@ -146,12 +473,33 @@ esp_err_t storage_save_door_state(uint32_t state)
         return ESP_ERR_INVALID_ARG;
     }
     
+#if CONFIG_GARAGE_STATE_SNAPSHOT
+    LOCK_TAKE(s_snapshot_mutex);
+    bool changed = state != s_snapshot.door_state;
+    if (changed) {
+        storage_transition_t *t = &s_snapshot.transitions[s_snapshot.transition_count % STORAGE_TRANSITIONS];
+        t->state = state;
+        t->boot = s_snapshot.warm_boots;
+        t->timestamp = (uint32_t)(esp_timer_get_time() / 1000);
+        s_snapshot.transition_count++;
+        s_snapshot.door_state = state;
+        s_snapshot.state_dirty = 1;
+        s_snapshot.deferred_writes++;
+        snapshot_seal();
+    }
+    LOCK_GIVE(s_snapshot_mutex);
+    if (changed) {
+        METRIC_INC(deferred_writes);
+    }
+    return ESP_OK;
+#else
     esp_err_t ret = nvs_set_u32(s_nvs_handle, KEY_DOOR_STATE, state);
     if (ret != ESP_OK) return ret;
     
-    ret = nvs_commit(s_nvs_handle);
+    ret = commit(sizeof(uint32_t));
     ESP_LOGI(TAG, "Saved door state: %" PRIu32, state);
     return ret;
+#endif
 }
 
 esp_err_t storage_load_door_state(uint32_t *state)
@@ -160,27 +508,97 @@ esp_err_t storage_load_door_state(uint32_t *state)
         return ESP_ERR_INVALID_ARG;
     }
     
+#if CONFIG_GARAGE_STATE_SNAPSHOT
+    LOCK_TAKE(s_snapshot_mutex);
+    *state = s_snapshot.door_state;
+    LOCK_GIVE(s_snapshot_mutex);
+    return ESP_OK;
+#else
     esp_err_t ret = nvs_get_u32(s_nvs_handle, KEY_DOOR_STATE, state);
     if (ret == ESP_ERR_NVS_NOT_FOUND) {
-        *state = DOOR_STATE_UNKNOWN;
+        *state = STORAGE_DOOR_STATE_NONE;
         return ESP_OK;
     }
     
     ESP_LOGI(TAG, "Loaded door state: %" PRIu32, *state);
     return ret;
+#endif
 }
 
-esp_err_t storage_log_event(event_type_t type, int32_t value)
+esp_err_t storage_save_motion_start(uint32_t release_ms)
 {
     if (!s_initialized) {
         return ESP_ERR_INVALID_ARG;
     }
     
-    uint32_t count = 0;
-    nvs_get_u32(s_nvs_handle, KEY_EVENT_COUNT, &count);
+    esp_err_t ret = nvs_set_u32(s_nvs_handle, KEY_MOTION_START, release_ms);
+    if (ret != ESP_OK) return ret;
     
-    char key[32];
-    snprintf(key, sizeof(key), "evt_%" PRIu32, count);
+    return commit(sizeof(uint32_t));
+}
+
+esp_err_t storage_load_motion_start(uint32_t *release_ms)
+{
+    if (!s_initialized || !release_ms) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    esp_err_t ret = nvs_get_u32(s_nvs_handle, KEY_MOTION_START, release_ms);
+    if (ret == ESP_ERR_NVS_NOT_FOUND) {
+        *release_ms = 0;
+        return ESP_OK;
+    }
+    return ret;
+}
+
+esp_err_t storage_save_rules(const uint8_t *blob, size_t len)
+{
+    if (!s_initialized || (!blob && len)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    esp_err_t ret = len ? nvs_set_blob(s_nvs_handle, KEY_RULES, blob, len) : nvs_erase_key(s_nvs_handle, KEY_RULES);
+    if (ret == ESP_ERR_NVS_NOT_FOUND) {
+        ret = ESP_OK; /* Nothing stored to erase */
+    }
+    if (ret != ESP_OK) return ret;
+    
+    ret = commit(len);
+    ESP_LOGI(TAG, "Saved %u bytes of rules", (unsigned)len);
+    return ret;
+}
+
+esp_err_t storage_load_rules(uint8_t *blob, size_t *len)
+{
+    if (!s_initialized || !blob || !len) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    esp_err_t ret = nvs_get_blob(s_nvs_handle, KEY_RULES, blob, len);
+    if (ret == ESP_ERR_NVS_NOT_FOUND) {
+        *len = 0;
+        return ESP_OK;
+    }
+    return ret;
+}
+
+static esp_err_t log_next_seq(uint32_t *next)
+{
+#if CONFIG_GARAGE_STATE_SNAPSHOT
+    LOCK_TAKE(s_snapshot_mutex);
+    *next = s_snapshot.flash_next + s_snapshot.pending_count;
+    LOCK_GIVE(s_snapshot_mutex);
+    return ESP_OK;
+#else
+    return flash_next_seq(next);
+#endif
+}
+
+esp_err_t storage_log_event(event_type_t type, int32_t value)
+{
+    if (!s_initialized) {
+        return ESP_ERR_INVALID_ARG;
+    }
     
     event_log_t log = {
         .type = type,
@@ -188,41 +606,119 @@ esp_err_t storage_log_event(event_type_t type, int32_t value)
         .value = value
     };
     
-    esp_err_t ret = nvs_set_blob(s_nvs_handle, key, &log, sizeof(event_log_t));
+#if CONFIG_GARAGE_STATE_SNAPSHOT
+    esp_err_t ret = ESP_OK;
+    bool deferred = false;
+    LOCK_TAKE(s_snapshot_mutex);
+    if (s_snapshot.pending_count == STORAGE_PENDING_EVENTS) {
+        ret = checkpoint_locked();
+    }
+    uint32_t seq = s_snapshot.flash_next + s_snapshot.pending_count;
+    if (ret == ESP_OK && seq >= s_snapshot.reserved) {
+        ret = reserve_locked(seq);
+    }
+    if (ret == ESP_OK) {
+        s_snapshot.pending[s_snapshot.pending_count++] = log;
+        deferred = routine_event(type);
+        s_snapshot.deferred_writes += deferred;
+        snapshot_seal();
+        if (!deferred) {
+            ret = checkpoint_locked();
+        }
+    }
+    LOCK_GIVE(s_snapshot_mutex);
+    if (deferred) {
+        METRIC_INC(deferred_writes);
+    }
+#else
+    uint32_t seq = 0;
+    log_next_seq(&seq);
+    
+    esp_err_t ret = write_slot(seq, &log);
     if (ret != ESP_OK) return ret;
     
-    count = (count + 1) % MAX_EVENT_LOGS;
-    ret = nvs_set_u32(s_nvs_handle, KEY_EVENT_COUNT, count);
+    ret = nvs_set_u32(s_nvs_handle, KEY_EVENT_COUNT, seq + 1);
     if (ret != ESP_OK) return ret;
     
-    ret = nvs_commit(s_nvs_handle);
+    ret = commit(sizeof(event_log_t) + sizeof(uint32_t));
+#endif
+    if (ret == ESP_OK) {
+        METRIC_INC(events_logged);
+    }
     return ret;
 }
 
-esp_err_t storage_get_logs(event_log_t *logs, size_t max_count, size_t *actual_count)
+esp_err_t storage_log_range(uint32_t *oldest, uint32_t *next)
 {
-    if (!s_initialized || !logs || !actual_count) {
+    if (!s_initialized || !oldest || !next) {
         return ESP_ERR_INVALID_ARG;
     }
     
-    uint32_t count = 0;
-    esp_err_t ret = nvs_get_u32(s_nvs_handle, KEY_EVENT_COUNT, &count);
-    if (ret == ESP_ERR_NVS_NOT_FOUND) {
-        *actual_count = 0;
-        return ESP_OK;
+    esp_err_t ret = log_next_seq(next);
+    if (ret != ESP_OK) return ret;
+    *oldest = *next > MAX_EVENT_LOGS ? *next - MAX_EVENT_LOGS : 0;
+    return ESP_OK;
+}
+
+static esp_err_t read_slot(uint32_t seq, event_log_t *log)
+{
+#if CONFIG_GARAGE_STATE_SNAPSHOT
+    esp_err_t ret = ESP_ERR_NVS_NOT_FOUND;
+    LOCK_TAKE(s_snapshot_mutex);
+    bool pending = seq >= s_snapshot.flash_next;
+    if (pending && seq - s_snapshot.flash_next < s_snapshot.pending_count) {
+        *log = s_snapshot.pending[seq - s_snapshot.flash_next];
+        ret = ESP_OK;
     }
+    LOCK_GIVE(s_snapshot_mutex);
+    if (pending) {
+        return ret;
+    }
+#endif
+    char key[32];
+    snprintf(key, sizeof(key), "evt_%" PRIu32, seq % MAX_EVENT_LOGS);
+    size_t size = sizeof(event_log_t);
+    return nvs_get_blob(s_nvs_handle, key, log, &size);
+}
+
+esp_err_t storage_visit_logs(uint32_t *cursor, storage_log_visitor_t visit, void *ctx)
+{
+    if (!cursor || !visit) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    uint32_t oldest = 0;
+    uint32_t next = 0;
+    esp_err_t ret = storage_log_range(&oldest, &next);
     if (ret != ESP_OK) return ret;
     
-    size_t to_read = count > max_count ? max_count : count;
+    if (*cursor < oldest) {
+        *cursor = oldest;
+    }
+    while (*cursor < next) {
+        event_log_t log;
+        uint32_t seq = (*cursor)++;
+        if (read_slot(seq, &log) == ESP_OK && !visit(seq, &log, ctx)) {
+            break;
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t storage_read_logs(size_t first, event_log_t *logs, size_t max_count, size_t *actual_count)
+{
+    if (!s_initialized || !logs || !actual_count) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    uint32_t oldest = 0;
+    uint32_t next = 0;
     *actual_count = 0;
+    esp_err_t ret = storage_log_range(&oldest, &next);
+    if (ret != ESP_OK) return ret;
     
-    for (size_t i = 0; i < to_read; i++) {
-        char key[32];
-        snprintf(key, sizeof(key), "evt_%" PRIu32, i);
-        
-        size_t size = sizeof(event_log_t);
-        ret = nvs_get_blob(s_nvs_handle, key, &logs[*actual_count], &size);
-        if (ret == ESP_OK) {
+    for (uint32_t seq = oldest + first; seq < next && *actual_count < max_count; seq++) {
+        if (read_slot(seq, &logs[*actual_count]) == ESP_OK) {
             (*actual_count)++;
         }
     }
@@ -230,6 +726,43 @@ esp_err_t storage_get_logs(event_log_t *logs, size_t max_count, size_t *actual_c
     return ESP_OK;
 }
 
+esp_err_t storage_get_logs(event_log_t *logs, size_t max_count, size_t *actual_count)
+{
+    return storage_read_logs(0, logs, max_count, actual_count);
+}
+
+typedef struct {
+    storage_export_record_t *records;
+    size_t max_count;
+    size_t count;
+} export_ctx_t;
+
+static bool export_visit(uint32_t seq, const event_log_t *log, void *ctx)
+{
+    export_ctx_t *out = ctx;
+    out->records[out->count++] = (storage_export_record_t){.seq = seq, .log = *log};
+    return out->count < out->max_count;
+}
+
+esp_err_t storage_export_logs(uint32_t *cursor, uint8_t *buf, size_t len, size_t *out_len, void *ctx)
+{
+    export_ctx_t out = {
+        .records = (storage_export_record_t *)buf,
+        .max_count = len / sizeof(storage_export_record_t),
+        .count = 0,
+    };
+    *out_len = 0;
+    if (out.max_count == 0) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    esp_err_t ret = storage_visit_logs(cursor, export_visit, &out);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    *out_len = out.count * sizeof(storage_export_record_t);
+    return ESP_OK;
+}
+
 esp_err_t storage_factory_reset(void)
 {
     if (!s_initialized) {
@@ -249,6 +782,11 @@ esp_err_t storage_factory_reset(void)
     }
     
     ret = nvs_open(STORAGE_NAMESPACE, NVS_READWRITE, &s_nvs_handle);
+#if CONFIG_GARAGE_STATE_SNAPSHOT
+    LOCK_TAKE(s_snapshot_mutex);
+    snapshot_load_flash();
+    LOCK_GIVE(s_snapshot_mutex);
+#endif
     
     ESP_LOGW(TAG, "Factory reset completed");
     return ret;
@@ -7,6 +7,9 @@
 
 #define STORAGE_NAMESPACE "garage_door"
 
+/* Value reported when no door state was ever saved; equals DOOR_STATE_UNKNOWN */
+#define STORAGE_DOOR_STATE_NONE 5
+
 typedef struct {
     uint32_t reed_closed_pin;
     uint32_t reed_open_pin;
@@ -25,7 +28,10 @@ typedef enum {
     EVENT_TYPE_TIMEOUT = 2,
     EVENT_TYPE_OBSTRUCTION = 3,
     EVENT_TYPE_COMMISSION = 4,
-    EVENT_TYPE_ERROR = 5
+    EVENT_TYPE_ERROR = 5,
+    EVENT_TYPE_RULE = 6, /* value: rule index << 8 | action */
+    EVENT_TYPE_LIVENESS = 7, /* value: liveness entry << 8 | action */
+    EVENT_TYPE_NO_ACTUATION = 8 /* value: door state; the door never left its end stop */
 } event_type_t;
 
 typedef struct {
@@ -34,13 +40,85 @@ typedef struct {
     int32_t value;
 } event_log_t;
 
+/*
+ * With CONFIG_GARAGE_STATE_SNAPSHOT the door state and routine events (door
+ * opened or closed, rule actions) are written to a CRC-checked snapshot in
+ * no-init RAM rather than committed to NVS one by one. storage_checkpoint()
+ * commits them together. Reads, the event sequence numbers included, see the
+ * snapshot, so callers cannot tell the difference. A warm boot (software
+ * reset, panic, watchdog) with an intact snapshot restores from it without
+ * reading flash; after a power-on, a brownout or a failed check the door
+ * state and the journal come from NVS as of the last checkpoint. Fault
+ * events are committed at once, after any pending ones. Sequence numbers
+ * are reserved in NVS a pending ring ahead, so numbers lost with RAM are
+ * skipped, never reused.
+ */
+#define STORAGE_PENDING_EVENTS 8
+#define STORAGE_TRANSITIONS    8
+
+typedef struct {
+    uint32_t state;
+    uint32_t boot;         /* Warm boots before it; 0 is the cold boot */
+    uint32_t timestamp;    /* ms since that boot */
+} storage_transition_t;
+
+typedef struct {
+    bool restored;             /* This boot started from the snapshot */
+    bool state_dirty;          /* Door state not yet in NVS */
+    uint32_t warm_boots;       /* Restored from the snapshot since the last cold boot */
+    uint32_t pending_events;   /* Journal entries not yet in NVS */
+    uint32_t deferred_writes;  /* Commits saved since the last cold boot */
+    uint32_t checkpoints;
+    size_t transition_count;
+    storage_transition_t transitions[STORAGE_TRANSITIONS]; /* Oldest first */
+} storage_snapshot_info_t;
+
 esp_err_t storage_init(void);
+/* Closes NVS; the snapshot stays in RAM, as across a reset */
+esp_err_t storage_deinit(void);
+/* Commits the snapshot's door state and pending events; ESP_OK when there is nothing to write */
+esp_err_t storage_checkpoint(void);
+/* ESP_ERR_NOT_SUPPORTED without CONFIG_GARAGE_STATE_SNAPSHOT */
+esp_err_t storage_get_snapshot_info(storage_snapshot_info_t *info);
 esp_err_t storage_save_gpio_config(const storage_gpio_config_t *config);
 esp_err_t storage_load_gpio_config(storage_gpio_config_t *config);
 esp_err_t storage_save_relay_config(const storage_relay_config_t *config);
 esp_err_t storage_load_relay_config(storage_relay_config_t *config);
 esp_err_t storage_save_door_state(uint32_t state);
 esp_err_t storage_load_door_state(uint32_t *state);
+/* Learned pulse-to-release latency of the door; 0 when none stored */
+esp_err_t storage_save_motion_start(uint32_t release_ms);
+esp_err_t storage_load_motion_start(uint32_t *release_ms);
+/* Automation rule bytecode; *len is the buffer size in, the blob size out (0 when none stored) */
+esp_err_t storage_save_rules(const uint8_t *blob, size_t len);
+esp_err_t storage_load_rules(uint8_t *blob, size_t *len);
 esp_err_t storage_log_event(event_type_t type, int32_t value);
+/*
+ * Events carry sequence numbers that count up across reboots; the retained
+ * ones are [*oldest, *next).
+ */
+esp_err_t storage_log_range(uint32_t *oldest, uint32_t *next);
+/* Returns false to stop the walk */
+typedef bool (*storage_log_visitor_t)(uint32_t seq, const event_log_t *log, void *ctx);
+/*
+ * Visits the retained events from sequence number *cursor on, oldest first,
+ * reading one at a time, and leaves *cursor past the last one visited
+ */
+esp_err_t storage_visit_logs(uint32_t *cursor, storage_log_visitor_t visit, void *ctx);
+/* Oldest first */
 esp_err_t storage_get_logs(event_log_t *logs, size_t max_count, size_t *actual_count);
+/* Oldest first, skipping the 'first' oldest retained events; *actual_count is 0 past the end */
+esp_err_t storage_read_logs(size_t first, event_log_t *logs, size_t max_count, size_t *actual_count);
+/* An exported event: numbers missing between records were lost or overwritten */
+typedef struct {
+    uint32_t seq;
+    event_log_t log;
+} storage_export_record_t;
+/*
+ * Event log source for diag_export_register_source(): reads
+ * storage_export_record_t records straight into the frame buffer. *cursor is
+ * the next sequence number, so events dropped off the ring while the export
+ * runs are skipped rather than shifting the rest.
+ */
+esp_err_t storage_export_logs(uint32_t *cursor, uint8_t *buf, size_t len, size_t *out_len, void *ctx);
 esp_err_t storage_factory_reset(void);
\ No newline at end of file
@@ -0,0 +1,89 @@
+#include "boot_profile.h"
+#include <stdio.h>
+#include <stdbool.h>
+#include "esp_console.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#define TAG "boot"
+
+/* Microseconds since esp_timer start; 0 = phase not reached */
+static int64_t s_phase_us[BOOT_PHASE_COUNT];
+
+void boot_profile_mark(boot_phase_t phase)
+{
+    if (phase >= BOOT_PHASE_COUNT || s_phase_us[phase] != 0) {
+        return;
+    }
+    s_phase_us[phase] = esp_timer_get_time();
+}
+
+int64_t boot_profile_get_us(boot_phase_t phase)
+{
+    if (phase >= BOOT_PHASE_COUNT) {
+        return 0;
+    }
+    return s_phase_us[phase];
+}
+
+const char *boot_profile_phase_name(boot_phase_t phase)
+{
+    switch (phase) {
+        case BOOT_PHASE_APP_START: return "app_start";
+        case BOOT_PHASE_STORAGE_READY: return "storage";
+        case BOOT_PHASE_GPIO_CONFIG_LOADED: return "gpio_config";
+        case BOOT_PHASE_REED_READY: return "reed";
+        case BOOT_PHASE_STATE_VALID: return "state_valid";
+        case BOOT_PHASE_RELAY_READY: return "relay";
+        case BOOT_PHASE_INIT_COMPLETE: return "init_complete";
+        case BOOT_PHASE_MATTER_READY: return "matter";
+        default: return "invalid";
+    }
+}
+
+/* Phases reached in time order, so each step is measured from the one before it; pending ones last */
+void boot_profile_log(void)
+{
+    bool logged[BOOT_PHASE_COUNT] = {false};
+    int64_t prev = 0;
+    for (;;) {
+        int next = -1;
+        for (int i = 0; i < BOOT_PHASE_COUNT; i++) {
+            if (!logged[i] && s_phase_us[i] != 0 && (next < 0 || s_phase_us[i] < s_phase_us[next])) {
+                next = i;
+            }
+        }
+        if (next < 0) {
+            break;
+        }
+        logged[next] = true;
+        int64_t t = s_phase_us[next];
+        ESP_LOGI(TAG, "%-14s %8lld us (+%lld us)", boot_profile_phase_name((boot_phase_t)next), (long long)t,
+                 (long long)(t - prev));
+        prev = t;
+    }
+    for (int i = 0; i < BOOT_PHASE_COUNT; i++) {
+        if (!logged[i]) {
+            ESP_LOGI(TAG, "%-14s   pending", boot_profile_phase_name((boot_phase_t)i));
+        }
+    }
+}
+
+static int boot_cmd(int argc, char **argv)
+{
+    for (int i = 0; i < BOOT_PHASE_COUNT; i++) {
+        printf("%s %lld\n", boot_profile_phase_name((boot_phase_t)i), (long long)s_phase_us[i]);
+    }
+    return 0;
+}
+
+esp_err_t boot_profile_register_console_command(void)
+{
+    const esp_console_cmd_t cmd = {
+        .command = "boot",
+        .help = "Print boot phase timestamps (us since esp_timer start, 0 = not reached)",
+        .hint = NULL,
+        .func = &boot_cmd,
+    };
+    return esp_console_cmd_register(&cmd);
+}
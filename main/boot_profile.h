@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+/*
+ * Boot phases in the order app_main() reaches them; MATTER_READY comes
+ * before INIT_COMPLETE when Matter starts inline (static allocation)
+ */
+typedef enum {
+    BOOT_PHASE_APP_START = 0,
+    BOOT_PHASE_STORAGE_READY,
+    BOOT_PHASE_GPIO_CONFIG_LOADED,
+    BOOT_PHASE_REED_READY,
+    BOOT_PHASE_STATE_VALID,
+    BOOT_PHASE_RELAY_READY,
+    BOOT_PHASE_INIT_COMPLETE,
+    BOOT_PHASE_MATTER_READY,
+    BOOT_PHASE_COUNT
+} boot_phase_t;
+
+void boot_profile_mark(boot_phase_t phase);
+int64_t boot_profile_get_us(boot_phase_t phase);
+const char *boot_profile_phase_name(boot_phase_t phase);
+void boot_profile_log(void);
+esp_err_t boot_profile_register_console_command(void);
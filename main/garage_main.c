@@ -1,4 +1,5 @@
 #include <stdio.h>
+#include <time.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "esp_log.h"
@@ -6,8 +7,28 @@
 #include "storage_manager.h"
 #include "reed_switch.h"
 #include "relay_control.h"
+#include "ultrasonic.h"
+#include "tilt_sensor.h"
+#include "sensor_scheduler.h"
+#include "rule_engine.h"
+#include "delta_ota.h"
+#include "power_manager.h"
 #include "garage_door_control.h"
 #include "matter_device.h"
+#include "matter_events.h"
+#include "boot_profile.h"
+#include "metrics.h"
+#include "tlog.h"
+#include "mem_budget.h"
+#include "trace.h"
+#include "liveness.h"
+#include "lock_profile.h"
+#include "hot_path.h"
+#include "span.h"
+#include "diag_export.h"
+#include "task_profile.h"
+#include "esp_console.h"
+#include "esp_timer.h"
 
 #define TAG "app_main"
 
@@ -15,21 +36,293 @@
 #define DEFAULT_REED_OPEN_PIN GPIO_NUM_3
 #define DEFAULT_RELAY_PIN GPIO_NUM_4
 
+#if CONFIG_GARAGE_ULTRASONIC_ENABLE
+static ultrasonic_activity_t activity_for_state(door_state_t state)
+{
+    switch (state) {
+        case DOOR_STATE_OPENING:
+        case DOOR_STATE_CLOSING:
+            return ULTRASONIC_ACTIVITY_MOVING;
+        case DOOR_STATE_CLOSED:
+            return ULTRASONIC_ACTIVITY_CLOSED;
+        default:
+            return ULTRASONIC_ACTIVITY_OPEN;
+    }
+}
+
+static void vehicle_callback(bool present, uint16_t distance_mm)
+{
+    ESP_LOGI(TAG, "Vehicle %s (%u mm)", present ? "present" : "absent", distance_mm);
+    rule_engine_set_input(RULE_INPUT_VEHICLE, present ? 1 : 0);
+}
+
+static void ultrasonic_start(void)
+{
+    const ultrasonic_config_t config = {
+        .trig_pin = CONFIG_GARAGE_ULTRASONIC_TRIG_GPIO,
+        .echo_pin = CONFIG_GARAGE_ULTRASONIC_ECHO_GPIO,
+        .present_below_mm = CONFIG_GARAGE_ULTRASONIC_PRESENT_BELOW_MM,
+    };
+    esp_err_t ret = ultrasonic_init(&config);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Vehicle sensor unavailable: %s", esp_err_to_name(ret));
+        return;
+    }
+    ultrasonic_register_callback(vehicle_callback);
+    ultrasonic_set_activity(activity_for_state(garage_door_get_state()));
+}
+#endif
+
+#if CONFIG_GARAGE_TILT_ENABLE
+static bool door_moving(door_state_t state)
+{
+    return state == DOOR_STATE_OPENING || state == DOOR_STATE_CLOSING;
+}
+
+static void tilt_callback(uint8_t percent)
+{
+    matter_device_update_door_state(percent, door_moving(garage_door_get_state()));
+}
+
+static void tilt_start(void)
+{
+    const tilt_sensor_config_t config = {
+        .sda_pin = CONFIG_GARAGE_TILT_SDA_GPIO,
+        .scl_pin = CONFIG_GARAGE_TILT_SCL_GPIO,
+        .int_pin = CONFIG_GARAGE_TILT_INT_GPIO,
+    };
+    esp_err_t ret = tilt_sensor_init(&config);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Position sensor unavailable: %s", esp_err_to_name(ret));
+        return;
+    }
+    tilt_sensor_register_callback(tilt_callback);
+    tilt_sensor_set_moving(door_moving(garage_door_get_state()));
+}
+#endif
+
 static void door_state_callback(door_state_t state)
 {
     ESP_LOGI(TAG, "Door state: %s", garage_door_state_to_string(state));
+#if CONFIG_GARAGE_ULTRASONIC_ENABLE
+    ultrasonic_set_activity(activity_for_state(state));
+#endif
+#if CONFIG_GARAGE_TILT_ENABLE
+    tilt_sensor_set_moving(door_moving(state));
+#endif
+    rule_engine_set_input(RULE_INPUT_DOOR, state);
+#if CONFIG_GARAGE_POWER_SAVE
+    power_manager_on_door_state(state);
+#endif
+}
+
+/*
+ * Runs on the liveness monitor when a watched task or timer stops checking in.
+ * Stop first, log second: the flash commit may wait on whatever is stuck. A
+ * reboot is not logged for the same reason; the monitor reboots on return.
+ */
+static void liveness_escalation(liveness_id_t id, const char *name, liveness_action_t action)
+{
+    if (action == LIVENESS_ACTION_SAFE_STOP) {
+        garage_door_stop();
+    }
+    if (action != LIVENESS_ACTION_REBOOT) {
+        storage_log_event(EVENT_TYPE_LIVENESS, (int32_t)((id << 8) | action));
+    }
+}
+
+/* Called from the esp_timer task, outside the door callback that triggered the rule */
+static void rule_action(rule_action_t action, uint8_t arg, const char *rule_name)
+{
+    esp_err_t ret = ESP_OK;
+    switch (action) {
+        case RULE_ACTION_CLOSE:
+            ret = garage_door_close();
+            break;
+        case RULE_ACTION_OPEN:
+            ret = garage_door_open();
+            break;
+        case RULE_ACTION_ALERT:
+            ESP_LOGW(TAG, "Rule %s: alert %u", rule_name, arg);
+            break;
+        default:
+            break;
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Rule %s: action failed: %s", rule_name, esp_err_to_name(ret));
+    }
+}
+
+/* Feeds the hour of day to the rules once the clock has been set (SNTP via Matter) */
+static esp_timer_handle_t s_hour_timer = NULL;
+
+static void hour_callback(void *arg)
+{
+    time_t now = time(NULL);
+    struct tm local;
+    localtime_r(&now, &local);
+    if (local.tm_year + 1900 < 2024) {
+        esp_timer_start_once(s_hour_timer, 60ULL * 1000000);
+        return;
+    }
+    rule_engine_set_input(RULE_INPUT_HOUR, (int16_t)local.tm_hour);
+    uint32_t to_next_hour_s = 3600 - (local.tm_min * 60 + local.tm_sec);
+    esp_timer_start_once(s_hour_timer, (uint64_t)to_next_hour_s * 1000000);
+}
+
+static void rules_start(void)
+{
+    esp_err_t ret = rule_engine_init(rule_action);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Automation rules unavailable: %s", esp_err_to_name(ret));
+        return;
+    }
+    ret = rule_engine_load_stored();
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Stored rules not loaded: %s", esp_err_to_name(ret));
+    }
+    rule_engine_set_input(RULE_INPUT_DOOR, garage_door_get_state());
+
+    const esp_timer_create_args_t timer_args = {
+        .callback = hour_callback,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "rule_hour"
+    };
+    if (esp_timer_create(&timer_args, &s_hour_timer) == ESP_OK) {
+        hour_callback(NULL);
+    }
+}
+
+#if CONFIG_GARAGE_STATE_SNAPSHOT
+/* Bounds what a power loss takes from the RAM snapshot; a checkpoint with nothing changed writes nothing */
+static esp_timer_handle_t s_checkpoint_timer = NULL;
+
+static void checkpoint_callback(void *arg)
+{
+    esp_err_t ret = storage_checkpoint();
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Checkpoint failed: %s", esp_err_to_name(ret));
+    }
+}
+
+static void checkpoint_start(void)
+{
+    const esp_timer_create_args_t timer_args = {
+        .callback = checkpoint_callback,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "checkpoint"
+    };
+    if (esp_timer_create(&timer_args, &s_checkpoint_timer) != ESP_OK ||
+        esp_timer_start_periodic(s_checkpoint_timer, CONFIG_GARAGE_STATE_CHECKPOINT_MIN * 60ULL * 1000000) != ESP_OK) {
+        ESP_LOGW(TAG, "Periodic checkpoint not started");
+    }
+}
+#endif
+
+static void console_start(void)
+{
+    esp_console_repl_t *repl = NULL;
+    esp_console_repl_config_t repl_config = ESP_CONSOLE_REPL_CONFIG_DEFAULT();
+    repl_config.prompt = "garage>";
+    /* 'rules load' takes a whole rule blob as hex */
+    repl_config.max_cmdline_length = 2 * RULE_BLOB_MAX + 64;
+    esp_console_dev_uart_config_t uart_config = ESP_CONSOLE_DEV_UART_CONFIG_DEFAULT();
+    
+    esp_err_t ret = esp_console_new_repl_uart(&uart_config, &repl_config, &repl);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create console: %s", esp_err_to_name(ret));
+        return;
+    }
+    
+    metrics_register_console_command();
+    boot_profile_register_console_command();
+    mem_budget_register_console_command();
+    trace_register_console_command();
+    sensor_scheduler_register_console_command();
+    liveness_register_console_command();
+    lock_profile_register_console_command();
+    hot_path_register_console_command();
+    span_register_console_command();
+    task_profile_register_console_command();
+    diag_export_register_source("events", DIAG_STREAM_EVENTS, storage_export_logs, NULL);
+    diag_export_register_console_command();
+    rule_engine_register_console_command();
+    delta_ota_register_console_command();
+    power_manager_register_console_command();
+    
+    ret = esp_console_start_repl(repl);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start console: %s", esp_err_to_name(ret));
+        return;
+    }
+    
+    /* Line editing allocates per command; that is not a runtime leak */
+    TaskHandle_t repl_task = xTaskGetHandle("console_repl");
+    if (repl_task) {
+        mem_budget_exempt_task(repl_task);
+    }
 }
 
+static void matter_start(void)
+{
+    esp_err_t ret = matter_device_init();
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to initialize Matter: %s", esp_err_to_name(ret));
+    }
+    boot_profile_mark(BOOT_PHASE_MATTER_READY);
+    boot_profile_log();
+}
+
+#if !CONFIG_GARAGE_STATIC_ALLOCATION
+static TaskHandle_t s_app_main_task = NULL;
+
+/* Matter brings up the radio stack; keep it off the path to a valid door state */
+static void matter_init_task(void *pvParameters)
+{
+    matter_start();
+    /* app_main seals the heap budget once these allocations are done */
+    xTaskNotifyGive(s_app_main_task);
+    vTaskDelete(NULL);
+}
+#endif
+
 void app_main(void)
 {
+    boot_profile_mark(BOOT_PHASE_APP_START);
     ESP_LOGI(TAG, "Smart Garage Door Controller Starting");
     
+    if (tlog_start() != ESP_OK) {
+        ESP_LOGW(TAG, "Deferred log drain not started");
+    }
+    
     esp_err_t ret = storage_init();
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to initialize storage: %s", esp_err_to_name(ret));
         return;
     }
+    boot_profile_mark(BOOT_PHASE_STORAGE_READY);
+#if CONFIG_GARAGE_STATE_SNAPSHOT
+    checkpoint_start();
+#endif
     
+    /* Before anything logs an event, so Matter tells this boot's events from earlier ones */
+    matter_events_init();
+    
+    /* Before the components that register with it */
+    ret = liveness_init(liveness_escalation);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Liveness monitor not started: %s", esp_err_to_name(ret));
+    }
+    
+    /* Critical path: reed pins -> reed driver -> reconciled door state */
+#if CONFIG_GARAGE_FIXED_CONFIG
+    const storage_gpio_config_t gpio_config = {
+        .reed_closed_pin = CONFIG_GARAGE_REED_CLOSED_GPIO,
+        .reed_open_pin = CONFIG_GARAGE_REED_OPEN_GPIO,
+        .relay_pin = CONFIG_GARAGE_RELAY_GPIO
+    };
+#else
+    bool save_gpio_defaults = false;
     storage_gpio_config_t gpio_config;
     ret = storage_load_gpio_config(&gpio_config);
     if (ret != ESP_OK || gpio_config.relay_pin == 0) {
@@ -37,11 +330,10 @@ void app_main(void)
         gpio_config.reed_closed_pin = DEFAULT_REED_CLOSED_PIN;
         gpio_config.reed_open_pin = DEFAULT_REED_OPEN_PIN;
         gpio_config.relay_pin = DEFAULT_RELAY_PIN;
-        storage_save_gpio_config(&gpio_config);
+        save_gpio_defaults = true;
     }
-    
-    ESP_LOGI(TAG, "GPIO config: reed_closed=%" PRIu32 ", reed_open=%" PRIu32 ", relay=%" PRIu32,
-             gpio_config.reed_closed_pin, gpio_config.reed_open_pin, gpio_config.relay_pin);
+#endif
+    boot_profile_mark(BOOT_PHASE_GPIO_CONFIG_LOADED);
     
     reed_switch_config_t reed_config = {
         .reed_closed_pin = gpio_config.reed_closed_pin,
@@ -54,16 +346,35 @@ void app_main(void)
         ESP_LOGE(TAG, "Failed to initialize reed switches: %s", esp_err_to_name(ret));
         return;
     }
+    boot_profile_mark(BOOT_PHASE_REED_READY);
+    
+    /* Samples the door safety check and the optional sensors; needed before the door */
+    ret = sensor_scheduler_init();
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start sensor scheduler: %s", esp_err_to_name(ret));
+        return;
+    }
+    
+    ret = garage_door_init();
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to initialize garage door: %s", esp_err_to_name(ret));
+        return;
+    }
+    boot_profile_mark(BOOT_PHASE_STATE_VALID);
     
+    /* Non-critical: relay (only needed for the first command) and config write-back */
+#if !CONFIG_GARAGE_FIXED_CONFIG
     storage_relay_config_t relay_config;
+    bool save_relay_defaults = false;
     ret = storage_load_relay_config(&relay_config);
     if (ret != ESP_OK || relay_config.pulse_duration_ms == 0) {
         ESP_LOGW(TAG, "Using default relay configuration");
         relay_config.pulse_duration_ms = 500;
         relay_config.max_pulse_duration_ms = 600;
         relay_config.min_interval_ms = 1000;
-        storage_save_relay_config(&relay_config);
+        save_relay_defaults = true;
     }
+#endif
     
     ret = relay_init(gpio_config.relay_pin);
     if (ret != ESP_OK) {
@@ -71,28 +382,92 @@ void app_main(void)
         return;
     }
     
+#if !CONFIG_GARAGE_FIXED_CONFIG
     ret = relay_set_config(&relay_config);
     if (ret != ESP_OK) {
         ESP_LOGW(TAG, "Failed to set relay config: %s", esp_err_to_name(ret));
     }
-    
-    ret = garage_door_init();
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to initialize garage door: %s", esp_err_to_name(ret));
-        return;
-    }
+#endif
+    boot_profile_mark(BOOT_PHASE_RELAY_READY);
     
     ret = garage_door_register_state_callback(door_state_callback);
     if (ret != ESP_OK) {
         ESP_LOGW(TAG, "Failed to register state callback: %s", esp_err_to_name(ret));
     }
+
+    /* Optional: rules act on the door, so they start after it is fully up */
+    rules_start();
+
+#if CONFIG_GARAGE_ULTRASONIC_ENABLE
+    /* Optional: presence only feeds the rules, the door works without it */
+    ultrasonic_start();
+#endif
+
+#if CONFIG_GARAGE_TILT_ENABLE
+    /* Optional: positions between the end stops, the reeds still drive the door */
+    tilt_start();
+#endif
+
+#if CONFIG_GARAGE_POWER_SAVE
+    /* Optional: without it the chip stays awake, the door works the same */
+    ret = power_manager_init();
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Power management unavailable: %s", esp_err_to_name(ret));
+    }
+#endif
+
+#if CONFIG_GARAGE_TASK_PROFILE
+    /* Optional: once every task is up, so the first sample sees them all */
+    ret = task_profile_init(CONFIG_GARAGE_TASK_PROFILE_PERIOD_MS);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Task profiling unavailable: %s", esp_err_to_name(ret));
+    }
+#endif
     
-    ESP_LOGI(TAG, "Initialization complete. Door state: %s", garage_door_state_to_string(garage_door_get_state()));
+#if !CONFIG_GARAGE_FIXED_CONFIG
+    if (save_gpio_defaults) {
+        storage_save_gpio_config(&gpio_config);
+    }
+    if (save_relay_defaults) {
+        storage_save_relay_config(&relay_config);
+    }
+#endif
     
-    while (true) {
-        vTaskDelay(pdMS_TO_TICKS(10000));
-        ESP_LOGI(TAG, "Door state: %s, Position: %d", 
-                 garage_door_state_to_string(garage_door_get_state()),
-                 reed_switch_get_position());
+    ESP_LOGI(TAG, "GPIO config: reed_closed=%" PRIu32 ", reed_open=%" PRIu32 ", relay=%" PRIu32,
+             gpio_config.reed_closed_pin, gpio_config.reed_open_pin, gpio_config.relay_pin);
+    
+#if CONFIG_GARAGE_STATIC_ALLOCATION
+    /* A dedicated init task would pin 4 KB of static stack for one use; the
+     * door state is already valid, so run it inline */
+    matter_start();
+#else
+    s_app_main_task = xTaskGetCurrentTaskHandle();
+    bool matter_pending = xTaskCreate(matter_init_task, "matter_init", 4096, NULL, 3, NULL) == pdPASS;
+    if (!matter_pending) {
+        ESP_LOGE(TAG, "Failed to start Matter initialization");
+    }
+#endif
+    
+    /* The door came up: an image fresh from a delta update is good, cancel its rollback */
+    if (delta_ota_init() == ESP_OK) {
+        delta_ota_confirm_running();
+    }
+    
+    boot_profile_mark(BOOT_PHASE_INIT_COMPLETE);
+    ESP_LOGI(TAG, "Initialization complete. Door state: %s (valid after %lld us)",
+             garage_door_state_to_string(garage_door_get_state()),
+             (long long)boot_profile_get_us(BOOT_PHASE_STATE_VALID));
+    
+    /* Runtime state is available on demand via the 'metrics' console command */
+    console_start();
+    
+#if !CONFIG_GARAGE_STATIC_ALLOCATION
+    /* Matter's init allocations are not runtime ones; seal once they are done */
+    if (matter_pending) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
     }
+#endif
+    
+    /* From here on the heap must stay flat; see the 'mem' console command */
+    mem_budget_seal();
 }
\ No newline at end of file
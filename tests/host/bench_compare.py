@@ -0,0 +1,47 @@
+#!/usr/bin/env python3
+"""Compare two bench_components JSON files and fail on regressions.
+
+    bench_compare.py baseline.json current.json [--threshold 20]
+
+A benchmark regresses when its ns_per_op grew by more than the threshold
+percentage. Benchmarks present in only one file are listed but not judged.
+"""
+import argparse
+import json
+import sys
+
+
+def load(path):
+    with open(path) as f:
+        doc = json.load(f)
+    return doc.get("commit", "?"), {r["name"]: r for r in doc["results"]}
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("baseline")
+    parser.add_argument("current")
+    parser.add_argument("--threshold", type=float, default=20.0, help="allowed slowdown in percent")
+    args = parser.parse_args()
+
+    base_commit, base = load(args.baseline)
+    cur_commit, cur = load(args.current)
+    print(f"{'benchmark':<28} {base_commit:>12} {cur_commit:>12}  change")
+    regressions = 0
+    for name in sorted(set(base) | set(cur)):
+        if name not in base or name not in cur:
+            print(f"{name:<28} {'only in ' + ('current' if name in cur else 'baseline'):>26}")
+            continue
+        before = base[name]["ns_per_op"]
+        after = cur[name]["ns_per_op"]
+        change = (after - before) / before * 100.0 if before else 0.0
+        flag = ""
+        if change > args.threshold:
+            flag = "  REGRESSION"
+            regressions += 1
+        print(f"{name:<28} {before:>10.1f}ns {after:>10.1f}ns  {change:+6.1f}%{flag}")
+    return 1 if regressions else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,398 @@
+/*
+ * Host microbenchmarks for the component hot paths, run on the simulator.
+ *
+ * Results are written as one JSON document (stdout, or the file named by the
+ * first argument) so a CI job can store them per commit and compare with
+ * bench_compare.py. Absolute host numbers say little about the ESP32-H2;
+ * the trend between commits is what matters. --quick runs a few iterations
+ * only, as a smoke test.
+ */
+#define _POSIX_C_SOURCE 199309L
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "sim.h"
+#include "garage_door_control.h"
+#include "reed_switch.h"
+#include "relay_control.h"
+#include "sensor_scheduler.h"
+#include "storage_manager.h"
+#include "range_filter.h"
+#include "ultrasonic.h"
+#include "tilt_angle.h"
+#include "tilt_sensor.h"
+#include "liveness.h"
+#include "lock_profile.h"
+#include "matter_events.h"
+
+#ifndef BENCH_COMMIT
+#define BENCH_COMMIT "unknown"
+#endif
+
+#define CLOSED_PIN  GPIO_NUM_2
+#define OPEN_PIN    GPIO_NUM_3
+#define RELAY_PIN   GPIO_NUM_4
+#define DEBOUNCE_MS 50
+#define TRIG_PIN    GPIO_NUM_10
+#define ECHO_PIN    GPIO_NUM_11
+#define TILT_SDA    GPIO_NUM_6
+#define TILT_SCL    GPIO_NUM_7
+#define TILT_INT    GPIO_NUM_12
+#define MAX_RESULTS 24
+
+typedef struct {
+    const char *name;
+    const char *unit;
+    uint64_t iterations;
+    double ns_per_op;
+} bench_result_t;
+
+static bench_result_t s_results[MAX_RESULTS];
+static size_t s_result_count;
+static volatile uint32_t s_sink;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void record(const char *name, const char *unit, uint64_t iterations, uint64_t elapsed_ns)
+{
+    if (s_result_count < MAX_RESULTS) {
+        s_results[s_result_count++] = (bench_result_t){name, unit, iterations, (double)elapsed_ns / iterations};
+    }
+}
+
+static void on_state(door_state_t state)
+{
+    s_sink += state;
+}
+
+static void bring_up(void)
+{
+    sim_reset();
+    sim_nvs_erase_all();
+    sim_gpio_set_input(CLOSED_PIN, 0);
+    sim_gpio_set_input(OPEN_PIN, 1);
+    storage_init();
+    const reed_switch_config_t reed = {.reed_closed_pin = CLOSED_PIN, .reed_open_pin = OPEN_PIN};
+    reed_switch_init(&reed);
+    sensor_scheduler_init();
+    garage_door_init();
+    relay_init(RELAY_PIN);
+    /* Same fan-out as the firmware: app_main and the Matter bridge */
+    garage_door_register_state_callback(on_state);
+    garage_door_register_state_callback(on_state);
+    sim_run_for(2000);
+}
+
+static void tear_down(void)
+{
+    garage_door_deinit();
+    relay_deinit();
+    reed_switch_deinit();
+    sensor_scheduler_deinit();
+    sim_reset();
+}
+
+/* Command to state change: validation, relay, persistence, callbacks; two transitions per iteration */
+static void bench_state_dispatch(uint64_t iterations)
+{
+    bring_up();
+    const relay_config_t fast = {.pulse_duration_ms = 1, .max_pulse_duration_ms = 600, .min_interval_ms = 0};
+    relay_set_config(&fast);
+
+    uint64_t start = now_ns();
+    for (uint64_t i = 0; i < iterations; i++) {
+        garage_door_open();
+        sim_run_for(1);
+        garage_door_stop();
+    }
+    record("state_transition_dispatch", "transition", iterations * 2, now_ns() - start);
+    tear_down();
+}
+
+static void bench_log_event(uint64_t iterations)
+{
+    bring_up();
+    uint64_t start = now_ns();
+    for (uint64_t i = 0; i < iterations; i++) {
+        storage_log_event(EVENT_TYPE_DOOR_OPEN, (int32_t)i);
+    }
+    record("storage_log_event", "event", iterations, now_ns() - start);
+    tear_down();
+}
+
+/* Full event log (100 retained of 150): a subscription primed from EventMin 0, then one new event */
+static void bench_matter_events(uint64_t iterations)
+{
+    bring_up();
+    for (int32_t i = 0; i < 150; i++) {
+        storage_log_event(i % 3 ? EVENT_TYPE_DOOR_OPEN : EVENT_TYPE_OBSTRUCTION, i);
+    }
+    matter_events_init();
+
+    matter_event_t events[8];
+    size_t count = 0;
+    uint64_t primed = 0;
+    uint64_t start = now_ns();
+    for (uint64_t i = 0; i < iterations / 100 + 1; i++) {
+        uint64_t event_min = 0;
+        do {
+            matter_events_read(&event_min, events, 8, &count);
+            primed += count;
+        } while (count > 0);
+    }
+    record("matter_event_prime_full_log", "event", primed, now_ns() - start);
+
+    uint64_t next = 0;
+    matter_events_next_number(&next);
+    start = now_ns();
+    for (uint64_t i = 0; i < iterations; i++) {
+        uint64_t event_min = next - 1;
+        matter_events_read(&event_min, events, 8, &count);
+        s_sink += (uint32_t)count;
+    }
+    record("matter_event_read_latest", "read", iterations, now_ns() - start);
+    tear_down();
+}
+
+/* Edge interrupt, debounce timer and the position decision; includes the simulator's scheduling */
+static void bench_debounce(uint64_t iterations)
+{
+    bring_up();
+    uint64_t start = now_ns();
+    for (uint64_t i = 0; i < iterations; i++) {
+        sim_gpio_set_input(CLOSED_PIN, (i & 1) ? 0 : 1);
+        sim_run_for(DEBOUNCE_MS);
+    }
+    record("reed_debounce_decision", "edge", iterations, now_ns() - start);
+
+    start = now_ns();
+    for (uint64_t i = 0; i < iterations * 100; i++) {
+        s_sink += reed_switch_get_position();
+    }
+    record("reed_position_decode", "call", iterations * 100, now_ns() - start);
+    tear_down();
+}
+
+static void bench_lock(uint64_t iterations)
+{
+    sim_reset();
+    SemaphoreHandle_t mutex = xSemaphoreCreateMutex();
+    uint64_t start = now_ns();
+    for (uint64_t i = 0; i < iterations * 100; i++) {
+        xSemaphoreTake(mutex, portMAX_DELAY);
+        s_sink++;
+        xSemaphoreGive(mutex);
+    }
+    record("mutex_take_give", "pair", iterations * 100, now_ns() - start);
+
+    /* The same pair through the CONFIG_GARAGE_LOCK_PROFILE wrapper */
+    static lock_profile_t profile;
+    lock_profile_attach(&profile, "bench/mutex", mutex);
+    start = now_ns();
+    for (uint64_t i = 0; i < iterations * 100; i++) {
+        lock_profile_take(&profile, mutex);
+        s_sink++;
+        lock_profile_give(&profile, mutex);
+    }
+    record("profiled_mutex_take_give", "pair", iterations * 100, now_ns() - start);
+    vSemaphoreDelete(mutex);
+    sim_reset();
+}
+
+/* Liveness check-in and a timed begin/end pair, next to the mutex pair they should stay well under */
+static void bench_liveness(uint64_t iterations)
+{
+    sim_reset();
+    liveness_init(NULL);
+    const liveness_desc_t desc = {.name = "bench", .period_ms = 1000, .budget_us = 1000};
+    liveness_id_t id;
+    liveness_register(&desc, &id);
+
+    uint64_t start = now_ns();
+    for (uint64_t i = 0; i < iterations * 100; i++) {
+        liveness_checkin(id);
+    }
+    record("liveness_checkin", "call", iterations * 100, now_ns() - start);
+
+    start = now_ns();
+    for (uint64_t i = 0; i < iterations * 100; i++) {
+        liveness_end(id, liveness_begin());
+    }
+    record("liveness_begin_end", "pair", iterations * 100, now_ns() - start);
+    liveness_deinit();
+    sim_reset();
+}
+
+/* Conversion, step gate, median and presence decision for one echo */
+static void bench_range_filter(uint64_t iterations)
+{
+    const presence_config_t config = {.present_below_mm = 1500, .hysteresis_mm = 200, .confirm_samples = 2};
+    presence_state_t presence = {0};
+    range_filter_t filter;
+    range_filter_reset(&filter);
+
+    uint64_t start = now_ns();
+    for (uint64_t i = 0; i < iterations * 100; i++) {
+        /* A car parks and leaves every 64 samples, with some jitter on top */
+        uint32_t echo_us = ((i >> 6) & 1 ? 7000 : 14500) + (uint32_t)(i * 37 % 60);
+        uint16_t median;
+        if (range_filter_add(&filter, range_echo_to_mm(echo_us), &median)) {
+            s_sink += presence_update(&presence, &config, median);
+        }
+    }
+    record("ultrasonic_filter_sample", "sample", iterations * 100, now_ns() - start);
+}
+
+static void bring_up_ultrasonic(void)
+{
+    sim_reset();
+    sim_echo_attach(TRIG_PIN);
+    sim_echo_set_distance(2500);
+    sensor_scheduler_init();
+    const ultrasonic_config_t config = {.trig_pin = TRIG_PIN, .echo_pin = ECHO_PIN};
+    ultrasonic_init(&config);
+    ultrasonic_set_activity(ULTRASONIC_ACTIVITY_MOVING);
+}
+
+static void tear_down_ultrasonic(void)
+{
+    ultrasonic_deinit();
+    sensor_scheduler_deinit();
+    sim_reset();
+}
+
+/*
+ * Whole sample tick on the simulator (timer, trigger, RMT completion, filter),
+ * then the arrival-to-callback latency in virtual time. The latter is set by
+ * the sampling period and filter depth, not the host, so it should not move
+ * between commits unless the filter changes.
+ */
+static void bench_ultrasonic(uint64_t iterations)
+{
+    bring_up_ultrasonic();
+    uint64_t start = now_ns();
+    for (uint64_t i = 0; i < iterations; i++) {
+        sim_run_for(ULTRASONIC_FAST_PERIOD_MS);
+    }
+    record("ultrasonic_sample_tick", "sample", iterations, now_ns() - start);
+    tear_down_ultrasonic();
+
+    uint64_t detections = iterations / 100 ? iterations / 100 : 1;
+    uint64_t latency_us = 0;
+    bring_up_ultrasonic();
+    for (uint64_t i = 0; i < detections; i++) {
+        bool arrive = !ultrasonic_vehicle_present();
+        sim_echo_set_distance(arrive ? 1200 : 2500);
+        int64_t changed_at = sim_now_us();
+        while (ultrasonic_vehicle_present() != arrive) {
+            sim_run_for(10);
+        }
+        latency_us += (uint64_t)(sim_now_us() - changed_at);
+    }
+    record("ultrasonic_detect_latency", "detection_virtual", detections, latency_us * 1000);
+    tear_down_ultrasonic();
+}
+
+/* Averaging and CORDIC for one idle burst, the per-wakeup CPU cost of the tilt sensor */
+static void bench_tilt_decode(uint64_t iterations)
+{
+    uint8_t fifo[TILT_SENSOR_WATERMARK_IDLE * TILT_SAMPLE_BYTES];
+    for (size_t i = 0; i < sizeof(fifo); i++) {
+        fifo[i] = (uint8_t)(i * 29 + 7);
+    }
+
+    uint64_t start = now_ns();
+    for (uint64_t i = 0; i < iterations; i++) {
+        fifo[0] = (uint8_t)i;
+        s_sink += (uint32_t)tilt_angle_from_fifo(fifo, TILT_SENSOR_WATERMARK_IDLE);
+    }
+    record("tilt_burst_decode", "burst", iterations, now_ns() - start);
+}
+
+/*
+ * Virtual I2C time per burst while the door moves: the register reads a
+ * burst costs on the wire at 400 kHz. Set by the burst layout, not the host.
+ */
+static void bench_tilt_bus(uint64_t iterations)
+{
+    sim_reset();
+    const sim_accel_config_t accel = {.address = 0x18, .int_pin = TILT_INT, .open_cdeg = 9000};
+    sim_accel_attach(&accel);
+    sensor_scheduler_init();
+    const tilt_sensor_config_t config = {.sda_pin = TILT_SDA, .scl_pin = TILT_SCL, .int_pin = TILT_INT};
+    tilt_sensor_init(&config);
+    tilt_sensor_set_moving(true);
+    sim_run_for(1000);
+
+    uint64_t bursts = iterations / 100 ? iterations / 100 : 1;
+    sim_i2c_reset_stats();
+    sim_run_for((uint32_t)(bursts * TILT_SENSOR_WATERMARK_MOVING * 1000 / TILT_SENSOR_ODR_HZ));
+    sim_i2c_stats_t stats;
+    sim_i2c_get_stats(&stats);
+    record("tilt_bus_busy_moving", "burst_virtual", bursts, stats.busy_us * 1000);
+
+    tilt_sensor_deinit();
+    sensor_scheduler_deinit();
+    sim_reset();
+}
+
+static void write_json(FILE *out)
+{
+    const char *commit = getenv("GIT_COMMIT");
+    fprintf(out, "{\n  \"suite\": \"components\",\n  \"commit\": \"%s\",\n  \"results\": [\n",
+            commit ? commit : BENCH_COMMIT);
+    for (size_t i = 0; i < s_result_count; i++) {
+        const bench_result_t *r = &s_results[i];
+        fprintf(out,
+                "    {\"name\": \"%s\", \"unit\": \"%s\", \"iterations\": %" PRIu64
+                ", \"ns_per_op\": %.1f, \"ops_per_sec\": %.0f}%s\n",
+                r->name, r->unit, r->iterations, r->ns_per_op, 1e9 / r->ns_per_op,
+                i + 1 < s_result_count ? "," : "");
+    }
+    fprintf(out, "  ]\n}\n");
+}
+
+int main(int argc, char **argv)
+{
+    uint64_t iterations = 20000;
+    const char *path = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--quick") == 0) {
+            iterations = 200;
+        } else {
+            path = argv[i];
+        }
+    }
+
+    bench_state_dispatch(iterations);
+    bench_log_event(iterations);
+    bench_matter_events(iterations);
+    bench_debounce(iterations);
+    bench_lock(iterations);
+    bench_liveness(iterations);
+    bench_range_filter(iterations);
+    bench_ultrasonic(iterations);
+    bench_tilt_decode(iterations);
+    bench_tilt_bus(iterations);
+
+    FILE *out = path ? fopen(path, "w") : stdout;
+    if (!out) {
+        perror(path);
+        return 1;
+    }
+    write_json(out);
+    if (path) {
+        fclose(out);
+        write_json(stdout);
+    }
+    return 0;
+}
@@ -0,0 +1,44 @@
+#!/usr/bin/env python3
+"""Diff two builds with tools/delta_diff.py and apply the patch with the firmware applier on file-backed slots."""
+import os
+import subprocess
+import sys
+
+TOOLS = os.path.join(os.path.dirname(__file__), '..', '..', 'tools')
+sys.path.insert(0, TOOLS)
+import delta_diff  # noqa: E402
+
+
+def main():
+    test_binary, old_path, new_path, work_dir = sys.argv[1:5]
+    with open(old_path, 'rb') as f:
+        old = f.read()
+    with open(new_path, 'rb') as f:
+        new = f.read()
+
+    # Same image: a handful of copies
+    same, _ = delta_diff.make_patch(old, old)
+    if len(same) > 200:
+        print(f'identical images need a {len(same)} byte patch')
+        return 1
+
+    # Reference applier rejects a patch for another base
+    patch, _ = delta_diff.make_patch(old, new)
+    try:
+        delta_diff.apply_patch(new, patch)
+        print('patch applied to the wrong base image')
+        return 1
+    except ValueError:
+        pass
+
+    patch_path = os.path.join(work_dir, 'delta_demo.patch')
+    subprocess.run([sys.executable, os.path.join(TOOLS, 'delta_diff.py'), old_path, new_path, '-o', patch_path],
+                   check=True)
+    if os.path.getsize(patch_path) > len(new) // 2:
+        print('patch is more than half the image')
+        return 1
+    return subprocess.run([test_binary, old_path, patch_path, new_path]).returncode
+
+
+if __name__ == '__main__':
+    sys.exit(main())
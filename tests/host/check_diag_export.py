@@ -0,0 +1,62 @@
+#!/usr/bin/env python3
+"""Run tools/diag_export.py against diag_export_demo behind a pty and compare with the demo's text output."""
+import os
+import re
+import subprocess
+import sys
+import tty
+
+TOOL = os.path.join(os.path.dirname(__file__), '..', '..', 'tools', 'diag_export.py')
+MIN_EFFICIENCY = 90.0  # percent of wire bytes that are payload
+
+
+def export(demo, sources):
+    master, slave = os.openpty()
+    # Raw before the demo writes anything, or the line discipline echoes its output back as input
+    tty.setraw(slave)
+    device = subprocess.Popen([demo, 'serve'], stdin=master, stdout=master)
+    try:
+        result = subprocess.run([sys.executable, TOOL, os.ttyname(slave), '--timeout', '20', '--sources', *sources],
+                                capture_output=True, text=True)
+        os.write(slave, b'quit\r\n')
+        device.wait(timeout=10)
+    finally:
+        if device.poll() is None:
+            device.kill()
+        os.close(master)
+        os.close(slave)
+    return result
+
+
+def main():
+    demo = sys.argv[1]
+    expected = subprocess.run([demo, 'text'], capture_output=True, text=True, check=True).stdout
+    failures = 0
+
+    result = export(demo, [])
+    print(result.stderr, end='')
+    if result.returncode != 0:
+        print(f'diag_export.py: exit {result.returncode}')
+        return 1
+    if result.stdout != expected:
+        got, want = result.stdout.splitlines(), expected.splitlines()
+        first = next((i for i, (g, w) in enumerate(zip(got, want)) if g != w), min(len(got), len(want)))
+        print(f'decoded output differs at line {first + 1}: {got[first:first + 1]} vs {want[first:first + 1]} '
+              f'({len(got)} vs {len(want)} lines)')
+        failures += 1
+    stats = re.search(r'\(([\d.]+)%\).* (\d+) damaged frames', result.stderr)
+    if not stats or float(stats.group(1)) < MIN_EFFICIENCY or int(stats.group(2)) != 0:
+        print(f'expected at least {MIN_EFFICIENCY}% payload and no damaged frames')
+        failures += 1
+
+    # One source on its own: the event log, wrapped, oldest first
+    result = export(demo, ['events'])
+    events = expected[expected.index('# events:'):]
+    if result.returncode != 0 or result.stdout != events:
+        print(f'events only: exit {result.returncode}, {len(result.stdout.splitlines())} lines: {result.stderr}')
+        failures += 1
+    return 1 if failures else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
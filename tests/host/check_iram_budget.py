@@ -0,0 +1,42 @@
+#!/usr/bin/env python3
+"""Run tools/iram_budget.py on the map of a host link with the hot paths in .iram1.hot sections."""
+import os
+import subprocess
+import sys
+
+TOOL = os.path.join(os.path.dirname(__file__), '..', '..', 'tools', 'iram_budget.py')
+HOT_FILES = ('reed_switch.c', 'relay_control.c', 'garage_door_control.c')
+
+
+def run(map_path, budget):
+    return subprocess.run([sys.executable, TOOL, map_path, '--budget', str(budget)], capture_output=True, text=True)
+
+
+def main():
+    map_path = sys.argv[1]
+    failures = 0
+
+    ok = run(map_path, 1 << 20)
+    print(ok.stdout, end='')
+    if ok.returncode != 0:
+        print(f'within budget: exit {ok.returncode}: {ok.stderr}')
+        failures += 1
+    for name in HOT_FILES:
+        if name not in ok.stdout:
+            print(f'{name}: no hot sections in the map')
+            failures += 1
+    total = int(ok.stdout.rsplit('hot paths in IRAM: ', 1)[-1].split()[0])
+
+    over = run(map_path, total - 1)
+    if over.returncode == 0 or 'exceeded by 1 bytes' not in over.stderr:
+        print(f'one byte over budget: exit {over.returncode}: {over.stderr}')
+        failures += 1
+    exact = run(map_path, total)
+    if exact.returncode != 0:
+        print(f'exactly at budget: exit {exact.returncode}: {exact.stderr}')
+        failures += 1
+    return 1 if failures else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
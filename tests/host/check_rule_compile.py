@@ -0,0 +1,43 @@
+#!/usr/bin/env python3
+"""Compile tools/garage.rules and run the rule engine tests against the blob, plus compiler error cases."""
+import os
+import subprocess
+import sys
+
+TOOLS = os.path.join(os.path.dirname(__file__), '..', '..', 'tools')
+sys.path.insert(0, TOOLS)
+import rule_compile  # noqa: E402
+
+BAD_RULES = [
+    ('rule r\ndo close\n', "needs 'when'"),
+    ('rule r\nwhen door == OPEN\ndo fly\n', "'do' takes"),
+    ('rule r\nwhen door == AJAR\ndo close\n', 'unknown name'),
+    ('rule r\non hour\nwhen door == OPEN\ndo close\n', 'does not read'),
+    ('rule r\nwhen (door == OPEN\ndo close\n', 'ends early'),
+    ('rule r\nwhen door == OPEN\nfor 19h\ndo close\n', 'at most 65535'),
+    ('rule this_name_is_too_long\nwhen door\ndo close\n', 'rule name'),
+    ('when door\n', 'before any rule'),
+]
+
+
+def main():
+    test_binary, blob_path = sys.argv[1], sys.argv[2]
+    failures = 0
+    for text, expected in BAD_RULES:
+        try:
+            rule_compile.compile_rules(text)
+            error = 'accepted'
+        except rule_compile.RuleError as e:
+            error = str(e)
+        if expected not in error:
+            print(f'{text!r}: expected {expected!r}, got {error!r}')
+            failures += 1
+
+    subprocess.run([sys.executable, os.path.join(TOOLS, 'rule_compile.py'), os.path.join(TOOLS, 'garage.rules'),
+                    '-o', blob_path], check=True)
+    result = subprocess.run([test_binary, blob_path])
+    return 1 if failures or result.returncode else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
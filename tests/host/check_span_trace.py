@@ -0,0 +1,64 @@
+#!/usr/bin/env python3
+"""Convert the spans of a simulated Matter open command with tools/span_trace.py and check the timeline."""
+import json
+import os
+import subprocess
+import sys
+
+TOOL = os.path.join(os.path.dirname(__file__), '..', '..', 'tools', 'span_trace.py')
+COMMAND_SPANS = ('MATTER_COMMAND', 'DOOR_COMMAND', 'RELAY_ACTIVATE', 'DOOR_LOCK', 'DOOR_STATE', 'NVS_COMMIT')
+COMMIT_LATENCY_US = 40000  # sim_nvs_set_commit_latency() in test_span.c
+
+
+def main():
+    dump = subprocess.run([sys.argv[1], '--dump'], capture_output=True, text=True)
+    if dump.returncode != 0:
+        print(dump.stdout)
+        return 1
+    result = subprocess.run([sys.executable, TOOL], input=dump.stdout, capture_output=True, text=True)
+    if result.returncode != 0:
+        print(f'span_trace.py: exit {result.returncode}: {result.stderr}')
+        return 1
+    events = json.loads(result.stdout)['traceEvents']
+    failures = 0
+
+    threads = {e['tid']: e['args']['name'] for e in events if e['ph'] == 'M' and e['name'] == 'thread_name'}
+    slices = [e for e in events if e['ph'] == 'X']
+    # Spans after the motion ended (correlation ID 0) belong to no command
+    corrs = {e['args']['corr'] for e in slices} - {0}
+    if len(corrs) != 1:
+        print(f'expected the spans of one command, got correlation IDs {sorted(corrs)}')
+        return 1
+
+    names = {e['name'] for e in slices}
+    for name in COMMAND_SPANS:
+        if name not in names:
+            print(f'{name}: no slice')
+            failures += 1
+    commits = [e['dur'] for e in slices if e['name'] == 'NVS_COMMIT']
+    if not commits or min(commits) < COMMIT_LATENCY_US:
+        print(f'NVS_COMMIT slices {commits}: expected at least {COMMIT_LATENCY_US} us each')
+        failures += 1
+    if not any(e['ph'] == 'i' and e['name'] == 'RELAY_RELEASE' for e in events):
+        print('RELAY_RELEASE: no instant')
+        failures += 1
+
+    # The command starts on the caller's track and the flow carries it to the task that saw the end stop
+    flow = sorted((e for e in events if e['ph'] in 'stf'), key=lambda e: e['ts'])
+    if [e['ph'] for e in flow][:1] != ['s'] or [e['ph'] for e in flow][-1:] != ['f']:
+        print(f'flow phases {[e["ph"] for e in flow]}')
+        failures += 1
+    elif threads.get(flow[0]['tid']) != 'main' or flow[0]['tid'] == flow[-1]['tid']:
+        print(f'flow from {threads.get(flow[0]["tid"])} to {threads.get(flow[-1]["tid"])}')
+        failures += 1
+
+    summary = subprocess.run([sys.executable, TOOL, '--summary'], input=dump.stdout, capture_output=True, text=True)
+    print(summary.stdout, end='')
+    if summary.returncode != 0 or 'NVS_COMMIT' not in summary.stdout:
+        print(f'summary: exit {summary.returncode}: {summary.stderr}')
+        failures += 1
+    return 1 if failures else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
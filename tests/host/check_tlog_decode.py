@@ -0,0 +1,28 @@
+#!/usr/bin/env python3
+"""Decode tlog_demo tokens with tools/tlog_decode.py and compare with its text output."""
+import os
+import subprocess
+import sys
+
+sys.path.insert(0, os.path.join(os.path.dirname(__file__), '..', '..', 'tools'))
+import tlog_decode  # noqa: E402
+
+
+def main():
+    demo = sys.argv[1]
+    tokens = subprocess.run([demo, 'binary'], check=True, capture_output=True, text=True).stdout.splitlines()
+    expected = subprocess.run([demo, 'text'], check=True, capture_output=True, text=True).stdout.splitlines()
+
+    elf = tlog_decode.Elf(demo)
+    decoded = [tlog_decode.decode_line(elf, line) for line in tokens]
+    if decoded != expected or not expected:
+        for got, want in zip(decoded, expected):
+            marker = '  ' if got == want else '!='
+            print(f'{marker} {got!r}\n   {want!r}')
+        return 1
+    print(f'{len(decoded)} records decoded')
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
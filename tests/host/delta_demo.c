@@ -0,0 +1,28 @@
+/*
+ * Two builds of one program stand in for consecutive firmware versions in the
+ * delta_diff test: version 2 adds a step to main(), which comes first in the
+ * link, so the whole component library behind it moves and every call into
+ * it changes, as in a real firmware rebuild.
+ */
+#include <stdio.h>
+#include "garage_fixture.h"
+#include "garage_door_control.h"
+
+#ifndef DELTA_DEMO_VERSION
+#define DELTA_DEMO_VERSION 1
+#endif
+
+int main(void)
+{
+    fixture_boot(0);
+    garage_door_open();
+    sim_run_for(FIXTURE_TRAVEL_MS + 3000);
+#if DELTA_DEMO_VERSION >= 2
+    printf("open: %s\n", garage_door_state_to_string(garage_door_get_state()));
+    garage_door_close();
+    sim_run_for(FIXTURE_TRAVEL_MS + 3000);
+#endif
+    printf("delta demo v%d: door %s\n", DELTA_DEMO_VERSION, garage_door_state_to_string(garage_door_get_state()));
+    fixture_shutdown();
+    return 0;
+}
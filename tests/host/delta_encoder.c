@@ -0,0 +1,104 @@
+#include "delta_encoder.h"
+#include <string.h>
+#include "delta_patch.h"
+
+static void put(delta_encoder_t *enc, const void *data, size_t len)
+{
+    if (enc->len + len <= enc->cap) {
+        memcpy(&enc->buf[enc->len], data, len);
+    }
+    enc->len += len;
+}
+
+static void put_byte(delta_encoder_t *enc, uint8_t byte)
+{
+    put(enc, &byte, 1);
+}
+
+static void put_varint(delta_encoder_t *enc, uint32_t value)
+{
+    do {
+        uint8_t byte = value & 0x7F;
+        value >>= 7;
+        put_byte(enc, byte | (value ? 0x80 : 0));
+    } while (value);
+}
+
+static void put_u32(delta_encoder_t *enc, uint32_t value)
+{
+    for (int i = 0; i < 4; i++) {
+        put_byte(enc, (uint8_t)(value >> (8 * i)));
+    }
+}
+
+static void produce(delta_encoder_t *enc, uint32_t len)
+{
+    mbedtls_sha256_update(&enc->hash, &enc->new_image[enc->produced], len);
+    enc->produced += len;
+}
+
+void delta_encoder_begin(delta_encoder_t *enc, uint8_t *buf, size_t cap, const uint8_t *old_image, size_t old_len,
+                         const uint8_t *new_image, size_t new_len)
+{
+    uint8_t digest[32];
+    memset(enc, 0, sizeof(*enc));
+    enc->buf = buf;
+    enc->cap = cap;
+    enc->new_image = new_image;
+
+    put(enc, "GDP", 3);
+    put_byte(enc, DELTA_PATCH_VERSION);
+    put_u32(enc, (uint32_t)old_len);
+    put_u32(enc, (uint32_t)new_len);
+    mbedtls_sha256_init(&enc->hash);
+    mbedtls_sha256_starts(&enc->hash, 0);
+    mbedtls_sha256_update(&enc->hash, old_image, old_len);
+    mbedtls_sha256_finish(&enc->hash, digest);
+    put(enc, digest, sizeof(digest));
+    mbedtls_sha256_starts(&enc->hash, 0);
+    mbedtls_sha256_update(&enc->hash, new_image, new_len);
+    mbedtls_sha256_finish(&enc->hash, digest);
+    put(enc, digest, sizeof(digest));
+    mbedtls_sha256_starts(&enc->hash, 0);
+}
+
+void delta_encoder_copy(delta_encoder_t *enc, uint32_t old_offset, uint32_t len, const uint32_t *edits,
+                        size_t edit_count)
+{
+    put_byte(enc, DELTA_OP_COPY);
+    put_varint(enc, old_offset);
+    put_varint(enc, len);
+    put_varint(enc, (uint32_t)edit_count);
+    uint32_t previous = 0;
+    for (size_t i = 0; i < edit_count; i++) {
+        put_varint(enc, edits[i] - previous);
+        put_byte(enc, enc->new_image[enc->produced + edits[i]]);
+        previous = edits[i] + 1;
+    }
+    produce(enc, len);
+}
+
+void delta_encoder_insert(delta_encoder_t *enc, uint32_t len)
+{
+    put_byte(enc, DELTA_OP_INSERT);
+    put_varint(enc, len);
+    put(enc, &enc->new_image[enc->produced], len);
+    produce(enc, len);
+}
+
+void delta_encoder_check(delta_encoder_t *enc)
+{
+    mbedtls_sha256_context snapshot;
+    uint8_t digest[32];
+    mbedtls_sha256_clone(&snapshot, &enc->hash);
+    mbedtls_sha256_finish(&snapshot, digest);
+    put_byte(enc, DELTA_OP_CHECK);
+    put(enc, digest, DELTA_PATCH_CHECK_SIZE);
+}
+
+size_t delta_encoder_end(delta_encoder_t *enc)
+{
+    put_byte(enc, DELTA_OP_END);
+    mbedtls_sha256_free(&enc->hash);
+    return enc->len;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+/*
+ * Builds delta patches for the host tests and benchmarks, record by record,
+ * without tools/delta_diff.py. Data for inserts and edits is taken from the
+ * new image at the current output position.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include "mbedtls/sha256.h"
+
+typedef struct {
+    uint8_t *buf;
+    size_t len;
+    size_t cap;
+    const uint8_t *new_image;
+    size_t produced;
+    mbedtls_sha256_context hash;
+} delta_encoder_t;
+
+void delta_encoder_begin(delta_encoder_t *enc, uint8_t *buf, size_t cap, const uint8_t *old_image, size_t old_len,
+                         const uint8_t *new_image, size_t new_len);
+/* Edits at the given positions (ascending, relative to the copy) take the new image's bytes */
+void delta_encoder_copy(delta_encoder_t *enc, uint32_t old_offset, uint32_t len, const uint32_t *edits,
+                        size_t edit_count);
+void delta_encoder_insert(delta_encoder_t *enc, uint32_t len);
+void delta_encoder_check(delta_encoder_t *enc);
+/* Appends END; returns the patch length */
+size_t delta_encoder_end(delta_encoder_t *enc);
@@ -0,0 +1,106 @@
+/*
+ * Device stand-in for the diag_export test. After a door cycle and enough
+ * events to wrap the event log, "text" prints what a receiver must decode
+ * from the export; "serve" acts as the console on stdin/stdout (a pty in
+ * check_diag_export.py): it echoes each command line with some log noise and
+ * runs "export ..." through diag_export().
+ */
+#include <stdio.h>
+#include <string.h>
+#include "garage_fixture.h"
+#include "garage_door_control.h"
+#include "storage_manager.h"
+#include "metrics.h"
+#include "trace.h"
+#include "diag_export.h"
+
+#define EXTRA_EVENTS 130 /* More than the event log keeps */
+#define MAX_ARGS 8
+
+static const char *const s_event_names[] = {
+    "DOOR_OPEN", "DOOR_CLOSED", "TIMEOUT", "OBSTRUCTION", "COMMISSION", "ERROR", "RULE", "LIVENESS", "NO_ACTUATION",
+};
+
+static void run_scenario(void)
+{
+    fixture_boot(0);
+    garage_door_open();
+    sim_run_for(FIXTURE_TRAVEL_MS + 3000);
+    garage_door_close();
+    sim_run_for(FIXTURE_TRAVEL_MS + 3000);
+    for (int i = 0; i < EXTRA_EVENTS; i++) {
+        storage_log_event(EVENT_TYPE_RULE, i);
+        sim_run_for(10);
+    }
+}
+
+/* Same order as the export: metrics, trace, events */
+static void print_text(void)
+{
+    static char metrics[4096];
+    metrics_snapshot_text(metrics, sizeof(metrics));
+    printf("# schema %08lx\n%s", (unsigned long)metrics_schema_hash(), metrics);
+
+    static trace_record_t trace[4096];
+    size_t count = trace_snapshot(trace, sizeof(trace) / sizeof(trace[0]));
+    char line[TRACE_LINE_MAX];
+    printf("# trace: %zu records\n", count);
+    for (size_t i = 0; i < count; i++) {
+        trace_format(&trace[i], line, sizeof(line));
+        printf("%s\n", line);
+    }
+
+    static uint8_t records[128 * sizeof(storage_export_record_t)];
+    uint32_t cursor = 0;
+    size_t len = 0;
+    storage_export_logs(&cursor, records, sizeof(records), &len, NULL);
+    count = len / sizeof(storage_export_record_t);
+    printf("# events: %zu\n", count);
+    for (size_t i = 0; i < count; i++) {
+        const storage_export_record_t *r = &((const storage_export_record_t *)records)[i];
+        printf("E %lu %lu %s %ld\n", (unsigned long)r->seq, (unsigned long)r->log.timestamp,
+               s_event_names[r->log.type], (long)r->log.value);
+    }
+}
+
+static void serve(void)
+{
+    char line[128];
+    printf("I (1234) garage: console ready\ngarage> ");
+    fflush(stdout);
+    while (fgets(line, sizeof(line), stdin)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        /* Echo and a log line racing the command, as on the real console */
+        printf("%s\nI (1240) relay: Pulse completed, relay deactivated\n", line);
+
+        char *argv[MAX_ARGS];
+        int argc = 0;
+        for (char *tok = strtok(line, " "); tok && argc < MAX_ARGS; tok = strtok(NULL, " ")) {
+            argv[argc++] = tok;
+        }
+        if (argc > 0 && strcmp(argv[0], "quit") == 0) {
+            break;
+        }
+        if (argc > 0 && strcmp(argv[0], "export") == 0) {
+            esp_err_t ret = diag_export((const char *const *)&argv[1], (size_t)(argc - 1));
+            if (ret != ESP_OK) {
+                printf("export: %s\n", esp_err_to_name(ret));
+            }
+        }
+        printf("garage> ");
+        fflush(stdout);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    run_scenario();
+    diag_export_register_source("events", DIAG_STREAM_EVENTS, storage_export_logs, NULL);
+    if (argc > 1 && strcmp(argv[1], "serve") == 0) {
+        serve();
+    } else {
+        print_text();
+    }
+    fixture_shutdown();
+    return 0;
+}
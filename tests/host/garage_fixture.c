@@ -0,0 +1,57 @@
+#include "garage_fixture.h"
+#include "garage_door_control.h"
+#include "reed_switch.h"
+#include "relay_control.h"
+#include "sensor_scheduler.h"
+#include "storage_manager.h"
+#include "liveness.h"
+
+/* As app_main's: a silent safety check stops the door */
+static void fixture_escalation(liveness_id_t id, const char *name, liveness_action_t action)
+{
+    if (action == LIVENESS_ACTION_SAFE_STOP) {
+        garage_door_stop();
+    }
+    if (action != LIVENESS_ACTION_REBOOT) {
+        storage_log_event(EVENT_TYPE_LIVENESS, (int32_t)((id << 8) | action));
+    }
+}
+
+void fixture_boot(uint32_t door_position_permille)
+{
+    sim_reset();
+    const sim_door_config_t door = {
+        .relay_pin = FIXTURE_RELAY_PIN,
+        .reed_closed_pin = FIXTURE_REED_CLOSED_PIN,
+        .reed_open_pin = FIXTURE_REED_OPEN_PIN,
+        .travel_ms = FIXTURE_TRAVEL_MS,
+        .reed_span_permille = FIXTURE_REED_SPAN,
+    };
+    sim_door_attach(&door, door_position_permille);
+
+    storage_init();
+    liveness_init(fixture_escalation);
+    const reed_switch_config_t reed = {
+        .reed_closed_pin = FIXTURE_REED_CLOSED_PIN,
+        .reed_open_pin = FIXTURE_REED_OPEN_PIN,
+        .relay_pin = FIXTURE_RELAY_PIN,
+    };
+    reed_switch_init(&reed);
+    sensor_scheduler_init();
+    garage_door_init();
+    relay_init(FIXTURE_RELAY_PIN);
+
+    /* Let the tasks start and the relay rate limit from any earlier test expire */
+    sim_run_for(FIXTURE_SETTLE_MS);
+}
+
+void fixture_shutdown(void)
+{
+    garage_door_deinit();
+    relay_deinit();
+    reed_switch_deinit();
+    sensor_scheduler_deinit();
+    liveness_deinit();
+    storage_deinit();
+    sim_reset();
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+/*
+ * Brings the hardware-facing components and the sensor scheduler up on the simulator the way
+ * app_main does, with the door model wired to the relay and reeds.
+ */
+
+#include <stdint.h>
+#include "sim.h"
+
+#define FIXTURE_REED_CLOSED_PIN GPIO_NUM_2
+#define FIXTURE_REED_OPEN_PIN   GPIO_NUM_3
+#define FIXTURE_RELAY_PIN       GPIO_NUM_4
+#define FIXTURE_TRAVEL_MS       12000
+#define FIXTURE_REED_SPAN       20 /* permille of travel each reed stays closed */
+#define FIXTURE_SETTLE_MS       1000
+
+/* Door position is in permille of travel: 0 closed, 1000 open */
+void fixture_boot(uint32_t door_position_permille);
+void fixture_shutdown(void);
@@ -0,0 +1,94 @@
+#include "sim.h"
+#include "sim_internal.h"
+#include "esp_system.h"
+
+#define MAX_SHUTDOWN_HANDLERS 4
+
+static uint32_t s_restarts;
+static esp_reset_reason_t s_reset_reason = ESP_RST_POWERON;
+static shutdown_handler_t s_shutdown_handlers[MAX_SHUTDOWN_HANDLERS];
+
+/* Bounds of the __NOINIT_ATTR section, from the linker; absent when nothing uses it */
+extern uint8_t __start_sim_noinit[] __attribute__((weak));
+extern uint8_t __stop_sim_noinit[] __attribute__((weak));
+
+void sim_reset(void)
+{
+    s_restarts = 0;
+    sim_door_detach();
+    sim_echo_detach();
+    sim_accel_detach();
+    sim_i2c_reset();
+    sim_rtos_reset();
+    sim_gpio_reset();
+    sim_pm_reset();
+}
+
+void esp_restart(void)
+{
+    for (int i = MAX_SHUTDOWN_HANDLERS - 1; i >= 0; i--) {
+        if (s_shutdown_handlers[i]) {
+            s_shutdown_handlers[i]();
+        }
+    }
+    s_restarts++;
+}
+
+esp_err_t esp_register_shutdown_handler(shutdown_handler_t handler)
+{
+    for (int i = 0; i < MAX_SHUTDOWN_HANDLERS; i++) {
+        if (s_shutdown_handlers[i] == handler) {
+            return ESP_ERR_INVALID_STATE;
+        }
+    }
+    for (int i = 0; i < MAX_SHUTDOWN_HANDLERS; i++) {
+        if (!s_shutdown_handlers[i]) {
+            s_shutdown_handlers[i] = handler;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NO_MEM;
+}
+
+esp_err_t esp_unregister_shutdown_handler(shutdown_handler_t handler)
+{
+    for (int i = 0; i < MAX_SHUTDOWN_HANDLERS; i++) {
+        if (s_shutdown_handlers[i] == handler) {
+            s_shutdown_handlers[i] = NULL;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_INVALID_STATE;
+}
+
+esp_reset_reason_t esp_reset_reason(void)
+{
+    return s_reset_reason;
+}
+
+void sim_set_reset_reason(esp_reset_reason_t reason)
+{
+    s_reset_reason = reason;
+}
+
+void sim_power_on(void)
+{
+    uint32_t lcg = 0x5eed;
+    for (uint8_t *p = __start_sim_noinit; p && p < __stop_sim_noinit; p++) {
+        lcg = lcg * 1103515245u + 12345u;
+        *p = (uint8_t)(lcg >> 16);
+    }
+    s_reset_reason = ESP_RST_POWERON;
+}
+
+void sim_noinit_flip_bit(size_t bit)
+{
+    if (__start_sim_noinit && __start_sim_noinit + bit / 8 < __stop_sim_noinit) {
+        __start_sim_noinit[bit / 8] ^= (uint8_t)(1u << (bit % 8));
+    }
+}
+
+uint32_t sim_restart_count(void)
+{
+    return s_restarts;
+}
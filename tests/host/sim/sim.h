@@ -0,0 +1,204 @@
+#pragma once
+
+/*
+ * Deterministic host simulator for the ESP-IDF services the components use.
+ *
+ * FreeRTOS tasks run as coroutines scheduled by priority on a virtual clock;
+ * esp_timer callbacks run from a simulated esp_timer task at its firmware
+ * priority. Nothing advances on its own: the test drives time with
+ * sim_run_for()/sim_run_until(), so a 30 s door timeout takes microseconds
+ * and every run produces the same interleaving. The clock is monotonic across
+ * sim_reset() so component state that remembers timestamps stays consistent.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_system.h"
+#include "driver/gpio.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+/* Scheduler and clock */
+void sim_reset(void);
+int64_t sim_now_us(void);
+void sim_run_until(int64_t time_us);
+void sim_run_for(uint32_t ms);
+uint32_t sim_task_count(void);
+/* Every esp_timer callback fires this much later than requested (interrupt latency, busy timer task) */
+void sim_timer_set_lateness(uint32_t lateness_us);
+/* esp_restart() calls since the last sim_reset(); the program keeps running */
+uint32_t sim_restart_count(void);
+/*
+ * The reset the next boot reports through esp_reset_reason(). No-init RAM
+ * (__NOINIT_ATTR) keeps its contents across sim_reset() like across a warm
+ * reset; sim_power_on() fills it with garbage and reports ESP_RST_POWERON.
+ */
+void sim_set_reset_reason(esp_reset_reason_t reason);
+void sim_power_on(void);
+/* Flips one bit of no-init RAM, e.g. a stray write before a reset */
+void sim_noinit_flip_bit(size_t bit);
+/*
+ * esp_cpu_get_cycle_count() runs at CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ on the
+ * virtual clock, so code takes no cycles unless it blocks; this stands in for
+ * the cycles of work the host does not model. Never goes back across sim_reset().
+ */
+void sim_cpu_spend(uint32_t cycles);
+/*
+ * The running task keeps the CPU for 'us' of virtual time: the clock moves on
+ * and nothing else runs meanwhile, so timers due in between fire late. This is
+ * the run time uxTaskGetSystemState() reports per task (otherwise zero); in an
+ * esp_timer callback it counts for the esp_timer task.
+ */
+void sim_task_busy_us(uint32_t us);
+/* Free stack the task's high-water mark reports; by default its whole stack is free */
+void sim_task_set_stack_free(TaskHandle_t task, uint32_t free_bytes);
+
+/*
+ * Power management: after esp_pm_configure() with light_sleep_enable the chip
+ * light sleeps whenever no task is ready and no ESP_PM_NO_LIGHT_SLEEP lock is
+ * held (see sim_pm.c). Timers, and interrupts on pins armed with
+ * gpio_wakeup_enable(), wake it after the wake latency; other interrupts wait
+ * for the next wake.
+ */
+typedef struct {
+    int64_t slept_us;
+    uint32_t sleeps;
+    uint32_t gpio_wakeups;
+    uint32_t held_interrupts; /* Raised while asleep on a pin that is not a wake source */
+} sim_pm_stats_t;
+
+void sim_pm_set_wake_latency(uint32_t latency_us);
+bool sim_pm_light_sleep_allowed(void);
+bool sim_pm_asleep(void);
+void sim_pm_get_stats(sim_pm_stats_t *stats);
+void sim_pm_reset_stats(void);
+
+/* GPIO: inputs are driven by the test, outputs observed through a hook */
+typedef void (*sim_gpio_output_hook_t)(gpio_num_t pin, uint32_t level, void *ctx);
+
+void sim_gpio_reset(void);
+void sim_gpio_set_input(gpio_num_t pin, uint32_t level);
+uint32_t sim_gpio_get_output(gpio_num_t pin);
+void sim_gpio_set_output_hook(gpio_num_t pin, sim_gpio_output_hook_t hook, void *ctx);
+/* A stuck input holds 'level' and ignores sim_gpio_set_input() until released */
+void sim_gpio_stick(gpio_num_t pin, uint32_t level);
+void sim_gpio_release(gpio_num_t pin);
+
+/* NVS: contents survive sim_reset() like flash survives a reboot */
+typedef enum {
+    SIM_NVS_OP_SET = 1 << 0,
+    SIM_NVS_OP_GET = 1 << 1,
+    SIM_NVS_OP_COMMIT = 1 << 2,
+} sim_nvs_op_t;
+
+void sim_nvs_erase_all(void);
+/* The next 'count' operations matching 'ops' fail with 'err' */
+void sim_nvs_inject_failure(uint32_t ops, esp_err_t err, uint32_t count);
+uint32_t sim_nvs_commit_count(void);
+/* Lookups by key (nvs_get_*), found or not */
+uint32_t sim_nvs_read_count(void);
+uint32_t sim_nvs_entry_count(void);
+/* Each commit blocks the calling task this long, like a flash page erase */
+void sim_nvs_set_commit_latency(uint32_t latency_ms);
+/* Called after every successful set (key, data) and commit (key NULL) */
+typedef void (*sim_nvs_hook_t)(const char *key, const void *data, size_t length, void *ctx);
+void sim_nvs_set_hook(sim_nvs_hook_t hook, void *ctx);
+
+/*
+ * Single-button (toggle) opener and door. A relay pulse starts the door away
+ * from the end stop it rests at, stops it while moving, and reverses it after
+ * a stop. Reeds are active low and closed within reed_span_permille of their
+ * end stop.
+ */
+typedef struct {
+    gpio_num_t relay_pin;
+    gpio_num_t reed_closed_pin;
+    gpio_num_t reed_open_pin;
+    uint32_t travel_ms;
+    uint32_t reed_span_permille;
+} sim_door_config_t;
+
+typedef enum {
+    SIM_DOOR_IDLE,
+    SIM_DOOR_UP,
+    SIM_DOOR_DOWN,
+} sim_door_motion_t;
+
+void sim_door_attach(const sim_door_config_t *config, uint32_t position_permille);
+void sim_door_detach(void);
+uint32_t sim_door_position(void);
+sim_door_motion_t sim_door_motion(void);
+/* A jammed door ignores motion; a dead opener ignores relay pulses */
+void sim_door_set_jammed(bool jammed);
+void sim_door_set_opener_dead(bool dead);
+/* The opener misses the next 'count' relay pulses, e.g. a bad push-button contact */
+void sim_door_miss_pulses(uint32_t count);
+
+/*
+ * HC-SR04 behind the simulated RMT receive channel: a falling edge on the
+ * trigger pin starts a ranging whose echo width is delivered to the RMT
+ * receive-done callback (in ISR context) once the line has been idle for the
+ * receive's signal_range_max_ns.
+ */
+void sim_echo_attach(gpio_num_t trig_pin);
+void sim_echo_detach(void);
+/* 0: nothing in range, the sensor answers with its 38 ms timeout pulse */
+void sim_echo_set_distance(uint32_t distance_mm);
+/* Uniform +/-jitter, and per-mille of rangings that are lost or a spurious near reflection */
+void sim_echo_set_noise(uint32_t jitter_mm, uint32_t outlier_permille);
+/* A disconnected echo line: no pulse at all, the receive never completes */
+void sim_echo_set_silent(bool silent);
+uint32_t sim_echo_trigger_count(void);
+
+/*
+ * LIS3DH-style accelerometer on the door panel, the one device on the
+ * simulated I2C master bus. Once CTRL_REG1 sets an output data rate it
+ * samples into a 32-level FIFO (stream or FIFO mode per FIFO_CTRL_REG) and
+ * drives int_pin high while the FIFO holds the watermark or more. Burst
+ * reads with the auto-increment bit wrap over the output registers, popping
+ * a sample per X/Y/Z triple. The panel tilts linearly with door position from
+ * closed_cdeg to open_cdeg (centidegrees from vertical): X reads gravity
+ * along the panel, Z normal to it, high resolution +/-2 g. Every transfer
+ * blocks the calling task for its time on the wire at the device's SCL
+ * speed; a transfer to any other address is not acknowledged.
+ */
+typedef struct {
+    uint16_t address;
+    gpio_num_t int_pin;
+    int32_t closed_cdeg;
+    int32_t open_cdeg;
+} sim_accel_config_t;
+
+typedef struct {
+    uint32_t transactions;
+    uint32_t bytes;    /* Address and data bytes on the wire */
+    uint64_t busy_us;
+    uint32_t samples;  /* Taken by the sensor, FIFO or not */
+    uint32_t overruns; /* Samples that found the FIFO full */
+} sim_i2c_stats_t;
+
+void sim_accel_attach(const sim_accel_config_t *config);
+void sim_accel_detach(void);
+/* Uniform +/-jitter on every axis */
+void sim_accel_set_noise(uint32_t jitter_mg);
+/* Holds the panel at 'cdeg' whatever the door does (a sagging or loose mount); false follows the door again */
+void sim_accel_pin_tilt(bool pinned, int32_t cdeg);
+uint32_t sim_accel_fifo_level(void);
+void sim_i2c_get_stats(sim_i2c_stats_t *stats);
+void sim_i2c_reset_stats(void);
+
+/*
+ * Two OTA app slots, ota_0 and ota_1, backed by temporary files. Like flash
+ * they survive sim_reset(); the running slot starts as ota_0 holding 'image'
+ * and the rest of both slots erased (0xFF).
+ */
+void sim_ota_attach(const uint8_t *image, size_t len, size_t slot_size);
+void sim_ota_detach(void);
+/* Boots the slot esp_ota_set_boot_partition() selected; it runs unconfirmed until marked valid */
+void sim_ota_reboot(void);
+bool sim_ota_pending_verify(void);
+/* esp_ota_write() fails once the update has reached this many bytes */
+void sim_ota_fail_writes_after(size_t bytes);
+
@@ -0,0 +1,348 @@
+/* LIS3DH-style accelerometer on the door panel, behind a simulated I2C master bus (one bus) */
+#include <math.h>
+#include <string.h>
+#include "esp_timer.h"
+#include "driver/i2c_master.h"
+#include "sim.h"
+#include "sim_internal.h"
+
+#define REG_WHO_AM_I   0x0F
+#define REG_CTRL_REG1  0x20
+#define REG_CTRL_REG3  0x22
+#define REG_CTRL_REG5  0x24
+#define REG_OUT_X_L    0x28
+#define REG_OUT_Z_H    0x2D
+#define REG_FIFO_CTRL  0x2E
+#define REG_FIFO_SRC   0x2F
+#define REG_AUTO_INC   0x80
+
+#define WHO_AM_I_VALUE 0x33
+#define CTRL3_I1_WTM   0x04
+#define CTRL5_FIFO_EN  0x40
+#define FIFO_MODE_BYPASS 0
+#define FIFO_MODE_FIFO   1
+
+#define SIM_ACCEL_FIFO_DEPTH 32
+#define SIM_ACCEL_MAX_DEVICES 4
+
+typedef struct {
+    int16_t axis[3];
+} sample_t;
+
+struct i2c_master_bus_t {
+    bool used;
+};
+
+struct i2c_master_dev_t {
+    bool used;
+    uint16_t address;
+    uint32_t scl_speed_hz;
+};
+
+static struct i2c_master_bus_t s_bus;
+static struct i2c_master_dev_t s_devices[SIM_ACCEL_MAX_DEVICES];
+static sim_i2c_stats_t s_stats;
+
+static struct {
+    bool attached;
+    sim_accel_config_t config;
+    esp_timer_handle_t timer;
+    uint32_t period_us;
+    uint8_t regs[128];
+    sample_t fifo[SIM_ACCEL_FIFO_DEPTH];
+    uint32_t head;
+    uint32_t count;
+    sample_t latest;
+    uint32_t jitter_mg;
+    bool pinned;
+    int32_t pinned_cdeg;
+    uint32_t lcg;
+} s_accel;
+
+static const uint32_t s_odr_hz[] = {0, 1, 10, 25, 50, 100, 200, 400};
+
+static uint32_t next_random(void)
+{
+    s_accel.lcg = s_accel.lcg * 1103515245u + 12345u;
+    return s_accel.lcg >> 8;
+}
+
+static bool fifo_active(void)
+{
+    return (s_accel.regs[REG_CTRL_REG5] & CTRL5_FIFO_EN) && (s_accel.regs[REG_FIFO_CTRL] >> 6) != FIFO_MODE_BYPASS;
+}
+
+static uint32_t watermark(void)
+{
+    return s_accel.regs[REG_FIFO_CTRL] & 0x1F;
+}
+
+/* INT1 follows the watermark flag: high while the FIFO holds the watermark or more */
+static void update_int(void)
+{
+    bool high = (s_accel.regs[REG_CTRL_REG3] & CTRL3_I1_WTM) && fifo_active() && watermark() &&
+                s_accel.count >= watermark();
+    sim_gpio_set_input(s_accel.config.int_pin, high);
+}
+
+static int32_t panel_cdeg(void)
+{
+    if (s_accel.pinned) {
+        return s_accel.pinned_cdeg;
+    }
+    const sim_accel_config_t *c = &s_accel.config;
+    return c->closed_cdeg + (c->open_cdeg - c->closed_cdeg) * (int32_t)sim_door_position() / 1000;
+}
+
+/* High resolution, +/-2 g: 1 mg per digit, 12 bits left justified */
+static int16_t to_raw(double mg)
+{
+    if (s_accel.jitter_mg) {
+        mg += (double)((int32_t)(next_random() % (2 * s_accel.jitter_mg + 1)) - (int32_t)s_accel.jitter_mg);
+    }
+    if (mg > 2047) {
+        mg = 2047;
+    } else if (mg < -2048) {
+        mg = -2048;
+    }
+    return (int16_t)(lround(mg) * 16);
+}
+
+static void take_sample(void *arg)
+{
+    double rad = panel_cdeg() * M_PI / 18000.0;
+    sample_t sample = {.axis = {to_raw(1000.0 * cos(rad)), to_raw(0), to_raw(1000.0 * sin(rad))}};
+    s_accel.latest = sample;
+    s_stats.samples++;
+    if (!fifo_active()) {
+        return;
+    }
+    if (s_accel.count == SIM_ACCEL_FIFO_DEPTH) {
+        s_stats.overruns++;
+        if ((s_accel.regs[REG_FIFO_CTRL] >> 6) == FIFO_MODE_FIFO) {
+            return; /* FIFO mode stops when full; stream mode drops the oldest */
+        }
+        s_accel.head = (s_accel.head + 1) % SIM_ACCEL_FIFO_DEPTH;
+        s_accel.count--;
+    }
+    s_accel.fifo[(s_accel.head + s_accel.count) % SIM_ACCEL_FIFO_DEPTH] = sample;
+    s_accel.count++;
+    update_int();
+}
+
+static void apply_odr(void)
+{
+    uint32_t hz = s_odr_hz[(s_accel.regs[REG_CTRL_REG1] >> 4) & 0x07];
+    uint32_t period_us = hz ? 1000000 / hz : 0;
+    if (period_us == s_accel.period_us) {
+        return;
+    }
+    s_accel.period_us = period_us;
+    esp_timer_stop(s_accel.timer);
+    if (period_us) {
+        esp_timer_start_periodic(s_accel.timer, period_us);
+    }
+}
+
+static void write_reg(uint8_t reg, uint8_t value)
+{
+    if (reg < REG_CTRL_REG1 || reg == REG_FIFO_SRC || (reg >= REG_OUT_X_L && reg <= REG_OUT_Z_H) || reg >= 0x40) {
+        return; /* Read-only or not modelled */
+    }
+    s_accel.regs[reg] = value;
+    if (reg == REG_CTRL_REG1) {
+        apply_odr();
+    }
+    if (!fifo_active()) {
+        s_accel.head = 0;
+        s_accel.count = 0;
+    }
+    update_int();
+}
+
+/* Output registers read from the FIFO head while it is active; reading OUT_Z_H pops it */
+static uint8_t read_reg(uint8_t reg)
+{
+    if (reg >= REG_OUT_X_L && reg <= REG_OUT_Z_H) {
+        const sample_t *sample = &s_accel.latest;
+        if (fifo_active() && s_accel.count) {
+            sample = &s_accel.fifo[s_accel.head];
+        }
+        uint16_t value = (uint16_t)sample->axis[(reg - REG_OUT_X_L) / 2];
+        uint8_t byte = (reg & 1) ? (uint8_t)(value >> 8) : (uint8_t)value;
+        if (reg == REG_OUT_Z_H && fifo_active() && s_accel.count) {
+            s_accel.head = (s_accel.head + 1) % SIM_ACCEL_FIFO_DEPTH;
+            s_accel.count--;
+        }
+        return byte;
+    }
+    if (reg == REG_FIFO_SRC) {
+        uint32_t count = s_accel.count;
+        return (uint8_t)((watermark() && count >= watermark() ? 0x80 : 0) |
+                         (count == SIM_ACCEL_FIFO_DEPTH ? 0x40 : 0) | (count == 0 ? 0x20 : 0) |
+                         (count > 0x1F ? 0x1F : count));
+    }
+    return reg == REG_WHO_AM_I ? WHO_AM_I_VALUE : s_accel.regs[reg & 0x7F];
+}
+
+static uint8_t next_reg(uint8_t reg)
+{
+    if (reg == REG_OUT_Z_H && fifo_active()) {
+        return REG_OUT_X_L; /* Burst reads wrap over the output registers to drain the FIFO */
+    }
+    return (uint8_t)((reg + 1) & 0x7F);
+}
+
+/* Start, address and data bytes with their ACK bits, repeated start, stop */
+static esp_err_t transfer(i2c_master_dev_handle_t dev, const uint8_t *wbuf, size_t wlen, uint8_t *rbuf, size_t rlen)
+{
+    if (!dev || !dev->used || (wlen && !wbuf) || (rlen && !rbuf) || wlen + rlen == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    bool present = s_accel.attached && dev->address == s_accel.config.address;
+    size_t bytes = present ? 1 + wlen + (rlen ? 1 + rlen : 0) : 1;
+    uint32_t bits = (uint32_t)bytes * 9 + 2 + (present && wlen && rlen ? 1 : 0);
+    uint32_t busy_us = (uint32_t)(((uint64_t)bits * 1000000 + dev->scl_speed_hz - 1) / dev->scl_speed_hz);
+
+    s_stats.transactions++;
+    s_stats.bytes += bytes;
+    s_stats.busy_us += busy_us;
+    if (present) {
+        uint8_t reg = wlen ? (wbuf[0] & 0x7F) : 0;
+        bool auto_inc = wlen && (wbuf[0] & REG_AUTO_INC);
+        for (size_t i = 1; i < wlen; i++) {
+            write_reg(reg, wbuf[i]);
+            reg = auto_inc ? (uint8_t)((reg + 1) & 0x7F) : reg;
+        }
+        for (size_t i = 0; i < rlen; i++) {
+            rbuf[i] = read_reg(reg);
+            reg = auto_inc ? next_reg(reg) : reg;
+        }
+        update_int();
+    }
+    sim_task_block_us(busy_us);
+    return present ? ESP_OK : ESP_ERR_INVALID_RESPONSE;
+}
+
+void sim_accel_attach(const sim_accel_config_t *config)
+{
+    sim_accel_detach();
+    s_accel.config = *config;
+    s_accel.lcg = 12345;
+    const esp_timer_create_args_t args = {.callback = take_sample, .name = "sim_accel"};
+    esp_timer_create(&args, &s_accel.timer);
+    sim_timer_set_world(s_accel.timer);
+    s_accel.attached = true;
+    update_int();
+}
+
+void sim_accel_detach(void)
+{
+    if (s_accel.attached) {
+        esp_timer_stop(s_accel.timer);
+        esp_timer_delete(s_accel.timer);
+    }
+    memset(&s_accel, 0, sizeof(s_accel));
+}
+
+void sim_i2c_reset(void)
+{
+    memset(&s_bus, 0, sizeof(s_bus));
+    memset(s_devices, 0, sizeof(s_devices));
+    memset(&s_stats, 0, sizeof(s_stats));
+}
+
+void sim_accel_set_noise(uint32_t jitter_mg)
+{
+    s_accel.jitter_mg = jitter_mg;
+}
+
+void sim_accel_pin_tilt(bool pinned, int32_t cdeg)
+{
+    s_accel.pinned = pinned;
+    s_accel.pinned_cdeg = cdeg;
+}
+
+uint32_t sim_accel_fifo_level(void)
+{
+    return s_accel.count;
+}
+
+void sim_i2c_get_stats(sim_i2c_stats_t *stats)
+{
+    *stats = s_stats;
+}
+
+void sim_i2c_reset_stats(void)
+{
+    memset(&s_stats, 0, sizeof(s_stats));
+}
+
+esp_err_t i2c_new_master_bus(const i2c_master_bus_config_t *bus_config, i2c_master_bus_handle_t *ret_bus_handle)
+{
+    if (!bus_config || !ret_bus_handle) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_bus.used) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    s_bus.used = true;
+    *ret_bus_handle = &s_bus;
+    return ESP_OK;
+}
+
+esp_err_t i2c_del_master_bus(i2c_master_bus_handle_t bus_handle)
+{
+    if (!bus_handle || !bus_handle->used) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (int i = 0; i < SIM_ACCEL_MAX_DEVICES; i++) {
+        if (s_devices[i].used) {
+            return ESP_ERR_INVALID_STATE; /* Devices must be removed first */
+        }
+    }
+    bus_handle->used = false;
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_bus_add_device(i2c_master_bus_handle_t bus_handle, const i2c_device_config_t *dev_config,
+                                    i2c_master_dev_handle_t *ret_handle)
+{
+    if (!bus_handle || !bus_handle->used || !dev_config || !ret_handle || dev_config->scl_speed_hz == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (int i = 0; i < SIM_ACCEL_MAX_DEVICES; i++) {
+        if (!s_devices[i].used) {
+            s_devices[i] = (struct i2c_master_dev_t){
+                .used = true,
+                .address = dev_config->device_address,
+                .scl_speed_hz = dev_config->scl_speed_hz,
+            };
+            *ret_handle = &s_devices[i];
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NO_MEM;
+}
+
+esp_err_t i2c_master_bus_rm_device(i2c_master_dev_handle_t handle)
+{
+    if (!handle || !handle->used) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    handle->used = false;
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_transmit(i2c_master_dev_handle_t i2c_dev, const uint8_t *write_buffer, size_t write_size,
+                              int xfer_timeout_ms)
+{
+    return transfer(i2c_dev, write_buffer, write_size, NULL, 0);
+}
+
+esp_err_t i2c_master_transmit_receive(i2c_master_dev_handle_t i2c_dev, const uint8_t *write_buffer,
+                                      size_t write_size, uint8_t *read_buffer, size_t read_size,
+                                      int xfer_timeout_ms)
+{
+    return transfer(i2c_dev, write_buffer, write_size, read_buffer, read_size);
+}
@@ -0,0 +1,114 @@
+/* Toggle opener and door model driven by the relay output, reporting through the reeds */
+#include <string.h>
+#include "esp_timer.h"
+#include "sim.h"
+#include "sim_internal.h"
+
+#define SIM_DOOR_STEP_MS  10
+#define SIM_DOOR_FULL     1000000 /* position resolution: millionths of full travel */
+
+static struct {
+    bool attached;
+    sim_door_config_t config;
+    esp_timer_handle_t timer;
+    int32_t position;
+    sim_door_motion_t motion;
+    sim_door_motion_t last_motion;
+    bool jammed;
+    bool opener_dead;
+    uint32_t missed_pulses;
+} s_door;
+
+static void update_reeds(void)
+{
+    int32_t span = (int32_t)s_door.config.reed_span_permille * (SIM_DOOR_FULL / 1000);
+    sim_gpio_set_input(s_door.config.reed_closed_pin, s_door.position <= span ? 0 : 1);
+    sim_gpio_set_input(s_door.config.reed_open_pin, s_door.position >= SIM_DOOR_FULL - span ? 0 : 1);
+}
+
+static void step(void *arg)
+{
+    if (s_door.motion == SIM_DOOR_IDLE || s_door.jammed) {
+        return;
+    }
+    int32_t delta = (int32_t)((int64_t)SIM_DOOR_FULL * SIM_DOOR_STEP_MS / s_door.config.travel_ms);
+    s_door.position += (s_door.motion == SIM_DOOR_UP) ? delta : -delta;
+    if (s_door.position >= SIM_DOOR_FULL || s_door.position <= 0) {
+        s_door.position = s_door.position <= 0 ? 0 : SIM_DOOR_FULL;
+        s_door.motion = SIM_DOOR_IDLE;
+    }
+    update_reeds();
+}
+
+static void relay_edge(gpio_num_t pin, uint32_t level, void *ctx)
+{
+    if (level != 1 || s_door.opener_dead) {
+        return;
+    }
+    if (s_door.missed_pulses) {
+        s_door.missed_pulses--;
+        return;
+    }
+    if (s_door.motion != SIM_DOOR_IDLE) {
+        s_door.last_motion = s_door.motion;
+        s_door.motion = SIM_DOOR_IDLE;
+    } else if (s_door.position == 0) {
+        s_door.motion = SIM_DOOR_UP;
+    } else if (s_door.position == SIM_DOOR_FULL) {
+        s_door.motion = SIM_DOOR_DOWN;
+    } else {
+        s_door.motion = (s_door.last_motion == SIM_DOOR_UP) ? SIM_DOOR_DOWN : SIM_DOOR_UP;
+    }
+}
+
+void sim_door_attach(const sim_door_config_t *config, uint32_t position_permille)
+{
+    sim_door_detach();
+    s_door.config = *config;
+    s_door.position = (int32_t)(position_permille > 1000 ? 1000 : position_permille) * (SIM_DOOR_FULL / 1000);
+    s_door.motion = SIM_DOOR_IDLE;
+    s_door.last_motion = SIM_DOOR_IDLE;
+    const esp_timer_create_args_t args = {.callback = step, .name = "sim_door"};
+    esp_timer_create(&args, &s_door.timer);
+    sim_timer_set_world(s_door.timer);
+    esp_timer_start_periodic(s_door.timer, SIM_DOOR_STEP_MS * 1000);
+    sim_gpio_set_output_hook(config->relay_pin, relay_edge, NULL);
+    s_door.attached = true;
+    update_reeds();
+}
+
+void sim_door_detach(void)
+{
+    if (!s_door.attached) {
+        return;
+    }
+    esp_timer_stop(s_door.timer);
+    esp_timer_delete(s_door.timer);
+    sim_gpio_set_output_hook(s_door.config.relay_pin, NULL, NULL);
+    memset(&s_door, 0, sizeof(s_door));
+}
+
+uint32_t sim_door_position(void)
+{
+    return (uint32_t)(s_door.position / (SIM_DOOR_FULL / 1000));
+}
+
+sim_door_motion_t sim_door_motion(void)
+{
+    return s_door.motion;
+}
+
+void sim_door_set_jammed(bool jammed)
+{
+    s_door.jammed = jammed;
+}
+
+void sim_door_set_opener_dead(bool dead)
+{
+    s_door.opener_dead = dead;
+}
+
+void sim_door_miss_pulses(uint32_t count)
+{
+    s_door.missed_pulses = count;
+}
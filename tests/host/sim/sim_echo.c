@@ -0,0 +1,206 @@
+/* HC-SR04 model behind a simulated RMT receive channel (one channel) */
+#include <string.h>
+#include "esp_timer.h"
+#include "driver/rmt_rx.h"
+#include "sim.h"
+#include "sim_internal.h"
+
+#define SIM_ECHO_NO_TARGET_US 38000 /* The sensor's own timeout pulse */
+
+struct rmt_channel_t {
+    bool used;
+    bool enabled;
+    bool receiving;
+    rmt_rx_done_callback_t on_recv_done;
+    void *ctx;
+    rmt_symbol_word_t *buffer;
+    size_t buffer_symbols;
+    uint32_t idle_us;
+    uint32_t echo_us;
+};
+
+static struct rmt_channel_t s_channel;
+
+static struct {
+    bool attached;
+    gpio_num_t trig_pin;
+    uint32_t last_level;
+    uint32_t distance_mm;
+    uint32_t jitter_mm;
+    uint32_t outlier_permille;
+    bool silent;
+    uint32_t lcg;
+    uint32_t triggers;
+    esp_timer_handle_t timer;
+} s_echo;
+
+static uint32_t next_random(void)
+{
+    s_echo.lcg = s_echo.lcg * 1103515245u + 12345u;
+    return s_echo.lcg >> 8;
+}
+
+/* The receive completes once the line has been idle for the configured range */
+static void deliver(void *arg)
+{
+    if (!s_channel.receiving || !s_channel.buffer || s_channel.buffer_symbols == 0) {
+        return;
+    }
+    uint32_t width = s_channel.echo_us < s_channel.idle_us ? s_channel.echo_us : s_channel.idle_us;
+    s_channel.buffer[0].val = 0;
+    s_channel.buffer[0].duration0 = width > 0x7FFF ? 0x7FFF : width;
+    s_channel.buffer[0].level0 = 1;
+    s_channel.receiving = false;
+
+    rmt_rx_done_event_data_t data = {.received_symbols = s_channel.buffer, .num_symbols = 1};
+    if (s_channel.on_recv_done) {
+        sim_isr_enter();
+        s_channel.on_recv_done(&s_channel, &data, s_channel.ctx);
+        sim_isr_exit();
+    }
+}
+
+static void trigger_edge(gpio_num_t pin, uint32_t level, void *ctx)
+{
+    bool falling = s_echo.last_level == 1 && level == 0;
+    s_echo.last_level = level;
+    if (!falling) {
+        return;
+    }
+    s_echo.triggers++;
+    if (s_echo.silent || !s_channel.receiving || esp_timer_is_active(s_echo.timer)) {
+        return;
+    }
+
+    uint32_t distance_mm = s_echo.distance_mm;
+    if (s_echo.outlier_permille && next_random() % 1000 < s_echo.outlier_permille) {
+        if (next_random() & 1) {
+            return; /* Lost echo: the receive never completes */
+        }
+        distance_mm = distance_mm / 3 + 100; /* Spurious near reflection */
+    } else if (s_echo.jitter_mm && distance_mm) {
+        int32_t offset = (int32_t)(next_random() % (2 * s_echo.jitter_mm + 1)) - (int32_t)s_echo.jitter_mm;
+        distance_mm = (uint32_t)((int32_t)distance_mm + offset);
+    }
+
+    /* 343 m/s round trip */
+    s_channel.echo_us = distance_mm ? distance_mm * 2000 / 343 : SIM_ECHO_NO_TARGET_US;
+    uint32_t width = s_channel.echo_us < s_channel.idle_us ? s_channel.echo_us : s_channel.idle_us;
+    esp_timer_start_once(s_echo.timer, width + s_channel.idle_us);
+}
+
+void sim_echo_attach(gpio_num_t trig_pin)
+{
+    sim_echo_detach();
+    s_echo.trig_pin = trig_pin;
+    s_echo.lcg = 12345;
+    const esp_timer_create_args_t args = {.callback = deliver, .name = "sim_echo"};
+    esp_timer_create(&args, &s_echo.timer);
+    sim_gpio_set_output_hook(trig_pin, trigger_edge, NULL);
+    s_echo.attached = true;
+}
+
+void sim_echo_detach(void)
+{
+    if (s_echo.attached) {
+        esp_timer_stop(s_echo.timer);
+        esp_timer_delete(s_echo.timer);
+        sim_gpio_set_output_hook(s_echo.trig_pin, NULL, NULL);
+    }
+    memset(&s_echo, 0, sizeof(s_echo));
+    memset(&s_channel, 0, sizeof(s_channel));
+}
+
+void sim_echo_set_distance(uint32_t distance_mm)
+{
+    s_echo.distance_mm = distance_mm;
+}
+
+void sim_echo_set_noise(uint32_t jitter_mm, uint32_t outlier_permille)
+{
+    s_echo.jitter_mm = jitter_mm;
+    s_echo.outlier_permille = outlier_permille;
+}
+
+void sim_echo_set_silent(bool silent)
+{
+    s_echo.silent = silent;
+}
+
+uint32_t sim_echo_trigger_count(void)
+{
+    return s_echo.triggers;
+}
+
+esp_err_t rmt_new_rx_channel(const rmt_rx_channel_config_t *config, rmt_channel_handle_t *ret_chan)
+{
+    if (!config || !ret_chan) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_channel.used) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    memset(&s_channel, 0, sizeof(s_channel));
+    s_channel.used = true;
+    *ret_chan = &s_channel;
+    return ESP_OK;
+}
+
+esp_err_t rmt_rx_register_event_callbacks(rmt_channel_handle_t rx_channel, const rmt_rx_event_callbacks_t *cbs,
+                                          void *user_data)
+{
+    if (!rx_channel || !cbs) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    rx_channel->on_recv_done = cbs->on_recv_done;
+    rx_channel->ctx = user_data;
+    return ESP_OK;
+}
+
+esp_err_t rmt_receive(rmt_channel_handle_t rx_channel, void *buffer, size_t buffer_size,
+                      const rmt_receive_config_t *config)
+{
+    if (!rx_channel || !buffer || !config) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!rx_channel->enabled || rx_channel->receiving) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    rx_channel->buffer = buffer;
+    rx_channel->buffer_symbols = buffer_size / sizeof(rmt_symbol_word_t);
+    rx_channel->idle_us = config->signal_range_max_ns / 1000;
+    rx_channel->receiving = true;
+    return ESP_OK;
+}
+
+esp_err_t rmt_enable(rmt_channel_handle_t channel)
+{
+    if (!channel || channel->enabled) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    channel->enabled = true;
+    return ESP_OK;
+}
+
+/* Disabling aborts a receive in progress, including an echo already on its way */
+esp_err_t rmt_disable(rmt_channel_handle_t channel)
+{
+    if (!channel || !channel->enabled) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    channel->enabled = false;
+    channel->receiving = false;
+    if (s_echo.attached) {
+        esp_timer_stop(s_echo.timer);
+    }
+    return ESP_OK;
+}
+
+esp_err_t rmt_del_channel(rmt_channel_handle_t channel)
+{
+    if (!channel || channel->enabled) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    channel->used = false;
+    return ESP_OK;
+}
@@ -0,0 +1,294 @@
+/*
+ * GPIO stand-in: pin levels in memory, edge interrupts dispatched synchronously.
+ * A level interrupt fires when its level arrives, or when it is unmasked
+ * (gpio_intr_enable()) while the level holds.
+ * While the simulated chip light sleeps (sim_pm.c) an interrupt is held
+ * pending and dispatched on the next wake; only a pin armed with
+ * gpio_wakeup_enable() wakes the chip itself.
+ */
+#include <string.h>
+#include "driver/gpio.h"
+#include "hal/gpio_ll.h"
+#include "sim.h"
+#include "sim_internal.h"
+
+typedef struct {
+    bool configured;
+    bool driven;
+    bool stuck;
+    bool wakeup;
+    bool pending;
+    bool masked; /* gpio_intr_disable() */
+    gpio_mode_t mode;
+    gpio_int_type_t intr_type;
+    uint32_t level;
+    gpio_isr_t isr;
+    void *isr_arg;
+    sim_gpio_output_hook_t hook;
+    void *hook_ctx;
+} sim_pin_t;
+
+static sim_pin_t s_pins[GPIO_NUM_MAX];
+
+/* The register block the LL functions are handed; they go through the pins above */
+struct gpio_dev_s {
+    int unused;
+};
+gpio_dev_t GPIO;
+
+static bool s_isr_service = false;
+static bool s_any_pending = false;
+
+static bool valid_pin(gpio_num_t pin)
+{
+    return pin >= 0 && pin < GPIO_NUM_MAX;
+}
+
+void sim_gpio_reset(void)
+{
+    memset(s_pins, 0, sizeof(s_pins));
+    s_isr_service = false;
+    s_any_pending = false;
+}
+
+esp_err_t gpio_config(const gpio_config_t *config)
+{
+    if (!config || config->pin_bit_mask == 0 || (config->pin_bit_mask >> GPIO_NUM_MAX) != 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (int pin = 0; pin < GPIO_NUM_MAX; pin++) {
+        if (!(config->pin_bit_mask & (1ULL << pin))) {
+            continue;
+        }
+        sim_pin_t *p = &s_pins[pin];
+        /* A freshly configured input follows its pull resistor until the test drives it */
+        if (!p->configured && !p->driven && (config->mode & GPIO_MODE_INPUT)) {
+            p->level = config->pull_up_en ? 1 : 0;
+        }
+        p->configured = true;
+        p->mode = config->mode;
+        p->intr_type = config->intr_type;
+        if (config->intr_type != GPIO_INTR_DISABLE) {
+            p->masked = false; /* gpio_config() enables the interrupt it configures */
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_level(gpio_num_t gpio_num, uint32_t level)
+{
+    if (!valid_pin(gpio_num)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    sim_pin_t *p = &s_pins[gpio_num];
+    level = level ? 1 : 0;
+    if (!(p->mode & GPIO_MODE_OUTPUT)) {
+        return ESP_OK;
+    }
+    bool changed = p->level != level;
+    p->level = level;
+    if (changed && p->hook) {
+        p->hook(gpio_num, level, p->hook_ctx);
+    }
+    return ESP_OK;
+}
+
+int gpio_get_level(gpio_num_t gpio_num)
+{
+    return valid_pin(gpio_num) ? (int)s_pins[gpio_num].level : 0;
+}
+
+esp_err_t gpio_install_isr_service(int intr_alloc_flags)
+{
+    if (s_isr_service) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    s_isr_service = true;
+    return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_add(gpio_num_t gpio_num, gpio_isr_t isr_handler, void *args)
+{
+    if (!valid_pin(gpio_num)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!s_isr_service) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    s_pins[gpio_num].isr = isr_handler;
+    s_pins[gpio_num].isr_arg = args;
+    return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_remove(gpio_num_t gpio_num)
+{
+    if (!valid_pin(gpio_num)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_pins[gpio_num].isr = NULL;
+    s_pins[gpio_num].isr_arg = NULL;
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_intr_type(gpio_num_t gpio_num, gpio_int_type_t intr_type)
+{
+    if (!valid_pin(gpio_num)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_pins[gpio_num].intr_type = intr_type;
+    return ESP_OK;
+}
+
+esp_err_t gpio_intr_disable(gpio_num_t gpio_num)
+{
+    if (!valid_pin(gpio_num)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_pins[gpio_num].masked = true;
+    return ESP_OK;
+}
+
+esp_err_t gpio_wakeup_enable(gpio_num_t gpio_num, gpio_int_type_t intr_type)
+{
+    if (!valid_pin(gpio_num) || (intr_type != GPIO_INTR_LOW_LEVEL && intr_type != GPIO_INTR_HIGH_LEVEL)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_pins[gpio_num].intr_type = intr_type;
+    s_pins[gpio_num].wakeup = true;
+    return ESP_OK;
+}
+
+/* As on target, this also disables the pin's interrupt */
+esp_err_t gpio_wakeup_disable(gpio_num_t gpio_num)
+{
+    if (!valid_pin(gpio_num)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_pins[gpio_num].intr_type = GPIO_INTR_DISABLE;
+    s_pins[gpio_num].wakeup = false;
+    return ESP_OK;
+}
+
+void gpio_ll_wakeup_disable(gpio_dev_t *hw, uint32_t gpio_num)
+{
+    (void)hw;
+    if (valid_pin((gpio_num_t)gpio_num)) {
+        s_pins[gpio_num].wakeup = false;
+    }
+}
+
+static void dispatch(sim_pin_t *p)
+{
+    sim_isr_enter();
+    p->isr(p->isr_arg);
+    sim_isr_exit();
+}
+
+bool sim_gpio_dispatch_pending(void)
+{
+    if (!s_any_pending) {
+        return false;
+    }
+    s_any_pending = false;
+    for (int pin = 0; pin < GPIO_NUM_MAX; pin++) {
+        sim_pin_t *p = &s_pins[pin];
+        if (p->pending) {
+            p->pending = false;
+            if (p->isr && !p->masked) {
+                dispatch(p);
+            }
+        }
+    }
+    return true;
+}
+
+static void raise(sim_pin_t *p)
+{
+    if (!p->isr || p->masked) {
+        return;
+    }
+    if (sim_pm_interrupt(p->wakeup)) {
+        dispatch(p);
+    } else {
+        p->pending = true;
+        s_any_pending = true;
+    }
+}
+
+static bool level_active(const sim_pin_t *p)
+{
+    return (p->intr_type == GPIO_INTR_LOW_LEVEL && p->level == 0) ||
+           (p->intr_type == GPIO_INTR_HIGH_LEVEL && p->level == 1);
+}
+
+static void drive_input(gpio_num_t pin, uint32_t level)
+{
+    sim_pin_t *p = &s_pins[pin];
+    level = level ? 1 : 0;
+    p->driven = true;
+    if (p->level == level) {
+        return;
+    }
+    p->level = level;
+
+    bool fire = false;
+    switch (p->intr_type) {
+        case GPIO_INTR_ANYEDGE: fire = true; break;
+        case GPIO_INTR_POSEDGE: fire = level == 1; break;
+        case GPIO_INTR_NEGEDGE: fire = level == 0; break;
+        default: fire = level_active(p); break;
+    }
+    if (fire) {
+        raise(p);
+    }
+}
+
+/* A level interrupt whose level already holds fires as soon as it is unmasked */
+esp_err_t gpio_intr_enable(gpio_num_t gpio_num)
+{
+    if (!valid_pin(gpio_num)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    sim_pin_t *p = &s_pins[gpio_num];
+    p->masked = false;
+    if (level_active(p)) {
+        raise(p);
+    }
+    return ESP_OK;
+}
+
+void sim_gpio_set_input(gpio_num_t pin, uint32_t level)
+{
+    if (valid_pin(pin) && !s_pins[pin].stuck) {
+        drive_input(pin, level);
+    }
+}
+
+void sim_gpio_stick(gpio_num_t pin, uint32_t level)
+{
+    if (valid_pin(pin)) {
+        s_pins[pin].stuck = false;
+        drive_input(pin, level);
+        s_pins[pin].stuck = true;
+    }
+}
+
+void sim_gpio_release(gpio_num_t pin)
+{
+    if (valid_pin(pin)) {
+        s_pins[pin].stuck = false;
+    }
+}
+
+uint32_t sim_gpio_get_output(gpio_num_t pin)
+{
+    return valid_pin(pin) ? s_pins[pin].level : 0;
+}
+
+void sim_gpio_set_output_hook(gpio_num_t pin, sim_gpio_output_hook_t hook, void *ctx)
+{
+    if (valid_pin(pin)) {
+        s_pins[pin].hook = hook;
+        s_pins[pin].hook_ctx = ctx;
+    }
+}
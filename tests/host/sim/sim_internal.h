@@ -0,0 +1,30 @@
+#pragma once
+
+/* Hooks shared between the simulator modules; not for tests */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_timer.h"
+
+void sim_isr_enter(void);
+void sim_isr_exit(void);
+void sim_rtos_reset(void);
+/* Forgets the I2C bus and devices the drivers created (sim_accel.c) */
+void sim_i2c_reset(void);
+/* Interrupts held while the chip slept; true if there were any */
+bool sim_gpio_dispatch_pending(void);
+void sim_timer_set_world(esp_timer_handle_t timer);
+/* The calling task waits while a peripheral works on its own (a bus transfer); the CPU stays free */
+void sim_task_block_us(uint32_t us);
+
+/*
+ * Power manager. The scheduler reports when nothing is ready (the chip may
+ * fall asleep) and asks before running anything whether the chip must wake
+ * first; the answer is the time the wake completes.
+ */
+void sim_pm_reset(void);
+void sim_pm_idle(int64_t now_us, int64_t until_us);
+bool sim_pm_wake_requested(void);
+int64_t sim_pm_wake(int64_t now_us);
+/* An interrupt raised now: true to dispatch it, false to hold it until the next wake */
+bool sim_pm_interrupt(bool wake_source);
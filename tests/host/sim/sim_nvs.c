@@ -0,0 +1,279 @@
+/* NVS stand-in: one flat in-memory table of typed entries per namespace */
+#include <string.h>
+#include "nvs.h"
+#include "nvs_flash.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "sim.h"
+
+#define SIM_NVS_MAX_ENTRIES    256
+#define SIM_NVS_MAX_NAMESPACES 4
+#define SIM_NVS_MAX_VALUE      512
+
+typedef enum {
+    ENTRY_U32,
+    ENTRY_BLOB,
+} entry_type_t;
+
+typedef struct {
+    bool used;
+    uint8_t ns;
+    entry_type_t type;
+    char key[NVS_KEY_NAME_MAX_SIZE];
+    size_t length;
+    uint8_t data[SIM_NVS_MAX_VALUE];
+} entry_t;
+
+static entry_t s_entries[SIM_NVS_MAX_ENTRIES];
+static char s_namespaces[SIM_NVS_MAX_NAMESPACES][NVS_KEY_NAME_MAX_SIZE];
+static bool s_initialized = false;
+static uint32_t s_commits = 0;
+static uint32_t s_reads = 0;
+static uint32_t s_commit_latency_ms = 0;
+static sim_nvs_hook_t s_hook = NULL;
+static void *s_hook_ctx = NULL;
+
+static uint32_t s_fail_ops = 0;
+static esp_err_t s_fail_err = ESP_OK;
+static uint32_t s_fail_count = 0;
+
+static bool inject(uint32_t op, esp_err_t *err)
+{
+    if (s_fail_count == 0 || !(s_fail_ops & op)) {
+        return false;
+    }
+    s_fail_count--;
+    *err = s_fail_err;
+    return true;
+}
+
+static esp_err_t check_handle(nvs_handle_t handle, const char *key)
+{
+    if (!s_initialized) {
+        return ESP_ERR_NVS_NOT_INITIALIZED;
+    }
+    if (handle == 0 || handle > SIM_NVS_MAX_NAMESPACES || !s_namespaces[handle - 1][0]) {
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    }
+    if (!key) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (strlen(key) >= NVS_KEY_NAME_MAX_SIZE) {
+        return ESP_ERR_NVS_KEY_TOO_LONG;
+    }
+    return ESP_OK;
+}
+
+static entry_t *find(nvs_handle_t handle, const char *key)
+{
+    for (int i = 0; i < SIM_NVS_MAX_ENTRIES; i++) {
+        if (s_entries[i].used && s_entries[i].ns == handle && strcmp(s_entries[i].key, key) == 0) {
+            return &s_entries[i];
+        }
+    }
+    return NULL;
+}
+
+static esp_err_t store(nvs_handle_t handle, const char *key, entry_type_t type, const void *value, size_t length)
+{
+    esp_err_t err = check_handle(handle, key);
+    if (err != ESP_OK || inject(SIM_NVS_OP_SET, &err)) {
+        return err;
+    }
+    if (length > SIM_NVS_MAX_VALUE) {
+        return ESP_ERR_NVS_VALUE_TOO_LONG;
+    }
+    entry_t *e = find(handle, key);
+    if (e && e->type != type) {
+        return ESP_ERR_NVS_TYPE_MISMATCH;
+    }
+    for (int i = 0; !e && i < SIM_NVS_MAX_ENTRIES; i++) {
+        if (!s_entries[i].used) {
+            e = &s_entries[i];
+            memset(e, 0, sizeof(*e));
+            e->used = true;
+            e->ns = (uint8_t)handle;
+            e->type = type;
+            strcpy(e->key, key);
+        }
+    }
+    if (!e) {
+        return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+    }
+    memcpy(e->data, value, length);
+    e->length = length;
+    if (s_hook) {
+        s_hook(key, value, length, s_hook_ctx);
+    }
+    return ESP_OK;
+}
+
+static esp_err_t load(nvs_handle_t handle, const char *key, entry_type_t type, entry_t **out)
+{
+    esp_err_t err = check_handle(handle, key);
+    if (err != ESP_OK || inject(SIM_NVS_OP_GET, &err)) {
+        return err;
+    }
+    s_reads++;
+    entry_t *e = find(handle, key);
+    if (!e) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    if (e->type != type) {
+        return ESP_ERR_NVS_TYPE_MISMATCH;
+    }
+    *out = e;
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_init(void)
+{
+    s_initialized = true;
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_erase(void)
+{
+    memset(s_entries, 0, sizeof(s_entries));
+    return ESP_OK;
+}
+
+esp_err_t nvs_open(const char *namespace_name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle)
+{
+    if (!s_initialized) {
+        return ESP_ERR_NVS_NOT_INITIALIZED;
+    }
+    if (!namespace_name || !out_handle || strlen(namespace_name) >= NVS_KEY_NAME_MAX_SIZE) {
+        return ESP_ERR_NVS_INVALID_NAME;
+    }
+    for (int i = 0; i < SIM_NVS_MAX_NAMESPACES; i++) {
+        if (!s_namespaces[i][0] || strcmp(s_namespaces[i], namespace_name) == 0) {
+            strcpy(s_namespaces[i], namespace_name);
+            *out_handle = (nvs_handle_t)(i + 1);
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+}
+
+/* Handles stay valid: the simulated flash outlives the component state between tests */
+void nvs_close(nvs_handle_t handle)
+{
+}
+
+esp_err_t nvs_set_u32(nvs_handle_t handle, const char *key, uint32_t value)
+{
+    return store(handle, key, ENTRY_U32, &value, sizeof(value));
+}
+
+esp_err_t nvs_get_u32(nvs_handle_t handle, const char *key, uint32_t *out_value)
+{
+    entry_t *e = NULL;
+    esp_err_t err = load(handle, key, ENTRY_U32, &e);
+    if (err == ESP_OK) {
+        memcpy(out_value, e->data, sizeof(*out_value));
+    }
+    return err;
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length)
+{
+    return store(handle, key, ENTRY_BLOB, value, length);
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out_value, size_t *length)
+{
+    entry_t *e = NULL;
+    esp_err_t err = load(handle, key, ENTRY_BLOB, &e);
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (!out_value) {
+        *length = e->length;
+        return ESP_OK;
+    }
+    if (*length < e->length) {
+        *length = e->length;
+        return ESP_ERR_NVS_INVALID_LENGTH;
+    }
+    memcpy(out_value, e->data, e->length);
+    *length = e->length;
+    return ESP_OK;
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key)
+{
+    esp_err_t err = check_handle(handle, key);
+    if (err != ESP_OK || inject(SIM_NVS_OP_SET, &err)) {
+        return err;
+    }
+    entry_t *e = find(handle, key);
+    if (!e) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    e->used = false;
+    return ESP_OK;
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle)
+{
+    esp_err_t err = check_handle(handle, "");
+    if (err != ESP_OK || inject(SIM_NVS_OP_COMMIT, &err)) {
+        return err;
+    }
+    if (s_commit_latency_ms) {
+        vTaskDelay(pdMS_TO_TICKS(s_commit_latency_ms));
+    }
+    s_commits++;
+    if (s_hook) {
+        s_hook(NULL, NULL, 0, s_hook_ctx);
+    }
+    return ESP_OK;
+}
+
+void sim_nvs_erase_all(void)
+{
+    nvs_flash_erase();
+    s_fail_count = 0;
+    s_commits = 0;
+    s_reads = 0;
+    s_commit_latency_ms = 0;
+    s_hook = NULL;
+}
+
+void sim_nvs_set_commit_latency(uint32_t latency_ms)
+{
+    s_commit_latency_ms = latency_ms;
+}
+
+void sim_nvs_set_hook(sim_nvs_hook_t hook, void *ctx)
+{
+    s_hook = hook;
+    s_hook_ctx = ctx;
+}
+
+void sim_nvs_inject_failure(uint32_t ops, esp_err_t err, uint32_t count)
+{
+    s_fail_ops = ops;
+    s_fail_err = err;
+    s_fail_count = count;
+}
+
+uint32_t sim_nvs_commit_count(void)
+{
+    return s_commits;
+}
+
+uint32_t sim_nvs_read_count(void)
+{
+    return s_reads;
+}
+
+uint32_t sim_nvs_entry_count(void)
+{
+    uint32_t count = 0;
+    for (int i = 0; i < SIM_NVS_MAX_ENTRIES; i++) {
+        count += s_entries[i].used;
+    }
+    return count;
+}
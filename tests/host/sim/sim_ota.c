@@ -0,0 +1,185 @@
+/* OTA stand-in: ota_0 and ota_1 app slots backed by temporary files */
+#include <stdio.h>
+#include <string.h>
+#include "esp_ota_ops.h"
+#include "sim.h"
+
+#define SLOT_COUNT 2
+
+static esp_partition_t s_slots[SLOT_COUNT];
+static FILE *s_files[SLOT_COUNT];
+static int s_running = 0;
+static int s_boot = 0;
+static bool s_pending_verify = false;
+
+/* One update at a time, as the firmware does */
+static int s_update_slot = -1;
+static size_t s_written = 0;
+static size_t s_fail_after = SIZE_MAX;
+
+static int slot_of(const esp_partition_t *partition)
+{
+    for (int i = 0; i < SLOT_COUNT; i++) {
+        if (partition == &s_slots[i] && s_files[i]) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void sim_ota_attach(const uint8_t *image, size_t len, size_t slot_size)
+{
+    sim_ota_detach();
+    static uint8_t erased[4096];
+    memset(erased, 0xFF, sizeof(erased));
+    for (int i = 0; i < SLOT_COUNT; i++) {
+        s_slots[i] = (esp_partition_t){
+            .type = ESP_PARTITION_TYPE_APP,
+            .subtype = ESP_PARTITION_SUBTYPE_APP_OTA_0 + i,
+            .address = 0x20000 + (uint32_t)(i * slot_size),
+            .size = (uint32_t)slot_size,
+            .erase_size = 4096,
+        };
+        snprintf(s_slots[i].label, sizeof(s_slots[i].label), "ota_%d", i);
+        s_files[i] = tmpfile();
+        for (size_t done = 0; done < slot_size; done += sizeof(erased)) {
+            size_t n = slot_size - done < sizeof(erased) ? slot_size - done : sizeof(erased);
+            fwrite(erased, 1, n, s_files[i]);
+        }
+    }
+    fseek(s_files[0], 0, SEEK_SET);
+    fwrite(image, 1, len, s_files[0]);
+    fflush(s_files[0]);
+    s_running = 0;
+    s_boot = 0;
+    s_update_slot = -1;
+    s_fail_after = SIZE_MAX;
+    s_pending_verify = false;
+}
+
+void sim_ota_detach(void)
+{
+    for (int i = 0; i < SLOT_COUNT; i++) {
+        if (s_files[i]) {
+            fclose(s_files[i]);
+            s_files[i] = NULL;
+        }
+    }
+    s_update_slot = -1;
+}
+
+void sim_ota_reboot(void)
+{
+    s_running = s_boot;
+    s_pending_verify = true;
+}
+
+bool sim_ota_pending_verify(void)
+{
+    return s_pending_verify;
+}
+
+void sim_ota_fail_writes_after(size_t bytes)
+{
+    s_fail_after = bytes;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *partition, size_t src_offset, void *dst, size_t size)
+{
+    int slot = slot_of(partition);
+    if (slot < 0 || !dst) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (src_offset > partition->size || size > partition->size - src_offset) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    fseek(s_files[slot], (long)src_offset, SEEK_SET);
+    return fread(dst, 1, size, s_files[slot]) == size ? ESP_OK : ESP_FAIL;
+}
+
+const esp_partition_t *esp_ota_get_running_partition(void)
+{
+    return s_files[s_running] ? &s_slots[s_running] : NULL;
+}
+
+const esp_partition_t *esp_ota_get_boot_partition(void)
+{
+    return s_files[s_boot] ? &s_slots[s_boot] : NULL;
+}
+
+const esp_partition_t *esp_ota_get_next_update_partition(const esp_partition_t *start_from)
+{
+    int next = (s_running + 1) % SLOT_COUNT;
+    return s_files[next] ? &s_slots[next] : NULL;
+}
+
+esp_err_t esp_ota_begin(const esp_partition_t *partition, size_t image_size, esp_ota_handle_t *out_handle)
+{
+    int slot = slot_of(partition);
+    if (slot < 0 || !out_handle) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (slot == s_running) {
+        return ESP_ERR_OTA_PARTITION_CONFLICT;
+    }
+    if (s_update_slot >= 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    s_update_slot = slot;
+    s_written = 0;
+    *out_handle = (esp_ota_handle_t)(slot + 1);
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_write(esp_ota_handle_t handle, const void *data, size_t size)
+{
+    if (s_update_slot < 0 || handle != (esp_ota_handle_t)(s_update_slot + 1)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_written + size > s_slots[s_update_slot].size) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    if (s_written + size > s_fail_after) {
+        return ESP_FAIL;
+    }
+    fseek(s_files[s_update_slot], (long)s_written, SEEK_SET);
+    fwrite(data, 1, size, s_files[s_update_slot]);
+    s_written += size;
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_end(esp_ota_handle_t handle)
+{
+    if (s_update_slot < 0 || handle != (esp_ota_handle_t)(s_update_slot + 1)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    fflush(s_files[s_update_slot]);
+    bool empty = s_written == 0;
+    s_update_slot = -1;
+    return empty ? ESP_ERR_OTA_VALIDATE_FAILED : ESP_OK;
+}
+
+esp_err_t esp_ota_abort(esp_ota_handle_t handle)
+{
+    if (s_update_slot < 0 || handle != (esp_ota_handle_t)(s_update_slot + 1)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_update_slot = -1;
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_set_boot_partition(const esp_partition_t *partition)
+{
+    int slot = slot_of(partition);
+    if (slot < 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_boot = slot;
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_mark_app_valid_cancel_rollback(void)
+{
+    s_pending_verify = false;
+    return ESP_OK;
+}
@@ -0,0 +1,233 @@
+/*
+ * Power management stand-in: esp_pm locks and light sleep on the virtual clock.
+ *
+ * The chip light sleeps whenever the scheduler has nothing ready, light sleep
+ * is enabled and no ESP_PM_NO_LIGHT_SLEEP lock is held. It wakes for a due
+ * timer or task and for an interrupt on a pin armed with gpio_wakeup_enable();
+ * the wake takes the configured latency before anything runs. Interrupts on
+ * other pins are held until the next wake, as the GPIO matrix is not clocked.
+ */
+#include <string.h>
+#include "esp_pm.h"
+#include "esp_sleep.h"
+#include "sim.h"
+#include "sim_internal.h"
+
+#define SIM_MAX_PM_LOCKS 8
+
+struct esp_pm_lock {
+    bool in_use;
+    esp_pm_lock_type_t type;
+    uint32_t count;
+};
+
+static struct esp_pm_lock s_locks[SIM_MAX_PM_LOCKS];
+static esp_pm_config_t s_config;
+static esp_pm_sleep_cbs_register_config_t s_cbs;
+static bool s_gpio_wakeup;
+static uint32_t s_wake_latency_us;
+static bool s_asleep;
+static bool s_wake_requested;
+static int64_t s_sleep_start_us;
+static sim_pm_stats_t s_stats;
+
+void sim_pm_reset(void)
+{
+    memset(s_locks, 0, sizeof(s_locks));
+    memset(&s_config, 0, sizeof(s_config));
+    memset(&s_cbs, 0, sizeof(s_cbs));
+    memset(&s_stats, 0, sizeof(s_stats));
+    s_gpio_wakeup = false;
+    s_wake_latency_us = 0;
+    s_asleep = false;
+    s_wake_requested = false;
+}
+
+bool sim_pm_light_sleep_allowed(void)
+{
+    if (!s_config.light_sleep_enable) {
+        return false;
+    }
+    for (int i = 0; i < SIM_MAX_PM_LOCKS; i++) {
+        if (s_locks[i].in_use && s_locks[i].type == ESP_PM_NO_LIGHT_SLEEP && s_locks[i].count) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool sim_pm_asleep(void)
+{
+    return s_asleep;
+}
+
+void sim_pm_idle(int64_t now_us, int64_t until_us)
+{
+    if (s_asleep || !sim_pm_light_sleep_allowed()) {
+        return;
+    }
+    if (s_cbs.enter_cb) {
+        s_cbs.enter_cb(until_us - now_us, s_cbs.enter_cb_user_arg);
+    }
+    s_asleep = true;
+    s_sleep_start_us = now_us;
+    s_stats.sleeps++;
+}
+
+static void end_sleep(int64_t now_us)
+{
+    int64_t slept = now_us - s_sleep_start_us;
+    s_asleep = false;
+    s_wake_requested = false;
+    s_stats.slept_us += slept;
+    if (s_cbs.exit_cb) {
+        s_cbs.exit_cb(slept, s_cbs.exit_cb_user_arg);
+    }
+}
+
+bool sim_pm_wake_requested(void)
+{
+    return s_wake_requested;
+}
+
+int64_t sim_pm_wake(int64_t now_us)
+{
+    if (!s_asleep) {
+        return now_us;
+    }
+    end_sleep(now_us);
+    return now_us + s_wake_latency_us;
+}
+
+bool sim_pm_interrupt(bool wake_source)
+{
+    if (!s_asleep) {
+        return true;
+    }
+    if (wake_source && s_gpio_wakeup) {
+        s_wake_requested = true;
+        s_stats.gpio_wakeups++;
+    } else {
+        s_stats.held_interrupts++;
+    }
+    return false;
+}
+
+void sim_pm_set_wake_latency(uint32_t latency_us)
+{
+    s_wake_latency_us = latency_us;
+}
+
+void sim_pm_get_stats(sim_pm_stats_t *stats)
+{
+    *stats = s_stats;
+    if (s_asleep) {
+        stats->slept_us += sim_now_us() - s_sleep_start_us;
+    }
+}
+
+void sim_pm_reset_stats(void)
+{
+    memset(&s_stats, 0, sizeof(s_stats));
+    if (s_asleep) {
+        s_sleep_start_us = sim_now_us();
+    }
+}
+
+esp_err_t esp_pm_configure(const void *config)
+{
+    if (!config) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    const esp_pm_config_t *pm = config;
+    if (pm->min_freq_mhz <= 0 || pm->max_freq_mhz < pm->min_freq_mhz) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_config = *pm;
+    return ESP_OK;
+}
+
+esp_err_t esp_pm_get_configuration(void *config)
+{
+    if (!config) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *(esp_pm_config_t *)config = s_config;
+    return ESP_OK;
+}
+
+esp_err_t esp_pm_lock_create(esp_pm_lock_type_t lock_type, int arg, const char *name, esp_pm_lock_handle_t *out_handle)
+{
+    if (!out_handle) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (int i = 0; i < SIM_MAX_PM_LOCKS; i++) {
+        if (!s_locks[i].in_use) {
+            s_locks[i] = (struct esp_pm_lock){.in_use = true, .type = lock_type};
+            *out_handle = &s_locks[i];
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NO_MEM;
+}
+
+/* Taken from test code while the chip sleeps, the lock is the caller's wake: no latency is modelled */
+esp_err_t esp_pm_lock_acquire(esp_pm_lock_handle_t handle)
+{
+    if (!handle || !handle->in_use) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_asleep && handle->type == ESP_PM_NO_LIGHT_SLEEP) {
+        end_sleep(sim_now_us());
+    }
+    handle->count++;
+    return ESP_OK;
+}
+
+esp_err_t esp_pm_lock_release(esp_pm_lock_handle_t handle)
+{
+    if (!handle || !handle->in_use) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (handle->count == 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    handle->count--;
+    return ESP_OK;
+}
+
+esp_err_t esp_pm_lock_delete(esp_pm_lock_handle_t handle)
+{
+    if (!handle || !handle->in_use) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (handle->count) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    memset(handle, 0, sizeof(*handle));
+    return ESP_OK;
+}
+
+esp_err_t esp_pm_light_sleep_register_cbs(esp_pm_sleep_cbs_register_config_t *cbs_conf)
+{
+    if (!cbs_conf || (!cbs_conf->enter_cb && !cbs_conf->exit_cb)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_cbs = *cbs_conf;
+    return ESP_OK;
+}
+
+esp_err_t esp_pm_light_sleep_unregister_cbs(esp_pm_sleep_cbs_register_config_t *cbs_conf)
+{
+    if (!cbs_conf) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(&s_cbs, 0, sizeof(s_cbs));
+    return ESP_OK;
+}
+
+esp_err_t esp_sleep_enable_gpio_wakeup(void)
+{
+    s_gpio_wakeup = true;
+    return ESP_OK;
+}
@@ -0,0 +1,767 @@
+/*
+ * FreeRTOS and esp_timer stand-ins on a virtual clock.
+ *
+ * Tasks are ucontext coroutines with their own host stack. Scheduling is
+ * priority based: the highest-priority ready task runs until it blocks
+ * (vTaskDelay, a contended mutex, a notification wait) or readies a higher-priority task, which
+ * then preempts it. Timer callbacks run in a simulated esp_timer task at the
+ * firmware priority (22). Priority inheritance is not modelled. Timers that
+ * model the physical world (the door) fire from the scheduler instead, so
+ * they neither run as firmware nor wake a light-sleeping chip (sim_pm.c).
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ucontext.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+#include "esp_cpu.h"
+#include "sdkconfig.h"
+#include "sim.h"
+#include "sim_internal.h"
+
+#define SIM_MAX_TASKS          16
+#define SIM_MAX_MUTEXES        32
+#define SIM_MAX_TIMERS         32
+#define SIM_TASK_STACK_SIZE    (256 * 1024)
+#define SIM_ESP_TIMER_PRIORITY 22
+#define SIM_FOREVER            INT64_MAX
+
+typedef enum {
+    TASK_FREE,
+    TASK_READY,
+    TASK_DELAYED,
+    TASK_BLOCKED,
+    TASK_TIMER_WAIT,
+    TASK_NOTIFY_WAIT,
+    TASK_DELETED,
+} task_state_t;
+
+struct sim_task {
+    ucontext_t ctx;
+    void *stack;
+    TaskFunction_t fn;
+    void *arg;
+    char name[16];
+    UBaseType_t prio;
+    uint32_t stack_bytes;
+    task_state_t state;
+    int64_t wake_us;
+    struct sim_mutex *waiting_on;
+    bool timed_out;
+    uint64_t ready_seq;
+    uint32_t notify_count;
+    uint32_t run_time_us;    /* sim_task_busy_us() only */
+    uint32_t stack_free;     /* sim_task_set_stack_free(); 0: all of it */
+    UBaseType_t number;
+};
+
+struct sim_mutex {
+    bool in_use;
+    bool held;
+    TaskHandle_t owner;
+};
+
+struct esp_timer {
+    bool in_use;
+    bool armed;
+    esp_timer_cb_t callback;
+    void *arg;
+    const char *name;
+    int64_t expiry_us;
+    uint64_t period_us;
+    uint64_t seq;
+    bool world;
+};
+
+static struct sim_task s_tasks[SIM_MAX_TASKS];
+static struct sim_mutex s_mutexes[SIM_MAX_MUTEXES];
+static struct esp_timer s_timers[SIM_MAX_TIMERS];
+
+static int64_t s_now_us = 0;
+static int64_t s_timer_lateness_us = 0;
+static uint64_t s_cpu_cycles = 0; /* Added by sim_cpu_spend(), on top of the clock */
+static uint64_t s_seq = 0;
+static UBaseType_t s_task_number = 0;
+static TaskHandle_t s_current = NULL;
+static TaskHandle_t s_timer_task = NULL;
+static ucontext_t s_sched_ctx;
+static int s_isr_depth = 0;
+static bool s_running = false;
+
+static void fatal(const char *what)
+{
+    fprintf(stderr, "sim: %s (task %s)\n", what, s_current ? s_current->name : "<main>");
+    abort();
+}
+
+static void make_ready(TaskHandle_t task)
+{
+    task->state = TASK_READY;
+    task->ready_seq = ++s_seq;
+}
+
+static TaskHandle_t highest_ready(void)
+{
+    TaskHandle_t best = NULL;
+    for (int i = 0; i < SIM_MAX_TASKS; i++) {
+        TaskHandle_t t = &s_tasks[i];
+        if (t->state != TASK_READY) {
+            continue;
+        }
+        if (!best || t->prio > best->prio || (t->prio == best->prio && t->ready_seq < best->ready_seq)) {
+            best = t;
+        }
+    }
+    return best;
+}
+
+static void release_task(TaskHandle_t task)
+{
+    free(task->stack);
+    memset(task, 0, sizeof(*task));
+}
+
+/* Switch from the running task back to the scheduler */
+static void task_yield(void)
+{
+    TaskHandle_t self = s_current;
+    if (swapcontext(&self->ctx, &s_sched_ctx) != 0) {
+        fatal("swapcontext failed");
+    }
+}
+
+/* A task that readies a higher-priority task is preempted immediately, as on target */
+static void maybe_preempt(void)
+{
+    if (!s_current || s_isr_depth) {
+        return;
+    }
+    TaskHandle_t next = highest_ready();
+    if (next && next->prio > s_current->prio) {
+        make_ready(s_current);
+        task_yield();
+    }
+}
+
+static void task_entry(void)
+{
+    TaskHandle_t self = s_current;
+    self->fn(self->arg);
+    /* Returning from a task function is a bug on target; end the task instead */
+    fprintf(stderr, "sim: task %s returned\n", self->name);
+    self->state = TASK_DELETED;
+    task_yield();
+}
+
+static TaskHandle_t create_task(TaskFunction_t fn, const char *name, uint32_t stack_bytes, void *arg,
+                                UBaseType_t prio)
+{
+    for (int i = 0; i < SIM_MAX_TASKS; i++) {
+        TaskHandle_t t = &s_tasks[i];
+        if (t->state != TASK_FREE) {
+            continue;
+        }
+        t->stack = malloc(SIM_TASK_STACK_SIZE);
+        if (!t->stack) {
+            return NULL;
+        }
+        getcontext(&t->ctx);
+        t->ctx.uc_stack.ss_sp = t->stack;
+        t->ctx.uc_stack.ss_size = SIM_TASK_STACK_SIZE;
+        t->ctx.uc_link = NULL;
+        makecontext(&t->ctx, task_entry, 0);
+        t->fn = fn;
+        t->arg = arg;
+        snprintf(t->name, sizeof(t->name), "%s", name ? name : "");
+        t->prio = prio;
+        t->stack_bytes = stack_bytes;
+        t->number = ++s_task_number;
+        make_ready(t);
+        maybe_preempt();
+        return t;
+    }
+    return NULL;
+}
+
+static struct esp_timer *earliest_timer(bool world)
+{
+    struct esp_timer *best = NULL;
+    for (int i = 0; i < SIM_MAX_TIMERS; i++) {
+        struct esp_timer *tm = &s_timers[i];
+        if (!tm->in_use || !tm->armed || tm->world != world) {
+            continue;
+        }
+        if (!best || tm->expiry_us < best->expiry_us ||
+            (tm->expiry_us == best->expiry_us && tm->seq < best->seq)) {
+            best = tm;
+        }
+    }
+    return best;
+}
+
+static void expire(struct esp_timer *tm)
+{
+    if (tm->period_us) {
+        tm->expiry_us += tm->period_us;
+        tm->seq = ++s_seq;
+    } else {
+        tm->armed = false;
+    }
+    tm->callback(tm->arg);
+}
+
+static void esp_timer_task(void *arg)
+{
+    while (true) {
+        struct esp_timer *tm;
+        while ((tm = earliest_timer(false)) != NULL && tm->expiry_us + s_timer_lateness_us <= s_now_us) {
+            expire(tm);
+        }
+        s_current->state = TASK_TIMER_WAIT;
+        task_yield();
+    }
+}
+
+/* World timers due up to 'until', each at its own time; returns the next expiry */
+static int64_t run_world(int64_t until)
+{
+    struct esp_timer *tm;
+    while ((tm = earliest_timer(true)) != NULL && tm->expiry_us <= until) {
+        if (tm->expiry_us > s_now_us) {
+            s_now_us = tm->expiry_us;
+        }
+        expire(tm);
+    }
+    return tm ? tm->expiry_us : SIM_FOREVER;
+}
+
+/* Move tasks whose wait has ended to ready; returns the next future wake-up */
+static int64_t wake_tasks(void)
+{
+    int64_t next = SIM_FOREVER;
+    for (int i = 0; i < SIM_MAX_TASKS; i++) {
+        TaskHandle_t t = &s_tasks[i];
+        if (t->state == TASK_DELAYED || ((t->state == TASK_BLOCKED || t->state == TASK_NOTIFY_WAIT) &&
+                                         t->wake_us != SIM_FOREVER)) {
+            if (t->wake_us <= s_now_us) {
+                if (t->state == TASK_BLOCKED) {
+                    t->waiting_on = NULL;
+                    t->timed_out = true;
+                }
+                make_ready(t);
+            } else if (t->wake_us < next) {
+                next = t->wake_us;
+            }
+        }
+    }
+    if (s_timer_task && s_timer_task->state == TASK_TIMER_WAIT) {
+        struct esp_timer *tm = earliest_timer(false);
+        int64_t due = tm ? tm->expiry_us + s_timer_lateness_us : SIM_FOREVER;
+        if (due <= s_now_us) {
+            make_ready(s_timer_task);
+        } else if (due < next) {
+            next = due;
+        }
+    }
+    return next;
+}
+
+void sim_run_until(int64_t time_us)
+{
+    if (s_current || s_running) {
+        fatal("sim_run_until called from a task");
+    }
+    if (!s_timer_task) {
+        s_timer_task = create_task(esp_timer_task, "esp_timer", CONFIG_ESP_TIMER_TASK_STACK_SIZE, NULL, SIM_ESP_TIMER_PRIORITY);
+    }
+    s_running = true;
+    while (true) {
+        int64_t world = run_world(s_now_us);
+        int64_t next = wake_tasks();
+        TaskHandle_t task = highest_ready();
+        if (sim_pm_asleep() && (task || sim_pm_wake_requested())) {
+            /* Nothing runs until the wake completes; the world keeps moving meanwhile */
+            int64_t resume = sim_pm_wake(s_now_us);
+            run_world(resume);
+            s_now_us = resume;
+            sim_gpio_dispatch_pending();
+            continue;
+        }
+        if (!sim_pm_asleep() && sim_gpio_dispatch_pending()) {
+            continue;
+        }
+        if (task) {
+            s_current = task;
+            if (swapcontext(&s_sched_ctx, &task->ctx) != 0) {
+                fatal("swapcontext failed");
+            }
+            s_current = NULL;
+            if (task->state == TASK_DELETED) {
+                release_task(task);
+            }
+            continue;
+        }
+        sim_pm_idle(s_now_us, next);
+        if (world < next) {
+            next = world;
+        }
+        if (next > time_us) {
+            break;
+        }
+        s_now_us = next;
+    }
+    if (time_us > s_now_us) {
+        s_now_us = time_us;
+    }
+    s_running = false;
+}
+
+void sim_run_for(uint32_t ms)
+{
+    sim_run_until(s_now_us + (int64_t)ms * 1000);
+}
+
+int64_t sim_now_us(void)
+{
+    return s_now_us;
+}
+
+uint32_t sim_task_count(void)
+{
+    uint32_t count = 0;
+    for (int i = 0; i < SIM_MAX_TASKS; i++) {
+        if (s_tasks[i].state != TASK_FREE && &s_tasks[i] != s_timer_task) {
+            count++;
+        }
+    }
+    return count;
+}
+
+void sim_rtos_reset(void)
+{
+    if (s_current || s_running) {
+        fatal("sim_reset called from a task");
+    }
+    for (int i = 0; i < SIM_MAX_TASKS; i++) {
+        if (s_tasks[i].state != TASK_FREE) {
+            release_task(&s_tasks[i]);
+        }
+    }
+    memset(s_mutexes, 0, sizeof(s_mutexes));
+    memset(s_timers, 0, sizeof(s_timers));
+    s_timer_task = NULL;
+    s_timer_lateness_us = 0;
+    s_isr_depth = 0;
+}
+
+void sim_timer_set_world(esp_timer_handle_t timer)
+{
+    timer->world = true;
+}
+
+esp_cpu_cycle_count_t esp_cpu_get_cycle_count(void)
+{
+    return (esp_cpu_cycle_count_t)((uint64_t)s_now_us * CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ + s_cpu_cycles);
+}
+
+void sim_cpu_spend(uint32_t cycles)
+{
+    s_cpu_cycles += cycles;
+}
+
+void sim_task_busy_us(uint32_t us)
+{
+    if (!s_current || s_isr_depth) {
+        fatal("busy outside a task");
+    }
+    s_current->run_time_us += us;
+    s_now_us += us;
+}
+
+void sim_task_set_stack_free(TaskHandle_t task, uint32_t free_bytes)
+{
+    task->stack_free = free_bytes;
+}
+
+void sim_timer_set_lateness(uint32_t lateness_us)
+{
+    s_timer_lateness_us = lateness_us;
+}
+
+void sim_isr_enter(void)
+{
+    s_isr_depth++;
+}
+
+void sim_isr_exit(void)
+{
+    s_isr_depth--;
+}
+
+BaseType_t xPortInIsrContext(void)
+{
+    return s_isr_depth > 0;
+}
+
+/* Tasks */
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack_bytes, void *arg, UBaseType_t prio,
+                       TaskHandle_t *handle)
+{
+    TaskHandle_t task = create_task(fn, name, stack_bytes, arg, prio);
+    if (handle) {
+        *handle = task;
+    }
+    return task ? pdPASS : pdFAIL;
+}
+
+/* The caller's stack is far too small for host code; only its size is recorded */
+TaskHandle_t xTaskCreateStatic(TaskFunction_t fn, const char *name, uint32_t stack_bytes, void *arg,
+                               UBaseType_t prio, StackType_t *stack, StaticTask_t *tcb)
+{
+    return create_task(fn, name, stack_bytes, arg, prio);
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    if (!task || task == s_current) {
+        if (!s_current) {
+            fatal("vTaskDelete(NULL) outside a task");
+        }
+        s_current->state = TASK_DELETED;
+        task_yield();
+        return;
+    }
+    if (task->state != TASK_FREE) {
+        release_task(task);
+    }
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    int64_t wake = s_now_us + (int64_t)ticks * 1000 * portTICK_PERIOD_MS;
+    if (!s_current) {
+        sim_run_until(wake);
+        return;
+    }
+    if (ticks == 0) {
+        make_ready(s_current);
+    } else {
+        s_current->state = TASK_DELAYED;
+        s_current->wake_us = wake;
+    }
+    task_yield();
+}
+
+void sim_task_block_us(uint32_t us)
+{
+    int64_t wake = s_now_us + us;
+    if (!s_current) {
+        sim_run_until(wake);
+        return;
+    }
+    if (s_isr_depth) {
+        fatal("blocking transfer in an ISR");
+    }
+    s_current->state = TASK_DELAYED;
+    s_current->wake_us = wake;
+    task_yield();
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return (TickType_t)(s_now_us / 1000 / portTICK_PERIOD_MS);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return s_current;
+}
+
+TaskHandle_t xTaskGetHandle(const char *name)
+{
+    for (int i = 0; i < SIM_MAX_TASKS; i++) {
+        if (s_tasks[i].state != TASK_FREE && strcmp(s_tasks[i].name, name) == 0) {
+            return &s_tasks[i];
+        }
+    }
+    return NULL;
+}
+
+char *pcTaskGetName(TaskHandle_t task)
+{
+    static char main_name[] = "main";
+    task = task ? task : s_current;
+    return task ? task->name : main_name;
+}
+
+/* Host stack use says nothing about the target; the whole stack is unused unless a test says otherwise */
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task)
+{
+    task = task ? task : s_current;
+    if (!task) {
+        return 0;
+    }
+    return task->stack_free ? task->stack_free : task->stack_bytes;
+}
+
+UBaseType_t uxTaskGetNumberOfTasks(void)
+{
+    UBaseType_t count = 0;
+    for (int i = 0; i < SIM_MAX_TASKS; i++) {
+        if (s_tasks[i].state != TASK_FREE && s_tasks[i].state != TASK_DELETED) {
+            count++;
+        }
+    }
+    return count;
+}
+
+UBaseType_t uxTaskGetSystemState(TaskStatus_t *status, UBaseType_t size, configRUN_TIME_COUNTER_TYPE *total_run_time)
+{
+    if (size < uxTaskGetNumberOfTasks()) {
+        return 0;
+    }
+    UBaseType_t count = 0;
+    for (int i = 0; i < SIM_MAX_TASKS; i++) {
+        TaskHandle_t t = &s_tasks[i];
+        if (t->state == TASK_FREE || t->state == TASK_DELETED) {
+            continue;
+        }
+        status[count++] = (TaskStatus_t){
+            .xHandle = t,
+            .pcTaskName = t->name,
+            .xTaskNumber = t->number,
+            .eCurrentState = (t == s_current) ? eRunning : (t->state == TASK_READY ? eReady : eBlocked),
+            .uxCurrentPriority = t->prio,
+            .uxBasePriority = t->prio,
+            .ulRunTimeCounter = t->run_time_us,
+            .usStackHighWaterMark = uxTaskGetStackHighWaterMark(t),
+        };
+    }
+    if (total_run_time) {
+        *total_run_time = (configRUN_TIME_COUNTER_TYPE)s_now_us;
+    }
+    return count;
+}
+
+/* Task notifications, counting semantics only (ulTaskNotifyTake / xTaskNotifyGive) */
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks)
+{
+    if (!s_current || s_isr_depth) {
+        fatal("notify take outside a task");
+    }
+    if (s_current->notify_count == 0 && ticks != 0) {
+        s_current->state = TASK_NOTIFY_WAIT;
+        s_current->wake_us = (ticks == portMAX_DELAY) ? SIM_FOREVER
+                                                     : s_now_us + (int64_t)ticks * 1000 * portTICK_PERIOD_MS;
+        task_yield();
+    }
+    uint32_t count = s_current->notify_count;
+    if (count) {
+        s_current->notify_count = clear_on_exit ? 0 : count - 1;
+    }
+    return count;
+}
+
+static void notify(TaskHandle_t task)
+{
+    if (!task || task->state == TASK_FREE || task->state == TASK_DELETED) {
+        fatal("notify on invalid task");
+    }
+    task->notify_count++;
+    if (task->state == TASK_NOTIFY_WAIT) {
+        make_ready(task);
+    }
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    notify(task);
+    maybe_preempt();
+    return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *higher_priority_task_woken)
+{
+    notify(task);
+    if (higher_priority_task_woken) {
+        *higher_priority_task_woken = pdFALSE;
+    }
+}
+
+/* Mutexes */
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    for (int i = 0; i < SIM_MAX_MUTEXES; i++) {
+        if (!s_mutexes[i].in_use) {
+            memset(&s_mutexes[i], 0, sizeof(s_mutexes[i]));
+            s_mutexes[i].in_use = true;
+            return &s_mutexes[i];
+        }
+    }
+    return NULL;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutexStatic(StaticSemaphore_t *buffer)
+{
+    return buffer ? xSemaphoreCreateMutex() : NULL;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t mutex, TickType_t ticks)
+{
+    if (!mutex || !mutex->in_use) {
+        fatal("take on invalid mutex");
+    }
+    if (!mutex->held) {
+        mutex->held = true;
+        mutex->owner = s_current;
+        return pdTRUE;
+    }
+    if (mutex->owner == s_current) {
+        fatal("recursive take of a non-recursive mutex (deadlock on target)");
+    }
+    if (ticks == 0) {
+        return pdFALSE;
+    }
+    if (!s_current || s_isr_depth) {
+        fatal("blocking take outside a task");
+    }
+    s_current->state = TASK_BLOCKED;
+    s_current->waiting_on = mutex;
+    s_current->timed_out = false;
+    s_current->wake_us = (ticks == portMAX_DELAY) ? SIM_FOREVER
+                                                 : s_now_us + (int64_t)ticks * 1000 * portTICK_PERIOD_MS;
+    task_yield();
+    return s_current->timed_out ? pdFALSE : pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t mutex)
+{
+    if (!mutex || !mutex->in_use) {
+        fatal("give on invalid mutex");
+    }
+    if (!mutex->held || mutex->owner != s_current) {
+        return pdFALSE;
+    }
+    /* Hand ownership to the highest-priority, longest-waiting task */
+    TaskHandle_t next = NULL;
+    for (int i = 0; i < SIM_MAX_TASKS; i++) {
+        TaskHandle_t t = &s_tasks[i];
+        if (t->state == TASK_BLOCKED && t->waiting_on == mutex &&
+            (!next || t->prio > next->prio || (t->prio == next->prio && t->ready_seq < next->ready_seq))) {
+            next = t;
+        }
+    }
+    if (next) {
+        mutex->owner = next;
+        next->waiting_on = NULL;
+        make_ready(next);
+        maybe_preempt();
+    } else {
+        mutex->held = false;
+        mutex->owner = NULL;
+    }
+    return pdTRUE;
+}
+
+TaskHandle_t xSemaphoreGetMutexHolder(SemaphoreHandle_t mutex)
+{
+    return (mutex && mutex->held) ? mutex->owner : NULL;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t mutex)
+{
+    if (mutex) {
+        memset(mutex, 0, sizeof(*mutex));
+    }
+}
+
+/* esp_timer */
+
+int64_t esp_timer_get_time(void)
+{
+    return s_now_us;
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *create_args, esp_timer_handle_t *out_handle)
+{
+    if (!create_args || !create_args->callback || !out_handle) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (int i = 0; i < SIM_MAX_TIMERS; i++) {
+        struct esp_timer *tm = &s_timers[i];
+        if (!tm->in_use) {
+            memset(tm, 0, sizeof(*tm));
+            tm->in_use = true;
+            tm->callback = create_args->callback;
+            tm->arg = create_args->arg;
+            tm->name = create_args->name;
+            *out_handle = tm;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NO_MEM;
+}
+
+static esp_err_t arm(esp_timer_handle_t timer, uint64_t timeout_us, uint64_t period_us)
+{
+    if (!timer || !timer->in_use) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (timer->armed) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->armed = true;
+    timer->expiry_us = s_now_us + (int64_t)timeout_us;
+    timer->period_us = period_us;
+    timer->seq = ++s_seq;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us)
+{
+    return arm(timer, timeout_us, 0);
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period)
+{
+    if (period == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return arm(timer, period, period);
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer)
+{
+    if (!timer || !timer->in_use) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!timer->armed) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->armed = false;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer)
+{
+    if (!timer || !timer->in_use) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (timer->armed) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    memset(timer, 0, sizeof(*timer));
+    return ESP_OK;
+}
+
+bool esp_timer_is_active(esp_timer_handle_t timer)
+{
+    return timer && timer->in_use && timer->armed;
+}
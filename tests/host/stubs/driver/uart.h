@@ -0,0 +1,22 @@
+#pragma once
+
+/* Host stand-in for ESP-IDF driver/uart.h: the console UART is the process's stdout */
+
+#include <stddef.h>
+#include <unistd.h>
+
+typedef int uart_port_t;
+
+static inline int uart_write_bytes(uart_port_t uart_num, const void *src, size_t size)
+{
+    (void)uart_num;
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = write(STDOUT_FILENO, (const char *)src + done, size - done);
+        if (n <= 0) {
+            return -1;
+        }
+        done += (size_t)n;
+    }
+    return (int)done;
+}
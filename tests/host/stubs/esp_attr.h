@@ -0,0 +1,9 @@
+#pragma once
+
+/* Host stand-in for ESP-IDF esp_attr.h: placement attributes have no meaning on the host */
+
+#define IRAM_ATTR
+#define DRAM_ATTR
+#define RTC_NOINIT_ATTR
+/* Kept in a section of its own, which sim_power_on() scrambles as a power-on leaves RAM */
+#define __NOINIT_ATTR __attribute__((section("sim_noinit")))
@@ -0,0 +1,20 @@
+#pragma once
+
+/* Host stand-in for ESP-IDF esp_console.h: commands are accepted and ignored */
+
+#include "esp_err.h"
+
+typedef int (*esp_console_cmd_func_t)(int argc, char **argv);
+
+typedef struct {
+    const char *command;
+    const char *help;
+    const char *hint;
+    esp_console_cmd_func_t func;
+    void *argtable;
+} esp_console_cmd_t;
+
+static inline esp_err_t esp_console_cmd_register(const esp_console_cmd_t *cmd)
+{
+    return cmd ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
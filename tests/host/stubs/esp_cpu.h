@@ -0,0 +1,9 @@
+#pragma once
+
+/* Host stand-in for ESP-IDF esp_cpu.h: the cycle counter follows the virtual clock (see sim.h) */
+
+#include <stdint.h>
+
+typedef uint32_t esp_cpu_cycle_count_t;
+
+esp_cpu_cycle_count_t esp_cpu_get_cycle_count(void);
@@ -0,0 +1,13 @@
+#pragma once
+
+/* Host stand-in for ESP-IDF esp_heap_caps.h: the host heap is not budgeted, report zeros */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define MALLOC_CAP_8BIT (1 << 2)
+
+static inline size_t heap_caps_get_total_size(uint32_t caps) { return 0; }
+static inline size_t heap_caps_get_free_size(uint32_t caps) { return 0; }
+static inline size_t heap_caps_get_minimum_free_size(uint32_t caps) { return 0; }
+static inline size_t heap_caps_get_largest_free_block(uint32_t caps) { return 0; }
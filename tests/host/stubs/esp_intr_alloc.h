@@ -0,0 +1,7 @@
+#pragma once
+
+/* Host stand-in for ESP-IDF esp_intr_alloc.h */
+
+#include "esp_attr.h"
+
+#define ESP_INTR_FLAG_IRAM (1 << 10)
@@ -0,0 +1,46 @@
+#pragma once
+
+/* Host stand-in for ESP-IDF esp_log.h; set HOST_LOG=1 in the environment to see output */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef enum {
+    ESP_LOG_NONE,
+    ESP_LOG_ERROR,
+    ESP_LOG_WARN,
+    ESP_LOG_INFO,
+    ESP_LOG_DEBUG,
+    ESP_LOG_VERBOSE
+} esp_log_level_t;
+
+static inline int host_log_enabled(void)
+{
+    static int enabled = -1;
+    if (enabled < 0) {
+        const char *env = getenv("HOST_LOG");
+        enabled = (env && env[0] == '1') ? 1 : 0;
+    }
+    return enabled;
+}
+
+#define HOST_LOG_(level, tag, fmt, ...)                                   \
+    do {                                                                  \
+        if (host_log_enabled()) {                                         \
+            printf(level " (%s) " fmt "\n", tag, ##__VA_ARGS__);          \
+        }                                                                 \
+    } while (0)
+
+#define esp_log_write(level, tag, fmt, ...)                               \
+    do {                                                                  \
+        if (host_log_enabled()) {                                         \
+            printf(fmt, ##__VA_ARGS__);                                   \
+        }                                                                 \
+    } while (0)
+
+#define ESP_LOGE(tag, fmt, ...) HOST_LOG_("E", tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGW(tag, fmt, ...) HOST_LOG_("W", tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGI(tag, fmt, ...) HOST_LOG_("I", tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGD(tag, fmt, ...) HOST_LOG_("D", tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGV(tag, fmt, ...) HOST_LOG_("V", tag, fmt, ##__VA_ARGS__)
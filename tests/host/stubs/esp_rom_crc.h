@@ -0,0 +1,17 @@
+#pragma once
+
+/* Host stand-in for ESP-IDF esp_rom_crc.h: CRC-32 (IEEE), same result as the ROM routine and zlib */
+
+#include <stdint.h>
+
+static inline uint32_t esp_rom_crc32_le(uint32_t crc, uint8_t const *buf, uint32_t len)
+{
+    crc = ~crc;
+    while (len--) {
+        crc ^= *buf++;
+        for (int k = 0; k < 8; k++) {
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+        }
+    }
+    return ~crc;
+}
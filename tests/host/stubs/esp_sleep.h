@@ -0,0 +1,7 @@
+#pragma once
+
+/* Host stand-in for ESP-IDF esp_sleep.h; GPIO wake levels are set with gpio_wakeup_enable() */
+
+#include "esp_err.h"
+
+esp_err_t esp_sleep_enable_gpio_wakeup(void);
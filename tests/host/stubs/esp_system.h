@@ -0,0 +1,37 @@
+#pragma once
+
+/* Host stand-in for ESP-IDF esp_system.h */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "esp_err.h"
+
+static inline void esp_system_abort(const char *details)
+{
+    fprintf(stderr, "abort: %s\n", details);
+    abort();
+}
+
+typedef enum {
+    ESP_RST_UNKNOWN,
+    ESP_RST_POWERON,
+    ESP_RST_EXT,
+    ESP_RST_SW,
+    ESP_RST_PANIC,
+    ESP_RST_INT_WDT,
+    ESP_RST_TASK_WDT,
+    ESP_RST_WDT,
+    ESP_RST_DEEPSLEEP,
+    ESP_RST_BROWNOUT,
+    ESP_RST_SDIO,
+} esp_reset_reason_t;
+
+typedef void (*shutdown_handler_t)(void);
+
+/* Provided by the simulator, which counts restarts instead of resetting (sim_restart_count) */
+void esp_restart(void);
+/* ESP_RST_POWERON unless set with sim_set_reset_reason() */
+esp_reset_reason_t esp_reset_reason(void);
+/* esp_restart() runs them */
+esp_err_t esp_register_shutdown_handler(shutdown_handler_t handler);
+esp_err_t esp_unregister_shutdown_handler(shutdown_handler_t handler);
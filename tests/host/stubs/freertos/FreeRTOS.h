@@ -0,0 +1,33 @@
+#pragma once
+
+/* Host stand-in for FreeRTOS.h; tasks run as coroutines on the simulator's virtual clock (sim/) */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "sdkconfig.h"
+#include "esp_attr.h"
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+typedef uint8_t StackType_t;
+
+#define pdFALSE 0
+#define pdTRUE  1
+#define pdPASS  pdTRUE
+#define pdFAIL  pdFALSE
+
+#define configTICK_RATE_HZ  1000
+#define portTICK_PERIOD_MS  (1000 / configTICK_RATE_HZ)
+#define portMAX_DELAY       ((TickType_t)0xffffffffUL)
+#define pdMS_TO_TICKS(ms)   ((TickType_t)(((uint64_t)(ms) * configTICK_RATE_HZ) / 1000))
+
+/* Opaque storage for the static creation APIs; sizes match nothing in particular */
+typedef struct { uint8_t opaque[96]; } StaticTask_t;
+typedef struct { uint8_t opaque[80]; } StaticSemaphore_t;
+typedef struct { uint8_t opaque[32]; } StaticEventGroup_t;
+
+BaseType_t xPortInIsrContext(void);
+/* A task readied by the ISR runs at the simulator's next scheduling point */
+#define portYIELD_FROM_ISR(woken) ((void)(woken))
@@ -0,0 +1,5 @@
+#pragma once
+
+/* Included by components for historical reasons; software timers are not used */
+
+#include "freertos/FreeRTOS.h"
@@ -0,0 +1,36 @@
+#pragma once
+
+/* Host stand-in for ESP-IDF hal/gpio_ll.h: register access goes to the simulated pins */
+
+#include <stdint.h>
+#include "driver/gpio.h"
+
+typedef struct gpio_dev_s gpio_dev_t;
+extern gpio_dev_t GPIO;
+
+static inline int gpio_ll_get_level(gpio_dev_t *hw, uint32_t gpio_num)
+{
+    (void)hw;
+    return gpio_get_level((gpio_num_t)gpio_num);
+}
+
+static inline void gpio_ll_set_level(gpio_dev_t *hw, uint32_t gpio_num, uint32_t level)
+{
+    (void)hw;
+    gpio_set_level((gpio_num_t)gpio_num, level);
+}
+
+static inline void gpio_ll_set_intr_type(gpio_dev_t *hw, uint32_t gpio_num, gpio_int_type_t intr_type)
+{
+    (void)hw;
+    gpio_set_intr_type((gpio_num_t)gpio_num, intr_type);
+}
+
+static inline void gpio_ll_intr_disable(gpio_dev_t *hw, uint32_t gpio_num)
+{
+    (void)hw;
+    gpio_intr_disable((gpio_num_t)gpio_num);
+}
+
+/* Unlike gpio_wakeup_disable(), leaves the interrupt type alone */
+void gpio_ll_wakeup_disable(gpio_dev_t *hw, uint32_t gpio_num);
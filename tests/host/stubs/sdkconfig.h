@@ -0,0 +1,28 @@
+#pragma once
+
+/* Host build configuration, mirrors the Kconfig options the components read */
+
+#define CONFIG_TLOG_ENABLE 1
+#define CONFIG_TLOG_RING_SIZE 64
+#define CONFIG_TLOG_DRAIN_PERIOD_MS 50
+#define CONFIG_TLOG_OUTPUT_TEXT 1
+#define CONFIG_LOG_DEFAULT_LEVEL 3
+#define CONFIG_GARAGE_TRACE_ENABLE 1
+#define CONFIG_GARAGE_TRACE_RING_SIZE 4096
+#define CONFIG_GARAGE_SPAN_ENABLE 1
+#define CONFIG_GARAGE_SPAN_RING_SIZE 1024
+#define CONFIG_GARAGE_LOCK_PROFILE 1
+#define CONFIG_GARAGE_HOT_PATH_PROFILE 1
+#define CONFIG_GARAGE_TASK_PROFILE 1
+#define CONFIG_GARAGE_DOOR_ACTUATION_RETRY 1
+#define CONFIG_GARAGE_TASK_PROFILE_PERIOD_MS 10000
+#define CONFIG_GARAGE_TASK_PROFILE_HISTORY 12
+#define CONFIG_GARAGE_POWER_SAVE 1
+#define CONFIG_GARAGE_POWER_IDLE_ENTRY_MS 2000
+#define CONFIG_PM_LIGHT_SLEEP_CALLBACKS 1
+#define CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ 96
+#define CONFIG_ESP_MAIN_TASK_STACK_SIZE 3584
+#define CONFIG_ESP_TIMER_TASK_STACK_SIZE 3584
+#define CONFIG_FREERTOS_IDLE_TASK_STACKSIZE 1536
+#define CONFIG_ESP_CONSOLE_UART_NUM 0
+#define CONFIG_XTAL_FREQ 32
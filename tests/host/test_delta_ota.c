@@ -0,0 +1,348 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "unity.h"
+#include "sim.h"
+#include "esp_ota_ops.h"
+#include "delta_ota.h"
+#include "delta_encoder.h"
+
+#define SLOT_SIZE  (128 * 1024)
+#define OLD_SIZE   (96 * 1024)
+#define MOVED_AT   30000 /* 200 new bytes are inserted here */
+#define MOVED_LEN  60000
+#define TAIL_LEN   6000
+#define NEW_SIZE   (MOVED_AT + 200 + MOVED_LEN + TAIL_LEN)
+#define PATCH_MAX  (16 * 1024)
+#define BDX_BLOCK  1024
+
+static uint8_t s_old[OLD_SIZE];
+static uint8_t s_new[NEW_SIZE];
+static uint8_t s_patch[PATCH_MAX];
+static size_t s_patch_len;
+static uint8_t s_slot[SLOT_SIZE];
+
+/* Generated patch passed in by check_delta_diff.py: old image, patch, new image */
+static const char *s_files[3];
+
+static uint32_t s_rng = 1;
+
+static uint8_t next_random(void)
+{
+    s_rng ^= s_rng << 13;
+    s_rng ^= s_rng >> 17;
+    s_rng ^= s_rng << 5;
+    return (uint8_t)s_rng;
+}
+
+static const uint32_t s_head_edits[] = {100, 5000, 5001, 29000};
+static const uint32_t s_moved_edits[] = {0, 4, 8, 40000, 59999};
+
+/* A new image as a rebuild produces it: code moved by an insertion, a few addresses changed */
+static void make_images(void)
+{
+    s_rng = 1;
+    for (size_t i = 0; i < OLD_SIZE; i++) {
+        s_old[i] = next_random();
+    }
+    memcpy(s_new, s_old, MOVED_AT);
+    for (size_t i = 0; i < sizeof(s_head_edits) / sizeof(s_head_edits[0]); i++) {
+        s_new[s_head_edits[i]] ^= 0x5A;
+    }
+    for (size_t i = MOVED_AT; i < MOVED_AT + 200; i++) {
+        s_new[i] = next_random();
+    }
+    memcpy(&s_new[MOVED_AT + 200], &s_old[MOVED_AT], MOVED_LEN);
+    for (size_t i = 0; i < sizeof(s_moved_edits) / sizeof(s_moved_edits[0]); i++) {
+        s_new[MOVED_AT + 200 + s_moved_edits[i]] ^= 0xA5;
+    }
+    for (size_t i = NEW_SIZE - TAIL_LEN; i < NEW_SIZE; i++) {
+        s_new[i] = next_random();
+    }
+}
+
+static void make_patch(void)
+{
+    delta_encoder_t enc;
+    delta_encoder_begin(&enc, s_patch, sizeof(s_patch), s_old, OLD_SIZE, s_new, NEW_SIZE);
+    delta_encoder_copy(&enc, 0, MOVED_AT, s_head_edits, sizeof(s_head_edits) / sizeof(s_head_edits[0]));
+    delta_encoder_insert(&enc, 200);
+    delta_encoder_copy(&enc, MOVED_AT, MOVED_LEN, s_moved_edits, sizeof(s_moved_edits) / sizeof(s_moved_edits[0]));
+    delta_encoder_check(&enc);
+    delta_encoder_insert(&enc, TAIL_LEN);
+    s_patch_len = delta_encoder_end(&enc);
+    TEST_ASSERT_TRUE(s_patch_len <= sizeof(s_patch));
+}
+
+void setUp(void)
+{
+    sim_reset();
+    make_images();
+    make_patch();
+    sim_ota_attach(s_old, OLD_SIZE, SLOT_SIZE);
+    TEST_ASSERT_EQUAL(ESP_OK, delta_ota_init());
+}
+
+void tearDown(void)
+{
+    delta_ota_deinit();
+    sim_ota_detach();
+}
+
+/* Feeds the patch in chunks; returns the first error and how many bytes were accepted before it */
+static esp_err_t feed(const uint8_t *patch, size_t len, size_t chunk, size_t *fed)
+{
+    *fed = 0;
+    while (*fed < len) {
+        size_t n = len - *fed < chunk ? len - *fed : chunk;
+        esp_err_t ret = delta_ota_write(&patch[*fed], n);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+        *fed += n;
+    }
+    return ESP_OK;
+}
+
+static const uint8_t *read_slot(const char *label, size_t len)
+{
+    const esp_partition_t *running = esp_ota_get_running_partition();
+    const esp_partition_t *other = esp_ota_get_next_update_partition(NULL);
+    const esp_partition_t *slot = strcmp(running->label, label) == 0 ? running : other;
+    TEST_ASSERT_EQUAL(ESP_OK, esp_partition_read(slot, 0, s_slot, len));
+    return s_slot;
+}
+
+static void apply_in_chunks(size_t chunk)
+{
+    size_t fed;
+    TEST_ASSERT_EQUAL(ESP_OK, delta_ota_begin());
+    TEST_ASSERT_EQUAL(ESP_OK, feed(s_patch, s_patch_len, chunk, &fed));
+    TEST_ASSERT_EQUAL(ESP_OK, delta_ota_end());
+    TEST_ASSERT_EQUAL_STRING("ota_1", esp_ota_get_boot_partition()->label);
+    TEST_ASSERT_EQUAL_MEMORY(s_new, read_slot("ota_1", NEW_SIZE), NEW_SIZE);
+}
+
+static void test_rebuilds_image_in_inactive_slot(void)
+{
+    apply_in_chunks(BDX_BLOCK);
+
+    /* The running image is only read */
+    TEST_ASSERT_EQUAL_MEMORY(s_old, read_slot("ota_0", OLD_SIZE), OLD_SIZE);
+    TEST_ASSERT_EQUAL_STRING("ota_0", esp_ota_get_running_partition()->label);
+
+    delta_ota_status_t status;
+    delta_ota_get_status(&status);
+    TEST_ASSERT_EQUAL(DELTA_OTA_READY, status.state);
+    TEST_ASSERT_EQUAL_UINT32(s_patch_len, status.stats.patch_bytes);
+    TEST_ASSERT_EQUAL_UINT32(NEW_SIZE, status.stats.out_bytes);
+    TEST_ASSERT_EQUAL_UINT32(200 + TAIL_LEN, status.stats.inserted_bytes);
+    TEST_ASSERT_EQUAL_UINT32(9, status.stats.edits);
+    TEST_ASSERT_EQUAL_UINT32(1, status.stats.checkpoints);
+    TEST_ASSERT_TRUE(s_patch_len < NEW_SIZE / 10);
+
+    /* The new image confirms itself after the reboot */
+    sim_ota_reboot();
+    TEST_ASSERT_EQUAL_STRING("ota_1", esp_ota_get_running_partition()->label);
+    TEST_ASSERT_TRUE(sim_ota_pending_verify());
+    TEST_ASSERT_EQUAL(ESP_OK, delta_ota_confirm_running());
+    TEST_ASSERT_FALSE(sim_ota_pending_verify());
+}
+
+static void test_any_block_size_gives_the_same_image(void)
+{
+    const size_t chunks[] = {1, 7, 76, 77, 4096, PATCH_MAX};
+    for (size_t i = 0; i < sizeof(chunks) / sizeof(chunks[0]); i++) {
+        sim_ota_attach(s_old, OLD_SIZE, SLOT_SIZE);
+        apply_in_chunks(chunks[i]);
+    }
+}
+
+static void test_rejects_patch_for_another_image(void)
+{
+    s_old[OLD_SIZE / 2] ^= 1;
+    sim_ota_attach(s_old, OLD_SIZE, SLOT_SIZE);
+
+    size_t fed;
+    TEST_ASSERT_EQUAL(ESP_OK, delta_ota_begin());
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_VERSION, feed(s_patch, s_patch_len, BDX_BLOCK, &fed));
+    TEST_ASSERT_EQUAL_UINT32(0, fed);
+
+    /* Nothing was written and the boot slot is unchanged */
+    const uint8_t *slot = read_slot("ota_1", BDX_BLOCK);
+    for (size_t i = 0; i < BDX_BLOCK; i++) {
+        TEST_ASSERT_EQUAL(0xFF, slot[i]);
+    }
+    TEST_ASSERT_EQUAL_STRING("ota_0", esp_ota_get_boot_partition()->label);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, delta_ota_end());
+
+    delta_ota_status_t status;
+    delta_ota_get_status(&status);
+    TEST_ASSERT_EQUAL(DELTA_OTA_FAILED, status.state);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_VERSION, status.error);
+}
+
+static void test_corruption_is_caught_at_the_checkpoint(void)
+{
+    /* One bit of the first inserted block, as a damaged transfer would deliver it */
+    const uint8_t *insert = memmem(s_patch, s_patch_len, &s_new[MOVED_AT], 200);
+    TEST_ASSERT_NOT_NULL(insert);
+    s_patch[insert - s_patch + 10] ^= 0x01;
+
+    size_t fed;
+    TEST_ASSERT_EQUAL(ESP_OK, delta_ota_begin());
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_CRC, feed(s_patch, s_patch_len, 64, &fed));
+    /* Long before the end of the transfer */
+    TEST_ASSERT_TRUE(fed < s_patch_len / 4);
+    TEST_ASSERT_EQUAL_STRING("ota_0", esp_ota_get_boot_partition()->label);
+
+    /* Without checkpoints the final hash still catches it: here the head's edits are missing */
+    delta_encoder_t enc;
+    delta_encoder_begin(&enc, s_patch, sizeof(s_patch), s_old, OLD_SIZE, s_new, NEW_SIZE);
+    delta_encoder_copy(&enc, 0, MOVED_AT, NULL, 0);
+    delta_encoder_insert(&enc, 200);
+    delta_encoder_copy(&enc, MOVED_AT, MOVED_LEN, s_moved_edits, sizeof(s_moved_edits) / sizeof(s_moved_edits[0]));
+    delta_encoder_insert(&enc, TAIL_LEN);
+    s_patch_len = delta_encoder_end(&enc);
+    TEST_ASSERT_EQUAL(ESP_OK, delta_ota_begin());
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_CRC, feed(s_patch, s_patch_len, BDX_BLOCK, &fed));
+}
+
+static esp_err_t apply_raw(const uint8_t *records, size_t len)
+{
+    /* A valid header followed by hand-written records */
+    uint8_t patch[DELTA_PATCH_HEADER_SIZE + 32];
+    memcpy(patch, s_patch, DELTA_PATCH_HEADER_SIZE);
+    memcpy(&patch[DELTA_PATCH_HEADER_SIZE], records, len);
+    size_t fed;
+    TEST_ASSERT_EQUAL(ESP_OK, delta_ota_begin());
+    esp_err_t ret = feed(patch, DELTA_PATCH_HEADER_SIZE + len, BDX_BLOCK, &fed);
+    if (ret == ESP_OK) {
+        ret = delta_ota_end();
+    }
+    return ret;
+}
+
+static void test_malformed_patches_are_rejected(void)
+{
+    /* Beyond the old image, more edits than bytes, unknown record, overlong varint */
+    const uint8_t past_end[] = {DELTA_OP_COPY, 0x80, 0x80, 0x06, 0x10, 0x00};
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, apply_raw(past_end, sizeof(past_end)));
+    const uint8_t edits[] = {DELTA_OP_COPY, 0x00, 0x02, 0x03};
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, apply_raw(edits, sizeof(edits)));
+    const uint8_t unknown[] = {0x7E};
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, apply_raw(unknown, sizeof(unknown)));
+    const uint8_t overlong[] = {DELTA_OP_INSERT, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x01};
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, apply_raw(overlong, sizeof(overlong)));
+    /* END before the image is complete, and a patch that just stops */
+    const uint8_t early_end[] = {DELTA_OP_COPY, 0x00, 0x10, 0x00, DELTA_OP_END};
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, apply_raw(early_end, sizeof(early_end)));
+    const uint8_t truncated[] = {DELTA_OP_COPY, 0x00, 0x10, 0x00};
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, apply_raw(truncated, sizeof(truncated)));
+
+    /* Not a patch at all, and an image larger than the slot */
+    uint8_t header[DELTA_PATCH_HEADER_SIZE];
+    size_t fed;
+    memcpy(header, s_patch, sizeof(header));
+    header[0] = 'X';
+    TEST_ASSERT_EQUAL(ESP_OK, delta_ota_begin());
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_SUPPORTED, feed(header, sizeof(header), BDX_BLOCK, &fed));
+    memcpy(header, s_patch, sizeof(header));
+    header[10] = 0x10; /* New size over 1 MB */
+    TEST_ASSERT_EQUAL(ESP_OK, delta_ota_begin());
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, feed(header, sizeof(header), BDX_BLOCK, &fed));
+
+    /* Trailing bytes after END */
+    s_patch[s_patch_len++] = 0;
+    TEST_ASSERT_EQUAL(ESP_OK, delta_ota_begin());
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, feed(s_patch, s_patch_len, BDX_BLOCK, &fed));
+    TEST_ASSERT_EQUAL_STRING("ota_0", esp_ota_get_boot_partition()->label);
+}
+
+static void test_flash_error_fails_and_update_can_restart(void)
+{
+    size_t fed;
+    sim_ota_fail_writes_after(8 * 1024);
+    TEST_ASSERT_EQUAL(ESP_OK, delta_ota_begin());
+    TEST_ASSERT_EQUAL(ESP_FAIL, feed(s_patch, s_patch_len, BDX_BLOCK, &fed));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, delta_ota_write(s_patch, 1));
+
+    sim_ota_fail_writes_after(SIZE_MAX);
+    apply_in_chunks(BDX_BLOCK);
+
+    /* A second update while one is in progress is refused */
+    TEST_ASSERT_EQUAL(ESP_OK, delta_ota_begin());
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, delta_ota_begin());
+    TEST_ASSERT_EQUAL(ESP_OK, delta_ota_abort());
+}
+
+static void test_ram_does_not_grow_with_the_image(void)
+{
+    /* The applier's whole state; images and patches are streamed */
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(DELTA_PATCH_BUF_SIZE + 512, sizeof(delta_patch_t));
+}
+
+static size_t read_file(const char *path, uint8_t **data)
+{
+    FILE *f = fopen(path, "rb");
+    TEST_ASSERT_NOT_NULL(f);
+    fseek(f, 0, SEEK_END);
+    size_t len = (size_t)ftell(f);
+    fseek(f, 0, SEEK_SET);
+    *data = malloc(len);
+    TEST_ASSERT_EQUAL_UINT32(len, fread(*data, 1, len, f));
+    fclose(f);
+    return len;
+}
+
+/* tools/delta_diff.py output on two real builds; prints the applier's host throughput */
+static void test_applies_generated_patch(void)
+{
+    uint8_t *old, *patch, *new_image;
+    size_t old_len = read_file(s_files[0], &old);
+    size_t patch_len = read_file(s_files[1], &patch);
+    size_t new_len = read_file(s_files[2], &new_image);
+    size_t slot_size = (old_len > new_len ? old_len : new_len) + 4096;
+    sim_ota_attach(old, old_len, slot_size);
+
+    struct timespec start, end;
+    size_t fed;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    TEST_ASSERT_EQUAL(ESP_OK, delta_ota_begin());
+    TEST_ASSERT_EQUAL(ESP_OK, feed(patch, patch_len, BDX_BLOCK, &fed));
+    TEST_ASSERT_EQUAL(ESP_OK, delta_ota_end());
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    uint8_t *rebuilt = malloc(new_len);
+    TEST_ASSERT_EQUAL(ESP_OK, esp_partition_read(esp_ota_get_boot_partition(), 0, rebuilt, new_len));
+    TEST_ASSERT_EQUAL_MEMORY(new_image, rebuilt, new_len);
+
+    double seconds = (double)(end.tv_sec - start.tv_sec) + (double)(end.tv_nsec - start.tv_nsec) / 1e9;
+    printf("patch %zu bytes (%.1f%% of the %zu byte image), applied in %.2f ms: %.1f MB/s of image\n", patch_len,
+           100.0 * patch_len / new_len, new_len, seconds * 1e3, new_len / seconds / 1e6);
+    free(rebuilt);
+    free(old);
+    free(patch);
+    free(new_image);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_rebuilds_image_in_inactive_slot);
+    RUN_TEST(test_any_block_size_gives_the_same_image);
+    RUN_TEST(test_rejects_patch_for_another_image);
+    RUN_TEST(test_corruption_is_caught_at_the_checkpoint);
+    RUN_TEST(test_malformed_patches_are_rejected);
+    RUN_TEST(test_flash_error_fails_and_update_can_restart);
+    RUN_TEST(test_ram_does_not_grow_with_the_image);
+    if (argc > 3) {
+        s_files[0] = argv[1];
+        s_files[1] = argv[2];
+        s_files[2] = argv[3];
+        RUN_TEST(test_applies_generated_patch);
+    }
+    return UNITY_END();
+}
@@ -0,0 +1,153 @@
+#include <string.h>
+#include "unity.h"
+#include "diag_export.h"
+
+#define TEST_STREAM_BYTES 600 /* Two full frames and a partial one */
+#define CAPTURE_MAX 4096
+#define FRAME_BUF (DIAG_FRAME_HEADER + DIAG_EXPORT_PAYLOAD_MAX + DIAG_FRAME_CRC)
+
+static uint8_t s_capture[CAPTURE_MAX];
+static size_t s_captured = 0;
+
+static esp_err_t capture(const uint8_t *data, size_t len, void *ctx)
+{
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(CAPTURE_MAX, s_captured + len);
+    memcpy(&s_capture[s_captured], data, len);
+    s_captured += len;
+    return ESP_OK;
+}
+
+/* Bytes i & 0xFF of a TEST_STREAM_BYTES stream, zeros included, in chunks of at most 'len' */
+static esp_err_t read_counter(uint32_t *cursor, uint8_t *buf, size_t len, size_t *out_len, void *ctx)
+{
+    size_t n = 0;
+    while (n < len && *cursor < TEST_STREAM_BYTES) {
+        buf[n++] = (uint8_t)(*cursor)++;
+    }
+    *out_len = n;
+    return ESP_OK;
+}
+
+void setUp(void)
+{
+    s_captured = 0;
+    diag_export_set_output(capture, NULL);
+}
+
+void tearDown(void)
+{
+    diag_export_set_output(NULL, NULL);
+}
+
+static void round_trip(const uint8_t *in, size_t len)
+{
+    uint8_t wire[300];
+    uint8_t out[300];
+    size_t n = diag_cobs_encode(in, len, wire);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(len + 1 + len / 254, n);
+    TEST_ASSERT_NULL(memchr(wire, 0, n));
+    TEST_ASSERT_EQUAL_UINT32(len, diag_cobs_decode(wire, n, out));
+    TEST_ASSERT_EQUAL_MEMORY(in, out, len);
+}
+
+static void test_cobs_round_trip(void)
+{
+    uint8_t buf[260];
+    memset(buf, 0, sizeof(buf));
+    round_trip(buf, 1);
+    round_trip(buf, 8);
+
+    for (size_t i = 0; i < sizeof(buf); i++) {
+        buf[i] = (uint8_t)(i % 255 + 1);
+    }
+    round_trip(buf, 253);
+    round_trip(buf, 254);
+    round_trip(buf, 255);
+    buf[0] = 0;
+    buf[100] = 0;
+    round_trip(buf, sizeof(buf));
+
+    /* A block running past the end, and a delimiter inside a frame */
+    const uint8_t truncated[] = {0x05, 0x11, 0x22};
+    const uint8_t embedded[] = {0x03, 0x11, 0x00, 0x01};
+    uint8_t out[8];
+    TEST_ASSERT_EQUAL_UINT32(0, diag_cobs_decode(truncated, sizeof(truncated), out));
+    TEST_ASSERT_EQUAL_UINT32(0, diag_cobs_decode(embedded, sizeof(embedded), out));
+}
+
+static void test_crc32_matches_zlib(void)
+{
+    TEST_ASSERT_EQUAL_UINT32(0xCBF43926, diag_crc32((const uint8_t *)"123456789", 9));
+    TEST_ASSERT_EQUAL_UINT32(0, diag_crc32(NULL, 0));
+}
+
+static size_t next_frame(size_t *pos, uint8_t *frame)
+{
+    const uint8_t *end = memchr(&s_capture[*pos], 0, s_captured - *pos);
+    TEST_ASSERT_NOT_NULL(end);
+    size_t wire_len = (size_t)(end - &s_capture[*pos]);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(DIAG_FRAME_WIRE_MAX - 1, wire_len);
+    size_t len = diag_cobs_decode(&s_capture[*pos], wire_len, frame);
+    *pos += wire_len + 1;
+
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(DIAG_FRAME_HEADER + DIAG_FRAME_CRC, len);
+    size_t body = len - DIAG_FRAME_CRC;
+    uint32_t crc = frame[body] | frame[body + 1] << 8 | frame[body + 2] << 16 | (uint32_t)frame[body + 3] << 24;
+    TEST_ASSERT_EQUAL_UINT32(diag_crc32(frame, body), crc);
+    return body - DIAG_FRAME_HEADER;
+}
+
+static void test_stream_is_chunked_and_terminated(void)
+{
+    TEST_ASSERT_EQUAL(ESP_OK, diag_export_register_source("counter", DIAG_STREAM_EVENTS, read_counter, NULL));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, diag_export_register_source("end", DIAG_STREAM_END, read_counter, NULL));
+
+    const char *names[] = {"counter"};
+    TEST_ASSERT_EQUAL(ESP_OK, diag_export(names, 1));
+
+    /* Leading delimiter, 240 + 240 + 120 bytes, an empty last frame, the end frame */
+    TEST_ASSERT_EQUAL_UINT32(0, s_capture[0]);
+    size_t pos = 1;
+    uint8_t frame[FRAME_BUF];
+    const size_t expected_len[] = {240, 240, 120, 0};
+    const uint8_t expected_flags[] = {DIAG_FRAME_FIRST, 0, 0, DIAG_FRAME_LAST};
+    uint32_t offset = 0;
+    for (uint32_t seq = 0; seq < 4; seq++) {
+        size_t len = next_frame(&pos, frame);
+        TEST_ASSERT_EQUAL_UINT32(expected_len[seq], len);
+        TEST_ASSERT_EQUAL(DIAG_STREAM_EVENTS, frame[0]);
+        TEST_ASSERT_EQUAL(expected_flags[seq], frame[1]);
+        TEST_ASSERT_EQUAL_UINT32(seq, frame[2] | frame[3] << 8);
+        for (size_t i = 0; i < len; i++, offset++) {
+            TEST_ASSERT_EQUAL(offset & 0xFF, frame[DIAG_FRAME_HEADER + i]);
+        }
+    }
+
+    TEST_ASSERT_EQUAL_UINT32(8, next_frame(&pos, frame));
+    TEST_ASSERT_EQUAL(DIAG_STREAM_END, frame[0]);
+    TEST_ASSERT_EQUAL(DIAG_FRAME_FIRST | DIAG_FRAME_LAST, frame[1]);
+    const uint8_t summary[8] = {4, 0, 0, 0, TEST_STREAM_BYTES & 0xFF, TEST_STREAM_BYTES >> 8, 0, 0};
+    TEST_ASSERT_EQUAL_MEMORY(summary, &frame[DIAG_FRAME_HEADER], 8);
+    TEST_ASSERT_EQUAL_UINT32(s_captured, pos);
+
+    /* Every frame costs header, CRC, one COBS byte and the delimiter on top of its payload */
+    const size_t overhead = DIAG_FRAME_WIRE_MAX - DIAG_EXPORT_PAYLOAD_MAX;
+    TEST_ASSERT_EQUAL_UINT32(1 + TEST_STREAM_BYTES + 8 + 5 * overhead, s_captured);
+}
+
+static void test_unknown_source_sends_nothing(void)
+{
+    const char *names[] = {"metrics", "nope"};
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_FOUND, diag_export(names, 2));
+    TEST_ASSERT_EQUAL_UINT32(0, s_captured);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_cobs_round_trip);
+    RUN_TEST(test_crc32_matches_zlib);
+    RUN_TEST(test_stream_is_chunked_and_terminated);
+    RUN_TEST(test_unknown_source_sends_nothing);
+    return UNITY_END();
+}
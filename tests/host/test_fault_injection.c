@@ -0,0 +1,364 @@
+/*
+ * Fault-injection harness for the safety layer.
+ *
+ * Each scenario boots the door on the simulator, issues a command, injects a
+ * fault and measures, from fault onset in virtual time: time to STOPPED, time
+ * until the matching event is committed to NVS, and whether a required
+ * detection was missed. Budgets derive from the firmware's own constants, so
+ * a change that slows detection fails here instead of in the field. Pass a
+ * path to also write the measurements as JSON.
+ */
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include "unity.h"
+#include "garage_fixture.h"
+#include "garage_door_control.h"
+#include "relay_control.h"
+#include "storage_manager.h"
+#include "nvs.h"
+
+/* Firmware constants the budgets are built from */
+#define SAFETY_CHECK_INTERVAL_MS GARAGE_DOOR_SAFETY_CHECK_INTERVAL_MS
+#define MOTION_START_GRACE_MS    GARAGE_DOOR_MOTION_START_GRACE_MS
+#define DOOR_TIMEOUT_MS          GARAGE_DOOR_DEFAULT_TIMEOUT_MS
+
+#define OBSERVE_MS       45000
+#define SLOW_COMMIT_MS   200
+#define TIMER_LATENESS_MS 20
+#define NOT_SEEN         (-1)
+#define MAX_SCENARIOS    16
+
+typedef enum {
+    EXPECT_STOPPED,  /* Fault must be detected: STOPPED and the event logged */
+    EXPECT_ARRIVAL,  /* Fault must be tolerated: door reaches the end stop, no STOPPED */
+    EXPECT_REJECTED, /* Command must fail without a transition */
+} expectation_t;
+
+typedef struct {
+    const char *name;
+    uint32_t start_position; /* permille; 0 opens, 1000 closes */
+    bool inject_before_command;
+    uint32_t fault_at_ms;    /* after the command, unless injected before it */
+    void (*inject)(void);
+    expectation_t expect;
+    event_type_t event;
+    uint32_t stop_budget_ms;
+    uint32_t event_budget_ms;
+    bool event_may_be_lost;  /* NVS faults: losing the log entry is expected, not a miss */
+} scenario_t;
+
+typedef struct {
+    const char *name;
+    int64_t stop_ms;
+    int64_t event_ms;
+    uint32_t missed_detections;
+    uint32_t lost_events;
+} measurement_t;
+
+static measurement_t s_measurements[MAX_SCENARIOS];
+static size_t s_measurement_count;
+
+static int64_t s_fault_us;
+static int64_t s_stopped_us;
+static int64_t s_event_us;
+static event_type_t s_event_type;
+static bool s_event_pending;
+static event_type_t s_pending_type;
+static uint32_t s_transitions;
+
+static void on_state(door_state_t state)
+{
+    s_transitions++;
+    if (state == DOOR_STATE_STOPPED && s_stopped_us == NOT_SEEN) {
+        s_stopped_us = sim_now_us();
+    }
+}
+
+/* An event counts as logged once the blob written for it is committed */
+static void on_nvs(const char *key, const void *data, size_t length, void *ctx)
+{
+    if (key && strncmp(key, "evt_", 4) == 0 && length == sizeof(event_log_t)) {
+        const event_log_t *log = data;
+        if (log->type == EVENT_TYPE_TIMEOUT || log->type == EVENT_TYPE_OBSTRUCTION ||
+            log->type == EVENT_TYPE_NO_ACTUATION) {
+            s_pending_type = log->type;
+            s_event_pending = true;
+        }
+    } else if (!key && s_event_pending) {
+        s_event_pending = false;
+        if (s_event_us == NOT_SEEN) {
+            s_event_us = sim_now_us();
+            s_event_type = s_pending_type;
+        }
+    }
+}
+
+/* Faults */
+
+static void fault_jam(void)
+{
+    sim_door_set_jammed(true);
+}
+
+static void fault_opener_dead(void)
+{
+    sim_door_set_opener_dead(true);
+}
+
+static void fault_closed_reed_stuck(void)
+{
+    sim_gpio_stick(FIXTURE_REED_CLOSED_PIN, 0);
+}
+
+static void fault_open_reed_dead(void)
+{
+    sim_gpio_stick(FIXTURE_REED_OPEN_PIN, 1);
+}
+
+/* Deterministic contact chatter on one reed for 300 ms, then the door model takes over again */
+static void chatter(gpio_num_t pin)
+{
+    uint32_t lcg = 12345;
+    for (int elapsed = 0; elapsed < 300;) {
+        lcg = lcg * 1103515245u + 12345u;
+        int gap = 1 + (int)((lcg >> 16) % 8);
+        sim_gpio_stick(pin, (lcg >> 8) & 1);
+        sim_run_for(gap);
+        elapsed += gap;
+    }
+    sim_gpio_release(pin);
+}
+
+static void fault_chatter_departure(void)
+{
+    chatter(FIXTURE_REED_CLOSED_PIN);
+}
+
+static void fault_chatter_arrival(void)
+{
+    chatter(FIXTURE_REED_OPEN_PIN);
+}
+
+static void fault_jam_and_commit_failure(void)
+{
+    sim_door_set_jammed(true);
+    sim_nvs_inject_failure(SIM_NVS_OP_COMMIT, ESP_ERR_NVS_NOT_ENOUGH_SPACE, 1000);
+}
+
+static void fault_dead_opener_slow_flash(void)
+{
+    sim_door_set_opener_dead(true);
+    sim_nvs_set_commit_latency(SLOW_COMMIT_MS);
+}
+
+static void fault_jam_late_timers(void)
+{
+    sim_door_set_jammed(true);
+    sim_timer_set_lateness(TIMER_LATENESS_MS * 1000);
+}
+
+static void fault_dead_opener_late_timers(void)
+{
+    sim_door_set_opener_dead(true);
+    sim_timer_set_lateness(TIMER_LATENESS_MS * 1000);
+}
+
+/* A pulse already in progress makes the relay reject the command's pulse; the opener ignores it */
+static void fault_relay_busy(void)
+{
+    sim_door_set_opener_dead(true);
+    relay_activate_pulse(500);
+}
+
+/*
+ * Budgets. The safety check samples every SAFETY_CHECK_INTERVAL_MS and only
+ * declares "never left the end stop" after MOTION_START_GRACE_MS, the window
+ * before any start has been learned (every scenario boots on erased NVS), then
+ * pulses once more and waits the window again; anything the reeds cannot see
+ * is caught by the DOOR_TIMEOUT_MS operation timeout.
+ */
+#define START_BUDGET_MS   (2 * (MOTION_START_GRACE_MS + SAFETY_CHECK_INTERVAL_MS))
+#define JAM_AT_MS         3000
+#define JAM_BUDGET_MS     (DOOR_TIMEOUT_MS - JAM_AT_MS)
+
+static const scenario_t s_jam = {
+    "jam_mid_travel", 0, false, JAM_AT_MS, fault_jam,
+    EXPECT_STOPPED, EVENT_TYPE_TIMEOUT, JAM_BUDGET_MS, JAM_BUDGET_MS, false};
+static const scenario_t s_opener_dead = {
+    "opener_never_moves", 0, true, 0, fault_opener_dead,
+    EXPECT_STOPPED, EVENT_TYPE_NO_ACTUATION, START_BUDGET_MS, START_BUDGET_MS, false};
+/* A reed stuck at its end stop cannot be told from a door that did not move */
+static const scenario_t s_closed_reed_stuck = {
+    "reed_never_leaves_closed", 0, true, 0, fault_closed_reed_stuck,
+    EXPECT_STOPPED, EVENT_TYPE_NO_ACTUATION, START_BUDGET_MS, START_BUDGET_MS, false};
+static const scenario_t s_open_reed_dead = {
+    "open_reed_stuck_inactive", 0, true, 0, fault_open_reed_dead,
+    EXPECT_STOPPED, EVENT_TYPE_TIMEOUT, DOOR_TIMEOUT_MS, DOOR_TIMEOUT_MS, false};
+static const scenario_t s_chatter_departure = {
+    "reed_chatter_departure", 0, true, 0, fault_chatter_departure,
+    EXPECT_ARRIVAL, 0, 0, 0, false};
+static const scenario_t s_chatter_arrival = {
+    "reed_chatter_arrival", 0, false, FIXTURE_TRAVEL_MS - 200, fault_chatter_arrival,
+    EXPECT_ARRIVAL, 0, 0, 0, false};
+static const scenario_t s_commit_failure = {
+    "jam_with_nvs_commit_failure", 1000, false, JAM_AT_MS, fault_jam_and_commit_failure,
+    EXPECT_STOPPED, EVENT_TYPE_TIMEOUT, JAM_BUDGET_MS, 0, true};
+/* Slow flash may delay the log entry, but STOPPED by no more than its own state save */
+static const scenario_t s_slow_commit = {
+    "opener_dead_slow_nvs_commit", 0, true, 0, fault_dead_opener_slow_flash,
+    EXPECT_STOPPED, EVENT_TYPE_NO_ACTUATION, START_BUDGET_MS + SLOW_COMMIT_MS,
+    START_BUDGET_MS + 2 * SLOW_COMMIT_MS, false};
+static const scenario_t s_late_timeout = {
+    "jam_with_late_timers", 0, false, JAM_AT_MS, fault_jam_late_timers,
+    EXPECT_STOPPED, EVENT_TYPE_TIMEOUT, JAM_BUDGET_MS + TIMER_LATENESS_MS, JAM_BUDGET_MS + TIMER_LATENESS_MS, false};
+static const scenario_t s_late_start = {
+    "opener_dead_late_timers", 0, true, 0, fault_dead_opener_late_timers,
+    EXPECT_STOPPED, EVENT_TYPE_NO_ACTUATION, START_BUDGET_MS, START_BUDGET_MS, false};
+static const scenario_t s_relay_busy = {
+    "relay_rejects_pulse", 0, true, 0, fault_relay_busy,
+    EXPECT_REJECTED, 0, 0, 0, false};
+
+static int64_t since_fault_ms(int64_t at_us)
+{
+    return at_us == NOT_SEEN ? NOT_SEEN : (at_us - s_fault_us) / 1000;
+}
+
+static void run_scenario(const scenario_t *sc)
+{
+    bool opening = sc->start_position < 500;
+    door_state_t start = opening ? DOOR_STATE_CLOSED : DOOR_STATE_OPEN;
+    door_state_t target = opening ? DOOR_STATE_OPEN : DOOR_STATE_CLOSED;
+
+    sim_nvs_erase_all();
+    fixture_boot(sc->start_position);
+    TEST_ASSERT_EQUAL(start, garage_door_get_state());
+    garage_door_register_state_callback(on_state);
+    sim_nvs_set_hook(on_nvs, NULL);
+
+    s_stopped_us = NOT_SEEN;
+    s_event_us = NOT_SEEN;
+    s_event_pending = false;
+    s_transitions = 0;
+
+    if (sc->inject_before_command) {
+        s_fault_us = sim_now_us();
+        sc->inject();
+    }
+    esp_err_t ret = opening ? garage_door_open() : garage_door_close();
+    if (!sc->inject_before_command) {
+        sim_run_for(sc->fault_at_ms);
+        s_fault_us = sim_now_us();
+        sc->inject();
+    }
+    sim_run_until(s_fault_us + (int64_t)OBSERVE_MS * 1000);
+
+    measurement_t *m = &s_measurements[s_measurement_count++];
+    m->name = sc->name;
+    m->stop_ms = since_fault_ms(s_stopped_us);
+    m->event_ms = since_fault_ms(s_event_us);
+
+    switch (sc->expect) {
+        case EXPECT_STOPPED:
+            m->missed_detections = s_stopped_us == NOT_SEEN;
+            m->lost_events = s_event_us == NOT_SEEN;
+            TEST_ASSERT_EQUAL(ESP_OK, ret);
+            TEST_ASSERT_EQUAL_UINT32(0, m->missed_detections);
+            TEST_ASSERT_LESS_OR_EQUAL_UINT32(sc->stop_budget_ms, m->stop_ms);
+            if (sc->event_may_be_lost) {
+                break;
+            }
+            TEST_ASSERT_EQUAL_UINT32(0, m->lost_events);
+            TEST_ASSERT_EQUAL(sc->event, s_event_type);
+            TEST_ASSERT_LESS_OR_EQUAL_UINT32(sc->event_budget_ms, m->event_ms);
+            break;
+        case EXPECT_ARRIVAL:
+            /* A STOPPED here is a false detection */
+            TEST_ASSERT_EQUAL(ESP_OK, ret);
+            TEST_ASSERT_EQUAL_INT(NOT_SEEN, s_stopped_us);
+            TEST_ASSERT_EQUAL(target, garage_door_get_state());
+            break;
+        case EXPECT_REJECTED:
+            TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, ret);
+            TEST_ASSERT_EQUAL_UINT32(0, s_transitions);
+            TEST_ASSERT_EQUAL(start, garage_door_get_state());
+            break;
+    }
+}
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+    sim_nvs_set_hook(NULL, NULL);
+    sim_nvs_set_commit_latency(0);
+    sim_nvs_inject_failure(0, ESP_OK, 0);
+    fixture_shutdown();
+}
+
+#define SCENARIO_TEST(sc) \
+    static void test_##sc(void) { run_scenario(&s_##sc); }
+
+SCENARIO_TEST(jam)
+SCENARIO_TEST(opener_dead)
+SCENARIO_TEST(closed_reed_stuck)
+SCENARIO_TEST(open_reed_dead)
+SCENARIO_TEST(chatter_departure)
+SCENARIO_TEST(chatter_arrival)
+SCENARIO_TEST(commit_failure)
+SCENARIO_TEST(slow_commit)
+SCENARIO_TEST(late_timeout)
+SCENARIO_TEST(late_start)
+SCENARIO_TEST(relay_busy)
+
+static void report(FILE *out, bool json)
+{
+    if (json) {
+        fprintf(out, "{\n  \"suite\": \"fault_injection\",\n  \"scenarios\": [\n");
+    } else {
+        fprintf(out, "\n%-30s %12s %12s %7s %6s\n", "scenario", "to_stopped", "to_logged", "missed", "lost");
+    }
+    for (size_t i = 0; i < s_measurement_count; i++) {
+        const measurement_t *m = &s_measurements[i];
+        if (json) {
+            fprintf(out,
+                    "    {\"name\": \"%s\", \"to_stopped_ms\": %" PRId64 ", \"to_logged_ms\": %" PRId64
+                    ", \"missed_detections\": %" PRIu32 ", \"lost_events\": %" PRIu32 "}%s\n",
+                    m->name, m->stop_ms, m->event_ms, m->missed_detections, m->lost_events,
+                    i + 1 < s_measurement_count ? "," : "");
+        } else {
+            fprintf(out, "%-30s %10" PRId64 "ms %10" PRId64 "ms %7" PRIu32 " %6" PRIu32 "\n", m->name, m->stop_ms,
+                    m->event_ms, m->missed_detections, m->lost_events);
+        }
+    }
+    if (json) {
+        fprintf(out, "  ]\n}\n");
+    }
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_jam);
+    RUN_TEST(test_opener_dead);
+    RUN_TEST(test_closed_reed_stuck);
+    RUN_TEST(test_open_reed_dead);
+    RUN_TEST(test_chatter_departure);
+    RUN_TEST(test_chatter_arrival);
+    RUN_TEST(test_commit_failure);
+    RUN_TEST(test_slow_commit);
+    RUN_TEST(test_late_timeout);
+    RUN_TEST(test_late_start);
+    RUN_TEST(test_relay_busy);
+    report(stdout, false);
+    if (argc > 1) {
+        FILE *out = fopen(argv[1], "w");
+        if (out) {
+            report(out, true);
+            fclose(out);
+        }
+    }
+    return UNITY_END();
+}
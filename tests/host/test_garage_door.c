@@ -0,0 +1,438 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include "unity.h"
+#include "garage_fixture.h"
+#include "garage_door_control.h"
+#include "pulse_planner.h"
+#include "relay_control.h"
+#include "reed_switch.h"
+#include "storage_manager.h"
+
+#if CONFIG_GARAGE_FIXED_CONFIG
+#define DOOR_TIMEOUT_MS CONFIG_GARAGE_DOOR_TIMEOUT_MS
+#else
+#define DOOR_TIMEOUT_MS GARAGE_DOOR_DEFAULT_TIMEOUT_MS
+#endif
+#define MOTION_START_GRACE_MS GARAGE_DOOR_MOTION_START_GRACE_MS
+#define MOTION_START_MIN_MS   GARAGE_DOOR_MOTION_START_MIN_MS
+
+static door_state_t s_seen[16];
+static size_t s_seen_count;
+
+static void record_state(door_state_t state)
+{
+    if (s_seen_count < sizeof(s_seen) / sizeof(s_seen[0])) {
+        s_seen[s_seen_count++] = state;
+    }
+}
+
+static void boot_with_saved_state(door_state_t saved, uint32_t position_permille)
+{
+    sim_nvs_erase_all();
+    storage_init();
+    if (saved != DOOR_STATE_UNKNOWN) {
+        storage_save_door_state(saved);
+    }
+    fixture_boot(position_permille);
+    garage_door_register_state_callback(record_state);
+}
+
+static size_t count_events(event_type_t type)
+{
+    event_log_t logs[32];
+    size_t count = 0;
+    size_t matches = 0;
+    storage_get_logs(logs, 32, &count);
+    for (size_t i = 0; i < count; i++) {
+        matches += logs[i].type == type;
+    }
+    return matches;
+}
+
+void setUp(void)
+{
+    memset(s_seen, 0, sizeof(s_seen));
+    s_seen_count = 0;
+}
+
+void tearDown(void)
+{
+    fixture_shutdown();
+}
+
+static void test_boot_state_follows_reeds(void)
+{
+    boot_with_saved_state(DOOR_STATE_OPEN, 0);
+    TEST_ASSERT_EQUAL(DOOR_STATE_CLOSED, garage_door_get_state());
+    uint32_t saved = 0;
+    TEST_ASSERT_EQUAL(ESP_OK, storage_load_door_state(&saved));
+    TEST_ASSERT_EQUAL_UINT32(DOOR_STATE_CLOSED, saved);
+    fixture_shutdown();
+
+    boot_with_saved_state(DOOR_STATE_CLOSED, 1000);
+    TEST_ASSERT_EQUAL(DOOR_STATE_OPEN, garage_door_get_state());
+    fixture_shutdown();
+
+    /* A persisted motion state is never resumed */
+    boot_with_saved_state(DOOR_STATE_OPENING, 500);
+    TEST_ASSERT_EQUAL(DOOR_STATE_STOPPED, garage_door_get_state());
+    fixture_shutdown();
+
+    boot_with_saved_state(DOOR_STATE_UNKNOWN, 500);
+    TEST_ASSERT_EQUAL(DOOR_STATE_UNKNOWN, garage_door_get_state());
+}
+
+static void test_open_runs_to_open(void)
+{
+    boot_with_saved_state(DOOR_STATE_CLOSED, 0);
+
+    TEST_ASSERT_EQUAL(ESP_OK, garage_door_open());
+    TEST_ASSERT_EQUAL(DOOR_STATE_OPENING, garage_door_get_state());
+    TEST_ASSERT_EQUAL_UINT32(1, sim_gpio_get_output(FIXTURE_RELAY_PIN));
+
+    /* Still at the closed stop right after the pulse: not an obstruction */
+    sim_run_for(500);
+    TEST_ASSERT_EQUAL(DOOR_STATE_OPENING, garage_door_get_state());
+    TEST_ASSERT_EQUAL_UINT32(0, sim_gpio_get_output(FIXTURE_RELAY_PIN));
+
+    sim_run_for(FIXTURE_TRAVEL_MS);
+    TEST_ASSERT_EQUAL(DOOR_STATE_OPEN, garage_door_get_state());
+    TEST_ASSERT_EQUAL_UINT32(1000, sim_door_position());
+    TEST_ASSERT_EQUAL_UINT32(2, s_seen_count);
+    TEST_ASSERT_EQUAL(DOOR_STATE_OPENING, s_seen[0]);
+    TEST_ASSERT_EQUAL(DOOR_STATE_OPEN, s_seen[1]);
+}
+
+static void test_completed_move_is_not_timed_out(void)
+{
+    boot_with_saved_state(DOOR_STATE_OPEN, 1000);
+
+    TEST_ASSERT_EQUAL(ESP_OK, garage_door_close());
+    sim_run_for(FIXTURE_TRAVEL_MS + 1000);
+    TEST_ASSERT_EQUAL(DOOR_STATE_CLOSED, garage_door_get_state());
+
+    /* The operation timeout must not fire after the door arrived */
+    sim_run_for(DOOR_TIMEOUT_MS * 2);
+    TEST_ASSERT_EQUAL(DOOR_STATE_CLOSED, garage_door_get_state());
+    TEST_ASSERT_EQUAL_UINT32(0, count_events(EVENT_TYPE_TIMEOUT));
+}
+
+static void test_rejects_commands_from_wrong_state(void)
+{
+    boot_with_saved_state(DOOR_STATE_CLOSED, 0);
+
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, garage_door_close());
+    TEST_ASSERT_EQUAL(ESP_OK, garage_door_open());
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, garage_door_open());
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, garage_door_close());
+    TEST_ASSERT_TRUE(garage_door_is_moving());
+}
+
+static void test_jammed_door_times_out(void)
+{
+    boot_with_saved_state(DOOR_STATE_CLOSED, 0);
+
+    TEST_ASSERT_EQUAL(ESP_OK, garage_door_open());
+    sim_run_for(3000);
+    sim_door_set_jammed(true);
+
+    sim_run_for(DOOR_TIMEOUT_MS - 3000 - 100);
+    TEST_ASSERT_EQUAL(DOOR_STATE_OPENING, garage_door_get_state());
+    sim_run_for(200);
+    TEST_ASSERT_EQUAL(DOOR_STATE_STOPPED, garage_door_get_state());
+    TEST_ASSERT_EQUAL_UINT32(1, count_events(EVENT_TYPE_TIMEOUT));
+}
+
+static void test_door_that_never_moves_is_reported(void)
+{
+    boot_with_saved_state(DOOR_STATE_CLOSED, 0);
+    sim_door_set_opener_dead(true);
+    TEST_ASSERT_EQUAL_UINT32(MOTION_START_GRACE_MS, garage_door_motion_start_window_ms());
+
+    /* Nothing learned yet: the whole window, a second pulse, and the window again */
+    TEST_ASSERT_EQUAL(ESP_OK, garage_door_open());
+    sim_run_for(MOTION_START_GRACE_MS - 100);
+    TEST_ASSERT_EQUAL(DOOR_STATE_OPENING, garage_door_get_state());
+    sim_run_for(200);
+    TEST_ASSERT_EQUAL(DOOR_STATE_OPENING, garage_door_get_state());
+    TEST_ASSERT_EQUAL_UINT32(1, sim_gpio_get_output(FIXTURE_RELAY_PIN));
+    sim_run_for(MOTION_START_GRACE_MS);
+    TEST_ASSERT_EQUAL(DOOR_STATE_STOPPED, garage_door_get_state());
+    TEST_ASSERT_EQUAL_UINT32(1, count_events(EVENT_TYPE_NO_ACTUATION));
+    TEST_ASSERT_EQUAL_UINT32(0, count_events(EVENT_TYPE_OBSTRUCTION));
+}
+
+static void test_learned_start_window_detects_in_two_seconds(void)
+{
+    boot_with_saved_state(DOOR_STATE_CLOSED, 0);
+    TEST_ASSERT_EQUAL(ESP_OK, garage_door_open());
+    sim_run_for(FIXTURE_TRAVEL_MS + 1000);
+    TEST_ASSERT_EQUAL(DOOR_STATE_OPEN, garage_door_get_state());
+    /* The simulated reed releases within 300 ms of the pulse */
+    TEST_ASSERT_EQUAL_UINT32(MOTION_START_MIN_MS, garage_door_motion_start_window_ms());
+
+    /* Kept across a reboot */
+    fixture_shutdown();
+    fixture_boot(1000);
+    TEST_ASSERT_EQUAL_UINT32(MOTION_START_MIN_MS, garage_door_motion_start_window_ms());
+
+    sim_door_set_opener_dead(true);
+    int64_t start = sim_now_us();
+    TEST_ASSERT_EQUAL(ESP_OK, garage_door_close());
+    while (garage_door_get_state() == DOOR_STATE_CLOSING && sim_now_us() - start < DOOR_TIMEOUT_MS * 1000LL) {
+        sim_run_for(10);
+    }
+    uint32_t detect_ms = (uint32_t)((sim_now_us() - start) / 1000);
+    printf("no actuation reported after %lu ms\n", (unsigned long)detect_ms);
+    TEST_ASSERT_EQUAL(DOOR_STATE_STOPPED, garage_door_get_state());
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(2 * MOTION_START_MIN_MS + 200, detect_ms);
+    TEST_ASSERT_EQUAL_UINT32(1, count_events(EVENT_TYPE_NO_ACTUATION));
+}
+
+static void test_missed_pulse_is_retried(void)
+{
+    boot_with_saved_state(DOOR_STATE_CLOSED, 0);
+    sim_door_miss_pulses(1);
+
+    TEST_ASSERT_EQUAL(ESP_OK, garage_door_open());
+    sim_run_for(MOTION_START_GRACE_MS + FIXTURE_TRAVEL_MS + 1000);
+    TEST_ASSERT_EQUAL(DOOR_STATE_OPEN, garage_door_get_state());
+    TEST_ASSERT_EQUAL_UINT32(2, s_seen_count);
+    TEST_ASSERT_EQUAL_UINT32(0, count_events(EVENT_TYPE_NO_ACTUATION));
+    TEST_ASSERT_EQUAL_UINT32(0, count_events(EVENT_TYPE_TIMEOUT));
+}
+
+#if !CONFIG_GARAGE_FIXED_CONFIG
+static void test_retry_can_be_turned_off(void)
+{
+    boot_with_saved_state(DOOR_STATE_CLOSED, 0);
+    TEST_ASSERT_EQUAL(ESP_OK, garage_door_set_actuation_retry(false));
+    sim_door_miss_pulses(1);
+
+    TEST_ASSERT_EQUAL(ESP_OK, garage_door_open());
+    sim_run_for(MOTION_START_GRACE_MS + 200);
+    TEST_ASSERT_EQUAL(DOOR_STATE_STOPPED, garage_door_get_state());
+    TEST_ASSERT_EQUAL_UINT32(0, sim_gpio_get_output(FIXTURE_RELAY_PIN));
+    TEST_ASSERT_EQUAL_UINT32(1, count_events(EVENT_TYPE_NO_ACTUATION));
+    TEST_ASSERT_EQUAL(ESP_OK, garage_door_set_actuation_retry(true));
+}
+#endif
+
+static void test_planner_sequences(void)
+{
+    pulse_planner_t p;
+    pulse_planner_reset(&p, DOOR_POSITION_CLOSED);
+    TEST_ASSERT_EQUAL(1, pulse_planner_plan(&p, PLANNER_UP));
+    TEST_ASSERT_EQUAL(0, pulse_planner_plan(&p, PLANNER_STOPPED));
+    TEST_ASSERT_EQUAL(-1, pulse_planner_plan(&p, PLANNER_DOWN));
+
+    /* Up, then stopped between the stops: down is one pulse, up again three */
+    pulse_planner_on_pulse(&p);
+    TEST_ASSERT_TRUE(pulse_planner_on_reed(&p, DOOR_POSITION_BETWEEN));
+    TEST_ASSERT_EQUAL(PLANNER_UP, p.motion);
+    TEST_ASSERT_EQUAL(1, pulse_planner_plan(&p, PLANNER_STOPPED));
+    TEST_ASSERT_EQUAL(2, pulse_planner_plan(&p, PLANNER_DOWN));
+    pulse_planner_on_pulse(&p);
+    TEST_ASSERT_EQUAL(1, pulse_planner_plan(&p, PLANNER_DOWN));
+    TEST_ASSERT_EQUAL(3, pulse_planner_plan(&p, PLANNER_UP));
+
+    /* Modelled down, arriving open: the door ran the other way */
+    pulse_planner_on_pulse(&p);
+    TEST_ASSERT_EQUAL(PLANNER_DOWN, p.motion);
+    TEST_ASSERT_TRUE(!pulse_planner_on_reed(&p, DOOR_POSITION_OPEN));
+    TEST_ASSERT_EQUAL(1, pulse_planner_plan(&p, PLANNER_DOWN));
+
+    /* After a reset between the stops the direction is a guess until a reed shows it */
+    pulse_planner_reset(&p, DOOR_POSITION_BETWEEN);
+    TEST_ASSERT_EQUAL(1, pulse_planner_plan(&p, PLANNER_DOWN));
+    pulse_planner_on_pulse(&p);
+    TEST_ASSERT_EQUAL(PLANNER_MOVING, p.motion);
+    TEST_ASSERT_TRUE(pulse_planner_on_reed(&p, DOOR_POSITION_OPEN));
+    TEST_ASSERT_EQUAL(PLANNER_UP, p.last);
+
+    /* Leaving a stop on the wall button is tracked; settling drops it */
+    pulse_planner_reset(&p, DOOR_POSITION_CLOSED);
+    TEST_ASSERT_TRUE(pulse_planner_on_reed(&p, DOOR_POSITION_BETWEEN));
+    TEST_ASSERT_EQUAL(PLANNER_UP, p.motion);
+    TEST_ASSERT_EQUAL(0, pulse_planner_plan(&p, PLANNER_UP));
+    pulse_planner_settle(&p);
+    TEST_ASSERT_EQUAL(PLANNER_STOPPED, p.motion);
+    TEST_ASSERT_EQUAL(PLANNER_STOPPED, p.last);
+}
+
+static void test_stop_pulses_the_opener(void)
+{
+    boot_with_saved_state(DOOR_STATE_CLOSED, 0);
+
+    TEST_ASSERT_EQUAL(ESP_OK, garage_door_stop());
+    TEST_ASSERT_EQUAL(DOOR_STATE_CLOSED, garage_door_get_state());
+    TEST_ASSERT_EQUAL_UINT32(0, sim_gpio_get_output(FIXTURE_RELAY_PIN));
+
+    TEST_ASSERT_EQUAL(ESP_OK, garage_door_open());
+    sim_run_for(3000);
+    TEST_ASSERT_EQUAL(ESP_OK, garage_door_stop());
+    TEST_ASSERT_EQUAL(DOOR_STATE_STOPPED, garage_door_get_state());
+    TEST_ASSERT_EQUAL_UINT32(1, sim_gpio_get_output(FIXTURE_RELAY_PIN));
+    uint32_t stopped_at = sim_door_position();
+    sim_run_for(FIXTURE_TRAVEL_MS);
+    TEST_ASSERT_EQUAL(DOOR_STATE_STOPPED, garage_door_get_state());
+    TEST_ASSERT_EQUAL_UINT32(stopped_at, sim_door_position());
+    TEST_ASSERT_EQUAL(SIM_DOOR_IDLE, sim_door_motion());
+
+    /* Stopped before the relay takes another pulse: sent once it does */
+    TEST_ASSERT_EQUAL(ESP_OK, garage_door_close());
+    sim_run_for(300);
+    TEST_ASSERT_EQUAL(ESP_OK, garage_door_stop());
+    TEST_ASSERT_EQUAL(DOOR_STATE_STOPPED, garage_door_get_state());
+    TEST_ASSERT_EQUAL(SIM_DOOR_DOWN, sim_door_motion());
+    sim_run_for(1000);
+    TEST_ASSERT_EQUAL(SIM_DOOR_IDLE, sim_door_motion());
+    TEST_ASSERT_EQUAL(DOOR_STATE_STOPPED, garage_door_get_state());
+}
+
+/* Command to end stop for a door stopped halfway; 0 if it never gets there */
+static uint32_t time_to_target(bool was_opening, bool open, uint32_t *travel_left_ms)
+{
+    boot_with_saved_state(was_opening ? DOOR_STATE_CLOSED : DOOR_STATE_OPEN, was_opening ? 0 : 1000);
+    TEST_ASSERT_EQUAL(ESP_OK, was_opening ? garage_door_open() : garage_door_close());
+    sim_run_for(FIXTURE_TRAVEL_MS / 2);
+    TEST_ASSERT_EQUAL(ESP_OK, garage_door_stop());
+    sim_run_for(FIXTURE_SETTLE_MS);
+
+    uint32_t pos = sim_door_position();
+    *travel_left_ms = (open ? 1000 - pos : pos) * FIXTURE_TRAVEL_MS / 1000;
+    door_state_t target = open ? DOOR_STATE_OPEN : DOOR_STATE_CLOSED;
+    TEST_ASSERT_EQUAL(ESP_OK, open ? garage_door_open() : garage_door_close());
+    uint32_t elapsed = 0;
+    while (garage_door_get_state() != target && elapsed < DOOR_TIMEOUT_MS) {
+        sim_run_for(10);
+        elapsed += 10;
+    }
+    uint32_t timeouts = count_events(EVENT_TYPE_TIMEOUT);
+    fixture_shutdown();
+    TEST_ASSERT_EQUAL_UINT32(0, timeouts);
+    return elapsed < DOOR_TIMEOUT_MS ? elapsed : 0;
+}
+
+static void test_time_to_target_after_stop(void)
+{
+    /* Reversal is one pulse; resuming is three: away, stop, back */
+    static const struct {
+        bool was_opening;
+        bool open;
+    } cases[] = {{true, false}, {true, true}, {false, true}, {false, false}};
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        uint32_t travel_left_ms;
+        uint32_t ms = time_to_target(cases[i].was_opening, cases[i].open, &travel_left_ms);
+        printf("stopped while %-7s then %-5s: %5" PRIu32 " ms (%5" PRIu32 " ms of travel)\n",
+               cases[i].was_opening ? "opening" : "closing", cases[i].open ? "open" : "close", ms, travel_left_ms);
+        TEST_ASSERT_TRUE(ms > 0);
+        TEST_ASSERT_LESS_OR_EQUAL_UINT32(travel_left_ms + 4000, ms);
+    }
+    boot_with_saved_state(DOOR_STATE_CLOSED, 0);
+}
+
+static void test_unknown_direction_is_corrected(void)
+{
+    /* Rebooted between the stops: the opener's last direction is lost and it goes up */
+    boot_with_saved_state(DOOR_STATE_STOPPED, 500);
+    TEST_ASSERT_EQUAL(DOOR_STATE_STOPPED, garage_door_get_state());
+
+    TEST_ASSERT_EQUAL(ESP_OK, garage_door_close());
+    sim_run_for(FIXTURE_TRAVEL_MS / 2 + 1500);
+    TEST_ASSERT_EQUAL(DOOR_STATE_CLOSING, garage_door_get_state());
+    TEST_ASSERT_EQUAL(SIM_DOOR_DOWN, sim_door_motion());
+
+    uint32_t elapsed = FIXTURE_TRAVEL_MS / 2 + 1500;
+    while (garage_door_get_state() == DOOR_STATE_CLOSING && elapsed < DOOR_TIMEOUT_MS) {
+        sim_run_for(10);
+        elapsed += 10;
+    }
+    printf("closed %" PRIu32 " ms after a close that went up first\n", elapsed);
+    TEST_ASSERT_EQUAL(DOOR_STATE_CLOSED, garage_door_get_state());
+    TEST_ASSERT_EQUAL_UINT32(2, s_seen_count);
+    TEST_ASSERT_EQUAL(DOOR_STATE_CLOSING, s_seen[0]);
+    TEST_ASSERT_EQUAL(DOOR_STATE_CLOSED, s_seen[1]);
+    TEST_ASSERT_EQUAL_UINT32(0, count_events(EVENT_TYPE_OBSTRUCTION));
+}
+
+static void test_state_survives_reboot(void)
+{
+    boot_with_saved_state(DOOR_STATE_CLOSED, 0);
+    TEST_ASSERT_EQUAL(ESP_OK, garage_door_open());
+    sim_run_for(FIXTURE_TRAVEL_MS + 1000);
+    TEST_ASSERT_EQUAL(DOOR_STATE_OPEN, garage_door_get_state());
+    uint32_t position = sim_door_position();
+
+    /* Reboot without erasing NVS; the door has not moved */
+    fixture_shutdown();
+    fixture_boot(position);
+    TEST_ASSERT_EQUAL(DOOR_STATE_OPEN, garage_door_get_state());
+}
+
+static void test_callback_table_is_bounded(void)
+{
+    boot_with_saved_state(DOOR_STATE_CLOSED, 0);
+    /* record_state already holds one slot */
+    TEST_ASSERT_EQUAL(ESP_OK, garage_door_register_state_callback(record_state));
+    TEST_ASSERT_EQUAL(ESP_OK, garage_door_register_state_callback(record_state));
+    TEST_ASSERT_EQUAL(ESP_OK, garage_door_register_state_callback(record_state));
+    TEST_ASSERT_EQUAL(ESP_ERR_NO_MEM, garage_door_register_state_callback(record_state));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, garage_door_register_state_callback(NULL));
+
+    /* Deinit releases the slots */
+    fixture_shutdown();
+    fixture_boot(0);
+    TEST_ASSERT_EQUAL(ESP_OK, garage_door_register_state_callback(record_state));
+}
+
+#if CONFIG_GARAGE_FIXED_CONFIG
+/* test_garage_door_fixed: the configured constants replace the runtime configuration */
+static void test_fixed_config_cannot_change_at_runtime(void)
+{
+    boot_with_saved_state(DOOR_STATE_CLOSED, 0);
+    relay_config_t config;
+    TEST_ASSERT_EQUAL(ESP_OK, relay_get_config(&config));
+    TEST_ASSERT_EQUAL_UINT32(CONFIG_GARAGE_RELAY_PULSE_MS, config.pulse_duration_ms);
+    TEST_ASSERT_EQUAL_UINT32(CONFIG_GARAGE_RELAY_MIN_INTERVAL_MS, config.min_interval_ms);
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_SUPPORTED, relay_set_config(&config));
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_SUPPORTED, garage_door_set_timeout(DOOR_TIMEOUT_MS));
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_SUPPORTED, garage_door_set_actuation_retry(false));
+
+    /* Pins other than the configured ones are refused */
+    fixture_shutdown();
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, relay_init(FIXTURE_RELAY_PIN + 1));
+    const reed_switch_config_t swapped = {
+        .reed_closed_pin = FIXTURE_REED_OPEN_PIN,
+        .reed_open_pin = FIXTURE_REED_CLOSED_PIN,
+    };
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, reed_switch_init(&swapped));
+}
+#endif
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_boot_state_follows_reeds);
+    RUN_TEST(test_open_runs_to_open);
+    RUN_TEST(test_completed_move_is_not_timed_out);
+    RUN_TEST(test_rejects_commands_from_wrong_state);
+    RUN_TEST(test_jammed_door_times_out);
+    RUN_TEST(test_door_that_never_moves_is_reported);
+    RUN_TEST(test_learned_start_window_detects_in_two_seconds);
+    RUN_TEST(test_missed_pulse_is_retried);
+#if !CONFIG_GARAGE_FIXED_CONFIG
+    RUN_TEST(test_retry_can_be_turned_off);
+#endif
+    RUN_TEST(test_planner_sequences);
+    RUN_TEST(test_stop_pulses_the_opener);
+    RUN_TEST(test_time_to_target_after_stop);
+    RUN_TEST(test_unknown_direction_is_corrected);
+    RUN_TEST(test_state_survives_reboot);
+    RUN_TEST(test_callback_table_is_bounded);
+#if CONFIG_GARAGE_FIXED_CONFIG
+    RUN_TEST(test_fixed_config_cannot_change_at_runtime);
+#endif
+    return UNITY_END();
+}
@@ -0,0 +1,100 @@
+#include "unity.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "garage_fixture.h"
+#include "garage_door_control.h"
+#include "hot_path.h"
+
+#define TAG "test"
+#define CYCLES_PER_MS (CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ * 1000)
+
+HOT_PATH_DEFINE(work);
+
+static void run_work(uint32_t cycles)
+{
+    uint32_t begin = HOT_PATH_BEGIN();
+    sim_cpu_spend(cycles);
+    HOT_PATH_END(work, begin);
+}
+
+void setUp(void)
+{
+    sim_reset();
+    hot_path_reset();
+}
+
+void tearDown(void)
+{
+    sim_reset();
+}
+
+/* The fastest run is the warm-cache cost; everything above it counts as stall */
+static void test_stalls_are_cycles_above_the_fastest_run(void)
+{
+    run_work(1200);
+    run_work(1000);
+    run_work(5000);
+    run_work(1000);
+
+    const hot_path_t *p = hot_path_find("test/work");
+    TEST_ASSERT_NOT_NULL(p);
+    TEST_ASSERT_EQUAL_UINT32(4, p->calls);
+    TEST_ASSERT_EQUAL_UINT32(1000, p->cycles_min);
+    TEST_ASSERT_EQUAL_UINT32(5000, p->cycles_max);
+    TEST_ASSERT_EQUAL_UINT32(8200, (uint32_t)p->cycles_total);
+    TEST_ASSERT_EQUAL_UINT32(4200, (uint32_t)hot_path_stall_total(p));
+    TEST_ASSERT_EQUAL_UINT32(4000, hot_path_stall_max(p));
+
+    hot_path_reset();
+    TEST_ASSERT_EQUAL_UINT32(0, p->calls);
+    TEST_ASSERT_EQUAL_UINT32(0, hot_path_stall_max(p));
+    run_work(3000);
+    TEST_ASSERT_EQUAL_UINT32(3000, p->cycles_min);
+    TEST_ASSERT_EQUAL_UINT32(0, (uint32_t)hot_path_stall_total(p));
+}
+
+/* A full open: each timing-critical path is profiled, a slow flash commit stays outside them */
+static void test_door_cycle_profiles_each_path(void)
+{
+    fixture_boot(0);
+    sim_nvs_set_commit_latency(40);
+    hot_path_reset();
+
+    TEST_ASSERT_EQUAL(ESP_OK, garage_door_open());
+    sim_run_for(FIXTURE_TRAVEL_MS + FIXTURE_SETTLE_MS);
+    TEST_ASSERT_EQUAL(DOOR_STATE_OPEN, garage_door_get_state());
+
+    const hot_path_t *activate = hot_path_find("relay/activate");
+    const hot_path_t *pulse_end = hot_path_find("relay/pulse_end");
+    const hot_path_t *debounce = hot_path_find("reed_switch/debounce");
+    const hot_path_t *update = hot_path_find("garage_door/update_state");
+    const hot_path_t *safety = hot_path_find("garage_door/safety_check");
+    TEST_ASSERT_NOT_NULL(activate);
+    TEST_ASSERT_NOT_NULL(pulse_end);
+    TEST_ASSERT_NOT_NULL(debounce);
+    TEST_ASSERT_NOT_NULL(update);
+    TEST_ASSERT_NOT_NULL(safety);
+
+    TEST_ASSERT_EQUAL_UINT32(1, activate->calls);
+    TEST_ASSERT_EQUAL_UINT32(1, pulse_end->calls);
+    /* Leaving the closed reed and reaching the open one */
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(2, debounce->calls);
+    TEST_ASSERT_EQUAL_UINT32(2, update->calls);
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(FIXTURE_TRAVEL_MS / 100 - 2, safety->calls);
+
+    /* The commit (40 ms) and the state callbacks run after each path ends */
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(CYCLES_PER_MS, update->cycles_max);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(CYCLES_PER_MS, safety->cycles_max);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(CYCLES_PER_MS, debounce->cycles_max);
+
+    fixture_shutdown();
+    sim_nvs_set_commit_latency(0);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_stalls_are_cycles_above_the_fastest_run);
+    RUN_TEST(test_door_cycle_profiles_each_path);
+    return UNITY_END();
+}
@@ -0,0 +1,298 @@
+#include <stdio.h>
+#include <string.h>
+#include "unity.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "garage_fixture.h"
+#include "garage_door_control.h"
+#include "sensor_scheduler.h"
+#include "storage_manager.h"
+#include "liveness.h"
+
+/* Firmware constants (garage_door_control.c, liveness.c) */
+#define SAFETY_LIVENESS_MS  500
+#define HEARTBEAT_ALLOWANCE 3
+#define TICK_US             (portTICK_PERIOD_MS * 1000)
+
+typedef struct {
+    liveness_id_t id;
+    uint32_t interval_ms; /* Check-in spacing */
+    uint32_t stop_after;  /* Check-ins before the worker wedges; 0 never */
+    uint32_t busy_ms;     /* Per run between liveness_begin/end instead of check-ins */
+    uint32_t done;
+} worker_t;
+
+static uint32_t s_escalations;
+static liveness_id_t s_escalated_id;
+static liveness_action_t s_escalated_action;
+static char s_escalated_name[16];
+static int64_t s_escalated_at;
+
+static void record_escalation(liveness_id_t id, const char *name, liveness_action_t action)
+{
+    s_escalations++;
+    s_escalated_id = id;
+    s_escalated_action = action;
+    snprintf(s_escalated_name, sizeof(s_escalated_name), "%s", name);
+    s_escalated_at = sim_now_us();
+}
+
+static void worker_task(void *arg)
+{
+    worker_t *w = arg;
+    while (true) {
+        vTaskDelay(pdMS_TO_TICKS(w->interval_ms));
+        while (w->stop_after && w->done >= w->stop_after) {
+            vTaskDelay(pdMS_TO_TICKS(10));
+        }
+        if (w->busy_ms) {
+            uint32_t begin = liveness_begin();
+            vTaskDelay(pdMS_TO_TICKS(w->busy_ms));
+            liveness_end(w->id, begin);
+        } else {
+            liveness_checkin(w->id);
+        }
+        w->done++;
+    }
+}
+
+static liveness_id_t add(const char *name, uint32_t period_ms, uint32_t budget_us, liveness_action_t action)
+{
+    const liveness_desc_t desc = {.name = name, .period_ms = period_ms, .budget_us = budget_us, .action = action};
+    liveness_id_t id = -1;
+    TEST_ASSERT_EQUAL(ESP_OK, liveness_register(&desc, &id));
+    return id;
+}
+
+static liveness_stats_t stats_of(liveness_id_t id)
+{
+    liveness_stats_t st;
+    TEST_ASSERT_EQUAL(ESP_OK, liveness_get_stats(id, &st));
+    return st;
+}
+
+static void start_worker(worker_t *w)
+{
+    TEST_ASSERT_EQUAL(pdPASS, xTaskCreate(worker_task, "worker", 2048, w, 5, NULL));
+}
+
+void setUp(void)
+{
+    sim_reset();
+    s_escalations = 0;
+    s_escalated_id = -1;
+    s_escalated_name[0] = '\0';
+    TEST_ASSERT_EQUAL(ESP_OK, liveness_init(record_escalation));
+}
+
+void tearDown(void)
+{
+    liveness_deinit();
+    sim_reset();
+}
+
+static void test_checkins_within_period_are_quiet(void)
+{
+    worker_t w = {.id = add("worker", 100, 0, LIVENESS_ACTION_SAFE_STOP), .interval_ms = 60};
+    start_worker(&w);
+    sim_run_for(3000);
+
+    liveness_stats_t st = stats_of(w.id);
+    TEST_ASSERT_EQUAL_UINT32(w.done, st.checkins);
+    TEST_ASSERT_UINT32_WITHIN(1, 50, st.checkins);
+    TEST_ASSERT_EQUAL_UINT32(0, st.misses);
+    TEST_ASSERT_EQUAL_UINT32(0, st.escalations);
+    TEST_ASSERT_FALSE(st.silent);
+    TEST_ASSERT_EQUAL_UINT32(0, s_escalations);
+}
+
+static void test_silent_task_escalated_once_at_deadline(void)
+{
+    worker_t w = {.id = add("worker", 200, 0, LIVENESS_ACTION_SAFE_STOP), .interval_ms = 50, .stop_after = 10};
+    start_worker(&w);
+    while (w.done < w.stop_after) {
+        sim_run_for(1);
+    }
+    int64_t last_checkin = sim_now_us();
+    sim_run_for(5000);
+
+    /* Detected when the window closes, not at the next idle scan */
+    TEST_ASSERT_EQUAL_UINT32(1, s_escalations);
+    TEST_ASSERT_EQUAL(w.id, s_escalated_id);
+    TEST_ASSERT_EQUAL(LIVENESS_ACTION_SAFE_STOP, s_escalated_action);
+    TEST_ASSERT_EQUAL_STRING("worker", s_escalated_name);
+    TEST_ASSERT_UINT32_WITHIN(2 * TICK_US, 200000, (uint32_t)(s_escalated_at - last_checkin));
+
+    liveness_stats_t st = stats_of(w.id);
+    TEST_ASSERT_TRUE(st.silent);
+    TEST_ASSERT_EQUAL_UINT32(1, st.escalations);
+    TEST_ASSERT_EQUAL_UINT32(0, st.misses);
+    TEST_ASSERT_EQUAL_UINT32(0, sim_restart_count());
+
+    /* Checking in again ends the silence and records how late it was */
+    w.stop_after = 0;
+    sim_run_for(1100);
+    st = stats_of(w.id);
+    TEST_ASSERT_FALSE(st.silent);
+    TEST_ASSERT_EQUAL_UINT32(1, st.misses);
+    TEST_ASSERT_UINT32_WITHIN(w.interval_ms * 1000, 5000000 - 200000, st.lateness_max_us);
+}
+
+static void test_late_checkin_is_a_miss(void)
+{
+    liveness_id_t id = add("late", 100, 0, LIVENESS_ACTION_NONE);
+    sim_run_for(50);
+    liveness_checkin(id);
+    sim_run_for(140);
+    liveness_checkin(id);
+    sim_run_for(90);
+    liveness_checkin(id);
+
+    liveness_stats_t st = stats_of(id);
+    TEST_ASSERT_EQUAL_UINT32(3, st.checkins);
+    TEST_ASSERT_EQUAL_UINT32(1, st.misses);
+    TEST_ASSERT_UINT32_WITHIN(TICK_US, 40000, st.lateness_max_us);
+    /* Record only: logged, nothing stopped or rebooted */
+    TEST_ASSERT_EQUAL_UINT32(1, s_escalations);
+    TEST_ASSERT_EQUAL(LIVENESS_ACTION_NONE, s_escalated_action);
+    TEST_ASSERT_EQUAL_UINT32(0, sim_restart_count());
+}
+
+static void test_idle_entry_armed_on_demand(void)
+{
+    liveness_id_t id = add("pulse", 0, 0, LIVENESS_ACTION_REBOOT);
+    sim_run_for(5000);
+    TEST_ASSERT_EQUAL_UINT32(0, s_escalations);
+
+    /* The window starts at arming, not at the last check-in seconds ago */
+    TEST_ASSERT_EQUAL(ESP_OK, liveness_set_period(id, 300));
+    sim_run_for(290);
+    TEST_ASSERT_EQUAL_UINT32(0, s_escalations);
+    liveness_checkin(id);
+    TEST_ASSERT_EQUAL(ESP_OK, liveness_set_period(id, 0));
+    sim_run_for(2000);
+    TEST_ASSERT_EQUAL_UINT32(0, s_escalations);
+    TEST_ASSERT_EQUAL_UINT32(0, stats_of(id).misses);
+
+    TEST_ASSERT_EQUAL(ESP_OK, liveness_set_period(id, 300));
+    sim_run_for(310);
+    TEST_ASSERT_EQUAL_UINT32(1, s_escalations);
+    TEST_ASSERT_EQUAL(LIVENESS_ACTION_REBOOT, s_escalated_action);
+    TEST_ASSERT_EQUAL_UINT32(1, sim_restart_count());
+
+    /* Never registered (monitor was down at init): ignored */
+    liveness_checkin(-1);
+    liveness_end(-1, liveness_begin());
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, liveness_set_period(-1, 100));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, liveness_set_period(id, LIVENESS_MAX_PERIOD_MS + 1));
+}
+
+static void test_execution_budget(void)
+{
+    worker_t w = {.id = add("callback", 0, 10000, LIVENESS_ACTION_NONE), .interval_ms = 100, .busy_ms = 4};
+    start_worker(&w);
+    sim_run_for(1000);
+    w.busy_ms = 25;
+    sim_run_for(200);
+    w.busy_ms = 4;
+    sim_run_for(1000);
+
+    liveness_stats_t st = stats_of(w.id);
+    TEST_ASSERT_EQUAL_UINT32(w.done, st.runs);
+    TEST_ASSERT_UINT32_WITHIN(1, 2, st.overruns);
+    TEST_ASSERT_UINT32_WITHIN(TICK_US, 25000, st.exec_max_us);
+    /* Timing only, no period: never escalated */
+    TEST_ASSERT_EQUAL_UINT32(0, s_escalations);
+
+    liveness_reset_stats();
+    st = stats_of(w.id);
+    TEST_ASSERT_EQUAL_UINT32(0, st.runs);
+    TEST_ASSERT_EQUAL_UINT32(0, st.exec_max_us);
+}
+
+static void hog_timer_task(void *arg)
+{
+    /* A callback that blocks the esp_timer task: relay pulse ends and door timeouts wait behind it */
+    vTaskDelay(pdMS_TO_TICKS(10000));
+}
+
+static void test_wedged_esp_timer_task_reboots(void)
+{
+    sim_run_for(5000);
+    TEST_ASSERT_EQUAL_UINT32(0, s_escalations);
+
+    esp_timer_handle_t hog;
+    const esp_timer_create_args_t args = {.callback = hog_timer_task, .name = "hog"};
+    TEST_ASSERT_EQUAL(ESP_OK, esp_timer_create(&args, &hog));
+    esp_timer_start_once(hog, 1000);
+    int64_t wedged_at = sim_now_us();
+    sim_run_for(6000);
+
+    TEST_ASSERT_EQUAL_UINT32(1, s_escalations);
+    TEST_ASSERT_EQUAL_STRING("esp_timer", s_escalated_name);
+    TEST_ASSERT_EQUAL(LIVENESS_ACTION_REBOOT, s_escalated_action);
+    TEST_ASSERT_EQUAL_UINT32(1, sim_restart_count());
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(HEARTBEAT_ALLOWANCE * LIVENESS_TIMER_HEARTBEAT_MS * 1000 + TICK_US,
+                                     (uint32_t)(s_escalated_at - wedged_at));
+    esp_timer_delete(hog);
+}
+
+static bool s_wedge_sensor;
+
+static void wedging_sample(void *ctx)
+{
+    if (s_wedge_sensor) {
+        vTaskDelay(portMAX_DELAY);
+    }
+}
+
+/* A blocked sample starves the door's safety check on the shared sensor task; the monitor stops the door */
+static void test_starved_safety_check_stops_moving_door(void)
+{
+    liveness_deinit();
+    s_wedge_sensor = false;
+    fixture_boot(0);
+    sensor_id_t sensor;
+    const sensor_desc_t desc = {.name = "wedge", .period_ms = 250, .sample = wedging_sample};
+    TEST_ASSERT_EQUAL(ESP_OK, sensor_scheduler_register(&desc, &sensor));
+
+    TEST_ASSERT_EQUAL(ESP_OK, garage_door_open());
+    sim_run_for(3000);
+    TEST_ASSERT_EQUAL(DOOR_STATE_OPENING, garage_door_get_state());
+
+    s_wedge_sensor = true;
+    int64_t wedged_at = sim_now_us();
+    while (garage_door_get_state() == DOOR_STATE_OPENING && sim_now_us() - wedged_at < 5000000) {
+        sim_run_for(10);
+    }
+    TEST_ASSERT_EQUAL(DOOR_STATE_STOPPED, garage_door_get_state());
+    /* Wedged at most one sensor period after the last safety check, caught one window later */
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32((250 + SAFETY_LIVENESS_MS + 20) * 1000, (uint32_t)(sim_now_us() - wedged_at));
+
+    event_log_t logs[32];
+    size_t count = 0;
+    TEST_ASSERT_EQUAL(ESP_OK, storage_get_logs(logs, 32, &count));
+    bool logged = false;
+    for (size_t i = 0; i < count; i++) {
+        logged |= logs[i].type == EVENT_TYPE_LIVENESS && (logs[i].value & 0xff) == LIVENESS_ACTION_SAFE_STOP;
+    }
+    TEST_ASSERT_TRUE(logged);
+
+    s_wedge_sensor = false;
+    fixture_shutdown();
+    TEST_ASSERT_EQUAL(ESP_OK, liveness_init(record_escalation));
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_checkins_within_period_are_quiet);
+    RUN_TEST(test_silent_task_escalated_once_at_deadline);
+    RUN_TEST(test_late_checkin_is_a_miss);
+    RUN_TEST(test_idle_entry_armed_on_demand);
+    RUN_TEST(test_execution_budget);
+    RUN_TEST(test_wedged_esp_timer_task_reboots);
+    RUN_TEST(test_starved_safety_check_stops_moving_door);
+    return UNITY_END();
+}
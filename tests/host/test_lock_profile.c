@@ -0,0 +1,154 @@
+#include <string.h>
+#include "unity.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "garage_fixture.h"
+#include "garage_door_control.h"
+#include "static_alloc.h"
+#include "lock_profile.h"
+
+#define TAG "test"
+
+static SemaphoreHandle_t s_lock = NULL;
+STATIC_MUTEX_DEFINE(s_lock);
+
+typedef struct {
+    uint32_t start_ms;
+    uint32_t hold_ms;
+    bool done;
+} holder_t;
+
+static void holder_task(void *arg)
+{
+    holder_t *h = arg;
+    vTaskDelay(pdMS_TO_TICKS(h->start_ms));
+    LOCK_TAKE(s_lock);
+    if (h->hold_ms) {
+        vTaskDelay(pdMS_TO_TICKS(h->hold_ms));
+    }
+    LOCK_GIVE(s_lock);
+    h->done = true;
+    vTaskDelay(portMAX_DELAY);
+}
+
+static uint32_t count_named(const char *name)
+{
+    uint32_t count = 0;
+    for (const lock_profile_t *p = lock_profile_next(NULL); p; p = lock_profile_next(p)) {
+        count += strcmp(p->name, name) == 0;
+    }
+    return count;
+}
+
+static uint32_t total(const uint32_t *hist)
+{
+    uint32_t sum = 0;
+    for (size_t i = 0; i < LOCK_PROFILE_BUCKETS; i++) {
+        sum += hist[i];
+    }
+    return sum;
+}
+
+void setUp(void)
+{
+    sim_reset();
+    s_lock = STATIC_MUTEX_CREATE(s_lock);
+    lock_profile_reset();
+}
+
+void tearDown(void)
+{
+    vSemaphoreDelete(s_lock);
+    s_lock = NULL;
+    sim_reset();
+}
+
+static void test_hold_times_land_in_decade_buckets(void)
+{
+    holder_t holds[] = {{.start_ms = 10}, {.start_ms = 20, .hold_ms = 5}, {.start_ms = 40, .hold_ms = 50},
+                        {.start_ms = 100, .hold_ms = 500}};
+    for (size_t i = 0; i < 4; i++) {
+        TEST_ASSERT_EQUAL(pdPASS, xTaskCreate(holder_task, "holder", 2048, &holds[i], 5, NULL));
+    }
+    sim_run_for(1000);
+
+    const lock_profile_t *p = lock_profile_find("test/s_lock");
+    TEST_ASSERT_NOT_NULL(p);
+    TEST_ASSERT_EQUAL_UINT32(4, p->acquisitions);
+    TEST_ASSERT_EQUAL_UINT32(0, p->contended);
+    TEST_ASSERT_EQUAL_UINT32(4, p->wait_hist[0]);
+    const uint32_t expected[LOCK_PROFILE_BUCKETS] = {1, 0, 0, 1, 1, 1};
+    TEST_ASSERT_EQUAL_MEMORY(expected, p->hold_hist, sizeof(expected));
+    TEST_ASSERT_EQUAL_UINT32(500000, p->hold_max_us);
+    TEST_ASSERT_EQUAL_STRING("holder", p->hold_max_owner);
+}
+
+/* A high-priority task stuck behind a low-priority holder: the waiter, the holder and the wait are recorded */
+static void test_contention_records_waiter_and_holder(void)
+{
+    holder_t low = {.start_ms = 10, .hold_ms = 30};
+    holder_t high = {.start_ms = 20};
+    TEST_ASSERT_EQUAL(pdPASS, xTaskCreate(holder_task, "low", 2048, &low, 2, NULL));
+    TEST_ASSERT_EQUAL(pdPASS, xTaskCreate(holder_task, "high", 2048, &high, 9, NULL));
+    sim_run_for(100);
+    TEST_ASSERT_TRUE(low.done && high.done);
+
+    const lock_profile_t *p = lock_profile_find("test/s_lock");
+    TEST_ASSERT_EQUAL_UINT32(2, p->acquisitions);
+    TEST_ASSERT_EQUAL_UINT32(1, p->contended);
+    TEST_ASSERT_EQUAL_UINT32(20000, p->wait_max_us);
+    TEST_ASSERT_EQUAL_STRING("high", p->wait_max_waiter);
+    TEST_ASSERT_EQUAL_STRING("low", p->wait_max_holder);
+    TEST_ASSERT_EQUAL_UINT32(1, p->wait_hist[4]);
+    TEST_ASSERT_EQUAL_STRING("low", p->hold_max_owner);
+
+    lock_profile_reset();
+    TEST_ASSERT_EQUAL_UINT32(0, p->acquisitions);
+    TEST_ASSERT_EQUAL_UINT32(0, total(p->hold_hist));
+    TEST_ASSERT_EQUAL_UINT32(0, p->wait_max_us);
+}
+
+/* The door holds its state lock across the NVS commit of every transition */
+static void test_door_lock_held_across_flash_commit(void)
+{
+    fixture_boot(0);
+    sim_nvs_set_commit_latency(40);
+    lock_profile_reset();
+
+    TEST_ASSERT_EQUAL(ESP_OK, garage_door_open());
+    sim_run_for(FIXTURE_TRAVEL_MS + 2000);
+    TEST_ASSERT_EQUAL(DOOR_STATE_OPEN, garage_door_get_state());
+
+    const lock_profile_t *door = lock_profile_find("garage_door/s_state_mutex");
+    TEST_ASSERT_NOT_NULL(door);
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(2, door->acquisitions);
+    TEST_ASSERT_EQUAL_UINT32(door->acquisitions, total(door->wait_hist));
+    TEST_ASSERT_EQUAL_UINT32(door->acquisitions, total(door->hold_hist));
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(40000, door->hold_max_us);
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(2, door->hold_hist[4]);
+
+    const lock_profile_t *relay = lock_profile_find("relay/s_mutex");
+    TEST_ASSERT_NOT_NULL(relay);
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(2, relay->acquisitions);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(10, relay->hold_max_us);
+    fixture_shutdown();
+    sim_nvs_set_commit_latency(0);
+
+    /* Re-initialized components keep one record per mutex */
+    fixture_boot(0);
+    fixture_shutdown();
+    TEST_ASSERT_EQUAL_UINT32(1, count_named("garage_door/s_state_mutex"));
+    TEST_ASSERT_EQUAL_UINT32(1, count_named("sensor_sched/s_mutex"));
+    TEST_ASSERT_EQUAL_UINT32(1, count_named("liveness/s_mutex"));
+    s_lock = STATIC_MUTEX_CREATE(s_lock);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_hold_times_land_in_decade_buckets);
+    RUN_TEST(test_contention_records_waiter_and_holder);
+    RUN_TEST(test_door_lock_held_across_flash_commit);
+    return UNITY_END();
+}
@@ -0,0 +1,203 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include "unity.h"
+#include "sim.h"
+#include "nvs.h"
+#include "storage_manager.h"
+#include "matter_events.h"
+
+#define JOURNAL_SLOTS 100
+
+void setUp(void)
+{
+    sim_reset();
+    sim_nvs_erase_all();
+    TEST_ASSERT_EQUAL(ESP_OK, storage_init());
+    TEST_ASSERT_EQUAL(ESP_OK, matter_events_init());
+}
+
+void tearDown(void)
+{
+}
+
+static void log_events(uint32_t count)
+{
+    for (uint32_t i = 0; i < count; i++) {
+        TEST_ASSERT_EQUAL(ESP_OK, storage_log_event(i % 2 ? EVENT_TYPE_DOOR_CLOSED : EVENT_TYPE_DOOR_OPEN, 0));
+    }
+}
+
+static void test_journal_entries_become_matter_events(void)
+{
+    sim_run_for(1000);
+    storage_log_event(EVENT_TYPE_DOOR_OPEN, 0);
+    storage_log_event(EVENT_TYPE_TIMEOUT, 2);
+    storage_log_event(EVENT_TYPE_DOOR_CLOSED, 0);
+    storage_log_event(EVENT_TYPE_OBSTRUCTION, 3);
+    storage_log_event(EVENT_TYPE_RULE, 0x0101);
+    storage_log_event(EVENT_TYPE_COMMISSION, 0);
+    storage_log_event(EVENT_TYPE_LIVENESS, 0x0201);
+    storage_log_event(EVENT_TYPE_ERROR, -1);
+    storage_log_event(EVENT_TYPE_NO_ACTUATION, 1);
+
+    matter_event_t events[8];
+    size_t count = 0;
+    uint64_t event_min = 0;
+    TEST_ASSERT_EQUAL(ESP_OK, matter_events_read(&event_min, events, 8, &count));
+    TEST_ASSERT_EQUAL_UINT32(7, count);
+    TEST_ASSERT_EQUAL_UINT64(9, event_min);
+
+    TEST_ASSERT_EQUAL_UINT64(0, events[0].number);
+    TEST_ASSERT_EQUAL_UINT32(MATTER_CLUSTER_WINDOW_COVERING, events[0].cluster);
+    TEST_ASSERT_EQUAL_UINT32(MATTER_EVENT_MOVEMENT_STARTED, events[0].event);
+    TEST_ASSERT_EQUAL(MATTER_EVENTS_DOOR_ENDPOINT, events[0].endpoint);
+    TEST_ASSERT_EQUAL(MATTER_EVENT_PRIORITY_INFO, events[0].priority);
+    TEST_ASSERT_EQUAL_UINT32(100, events[0].data);
+    TEST_ASSERT_EQUAL_UINT32(1000, events[0].timestamp_ms);
+    TEST_ASSERT_FALSE(events[0].previous_boot);
+
+    TEST_ASSERT_EQUAL_UINT32(MATTER_EVENT_SAFETY_FAULT, events[1].event);
+    TEST_ASSERT_EQUAL(MATTER_EVENT_PRIORITY_CRITICAL, events[1].priority);
+    TEST_ASSERT_EQUAL_UINT32(MATTER_SAFETY_POSITION_FAILURE, events[1].data);
+    TEST_ASSERT_EQUAL_UINT32(0, events[2].data);
+    TEST_ASSERT_EQUAL_UINT32(MATTER_SAFETY_OBSTACLE_DETECTED, events[3].data);
+
+    /* Rule and commissioning entries have no event: numbers 4 and 5 are gaps */
+    TEST_ASSERT_EQUAL_UINT64(6, events[4].number);
+    TEST_ASSERT_EQUAL_UINT32(MATTER_CLUSTER_SOFTWARE_DIAGNOSTICS, events[4].cluster);
+    TEST_ASSERT_EQUAL(MATTER_EVENTS_ROOT_ENDPOINT, events[4].endpoint);
+    TEST_ASSERT_EQUAL_UINT32(0x0201, events[4].data);
+    TEST_ASSERT_EQUAL_UINT64(7, events[5].number);
+    TEST_ASSERT_EQUAL_UINT32(MATTER_CLUSTER_GENERAL_DIAGNOSTICS, events[5].cluster);
+    TEST_ASSERT_EQUAL_UINT32(MATTER_EVENT_HARDWARE_FAULT_CHANGE, events[5].event);
+    TEST_ASSERT_EQUAL(MATTER_EVENT_PRIORITY_CRITICAL, events[5].priority);
+    TEST_ASSERT_EQUAL_UINT32(MATTER_EVENT_SAFETY_FAULT, events[6].event);
+    TEST_ASSERT_EQUAL_UINT32(MATTER_SAFETY_FAILED_COMMUNICATION, events[6].data);
+}
+
+static void test_priming_walks_a_full_journal_once(void)
+{
+    log_events(250);
+    uint64_t next = 0;
+    TEST_ASSERT_EQUAL(ESP_OK, matter_events_next_number(&next));
+    TEST_ASSERT_EQUAL_UINT64(250, next);
+
+    /* EventMin 0 starts at the oldest retained event; chunks continue where the last one stopped */
+    matter_event_t events[16];
+    size_t count = 0;
+    size_t reads = 0;
+    uint64_t event_min = 0;
+    uint64_t expected = 250 - JOURNAL_SLOTS;
+    uint32_t lookups = sim_nvs_read_count();
+    do {
+        TEST_ASSERT_EQUAL(ESP_OK, matter_events_read(&event_min, events, 16, &count));
+        for (size_t i = 0; i < count; i++) {
+            TEST_ASSERT_EQUAL_UINT64(expected++, events[i].number);
+        }
+        reads++;
+    } while (count > 0);
+    TEST_ASSERT_EQUAL_UINT64(250, expected);
+    TEST_ASSERT_EQUAL_UINT64(next, event_min);
+
+    /* One blob per event and the sequence counter per read: nothing is staged or scanned twice */
+    lookups = sim_nvs_read_count() - lookups;
+    printf("priming %d events: %zu reads, %" PRIu32 " NVS lookups\n", JOURNAL_SLOTS, reads, lookups);
+    TEST_ASSERT_EQUAL_UINT32(JOURNAL_SLOTS + reads, lookups);
+
+    /* Up to date: the next read costs the counter only, then one new event costs one blob */
+    TEST_ASSERT_EQUAL(ESP_OK, matter_events_read(&event_min, events, 16, &count));
+    TEST_ASSERT_EQUAL_UINT32(0, count);
+    storage_log_event(EVENT_TYPE_OBSTRUCTION, 3);
+    lookups = sim_nvs_read_count();
+    TEST_ASSERT_EQUAL(ESP_OK, matter_events_read(&event_min, events, 16, &count));
+    TEST_ASSERT_EQUAL_UINT32(1, count);
+    TEST_ASSERT_EQUAL_UINT64(250, events[0].number);
+    TEST_ASSERT_EQUAL_UINT32(2, sim_nvs_read_count() - lookups);
+
+    event_min = (uint64_t)UINT32_MAX + 1;
+    TEST_ASSERT_EQUAL(ESP_OK, matter_events_read(&event_min, events, 16, &count));
+    TEST_ASSERT_EQUAL_UINT32(0, count);
+}
+
+static void test_events_before_boot_are_marked(void)
+{
+    log_events(3);
+    sim_run_for(5000);
+    sim_reset();
+    TEST_ASSERT_EQUAL(ESP_OK, storage_init());
+    TEST_ASSERT_EQUAL(ESP_OK, matter_events_init());
+    log_events(2);
+
+    matter_event_t events[8];
+    size_t count = 0;
+    uint64_t event_min = 0;
+    TEST_ASSERT_EQUAL(ESP_OK, matter_events_read(&event_min, events, 8, &count));
+    TEST_ASSERT_EQUAL_UINT32(5, count);
+    for (size_t i = 0; i < count; i++) {
+        TEST_ASSERT_EQUAL(i < 3, events[i].previous_boot);
+        TEST_ASSERT_EQUAL_UINT64(i, events[i].number);
+    }
+}
+
+/* Before sequence numbers, evt_count held the next slot and wrapped at 100 */
+static void test_wrapped_journal_from_older_firmware(void)
+{
+    nvs_handle_t handle;
+    TEST_ASSERT_EQUAL(ESP_OK, nvs_open(STORAGE_NAMESPACE, NVS_READWRITE, &handle));
+    for (uint32_t slot = 0; slot < JOURNAL_SLOTS; slot++) {
+        char key[16];
+        snprintf(key, sizeof(key), "evt_%" PRIu32, slot);
+        /* Slot 37 is the oldest: values count up from there around the ring */
+        const event_log_t log = {.type = EVENT_TYPE_RULE, .value = (int32_t)((slot + JOURNAL_SLOTS - 37) % JOURNAL_SLOTS)};
+        TEST_ASSERT_EQUAL(ESP_OK, nvs_set_blob(handle, key, &log, sizeof(log)));
+    }
+    TEST_ASSERT_EQUAL(ESP_OK, nvs_set_u32(handle, "evt_count", 37));
+
+    uint32_t oldest = 0;
+    uint32_t next = 0;
+    TEST_ASSERT_EQUAL(ESP_OK, storage_log_range(&oldest, &next));
+    TEST_ASSERT_EQUAL_UINT32(37, oldest);
+    TEST_ASSERT_EQUAL_UINT32(137, next);
+
+    static event_log_t logs[JOURNAL_SLOTS];
+    size_t count = 0;
+    TEST_ASSERT_EQUAL(ESP_OK, storage_get_logs(logs, JOURNAL_SLOTS, &count));
+    TEST_ASSERT_EQUAL_UINT32(JOURNAL_SLOTS, count);
+    for (size_t i = 0; i < count; i++) {
+        TEST_ASSERT_EQUAL_INT((int32_t)i, logs[i].value);
+    }
+
+    /* The next event overwrites the oldest and numbering carries on */
+    TEST_ASSERT_EQUAL(ESP_OK, storage_log_event(EVENT_TYPE_TIMEOUT, 2));
+    TEST_ASSERT_EQUAL(ESP_OK, storage_log_range(&oldest, &next));
+    TEST_ASSERT_EQUAL_UINT32(38, oldest);
+    TEST_ASSERT_EQUAL_UINT32(138, next);
+    matter_event_t event;
+    uint64_t event_min = 137;
+    TEST_ASSERT_EQUAL(ESP_OK, matter_events_read(&event_min, &event, 1, &count));
+    TEST_ASSERT_EQUAL_UINT32(1, count);
+    TEST_ASSERT_EQUAL_UINT64(137, event.number);
+    TEST_ASSERT_EQUAL_UINT32(MATTER_SAFETY_POSITION_FAILURE, event.data);
+}
+
+static void test_argument_checks(void)
+{
+    matter_event_t event;
+    size_t count = 0;
+    uint64_t event_min = 0;
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, matter_events_read(NULL, &event, 1, &count));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, matter_events_read(&event_min, &event, 0, &count));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, matter_events_next_number(NULL));
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_journal_entries_become_matter_events);
+    RUN_TEST(test_priming_walks_a_full_journal_once);
+    RUN_TEST(test_events_before_boot_are_marked);
+    RUN_TEST(test_wrapped_journal_from_older_firmware);
+    RUN_TEST(test_argument_checks);
+    return UNITY_END();
+}
@@ -0,0 +1,139 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include "unity.h"
+#include "metrics.h"
+
+#define THREADS     4
+#define INCREMENTS  100000
+
+#define TEST_METRICS(X)     \
+    X(COUNTER, events)      \
+    X(COUNTER, bytes)       \
+    X(GAUGE, level)
+METRICS_GROUP_DEFINE(test, TEST_METRICS)
+
+/* A second group registered by hand, sorted ahead of "test" */
+static const metric_desc_t s_alpha_descs[] = {{"hits", METRIC_COUNTER}};
+static uint32_t s_alpha_values[1];
+static metrics_group_t s_alpha = {"alpha", s_alpha_descs, s_alpha_values, 1, NULL};
+
+void setUp(void)
+{
+    metrics_register(&s_alpha);
+    metrics_reset();
+}
+
+void tearDown(void)
+{
+}
+
+static void test_group_registered_before_main(void)
+{
+    TEST_ASSERT_EQUAL_STRING("alpha", metrics_first_group()->name);
+    TEST_ASSERT_EQUAL_STRING("test", metrics_first_group()->next->name);
+    TEST_ASSERT_EQUAL_UINT32(4, metrics_count());
+
+    /* Registering twice is a no-op */
+    metrics_register(&s_alpha);
+    TEST_ASSERT_EQUAL_UINT32(4, metrics_count());
+}
+
+static void test_text_snapshot(void)
+{
+    METRIC_INC(events);
+    METRIC_ADD(bytes, 12);
+    METRIC_SET(level, 7);
+    s_alpha_values[0] = 3;
+
+    char buf[256];
+    size_t len = metrics_snapshot_text(buf, sizeof(buf));
+    TEST_ASSERT_EQUAL_STRING("alpha.hits 3\ntest.events 1\ntest.bytes 12\ntest.level 7\n", buf);
+    TEST_ASSERT_EQUAL_UINT32(strlen(buf), len);
+
+    /* A short buffer only holds complete lines */
+    len = metrics_snapshot_text(buf, 20);
+    TEST_ASSERT_EQUAL_STRING("alpha.hits 3\n", buf);
+    TEST_ASSERT_EQUAL_UINT32(13, len);
+}
+
+static void test_schema_chunks(void)
+{
+    char buf[64];
+    size_t len = 0;
+    uint32_t index = 0;
+    TEST_ASSERT_EQUAL(ESP_OK, metrics_read_schema(&index, buf, 20, &len));
+    TEST_ASSERT_EQUAL_UINT32(13, len);
+    TEST_ASSERT_EQUAL_MEMORY("alpha.hits:c;", buf, len);
+
+    /* An entry longer than the whole buffer is an error, not the end */
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, metrics_read_schema(&index, buf, 8, &len));
+    TEST_ASSERT_EQUAL_UINT32(0, len);
+    TEST_ASSERT_EQUAL_UINT32(1, index);
+
+    TEST_ASSERT_EQUAL(ESP_OK, metrics_read_schema(&index, buf, sizeof(buf), &len));
+    TEST_ASSERT_EQUAL_MEMORY("test.events:c;test.bytes:c;test.level:g;", buf, len);
+    TEST_ASSERT_EQUAL(ESP_OK, metrics_read_schema(&index, buf, sizeof(buf), &len));
+    TEST_ASSERT_EQUAL_UINT32(0, len);
+}
+
+static void test_binary_snapshot(void)
+{
+    METRIC_ADD(bytes, 0x01020304);
+    METRIC_SET(level, 9);
+
+    uint8_t buf[64];
+    TEST_ASSERT_EQUAL_UINT32(0, metrics_snapshot_binary(buf, 8 + 4 * 3));
+    size_t len = metrics_snapshot_binary(buf, sizeof(buf));
+    TEST_ASSERT_EQUAL_UINT32(8 + 4 * 4, len);
+    TEST_ASSERT_EQUAL_UINT32(METRICS_BINARY_VERSION, buf[0]);
+    TEST_ASSERT_EQUAL_UINT32(4, buf[2] | (buf[3] << 8));
+
+    uint32_t hash = (uint32_t)buf[4] | (uint32_t)buf[5] << 8 | (uint32_t)buf[6] << 16 | (uint32_t)buf[7] << 24;
+    TEST_ASSERT_EQUAL_UINT32(metrics_schema_hash(), hash);
+
+    const uint8_t bytes_le[4] = {0x04, 0x03, 0x02, 0x01};
+    TEST_ASSERT_EQUAL_MEMORY(bytes_le, &buf[8 + 4 * 2], 4);
+    TEST_ASSERT_EQUAL_UINT32(9, buf[8 + 4 * 3]);
+}
+
+static void test_reset_keeps_gauges(void)
+{
+    METRIC_INC(events);
+    METRIC_SET(level, 5);
+    metrics_reset();
+    TEST_ASSERT_EQUAL_UINT32(0, METRIC_GET(events));
+    TEST_ASSERT_EQUAL_UINT32(5, METRIC_GET(level));
+}
+
+static void *increment_thread(void *arg)
+{
+    for (int i = 0; i < INCREMENTS; i++) {
+        METRIC_INC(events);
+    }
+    return NULL;
+}
+
+static void test_concurrent_increments_are_not_lost(void)
+{
+    pthread_t threads[THREADS];
+    for (int i = 0; i < THREADS; i++) {
+        pthread_create(&threads[i], NULL, increment_thread, NULL);
+    }
+    for (int i = 0; i < THREADS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    TEST_ASSERT_EQUAL_UINT32(THREADS * INCREMENTS, METRIC_GET(events));
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_group_registered_before_main);
+    RUN_TEST(test_text_snapshot);
+    RUN_TEST(test_schema_chunks);
+    RUN_TEST(test_binary_snapshot);
+    RUN_TEST(test_reset_keeps_gauges);
+    RUN_TEST(test_concurrent_increments_are_not_lost);
+    return UNITY_END();
+}
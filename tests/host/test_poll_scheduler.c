@@ -0,0 +1,257 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include "unity.h"
+#include "poll_scheduler.h"
+
+#define LATENCY_BUDGET_MS 500
+#define SIM_TICK_MS       10
+
+/* Stand-in radio: records period changes and counts polls in simulated time */
+typedef struct {
+    uint32_t period_ms;
+    uint32_t changes;
+    uint32_t next_poll_ms;
+    uint64_t polls;
+    uint32_t worst_wait_ms;
+    bool fail_next;
+} fake_radio_t;
+
+static fake_radio_t s_radio;
+
+static esp_err_t fake_set_poll_period(uint32_t period_ms, void *ctx)
+{
+    fake_radio_t *radio = (fake_radio_t *)ctx;
+    if (radio->fail_next) {
+        radio->fail_next = false;
+        return ESP_FAIL;
+    }
+    radio->period_ms = period_ms;
+    radio->changes++;
+    return ESP_OK;
+}
+
+static void fake_radio_advance(fake_radio_t *radio, uint32_t now_ms)
+{
+    /* A poll is due every period; a shorter new period takes effect at the next poll */
+    while ((int32_t)(now_ms - radio->next_poll_ms) >= 0) {
+        radio->polls++;
+        if (radio->period_ms > radio->worst_wait_ms) {
+            radio->worst_wait_ms = radio->period_ms;
+        }
+        radio->next_poll_ms += radio->period_ms;
+    }
+}
+
+static void start(const poll_policy_t *policy, uint32_t now_ms)
+{
+    const poll_radio_t radio = {.set_poll_period = fake_set_poll_period, .ctx = &s_radio};
+    TEST_ASSERT_EQUAL(ESP_OK, poll_scheduler_init(policy, &radio, now_ms));
+}
+
+void setUp(void)
+{
+    memset(&s_radio, 0, sizeof(s_radio));
+}
+
+void tearDown(void)
+{
+    poll_scheduler_deinit();
+}
+
+static void test_init_uses_idle_period(void)
+{
+    poll_policy_t policy;
+    poll_scheduler_get_default_policy(&policy);
+    start(&policy, 0);
+
+    TEST_ASSERT_EQUAL(POLL_MODE_IDLE, poll_scheduler_get_mode());
+    TEST_ASSERT_EQUAL_UINT32(policy.idle_period_ms, s_radio.period_ms);
+    TEST_ASSERT_EQUAL_UINT32(1, s_radio.changes);
+}
+
+static void test_rejects_invalid_policy(void)
+{
+    poll_policy_t policy = {.idle_period_ms = 100, .active_period_ms = 200, .activity_window_ms = 0};
+    const poll_radio_t radio = {.set_poll_period = fake_set_poll_period, .ctx = &s_radio};
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, poll_scheduler_init(&policy, &radio, 0));
+    policy.active_period_ms = 0;
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, poll_scheduler_init(&policy, &radio, 0));
+}
+
+static void test_motion_holds_fast_window(void)
+{
+    poll_policy_t policy;
+    poll_scheduler_get_default_policy(&policy);
+    start(&policy, 1000);
+
+    poll_scheduler_on_door_state(DOOR_STATE_OPENING, 1000);
+    TEST_ASSERT_EQUAL(POLL_MODE_ACTIVE, poll_scheduler_get_mode());
+    TEST_ASSERT_EQUAL_UINT32(policy.active_period_ms, s_radio.period_ms);
+
+    /* Still moving long after the activity window would have expired */
+    uint32_t late = 1000 + policy.activity_window_ms * 3;
+    poll_scheduler_tick(late);
+    TEST_ASSERT_EQUAL(POLL_MODE_ACTIVE, poll_scheduler_get_mode());
+
+    /* Reaching the end stop restarts the window, then it expires */
+    poll_scheduler_on_door_state(DOOR_STATE_OPEN, late);
+    TEST_ASSERT_EQUAL(POLL_MODE_ACTIVE, poll_scheduler_get_mode());
+    TEST_ASSERT_EQUAL_UINT32(policy.activity_window_ms, poll_scheduler_tick(late));
+    poll_scheduler_tick(late + policy.activity_window_ms - 1);
+    TEST_ASSERT_EQUAL(POLL_MODE_ACTIVE, poll_scheduler_get_mode());
+    poll_scheduler_tick(late + policy.activity_window_ms);
+    TEST_ASSERT_EQUAL(POLL_MODE_IDLE, poll_scheduler_get_mode());
+    TEST_ASSERT_EQUAL_UINT32(policy.idle_period_ms, s_radio.period_ms);
+}
+
+static void test_command_and_local_activity_open_window(void)
+{
+    poll_policy_t policy;
+    poll_scheduler_get_default_policy(&policy);
+    start(&policy, 0);
+
+    poll_scheduler_on_command(5000);
+    TEST_ASSERT_EQUAL(POLL_MODE_ACTIVE, poll_scheduler_get_mode());
+    poll_scheduler_tick(5000 + policy.activity_window_ms);
+    TEST_ASSERT_EQUAL(POLL_MODE_IDLE, poll_scheduler_get_mode());
+
+    poll_scheduler_on_local_activity(100000);
+    TEST_ASSERT_EQUAL(POLL_MODE_ACTIVE, poll_scheduler_get_mode());
+
+    /* An earlier event never shortens a window that is already open */
+    poll_scheduler_on_local_activity(90000);
+    poll_scheduler_tick(100000 + policy.activity_window_ms - 1);
+    TEST_ASSERT_EQUAL(POLL_MODE_ACTIVE, poll_scheduler_get_mode());
+
+    /* Only mode changes reach the radio */
+    TEST_ASSERT_EQUAL_UINT32(4, s_radio.changes);
+}
+
+static void test_radio_failure_is_retried(void)
+{
+    poll_policy_t policy;
+    poll_scheduler_get_default_policy(&policy);
+    start(&policy, 0);
+
+    s_radio.fail_next = true;
+    poll_scheduler_on_command(10);
+    TEST_ASSERT_EQUAL(POLL_MODE_IDLE, poll_scheduler_get_mode());
+    TEST_ASSERT_EQUAL_UINT32(policy.idle_period_ms, s_radio.period_ms);
+
+    poll_scheduler_tick(20);
+    TEST_ASSERT_EQUAL(POLL_MODE_ACTIVE, poll_scheduler_get_mode());
+    TEST_ASSERT_EQUAL_UINT32(policy.active_period_ms, s_radio.period_ms);
+}
+
+static void test_window_survives_clock_wrap(void)
+{
+    poll_policy_t policy;
+    poll_scheduler_get_default_policy(&policy);
+    uint32_t now = UINT32_MAX - 1000;
+    start(&policy, now);
+
+    poll_scheduler_on_command(now);
+    poll_scheduler_tick(now + 2000); /* wrapped */
+    TEST_ASSERT_EQUAL(POLL_MODE_ACTIVE, poll_scheduler_get_mode());
+    poll_scheduler_tick(now + policy.activity_window_ms);
+    TEST_ASSERT_EQUAL(POLL_MODE_IDLE, poll_scheduler_get_mode());
+}
+
+static void test_projection_math(void)
+{
+    const poll_policy_t policy = {
+        .idle_period_ms = 1000,
+        .active_period_ms = 100,
+        .activity_window_ms = 10000,
+        .radio_on_us = 5000,
+    };
+    const poll_traffic_t traffic = {
+        .door_cycles_per_day = 4,
+        .travel_time_ms = 15000,
+        .commands_per_day = 2,
+        .local_events_per_day = 2,
+    };
+    poll_projection_t proj;
+    TEST_ASSERT_EQUAL(ESP_OK, poll_scheduler_project(&policy, &traffic, &proj));
+
+    /* 4 * 25 s + 4 * 10 s = 140 s active; 86260 s idle */
+    TEST_ASSERT_EQUAL_UINT32(140000, proj.active_ms_per_day);
+    TEST_ASSERT_EQUAL_UINT32(1400 + 86260, proj.polls_per_day);
+    /* 87660 polls * 5 ms = 438.3 s radio on per day */
+    TEST_ASSERT_EQUAL_UINT32(5072, proj.duty_cycle_ppm);
+    TEST_ASSERT_EQUAL_UINT32(1005, proj.idle_latency_ms);
+    TEST_ASSERT_EQUAL_UINT32(105, proj.active_latency_ms);
+}
+
+/* Drive a simulated day through the scheduler and compare with the projection */
+static void test_simulated_day_matches_projection(void)
+{
+    poll_policy_t policy;
+    poll_scheduler_get_default_policy(&policy);
+    const poll_traffic_t traffic = {
+        .door_cycles_per_day = 6,
+        .travel_time_ms = 14000,
+        .commands_per_day = 0,
+        .local_events_per_day = 0,
+    };
+    start(&policy, 0);
+    s_radio.next_poll_ms = s_radio.period_ms;
+
+    const uint32_t day_ms = 86400000;
+    const uint32_t spacing_ms = day_ms / traffic.door_cycles_per_day;
+    for (uint32_t now = 0; now < day_ms; now += SIM_TICK_MS) {
+        uint32_t phase = now % spacing_ms;
+        uint32_t cycle = now / spacing_ms;
+        if (phase == spacing_ms / 2) {
+            poll_scheduler_on_door_state((cycle & 1) ? DOOR_STATE_CLOSING : DOOR_STATE_OPENING, now);
+        } else if (phase == spacing_ms / 2 + traffic.travel_time_ms) {
+            poll_scheduler_on_door_state((cycle & 1) ? DOOR_STATE_CLOSED : DOOR_STATE_OPEN, now);
+        }
+        poll_scheduler_tick(now);
+        fake_radio_advance(&s_radio, now);
+    }
+
+    poll_projection_t proj;
+    TEST_ASSERT_EQUAL(ESP_OK, poll_scheduler_project(&policy, &traffic, &proj));
+
+    uint64_t measured_ppm = s_radio.polls * policy.radio_on_us * 1000 / 86400000ULL;
+    printf("policy idle=%" PRIu32 "ms active=%" PRIu32 "ms window=%" PRIu32 "ms: "
+           "projected %" PRIu32 " ppm, simulated %" PRIu64 " ppm, worst-case latency idle %" PRIu32
+           "ms / active %" PRIu32 "ms (budget %dms)\n",
+           policy.idle_period_ms, policy.active_period_ms, policy.activity_window_ms, proj.duty_cycle_ppm,
+           measured_ppm, proj.idle_latency_ms, proj.active_latency_ms, LATENCY_BUDGET_MS);
+
+    /* Projection is an upper bound and within 2% of the simulated radio */
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(measured_ppm, proj.duty_cycle_ppm);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(measured_ppm + measured_ppm / 50, proj.duty_cycle_ppm);
+    TEST_ASSERT_EQUAL_UINT32(policy.idle_period_ms, s_radio.worst_wait_ms);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(LATENCY_BUDGET_MS, proj.active_latency_ms);
+}
+
+static void test_default_policy_meets_latency_budget(void)
+{
+    poll_policy_t policy;
+    poll_scheduler_get_default_policy(&policy);
+    const poll_traffic_t traffic = {.door_cycles_per_day = 6, .travel_time_ms = 14000};
+    poll_projection_t proj;
+    TEST_ASSERT_EQUAL(ESP_OK, poll_scheduler_project(&policy, &traffic, &proj));
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(LATENCY_BUDGET_MS, proj.idle_latency_ms);
+    /* Still two orders of magnitude below an always-on receiver */
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(10000, proj.duty_cycle_ppm);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_init_uses_idle_period);
+    RUN_TEST(test_rejects_invalid_policy);
+    RUN_TEST(test_motion_holds_fast_window);
+    RUN_TEST(test_command_and_local_activity_open_window);
+    RUN_TEST(test_radio_failure_is_retried);
+    RUN_TEST(test_window_survives_clock_wrap);
+    RUN_TEST(test_projection_math);
+    RUN_TEST(test_simulated_day_matches_projection);
+    RUN_TEST(test_default_policy_meets_latency_budget);
+    return UNITY_END();
+}
@@ -0,0 +1,218 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include "unity.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "garage_fixture.h"
+#include "garage_door_control.h"
+#include "reed_switch.h"
+#include "power_manager.h"
+
+#define IDLE_ENTRY_MS    CONFIG_GARAGE_POWER_IDLE_ENTRY_MS
+#define DEBOUNCE_MS      50 /* reed_switch.c */
+/* Light sleep exit with the CPU powered down, order of magnitude for the ESP32-H2 */
+#define WAKE_LATENCY_US  1000
+/* Command to relay budget; a sleepy Thread device polls its parent every 450 ms when idle */
+#define COMMAND_BUDGET_MS 500
+#define THREAD_IDLE_POLL_MS 450
+
+static TaskHandle_t s_radio = NULL;
+static int64_t s_state_at_us;
+static door_state_t s_last_state;
+
+static void record_state(door_state_t state)
+{
+    s_last_state = state;
+    s_state_at_us = sim_now_us();
+}
+
+/* Stands in for the Matter task: a radio interrupt delivers an open command */
+static void radio_task(void *arg)
+{
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        garage_door_open();
+    }
+}
+
+static power_stats_t stats(void)
+{
+    power_stats_t st;
+    TEST_ASSERT_EQUAL(ESP_OK, power_manager_get_stats(&st));
+    return st;
+}
+
+/* Boots at rest and waits until sleep is allowed */
+static void boot_at_rest(uint32_t position_permille)
+{
+    fixture_boot(position_permille);
+    sim_pm_set_wake_latency(WAKE_LATENCY_US);
+    TEST_ASSERT_EQUAL(ESP_OK, power_manager_init());
+    TEST_ASSERT_EQUAL(ESP_OK, garage_door_register_state_callback(power_manager_on_door_state));
+    TEST_ASSERT_EQUAL(ESP_OK, garage_door_register_state_callback(record_state));
+    TEST_ASSERT_EQUAL(pdPASS, xTaskCreate(radio_task, "radio", 2048, NULL, 5, &s_radio));
+    sim_run_for(IDLE_ENTRY_MS + 10);
+    TEST_ASSERT_TRUE(sim_pm_light_sleep_allowed());
+}
+
+void setUp(void)
+{
+    s_state_at_us = 0;
+    s_last_state = DOOR_STATE_UNKNOWN;
+}
+
+void tearDown(void)
+{
+    power_manager_deinit();
+    fixture_shutdown();
+}
+
+static void test_sleeps_only_after_the_door_rests(void)
+{
+    fixture_boot(0);
+    TEST_ASSERT_EQUAL(ESP_OK, power_manager_init());
+    TEST_ASSERT_FALSE(sim_pm_light_sleep_allowed());
+    sim_run_for(IDLE_ENTRY_MS - 10);
+    TEST_ASSERT_FALSE(sim_pm_light_sleep_allowed());
+    sim_run_for(20);
+    TEST_ASSERT_TRUE(sim_pm_light_sleep_allowed());
+    TEST_ASSERT_TRUE(stats().sleep_allowed);
+    TEST_ASSERT_EQUAL_UINT32(1, stats().idle_entries);
+
+    /* A door between the end stops is not at rest */
+    power_manager_deinit();
+    fixture_shutdown();
+    fixture_boot(500);
+    TEST_ASSERT_EQUAL(DOOR_STATE_STOPPED, garage_door_get_state());
+    TEST_ASSERT_EQUAL(ESP_OK, power_manager_init());
+    sim_run_for(10 * IDLE_ENTRY_MS);
+    TEST_ASSERT_FALSE(sim_pm_light_sleep_allowed());
+    TEST_ASSERT_EQUAL_UINT32(0, stats().idle_entries);
+}
+
+/* Idle at rest: what is left waking the chip, and the fraction of time it is awake */
+static void test_idle_duty_cycle(void)
+{
+    boot_at_rest(0);
+    power_manager_reset_stats();
+    sim_pm_reset_stats();
+    sim_run_for(60000);
+
+    sim_pm_stats_t pm;
+    sim_pm_get_stats(&pm);
+    power_stats_t st = stats();
+    /* The sleep in progress at the reset counts in full once it ends */
+    TEST_ASSERT_UINT32_WITHIN(1, pm.sleeps, st.sleeps);
+    uint64_t awake_us = st.elapsed_us - st.slept_us;
+    uint32_t awake_ppm = (uint32_t)(awake_us * 1000000 / st.elapsed_us);
+    printf("idle: %" PRIu32 " wakeups/min, longest sleep %" PRIu32 " ms, awake %" PRIu32 " ppm\n", st.sleeps,
+           st.sleep_max_us / 1000, awake_ppm);
+    /* The liveness heartbeat and its monitor; every wake costs the wake latency */
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(90, st.sleeps);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(2000, awake_ppm);
+    TEST_ASSERT_EQUAL_UINT32(0, pm.gpio_wakeups);
+}
+
+/* A command arriving over the radio: the wake adds its latency, the door holds the chip awake */
+static void test_command_wakes_and_holds_awake(void)
+{
+    boot_at_rest(0);
+    sim_run_for(333);
+    TEST_ASSERT_TRUE(sim_pm_asleep());
+
+    int64_t command_at = sim_now_us();
+    vTaskNotifyGiveFromISR(s_radio, NULL);
+    sim_run_for(10);
+    TEST_ASSERT_EQUAL(DOOR_STATE_OPENING, s_last_state);
+    int64_t latency_us = s_state_at_us - command_at;
+    printf("command to relay: %lld us asleep\n", (long long)latency_us);
+    TEST_ASSERT_UINT32_WITHIN(portTICK_PERIOD_MS * 1000, WAKE_LATENCY_US, (uint32_t)latency_us);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(COMMAND_BUDGET_MS * 1000, THREAD_IDLE_POLL_MS * 1000 + (uint32_t)latency_us);
+
+    /* Awake for the whole travel and the idle entry delay after it */
+    sim_run_for(1000);
+    TEST_ASSERT_FALSE(sim_pm_light_sleep_allowed());
+    TEST_ASSERT_FALSE(sim_pm_asleep());
+    sim_run_for(FIXTURE_TRAVEL_MS);
+    TEST_ASSERT_EQUAL(DOOR_STATE_OPEN, garage_door_get_state());
+    TEST_ASSERT_FALSE(sim_pm_light_sleep_allowed());
+    sim_run_for(IDLE_ENTRY_MS);
+    TEST_ASSERT_TRUE(sim_pm_light_sleep_allowed());
+    TEST_ASSERT_EQUAL_UINT32(2, stats().idle_entries);
+}
+
+static void test_stopped_door_stays_awake(void)
+{
+    boot_at_rest(0);
+    vTaskNotifyGiveFromISR(s_radio, NULL);
+    sim_run_for(3000);
+    sim_door_set_jammed(true);
+    TEST_ASSERT_EQUAL(ESP_OK, garage_door_stop());
+    TEST_ASSERT_EQUAL(DOOR_STATE_STOPPED, garage_door_get_state());
+    sim_run_for(10 * IDLE_ENTRY_MS);
+    TEST_ASSERT_FALSE(sim_pm_light_sleep_allowed());
+    TEST_ASSERT_FALSE(sim_pm_asleep());
+}
+
+/* The door opened by hand (wall button) while the chip sleeps: the reeds wake it */
+static void test_reed_change_wakes_the_chip(void)
+{
+    boot_at_rest(0);
+    sim_run_for(500);
+    sim_pm_reset_stats();
+
+    sim_gpio_set_input(FIXTURE_REED_CLOSED_PIN, 1);
+    sim_run_for(5000);
+    TEST_ASSERT_EQUAL(DOOR_POSITION_BETWEEN, reed_switch_get_position());
+    int64_t arrival = sim_now_us();
+    sim_gpio_set_input(FIXTURE_REED_OPEN_PIN, 0);
+    sim_run_for(500);
+    TEST_ASSERT_EQUAL(DOOR_STATE_OPEN, s_last_state);
+    int64_t latency_us = s_state_at_us - arrival;
+    printf("reed edge to state asleep: %lld us\n", (long long)latency_us);
+    TEST_ASSERT_UINT32_WITHIN(portTICK_PERIOD_MS * 1000, DEBOUNCE_MS * 1000 + WAKE_LATENCY_US, (uint32_t)latency_us);
+
+    /* One wake per reed change: the reeds are re-armed at their new levels, not left firing */
+    sim_pm_stats_t pm;
+    sim_pm_get_stats(&pm);
+    TEST_ASSERT_EQUAL_UINT32(2, pm.gpio_wakeups);
+    TEST_ASSERT_EQUAL_UINT32(0, pm.held_interrupts);
+    sim_run_for(IDLE_ENTRY_MS + 10);
+    TEST_ASSERT_TRUE(sim_pm_light_sleep_allowed());
+    TEST_ASSERT_EQUAL_UINT32(2, stats().idle_entries);
+}
+
+/* Without the reeds as wake sources the same edge waits for the next timer */
+static void test_unarmed_reed_waits_for_a_timer(void)
+{
+    boot_at_rest(0);
+    TEST_ASSERT_EQUAL(ESP_OK, reed_switch_set_wakeup(false));
+    sim_run_for(500);
+    sim_pm_reset_stats();
+
+    sim_gpio_set_input(FIXTURE_REED_CLOSED_PIN, 1);
+    sim_run_for(5000);
+    int64_t arrival = sim_now_us();
+    sim_gpio_set_input(FIXTURE_REED_OPEN_PIN, 0);
+    sim_run_for(3000);
+    TEST_ASSERT_EQUAL(DOOR_STATE_OPEN, s_last_state);
+
+    sim_pm_stats_t pm;
+    sim_pm_get_stats(&pm);
+    TEST_ASSERT_EQUAL_UINT32(0, pm.gpio_wakeups);
+    TEST_ASSERT_EQUAL_UINT32(2, pm.held_interrupts);
+    printf("reed edge to state, not a wake source: %lld us\n", (long long)(s_state_at_us - arrival));
+    TEST_ASSERT_TRUE(s_state_at_us - arrival > (DEBOUNCE_MS + 10) * 1000);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_sleeps_only_after_the_door_rests);
+    RUN_TEST(test_idle_duty_cycle);
+    RUN_TEST(test_command_wakes_and_holds_awake);
+    RUN_TEST(test_stopped_door_stays_awake);
+    RUN_TEST(test_reed_change_wakes_the_chip);
+    RUN_TEST(test_unarmed_reed_waits_for_a_timer);
+    return UNITY_END();
+}
@@ -0,0 +1,130 @@
+#include <string.h>
+#include "unity.h"
+#include "sim.h"
+#include "reed_switch.h"
+
+#define CLOSED_PIN  GPIO_NUM_2
+#define OPEN_PIN    GPIO_NUM_3
+#define DEBOUNCE_MS 50
+
+static door_position_t s_reported[8];
+static size_t s_report_count;
+static int64_t s_last_report_us;
+
+static void on_position(door_position_t position)
+{
+    if (s_report_count < sizeof(s_reported) / sizeof(s_reported[0])) {
+        s_reported[s_report_count++] = position;
+    }
+    s_last_report_us = sim_now_us();
+}
+
+/* Reeds are active low: 0 means the magnet is at the switch */
+static void drive(uint32_t closed_level, uint32_t open_level)
+{
+    sim_gpio_set_input(CLOSED_PIN, closed_level);
+    sim_gpio_set_input(OPEN_PIN, open_level);
+}
+
+void setUp(void)
+{
+    sim_reset();
+    memset(s_reported, 0, sizeof(s_reported));
+    s_report_count = 0;
+    drive(0, 1);
+    const reed_switch_config_t config = {.reed_closed_pin = CLOSED_PIN, .reed_open_pin = OPEN_PIN};
+    TEST_ASSERT_EQUAL(ESP_OK, reed_switch_init(&config));
+    TEST_ASSERT_EQUAL(ESP_OK, reed_switch_register_callback(on_position));
+}
+
+void tearDown(void)
+{
+    reed_switch_deinit();
+    sim_reset();
+}
+
+static void test_position_decoding(void)
+{
+    TEST_ASSERT_EQUAL(DOOR_POSITION_CLOSED, reed_switch_get_position());
+    TEST_ASSERT_TRUE(reed_switch_is_closed());
+    drive(1, 0);
+    TEST_ASSERT_EQUAL(DOOR_POSITION_OPEN, reed_switch_get_position());
+    TEST_ASSERT_TRUE(reed_switch_is_open());
+    drive(1, 1);
+    TEST_ASSERT_EQUAL(DOOR_POSITION_BETWEEN, reed_switch_get_position());
+    /* Both magnets present is a wiring or placement fault */
+    drive(0, 0);
+    TEST_ASSERT_EQUAL(DOOR_POSITION_UNKNOWN, reed_switch_get_position());
+}
+
+static void test_change_reported_after_debounce(void)
+{
+    int64_t edge_us = sim_now_us();
+    drive(1, 1);
+    sim_run_for(DEBOUNCE_MS - 1);
+    TEST_ASSERT_EQUAL_UINT32(0, s_report_count);
+    sim_run_for(1);
+    TEST_ASSERT_EQUAL_UINT32(1, s_report_count);
+    TEST_ASSERT_EQUAL(DOOR_POSITION_BETWEEN, s_reported[0]);
+    TEST_ASSERT_EQUAL_INT(DEBOUNCE_MS * 1000, s_last_report_us - edge_us);
+}
+
+static void test_bounce_burst_reports_final_position(void)
+{
+    /* Contact bounce while the magnet leaves the closed switch */
+    for (int i = 0; i < 6; i++) {
+        sim_gpio_set_input(CLOSED_PIN, i & 1 ? 0 : 1);
+        sim_run_for(3);
+    }
+    sim_gpio_set_input(CLOSED_PIN, 1);
+    sim_run_for(DEBOUNCE_MS * 2);
+    TEST_ASSERT_EQUAL_UINT32(1, s_report_count);
+    TEST_ASSERT_EQUAL(DOOR_POSITION_BETWEEN, s_reported[0]);
+}
+
+static void test_glitch_is_filtered(void)
+{
+    sim_gpio_set_input(CLOSED_PIN, 1);
+    sim_run_for(5);
+    sim_gpio_set_input(CLOSED_PIN, 0);
+    sim_run_for(DEBOUNCE_MS * 2);
+    TEST_ASSERT_EQUAL_UINT32(0, s_report_count);
+    TEST_ASSERT_EQUAL(DOOR_POSITION_CLOSED, reed_switch_get_position());
+}
+
+static void test_full_travel_sequence(void)
+{
+    drive(1, 1);
+    sim_run_for(1000);
+    drive(1, 0);
+    sim_run_for(1000);
+    TEST_ASSERT_EQUAL_UINT32(2, s_report_count);
+    TEST_ASSERT_EQUAL(DOOR_POSITION_BETWEEN, s_reported[0]);
+    TEST_ASSERT_EQUAL(DOOR_POSITION_OPEN, s_reported[1]);
+}
+
+static void test_api_misuse(void)
+{
+    const reed_switch_config_t config = {.reed_closed_pin = CLOSED_PIN, .reed_open_pin = OPEN_PIN};
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, reed_switch_init(&config));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, reed_switch_set_gpio_config(&config));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, reed_switch_register_callback(NULL));
+
+    reed_switch_deinit();
+    TEST_ASSERT_EQUAL(DOOR_POSITION_UNKNOWN, reed_switch_get_position());
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, reed_switch_deinit());
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, reed_switch_init(NULL));
+    TEST_ASSERT_EQUAL(ESP_OK, reed_switch_init(&config));
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_position_decoding);
+    RUN_TEST(test_change_reported_after_debounce);
+    RUN_TEST(test_bounce_burst_reports_final_position);
+    RUN_TEST(test_glitch_is_filtered);
+    RUN_TEST(test_full_travel_sequence);
+    RUN_TEST(test_api_misuse);
+    return UNITY_END();
+}
@@ -0,0 +1,108 @@
+#include <string.h>
+#include "unity.h"
+#include "sim.h"
+#include "relay_control.h"
+
+#define RELAY_PIN GPIO_NUM_4
+
+static uint32_t s_completions;
+static uint32_t s_rising_edges;
+
+static void on_complete(void)
+{
+    s_completions++;
+}
+
+static void on_output(gpio_num_t pin, uint32_t level, void *ctx)
+{
+    s_rising_edges += level;
+}
+
+void setUp(void)
+{
+    sim_reset();
+    s_completions = 0;
+    s_rising_edges = 0;
+    sim_gpio_set_output_hook(RELAY_PIN, on_output, NULL);
+    TEST_ASSERT_EQUAL(ESP_OK, relay_init(RELAY_PIN));
+    TEST_ASSERT_EQUAL(ESP_OK, relay_register_callback(on_complete));
+    /* Clear the rate limit left by the previous test */
+    sim_run_for(2000);
+}
+
+void tearDown(void)
+{
+    relay_deinit();
+    sim_reset();
+}
+
+static void test_pulse_shape(void)
+{
+    TEST_ASSERT_EQUAL(ESP_OK, relay_activate());
+    TEST_ASSERT_EQUAL_UINT32(1, sim_gpio_get_output(RELAY_PIN));
+    TEST_ASSERT_TRUE(relay_is_active());
+
+    sim_run_for(499);
+    TEST_ASSERT_EQUAL_UINT32(1, sim_gpio_get_output(RELAY_PIN));
+    sim_run_for(1);
+    TEST_ASSERT_EQUAL_UINT32(0, sim_gpio_get_output(RELAY_PIN));
+    TEST_ASSERT_FALSE(relay_is_active());
+    TEST_ASSERT_EQUAL_UINT32(1, s_completions);
+    TEST_ASSERT_EQUAL_UINT32(1, s_rising_edges);
+}
+
+static void test_overlapping_and_rapid_pulses_rejected(void)
+{
+    TEST_ASSERT_EQUAL(ESP_OK, relay_activate_pulse(200));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, relay_activate_pulse(200));
+
+    /* Pulse over but inside the minimum interval */
+    sim_run_for(500);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, relay_activate_pulse(200));
+    sim_run_for(500);
+    TEST_ASSERT_EQUAL(ESP_OK, relay_activate_pulse(200));
+    TEST_ASSERT_EQUAL_UINT32(2, s_rising_edges);
+}
+
+static void test_duration_limits(void)
+{
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, relay_activate_pulse(0));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, relay_activate_pulse(601));
+    TEST_ASSERT_EQUAL_UINT32(0, s_rising_edges);
+    TEST_ASSERT_EQUAL(ESP_OK, relay_activate_pulse(600));
+}
+
+static void test_config_round_trip(void)
+{
+    const relay_config_t config = {.pulse_duration_ms = 300, .max_pulse_duration_ms = 400, .min_interval_ms = 100};
+    TEST_ASSERT_EQUAL(ESP_OK, relay_set_config(&config));
+    relay_config_t read = {0};
+    TEST_ASSERT_EQUAL(ESP_OK, relay_get_config(&read));
+    TEST_ASSERT_EQUAL_MEMORY(&config, &read, sizeof(config));
+
+    TEST_ASSERT_EQUAL(ESP_OK, relay_activate());
+    sim_run_for(300);
+    TEST_ASSERT_EQUAL_UINT32(0, sim_gpio_get_output(RELAY_PIN));
+    TEST_ASSERT_EQUAL(ESP_OK, relay_activate());
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, relay_set_config(NULL));
+}
+
+static void test_deinit_forces_output_low(void)
+{
+    TEST_ASSERT_EQUAL(ESP_OK, relay_activate());
+    TEST_ASSERT_EQUAL(ESP_OK, relay_deinit());
+    TEST_ASSERT_EQUAL_UINT32(0, sim_gpio_get_output(RELAY_PIN));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, relay_activate());
+    TEST_ASSERT_EQUAL(ESP_OK, relay_init(RELAY_PIN));
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_pulse_shape);
+    RUN_TEST(test_overlapping_and_rapid_pulses_rejected);
+    RUN_TEST(test_duration_limits);
+    RUN_TEST(test_config_round_trip);
+    RUN_TEST(test_deinit_forces_output_low);
+    return UNITY_END();
+}
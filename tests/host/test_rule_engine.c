@@ -0,0 +1,464 @@
+#include <stdio.h>
+#include <string.h>
+#include "unity.h"
+#include "garage_fixture.h"
+#include "garage_door_control.h"
+#include "storage_manager.h"
+#include "rule_engine.h"
+
+#define ACTIONS_MAX RULE_MAX_RULES
+#define MINUTE_MS   (60 * 1000)
+
+typedef struct {
+    rule_action_t action;
+    uint8_t arg;
+    char name[RULE_MAX_NAME + 1];
+    int64_t at_us;
+} action_record_t;
+
+static action_record_t s_actions[ACTIONS_MAX];
+static size_t s_action_count;
+static bool s_drive_door; /* Scenario tests: close/open move the simulated door */
+
+/* Compiled tools/garage.rules, passed in by check_rule_compile.py */
+static uint8_t s_example[RULE_BLOB_MAX];
+static size_t s_example_len;
+
+static void record_action(rule_action_t action, uint8_t arg, const char *rule_name)
+{
+    if (s_action_count < ACTIONS_MAX) {
+        action_record_t *rec = &s_actions[s_action_count++];
+        rec->action = action;
+        rec->arg = arg;
+        snprintf(rec->name, sizeof(rec->name), "%s", rule_name);
+        rec->at_us = sim_now_us();
+    }
+    if (s_drive_door && action == RULE_ACTION_CLOSE) {
+        TEST_ASSERT_EQUAL(ESP_OK, garage_door_close());
+    }
+}
+
+static void feed_door(door_state_t state)
+{
+    rule_engine_set_input(RULE_INPUT_DOOR, state);
+}
+
+void setUp(void)
+{
+    sim_reset();
+    sim_nvs_erase_all();
+    storage_init();
+    s_action_count = 0;
+    s_drive_door = false;
+    TEST_ASSERT_EQUAL(ESP_OK, rule_engine_init(record_action));
+}
+
+void tearDown(void)
+{
+    rule_engine_deinit();
+    sim_reset();
+}
+
+/* Hand assembly, so these tests do not depend on the compiler */
+typedef struct {
+    uint8_t data[RULE_BLOB_MAX + 64];
+    size_t len;
+} blob_t;
+
+static void blob_begin(blob_t *b)
+{
+    b->data[0] = RULE_BLOB_MAGIC0;
+    b->data[1] = RULE_BLOB_MAGIC1;
+    b->data[2] = RULE_BLOB_VERSION;
+    b->data[3] = 0;
+    b->len = 4;
+}
+
+static void blob_rule(blob_t *b, const char *name, uint8_t triggers, rule_action_t action, uint8_t arg,
+                      uint16_t hold_s, const uint8_t *code, size_t code_len)
+{
+    size_t name_len = strlen(name);
+    uint8_t *p = &b->data[b->len];
+    p[0] = (uint8_t)(7 + name_len + code_len);
+    p[1] = triggers;
+    p[2] = action;
+    p[3] = arg;
+    p[4] = hold_s & 0xFF;
+    p[5] = hold_s >> 8;
+    p[6] = (uint8_t)name_len;
+    memcpy(&p[7], name, name_len);
+    memcpy(&p[7 + name_len], code, code_len);
+    b->len += p[0];
+    b->data[3]++;
+}
+
+#define BIT(input) (1u << (input))
+
+/* door == OPEN */
+static const uint8_t DOOR_OPEN[] = {RULE_OP_IN, RULE_INPUT_DOOR, RULE_OP_K8, DOOR_STATE_OPEN, RULE_OP_EQ};
+/* hour >= 22 */
+static const uint8_t LATE[] = {RULE_OP_IN, RULE_INPUT_HOUR, RULE_OP_K8, 22, RULE_OP_GE};
+/* door == OPEN and vehicle == 0 */
+static const uint8_t OPEN_AND_GONE[] = {RULE_OP_IN, RULE_INPUT_DOOR, RULE_OP_K8, DOOR_STATE_OPEN, RULE_OP_EQ,
+                                        RULE_OP_IN, RULE_INPUT_VEHICLE, RULE_OP_NOT, RULE_OP_AND};
+
+static void load_one(const char *name, uint8_t triggers, rule_action_t action, uint16_t hold_s,
+                     const uint8_t *code, size_t code_len)
+{
+    blob_t b;
+    blob_begin(&b);
+    blob_rule(&b, name, triggers, action, 0, hold_s, code, code_len);
+    TEST_ASSERT_EQUAL(ESP_OK, rule_engine_load(b.data, b.len));
+}
+
+static rule_info_t info(size_t index)
+{
+    rule_info_t i;
+    TEST_ASSERT_EQUAL(ESP_OK, rule_engine_get_info(index, &i));
+    return i;
+}
+
+static void expect_rejected(const blob_t *b)
+{
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, rule_engine_load(b->data, b->len));
+    /* The previously loaded rule is untouched */
+    TEST_ASSERT_EQUAL_UINT32(1, rule_engine_count());
+    TEST_ASSERT_EQUAL_STRING("keep", info(0).name);
+}
+
+static void test_verifier_rejects_bad_programs(void)
+{
+    load_one("keep", BIT(RULE_INPUT_DOOR), RULE_ACTION_ALERT, 0, DOOR_OPEN, sizeof(DOOR_OPEN));
+    blob_t b;
+
+    blob_begin(&b);
+    blob_rule(&b, "ok", BIT(RULE_INPUT_DOOR), RULE_ACTION_CLOSE, 0, 0, DOOR_OPEN, sizeof(DOOR_OPEN));
+    b.data[0] = 'X';
+    expect_rejected(&b);
+
+    const uint8_t underflow[] = {RULE_OP_IN, RULE_INPUT_DOOR, RULE_OP_EQ};
+    blob_begin(&b);
+    blob_rule(&b, "under", BIT(RULE_INPUT_DOOR), RULE_ACTION_CLOSE, 0, 0, underflow, sizeof(underflow));
+    expect_rejected(&b);
+
+    const uint8_t two_left[] = {RULE_OP_IN, RULE_INPUT_DOOR, RULE_OP_K8, 1};
+    blob_begin(&b);
+    blob_rule(&b, "two", BIT(RULE_INPUT_DOOR), RULE_ACTION_CLOSE, 0, 0, two_left, sizeof(two_left));
+    expect_rejected(&b);
+
+    const uint8_t bad_input[] = {RULE_OP_IN, RULE_INPUT_COUNT};
+    blob_begin(&b);
+    blob_rule(&b, "input", BIT(RULE_INPUT_DOOR), RULE_ACTION_CLOSE, 0, 0, bad_input, sizeof(bad_input));
+    expect_rejected(&b);
+
+    const uint8_t bad_op[] = {RULE_OP_IN, RULE_INPUT_DOOR, 0x7F};
+    blob_begin(&b);
+    blob_rule(&b, "op", BIT(RULE_INPUT_DOOR), RULE_ACTION_CLOSE, 0, 0, bad_op, sizeof(bad_op));
+    expect_rejected(&b);
+
+    const uint8_t truncated[] = {RULE_OP_K16, 1};
+    blob_begin(&b);
+    blob_rule(&b, "trunc", BIT(RULE_INPUT_DOOR), RULE_ACTION_CLOSE, 0, 0, truncated, sizeof(truncated));
+    expect_rejected(&b);
+
+    uint8_t deep[2 * (RULE_STACK_DEPTH + 1) + RULE_STACK_DEPTH];
+    size_t n = 0;
+    for (int i = 0; i <= RULE_STACK_DEPTH; i++) {
+        deep[n++] = RULE_OP_K8;
+        deep[n++] = 1;
+    }
+    for (int i = 0; i < RULE_STACK_DEPTH; i++) {
+        deep[n++] = RULE_OP_AND;
+    }
+    blob_begin(&b);
+    blob_rule(&b, "deep", BIT(RULE_INPUT_DOOR), RULE_ACTION_CLOSE, 0, 0, deep, n);
+    expect_rejected(&b);
+
+    uint8_t long_code[RULE_MAX_CODE + 1];
+    memset(long_code, RULE_OP_NOT, sizeof(long_code));
+    memcpy(long_code, DOOR_OPEN, sizeof(DOOR_OPEN));
+    blob_begin(&b);
+    blob_rule(&b, "long", BIT(RULE_INPUT_DOOR), RULE_ACTION_CLOSE, 0, 0, long_code, sizeof(long_code));
+    expect_rejected(&b);
+
+    /* A trigger the condition does not read, no trigger at all, no action */
+    blob_begin(&b);
+    blob_rule(&b, "trig", BIT(RULE_INPUT_HOUR), RULE_ACTION_CLOSE, 0, 0, DOOR_OPEN, sizeof(DOOR_OPEN));
+    expect_rejected(&b);
+    blob_begin(&b);
+    blob_rule(&b, "none", 0, RULE_ACTION_CLOSE, 0, 0, DOOR_OPEN, sizeof(DOOR_OPEN));
+    expect_rejected(&b);
+    blob_begin(&b);
+    blob_rule(&b, "act", BIT(RULE_INPUT_DOOR), RULE_ACTION_NONE, 0, 0, DOOR_OPEN, sizeof(DOOR_OPEN));
+    expect_rejected(&b);
+
+    /* Trailing bytes and a rule count beyond the data */
+    blob_begin(&b);
+    blob_rule(&b, "ok", BIT(RULE_INPUT_DOOR), RULE_ACTION_CLOSE, 0, 0, DOOR_OPEN, sizeof(DOOR_OPEN));
+    b.data[b.len++] = 0;
+    expect_rejected(&b);
+    b.len--;
+    b.data[3] = 2;
+    expect_rejected(&b);
+}
+
+static void test_only_dependent_rules_are_evaluated(void)
+{
+    blob_t b;
+    blob_begin(&b);
+    blob_rule(&b, "door", BIT(RULE_INPUT_DOOR), RULE_ACTION_ALERT, 1, 0, DOOR_OPEN, sizeof(DOOR_OPEN));
+    blob_rule(&b, "late", BIT(RULE_INPUT_HOUR), RULE_ACTION_ALERT, 2, 0, LATE, sizeof(LATE));
+    TEST_ASSERT_EQUAL(ESP_OK, rule_engine_load(b.data, b.len));
+
+    for (int16_t hour = 10; hour < 20; hour++) {
+        TEST_ASSERT_EQUAL(ESP_OK, rule_engine_set_input(RULE_INPUT_HOUR, hour));
+    }
+    TEST_ASSERT_EQUAL(ESP_OK, rule_engine_set_input(RULE_INPUT_VEHICLE, 1));
+    TEST_ASSERT_EQUAL_UINT32(0, info(0).evaluations);
+    TEST_ASSERT_EQUAL_UINT32(10, info(1).evaluations);
+
+    /* Unchanged values are not events */
+    TEST_ASSERT_EQUAL(ESP_OK, rule_engine_set_input(RULE_INPUT_HOUR, 19));
+    TEST_ASSERT_EQUAL_UINT32(10, info(1).evaluations);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, rule_engine_set_input(RULE_INPUT_COUNT, 1));
+}
+
+static void test_actions_are_deferred_and_logged(void)
+{
+    load_one("door", BIT(RULE_INPUT_DOOR), RULE_ACTION_CLOSE, 0, DOOR_OPEN, sizeof(DOOR_OPEN));
+    feed_door(DOOR_STATE_CLOSED);
+    feed_door(DOOR_STATE_OPEN);
+    /* Not from inside the caller, which may hold the door mutex */
+    TEST_ASSERT_EQUAL_UINT32(0, s_action_count);
+    TEST_ASSERT_TRUE(info(0).pending);
+
+    sim_run_for(1);
+    TEST_ASSERT_EQUAL_UINT32(1, s_action_count);
+    TEST_ASSERT_EQUAL(RULE_ACTION_CLOSE, s_actions[0].action);
+    TEST_ASSERT_EQUAL_STRING("door", s_actions[0].name);
+    TEST_ASSERT_EQUAL_UINT32(1, info(0).fired);
+
+    event_log_t logs[4];
+    size_t count = 0;
+    TEST_ASSERT_EQUAL(ESP_OK, storage_get_logs(logs, 4, &count));
+    TEST_ASSERT_EQUAL_UINT32(1, count);
+    TEST_ASSERT_EQUAL(EVENT_TYPE_RULE, logs[0].type);
+    TEST_ASSERT_EQUAL(RULE_ACTION_CLOSE, logs[0].value);
+}
+
+static void test_first_known_value_and_other_inputs_do_not_trigger(void)
+{
+    load_one("gone", BIT(RULE_INPUT_VEHICLE), RULE_ACTION_CLOSE, 0, OPEN_AND_GONE, sizeof(OPEN_AND_GONE));
+
+    /* Boot: door open, vehicle absent. True, but nothing changed */
+    feed_door(DOOR_STATE_OPEN);
+    rule_engine_set_input(RULE_INPUT_VEHICLE, 0);
+    sim_run_for(1000);
+    TEST_ASSERT_EQUAL_UINT32(0, s_action_count);
+    TEST_ASSERT_TRUE(info(0).condition);
+
+    /* The door opening with no car inside is not 'the car left' */
+    feed_door(DOOR_STATE_CLOSED);
+    feed_door(DOOR_STATE_OPEN);
+    sim_run_for(1000);
+    TEST_ASSERT_EQUAL_UINT32(0, s_action_count);
+
+    rule_engine_set_input(RULE_INPUT_VEHICLE, 1);
+    rule_engine_set_input(RULE_INPUT_VEHICLE, 0);
+    sim_run_for(1000);
+    TEST_ASSERT_EQUAL_UINT32(1, s_action_count);
+}
+
+static void test_hold_time_is_cancelled_and_fires_once(void)
+{
+    load_one("held", BIT(RULE_INPUT_DOOR), RULE_ACTION_ALERT, 5, DOOR_OPEN, sizeof(DOOR_OPEN));
+    feed_door(DOOR_STATE_CLOSED);
+
+    feed_door(DOOR_STATE_OPEN);
+    sim_run_for(3000);
+    feed_door(DOOR_STATE_CLOSING);
+    sim_run_for(10000);
+    TEST_ASSERT_EQUAL_UINT32(0, s_action_count);
+    TEST_ASSERT_FALSE(info(0).pending);
+
+    int64_t opened = sim_now_us();
+    feed_door(DOOR_STATE_OPEN);
+    sim_run_for(60000);
+    TEST_ASSERT_EQUAL_UINT32(1, s_action_count);
+    TEST_ASSERT_UINT32_WITHIN(1000, 5000000, (uint32_t)(s_actions[0].at_us - opened));
+
+    /* Re-armed by the condition going false */
+    feed_door(DOOR_STATE_CLOSED);
+    feed_door(DOOR_STATE_OPEN);
+    sim_run_for(6000);
+    TEST_ASSERT_EQUAL_UINT32(2, s_action_count);
+}
+
+static void test_install_persists_and_clear_removes(void)
+{
+    blob_t b;
+    blob_begin(&b);
+    blob_rule(&b, "door", BIT(RULE_INPUT_DOOR), RULE_ACTION_ALERT, 7, 0, DOOR_OPEN, sizeof(DOOR_OPEN));
+    blob_rule(&b, "late", BIT(RULE_INPUT_HOUR), RULE_ACTION_ALERT, 8, 0, LATE, sizeof(LATE));
+    TEST_ASSERT_EQUAL(ESP_OK, rule_engine_install(b.data, b.len));
+
+    /* Reboot: NVS survives */
+    rule_engine_deinit();
+    sim_reset();
+    storage_init();
+    TEST_ASSERT_EQUAL(ESP_OK, rule_engine_init(record_action));
+    TEST_ASSERT_EQUAL_UINT32(0, rule_engine_count());
+    TEST_ASSERT_EQUAL(ESP_OK, rule_engine_load_stored());
+    TEST_ASSERT_EQUAL_UINT32(2, rule_engine_count());
+    TEST_ASSERT_EQUAL_STRING("late", info(1).name);
+    TEST_ASSERT_EQUAL_UINT32(8, info(1).action_arg);
+
+    /* A rejected install keeps both the active and the stored rules */
+    b.data[0] = 'X';
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, rule_engine_install(b.data, b.len));
+    TEST_ASSERT_EQUAL(ESP_OK, rule_engine_load_stored());
+    TEST_ASSERT_EQUAL_UINT32(2, rule_engine_count());
+
+    TEST_ASSERT_EQUAL(ESP_OK, rule_engine_install(NULL, 0));
+    TEST_ASSERT_EQUAL_UINT32(0, rule_engine_count());
+    TEST_ASSERT_EQUAL(ESP_OK, rule_engine_load_stored());
+    TEST_ASSERT_EQUAL_UINT32(0, rule_engine_count());
+}
+
+static void test_full_table_is_accepted(void)
+{
+    /* The largest table that fits the blob: every rule reads the door */
+    const size_t code_len = (RULE_BLOB_MAX - 4) / RULE_MAX_RULES - 7 - 3;
+    uint8_t code[RULE_MAX_CODE];
+    memcpy(code, DOOR_OPEN, sizeof(DOOR_OPEN));
+    for (size_t n = sizeof(DOOR_OPEN); n < code_len; n += 2) {
+        code[n] = RULE_OP_NOT;
+        code[n + 1] = RULE_OP_NOT;
+    }
+    blob_t b;
+    blob_begin(&b);
+    for (int i = 0; i < RULE_MAX_RULES; i++) {
+        char name[8];
+        snprintf(name, sizeof(name), "r%02d", i);
+        blob_rule(&b, name, BIT(RULE_INPUT_DOOR), RULE_ACTION_ALERT, 0, 0, code, code_len);
+    }
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(RULE_BLOB_MAX, b.len);
+    TEST_ASSERT_EQUAL(ESP_OK, rule_engine_load(b.data, b.len));
+    feed_door(DOOR_STATE_CLOSED);
+    feed_door(DOOR_STATE_OPEN);
+    sim_run_for(1);
+    TEST_ASSERT_EQUAL_UINT32(RULE_MAX_RULES, s_action_count);
+
+    /* One more rule does not fit */
+    blob_rule(&b, "r16", BIT(RULE_INPUT_DOOR), RULE_ACTION_ALERT, 0, 0, code, code_len);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, rule_engine_load(b.data, b.len));
+}
+
+/* Scenarios for the rules in tools/garage.rules, on the simulated door */
+static void example_boot(uint32_t door_position_permille, int16_t hour, int16_t vehicle)
+{
+    rule_engine_deinit();
+    fixture_boot(door_position_permille);
+    s_action_count = 0;
+    s_drive_door = true;
+    TEST_ASSERT_EQUAL(ESP_OK, rule_engine_init(record_action));
+    TEST_ASSERT_EQUAL(ESP_OK, rule_engine_load(s_example, s_example_len));
+    TEST_ASSERT_EQUAL(ESP_OK, garage_door_register_state_callback(feed_door));
+    feed_door(garage_door_get_state());
+    rule_engine_set_input(RULE_INPUT_HOUR, hour);
+    rule_engine_set_input(RULE_INPUT_VEHICLE, vehicle);
+}
+
+static void example_shutdown(void)
+{
+    rule_engine_deinit();
+    fixture_shutdown();
+    storage_init();
+    rule_engine_init(record_action);
+}
+
+static void test_example_closes_at_night(void)
+{
+    example_boot(1000, 21, 1);
+    TEST_ASSERT_EQUAL(DOOR_STATE_OPEN, garage_door_get_state());
+
+    /* Open since before 22:00: the hold starts when the hour turns */
+    sim_run_for(5 * MINUTE_MS);
+    rule_engine_set_input(RULE_INPUT_HOUR, 22);
+    sim_run_for(10 * MINUTE_MS - 1000);
+    TEST_ASSERT_EQUAL_UINT32(0, s_action_count);
+    sim_run_for(2000 + FIXTURE_TRAVEL_MS + 3000);
+    TEST_ASSERT_EQUAL_UINT32(1, s_action_count);
+    TEST_ASSERT_EQUAL_STRING("night_close", s_actions[0].name);
+    TEST_ASSERT_EQUAL(DOOR_STATE_CLOSED, garage_door_get_state());
+    example_shutdown();
+}
+
+static void test_example_closes_behind_departing_car(void)
+{
+    example_boot(0, 12, 1);
+    TEST_ASSERT_EQUAL(ESP_OK, garage_door_open());
+    sim_run_for(FIXTURE_TRAVEL_MS + 3000);
+    TEST_ASSERT_EQUAL(DOOR_STATE_OPEN, garage_door_get_state());
+
+    rule_engine_set_input(RULE_INPUT_VEHICLE, 0);
+    sim_run_for(MINUTE_MS + FIXTURE_TRAVEL_MS + 3000);
+    TEST_ASSERT_EQUAL_UINT32(1, s_action_count);
+    TEST_ASSERT_EQUAL_STRING("vehicle_left", s_actions[0].name);
+    TEST_ASSERT_EQUAL(DOOR_STATE_CLOSED, garage_door_get_state());
+
+    /* Closed in time: the open-too-long alert never fires */
+    sim_run_for(40 * MINUTE_MS);
+    TEST_ASSERT_EQUAL_UINT32(1, s_action_count);
+    example_shutdown();
+}
+
+static void test_example_alerts_once_when_left_open(void)
+{
+    example_boot(0, 12, 1);
+    TEST_ASSERT_EQUAL(ESP_OK, garage_door_open());
+    sim_run_for(FIXTURE_TRAVEL_MS + 3000);
+
+    sim_run_for(30 * MINUTE_MS);
+    TEST_ASSERT_EQUAL_UINT32(1, s_action_count);
+    TEST_ASSERT_EQUAL(RULE_ACTION_ALERT, s_actions[0].action);
+    TEST_ASSERT_EQUAL_UINT32(1, s_actions[0].arg);
+    TEST_ASSERT_EQUAL(DOOR_STATE_OPEN, garage_door_get_state());
+
+    sim_run_for(60 * MINUTE_MS);
+    TEST_ASSERT_EQUAL_UINT32(1, s_action_count);
+    example_shutdown();
+}
+
+static bool load_example(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        return false;
+    }
+    s_example_len = fread(s_example, 1, sizeof(s_example), f);
+    fclose(f);
+    return s_example_len > 0;
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_verifier_rejects_bad_programs);
+    RUN_TEST(test_only_dependent_rules_are_evaluated);
+    RUN_TEST(test_actions_are_deferred_and_logged);
+    RUN_TEST(test_first_known_value_and_other_inputs_do_not_trigger);
+    RUN_TEST(test_hold_time_is_cancelled_and_fires_once);
+    RUN_TEST(test_install_persists_and_clear_removes);
+    RUN_TEST(test_full_table_is_accepted);
+    if (argc > 1) {
+        if (!load_example(argv[1])) {
+            printf("cannot read %s\n", argv[1]);
+            return 1;
+        }
+        RUN_TEST(test_example_closes_at_night);
+        RUN_TEST(test_example_closes_behind_departing_car);
+        RUN_TEST(test_example_alerts_once_when_left_open);
+    }
+    return UNITY_END();
+}
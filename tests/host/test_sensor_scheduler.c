@@ -0,0 +1,284 @@
+#include <stdio.h>
+#include <string.h>
+#include "unity.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "garage_fixture.h"
+#include "garage_door_control.h"
+#include "sensor_scheduler.h"
+
+#define LOG_MAX 64
+
+typedef struct {
+    char tag;
+    uint32_t busy_ms; /* Blocks the scheduler task this long, as a slow bus read would */
+    uint32_t runs;
+} probe_t;
+
+static char s_log[LOG_MAX + 1];
+static size_t s_log_len;
+static uint32_t s_bus_begins;
+static uint32_t s_bus_ends;
+static bool s_bus_open;
+
+static void probe_sample(void *ctx)
+{
+    probe_t *probe = ctx;
+    probe->runs++;
+    if (s_log_len < LOG_MAX) {
+        s_log[s_log_len++] = probe->tag;
+    }
+    if (probe->busy_ms) {
+        vTaskDelay(pdMS_TO_TICKS(probe->busy_ms));
+    }
+}
+
+static void bus_sample(void *ctx)
+{
+    TEST_ASSERT_TRUE(s_bus_open);
+    probe_sample(ctx);
+}
+
+static void bus_begin(void *ctx)
+{
+    s_bus_begins++;
+    s_bus_open = true;
+}
+
+static void bus_end(void *ctx)
+{
+    s_bus_ends++;
+    s_bus_open = false;
+}
+
+static const sensor_bus_t s_i2c = {.name = "i2c0", .begin = bus_begin, .end = bus_end};
+
+void setUp(void)
+{
+    sim_reset();
+    memset(s_log, 0, sizeof(s_log));
+    s_log_len = 0;
+    s_bus_begins = 0;
+    s_bus_ends = 0;
+    s_bus_open = false;
+    TEST_ASSERT_EQUAL(ESP_OK, sensor_scheduler_init());
+}
+
+void tearDown(void)
+{
+    sensor_scheduler_deinit();
+    sim_reset();
+}
+
+static sensor_id_t add(const char *name, uint32_t period_ms, uint32_t deadline_ms, const sensor_bus_t *bus,
+                       probe_t *probe)
+{
+    const sensor_desc_t desc = {
+        .name = name,
+        .period_ms = period_ms,
+        .deadline_ms = deadline_ms,
+        .bus = bus,
+        .sample = bus ? bus_sample : probe_sample,
+        .ctx = probe,
+    };
+    sensor_id_t id = -1;
+    TEST_ASSERT_EQUAL(ESP_OK, sensor_scheduler_register(&desc, &id));
+    return id;
+}
+
+static void test_runs_on_period_without_lateness(void)
+{
+    probe_t probe = {.tag = 'a'};
+    sensor_id_t id = add("a", 100, 0, NULL, &probe);
+
+    sim_run_for(1000);
+    sensor_stats_t st;
+    TEST_ASSERT_EQUAL(ESP_OK, sensor_scheduler_get_stats(id, &st));
+    TEST_ASSERT_EQUAL_UINT32(10, st.runs);
+    TEST_ASSERT_EQUAL_UINT32(0, st.lateness_max_us);
+    TEST_ASSERT_EQUAL_UINT32(0, st.deadline_misses);
+    TEST_ASSERT_EQUAL_STRING("a", st.name);
+}
+
+static void test_earliest_deadline_runs_first(void)
+{
+    probe_t relaxed = {.tag = 'r', .busy_ms = 5};
+    probe_t urgent = {.tag = 'u', .busy_ms = 5};
+    sensor_id_t relaxed_id = add("relaxed", 100, 100, NULL, &relaxed);
+    sensor_id_t urgent_id = add("urgent", 100, 10, NULL, &urgent);
+
+    sim_run_for(250);
+    TEST_ASSERT_EQUAL_STRING("urur", s_log);
+
+    /* The relaxed sensor waited for the urgent one and still made its deadline */
+    sensor_stats_t st;
+    sensor_scheduler_get_stats(relaxed_id, &st);
+    TEST_ASSERT_EQUAL_UINT32(5000, st.lateness_max_us);
+    TEST_ASSERT_EQUAL_UINT32(0, st.deadline_misses);
+    sensor_scheduler_get_stats(urgent_id, &st);
+    TEST_ASSERT_EQUAL_UINT32(0, st.lateness_max_us);
+    TEST_ASSERT_EQUAL_UINT32(5000, st.exec_max_us);
+}
+
+static void test_records_execution_time_and_misses(void)
+{
+    probe_t slow = {.tag = 's', .busy_ms = 30};
+    sensor_id_t id = add("slow", 100, 20, NULL, &slow);
+
+    sim_run_for(550);
+    sensor_stats_t st;
+    sensor_scheduler_get_stats(id, &st);
+    TEST_ASSERT_EQUAL_UINT32(5, st.runs);
+    TEST_ASSERT_EQUAL_UINT32(5, st.deadline_misses);
+    TEST_ASSERT_EQUAL_UINT32(30000, st.exec_max_us);
+    TEST_ASSERT_EQUAL_UINT64(5 * 30000, st.exec_total_us);
+
+    sensor_scheduler_reset_stats();
+    sensor_scheduler_get_stats(id, &st);
+    TEST_ASSERT_EQUAL_UINT32(0, st.runs);
+    TEST_ASSERT_EQUAL_STRING("slow", st.name);
+}
+
+static void test_overrun_drops_missed_releases(void)
+{
+    probe_t hog = {.tag = 'h', .busy_ms = 250};
+    sensor_id_t id = add("hog", 100, 0, NULL, &hog);
+
+    sim_run_for(1300);
+    sensor_stats_t st;
+    sensor_scheduler_get_stats(id, &st);
+    /* Runs at 100, 400, 700, 1000 ms: never back to back to catch up */
+    TEST_ASSERT_EQUAL_UINT32(4, st.runs);
+    TEST_ASSERT_EQUAL_UINT32(0, st.lateness_max_us);
+}
+
+static void test_batches_sensors_sharing_a_bus(void)
+{
+    probe_t temp = {.tag = 't'};
+    probe_t light = {.tag = 'l'};
+    probe_t lone = {.tag = 'x'};
+    add("temp", 100, 0, &s_i2c, &temp);
+    sim_run_for(10);
+    sensor_id_t light_id = add("light", 100, 0, &s_i2c, &light);
+    sim_run_for(40);
+    add("lone", 100, 0, &s_i2c, &lone); /* 50 ms out of phase: outside the batch window */
+
+    sim_run_for(1000);
+    TEST_ASSERT_EQUAL_UINT32(s_bus_begins, s_bus_ends);
+    TEST_ASSERT_EQUAL_UINT32(10, temp.runs);
+    TEST_ASSERT_EQUAL_UINT32(10, light.runs);
+    TEST_ASSERT_EQUAL_UINT32(10, lone.runs);
+    /* temp and light share one transaction per period, lone gets its own */
+    TEST_ASSERT_EQUAL_UINT32(20, s_bus_begins);
+
+    sensor_stats_t st;
+    sensor_scheduler_get_stats(light_id, &st);
+    TEST_ASSERT_EQUAL_UINT32(10, st.batched);
+    TEST_ASSERT_EQUAL_UINT32(0, st.deadline_misses);
+}
+
+static void test_pause_resume_and_slots(void)
+{
+    probe_t probe = {.tag = 'p'};
+    sensor_id_t id = add("paused", 0, 0, NULL, &probe);
+    sim_run_for(1000);
+    TEST_ASSERT_EQUAL_UINT32(0, probe.runs);
+
+    TEST_ASSERT_EQUAL(ESP_OK, sensor_scheduler_set_period(id, 50));
+    sim_run_for(500);
+    TEST_ASSERT_EQUAL_UINT32(10, probe.runs);
+    TEST_ASSERT_EQUAL(ESP_OK, sensor_scheduler_set_period(id, 0));
+    sim_run_for(500);
+    TEST_ASSERT_EQUAL_UINT32(10, probe.runs);
+
+    probe_t fill = {.tag = 'f'};
+    for (int i = 1; i < SENSOR_SCHEDULER_MAX_SENSORS; i++) {
+        add("fill", 1000, 0, NULL, &fill);
+    }
+    const sensor_desc_t extra = {.name = "extra", .period_ms = 100, .sample = probe_sample, .ctx = &probe};
+    sensor_id_t extra_id;
+    TEST_ASSERT_EQUAL(ESP_ERR_NO_MEM, sensor_scheduler_register(&extra, &extra_id));
+    TEST_ASSERT_EQUAL(ESP_OK, sensor_scheduler_unregister(id));
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_FOUND, sensor_scheduler_set_period(id, 100));
+    TEST_ASSERT_EQUAL(ESP_OK, sensor_scheduler_register(&extra, &extra_id));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, sensor_scheduler_set_period(SENSOR_SCHEDULER_MAX_SENSORS, 100));
+}
+
+static void test_release_runs_paused_and_restarts_period(void)
+{
+    probe_t paused = {.tag = 'p'};
+    probe_t periodic = {.tag = 'q'};
+    sensor_id_t paused_id = add("paused", 0, 0, NULL, &paused);
+    sensor_id_t periodic_id = add("periodic", 100, 0, NULL, &periodic);
+
+    sim_run_for(50);
+    TEST_ASSERT_EQUAL(ESP_OK, sensor_scheduler_release(paused_id));
+    TEST_ASSERT_EQUAL(ESP_OK, sensor_scheduler_release(periodic_id));
+    sim_run_for(1);
+    TEST_ASSERT_EQUAL_UINT32(1, paused.runs);
+    TEST_ASSERT_EQUAL_UINT32(1, periodic.runs);
+
+    /* Next periodic run 100 ms after the release, not at the old 100 ms phase; the paused one stays paused */
+    sim_run_for(98);
+    TEST_ASSERT_EQUAL_UINT32(1, periodic.runs);
+    sim_run_for(2);
+    TEST_ASSERT_EQUAL_UINT32(2, periodic.runs);
+    sim_run_for(1000);
+    TEST_ASSERT_EQUAL_UINT32(1, paused.runs);
+
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, sensor_scheduler_release(SENSOR_SCHEDULER_MAX_SENSORS));
+}
+
+static bool door_safety_stats(sensor_stats_t *st)
+{
+    for (sensor_id_t i = 0; i < SENSOR_SCHEDULER_MAX_SENSORS; i++) {
+        if (sensor_scheduler_get_stats(i, st) == ESP_OK && strcmp(st->name, "door_safety") == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* The former 100 ms safety task: one table entry, and no wakeups while the door stands still */
+static void test_door_safety_check_runs_only_while_moving(void)
+{
+    sensor_scheduler_deinit();
+    fixture_boot(0);
+    uint32_t tasks = sim_task_count();
+    sensor_stats_t st;
+    TEST_ASSERT_TRUE(door_safety_stats(&st));
+    TEST_ASSERT_EQUAL_UINT32(0, st.runs);
+
+    sim_run_for(10000);
+    TEST_ASSERT_TRUE(door_safety_stats(&st));
+    TEST_ASSERT_EQUAL_UINT32(0, st.runs);
+
+    TEST_ASSERT_EQUAL(ESP_OK, garage_door_open());
+    sim_run_for(FIXTURE_TRAVEL_MS + 3000);
+    TEST_ASSERT_EQUAL(DOOR_STATE_OPEN, garage_door_get_state());
+    TEST_ASSERT_TRUE(door_safety_stats(&st));
+    uint32_t runs = st.runs;
+    TEST_ASSERT_TRUE(runs > 0);
+    TEST_ASSERT_EQUAL_UINT32(0, st.deadline_misses);
+
+    sim_run_for(10000);
+    TEST_ASSERT_TRUE(door_safety_stats(&st));
+    TEST_ASSERT_EQUAL_UINT32(runs, st.runs);
+    TEST_ASSERT_EQUAL_UINT32(tasks, sim_task_count());
+    fixture_shutdown();
+    TEST_ASSERT_EQUAL(ESP_OK, sensor_scheduler_init());
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_runs_on_period_without_lateness);
+    RUN_TEST(test_earliest_deadline_runs_first);
+    RUN_TEST(test_records_execution_time_and_misses);
+    RUN_TEST(test_overrun_drops_missed_releases);
+    RUN_TEST(test_batches_sensors_sharing_a_bus);
+    RUN_TEST(test_pause_resume_and_slots);
+    RUN_TEST(test_release_runs_paused_and_restarts_period);
+    RUN_TEST(test_door_safety_check_runs_only_while_moving);
+    return UNITY_END();
+}
@@ -0,0 +1,151 @@
+#include <stdio.h>
+#include <string.h>
+#include "unity.h"
+#include "garage_fixture.h"
+#include "garage_door_control.h"
+#include "span.h"
+
+#define RING_SIZE 1024 /* CONFIG_GARAGE_SPAN_RING_SIZE in the host sdkconfig.h */
+#define COMMIT_LATENCY_MS 40
+
+static span_record_t s_records[RING_SIZE];
+
+void setUp(void)
+{
+    span_clear();
+}
+
+void tearDown(void)
+{
+}
+
+/* A Matter command as matter_device_handle_command() runs it, from the test's own context */
+static uint16_t run_matter_open(void)
+{
+    fixture_boot(0);
+    sim_nvs_set_commit_latency(COMMIT_LATENCY_MS);
+    span_clear();
+
+    uint16_t prev = span_corr_enter();
+    uint16_t corr = span_corr_get();
+    span_record(SPAN_MATTER_COMMAND, SPAN_PHASE_BEGIN);
+    TEST_ASSERT_EQUAL(ESP_OK, garage_door_open());
+    span_record(SPAN_MATTER_COMMAND, SPAN_PHASE_END);
+    span_corr_set(prev);
+
+    sim_run_for(FIXTURE_TRAVEL_MS + FIXTURE_SETTLE_MS);
+    TEST_ASSERT_EQUAL(DOOR_STATE_OPEN, garage_door_get_state());
+    return corr;
+}
+
+static size_t find(size_t count, span_id_t id, span_phase_t phase, uint16_t corr, size_t from)
+{
+    for (size_t i = from; i < count; i++) {
+        if (s_records[i].id == id && s_records[i].phase == phase && s_records[i].corr == corr) {
+            return i;
+        }
+    }
+    return count;
+}
+
+static void test_records_format_and_clear(void)
+{
+    TEST_ASSERT_EQUAL_UINT32(0, span_corr_get());
+    uint16_t outer = span_corr_enter();
+    TEST_ASSERT_EQUAL_UINT32(0, outer);
+    uint16_t corr = span_corr_get();
+    TEST_ASSERT_TRUE(corr != 0);
+    /* A nested entry point keeps the command it runs for */
+    TEST_ASSERT_EQUAL_UINT32(corr, span_corr_enter());
+    TEST_ASSERT_EQUAL_UINT32(corr, span_corr_get());
+
+    span_record(SPAN_DOOR_COMMAND, SPAN_PHASE_BEGIN);
+    span_record(SPAN_RELAY_RELEASE, SPAN_PHASE_MARK);
+    span_record(SPAN_DOOR_COMMAND, SPAN_PHASE_END);
+    span_corr_set(outer);
+    TEST_ASSERT_EQUAL_UINT32(0, span_corr_get());
+
+    size_t count = span_snapshot(s_records, RING_SIZE);
+    TEST_ASSERT_EQUAL(3, count);
+    TEST_ASSERT_EQUAL_STRING("main", span_task_name(s_records[0].task));
+
+    char line[SPAN_LINE_MAX];
+    char expected[SPAN_LINE_MAX];
+    span_format(&s_records[1], line, sizeof(line));
+    snprintf(expected, sizeof(expected), "S %u M RELAY_RELEASE %u %u", (unsigned)s_records[1].timestamp_us, corr,
+             s_records[1].task);
+    TEST_ASSERT_EQUAL_STRING(expected, line);
+
+    span_clear();
+    TEST_ASSERT_EQUAL(0, span_snapshot(s_records, RING_SIZE));
+    for (int i = 0; i < RING_SIZE + 10; i++) {
+        span_record(SPAN_NVS_COMMIT, SPAN_PHASE_MARK);
+    }
+    TEST_ASSERT_EQUAL(RING_SIZE, span_snapshot(s_records, RING_SIZE));
+    TEST_ASSERT_EQUAL_UINT32(10, span_overwritten());
+}
+
+/* Every step of one command, on every task it reaches, carries the command's ID */
+static void test_command_lifecycle_is_correlated(void)
+{
+    uint16_t corr = run_matter_open();
+    size_t count = span_snapshot(s_records, RING_SIZE);
+    uint8_t command_task = s_records[0].task;
+
+    size_t cmd = find(count, SPAN_MATTER_COMMAND, SPAN_PHASE_BEGIN, corr, 0);
+    size_t door = find(count, SPAN_DOOR_COMMAND, SPAN_PHASE_BEGIN, corr, cmd);
+    size_t relay = find(count, SPAN_RELAY_ACTIVATE, SPAN_PHASE_END, corr, door);
+    size_t lock = find(count, SPAN_DOOR_LOCK, SPAN_PHASE_END, corr, relay);
+    size_t commit = find(count, SPAN_NVS_COMMIT, SPAN_PHASE_BEGIN, corr, lock);
+    size_t commit_end = find(count, SPAN_NVS_COMMIT, SPAN_PHASE_END, corr, commit);
+    size_t door_end = find(count, SPAN_DOOR_COMMAND, SPAN_PHASE_END, corr, commit_end);
+    size_t cmd_end = find(count, SPAN_MATTER_COMMAND, SPAN_PHASE_END, corr, door_end);
+    TEST_ASSERT_EQUAL(0, cmd);
+    TEST_ASSERT_TRUE(cmd_end < count);
+    TEST_ASSERT_UINT32_WITHIN(1000, COMMIT_LATENCY_MS * 1000,
+                              s_records[commit_end].timestamp_us - s_records[commit].timestamp_us);
+
+    /* The pulse end runs on the esp_timer task, the arrival at the end stop on whichever task sees it first */
+    size_t release = find(count, SPAN_RELAY_RELEASE, SPAN_PHASE_MARK, corr, cmd_end);
+    TEST_ASSERT_TRUE(release < count);
+    TEST_ASSERT_EQUAL_STRING("esp_timer", span_task_name(s_records[release].task));
+    size_t arrival = find(count, SPAN_DOOR_STATE, SPAN_PHASE_BEGIN, corr, release);
+    TEST_ASSERT_TRUE(arrival < count);
+    TEST_ASSERT_TRUE(s_records[arrival].task != command_task);
+    TEST_ASSERT_NOT_NULL(span_task_name(s_records[arrival].task));
+
+    /* Work after the motion ended belongs to no command, and the next command is a new one */
+    for (size_t i = arrival; i < count; i++) {
+        TEST_ASSERT_TRUE(s_records[i].corr == corr || s_records[i].corr == 0);
+    }
+    TEST_ASSERT_EQUAL_UINT32(0, span_corr_get());
+    span_clear();
+    TEST_ASSERT_EQUAL(ESP_OK, garage_door_close());
+    count = span_snapshot(s_records, RING_SIZE);
+    TEST_ASSERT_TRUE(count > 0);
+    TEST_ASSERT_TRUE(s_records[0].corr != 0 && s_records[0].corr != corr);
+
+    fixture_shutdown();
+    sim_nvs_set_commit_latency(0);
+}
+
+/* check_span_trace.py converts this dump with tools/span_trace.py */
+static void dump_matter_open(void)
+{
+    run_matter_open();
+    span_dump();
+    fixture_shutdown();
+    sim_nvs_set_commit_latency(0);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    if (argc > 1 && strcmp(argv[1], "--dump") == 0) {
+        RUN_TEST(dump_matter_open);
+        return UNITY_END();
+    }
+    RUN_TEST(test_records_format_and_clear);
+    RUN_TEST(test_command_lifecycle_is_correlated);
+    return UNITY_END();
+}
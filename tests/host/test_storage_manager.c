@@ -0,0 +1,155 @@
+#include <string.h>
+#include "unity.h"
+#include "sim.h"
+#include "nvs.h"
+#include "storage_manager.h"
+
+void setUp(void)
+{
+    sim_reset();
+    sim_nvs_erase_all();
+    TEST_ASSERT_EQUAL(ESP_OK, storage_init());
+}
+
+void tearDown(void)
+{
+    sim_nvs_inject_failure(0, ESP_OK, 0);
+}
+
+static void test_gpio_config_round_trip(void)
+{
+    const storage_gpio_config_t saved = {.reed_closed_pin = 5, .reed_open_pin = 6, .relay_pin = 7};
+    TEST_ASSERT_EQUAL(ESP_OK, storage_save_gpio_config(&saved));
+    storage_gpio_config_t loaded = {0};
+    TEST_ASSERT_EQUAL(ESP_OK, storage_load_gpio_config(&loaded));
+    TEST_ASSERT_EQUAL_MEMORY(&saved, &loaded, sizeof(saved));
+}
+
+static void test_missing_config_keeps_defaults(void)
+{
+    storage_relay_config_t config = {.pulse_duration_ms = 500, .max_pulse_duration_ms = 600, .min_interval_ms = 1000};
+    TEST_ASSERT_EQUAL(ESP_OK, storage_load_relay_config(&config));
+    TEST_ASSERT_EQUAL_UINT32(500, config.pulse_duration_ms);
+    TEST_ASSERT_EQUAL_UINT32(1000, config.min_interval_ms);
+
+    config.pulse_duration_ms = 250;
+    TEST_ASSERT_EQUAL(ESP_OK, storage_save_relay_config(&config));
+    storage_relay_config_t loaded = {0};
+    TEST_ASSERT_EQUAL(ESP_OK, storage_load_relay_config(&loaded));
+    TEST_ASSERT_EQUAL_UINT32(250, loaded.pulse_duration_ms);
+}
+
+static void test_door_state(void)
+{
+    uint32_t state = 0;
+    TEST_ASSERT_EQUAL(ESP_OK, storage_load_door_state(&state));
+    TEST_ASSERT_EQUAL_UINT32(STORAGE_DOOR_STATE_NONE, state);
+
+    uint32_t commits = sim_nvs_commit_count();
+    TEST_ASSERT_EQUAL(ESP_OK, storage_save_door_state(2));
+    TEST_ASSERT_EQUAL_UINT32(commits + 1, sim_nvs_commit_count());
+    TEST_ASSERT_EQUAL(ESP_OK, storage_load_door_state(&state));
+    TEST_ASSERT_EQUAL_UINT32(2, state);
+}
+
+static void test_event_log_in_order(void)
+{
+    sim_run_for(1000);
+    TEST_ASSERT_EQUAL(ESP_OK, storage_log_event(EVENT_TYPE_DOOR_OPEN, 0));
+    sim_run_for(1000);
+    TEST_ASSERT_EQUAL(ESP_OK, storage_log_event(EVENT_TYPE_TIMEOUT, 1));
+    TEST_ASSERT_EQUAL(ESP_OK, storage_log_event(EVENT_TYPE_OBSTRUCTION, 3));
+
+    event_log_t logs[8];
+    size_t count = 0;
+    TEST_ASSERT_EQUAL(ESP_OK, storage_get_logs(logs, 8, &count));
+    TEST_ASSERT_EQUAL_UINT32(3, count);
+    TEST_ASSERT_EQUAL(EVENT_TYPE_DOOR_OPEN, logs[0].type);
+    TEST_ASSERT_EQUAL(EVENT_TYPE_TIMEOUT, logs[1].type);
+    TEST_ASSERT_EQUAL_INT(1, logs[1].value);
+    TEST_ASSERT_EQUAL_UINT32(1000, logs[1].timestamp - logs[0].timestamp);
+
+    TEST_ASSERT_EQUAL(ESP_OK, storage_get_logs(logs, 2, &count));
+    TEST_ASSERT_EQUAL_UINT32(2, count);
+}
+
+static void test_wrapped_event_log_starts_at_oldest(void)
+{
+    /* The log keeps the last 100 events */
+    for (int32_t i = 0; i < 130; i++) {
+        TEST_ASSERT_EQUAL(ESP_OK, storage_log_event(EVENT_TYPE_RULE, i));
+    }
+
+    static event_log_t logs[128];
+    size_t count = 0;
+    TEST_ASSERT_EQUAL(ESP_OK, storage_get_logs(logs, 128, &count));
+    TEST_ASSERT_EQUAL_UINT32(100, count);
+    for (size_t i = 0; i < count; i++) {
+        TEST_ASSERT_EQUAL_INT(30 + (int32_t)i, logs[i].value);
+    }
+
+    uint32_t cursor = 0;
+    storage_export_record_t records[5];
+    size_t len = 0;
+    TEST_ASSERT_EQUAL(ESP_OK, storage_export_logs(&cursor, (uint8_t *)records, sizeof(records), &len, NULL));
+    TEST_ASSERT_EQUAL_UINT32(sizeof(records), len);
+    for (size_t i = 0; i < 5; i++) {
+        TEST_ASSERT_EQUAL_UINT32(30 + i, records[i].seq);
+        TEST_ASSERT_EQUAL_MEMORY(&logs[i], &records[i].log, sizeof(event_log_t));
+    }
+
+    /* Events dropping off the ring mid-export are skipped, not the ones after them */
+    for (int32_t i = 130; i < 140; i++) {
+        TEST_ASSERT_EQUAL(ESP_OK, storage_log_event(EVENT_TYPE_RULE, i));
+    }
+    TEST_ASSERT_EQUAL(ESP_OK, storage_export_logs(&cursor, (uint8_t *)records, sizeof(records), &len, NULL));
+    TEST_ASSERT_EQUAL_UINT32(40, records[0].seq);
+    TEST_ASSERT_EQUAL_INT(40, records[0].log.value);
+    TEST_ASSERT_EQUAL_UINT32(45, cursor);
+}
+
+static void test_write_failures_are_reported(void)
+{
+    sim_nvs_inject_failure(SIM_NVS_OP_COMMIT, ESP_ERR_NVS_NOT_ENOUGH_SPACE, 1);
+    TEST_ASSERT_EQUAL(ESP_ERR_NVS_NOT_ENOUGH_SPACE, storage_save_door_state(1));
+    TEST_ASSERT_EQUAL(ESP_OK, storage_save_door_state(1));
+
+    sim_nvs_inject_failure(SIM_NVS_OP_SET, ESP_ERR_NVS_NOT_ENOUGH_SPACE, 1);
+    TEST_ASSERT_EQUAL(ESP_ERR_NVS_NOT_ENOUGH_SPACE, storage_log_event(EVENT_TYPE_ERROR, 0));
+    event_log_t logs[4];
+    size_t count = 0;
+    TEST_ASSERT_EQUAL(ESP_OK, storage_get_logs(logs, 4, &count));
+    TEST_ASSERT_EQUAL_UINT32(0, count);
+}
+
+static void test_factory_reset_clears_everything(void)
+{
+    TEST_ASSERT_EQUAL(ESP_OK, storage_save_door_state(2));
+    TEST_ASSERT_EQUAL(ESP_OK, storage_log_event(EVENT_TYPE_DOOR_OPEN, 0));
+    TEST_ASSERT_EQUAL(ESP_OK, storage_factory_reset());
+    TEST_ASSERT_EQUAL_UINT32(0, sim_nvs_entry_count());
+    uint32_t state = 0;
+    TEST_ASSERT_EQUAL(ESP_OK, storage_load_door_state(&state));
+    TEST_ASSERT_EQUAL_UINT32(STORAGE_DOOR_STATE_NONE, state);
+}
+
+static void test_argument_checks(void)
+{
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, storage_save_gpio_config(NULL));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, storage_load_door_state(NULL));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, storage_get_logs(NULL, 1, NULL));
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_gpio_config_round_trip);
+    RUN_TEST(test_missing_config_keeps_defaults);
+    RUN_TEST(test_door_state);
+    RUN_TEST(test_event_log_in_order);
+    RUN_TEST(test_wrapped_event_log_starts_at_oldest);
+    RUN_TEST(test_write_failures_are_reported);
+    RUN_TEST(test_factory_reset_clears_everything);
+    RUN_TEST(test_argument_checks);
+    return UNITY_END();
+}
@@ -0,0 +1,328 @@
+#include <string.h>
+#include "unity.h"
+#include "esp_system.h"
+#include "nvs.h"
+#include "garage_fixture.h"
+#include "garage_door_control.h"
+#include "storage_manager.h"
+
+void setUp(void)
+{
+    sim_power_on();
+    sim_nvs_erase_all();
+    fixture_boot(0);
+}
+
+void tearDown(void)
+{
+    sim_nvs_inject_failure(0, ESP_OK, 0);
+    fixture_shutdown();
+}
+
+static storage_snapshot_info_t info(void)
+{
+    storage_snapshot_info_t info;
+    TEST_ASSERT_EQUAL(ESP_OK, storage_get_snapshot_info(&info));
+    return info;
+}
+
+static uint32_t next_seq(void)
+{
+    uint32_t oldest = 0;
+    uint32_t next = 0;
+    TEST_ASSERT_EQUAL(ESP_OK, storage_log_range(&oldest, &next));
+    return next;
+}
+
+static uint32_t door_state(void)
+{
+    uint32_t state = 0;
+    TEST_ASSERT_EQUAL(ESP_OK, storage_load_door_state(&state));
+    return state;
+}
+
+/* Storage alone through a reset of the given kind; the snapshot stays in RAM as on hardware */
+static void reboot(esp_reset_reason_t reason)
+{
+    TEST_ASSERT_EQUAL(ESP_OK, storage_deinit());
+    sim_set_reset_reason(reason);
+    TEST_ASSERT_EQUAL(ESP_OK, storage_init());
+}
+
+typedef struct {
+    event_type_t types[8];
+    uint32_t seqs[8];
+    size_t count;
+} visited_t;
+
+static bool collect(uint32_t seq, const event_log_t *log, void *ctx)
+{
+    visited_t *v = ctx;
+    v->types[v->count] = log->type;
+    v->seqs[v->count++] = seq;
+    return v->count < 8;
+}
+
+static visited_t visit_from(uint32_t cursor)
+{
+    visited_t v = {0};
+    TEST_ASSERT_EQUAL(ESP_OK, storage_visit_logs(&cursor, collect, &v));
+    return v;
+}
+
+static void test_door_cycle_costs_no_commit(void)
+{
+    /* The first run learns the opener's start delay, which is committed */
+    TEST_ASSERT_EQUAL(ESP_OK, garage_door_open());
+    sim_run_for(FIXTURE_TRAVEL_MS + 2000);
+    TEST_ASSERT_EQUAL(DOOR_STATE_OPEN, garage_door_get_state());
+
+    uint32_t commits = sim_nvs_commit_count();
+    TEST_ASSERT_EQUAL(ESP_OK, garage_door_close());
+    sim_run_for(FIXTURE_TRAVEL_MS + 2000);
+    TEST_ASSERT_EQUAL(DOOR_STATE_CLOSED, garage_door_get_state());
+    TEST_ASSERT_EQUAL_UINT32(commits, sim_nvs_commit_count());
+    TEST_ASSERT_EQUAL_UINT32(DOOR_STATE_CLOSED, door_state());
+
+    storage_snapshot_info_t before = info();
+    TEST_ASSERT_TRUE(before.state_dirty);
+    TEST_ASSERT_EQUAL_UINT32(2, before.pending_events);
+    /* Five transitions from the reconciled boot state and two events */
+    TEST_ASSERT_EQUAL_UINT32(7, before.deferred_writes);
+
+    /* Everything in one commit, and nothing to write the second time */
+    TEST_ASSERT_EQUAL(ESP_OK, storage_checkpoint());
+    TEST_ASSERT_EQUAL_UINT32(commits + 1, sim_nvs_commit_count());
+    TEST_ASSERT_EQUAL(ESP_OK, storage_checkpoint());
+    TEST_ASSERT_EQUAL_UINT32(commits + 1, sim_nvs_commit_count());
+    storage_snapshot_info_t after = info();
+    TEST_ASSERT_TRUE(!after.state_dirty);
+    TEST_ASSERT_EQUAL_UINT32(0, after.pending_events);
+    TEST_ASSERT_EQUAL_UINT32(before.checkpoints + 1, after.checkpoints);
+}
+
+static void test_warm_boot_restores_without_flash(void)
+{
+    TEST_ASSERT_EQUAL(ESP_OK, storage_save_door_state(DOOR_STATE_OPEN));
+    TEST_ASSERT_EQUAL(ESP_OK, storage_log_event(EVENT_TYPE_DOOR_OPEN, 0));
+    uint32_t next = next_seq();
+
+    uint32_t reads = sim_nvs_read_count();
+    reboot(ESP_RST_TASK_WDT);
+    TEST_ASSERT_EQUAL_UINT32(reads, sim_nvs_read_count());
+    storage_snapshot_info_t snap = info();
+    TEST_ASSERT_TRUE(snap.restored);
+    TEST_ASSERT_EQUAL_UINT32(1, snap.warm_boots);
+    TEST_ASSERT_EQUAL_UINT32(1, snap.pending_events);
+    TEST_ASSERT_EQUAL_UINT32(DOOR_STATE_OPEN, door_state());
+    TEST_ASSERT_EQUAL_UINT32(next, next_seq());
+}
+
+static void test_pending_events_keep_sequence(void)
+{
+    uint32_t first = next_seq();
+    uint32_t commits = sim_nvs_commit_count();
+    TEST_ASSERT_EQUAL(ESP_OK, storage_log_event(EVENT_TYPE_DOOR_OPEN, 0));
+    TEST_ASSERT_EQUAL(ESP_OK, storage_log_event(EVENT_TYPE_RULE, 0x0102));
+    TEST_ASSERT_EQUAL(ESP_OK, storage_log_event(EVENT_TYPE_DOOR_CLOSED, 0));
+    /* The first event after a cold boot reserves the ring's numbers */
+    TEST_ASSERT_EQUAL_UINT32(commits + 1, sim_nvs_commit_count());
+    TEST_ASSERT_EQUAL_UINT32(first + 3, next_seq());
+
+    visited_t pending = visit_from(first);
+    TEST_ASSERT_EQUAL_UINT32(3, pending.count);
+    TEST_ASSERT_EQUAL(EVENT_TYPE_RULE, pending.types[1]);
+    TEST_ASSERT_EQUAL_UINT32(first + 2, pending.seqs[2]);
+
+    /* Same numbers and contents from flash */
+    TEST_ASSERT_EQUAL(ESP_OK, storage_checkpoint());
+    visited_t stored = visit_from(first);
+    TEST_ASSERT_EQUAL_UINT32(3, stored.count);
+    TEST_ASSERT_EQUAL_MEMORY(&pending, &stored, sizeof(pending));
+    TEST_ASSERT_EQUAL_UINT32(first + 3, next_seq());
+}
+
+static void test_full_ring_checkpoints(void)
+{
+    TEST_ASSERT_EQUAL(ESP_OK, storage_checkpoint());
+    uint32_t commits = sim_nvs_commit_count();
+    for (int i = 0; i < STORAGE_PENDING_EVENTS; i++) {
+        TEST_ASSERT_EQUAL(ESP_OK, storage_log_event(EVENT_TYPE_RULE, i));
+    }
+    TEST_ASSERT_EQUAL_UINT32(commits + 1, sim_nvs_commit_count());
+    /* The checkpoint reserves the next ring's numbers in the same commit */
+    TEST_ASSERT_EQUAL(ESP_OK, storage_log_event(EVENT_TYPE_RULE, STORAGE_PENDING_EVENTS));
+    TEST_ASSERT_EQUAL_UINT32(commits + 2, sim_nvs_commit_count());
+    TEST_ASSERT_EQUAL_UINT32(1, info().pending_events);
+
+    /* A failed checkpoint keeps the event out rather than dropping an older one */
+    for (int i = 1; i < STORAGE_PENDING_EVENTS; i++) {
+        TEST_ASSERT_EQUAL(ESP_OK, storage_log_event(EVENT_TYPE_RULE, i));
+    }
+    uint32_t next = next_seq();
+    sim_nvs_inject_failure(SIM_NVS_OP_COMMIT, ESP_ERR_NVS_NOT_ENOUGH_SPACE, 1);
+    TEST_ASSERT_TRUE(storage_log_event(EVENT_TYPE_RULE, 0) != ESP_OK);
+    TEST_ASSERT_EQUAL_UINT32(next, next_seq());
+    TEST_ASSERT_EQUAL_UINT32(STORAGE_PENDING_EVENTS, info().pending_events);
+}
+
+static void test_fault_event_writes_through(void)
+{
+    uint32_t first = next_seq();
+    uint32_t commits = sim_nvs_commit_count();
+    TEST_ASSERT_EQUAL(ESP_OK, storage_log_event(EVENT_TYPE_DOOR_OPEN, 0));
+    TEST_ASSERT_EQUAL(ESP_OK, storage_log_event(EVENT_TYPE_TIMEOUT, DOOR_STATE_OPENING));
+    TEST_ASSERT_EQUAL_UINT32(commits + 2, sim_nvs_commit_count()); /* Reservation, then both events */
+    TEST_ASSERT_EQUAL_UINT32(0, info().pending_events);
+
+    /* Both survive a power loss, in order */
+    sim_power_on();
+    reboot(ESP_RST_POWERON);
+    visited_t v = visit_from(first);
+    TEST_ASSERT_EQUAL_UINT32(2, v.count);
+    TEST_ASSERT_EQUAL(EVENT_TYPE_DOOR_OPEN, v.types[0]);
+    TEST_ASSERT_EQUAL(EVENT_TYPE_TIMEOUT, v.types[1]);
+}
+
+static void test_power_loss_falls_back_to_checkpoint(void)
+{
+    TEST_ASSERT_EQUAL(ESP_OK, storage_save_door_state(DOOR_STATE_OPEN));
+    TEST_ASSERT_EQUAL(ESP_OK, storage_checkpoint());
+    uint32_t next = next_seq();
+    TEST_ASSERT_EQUAL(ESP_OK, storage_save_door_state(DOOR_STATE_CLOSING));
+    TEST_ASSERT_EQUAL(ESP_OK, storage_log_event(EVENT_TYPE_DOOR_CLOSED, 0));
+
+    sim_power_on();
+    reboot(ESP_RST_POWERON);
+    storage_snapshot_info_t snap = info();
+    TEST_ASSERT_TRUE(!snap.restored);
+    TEST_ASSERT_EQUAL_UINT32(0, snap.warm_boots);
+    TEST_ASSERT_EQUAL_UINT32(0, snap.pending_events);
+    TEST_ASSERT_EQUAL_UINT32(DOOR_STATE_OPEN, door_state());
+    /* The lost event's number, and the rest reserved with it, are not handed out again */
+    TEST_ASSERT_EQUAL_UINT32(next + STORAGE_PENDING_EVENTS, next_seq());
+
+    /* A brownout leaves RAM as unreliable as a power-on */
+    TEST_ASSERT_EQUAL(ESP_OK, storage_save_door_state(DOOR_STATE_CLOSING));
+    reboot(ESP_RST_BROWNOUT);
+    TEST_ASSERT_TRUE(!info().restored);
+    TEST_ASSERT_EQUAL_UINT32(DOOR_STATE_OPEN, door_state());
+}
+
+static void test_power_loss_never_reuses_numbers(void)
+{
+    /* Wrap the flash ring, so every slot holds an older entry */
+    for (int i = 0; i < 120; i++) {
+        TEST_ASSERT_EQUAL(ESP_OK, storage_log_event(EVENT_TYPE_RULE, i));
+    }
+    TEST_ASSERT_EQUAL(ESP_OK, storage_checkpoint());
+    uint32_t first = next_seq();
+    TEST_ASSERT_EQUAL(ESP_OK, storage_log_event(EVENT_TYPE_DOOR_OPEN, 0));
+    TEST_ASSERT_EQUAL(ESP_OK, storage_log_event(EVENT_TYPE_DOOR_CLOSED, 0));
+    visited_t seen = visit_from(first);
+    TEST_ASSERT_EQUAL_UINT32(2, seen.count);
+
+    sim_power_on();
+    reboot(ESP_RST_POWERON);
+    /* The numbers seen are gaps now, not the entries a lap older in their slots */
+    TEST_ASSERT_EQUAL_UINT32(0, visit_from(first).count);
+    TEST_ASSERT_EQUAL(ESP_OK, storage_log_event(EVENT_TYPE_RULE, 0x0203));
+    TEST_ASSERT_EQUAL(ESP_OK, storage_log_event(EVENT_TYPE_TIMEOUT, DOOR_STATE_CLOSING));
+    visited_t after = visit_from(first);
+    TEST_ASSERT_EQUAL_UINT32(2, after.count);
+    for (size_t i = 0; i < after.count; i++) {
+        TEST_ASSERT_GREATER_OR_EQUAL_UINT32(seen.seqs[seen.count - 1] + 1, after.seqs[i]);
+    }
+    TEST_ASSERT_EQUAL(EVENT_TYPE_RULE, after.types[0]);
+
+    /* Again after the new events reached flash, and across a second power loss */
+    sim_power_on();
+    reboot(ESP_RST_POWERON);
+    visited_t last = visit_from(first);
+    TEST_ASSERT_EQUAL_MEMORY(&after, &last, sizeof(after));
+    TEST_ASSERT_EQUAL(ESP_OK, storage_log_event(EVENT_TYPE_DOOR_OPEN, 0));
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(after.seqs[1] + 1, next_seq() - 1);
+}
+
+static void test_corrupt_snapshot_falls_back(void)
+{
+    TEST_ASSERT_EQUAL(ESP_OK, storage_save_door_state(DOOR_STATE_OPEN));
+    TEST_ASSERT_EQUAL(ESP_OK, storage_checkpoint());
+    TEST_ASSERT_EQUAL(ESP_OK, storage_save_door_state(DOOR_STATE_CLOSING));
+
+    TEST_ASSERT_EQUAL(ESP_OK, storage_deinit());
+    sim_noinit_flip_bit(100);
+    sim_set_reset_reason(ESP_RST_PANIC);
+    TEST_ASSERT_EQUAL(ESP_OK, storage_init());
+    TEST_ASSERT_TRUE(!info().restored);
+    TEST_ASSERT_EQUAL_UINT32(DOOR_STATE_OPEN, door_state());
+}
+
+static void test_restart_checkpoints(void)
+{
+    TEST_ASSERT_EQUAL(ESP_OK, storage_save_door_state(DOOR_STATE_OPEN));
+    TEST_ASSERT_EQUAL(ESP_OK, storage_log_event(EVENT_TYPE_DOOR_OPEN, 0));
+    uint32_t commits = sim_nvs_commit_count();
+    esp_restart();
+    TEST_ASSERT_EQUAL_UINT32(commits + 1, sim_nvs_commit_count());
+    storage_snapshot_info_t snap = info();
+    TEST_ASSERT_TRUE(!snap.state_dirty);
+    TEST_ASSERT_EQUAL_UINT32(0, snap.pending_events);
+}
+
+static void test_transition_history(void)
+{
+    /* The boot reconciled the unknown state to closed */
+    storage_snapshot_info_t snap = info();
+    TEST_ASSERT_EQUAL_UINT32(1, snap.transition_count);
+    TEST_ASSERT_EQUAL_UINT32(DOOR_STATE_CLOSED, snap.transitions[0].state);
+
+    TEST_ASSERT_EQUAL(ESP_OK, storage_save_door_state(DOOR_STATE_OPENING));
+    TEST_ASSERT_EQUAL(ESP_OK, storage_save_door_state(DOOR_STATE_OPENING));
+    reboot(ESP_RST_SW);
+    sim_run_for(500);
+    TEST_ASSERT_EQUAL(ESP_OK, storage_save_door_state(DOOR_STATE_OPEN));
+    snap = info();
+    TEST_ASSERT_EQUAL_UINT32(3, snap.transition_count);
+    TEST_ASSERT_EQUAL_UINT32(DOOR_STATE_OPENING, snap.transitions[1].state);
+    TEST_ASSERT_EQUAL_UINT32(0, snap.transitions[1].boot);
+    TEST_ASSERT_EQUAL_UINT32(DOOR_STATE_OPEN, snap.transitions[2].state);
+    TEST_ASSERT_EQUAL_UINT32(1, snap.transitions[2].boot);
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(snap.transitions[1].timestamp + 500, snap.transitions[2].timestamp);
+
+    /* Oldest first once the ring wraps */
+    for (uint32_t i = 0; i < STORAGE_TRANSITIONS + 2; i++) {
+        TEST_ASSERT_EQUAL(ESP_OK, storage_save_door_state(i % 2 ? DOOR_STATE_CLOSING : DOOR_STATE_CLOSED));
+    }
+    snap = info();
+    TEST_ASSERT_EQUAL_UINT32(STORAGE_TRANSITIONS, snap.transition_count);
+    TEST_ASSERT_EQUAL_UINT32(DOOR_STATE_CLOSED, snap.transitions[0].state);
+    TEST_ASSERT_EQUAL_UINT32(DOOR_STATE_CLOSING, snap.transitions[STORAGE_TRANSITIONS - 1].state);
+}
+
+static void test_factory_reset_reseeds(void)
+{
+    TEST_ASSERT_EQUAL(ESP_OK, storage_save_door_state(DOOR_STATE_OPEN));
+    TEST_ASSERT_EQUAL(ESP_OK, storage_log_event(EVENT_TYPE_DOOR_OPEN, 0));
+    TEST_ASSERT_EQUAL(ESP_OK, storage_factory_reset());
+    TEST_ASSERT_EQUAL_UINT32(STORAGE_DOOR_STATE_NONE, door_state());
+    TEST_ASSERT_EQUAL_UINT32(0, next_seq());
+    TEST_ASSERT_EQUAL_UINT32(0, info().pending_events);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_door_cycle_costs_no_commit);
+    RUN_TEST(test_warm_boot_restores_without_flash);
+    RUN_TEST(test_pending_events_keep_sequence);
+    RUN_TEST(test_full_ring_checkpoints);
+    RUN_TEST(test_fault_event_writes_through);
+    RUN_TEST(test_power_loss_falls_back_to_checkpoint);
+    RUN_TEST(test_power_loss_never_reuses_numbers);
+    RUN_TEST(test_corrupt_snapshot_falls_back);
+    RUN_TEST(test_restart_checkpoints);
+    RUN_TEST(test_transition_history);
+    RUN_TEST(test_factory_reset_reseeds);
+    return UNITY_END();
+}
@@ -0,0 +1,207 @@
+#include <stdio.h>
+#include <string.h>
+#include "unity.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "garage_fixture.h"
+#include "mem_budget.h"
+#include "task_profile.h"
+
+#define PERIOD_MS 1000
+
+typedef struct {
+    uint32_t busy_ms;  /* Of every 100 ms */
+} worker_t;
+
+static worker_t s_hog = {.busy_ms = 20};
+static worker_t s_light = {.busy_ms = 2};
+static esp_timer_handle_t s_timer;
+
+static void worker_task(void *arg)
+{
+    const worker_t *w = arg;
+    while (true) {
+        sim_task_busy_us(w->busy_ms * 1000);
+        vTaskDelay(pdMS_TO_TICKS(100 - w->busy_ms));
+    }
+}
+
+static void idle_task(void *arg)
+{
+    while (true) {
+        vTaskDelay(pdMS_TO_TICKS(1000));
+    }
+}
+
+/* 5 ms of every 100 ms in the esp_timer task */
+static void busy_callback(void *arg)
+{
+    sim_task_busy_us(5000);
+}
+
+void setUp(void)
+{
+    fixture_boot(0);
+    s_timer = NULL;
+}
+
+void tearDown(void)
+{
+    task_profile_deinit();
+    if (s_timer) {
+        esp_timer_stop(s_timer);
+        esp_timer_delete(s_timer);
+    }
+    fixture_shutdown();
+}
+
+static TaskHandle_t spawn(const char *name, TaskFunction_t fn, void *arg)
+{
+    TaskHandle_t task = NULL;
+    TEST_ASSERT_EQUAL(pdPASS, xTaskCreate(fn, name, 2048, arg, 5, &task));
+    return task;
+}
+
+/* Slot of the task in the latest sample, -1 if not there */
+static int find(const char *name, task_profile_task_t *task)
+{
+    for (size_t i = 0; i < TASK_PROFILE_MAX_TASKS; i++) {
+        if (task_profile_get_task(i, task) == ESP_OK && strcmp(task->name, name) == 0) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+static void test_cpu_shares(void)
+{
+    spawn("hog", worker_task, &s_hog);
+    spawn("light", worker_task, &s_light);
+    const esp_timer_create_args_t args = {.callback = busy_callback, .name = "busy"};
+    TEST_ASSERT_EQUAL(ESP_OK, esp_timer_create(&args, &s_timer));
+    TEST_ASSERT_EQUAL(ESP_OK, esp_timer_start_periodic(s_timer, 100 * 1000));
+
+    TEST_ASSERT_EQUAL(ESP_OK, task_profile_init(PERIOD_MS));
+    sim_run_for(10 * PERIOD_MS + 50);
+
+    task_profile_task_t hog, light;
+    int hog_slot = find("hog", &hog);
+    TEST_ASSERT_TRUE(hog_slot >= 0);
+    TEST_ASSERT_TRUE(find("light", &light) >= 0);
+    TEST_ASSERT_TRUE(hog.alive);
+    printf("hog %u, light %u permille\n", hog.cpu_permille, light.cpu_permille);
+    TEST_ASSERT_UINT32_WITHIN(10, 200, hog.cpu_permille);
+    TEST_ASSERT_UINT32_WITHIN(5, 20, light.cpu_permille);
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(hog.cpu_permille, hog.cpu_peak_permille);
+
+    task_profile_sample_t sample;
+    TEST_ASSERT_EQUAL(ESP_OK, task_profile_get_sample(0, &sample));
+    TEST_ASSERT_EQUAL_UINT32(PERIOD_MS, sample.period_ms);
+    TEST_ASSERT_UINT32_WITHIN(5, 50, sample.timer_permille);
+    /* The fixture's own tasks do not spend simulated CPU time */
+    TEST_ASSERT_UINT32_WITHIN(15, 270, sample.busy_permille);
+    TEST_ASSERT_EQUAL(hog.cpu_permille, sample.task_permille[hog_slot]);
+
+    task_profile_report();
+}
+
+static void test_stack_high_water(void)
+{
+    TaskHandle_t hog = spawn("hog", worker_task, &s_hog);
+    TEST_ASSERT_EQUAL(ESP_OK, mem_budget_register_task("test", hog, 3072));
+    sim_task_set_stack_free(hog, 1000);
+    TEST_ASSERT_EQUAL(ESP_OK, task_profile_init(PERIOD_MS));
+
+    task_profile_task_t task;
+    TEST_ASSERT_TRUE(find("hog", &task) >= 0);
+    TEST_ASSERT_EQUAL_UINT32(3072, task.stack_bytes);
+    TEST_ASSERT_EQUAL_UINT32(1000, task.stack_free_min);
+
+    /* Below the warning threshold, then recovering: the minimum is kept */
+    sim_task_set_stack_free(hog, TASK_PROFILE_STACK_WARN_BYTES - 56);
+    sim_run_for(PERIOD_MS);
+    sim_task_set_stack_free(hog, 1500);
+    sim_run_for(PERIOD_MS);
+    TEST_ASSERT_TRUE(find("hog", &task) >= 0);
+    TEST_ASSERT_EQUAL_UINT32(TASK_PROFILE_STACK_WARN_BYTES - 56, task.stack_free_min);
+
+    /* ESP-IDF's esp_timer task is sized from sdkconfig */
+    TEST_ASSERT_TRUE(find("esp_timer", &task) >= 0);
+    TEST_ASSERT_EQUAL_UINT32(CONFIG_ESP_TIMER_TASK_STACK_SIZE, task.stack_bytes);
+    /* A task nobody registered */
+    spawn("stranger", idle_task, NULL);
+    TEST_ASSERT_EQUAL(ESP_OK, task_profile_sample());
+    TEST_ASSERT_TRUE(find("stranger", &task) >= 0);
+    TEST_ASSERT_EQUAL_UINT32(0, task.stack_bytes);
+    TEST_ASSERT_EQUAL_UINT32(2048, task.stack_free_min);
+
+    mem_budget_unregister_task(hog);
+}
+
+static void test_history_ring(void)
+{
+    TEST_ASSERT_EQUAL(ESP_OK, task_profile_init(PERIOD_MS));
+    task_profile_sample_t sample;
+    TEST_ASSERT_EQUAL(ESP_OK, task_profile_get_sample(0, &sample));
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_FOUND, task_profile_get_sample(1, &sample));
+
+    sim_run_for(2 * CONFIG_GARAGE_TASK_PROFILE_HISTORY * PERIOD_MS + 50);
+    TEST_ASSERT_EQUAL(ESP_OK, task_profile_get_sample(CONFIG_GARAGE_TASK_PROFILE_HISTORY - 1, &sample));
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_FOUND, task_profile_get_sample(CONFIG_GARAGE_TASK_PROFILE_HISTORY, &sample));
+
+    /* Newest first, one period apart */
+    task_profile_sample_t newer;
+    for (size_t age = 0; age + 1 < CONFIG_GARAGE_TASK_PROFILE_HISTORY; age++) {
+        TEST_ASSERT_EQUAL(ESP_OK, task_profile_get_sample(age, &newer));
+        TEST_ASSERT_EQUAL(ESP_OK, task_profile_get_sample(age + 1, &sample));
+        TEST_ASSERT_EQUAL_UINT32(sample.uptime_s + PERIOD_MS / 1000, newer.uptime_s);
+    }
+}
+
+static void test_deleted_task_keeps_slot(void)
+{
+    TaskHandle_t gone = spawn("gone", worker_task, &s_hog);
+    TEST_ASSERT_EQUAL(ESP_OK, task_profile_init(PERIOD_MS));
+    sim_run_for(PERIOD_MS);
+    task_profile_task_t task;
+    int slot = find("gone", &task);
+    TEST_ASSERT_TRUE(slot >= 0);
+    TEST_ASSERT_TRUE(task.alive);
+
+    vTaskDelete(gone);
+    spawn("new", idle_task, NULL);
+    sim_run_for(PERIOD_MS);
+    TEST_ASSERT_EQUAL(slot, find("gone", &task));
+    TEST_ASSERT_TRUE(!task.alive);
+    TEST_ASSERT_EQUAL(0, task.cpu_permille);
+    TEST_ASSERT_UINT32_WITHIN(10, 200, task.cpu_peak_permille);
+    int new_slot = find("new", &task);
+    TEST_ASSERT_TRUE(new_slot >= 0 && new_slot != slot);
+    TEST_ASSERT_TRUE(task.alive);
+}
+
+static void test_init_checks(void)
+{
+    task_profile_sample_t sample;
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, task_profile_get_sample(0, &sample));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, task_profile_sample());
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, task_profile_init(0));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, task_profile_init(TASK_PROFILE_MAX_PERIOD_MS + 1));
+    TEST_ASSERT_EQUAL(ESP_OK, task_profile_init(PERIOD_MS));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, task_profile_init(PERIOD_MS));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_ARG, task_profile_get_task(TASK_PROFILE_MAX_TASKS, &(task_profile_task_t){0}));
+    TEST_ASSERT_EQUAL(ESP_OK, task_profile_deinit());
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, task_profile_deinit());
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_cpu_shares);
+    RUN_TEST(test_stack_high_water);
+    RUN_TEST(test_history_ring);
+    RUN_TEST(test_deleted_task_keeps_slot);
+    RUN_TEST(test_init_checks);
+    return UNITY_END();
+}
@@ -0,0 +1,265 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "unity.h"
+#include "garage_fixture.h"
+#include "garage_door_control.h"
+#include "tilt_angle.h"
+#include "tilt_sensor.h"
+
+#define INT_PIN GPIO_NUM_12
+#define SDA_PIN GPIO_NUM_6
+#define SCL_PIN GPIO_NUM_7
+/* The simulated panel is off from the driver's defaults (0 and 9000) until the reeds calibrate it */
+#define SIM_CLOSED_CDEG -500
+#define SIM_OPEN_CDEG   7500
+
+static uint32_t s_updates;
+static uint8_t s_last_percent;
+
+static void on_position(uint8_t percent)
+{
+    s_updates++;
+    s_last_percent = percent;
+}
+
+static void on_door_state(door_state_t state)
+{
+    tilt_sensor_set_moving(state == DOOR_STATE_OPENING || state == DOOR_STATE_CLOSING);
+}
+
+static const tilt_sensor_config_t s_config = {
+    .sda_pin = SDA_PIN,
+    .scl_pin = SCL_PIN,
+    .int_pin = INT_PIN,
+};
+
+static void attach_accel(void)
+{
+    const sim_accel_config_t accel = {
+        .address = 0x18,
+        .int_pin = INT_PIN,
+        .closed_cdeg = SIM_CLOSED_CDEG,
+        .open_cdeg = SIM_OPEN_CDEG,
+    };
+    sim_accel_attach(&accel);
+}
+
+void setUp(void)
+{
+    fixture_boot(0);
+    attach_accel();
+    s_updates = 0;
+    s_last_percent = 0;
+    TEST_ASSERT_EQUAL(ESP_OK, tilt_sensor_init(&s_config));
+    TEST_ASSERT_EQUAL(ESP_OK, tilt_sensor_register_callback(on_position));
+    TEST_ASSERT_EQUAL(ESP_OK, garage_door_register_state_callback(on_door_state));
+}
+
+void tearDown(void)
+{
+    tilt_sensor_deinit();
+    fixture_shutdown();
+}
+
+static uint8_t position(void)
+{
+    uint8_t percent = 0;
+    TEST_ASSERT_EQUAL(ESP_OK, tilt_sensor_get_position(&percent));
+    return percent;
+}
+
+/* Runs a full open and a rest at each end so the reeds calibrate both end stops */
+static void calibrate_by_cycling(void)
+{
+    sim_run_for(2000);
+    TEST_ASSERT_EQUAL(ESP_OK, garage_door_open());
+    sim_run_for(FIXTURE_TRAVEL_MS + 3000);
+    TEST_ASSERT_EQUAL(100, position());
+    TEST_ASSERT_TRUE(abs(tilt_sensor_angle_cdeg() - SIM_OPEN_CDEG) <= 50);
+}
+
+static void test_cordic_matches_atan2(void)
+{
+    int32_t worst = 0;
+    for (int deg = -179; deg <= 180; deg += 7) {
+        for (int32_t magnitude = 16; magnitude <= 800000; magnitude *= 10) {
+            double rad = deg * M_PI / 180.0;
+            int32_t along = (int32_t)lround(magnitude * cos(rad));
+            int32_t normal = (int32_t)lround(magnitude * sin(rad));
+            int32_t expected = (int32_t)lround(atan2(normal, along) * 18000.0 / M_PI);
+            int32_t error = tilt_angle_cdeg(along, normal) - expected;
+            if (error > 18000) {
+                error -= 36000; /* +/-180 degrees are the same angle */
+            } else if (error < -18000) {
+                error += 36000;
+            }
+            error = error < 0 ? -error : error;
+            worst = error > worst ? error : worst;
+        }
+    }
+    printf("worst CORDIC error %ld cdeg\n", (long)worst);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(2, worst);
+    TEST_ASSERT_EQUAL(0, tilt_angle_cdeg(0, 0));
+}
+
+static void test_fifo_burst_is_averaged(void)
+{
+    /* Two samples either side of 45 degrees average to it */
+    uint8_t fifo[2 * TILT_SAMPLE_BYTES] = {0};
+    const int16_t raw[2][2] = {{11000, 9000}, {9000, 11000}};
+    for (int i = 0; i < 2; i++) {
+        uint8_t *sample = &fifo[i * TILT_SAMPLE_BYTES];
+        sample[0] = (uint8_t)raw[i][0];
+        sample[1] = (uint8_t)(raw[i][0] >> 8);
+        sample[4] = (uint8_t)raw[i][1];
+        sample[5] = (uint8_t)(raw[i][1] >> 8);
+    }
+    TEST_ASSERT_UINT32_WITHIN(1, 4500, tilt_angle_from_fifo(fifo, 2));
+}
+
+static void test_angle_maps_to_percent(void)
+{
+    TEST_ASSERT_EQUAL(0, tilt_angle_to_percent(0, 0, 9000));
+    TEST_ASSERT_EQUAL(50, tilt_angle_to_percent(4500, 0, 9000));
+    TEST_ASSERT_EQUAL(100, tilt_angle_to_percent(9000, 0, 9000));
+    /* Clamped outside the end stops */
+    TEST_ASSERT_EQUAL(0, tilt_angle_to_percent(-300, 0, 9000));
+    TEST_ASSERT_EQUAL(100, tilt_angle_to_percent(9400, 0, 9000));
+    /* A sensor mounted the other way round */
+    TEST_ASSERT_EQUAL(25, tilt_angle_to_percent(-2250, 0, -9000));
+    TEST_ASSERT_EQUAL(0, tilt_angle_to_percent(4500, 1000, 1000));
+}
+
+static void test_position_follows_door(void)
+{
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, tilt_sensor_get_position(&(uint8_t){0}));
+    sim_run_for(2000);
+    TEST_ASSERT_EQUAL(0, position());
+
+    calibrate_by_cycling();
+    TEST_ASSERT_EQUAL(ESP_OK, garage_door_close());
+    uint32_t worst = 0;
+    for (int i = 0; i < FIXTURE_TRAVEL_MS / 500 - 2; i++) {
+        sim_run_for(500);
+        int32_t error = (int32_t)position() - (int32_t)sim_door_position() / 10;
+        error = error < 0 ? -error : error;
+        worst = (uint32_t)error > worst ? (uint32_t)error : worst;
+    }
+    printf("worst lag while closing %lu%%\n", (unsigned long)worst);
+    /* A 200 ms burst is 1.7% of travel, plus averaging over it */
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(4, worst);
+    sim_run_for(5000);
+    TEST_ASSERT_EQUAL(0, position());
+    TEST_ASSERT_EQUAL(0, s_last_percent);
+}
+
+static void test_bursts_keep_the_bus_quiet(void)
+{
+    sim_run_for(2000);
+    sim_i2c_stats_t stats;
+    sim_i2c_reset_stats();
+    sim_run_for(60000);
+    sim_i2c_get_stats(&stats);
+    /* At rest: one burst a second, two transactions each */
+    TEST_ASSERT_UINT32_WITHIN(4, 2 * 60, stats.transactions);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.overruns);
+    printf("at rest: %lu transactions/min, bus busy %llu us/min\n", (unsigned long)stats.transactions,
+           (unsigned long long)stats.busy_us);
+
+    sim_i2c_reset_stats();
+    TEST_ASSERT_EQUAL(ESP_OK, garage_door_open());
+    sim_run_for(FIXTURE_TRAVEL_MS / 2);
+    sim_i2c_get_stats(&stats);
+    uint32_t bursts = (stats.transactions - 1) / 2; /* Less the watermark change */
+    TEST_ASSERT_UINT32_WITHIN(3, FIXTURE_TRAVEL_MS / 2 / 200, bursts);
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(TILT_SENSOR_WATERMARK_MOVING * (bursts - 1), stats.samples - 1);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.overruns);
+    printf("moving: %lu bursts in %d ms, bus busy %llu us\n", (unsigned long)bursts, FIXTURE_TRAVEL_MS / 2,
+           (unsigned long long)stats.busy_us);
+}
+
+static void test_reeds_calibrate_end_stops(void)
+{
+    sim_accel_set_noise(30);
+    calibrate_by_cycling();
+
+    /* Stalled half way down: the driver's 0..9000 defaults would read 47% from the panel */
+    TEST_ASSERT_EQUAL(ESP_OK, garage_door_close());
+    sim_run_for(FIXTURE_TRAVEL_MS / 2);
+    sim_door_set_jammed(true);
+    sim_run_for(3000);
+    uint32_t truth = sim_door_position() / 10;
+    printf("jammed at %lu%%, tilt reads %u%%\n", (unsigned long)truth, position());
+    TEST_ASSERT_UINT32_WITHIN(2, truth, position());
+}
+
+static void test_loose_mount_is_not_calibrated(void)
+{
+    sim_run_for(2000);
+    /* The panel hangs near its closed angle whatever the door does */
+    sim_accel_pin_tilt(true, SIM_CLOSED_CDEG + 300);
+    TEST_ASSERT_EQUAL(ESP_OK, garage_door_open());
+    sim_run_for(FIXTURE_TRAVEL_MS + 3000);
+    TEST_ASSERT_EQUAL(100, position());
+
+    /* The open reference was kept: off the reeds the panel still reads near closed */
+    sim_accel_pin_tilt(false, 0);
+    TEST_ASSERT_EQUAL(ESP_OK, garage_door_close());
+    sim_run_for(FIXTURE_TRAVEL_MS / 2);
+    sim_door_set_jammed(true);
+    sim_run_for(3000);
+    uint8_t percent = position();
+    TEST_ASSERT_TRUE(percent > 1 && percent < 99);
+}
+
+static void test_recovers_from_bus_loss(void)
+{
+    sim_run_for(2000);
+    sim_accel_detach();
+    sim_run_for(5000);
+    /* Retried once a second, not spinning on the interrupt */
+    sim_i2c_stats_t stats;
+    sim_i2c_reset_stats();
+    sim_run_for(10000);
+    sim_i2c_get_stats(&stats);
+    TEST_ASSERT_UINT32_WITHIN(2, 10, stats.transactions);
+
+    /* Back on the bus after a power cycle: reconfigured, and bursts resume */
+    attach_accel();
+    TEST_ASSERT_EQUAL(ESP_OK, garage_door_open());
+    sim_run_for(FIXTURE_TRAVEL_MS / 2);
+    int32_t expected = SIM_CLOSED_CDEG + (SIM_OPEN_CDEG - SIM_CLOSED_CDEG) * (int32_t)sim_door_position() / 1000;
+    /* Within a burst and its averaging of the door, at 667 cdeg/s */
+    TEST_ASSERT_TRUE(abs(tilt_sensor_angle_cdeg() - expected) <= 300);
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(FIXTURE_TRAVEL_MS / 2 / 200 - 5, s_updates);
+}
+
+static void test_init_fails_without_sensor(void)
+{
+    tilt_sensor_deinit();
+    sim_accel_detach();
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_RESPONSE, tilt_sensor_init(&s_config));
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, tilt_sensor_deinit());
+
+    attach_accel();
+    TEST_ASSERT_EQUAL(ESP_OK, tilt_sensor_init(&s_config));
+    sim_run_for(2000);
+    TEST_ASSERT_EQUAL(0, position());
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_cordic_matches_atan2);
+    RUN_TEST(test_fifo_burst_is_averaged);
+    RUN_TEST(test_angle_maps_to_percent);
+    RUN_TEST(test_position_follows_door);
+    RUN_TEST(test_bursts_keep_the_bus_quiet);
+    RUN_TEST(test_reeds_calibrate_end_stops);
+    RUN_TEST(test_loose_mount_is_not_calibrated);
+    RUN_TEST(test_recovers_from_bus_loss);
+    RUN_TEST(test_init_fails_without_sensor);
+    return UNITY_END();
+}
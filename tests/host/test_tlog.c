@@ -0,0 +1,172 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "unity.h"
+#include "tlog.h"
+
+#define TAG "test"
+#define PRODUCERS 3
+#define PER_PRODUCER 20000
+#define BENCH_CALLS 200000
+
+static int64_t s_now_us;
+
+int64_t esp_timer_get_time(void)
+{
+    return __atomic_load_n(&s_now_us, __ATOMIC_RELAXED);
+}
+
+static void drain(void)
+{
+    tlog_record_t rec;
+    while (tlog_read(&rec)) {
+    }
+}
+
+void setUp(void)
+{
+    drain();
+    s_now_us = 0;
+}
+
+void tearDown(void)
+{
+}
+
+static void test_records_round_trip(void)
+{
+    static const char *const state = "OPENING";
+    s_now_us = 1234567;
+    TLOGI(TAG, "State: %s -> %s (%d)", "CLOSED", state, -3);
+    TLOGW(TAG, "no args");
+
+    tlog_record_t rec;
+    char text[64];
+    TEST_ASSERT_TRUE(tlog_read(&rec));
+    TEST_ASSERT_EQUAL_UINT32(1234567, rec.timestamp_us);
+    TEST_ASSERT_EQUAL(ESP_LOG_INFO, rec.fmt->level);
+    TEST_ASSERT_EQUAL(3, rec.fmt->nargs);
+    tlog_format(&rec, text, sizeof(text));
+    TEST_ASSERT_EQUAL_STRING("State: CLOSED -> OPENING (-3)", text);
+
+    TEST_ASSERT_TRUE(tlog_read(&rec));
+    TEST_ASSERT_EQUAL(0, rec.fmt->nargs);
+    tlog_format(&rec, text, sizeof(text));
+    TEST_ASSERT_EQUAL_STRING("no args", text);
+
+    TEST_ASSERT_FALSE(tlog_read(&rec));
+}
+
+static void test_full_ring_drops_newest(void)
+{
+    uint32_t dropped = tlog_dropped();
+    for (int i = 0; i < CONFIG_TLOG_RING_SIZE + 5; i++) {
+        TLOGI(TAG, "n=%d", i);
+    }
+    TEST_ASSERT_EQUAL_UINT32(dropped + 5, tlog_dropped());
+
+    tlog_record_t rec;
+    for (int i = 0; i < CONFIG_TLOG_RING_SIZE; i++) {
+        TEST_ASSERT_TRUE(tlog_read(&rec));
+        TEST_ASSERT_EQUAL(i, (int)rec.args[0]);
+    }
+    TEST_ASSERT_FALSE(tlog_read(&rec));
+}
+
+static void test_format_truncates(void)
+{
+    TLOGI(TAG, "%s", "a long string that does not fit");
+    tlog_record_t rec;
+    char text[8];
+    TEST_ASSERT_TRUE(tlog_read(&rec));
+    TEST_ASSERT_EQUAL_UINT32(7, tlog_format(&rec, text, sizeof(text)));
+    TEST_ASSERT_EQUAL_STRING("a long ", text);
+}
+
+static void *producer(void *arg)
+{
+    uintptr_t id = (uintptr_t)arg;
+    for (uintptr_t i = 0; i < PER_PRODUCER; i++) {
+        TLOGI(TAG, "p%u %u", (unsigned)id, (unsigned)i);
+    }
+    return NULL;
+}
+
+static void test_concurrent_producers_keep_per_producer_order(void)
+{
+    pthread_t threads[PRODUCERS];
+    uint32_t next[PRODUCERS] = {0};
+    uint32_t received = 0;
+    uint32_t dropped_before = tlog_dropped();
+
+    for (uintptr_t i = 0; i < PRODUCERS; i++) {
+        pthread_create(&threads[i], NULL, producer, (void *)i);
+    }
+
+    /* Consume concurrently until every producer is done and the ring is empty */
+    int done = 0;
+    while (done < 2) {
+        tlog_record_t rec;
+        bool any = false;
+        while (tlog_read(&rec)) {
+            any = true;
+            uint32_t id = (uint32_t)rec.args[0];
+            uint32_t seq = (uint32_t)rec.args[1];
+            TEST_ASSERT_TRUE(id < PRODUCERS);
+            TEST_ASSERT_TRUE(seq >= next[id]);
+            next[id] = seq + 1;
+            received++;
+        }
+        if (!any && received + (tlog_dropped() - dropped_before) == PRODUCERS * PER_PRODUCER) {
+            done++;
+        }
+    }
+    for (int i = 0; i < PRODUCERS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    /* Every record is either delivered or counted as dropped */
+    TEST_ASSERT_EQUAL_UINT32(PRODUCERS * PER_PRODUCER, received + (tlog_dropped() - dropped_before));
+}
+
+static double elapsed_ns(const struct timespec *a, const struct timespec *b)
+{
+    return (double)(b->tv_sec - a->tv_sec) * 1e9 + (double)(b->tv_nsec - a->tv_nsec);
+}
+
+/* Informational: per-call cost of a TLOG versus formatting and writing the line */
+static void test_report_call_cost(void)
+{
+    FILE *sink = fopen("/dev/null", "w");
+    TEST_ASSERT_NOT_NULL(sink);
+    struct timespec t0, t1, t2;
+    tlog_record_t rec;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (int i = 0; i < BENCH_CALLS; i++) {
+        TLOGI(TAG, "State: %s -> %s", "CLOSED", "OPENING");
+        tlog_read(&rec);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    for (int i = 0; i < BENCH_CALLS; i++) {
+        fprintf(sink, "I (%u) %s: State: %s -> %s\n", (unsigned)i, TAG, "CLOSED", "OPENING");
+        fflush(sink);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t2);
+    fclose(sink);
+
+    printf("tlog write+read %.1f ns/call, printf+flush %.1f ns/call\n", elapsed_ns(&t0, &t1) / BENCH_CALLS,
+           elapsed_ns(&t1, &t2) / BENCH_CALLS);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_records_round_trip);
+    RUN_TEST(test_full_ring_drops_newest);
+    RUN_TEST(test_format_truncates);
+    RUN_TEST(test_concurrent_producers_keep_per_producer_order);
+    RUN_TEST(test_report_call_cost);
+    return UNITY_END();
+}
@@ -0,0 +1,155 @@
+#include <stdio.h>
+#include <string.h>
+#include "unity.h"
+#include "garage_fixture.h"
+#include "garage_door_control.h"
+#include "trace.h"
+#include "trace_replay.h"
+
+#define RING_SIZE 4096 /* CONFIG_GARAGE_TRACE_RING_SIZE in the host sdkconfig.h */
+
+static trace_record_t s_records[RING_SIZE];
+
+void setUp(void)
+{
+    trace_clear();
+}
+
+void tearDown(void)
+{
+}
+
+static size_t capture_open_close_cycle(void)
+{
+    trace_clear();
+    fixture_boot(0);
+    TEST_ASSERT_EQUAL(ESP_OK, garage_door_open());
+    sim_run_for(FIXTURE_TRAVEL_MS + 3000);
+    TEST_ASSERT_EQUAL(DOOR_STATE_OPEN, garage_door_get_state());
+    TEST_ASSERT_EQUAL(ESP_OK, garage_door_close());
+    sim_run_for(FIXTURE_TRAVEL_MS + 3000);
+    TEST_ASSERT_EQUAL(DOOR_STATE_CLOSED, garage_door_get_state());
+    size_t count = trace_snapshot(s_records, RING_SIZE);
+    fixture_shutdown();
+    return count;
+}
+
+static void test_records_in_order(void)
+{
+    trace_record(TRACE_COMMAND, TRACE_CMD_OPEN, 0);
+    trace_record(TRACE_RELAY_PULSE, 0, 500);
+    trace_record(TRACE_STATE, DOOR_STATE_CLOSED, DOOR_STATE_OPENING);
+
+    TEST_ASSERT_EQUAL(3, trace_snapshot(s_records, RING_SIZE));
+    TEST_ASSERT_EQUAL(TRACE_COMMAND, s_records[0].type);
+    TEST_ASSERT_EQUAL(500, s_records[1].b);
+    TEST_ASSERT_EQUAL(DOOR_STATE_OPENING, s_records[2].b);
+    TEST_ASSERT_EQUAL_UINT32(0, trace_overwritten());
+}
+
+static void test_ring_keeps_newest(void)
+{
+    for (uint32_t i = 0; i < RING_SIZE + 10; i++) {
+        trace_record(TRACE_POSITION, 0, (uint16_t)i);
+    }
+
+    TEST_ASSERT_EQUAL(RING_SIZE, trace_snapshot(s_records, RING_SIZE));
+    TEST_ASSERT_EQUAL(10, s_records[0].b);
+    TEST_ASSERT_EQUAL((RING_SIZE + 9) & 0xFFFF, s_records[RING_SIZE - 1].b);
+    TEST_ASSERT_EQUAL_UINT32(10, trace_overwritten());
+
+    trace_clear();
+    TEST_ASSERT_EQUAL(0, trace_snapshot(s_records, RING_SIZE));
+    TEST_ASSERT_EQUAL_UINT32(0, trace_overwritten());
+}
+
+static void test_text_round_trip(void)
+{
+    const trace_record_t rec = {.timestamp_us = 4000000123u, .type = TRACE_STATE, .a = 3, .b = 0};
+    char line[TRACE_LINE_MAX];
+    trace_record_t parsed;
+
+    trace_format(&rec, line, sizeof(line));
+    TEST_ASSERT_EQUAL_STRING("T 4000000123 STATE 3 0", line);
+    TEST_ASSERT_TRUE(trace_parse(line, &parsed));
+    TEST_ASSERT_EQUAL_MEMORY(&rec, &parsed, sizeof(rec));
+
+    TEST_ASSERT_FALSE(trace_parse("I (1234) garage_door: State: OPEN -> CLOSING", &parsed));
+    TEST_ASSERT_FALSE(trace_parse("T 1 NOSUCH 0 0", &parsed));
+    TEST_ASSERT_FALSE(trace_parse("T 1 STATE 300 0", &parsed));
+}
+
+static void test_capture_covers_inputs_and_outputs(void)
+{
+    size_t count = capture_open_close_cycle();
+    size_t per_type[TRACE_STATE + 1] = {0};
+    for (size_t i = 0; i < count; i++) {
+        per_type[s_records[i].type]++;
+    }
+
+    TEST_ASSERT_EQUAL(1, per_type[TRACE_BOOT]);
+    TEST_ASSERT_EQUAL(2, per_type[TRACE_COMMAND]);
+    TEST_ASSERT_EQUAL(2, per_type[TRACE_RELAY_PULSE]);
+    TEST_ASSERT_EQUAL(4, per_type[TRACE_STATE]);
+    TEST_ASSERT_EQUAL(4, per_type[TRACE_POSITION]);
+    TEST_ASSERT_EQUAL(4, per_type[TRACE_REED_EDGE]);
+}
+
+static void test_replay_of_capture_matches(void)
+{
+    size_t count = capture_open_close_cycle();
+    const replay_options_t options = {.tolerance_ms = REPLAY_DEFAULT_TOLERANCE_MS, .report = stdout};
+    replay_result_t result;
+
+    TEST_ASSERT_EQUAL(ESP_OK, replay_run(s_records, count, &options, &result));
+    TEST_ASSERT_EQUAL(0, result.skipped);
+    TEST_ASSERT_EQUAL(6, result.inputs);
+    TEST_ASSERT_EQUAL(result.recorded_outputs, result.replayed_outputs);
+    TEST_ASSERT_EQUAL(0, result.mismatches);
+}
+
+/* A wrapped ring has lost BOOT; the replay starts at the first end state instead */
+static void test_replay_syncs_without_boot(void)
+{
+    size_t count = capture_open_close_cycle();
+    const replay_options_t options = {.tolerance_ms = REPLAY_DEFAULT_TOLERANCE_MS, .report = stdout};
+    replay_result_t result;
+
+    TEST_ASSERT_EQUAL(TRACE_BOOT, s_records[0].type);
+    TEST_ASSERT_EQUAL(ESP_OK, replay_run(s_records + 1, count - 1, &options, &result));
+    TEST_ASSERT_TRUE(result.skipped > 0);
+    TEST_ASSERT_EQUAL(0, result.mismatches);
+
+    const trace_record_t inputs_only[] = {{.timestamp_us = 1, .type = TRACE_REED_EDGE}};
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_FOUND, replay_run(inputs_only, 1, &options, &result));
+}
+
+/* The recording predates the fix that disarms the timeout at the end stop */
+static void test_replay_flags_field_regression(void)
+{
+    FILE *in = fopen(TRACE_DIR "/stopped_after_close.txt", "r");
+    TEST_ASSERT_NOT_NULL(in);
+    size_t count = replay_load(in, s_records, RING_SIZE);
+    fclose(in);
+    TEST_ASSERT_EQUAL(14, count);
+
+    const replay_options_t options = {.tolerance_ms = REPLAY_DEFAULT_TOLERANCE_MS, .report = stdout};
+    replay_result_t result;
+    TEST_ASSERT_EQUAL(ESP_OK, replay_run(s_records, count, &options, &result));
+    TEST_ASSERT_EQUAL(7, result.recorded_outputs);
+    TEST_ASSERT_EQUAL(6, result.replayed_outputs);
+    TEST_ASSERT_EQUAL(1, result.mismatches);
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_records_in_order);
+    RUN_TEST(test_ring_keeps_newest);
+    RUN_TEST(test_text_round_trip);
+    RUN_TEST(test_capture_covers_inputs_and_outputs);
+    RUN_TEST(test_replay_of_capture_matches);
+    RUN_TEST(test_replay_syncs_without_boot);
+    RUN_TEST(test_replay_flags_field_regression);
+    return UNITY_END();
+}
@@ -0,0 +1,213 @@
+#include <stdio.h>
+#include <string.h>
+#include "unity.h"
+#include "sim.h"
+#include "range_filter.h"
+#include "ultrasonic.h"
+#include "sensor_scheduler.h"
+
+#define TRIG_PIN GPIO_NUM_10
+#define ECHO_PIN GPIO_NUM_11
+#define FLOOR_MM 2500
+#define ROOF_MM  1200
+
+/* Step gate holds one sample, the median needs three of five, presence two confirmations, plus the pipeline tick */
+#define DETECT_BUDGET_SAMPLES 6
+
+static uint32_t s_changes;
+static bool s_present;
+static int64_t s_changed_at_us;
+
+static void on_presence(bool present, uint16_t distance_mm)
+{
+    s_changes++;
+    s_present = present;
+    s_changed_at_us = sim_now_us();
+}
+
+static const ultrasonic_config_t s_config = {
+    .trig_pin = TRIG_PIN,
+    .echo_pin = ECHO_PIN,
+    .present_below_mm = 1500,
+    .hysteresis_mm = 200,
+    .confirm_samples = 2,
+};
+
+void setUp(void)
+{
+    sim_reset();
+    sim_echo_attach(TRIG_PIN);
+    sim_echo_set_distance(FLOOR_MM);
+    s_changes = 0;
+    s_present = false;
+    TEST_ASSERT_EQUAL(ESP_OK, sensor_scheduler_init());
+    TEST_ASSERT_EQUAL(ESP_OK, ultrasonic_init(&s_config));
+    TEST_ASSERT_EQUAL(ESP_OK, ultrasonic_register_callback(on_presence));
+}
+
+void tearDown(void)
+{
+    ultrasonic_deinit();
+    sensor_scheduler_deinit();
+    sim_reset();
+}
+
+static void feed(range_filter_t *filter, uint16_t mm, int count)
+{
+    for (int i = 0; i < count; i++) {
+        range_filter_add(filter, mm, NULL);
+    }
+}
+
+static void test_echo_time_to_distance(void)
+{
+    TEST_ASSERT_UINT32_WITHIN(1, 20, range_echo_to_mm(117));
+    TEST_ASSERT_UINT32_WITHIN(1, 1000, range_echo_to_mm(5831));
+    TEST_ASSERT_UINT32_WITHIN(1, 4000, range_echo_to_mm(23324));
+}
+
+static void test_filter_drops_isolated_spike(void)
+{
+    range_filter_t filter;
+    uint16_t median;
+    range_filter_reset(&filter);
+    feed(&filter, FLOOR_MM, RANGE_FILTER_WINDOW);
+
+    TEST_ASSERT_FALSE(range_filter_add(&filter, 600, &median));
+    TEST_ASSERT_TRUE(range_filter_add(&filter, FLOOR_MM + 5, &median));
+    TEST_ASSERT_EQUAL_UINT32(FLOOR_MM, median);
+    TEST_ASSERT_EQUAL_UINT32(1, filter.outliers);
+
+    /* Two unrelated spikes in a row are both dropped */
+    TEST_ASSERT_FALSE(range_filter_add(&filter, 600, &median));
+    TEST_ASSERT_FALSE(range_filter_add(&filter, 3900, &median));
+    TEST_ASSERT_TRUE(range_filter_add(&filter, FLOOR_MM, &median));
+    TEST_ASSERT_EQUAL_UINT32(3, filter.outliers);
+}
+
+static void test_filter_follows_confirmed_step(void)
+{
+    range_filter_t filter;
+    uint16_t median = 0;
+    range_filter_reset(&filter);
+    feed(&filter, FLOOR_MM, RANGE_FILTER_WINDOW);
+
+    TEST_ASSERT_FALSE(range_filter_add(&filter, ROOF_MM, &median));
+    TEST_ASSERT_TRUE(range_filter_add(&filter, ROOF_MM + 10, &median));
+    TEST_ASSERT_EQUAL_UINT32(FLOOR_MM, median);
+    TEST_ASSERT_TRUE(range_filter_add(&filter, ROOF_MM - 10, &median));
+    TEST_ASSERT_UINT32_WITHIN(10, ROOF_MM, median);
+    TEST_ASSERT_EQUAL_UINT32(0, filter.outliers);
+}
+
+static void test_presence_hysteresis_and_confirmation(void)
+{
+    const presence_config_t config = {.present_below_mm = 1500, .hysteresis_mm = 200, .confirm_samples = 2};
+    presence_state_t state = {0};
+
+    TEST_ASSERT_FALSE(presence_update(&state, &config, 1400));
+    TEST_ASSERT_FALSE(presence_update(&state, &config, 1600)); /* Streak broken */
+    TEST_ASSERT_FALSE(presence_update(&state, &config, 1400));
+    TEST_ASSERT_TRUE(presence_update(&state, &config, 1400));
+    TEST_ASSERT_TRUE(state.present);
+
+    /* Inside the hysteresis band the car stays present */
+    TEST_ASSERT_FALSE(presence_update(&state, &config, 1650));
+    TEST_ASSERT_FALSE(presence_update(&state, &config, 1650));
+    TEST_ASSERT_FALSE(presence_update(&state, &config, 1750));
+    TEST_ASSERT_TRUE(presence_update(&state, &config, 1750));
+    TEST_ASSERT_FALSE(state.present);
+}
+
+static void test_detects_arrival_and_departure_within_budget(void)
+{
+    ultrasonic_set_activity(ULTRASONIC_ACTIVITY_MOVING);
+    sim_run_for(2000);
+    TEST_ASSERT_EQUAL_UINT32(0, s_changes);
+    TEST_ASSERT_UINT32_WITHIN(2, FLOOR_MM, ultrasonic_distance_mm());
+
+    int64_t start = sim_now_us();
+    sim_echo_set_distance(ROOF_MM);
+    sim_run_for(DETECT_BUDGET_SAMPLES * ULTRASONIC_FAST_PERIOD_MS);
+    TEST_ASSERT_EQUAL_UINT32(1, s_changes);
+    TEST_ASSERT_TRUE(ultrasonic_vehicle_present());
+    printf("arrival detected after %lld ms\n", (long long)(s_changed_at_us - start) / 1000);
+
+    start = sim_now_us();
+    sim_echo_set_distance(FLOOR_MM);
+    sim_run_for(DETECT_BUDGET_SAMPLES * ULTRASONIC_FAST_PERIOD_MS);
+    TEST_ASSERT_EQUAL_UINT32(2, s_changes);
+    TEST_ASSERT_FALSE(ultrasonic_vehicle_present());
+    printf("departure detected after %lld ms\n", (long long)(s_changed_at_us - start) / 1000);
+}
+
+static void test_noise_causes_no_false_presence(void)
+{
+    ultrasonic_set_activity(ULTRASONIC_ACTIVITY_MOVING);
+    sim_echo_set_noise(40, 150);
+    sim_run_for(120000);
+    TEST_ASSERT_EQUAL_UINT32(0, s_changes);
+    TEST_ASSERT_UINT32_WITHIN(40, FLOOR_MM, ultrasonic_distance_mm());
+
+    /* A real arrival still gets through the noise */
+    sim_echo_set_distance(ROOF_MM);
+    sim_run_for(5000);
+    TEST_ASSERT_EQUAL_UINT32(1, s_changes);
+    TEST_ASSERT_TRUE(s_present);
+}
+
+static void test_recovers_when_echoes_are_lost(void)
+{
+    ultrasonic_set_activity(ULTRASONIC_ACTIVITY_MOVING);
+    sim_echo_set_silent(true);
+    sim_run_for(10000);
+    TEST_ASSERT_EQUAL_UINT32(0, s_changes);
+
+    sim_echo_set_silent(false);
+    sim_echo_set_distance(ROOF_MM);
+    sim_run_for(DETECT_BUDGET_SAMPLES * ULTRASONIC_FAST_PERIOD_MS);
+    TEST_ASSERT_EQUAL_UINT32(1, s_changes);
+}
+
+static void test_rate_follows_door_activity(void)
+{
+    ultrasonic_set_activity(ULTRASONIC_ACTIVITY_MOVING);
+    TEST_ASSERT_EQUAL(ULTRASONIC_RATE_FAST, ultrasonic_get_rate());
+    uint32_t before = sim_echo_trigger_count();
+    sim_run_for(10000);
+    TEST_ASSERT_UINT32_WITHIN(1, 10000 / ULTRASONIC_FAST_PERIOD_MS, sim_echo_trigger_count() - before);
+
+    ultrasonic_set_activity(ULTRASONIC_ACTIVITY_OPEN);
+    TEST_ASSERT_EQUAL(ULTRASONIC_RATE_SLOW, ultrasonic_get_rate());
+    before = sim_echo_trigger_count();
+    sim_run_for(20000);
+    TEST_ASSERT_UINT32_WITHIN(1, 20000 / ULTRASONIC_SLOW_PERIOD_MS, sim_echo_trigger_count() - before);
+
+    /* Behind a closed door nothing can arrive or leave: sampling stops once the bay is stable */
+    ultrasonic_set_activity(ULTRASONIC_ACTIVITY_CLOSED);
+    sim_run_for(ULTRASONIC_STABLE_OFF_MS + ULTRASONIC_SLOW_PERIOD_MS);
+    TEST_ASSERT_EQUAL(ULTRASONIC_RATE_OFF, ultrasonic_get_rate());
+    before = sim_echo_trigger_count();
+    sim_run_for(600000);
+    TEST_ASSERT_EQUAL_UINT32(before, sim_echo_trigger_count());
+
+    ultrasonic_set_activity(ULTRASONIC_ACTIVITY_MOVING);
+    TEST_ASSERT_EQUAL(ULTRASONIC_RATE_FAST, ultrasonic_get_rate());
+    sim_echo_set_distance(ROOF_MM);
+    sim_run_for(DETECT_BUDGET_SAMPLES * ULTRASONIC_FAST_PERIOD_MS);
+    TEST_ASSERT_TRUE(ultrasonic_vehicle_present());
+}
+
+int main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_echo_time_to_distance);
+    RUN_TEST(test_filter_drops_isolated_spike);
+    RUN_TEST(test_filter_follows_confirmed_step);
+    RUN_TEST(test_presence_hysteresis_and_confirmation);
+    RUN_TEST(test_detects_arrival_and_departure_within_budget);
+    RUN_TEST(test_noise_causes_no_false_presence);
+    RUN_TEST(test_recovers_when_echoes_are_lost);
+    RUN_TEST(test_rate_follows_door_activity);
+    return UNITY_END();
+}
@@ -0,0 +1,53 @@
+/*
+ * Emits the same records as tokens ("binary") or as text formatted on the
+ * host ("text"); check_tlog_decode.py decodes the tokens with the ELF of this
+ * program and compares the two.
+ */
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include "tlog.h"
+
+#define TAG "demo"
+
+static int64_t s_now_us;
+
+int64_t esp_timer_get_time(void)
+{
+    return s_now_us;
+}
+
+static const char *state_name(int state)
+{
+    static const char *const names[] = {"CLOSED", "OPENING", "OPEN"};
+    return names[state % 3];
+}
+
+int main(int argc, char **argv)
+{
+    bool binary = argc > 1 && strcmp(argv[1], "binary") == 0;
+
+    for (int i = 0; i < 6; i++) {
+        s_now_us = 1000000 + i * 1500;
+        TLOGI(TAG, "State: %s -> %s", state_name(i), state_name(i + 1));
+        TLOGW(TAG, "value=%d hex=0x%08" PRIx32 " pct=%u%%", -i, (uint32_t)(0xA0000000u + i), (unsigned)(i * 20));
+        TLOGD("other", "no args");
+    }
+
+    static const char letters[] = "NEWIDV";
+    tlog_record_t rec;
+    char text[128];
+    while (tlog_read(&rec)) {
+        if (binary) {
+            printf("TLOG %08" PRIx32 " %08" PRIxPTR, rec.timestamp_us, (uintptr_t)rec.fmt);
+            for (int i = 0; i < rec.fmt->nargs; i++) {
+                printf(" %" PRIxPTR, rec.args[i]);
+            }
+            printf("\n");
+        } else {
+            tlog_format(&rec, text, sizeof(text));
+            printf("%c (%" PRIu32 ") %s: %s\n", letters[rec.fmt->level], rec.timestamp_us / 1000, rec.fmt->tag, text);
+        }
+    }
+    return 0;
+}
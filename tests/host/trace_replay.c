@@ -0,0 +1,348 @@
+#include "trace_replay.h"
+#include <inttypes.h>
+#include <string.h>
+#include "garage_fixture.h"
+#include "garage_door_control.h"
+#include "reed_switch.h"
+#include "relay_control.h"
+#include "sensor_scheduler.h"
+#include "storage_manager.h"
+
+#define REPLAY_MAX_RECORDS 4096
+#define REPLAY_SETTLE_MS   1000
+
+typedef struct {
+    int64_t time_us; /* Relative to the sync point */
+    trace_record_t rec;
+} timed_record_t;
+
+static timed_record_t s_recorded[REPLAY_MAX_RECORDS];
+static timed_record_t s_replayed[REPLAY_MAX_RECORDS];
+static trace_record_t s_snapshot[REPLAY_MAX_RECORDS];
+
+static const trace_type_t s_output_streams[] = {TRACE_POSITION, TRACE_STATE, TRACE_RELAY_PULSE, TRACE_COMMAND};
+
+size_t replay_load(FILE *in, trace_record_t *records, size_t max)
+{
+    char line[128];
+    size_t count = 0;
+    while (count < max && fgets(line, sizeof(line), in)) {
+        if (trace_parse(line, &records[count])) {
+            count++;
+        }
+    }
+    return count;
+}
+
+/* 32-bit timestamps wrap every ~71 minutes; consecutive records are never that far apart */
+static void unwrap(const trace_record_t *records, size_t count, uint32_t origin, timed_record_t *out)
+{
+    int64_t time_us = (int32_t)(records[0].timestamp_us - origin);
+    for (size_t i = 0; i < count; i++) {
+        if (i > 0) {
+            time_us += (int32_t)(records[i].timestamp_us - records[i - 1].timestamp_us);
+        }
+        out[i].time_us = time_us;
+        out[i].rec = records[i];
+    }
+}
+
+/* Ring order is claim order; commands carry their entry time, so sort (stably) by time */
+static void sort_by_time(timed_record_t *records, size_t count)
+{
+    for (size_t i = 1; i < count; i++) {
+        timed_record_t key = records[i];
+        size_t j = i;
+        while (j > 0 && records[j - 1].time_us > key.time_us) {
+            records[j] = records[j - 1];
+            j--;
+        }
+        records[j] = key;
+    }
+}
+
+static bool is_rest_state(uint16_t state)
+{
+    return state == DOOR_STATE_CLOSED || state == DOOR_STATE_OPEN || state == DOOR_STATE_STOPPED;
+}
+
+static bool find_sync(const timed_record_t *records, size_t count, size_t *index)
+{
+    for (size_t i = 0; i < count; i++) {
+        const trace_record_t *rec = &records[i].rec;
+        if (rec->type == TRACE_BOOT || (rec->type == TRACE_STATE && is_rest_state(rec->b))) {
+            *index = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Reeds are active low */
+static void position_levels(door_position_t pos, uint32_t levels[2])
+{
+    levels[TRACE_REED_CLOSED] = (pos == DOOR_POSITION_CLOSED || pos == DOOR_POSITION_UNKNOWN) ? 0 : 1;
+    levels[TRACE_REED_OPEN] = (pos == DOOR_POSITION_OPEN || pos == DOOR_POSITION_UNKNOWN) ? 0 : 1;
+}
+
+static door_position_t state_position(door_state_t state)
+{
+    switch (state) {
+        case DOOR_STATE_CLOSED:
+            return DOOR_POSITION_CLOSED;
+        case DOOR_STATE_OPEN:
+            return DOOR_POSITION_OPEN;
+        default:
+            return DOOR_POSITION_BETWEEN;
+    }
+}
+
+static gpio_num_t reed_pin(uint8_t reed)
+{
+    return reed == TRACE_REED_CLOSED ? FIXTURE_REED_CLOSED_PIN : FIXTURE_REED_OPEN_PIN;
+}
+
+/* Boot the components with the door state and reed levels in force at the sync point */
+static door_position_t boot(const timed_record_t *records, size_t sync)
+{
+    const trace_record_t *at = &records[sync].rec;
+    door_state_t state = (door_state_t)at->b;
+    door_position_t pos = (at->type == TRACE_BOOT) ? (door_position_t)at->a : state_position(state);
+    uint32_t levels[2];
+
+    position_levels(pos, levels);
+    for (size_t i = 0; i < sync; i++) {
+        if (records[i].rec.type == TRACE_REED_EDGE && records[i].rec.a <= TRACE_REED_OPEN) {
+            levels[records[i].rec.a] = records[i].rec.b;
+        }
+    }
+
+    sim_reset();
+    sim_nvs_erase_all();
+    sim_gpio_set_input(FIXTURE_REED_CLOSED_PIN, levels[TRACE_REED_CLOSED]);
+    sim_gpio_set_input(FIXTURE_REED_OPEN_PIN, levels[TRACE_REED_OPEN]);
+
+    storage_init();
+    storage_save_door_state(state);
+    const reed_switch_config_t reed = {
+        .reed_closed_pin = FIXTURE_REED_CLOSED_PIN,
+        .reed_open_pin = FIXTURE_REED_OPEN_PIN,
+        .relay_pin = FIXTURE_RELAY_PIN,
+    };
+    reed_switch_init(&reed);
+    sensor_scheduler_init();
+    garage_door_init();
+    relay_init(FIXTURE_RELAY_PIN);
+    sim_run_for(REPLAY_SETTLE_MS);
+    trace_clear();
+    return reed_switch_get_position();
+}
+
+static void shutdown(void)
+{
+    garage_door_deinit();
+    relay_deinit();
+    reed_switch_deinit();
+    sensor_scheduler_deinit();
+    sim_reset();
+}
+
+static void apply_input(const trace_record_t *rec)
+{
+    if (rec->type == TRACE_REED_EDGE) {
+        sim_gpio_set_input(reed_pin(rec->a), rec->b);
+    } else if (rec->a == TRACE_CMD_OPEN) {
+        garage_door_open();
+    } else if (rec->a == TRACE_CMD_CLOSE) {
+        garage_door_close();
+    } else if (rec->a == TRACE_CMD_STOP) {
+        garage_door_stop();
+    }
+}
+
+static bool is_output(const trace_record_t *rec)
+{
+    for (size_t i = 0; i < sizeof(s_output_streams) / sizeof(s_output_streams[0]); i++) {
+        if (rec->type == s_output_streams[i]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void describe(const trace_record_t *rec, char *buf, size_t len)
+{
+    static const char *const positions[] = {"UNKNOWN", "CLOSED", "OPEN", "BETWEEN"};
+    static const char *const commands[] = {"open", "close", "stop"};
+
+    switch (rec->type) {
+        case TRACE_POSITION:
+            snprintf(buf, len, "position %s", rec->a < 4 ? positions[rec->a] : "?");
+            break;
+        case TRACE_STATE:
+            snprintf(buf, len, "state %s -> %s", garage_door_state_to_string((door_state_t)rec->a),
+                     garage_door_state_to_string((door_state_t)rec->b));
+            break;
+        case TRACE_RELAY_PULSE:
+            snprintf(buf, len, "relay pulse %u ms", rec->b);
+            break;
+        default:
+            snprintf(buf, len, "%s -> %s", rec->a < 3 ? commands[rec->a] : "?", esp_err_to_name((int16_t)rec->b));
+            break;
+    }
+}
+
+static void report(FILE *out, const char *what, const timed_record_t *recorded, const timed_record_t *replayed)
+{
+    char a[64];
+    char b[64];
+    if (!out) {
+        return;
+    }
+    if (recorded && replayed) {
+        describe(&recorded->rec, a, sizeof(a));
+        describe(&replayed->rec, b, sizeof(b));
+        fprintf(out, "  %10.3f s  %-9s recorded: %s, replayed at %.3f s: %s\n", recorded->time_us / 1e6, what, a,
+                replayed->time_us / 1e6, b);
+    } else if (recorded) {
+        describe(&recorded->rec, a, sizeof(a));
+        fprintf(out, "  %10.3f s  %-9s recorded: %s\n", recorded->time_us / 1e6, what, a);
+    } else {
+        describe(&replayed->rec, b, sizeof(b));
+        fprintf(out, "  %10.3f s  %-9s replayed: %s\n", replayed->time_us / 1e6, what, b);
+    }
+}
+
+static bool same_output(const timed_record_t *x, const timed_record_t *y)
+{
+    return x->rec.a == y->rec.a && x->rec.b == y->rec.b;
+}
+
+static size_t collect(const timed_record_t *records, size_t count, trace_type_t type, const timed_record_t **out)
+{
+    size_t n = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (records[i].rec.type == type) {
+            out[n++] = &records[i];
+        }
+    }
+    return n;
+}
+
+/* In-order comparison that resynchronises after a single missing or extra output */
+static size_t diff_stream(trace_type_t type, size_t recorded_count, size_t replayed_count, const replay_options_t *opt)
+{
+    static const timed_record_t *r[REPLAY_MAX_RECORDS];
+    static const timed_record_t *p[REPLAY_MAX_RECORDS];
+    size_t nr = collect(s_recorded, recorded_count, type, r);
+    size_t np = collect(s_replayed, replayed_count, type, p);
+    int64_t tolerance_us = (int64_t)opt->tolerance_ms * 1000;
+    size_t mismatches = 0;
+    size_t i = 0;
+    size_t j = 0;
+
+    while (i < nr || j < np) {
+        if (i < nr && j < np && same_output(r[i], p[j])) {
+            int64_t skew = p[j]->time_us - r[i]->time_us;
+            if (skew > tolerance_us || skew < -tolerance_us) {
+                report(opt->report, "timing", r[i], p[j]);
+                mismatches++;
+            }
+            i++;
+            j++;
+        } else if (i + 1 < nr && j < np && same_output(r[i + 1], p[j])) {
+            report(opt->report, "missing", r[i++], NULL);
+            mismatches++;
+        } else if (i < nr && j + 1 < np && same_output(r[i], p[j + 1])) {
+            report(opt->report, "extra", NULL, p[j++]);
+            mismatches++;
+        } else if (i < nr && j < np) {
+            report(opt->report, "differs", r[i++], p[j++]);
+            mismatches++;
+        } else if (i < nr) {
+            report(opt->report, "missing", r[i++], NULL);
+            mismatches++;
+        } else {
+            report(opt->report, "extra", NULL, p[j++]);
+            mismatches++;
+        }
+    }
+    return mismatches;
+}
+
+esp_err_t replay_run(const trace_record_t *records, size_t count, const replay_options_t *options,
+                     replay_result_t *result)
+{
+    size_t sync;
+    if (!records || !options || !result || count == 0 || count > REPLAY_MAX_RECORDS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(result, 0, sizeof(*result));
+
+    unwrap(records, count, records[0].timestamp_us, s_recorded);
+    sort_by_time(s_recorded, count);
+    if (!find_sync(s_recorded, count, &sync)) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    int64_t origin_us = s_recorded[sync].time_us;
+    for (size_t i = 0; i < count; i++) {
+        s_recorded[i].time_us -= origin_us;
+    }
+    int64_t end_us = s_recorded[count - 1].time_us;
+    result->skipped = sync;
+
+    door_position_t pos = boot(s_recorded, sync);
+    int64_t base_us = sim_now_us();
+
+    /*
+     * Keep only what follows the sync point; it is both input and expected
+     * output. A position report that lands just after a STATE sync point
+     * (debounce finishing after the safety check saw the end stop) is already
+     * the boot position, so the replay cannot produce it and it is dropped.
+     */
+    size_t recorded_count = 0;
+    for (size_t i = sync + 1; i < count; i++) {
+        const timed_record_t *entry = &s_recorded[i];
+        if (entry->rec.type == TRACE_REED_EDGE || entry->rec.type == TRACE_COMMAND) {
+            sim_run_until(base_us + entry->time_us);
+            apply_input(&entry->rec);
+            result->inputs++;
+        }
+        if (entry->rec.type == TRACE_POSITION) {
+            if (entry->rec.a == pos) {
+                continue;
+            }
+            pos = (door_position_t)entry->rec.a;
+        }
+        if (is_output(&entry->rec)) {
+            s_recorded[recorded_count++] = *entry;
+        }
+    }
+    result->duration_us = end_us + (int64_t)options->tolerance_ms * 1000;
+    sim_run_until(base_us + result->duration_us);
+
+    size_t snapshot_count = trace_snapshot(s_snapshot, REPLAY_MAX_RECORDS);
+    bool overflow = trace_overwritten() > 0;
+    shutdown();
+    if (overflow) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    size_t replayed_count = 0;
+    if (snapshot_count > 0) {
+        unwrap(s_snapshot, snapshot_count, (uint32_t)base_us, s_replayed);
+        sort_by_time(s_replayed, snapshot_count);
+    }
+    for (size_t i = 0; i < snapshot_count; i++) {
+        if (is_output(&s_replayed[i].rec)) {
+            s_replayed[replayed_count++] = s_replayed[i];
+        }
+    }
+
+    result->recorded_outputs = recorded_count;
+    result->replayed_outputs = replayed_count;
+    for (size_t i = 0; i < sizeof(s_output_streams) / sizeof(s_output_streams[0]); i++) {
+        result->mismatches += diff_stream(s_output_streams[i], recorded_count, replayed_count, options);
+    }
+    return ESP_OK;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+/*
+ * Replays a trace captured with the 'trace' console command through the real
+ * door, reed and relay components on the simulator.
+ *
+ * The replay starts at the first record that pins down the door state (BOOT,
+ * or a transition into CLOSED/OPEN/STOPPED, since a wrapped ring has lost
+ * the boot). From there it re-drives the reed inputs and re-issues the
+ * commands at their recorded times and records what the current logic does.
+ * Outputs are compared per stream (positions, state transitions, relay
+ * pulses, command results) in order, with a timing tolerance.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "esp_err.h"
+#include "trace.h"
+
+#define REPLAY_DEFAULT_TOLERANCE_MS 150
+
+typedef struct {
+    uint32_t tolerance_ms;
+    FILE *report; /* Mismatch listing; NULL for none */
+} replay_options_t;
+
+typedef struct {
+    size_t skipped;         /* Records before the sync point */
+    size_t inputs;          /* Reed edges and commands re-applied */
+    size_t recorded_outputs;
+    size_t replayed_outputs;
+    size_t mismatches;      /* Missing, extra, different or late outputs */
+    int64_t duration_us;    /* Virtual time covered */
+} replay_result_t;
+
+/* Reads "T ..." lines, ignoring anything else (console prompts, log lines) */
+size_t replay_load(FILE *in, trace_record_t *records, size_t max);
+esp_err_t replay_run(const trace_record_t *records, size_t count, const replay_options_t *options,
+                     replay_result_t *result);
@@ -0,0 +1,87 @@
+/*
+ * Replays a 'trace' console dump through the current door logic and diffs
+ * the outputs:
+ *
+ *   trace_replay [-t tolerance_ms] [-n repeat] [-q] trace.txt
+ *
+ * Exits 1 when the replay diverges from the recording. -n repeats the replay
+ * to time the logic against real traffic; the speed-up over real time is
+ * printed either way.
+ */
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "trace_replay.h"
+
+#define MAX_RECORDS 4096
+
+static trace_record_t s_records[MAX_RECORDS];
+
+static int64_t wall_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int usage(void)
+{
+    fprintf(stderr, "usage: trace_replay [-t tolerance_ms] [-n repeat] [-q] trace.txt\n");
+    return 2;
+}
+
+int main(int argc, char **argv)
+{
+    replay_options_t options = {.tolerance_ms = REPLAY_DEFAULT_TOLERANCE_MS, .report = stdout};
+    unsigned repeat = 1;
+    const char *path = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            options.tolerance_ms = (uint32_t)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            repeat = (unsigned)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-q") == 0) {
+            options.report = NULL;
+        } else if (argv[i][0] != '-' && !path) {
+            path = argv[i];
+        } else {
+            return usage();
+        }
+    }
+    if (!path || repeat == 0) {
+        return usage();
+    }
+
+    FILE *in = fopen(path, "r");
+    if (!in) {
+        perror(path);
+        return 2;
+    }
+    size_t count = replay_load(in, s_records, MAX_RECORDS);
+    fclose(in);
+
+    replay_result_t result;
+    int64_t start = wall_us();
+    for (unsigned i = 0; i < repeat; i++) {
+        esp_err_t ret = replay_run(s_records, count, &options, &result);
+        if (ret != ESP_OK) {
+            fprintf(stderr, "%s: replay failed: %s\n", path, esp_err_to_name(ret));
+            return 2;
+        }
+        options.report = NULL; /* Repeats are for timing only */
+    }
+    int64_t elapsed = wall_us() - start;
+    if (elapsed < 1) {
+        elapsed = 1;
+    }
+
+    printf("%s: %zu records (%zu before sync), %zu inputs, outputs %zu recorded / %zu replayed, %zu mismatches\n",
+           path, count, result.skipped, result.inputs, result.recorded_outputs, result.replayed_outputs,
+           result.mismatches);
+    printf("replayed %.1f s of traffic %u times in %.1f ms (%.0fx real time)\n", result.duration_us / 1e6, repeat,
+           elapsed / 1e3, (double)result.duration_us * repeat / (double)elapsed);
+    return result.mismatches ? 1 : 0;
+}
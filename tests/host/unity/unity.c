@@ -0,0 +1,61 @@
+#include "unity.h"
+#include <inttypes.h>
+#include <setjmp.h>
+#include <stdio.h>
+
+static const char *s_suite;
+static int s_tests;
+static int s_failures;
+static jmp_buf s_abort;
+
+void unity_begin(const char *suite)
+{
+    s_suite = suite;
+    s_tests = 0;
+    s_failures = 0;
+}
+
+int unity_end(void)
+{
+    printf("\n-----------------------\n%d Tests %d Failures 0 Ignored\n%s\n", s_tests, s_failures,
+           s_failures ? "FAIL" : "OK");
+    return s_failures;
+}
+
+void unity_run(void (*test)(void), const char *name, int line)
+{
+    s_tests++;
+    if (setjmp(s_abort) == 0) {
+        setUp();
+        test();
+        tearDown();
+        printf("%s:%d:%s:PASS\n", s_suite, line, name);
+    } else {
+        tearDown();
+        s_failures++;
+    }
+}
+
+void unity_fail(const char *file, int line, const char *msg)
+{
+    printf("%s:%d:FAIL: %s\n", file, line, msg);
+    longjmp(s_abort, 1);
+}
+
+void unity_assert_int(int64_t expected, int64_t actual, const char *file, int line, const char *expr)
+{
+    if (expected != actual) {
+        char msg[160];
+        snprintf(msg, sizeof(msg), "%s: expected %" PRId64 " was %" PRId64, expr, expected, actual);
+        unity_fail(file, line, msg);
+    }
+}
+
+void unity_assert_uint(uint64_t expected, uint64_t actual, const char *file, int line, const char *expr)
+{
+    if (expected != actual) {
+        char msg[160];
+        snprintf(msg, sizeof(msg), "%s: expected %" PRIu64 " was %" PRIu64, expr, expected, actual);
+        unity_fail(file, line, msg);
+    }
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+/*
+ * Minimal Unity-compatible assertion layer for the host test target.
+ *
+ * Only the subset of the Unity API used by the host tests is provided, so the
+ * test sources stay portable to the Unity component shipped with ESP-IDF.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+void unity_begin(const char *suite);
+int unity_end(void);
+void unity_run(void (*test)(void), const char *name, int line);
+void unity_fail(const char *file, int line, const char *msg);
+void unity_assert_int(int64_t expected, int64_t actual, const char *file, int line, const char *expr);
+void unity_assert_uint(uint64_t expected, uint64_t actual, const char *file, int line, const char *expr);
+
+void setUp(void);
+void tearDown(void);
+
+#define UNITY_BEGIN() unity_begin(__FILE__)
+#define UNITY_END()   unity_end()
+#define RUN_TEST(fn)  unity_run(fn, #fn, __LINE__)
+
+#define TEST_FAIL_MESSAGE(msg) unity_fail(__FILE__, __LINE__, (msg))
+#define TEST_ASSERT_TRUE(cond) \
+    do { if (!(cond)) unity_fail(__FILE__, __LINE__, "Expected TRUE: " #cond); } while (0)
+#define TEST_ASSERT_FALSE(cond) \
+    do { if (cond) unity_fail(__FILE__, __LINE__, "Expected FALSE: " #cond); } while (0)
+#define TEST_ASSERT(cond) TEST_ASSERT_TRUE(cond)
+#define TEST_ASSERT_NULL(ptr) TEST_ASSERT_TRUE((ptr) == NULL)
+#define TEST_ASSERT_NOT_NULL(ptr) TEST_ASSERT_TRUE((ptr) != NULL)
+
+#define TEST_ASSERT_EQUAL_INT(expected, actual) \
+    unity_assert_int((int64_t)(expected), (int64_t)(actual), __FILE__, __LINE__, #actual)
+#define TEST_ASSERT_EQUAL(expected, actual) TEST_ASSERT_EQUAL_INT(expected, actual)
+#define TEST_ASSERT_EQUAL_UINT32(expected, actual) \
+    unity_assert_uint((uint64_t)(expected), (uint64_t)(actual), __FILE__, __LINE__, #actual)
+#define TEST_ASSERT_EQUAL_UINT64(expected, actual) \
+    unity_assert_uint((uint64_t)(expected), (uint64_t)(actual), __FILE__, __LINE__, #actual)
+#define TEST_ASSERT_LESS_OR_EQUAL_UINT32(threshold, actual) \
+    do { if (!((uint64_t)(actual) <= (uint64_t)(threshold))) \
+        unity_fail(__FILE__, __LINE__, "Expected " #actual " <= " #threshold); } while (0)
+#define TEST_ASSERT_GREATER_OR_EQUAL_UINT32(threshold, actual) \
+    do { if (!((uint64_t)(actual) >= (uint64_t)(threshold))) \
+        unity_fail(__FILE__, __LINE__, "Expected " #actual " >= " #threshold); } while (0)
+#define TEST_ASSERT_UINT32_WITHIN(delta, expected, actual) \
+    do { uint64_t e_ = (uint64_t)(expected), a_ = (uint64_t)(actual); \
+        if ((a_ > e_ ? a_ - e_ : e_ - a_) > (uint64_t)(delta)) \
+            unity_assert_uint(e_, a_, __FILE__, __LINE__, #actual " (within " #delta ")"); } while (0)
+#define TEST_ASSERT_EQUAL_MEMORY(expected, actual, len) \
+    do { if (memcmp((expected), (actual), (len)) != 0) \
+        unity_fail(__FILE__, __LINE__, "Memory mismatch: " #actual); } while (0)
+#define TEST_ASSERT_EQUAL_STRING(expected, actual) \
+    do { if (strcmp((expected), (actual)) != 0) \
+        unity_fail(__FILE__, __LINE__, "String mismatch: " #actual); } while (0)
@@ -0,0 +1,217 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: CC0-1.0
+"""
+Make a delta patch that turns one firmware image into another, for the
+streaming applier in components/ota (format in components/ota/delta_patch.h).
+
+The new image is matched against the old one in 16-byte blocks. A match is
+extended in both directions and keeps going through sparse differences (a
+relocated address changes a few bytes in an otherwise identical function),
+which become single-byte edits of the copy; everything else is inserted
+literally. The patch is applied once here before it is written, so a patch
+that would not reproduce the new image is never produced.
+
+    tools/delta_diff.py old.bin new.bin -o update.patch
+"""
+
+import argparse
+import hashlib
+import struct
+import sys
+
+VERSION = 1
+BLOCK = 16
+INDEX_STEP = 4          # Code is word aligned; indexing every 4th offset keeps the table small
+EXTEND_WINDOW = 16      # Bytes examined past a mismatch before giving up on a match
+EXTEND_MIN_MATCH = 12   # ... of which at least this many must match the old image
+CHECK_INTERVAL = 64 * 1024
+OP_END, OP_COPY, OP_INSERT, OP_CHECK = 0x00, 0x01, 0x02, 0x03
+
+
+def varint(value):
+    out = bytearray()
+    while True:
+        byte = value & 0x7F
+        value >>= 7
+        if value:
+            out.append(byte | 0x80)
+        else:
+            out.append(byte)
+            return bytes(out)
+
+
+def index_blocks(old):
+    index = {}
+    for offset in range(0, len(old) - BLOCK + 1, INDEX_STEP):
+        index.setdefault(old[offset:offset + BLOCK], offset)
+    return index
+
+
+def extend(old, new, old_pos, new_pos):
+    """Length of the copy at (old_pos, new_pos) and its edits as (position in copy, new byte)."""
+    length, edits = 0, []
+    limit = min(len(old) - old_pos, len(new) - new_pos)
+    while length < limit:
+        # Fast path over identical runs
+        step = 64
+        while length + step <= limit and old[old_pos + length:old_pos + length + step] == \
+                new[new_pos + length:new_pos + length + step]:
+            length += step
+        while length < limit and old[old_pos + length] == new[new_pos + length]:
+            length += 1
+        if length >= limit:
+            break
+        window = min(EXTEND_WINDOW, limit - length)
+        ahead = sum(old[old_pos + length + i] == new[new_pos + length + i] for i in range(window))
+        if window < EXTEND_WINDOW or ahead < EXTEND_MIN_MATCH:
+            break
+        for i in range(window):
+            if old[old_pos + length + i] != new[new_pos + length + i]:
+                edits.append((length + i, new[new_pos + length + i]))
+        length += window
+    # Do not end on edits: trailing differences are cheaper as literal data
+    while edits and edits[-1][0] >= length - 1:
+        length = edits.pop()[0]
+    return length, edits
+
+
+class PatchWriter:
+    def __init__(self, old, new):
+        self.new = new
+        self.out = bytearray(b'GDP' + bytes([VERSION]))
+        self.out += struct.pack('<II', len(old), len(new))
+        self.out += hashlib.sha256(old).digest() + hashlib.sha256(new).digest()
+        self.hash = hashlib.sha256()
+        self.produced = 0
+        self.next_check = CHECK_INTERVAL
+        self.stats = {'copies': 0, 'inserted': 0, 'edits': 0}
+
+    def advance(self, length):
+        self.hash.update(self.new[self.produced:self.produced + length])
+        self.produced += length
+        if self.produced >= self.next_check:
+            self.out += bytes([OP_CHECK]) + self.hash.copy().digest()[:8]
+            self.next_check = (self.produced // CHECK_INTERVAL + 1) * CHECK_INTERVAL
+
+    def insert(self, data):
+        if data:
+            self.out += bytes([OP_INSERT]) + varint(len(data)) + data
+            self.stats['inserted'] += len(data)
+            self.advance(len(data))
+
+    def copy(self, offset, length, edits):
+        self.out += bytes([OP_COPY]) + varint(offset) + varint(length) + varint(len(edits))
+        previous = 0
+        for position, value in edits:
+            self.out += varint(position - previous) + bytes([value])
+            previous = position + 1
+        self.stats['copies'] += 1
+        self.stats['edits'] += len(edits)
+        self.advance(length)
+
+    def finish(self):
+        self.out.append(OP_END)
+        return bytes(self.out)
+
+
+def make_patch(old, new):
+    index = index_blocks(old)
+    writer = PatchWriter(old, new)
+    literal_start = pos = 0
+    while pos + BLOCK <= len(new):
+        old_pos = index.get(new[pos:pos + BLOCK])
+        if old_pos is None:
+            pos += 1
+            continue
+        # Grow backwards into the pending literal
+        while pos > literal_start and old_pos > 0 and old[old_pos - 1] == new[pos - 1]:
+            pos -= 1
+            old_pos -= 1
+        length, edits = extend(old, new, old_pos, pos)
+        writer.insert(new[literal_start:pos])
+        writer.copy(old_pos, length, edits)
+        pos += length
+        literal_start = pos
+    writer.insert(new[literal_start:])
+    return writer.finish(), writer.stats
+
+
+def read_varint(data, pos):
+    value = shift = 0
+    while True:
+        byte = data[pos]
+        pos += 1
+        value |= (byte & 0x7F) << shift
+        shift += 7
+        if not byte & 0x80:
+            return value, pos
+
+
+def apply_patch(old, patch):
+    """Reference applier, same checks as the firmware's."""
+    if patch[:3] != b'GDP' or patch[3] != VERSION:
+        raise ValueError('not a delta patch')
+    old_size, new_size = struct.unpack_from('<II', patch, 4)
+    if hashlib.sha256(old[:old_size]).digest() != patch[12:44]:
+        raise ValueError('patch is for a different old image')
+    out = bytearray()
+    pos = 76
+    while True:
+        op = patch[pos]
+        pos += 1
+        if op == OP_END:
+            break
+        if op == OP_COPY:
+            offset, pos = read_varint(patch, pos)
+            length, pos = read_varint(patch, pos)
+            count, pos = read_varint(patch, pos)
+            chunk = bytearray(old[offset:offset + length])
+            at = 0
+            for _ in range(count):
+                skip, pos = read_varint(patch, pos)
+                at += skip
+                chunk[at] = patch[pos]
+                pos += 1
+                at += 1
+            out += chunk
+        elif op == OP_INSERT:
+            length, pos = read_varint(patch, pos)
+            out += patch[pos:pos + length]
+            pos += length
+        elif op == OP_CHECK:
+            if hashlib.sha256(out).digest()[:8] != patch[pos:pos + 8]:
+                raise ValueError(f'checkpoint at {len(out)} bytes does not match')
+            pos += 8
+        else:
+            raise ValueError(f'unknown record 0x{op:02x} at {pos - 1}')
+    if len(out) != new_size or hashlib.sha256(out).digest() != patch[44:76]:
+        raise ValueError('rebuilt image does not match')
+    return bytes(out)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Make a delta patch between two firmware images.')
+    parser.add_argument('old', help='image the device runs now')
+    parser.add_argument('new', help='image to update to')
+    parser.add_argument('-o', '--output', required=True, help='patch file to write')
+    args = parser.parse_args()
+
+    with open(args.old, 'rb') as f:
+        old = f.read()
+    with open(args.new, 'rb') as f:
+        new = f.read()
+
+    patch, stats = make_patch(old, new)
+    if apply_patch(old, patch) != new:
+        print('internal error: patch does not reproduce the new image', file=sys.stderr)
+        return 1
+    with open(args.output, 'wb') as f:
+        f.write(patch)
+    print(f'old {len(old)} bytes, new {len(new)} bytes, patch {len(patch)} bytes '
+          f'({100 * len(patch) / len(new):.1f}% of the image): {stats["copies"]} copies, '
+          f'{stats["edits"]} edits, {stats["inserted"]} bytes inserted', file=sys.stderr)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,246 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: CC0-1.0
+"""
+Receive and decode a binary diagnostic export (components/diagnostics/diag_export.h).
+
+Opens the console serial port raw, sends 'export [sources]', collects COBS
+frames up to the end frame, checks each CRC-32 and sequence number and prints
+the decoded streams as text: metrics as in the 'metrics' command, trace
+records as in the 'trace' dump (tests/host/trace_replay reads the output as
+is), event log entries oldest first with their sequence numbers. A file argument is decoded as a saved
+capture instead.
+
+    tools/diag_export.py /dev/ttyUSB0 -o diag.txt
+    tools/diag_export.py /dev/ttyUSB0 --sources events
+    tools/diag_export.py capture.bin
+"""
+
+import argparse
+import os
+import select
+import stat
+import struct
+import sys
+import termios
+import time
+import tty
+import zlib
+
+STREAM_END, STREAM_EVENTS, STREAM_METRICS_SCHEMA, STREAM_METRICS, STREAM_TRACE = range(5)
+FRAME_FIRST, FRAME_LAST = 0x01, 0x02
+HEADER, CRC = 4, 4
+
+EVENT_NAMES = ['DOOR_OPEN', 'DOOR_CLOSED', 'TIMEOUT', 'OBSTRUCTION', 'COMMISSION', 'ERROR', 'RULE', 'LIVENESS', 'NO_ACTUATION']
+TRACE_NAMES = {1: 'BOOT', 2: 'REED', 3: 'POSITION', 4: 'COMMAND', 5: 'RELAY', 6: 'STATE'}
+BAUD_RATES = {9600: termios.B9600, 115200: termios.B115200, 230400: termios.B230400, 460800: termios.B460800,
+              921600: termios.B921600}
+
+
+class ExportError(Exception):
+    pass
+
+
+def cobs_decode(data):
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        code = data[i]
+        i += 1
+        if code == 0 or i + code - 1 > len(data):
+            raise ExportError('bad COBS block')
+        out += data[i:i + code - 1]
+        i += code - 1
+        if code < 0xFF and i < len(data):
+            out.append(0)
+    return bytes(out)
+
+
+def parse_frame(wire):
+    """Return (stream, flags, seq, payload) or None when the frame is damaged."""
+    try:
+        frame = cobs_decode(wire)
+    except ExportError:
+        return None
+    if len(frame) < HEADER + CRC:
+        return None
+    body, crc = frame[:-CRC], struct.unpack('<I', frame[-CRC:])[0]
+    if zlib.crc32(body) != crc:
+        return None
+    stream, flags, seq = struct.unpack_from('<BBH', body)
+    return stream, flags, seq, body[HEADER:]
+
+
+class Receiver:
+    """Feeds on raw console bytes; text around the frames is skipped."""
+
+    def __init__(self):
+        self.pending = bytearray()
+        self.streams = {}
+        self.expected_seq = {}
+        self.synced = False
+        self.done = False
+        self.frames = 0
+        self.payload_bytes = 0
+        self.wire_bytes = 0
+        self.bad_frames = 0
+        self.summary = None
+
+    def feed(self, data):
+        self.pending += data
+        while not self.done:
+            end = self.pending.find(0)
+            if end < 0:
+                return
+            wire = bytes(self.pending[:end])
+            del self.pending[:end + 1]
+            self._frame(wire)
+
+    def _frame(self, wire):
+        parsed = parse_frame(wire) if wire else None
+        if parsed is None:
+            # Console text before the first frame is expected; after it, a frame was damaged
+            if self.synced and wire:
+                self.bad_frames += 1
+            return
+        self.synced = True
+        stream, flags, seq, payload = parsed
+        self.wire_bytes += len(wire) + 1
+        if stream == STREAM_END:
+            self.summary = struct.unpack('<II', payload[:8])
+            self.done = True
+            return
+        self.frames += 1
+        self.payload_bytes += len(payload)
+        if flags & FRAME_FIRST:
+            self.streams[stream] = bytearray()
+            self.expected_seq[stream] = 0
+        if self.expected_seq.get(stream) != seq:
+            raise ExportError(f'stream {stream}: frame {seq} out of sequence')
+        self.expected_seq[stream] = seq + 1
+        self.streams[stream] += payload
+
+    def check(self):
+        if not self.done:
+            raise ExportError('no end frame')
+        frames, payload_bytes = self.summary
+        if frames != self.frames or payload_bytes != self.payload_bytes:
+            raise ExportError(f'device sent {frames} frames / {payload_bytes} bytes, '
+                              f'received {self.frames} / {self.payload_bytes}')
+
+
+def fnv1a(text):
+    h = 2166136261
+    for b in text.encode():
+        h = ((h ^ b) * 16777619) & 0xFFFFFFFF
+    return h
+
+
+def decode_metrics(schema, snapshot):
+    version, _, count, schema_hash = struct.unpack_from('<BBHI', snapshot)
+    entries = [e for e in schema.decode().split(';') if e]
+    if fnv1a(''.join(e + ';' for e in entries)) != schema_hash:
+        raise ExportError('metrics schema does not match the snapshot')
+    values = struct.unpack_from(f'<{count}I', snapshot, 8)
+    lines = [f'# schema {schema_hash:08x}']
+    lines += [f'{entry.rsplit(":", 1)[0]} {value}' for entry, value in zip(entries, values)]
+    return lines
+
+
+def decode_trace(data):
+    records = [struct.unpack_from('<IBBH', data, off) for off in range(0, len(data) - len(data) % 8, 8)]
+    lines = [f'# trace: {len(records)} records']
+    lines += [f'T {ts} {TRACE_NAMES.get(kind, "UNKNOWN")} {a} {b}' for ts, kind, a, b in records]
+    return lines
+
+
+def decode_events(data):
+    records = [struct.unpack_from('<IIIi', data, off) for off in range(0, len(data) - len(data) % 16, 16)]
+    lines = [f'# events: {len(records)}']
+    expected = None
+    for seq, kind, ts, value in records:
+        # Numbers skipped on the device: overwritten during the export, or lost with a power cut
+        if expected is not None and seq != expected:
+            lines.append(f'# events {expected}..{seq - 1} missing')
+        expected = seq + 1
+        lines.append(f'E {seq} {ts} {EVENT_NAMES[kind] if kind < len(EVENT_NAMES) else kind} {value}')
+    return lines
+
+
+def decode(receiver):
+    streams = receiver.streams
+    lines = []
+    if STREAM_METRICS in streams:
+        lines += decode_metrics(bytes(streams.get(STREAM_METRICS_SCHEMA, b'')), bytes(streams[STREAM_METRICS]))
+    if STREAM_TRACE in streams:
+        lines += decode_trace(bytes(streams[STREAM_TRACE]))
+    if STREAM_EVENTS in streams:
+        lines += decode_events(bytes(streams[STREAM_EVENTS]))
+    return lines
+
+
+def open_port(path, baud):
+    fd = os.open(path, os.O_RDWR | os.O_NOCTTY)
+    tty.setraw(fd)
+    attrs = termios.tcgetattr(fd)
+    attrs[4] = attrs[5] = BAUD_RATES[baud]
+    termios.tcsetattr(fd, termios.TCSANOW, attrs)
+    return fd
+
+
+def receive(fd, receiver, timeout):
+    deadline = time.monotonic() + timeout
+    while not receiver.done:
+        remaining = deadline - time.monotonic()
+        if remaining <= 0:
+            raise ExportError('timed out')
+        ready, _, _ = select.select([fd], [], [], remaining)
+        if ready:
+            data = os.read(fd, 4096)
+            if not data:
+                raise ExportError('port closed')
+            receiver.feed(data)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument('port', help='console serial port, or a saved capture')
+    parser.add_argument('--baud', type=int, default=115200, choices=sorted(BAUD_RATES))
+    parser.add_argument('--sources', nargs='*', default=[], help='events, metrics, trace (default: all)')
+    parser.add_argument('--timeout', type=float, default=30, help='seconds to wait for the end frame')
+    parser.add_argument('-o', '--output', help='decoded text (default: stdout)')
+    args = parser.parse_args()
+
+    receiver = Receiver()
+    started = time.monotonic()
+    try:
+        if stat.S_ISCHR(os.stat(args.port).st_mode):
+            fd = open_port(args.port, args.baud)
+            try:
+                os.write(fd, ('export ' + ' '.join(args.sources)).strip().encode() + b'\r\n')
+                receive(fd, receiver, args.timeout)
+            finally:
+                os.close(fd)
+        else:
+            with open(args.port, 'rb') as f:
+                receiver.feed(f.read())
+        receiver.check()
+        lines = decode(receiver)
+    except ExportError as e:
+        print(f'export failed: {e}', file=sys.stderr)
+        return 1
+    elapsed = time.monotonic() - started
+
+    text = '\n'.join(lines) + '\n'
+    if args.output:
+        with open(args.output, 'w', encoding='utf-8') as f:
+            f.write(text)
+    else:
+        sys.stdout.write(text)
+    print(f'{receiver.frames} frames, {receiver.payload_bytes} payload bytes in {receiver.wire_bytes} on the wire '
+          f'({100 * receiver.payload_bytes / max(receiver.wire_bytes, 1):.1f}%), {elapsed:.2f} s, '
+          f'{receiver.bad_frames} damaged frames', file=sys.stderr)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
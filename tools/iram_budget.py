@@ -0,0 +1,88 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: CC0-1.0
+"""
+Check the IRAM taken by the timing-critical paths (HOT_PATH_ATTR, see
+components/diagnostics/hot_path.h) against their budget.
+
+Reads the linker map of a CONFIG_GARAGE_HOT_PATH_IRAM build, sums the
+.iram1.hot.* input sections per object file and exits non-zero if the total
+exceeds the budget. Run after every link by the top-level CMakeLists.txt:
+
+    tools/iram_budget.py build/smart_garage.map --budget 4096
+"""
+
+import argparse
+import re
+import sys
+
+SECTION_PREFIX = '.iram1.hot.'
+# " .iram1.hot.3  0x40800abc  0x9a  esp-idf/sensors/libsensors.a(reed_switch.c.obj)";
+# a long section name puts the address, size and object on the next line
+PLACEMENT = re.compile(r'^\s+(0x[0-9a-fA-F]+)\s+(0x[0-9a-fA-F]+)\s+(\S.*)$')
+
+
+def hot_sections(map_text):
+    """Yield (object, size) for every hot section the linker kept."""
+    lines = map_text.splitlines()
+    try:
+        # Everything before this lists the sections garbage collection discarded
+        start = lines.index('Linker script and memory map')
+    except ValueError:
+        start = 0
+    pending = False
+    for line in lines[start:]:
+        stripped = line.strip()
+        if stripped.startswith(SECTION_PREFIX):
+            rest = stripped[len(stripped.split()[0]):]
+            if rest.strip():
+                match = PLACEMENT.match(' ' + rest.strip())
+                if match:
+                    yield match.group(3), int(match.group(2), 16)
+                pending = False
+            else:
+                pending = True
+            continue
+        if pending:
+            match = PLACEMENT.match(line)
+            if match:
+                yield match.group(3), int(match.group(2), 16)
+            pending = False
+
+
+def object_name(obj):
+    """libsensors.a(reed_switch.c.obj) -> reed_switch.c"""
+    match = re.search(r'\(([^)]+)\)$', obj)
+    name = match.group(1) if match else obj.rsplit('/', 1)[-1]
+    return re.sub(r'\.(obj|o)$', '', name)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument('map', help='linker map file')
+    parser.add_argument('--budget', type=int, required=True, help='bytes of IRAM the hot paths may take')
+    args = parser.parse_args()
+
+    with open(args.map, encoding='utf-8', errors='replace') as f:
+        text = f.read()
+
+    per_object = {}
+    for obj, size in hot_sections(text):
+        name = object_name(obj)
+        per_object[name] = per_object.get(name, 0) + size
+    total = sum(per_object.values())
+
+    for name, size in sorted(per_object.items(), key=lambda item: -item[1]):
+        print(f'  {name:<32} {size:6d} bytes')
+    print(f'hot paths in IRAM: {total} of {args.budget} bytes')
+    if not per_object:
+        print('no .iram1.hot sections: is CONFIG_GARAGE_HOT_PATH_IRAM set?', file=sys.stderr)
+        return 1
+    if total > args.budget:
+        print(f'IRAM budget exceeded by {total - args.budget} bytes (CONFIG_GARAGE_HOT_PATH_IRAM_BUDGET)',
+              file=sys.stderr)
+        return 1
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,277 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: CC0-1.0
+"""
+Compile automation rules into the bytecode blob run by components/automation.
+
+A rules file holds one or more rules:
+
+    rule night_close
+    when door == OPEN and (hour >= 22 or hour < 6)
+    for 10m
+    do close
+
+    rule vehicle_left
+    on vehicle
+    when door == OPEN and vehicle == absent
+    do close
+
+'when' is required and reads the inputs door, vehicle and hour with ==, !=,
+<, <=, >, >=, and, or, not and parentheses; a bare input means 'input > 0'.
+Constants are integers, door states (CLOSED, OPENING, OPEN, CLOSING, STOPPED,
+UNKNOWN) and present/absent. 'on' lists the inputs whose changes may fire the
+rule (default: every input the condition reads). 'for' is the hold time in
+s, m or h. 'do' is close, open or 'alert <code>'. '#' starts a comment.
+
+The output is the console command that installs the rules, or the raw blob:
+
+    tools/rule_compile.py tools/garage.rules
+    tools/rule_compile.py tools/garage.rules -o rules.bin
+"""
+
+import argparse
+import re
+import struct
+import sys
+
+VERSION = 1
+BLOB_MAX = 512
+MAX_RULES = 16
+MAX_CODE = 48
+MAX_NAME = 15
+STACK_DEPTH = 8
+
+INPUTS = {'door': 0, 'vehicle': 1, 'hour': 2}
+ACTIONS = {'close': 1, 'open': 2, 'alert': 3}
+CONSTANTS = {
+    'CLOSED': 0, 'OPENING': 1, 'OPEN': 2, 'CLOSING': 3, 'STOPPED': 4, 'UNKNOWN': 5,
+    'absent': 0, 'present': 1,
+}
+OP_IN, OP_K8, OP_K16 = 0x01, 0x02, 0x03
+COMPARE = {'==': 0x10, '!=': 0x11, '<': 0x12, '<=': 0x13, '>': 0x14, '>=': 0x15}
+OP_AND, OP_OR, OP_NOT = 0x20, 0x21, 0x22
+HOLD_UNITS = {'s': 1, 'm': 60, 'h': 3600}
+TOKEN = re.compile(r'\s*(?:(\d+)|([A-Za-z_]\w*)|(==|!=|<=|>=|<|>|\(|\)))')
+
+
+class RuleError(Exception):
+    pass
+
+
+class Expression:
+    """Recursive descent over 'when' tokens; emits stack code and tracks depth."""
+
+    def __init__(self, text):
+        self.tokens = self.tokenize(text)
+        self.pos = 0
+        self.code = bytearray()
+        self.inputs = 0
+        self.depth = 0
+        self.max_depth = 0
+
+    @staticmethod
+    def tokenize(text):
+        tokens, pos = [], 0
+        text = text.rstrip()
+        while pos < len(text):
+            match = TOKEN.match(text, pos)
+            if not match:
+                raise RuleError(f'unexpected {text[pos:].strip()!r}')
+            tokens.append(match.group(match.lastindex))
+            pos = match.end()
+        return tokens
+
+    def peek(self):
+        return self.tokens[self.pos] if self.pos < len(self.tokens) else None
+
+    def take(self):
+        token = self.peek()
+        if token is None:
+            raise RuleError('condition ends early')
+        self.pos += 1
+        return token
+
+    def push(self, code):
+        self.code += code
+        self.depth += 1
+        self.max_depth = max(self.max_depth, self.depth)
+
+    def binary(self, op):
+        self.code.append(op)
+        self.depth -= 1
+
+    def compile(self):
+        self.parse_or()
+        if self.peek() is not None:
+            raise RuleError(f'unexpected {self.peek()!r}')
+        if len(self.code) > MAX_CODE:
+            raise RuleError(f'condition is {len(self.code)} bytes, at most {MAX_CODE}')
+        if self.max_depth > STACK_DEPTH:
+            raise RuleError('condition is nested too deeply')
+        return bytes(self.code)
+
+    def parse_or(self):
+        self.parse_and()
+        while self.peek() == 'or':
+            self.take()
+            self.parse_and()
+            self.binary(OP_OR)
+
+    def parse_and(self):
+        self.parse_not()
+        while self.peek() == 'and':
+            self.take()
+            self.parse_not()
+            self.binary(OP_AND)
+
+    def parse_not(self):
+        if self.peek() == 'not':
+            self.take()
+            self.parse_not()
+            self.code.append(OP_NOT)
+        else:
+            self.parse_compare()
+
+    def parse_compare(self):
+        if self.peek() == '(':
+            self.take()
+            self.parse_or()
+            if self.take() != ')':
+                raise RuleError("missing ')'")
+            return
+        bare_input = self.peek() in INPUTS
+        self.parse_value()
+        if self.peek() in COMPARE:
+            op = COMPARE[self.take()]
+            self.parse_value()
+            self.binary(op)
+        elif bare_input:
+            self.push(bytes([OP_K8, 0]))
+            self.binary(COMPARE['>'])
+        else:
+            raise RuleError('a constant alone is not a condition')
+
+    def parse_value(self):
+        token = self.take()
+        if token in INPUTS:
+            self.inputs |= 1 << INPUTS[token]
+            self.push(bytes([OP_IN, INPUTS[token]]))
+            return
+        if token in CONSTANTS:
+            value = CONSTANTS[token]
+        elif token.isdigit():
+            value = int(token)
+        else:
+            raise RuleError(f'unknown name {token!r}')
+        if value < 128:
+            self.push(bytes([OP_K8, value]))
+        elif value < 32768:
+            self.push(struct.pack('<Bh', OP_K16, value))
+        else:
+            raise RuleError(f'constant {value} out of range')
+
+
+def compile_rule(name, fields):
+    if not re.fullmatch(r'\w{1,%d}' % MAX_NAME, name):
+        raise RuleError(f'rule name must be 1..{MAX_NAME} word characters')
+    if 'when' not in fields or 'do' not in fields:
+        raise RuleError("needs 'when' and 'do'")
+
+    expr = Expression(fields['when'])
+    code = expr.compile()
+
+    triggers = expr.inputs
+    if 'on' in fields:
+        triggers = 0
+        for word in re.split(r'[\s,]+', fields['on'].strip()):
+            if word not in INPUTS:
+                raise RuleError(f'unknown input {word!r}')
+            triggers |= 1 << INPUTS[word]
+        if triggers & ~expr.inputs:
+            raise RuleError("'on' names an input the condition does not read")
+
+    hold = 0
+    if 'for' in fields:
+        match = re.fullmatch(r'\s*(\d+)\s*([smh])\s*', fields['for'])
+        if not match:
+            raise RuleError("'for' takes a duration such as 30s, 10m or 1h")
+        hold = int(match.group(1)) * HOLD_UNITS[match.group(2)]
+        if hold > 0xFFFF:
+            raise RuleError('hold time is at most 65535 s')
+
+    words = fields['do'].split()
+    if not words or words[0] not in ACTIONS:
+        raise RuleError(f"'do' takes one of {', '.join(ACTIONS)}")
+    arg = 0
+    if words[0] == 'alert' and len(words) > 1:
+        arg = int(words[1])
+        if not 0 <= arg <= 255:
+            raise RuleError('alert code is 0..255')
+    elif len(words) > 1:
+        raise RuleError(f"'{words[0]}' takes no argument")
+
+    encoded = name.encode()
+    size = 7 + len(encoded) + len(code)
+    return struct.pack('<BBBBHB', size, triggers, ACTIONS[words[0]], arg, hold, len(encoded)) + encoded + code
+
+
+def parse(text):
+    """Returns [(line, name, {keyword: rest})] for each rule in the file."""
+    rules = []
+    for number, raw in enumerate(text.splitlines(), 1):
+        line = raw.split('#', 1)[0].strip()
+        if not line:
+            continue
+        keyword, _, rest = line.partition(' ')
+        if keyword == 'rule':
+            rules.append((number, rest.strip(), {}))
+        elif keyword in ('on', 'when', 'for', 'do'):
+            if not rules:
+                raise RuleError(f'line {number}: {keyword!r} before any rule')
+            if keyword in rules[-1][2]:
+                raise RuleError(f'line {number}: second {keyword!r} in rule {rules[-1][1]}')
+            rules[-1][2][keyword] = rest
+        else:
+            raise RuleError(f'line {number}: unknown keyword {keyword!r}')
+    return rules
+
+
+def compile_rules(text):
+    rules = parse(text)
+    if len(rules) > MAX_RULES:
+        raise RuleError(f'{len(rules)} rules, at most {MAX_RULES}')
+    blob = bytearray(b'GR' + bytes([VERSION, len(rules)]))
+    for number, name, fields in rules:
+        try:
+            blob += compile_rule(name, fields)
+        except RuleError as e:
+            raise RuleError(f'line {number}: rule {name}: {e}') from None
+    if len(blob) > BLOB_MAX:
+        raise RuleError(f'rules take {len(blob)} bytes, at most {BLOB_MAX}')
+    return bytes(blob)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Compile garage automation rules to bytecode.')
+    parser.add_argument('rules', help='rules file')
+    parser.add_argument('-o', '--output', help='write the raw blob here instead of a console command')
+    args = parser.parse_args()
+
+    with open(args.rules) as f:
+        text = f.read()
+    try:
+        blob = compile_rules(text)
+    except RuleError as e:
+        print(f'{args.rules}: {e}', file=sys.stderr)
+        return 1
+
+    if args.output:
+        with open(args.output, 'wb') as f:
+            f.write(blob)
+    else:
+        print(f'rules load {blob.hex()}')
+    print(f'{blob[3]} rules, {len(blob)} bytes', file=sys.stderr)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,155 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: CC0-1.0
+"""
+Convert a 'spans' console dump (CONFIG_GARAGE_SPAN_ENABLE) to Chrome trace JSON.
+
+Reads the "# task <index> <name>" and "S <timestamp_us> <B|E|M> <SPAN> <corr>
+<task>" lines of a dump; other console output is skipped. Each task becomes a
+track, each span a slice, each mark an instant, and the spans of one command
+(same correlation ID) are linked by a flow arrow across tasks. Open the
+result in chrome://tracing or https://ui.perfetto.dev.
+
+    tools/span_trace.py capture.log -o spans.json
+    tools/span_trace.py capture.log --corr 12 --summary
+"""
+
+import argparse
+import json
+import re
+import sys
+
+TASK_LINE = re.compile(r'^# task (\d+) (\S+)')
+SPAN_LINE = re.compile(r'^S (\d+) ([BEM]) (\w+) (\d+) (\d+)$')
+TASK_NONE = 255
+PID = 1
+
+
+def parse(lines):
+    """Return ({task: name}, [(timestamp_us, phase, name, corr, task)]) with timestamps unwrapped."""
+    tasks = {}
+    records = []
+    wraps = 0
+    last = None
+    for line in lines:
+        line = line.strip()
+        match = TASK_LINE.match(line)
+        if match:
+            tasks[int(match.group(1))] = match.group(2)
+            continue
+        match = SPAN_LINE.match(line)
+        if not match:
+            continue
+        ts = int(match.group(1))
+        # esp_timer time is recorded in 32 bits and wraps after ~71 minutes
+        if last is not None and ts < last and last - ts > 1 << 31:
+            wraps += 1
+        last = ts
+        records.append((ts + (wraps << 32), match.group(2), match.group(3), int(match.group(4)),
+                        int(match.group(5))))
+    return tasks, records
+
+
+def pair_spans(records):
+    """Yield (begin_us, end_us, name, corr, task) per completed span; ends lost to the ring are dropped."""
+    open_spans = {}
+    for ts, phase, name, corr, task in records:
+        stack = open_spans.setdefault(task, [])
+        if phase == 'B':
+            stack.append((ts, name, corr))
+        elif phase == 'E':
+            # The begin may have been overwritten before the dump
+            for i in range(len(stack) - 1, -1, -1):
+                if stack[i][1] == name:
+                    begin, _, begin_corr = stack.pop(i)
+                    del stack[i:]
+                    yield begin, ts, name, begin_corr, task
+                    break
+
+
+def chrome_trace(tasks, records):
+    events = [{'ph': 'M', 'name': 'process_name', 'pid': PID, 'tid': 0, 'args': {'name': 'smart_garage'}}]
+    for task in sorted({r[4] for r in records}):
+        name = tasks.get(task, 'unknown' if task == TASK_NONE else f'task {task}')
+        events.append({'ph': 'M', 'name': 'thread_name', 'pid': PID, 'tid': task, 'args': {'name': name}})
+        events.append({'ph': 'M', 'name': 'thread_sort_index', 'pid': PID, 'tid': task, 'args': {'sort_index': task}})
+
+    for begin, end, name, corr, task in pair_spans(records):
+        events.append({'ph': 'X', 'name': name, 'cat': 'span', 'ts': begin, 'dur': end - begin, 'pid': PID,
+                       'tid': task, 'args': {'corr': corr}})
+    for ts, phase, name, corr, task in records:
+        if phase == 'M':
+            events.append({'ph': 'i', 's': 't', 'name': name, 'cat': 'span', 'ts': ts, 'pid': PID, 'tid': task,
+                           'args': {'corr': corr}})
+
+    # One flow per command, through the first slice it starts on each task it reaches
+    steps = {}
+    for ts, phase, name, corr, task in records:
+        if corr and phase == 'B':
+            hops = steps.setdefault(corr, [])
+            if not hops or hops[-1][1] != task:
+                hops.append((ts, task))
+    for corr, hops in steps.items():
+        if len(hops) < 2:
+            continue
+        for i, (ts, task) in enumerate(hops):
+            phase = 's' if i == 0 else ('f' if i == len(hops) - 1 else 't')
+            event = {'ph': phase, 'name': f'command {corr}', 'cat': 'command', 'id': corr, 'ts': ts, 'pid': PID,
+                     'tid': task}
+            if phase == 'f':
+                event['bp'] = 'e'
+            events.append(event)
+    return {'traceEvents': events, 'displayTimeUnit': 'ms'}
+
+
+def summary(tasks, records):
+    """Per command: first to last record, and the time in each span name (nested spans counted in each)."""
+    commands = {}
+    for begin, end, name, corr, task in pair_spans(records):
+        if corr:
+            cmd = commands.setdefault(corr, {'first': begin, 'last': end, 'spans': {}})
+            cmd['first'] = min(cmd['first'], begin)
+            cmd['last'] = max(cmd['last'], end)
+            count, total = cmd['spans'].get(name, (0, 0))
+            cmd['spans'][name] = (count + 1, total + end - begin)
+    lines = []
+    for corr in sorted(commands):
+        cmd = commands[corr]
+        lines.append(f'command {corr}: {(cmd["last"] - cmd["first"]) / 1000:.3f} ms')
+        for name, (count, total) in sorted(cmd['spans'].items(), key=lambda item: -item[1][1]):
+            lines.append(f'  {name:<16} {count:3d} x {total / 1000:10.3f} ms')
+    return '\n'.join(lines)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument('dump', nargs='?', help="console capture with a 'spans' dump (default: stdin)")
+    parser.add_argument('-o', '--output', help='JSON output file (default: stdout)')
+    parser.add_argument('--corr', type=int, help='only the command with this correlation ID')
+    parser.add_argument('--summary', action='store_true', help='print the time per span of each command instead')
+    args = parser.parse_args()
+
+    if args.dump:
+        with open(args.dump, encoding='utf-8', errors='replace') as f:
+            tasks, records = parse(f)
+    else:
+        tasks, records = parse(sys.stdin)
+    if not records:
+        print('no span records: is CONFIG_GARAGE_SPAN_ENABLE set?', file=sys.stderr)
+        return 1
+    if args.corr is not None:
+        records = [r for r in records if r[3] == args.corr]
+
+    if args.summary:
+        text = summary(tasks, records) + '\n'
+    else:
+        text = json.dumps(chrome_trace(tasks, records), indent=1) + '\n'
+    if args.output:
+        with open(args.output, 'w', encoding='utf-8') as f:
+            f.write(text)
+    else:
+        sys.stdout.write(text)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
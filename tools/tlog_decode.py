@@ -0,0 +1,142 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: CC0-1.0
+"""
+Decode tokenized log lines (CONFIG_TLOG_OUTPUT_BINARY) using the firmware ELF.
+
+Each "TLOG <timestamp> <descriptor> <args...>" line (hex fields) is resolved
+against the tlog_fmt_t descriptor at <descriptor> in the ELF: level, tag and
+format string are read from the image, %s arguments are read as strings at
+their address. Other lines are passed through unchanged.
+
+    idf.py monitor | tools/tlog_decode.py build/smart_garage.elf
+    tools/tlog_decode.py build/smart_garage.elf capture.log
+"""
+
+import argparse
+import re
+import struct
+import sys
+
+LEVEL_LETTERS = 'NEWIDV'
+FORMAT_SPEC = re.compile(r'%([-+ #0]*)(\d*|\*)(?:\.(\d+))?(hh|h|ll|l|j|z|t)?([diouxXcspf%])')
+
+
+class Elf:
+    """Minimal ELF reader: maps virtual addresses to bytes of allocated sections."""
+
+    def __init__(self, path):
+        with open(path, 'rb') as f:
+            self.data = f.read()
+        if self.data[:4] != b'\x7fELF':
+            raise ValueError(f'{path}: not an ELF file')
+        self.is64 = self.data[4] == 2
+        if self.data[5] != 1:
+            raise ValueError(f'{path}: only little-endian ELF is supported')
+        self.ptr_size = 8 if self.is64 else 4
+        self.sections = []
+        if self.is64:
+            shoff, = struct.unpack_from('<Q', self.data, 0x28)
+            shentsize, shnum = struct.unpack_from('<HH', self.data, 0x3A)
+        else:
+            shoff, = struct.unpack_from('<I', self.data, 0x20)
+            shentsize, shnum = struct.unpack_from('<HH', self.data, 0x2E)
+        for i in range(shnum):
+            off = shoff + i * shentsize
+            if self.is64:
+                _, sh_type, flags, addr, offset, size = struct.unpack_from('<IIQQQQ', self.data, off)
+            else:
+                _, sh_type, flags, addr, offset, size = struct.unpack_from('<IIIIII', self.data, off)
+            SHT_NOBITS, SHF_ALLOC = 8, 0x2
+            if (flags & SHF_ALLOC) and sh_type != SHT_NOBITS and size:
+                self.sections.append((addr, size, offset))
+
+    def read(self, addr, size):
+        for base, length, offset in self.sections:
+            if base <= addr and addr + size <= base + length:
+                start = offset + addr - base
+                return self.data[start:start + size]
+        raise KeyError(f'address 0x{addr:x} not in any loaded section')
+
+    def read_ptr(self, addr):
+        return struct.unpack('<Q' if self.is64 else '<I', self.read(addr, self.ptr_size))[0]
+
+    def read_cstr(self, addr, limit=512):
+        out = bytearray()
+        while len(out) < limit:
+            b = self.read(addr + len(out), 1)
+            if b == b'\0':
+                break
+            out += b
+        return out.decode('utf-8', errors='replace')
+
+    def read_fmt(self, addr):
+        """tlog_fmt_t: u8 level, u8 nargs, pad, const char *tag, const char *fmt"""
+        level, nargs = struct.unpack('<BB', self.read(addr, 2))
+        tag = self.read_cstr(self.read_ptr(addr + self.ptr_size))
+        fmt = self.read_cstr(self.read_ptr(addr + 2 * self.ptr_size))
+        return level, nargs, tag, fmt
+
+
+def to_signed(value, bits):
+    return value - (1 << bits) if value & (1 << (bits - 1)) else value
+
+
+def render(elf, fmt, args):
+    """Apply a C format string to raw integer arguments."""
+    args = list(args)
+    bits = elf.ptr_size * 8
+
+    def repl(m):
+        flags, width, precision, length, conv = m.groups()
+        if conv == '%':
+            return '%'
+        value = args.pop(0) if args else 0
+        spec = '%' + flags + width + ('.' + precision if precision else '')
+        if conv == 's':
+            try:
+                return (spec + 's') % elf.read_cstr(value)
+            except KeyError:
+                return f'<0x{value:x}>'
+        if conv in 'di':
+            nbits = 64 if length in ('ll', 'j') else min(bits, 32) if length != 'l' else bits
+            return (spec + 'd') % to_signed(value & ((1 << nbits) - 1), nbits)
+        if conv == 'c':
+            return chr(value & 0xFF)
+        if conv == 'p':
+            return f'0x{value:x}'
+        if conv == 'f':
+            return '<float>'
+        return (spec + conv) % value
+
+    return FORMAT_SPEC.sub(repl, fmt)
+
+
+def decode_line(elf, line):
+    fields = line.split()
+    if len(fields) < 3 or fields[0] != 'TLOG':
+        return line
+    try:
+        timestamp = int(fields[1], 16)
+        level, nargs, tag, fmt = elf.read_fmt(int(fields[2], 16))
+        text = render(elf, fmt, [int(a, 16) for a in fields[3:3 + nargs]])
+    except (KeyError, ValueError, struct.error) as e:
+        return f'{line}  # undecodable: {e}'
+    letter = LEVEL_LETTERS[level] if level < len(LEVEL_LETTERS) else '?'
+    return f'{letter} ({timestamp // 1000}) {tag}: {text}'
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('elf', help='firmware ELF matching the running image')
+    parser.add_argument('input', nargs='?', help='captured log (default: stdin)')
+    args = parser.parse_args()
+
+    elf = Elf(args.elf)
+    stream = open(args.input, encoding='utf-8', errors='replace') if args.input else sys.stdin
+    with stream:
+        for line in stream:
+            print(decode_line(elf, line.rstrip('\r\n')), flush=True)
+
+
+if __name__ == '__main__':
+    main()